@@ -0,0 +1,95 @@
+#pragma once
+#include "../DavesCodeLib/Common/timerMinimal.h"
+#include <cstddef>
+#include <vector>
+
+// A tiny benchmark framework for the DavesCodeLib benchmarks, which goes with the one in the Tests project.
+// Each benchmark is a function which is registered with DC_BENCHMARK, times the code it's interested in with
+// DCBench::measure() and prints the results with DCBench::report().
+// main() runs each of the registered benchmarks, or if a name is given on the command line, only the ones whose names
+// contain it.
+// Only the Release configuration gives meaningful times. Most of the SIMD code's instruction set is chosen at compile
+// time (See Math/simd.h), so to compare it with the scalar code, build and run this once with DC_SIMD_SCALAR added to
+// both this and the DavesCodeLib project's preprocessor definitions and once without. The few places which choose
+// while the program is running, such as Image2D's colour operations, are measured with each instruction set instead.
+//
+// Example:
+// DC_BENCHMARK(vector4fAddition)
+// {
+//     std::vector<DC::Vector4f> vectors(1000, DC::Vector4f(1, 2, 3, 4));
+//     double dSeconds = DCBench::measure([&]()
+//         {
+//             for (size_t i = 1; i < vectors.size(); i++)
+//                 vectors[i] += vectors[i - 1];
+//         });
+//     DCBench::doNotOptimiseAway(vectors.data(), vectors.size() * sizeof(DC::Vector4f));
+//     DCBench::report("Vector4f += Vector4f", dSeconds, (double)vectors.size(), "additions");
+// }
+
+// Declares and registers a benchmark function with the given name
+#define DC_BENCHMARK(benchmarkName)\
+	static void benchmarkName(void);\
+	static DCBench::BenchmarkRegistrar benchmarkName##Registrar(#benchmarkName, benchmarkName);\
+	static void benchmarkName(void)
+
+namespace DCBench
+{
+	// Signature of a benchmark function
+	typedef void (*BenchmarkFunction)(void);
+
+	// A registered benchmark
+	struct Benchmark
+	{
+		const char* name;
+		BenchmarkFunction function;
+	};
+
+	// Returns all of the registered benchmarks
+	std::vector<Benchmark>& getBenchmarks(void);
+
+	// Registers the given benchmark when constructed, which DC_BENCHMARK does before main() is called
+	class BenchmarkRegistrar
+	{
+	public:
+		BenchmarkRegistrar(const char* name, BenchmarkFunction function);
+	};
+
+	// Calls the given function once, so that any memory it uses is allocated and in the cache, then over and over
+	// until at least minSeconds have passed and returns the average number of seconds each call took.
+	template <typename Function> double measure(Function functionPARAM, double minSecondsPARAM = 0.25)
+	{
+		functionPARAM();
+		DC::TimerMinimal timer;
+		size_t numCalls = 1;
+		while (true)
+		{
+			timer.update();
+			for (size_t i = 0; i < numCalls; i++)
+				functionPARAM();
+			timer.update();
+			double dSeconds = timer.getSecondsPast();
+			if (dSeconds >= minSecondsPARAM)
+				return dSeconds / (double)numCalls;
+			numCalls *= 2;
+		}
+	}
+
+	// Returns the number of seconds the given function takes to run once, for things which can't simply be repeated,
+	// such as adding a million entities to a tree
+	template <typename Function> double measureOnce(Function functionPARAM)
+	{
+		DC::TimerMinimal timer;
+		timer.update();
+		functionPARAM();
+		timer.update();
+		return timer.getSecondsPast();
+	}
+
+	// Prints the given name and how long each call took.
+	// If numItemsPerCall isn't zero, also prints how many millions of the given items that is per second.
+	void report(const char* name, double secondsPerCall, double numItemsPerCall = 0.0, const char* itemName = "items");
+
+	// Reads the given memory in a way the compiler can't see through, so that the code which wrote the results a
+	// benchmark measured isn't optimised away
+	void doNotOptimiseAway(const void* pData, size_t numBytes);
+}
\ No newline at end of file
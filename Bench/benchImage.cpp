@@ -0,0 +1,136 @@
+#include "bench.h"
+#include "../DavesCodeLib/Image/image2D.h"
+#include "../DavesCodeLib/Math/simd.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace DC;
+
+namespace
+{
+	// Creates the given image with the given size and fills it with random values
+	void createRandomImage(Image2D& imagePARAM, unsigned int widthPARAM, unsigned int heightPARAM, unsigned short numberOfChannelsPARAM)
+	{
+		imagePARAM.createBlank(widthPARAM, heightPARAM, numberOfChannelsPARAM);
+		std::mt19937 random(1);
+		std::uniform_int_distribution<int> value(0, 255);
+		unsigned char* pData = imagePARAM.getData();
+		for (unsigned int i = 0; i < imagePARAM.getDataSize(); i++)
+			pData[i] = (unsigned char)value(random);
+	}
+}
+
+// Each of the filters which take numThreads, on a 4096x4096 RGBA image, with 1, 2 and 4 threads and with 0, which
+// uses all of them.
+// Each time is also given as how many times faster it is than with one thread.
+// The filters which change the image are run over and over on the same image, which changes the pixel values, but not
+// how long the filters take.
+DC_BENCHMARK(imageFilterThreads)
+{
+	const unsigned int kSize = 4096;
+	Image2D image;
+	createRandomImage(image, kSize, kSize, 4);
+	Image2D output;
+
+	struct Filter
+	{
+		const char* name;
+		void (*function)(Image2D& image, Image2D& output, unsigned int numThreads);
+	};
+	const Filter filters[] =
+	{
+		{ "greyscaleSimple()", [](Image2D& image, Image2D&, unsigned int numThreads) { image.greyscaleSimple(numThreads); } },
+		{ "greyscale()", [](Image2D& image, Image2D&, unsigned int numThreads) { image.greyscale(0.299f, 0.587f, 0.114f, numThreads); } },
+		{ "adjustBrightness()", [](Image2D& image, Image2D&, unsigned int numThreads) { image.adjustBrightness(1, numThreads); } },
+		{ "adjustContrast()", [](Image2D& image, Image2D&, unsigned int numThreads) { image.adjustContrast(1, numThreads); } },
+		{ "invert()", [](Image2D& image, Image2D&, unsigned int numThreads) { image.invert(true, false, numThreads); } },
+		{ "swapRedAndBlue()", [](Image2D& image, Image2D&, unsigned int numThreads) { image.swapRedAndBlue(numThreads); } },
+		{ "edgeDetect()", [](Image2D& image, Image2D& output, unsigned int numThreads) { image.edgeDetect(output, 255, 255, 255, numThreads); } },
+		{ "normalmap()", [](Image2D& image, Image2D& output, unsigned int numThreads) { image.normalmap(output, 1.0f, numThreads); } },
+	};
+	const unsigned int numThreads[] = { 1, 2, 4, 0 };
+
+	for (const Filter& filter : filters)
+	{
+		double dOneThreadSeconds = 0.0;
+		for (unsigned int threads : numThreads)
+		{
+			double dSeconds = DCBench::measure([&]() { filter.function(image, output, threads); });
+			if (1 == threads)
+				dOneThreadSeconds = dSeconds;
+			char name[128];
+			snprintf(name, sizeof(name), "%s, threads: %s (x%.2f)", filter.name, threads ? std::to_string(threads).c_str() : "all", dOneThreadSeconds / dSeconds);
+			DCBench::report(name, dSeconds, (double)kSize * kSize, "pixels");
+		}
+	}
+	DCBench::doNotOptimiseAway(image.getData(), image.getDataSize());
+	DCBench::doNotOptimiseAway(output.getData(), output.getDataSize());
+}
+
+// How many bytes per second each of the colour operations gets through on one thread, on 1024x1024 RGB and RGBA
+// images, which are small enough to stay in the cache, so that these measure the operations rather than the memory.
+// The operations choose their code path while the program is running, so each is measured with each of the
+// instruction sets which the CPU supports, see simdLimitInstructionSet().
+DC_BENCHMARK(imageColourThroughput)
+{
+	const unsigned int kSize = 1024;
+	const SIMDInstructionSet instructionSets[] = { SIMDInstructionSet::SCALAR, SIMDInstructionSet::SSE4_1, SIMDInstructionSet::AVX2 };
+	const char* instructionSetNames[] = { "scalar", "SSE4.1", "AVX2" };
+	struct Operation
+	{
+		const char* name;
+		void (*function)(Image2D& image);
+	};
+	const Operation operations[] =
+	{
+		{ "swapRedAndBlue()", [](Image2D& image) { image.swapRedAndBlue(); } },
+		{ "invert()", [](Image2D& image) { image.invert(true, true); } },
+		{ "greyscaleSimple()", [](Image2D& image) { image.greyscaleSimple(); } },
+		{ "greyscale()", [](Image2D& image) { image.greyscale(0.299f, 0.587f, 0.114f); } },
+		{ "adjustBrightness()", [](Image2D& image) { image.adjustBrightness(1); } },
+		{ "adjustContrast()", [](Image2D& image) { image.adjustContrast(1); } },
+	};
+
+	for (int iInstructionSet = 0; iInstructionSet < 3; iInstructionSet++)
+	{
+		simdLimitInstructionSet(instructionSets[iInstructionSet]);
+		if (simdGetInstructionSet() != instructionSets[iInstructionSet])
+			continue;
+		for (unsigned short numberOfChannels = 3; numberOfChannels <= 4; numberOfChannels++)
+		{
+			Image2D image;
+			createRandomImage(image, kSize, kSize, numberOfChannels);
+			for (const Operation& operation : operations)
+			{
+				double dSeconds = DCBench::measure([&]() { operation.function(image); });
+				std::string name = std::string(operation.name) + ", " + std::to_string(numberOfChannels) + " channels, " + instructionSetNames[iInstructionSet];
+				DCBench::report(name.c_str(), dSeconds, (double)image.getDataSize(), "bytes");
+			}
+			DCBench::doNotOptimiseAway(image.getData(), image.getDataSize());
+		}
+	}
+	simdLimitInstructionSet(SIMDInstructionSet::AVX2);
+
+	// removeAlphaChannel() turns the image into a 3 channel one, so each call has to recreate the 4 channel image first.
+	// The time taken to do that on it's own is measured too and taken away, which is why the image is freed first, even
+	// when it's already the 4 channel image.
+	Image2D source;
+	createRandomImage(source, kSize, kSize, 4);
+	Image2D image;
+	auto recreate = [&]()
+		{
+			image.free();
+			image.createBlank(kSize, kSize, 4);
+			memcpy(image.getData(), source.getData(), source.getDataSize());
+		};
+	double dRecreateSeconds = DCBench::measure(recreate);
+	double dSeconds = DCBench::measure([&]()
+		{
+			recreate();
+			image.removeAlphaChannel();
+		});
+	DCBench::report("removeAlphaChannel(), 4 channels", dSeconds - dRecreateSeconds, (double)source.getDataSize(), "bytes");
+	DCBench::doNotOptimiseAway(image.getData(), image.getDataSize());
+}
\ No newline at end of file
@@ -0,0 +1,408 @@
+#include "bench.h"
+#include "../DavesCodeLib/Math/frustum.h"
+#include "../DavesCodeLib/Math/matrix.h"
+#include "../DavesCodeLib/Math/quaternion.h"
+#include "../DavesCodeLib/Math/vector4f.h"
+#include <random>
+#include <string>
+
+using namespace DC;
+
+namespace
+{
+	// Number of matrices and vectors each of the benchmarks below works through per call, which is small enough for
+	// them all to stay in the cache, so that these measure the maths rather than the memory.
+	const size_t kNumValues = 1024;
+
+	// Returns the given number of matrices, filled with random values between -10 and 10
+	std::vector<Matrix> createRandomMatrices(size_t numMatricesPARAM)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+		std::vector<Matrix> matrices(numMatricesPARAM);
+		for (size_t i = 0; i < numMatricesPARAM; i++)
+		{
+			float values[16];
+			for (int j = 0; j < 16; j++)
+				values[j] = value(random);
+			matrices[i].set(values);
+		}
+		return matrices;
+	}
+
+	// Returns the given number of vectors, filled with random values between -10 and 10
+	std::vector<Vector4f> createRandomVector4fs(size_t numVectorsPARAM)
+	{
+		std::mt19937 random(2);
+		std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+		std::vector<Vector4f> vectors(numVectorsPARAM);
+		for (size_t i = 0; i < numVectorsPARAM; i++)
+			vectors[i].set(value(random), value(random), value(random), value(random));
+		return vectors;
+	}
+}
+
+DC_BENCHMARK(matrixOperations)
+{
+	std::vector<Matrix> matricesA = createRandomMatrices(kNumValues);
+	std::vector<Matrix> matricesB = createRandomMatrices(kNumValues);
+	std::vector<Matrix> matricesOut(kNumValues);
+	std::vector<Vector3f> vectors(kNumValues, Vector3f(1.0f, 2.0f, 3.0f));
+	std::vector<Vector3f> vectorsOut(kNumValues);
+
+	double dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumValues; i++)
+				matricesOut[i] = matricesA[i] * matricesB[i];
+		});
+	DCBench::doNotOptimiseAway(matricesOut.data(), matricesOut.size() * sizeof(Matrix));
+	DCBench::report("Matrix * Matrix", dSeconds, (double)kNumValues, "multiplies");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumValues; i++)
+				vectorsOut[i] = matricesA[i].multiply(vectors[i]);
+		});
+	DCBench::doNotOptimiseAway(vectorsOut.data(), vectorsOut.size() * sizeof(Vector3f));
+	DCBench::report("Matrix::multiply(Vector3f)", dSeconds, (double)kNumValues, "multiplies");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumValues; i++)
+				matricesOut[i] = matricesA[i].multiply(0.5f);
+		});
+	DCBench::doNotOptimiseAway(matricesOut.data(), matricesOut.size() * sizeof(Matrix));
+	DCBench::report("Matrix::multiply(float)", dSeconds, (double)kNumValues, "multiplies");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumValues; i++)
+				matricesOut[i] = matricesA[i].transpose();
+		});
+	DCBench::doNotOptimiseAway(matricesOut.data(), matricesOut.size() * sizeof(Matrix));
+	DCBench::report("Matrix::transpose()", dSeconds, (double)kNumValues, "transposes");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumValues; i++)
+				matricesOut[i] = matricesA[i].inverse();
+		});
+	DCBench::doNotOptimiseAway(matricesOut.data(), matricesOut.size() * sizeof(Matrix));
+	DCBench::report("Matrix::inverse()", dSeconds, (double)kNumValues, "inverses");
+}
+
+DC_BENCHMARK(vector4fOperations)
+{
+	std::vector<Vector4f> vectorsA = createRandomVector4fs(kNumValues);
+	std::vector<Vector4f> vectorsB = createRandomVector4fs(kNumValues);
+	std::vector<Vector4f> vectorsOut(kNumValues);
+
+	double dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumValues; i++)
+				vectorsOut[i] = vectorsA[i] + vectorsB[i];
+		});
+	DCBench::doNotOptimiseAway(vectorsOut.data(), vectorsOut.size() * sizeof(Vector4f));
+	DCBench::report("Vector4f + Vector4f", dSeconds, (double)kNumValues, "operations");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumValues; i++)
+				vectorsOut[i] = vectorsA[i] * vectorsB[i];
+		});
+	DCBench::doNotOptimiseAway(vectorsOut.data(), vectorsOut.size() * sizeof(Vector4f));
+	DCBench::report("Vector4f * Vector4f", dSeconds, (double)kNumValues, "operations");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumValues; i++)
+				vectorsOut[i] = vectorsA[i] * 0.5f;
+		});
+	DCBench::doNotOptimiseAway(vectorsOut.data(), vectorsOut.size() * sizeof(Vector4f));
+	DCBench::report("Vector4f * float", dSeconds, (double)kNumValues, "operations");
+
+	// Each addition depends on the one before, so this measures the latency of += rather than the throughput
+	dSeconds = DCBench::measure([&]()
+		{
+			Vector4f sum;
+			for (size_t i = 0; i < kNumValues; i++)
+				sum += vectorsA[i];
+			vectorsOut[0] = sum;
+		});
+	DCBench::doNotOptimiseAway(vectorsOut.data(), sizeof(Vector4f));
+	DCBench::report("Vector4f += Vector4f", dSeconds, (double)kNumValues, "operations");
+}
+
+// The batch visibility methods of Frustum against testing one object at a time, for a million spheres and AABBs
+// spread around the camera, so that roughly a tenth of them are visible.
+DC_BENCHMARK(frustumCulling)
+{
+	const size_t kNumObjects = 1000000;
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> size(0.0f, 5.0f);
+	Vector3fArray centres(kNumObjects);
+	Vector3fArray mins(kNumObjects);
+	Vector3fArray maxs(kNumObjects);
+	std::vector<AABB> aabbs(kNumObjects);
+	std::vector<float> radii(kNumObjects);
+	for (size_t i = 0; i < kNumObjects; i++)
+	{
+		Vector3f centre(position(random), position(random), position(random));
+		Vector3f halfDimensions(size(random), size(random), size(random));
+		centres.set(i, centre);
+		mins.set(i, centre - halfDimensions);
+		maxs.set(i, centre + halfDimensions);
+		aabbs[i].setMinMax(centre - halfDimensions, centre + halfDimensions);
+		radii[i] = size(random);
+	}
+	Matrix matrixView;
+	matrixView.setViewLookat(Vector3f(0.0f, 0.0f, 0.0f), Vector3f(0.0f, 0.0f, 1.0f));
+	Matrix matrixProjection;
+	matrixProjection.setProjectionPerspective(60.0f, 1.0f, 1000.0f, 1.5f);
+	Frustum frustum;
+	frustum.computeFromViewProjection(matrixView, matrixProjection);
+	std::vector<unsigned int> visibilityBits;
+	std::vector<unsigned int> visible;
+	visible.reserve(kNumObjects);
+
+	double dSeconds = DCBench::measure([&]()
+		{
+			visible.clear();
+			for (size_t i = 0; i < kNumObjects; i++)
+			{
+				if (frustum.isAABBIntersecting(aabbs[i]))
+					visible.push_back((unsigned int)i);
+			}
+		});
+	DCBench::doNotOptimiseAway(visible.data(), visible.size() * sizeof(unsigned int));
+	DCBench::report("isAABBIntersecting() for each AABB", dSeconds, (double)kNumObjects, "AABBs");
+
+	for (unsigned int numThreads = 1; numThreads <= 4; numThreads *= 2)
+	{
+		dSeconds = DCBench::measure([&]()
+			{
+				frustum.computeAABBVisibility(mins, maxs, visibilityBits, numThreads);
+			});
+		DCBench::doNotOptimiseAway(visibilityBits.data(), visibilityBits.size() * sizeof(unsigned int));
+		std::string name = "computeAABBVisibility(), threads: " + std::to_string(numThreads);
+		DCBench::report(name.c_str(), dSeconds, (double)kNumObjects, "AABBs");
+	}
+
+	dSeconds = DCBench::measure([&]()
+		{
+			visible.clear();
+			frustum.getVisibleAABBs(mins, maxs, visible);
+		});
+	DCBench::doNotOptimiseAway(visible.data(), visible.size() * sizeof(unsigned int));
+	DCBench::report("getVisibleAABBs()", dSeconds, (double)kNumObjects, "AABBs");
+
+	// Each sphere tested against the planes one at a time, the same way computeSphereVisibility() does
+	const Plane* pPlanes[6] = { &frustum.planeNear, &frustum.planeFar, &frustum.planeLeft, &frustum.planeRight, &frustum.planeTop, &frustum.planeBottom };
+	dSeconds = DCBench::measure([&]()
+		{
+			visible.clear();
+			for (size_t i = 0; i < kNumObjects; i++)
+			{
+				Vector3f centre = centres.get(i);
+				bool bVisible = true;
+				for (int plane = 0; plane < 6 && bVisible; plane++)
+					bVisible = pPlanes[plane]->getDistanceFromPlane(centre) + radii[i] >= 0.0f;
+				if (bVisible)
+					visible.push_back((unsigned int)i);
+			}
+		});
+	DCBench::doNotOptimiseAway(visible.data(), visible.size() * sizeof(unsigned int));
+	DCBench::report("Plane tests for each sphere", dSeconds, (double)kNumObjects, "spheres");
+
+	for (unsigned int numThreads = 1; numThreads <= 4; numThreads *= 2)
+	{
+		dSeconds = DCBench::measure([&]()
+			{
+				frustum.computeSphereVisibility(centres, radii, visibilityBits, numThreads);
+			});
+		DCBench::doNotOptimiseAway(visibilityBits.data(), visibilityBits.size() * sizeof(unsigned int));
+		std::string name = "computeSphereVisibility(), threads: " + std::to_string(numThreads);
+		DCBench::report(name.c_str(), dSeconds, (double)kNumObjects, "spheres");
+	}
+}
+
+// The batch transform methods of Matrix against calling multiply() for each point, for 100k points, which is a lot
+// of points but still fits in the cache, and then for 4M points, split between threads.
+DC_BENCHMARK(batchTransforms)
+{
+	std::mt19937 random(4);
+	std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+	Matrix matrix = createRandomMatrices(1)[0];
+	for (size_t numPoints = 100000; numPoints <= 4000000; numPoints *= 40)
+	{
+		std::string numText = ", points: " + std::to_string(numPoints);
+		std::vector<Vector3f> points(numPoints);
+		std::vector<Vector4f> vector4fs(numPoints);
+		std::vector<float> x(numPoints), y(numPoints), z(numPoints);
+		for (size_t i = 0; i < numPoints; i++)
+		{
+			points[i].set(value(random), value(random), value(random));
+			vector4fs[i].set(points[i].x, points[i].y, points[i].z, 1.0f);
+			x[i] = points[i].x;
+			y[i] = points[i].y;
+			z[i] = points[i].z;
+		}
+		std::vector<Vector3f> pointsOut(numPoints);
+		std::vector<Vector4f> vector4fsOut(numPoints);
+		std::vector<float> xOut(numPoints), yOut(numPoints), zOut(numPoints);
+
+		double dSeconds = DCBench::measure([&]()
+			{
+				for (size_t i = 0; i < numPoints; i++)
+					pointsOut[i] = matrix.multiply(points[i]);
+			});
+		DCBench::doNotOptimiseAway(pointsOut.data(), pointsOut.size() * sizeof(Vector3f));
+		DCBench::report(("multiply() for each point" + numText).c_str(), dSeconds, (double)numPoints, "points");
+
+		for (unsigned int numThreads = 1; numThreads <= 4; numThreads *= 2)
+		{
+			// Threads are only used for millions of points, so only time them for those
+			if (numThreads > 1 && numPoints < 1000000)
+				break;
+			std::string threadsText = numText + ", threads: " + std::to_string(numThreads);
+			dSeconds = DCBench::measure([&]()
+				{
+					matrix.transformPoints(points, pointsOut, numThreads);
+				});
+			DCBench::doNotOptimiseAway(pointsOut.data(), pointsOut.size() * sizeof(Vector3f));
+			DCBench::report(("transformPoints()" + threadsText).c_str(), dSeconds, (double)numPoints, "points");
+
+			dSeconds = DCBench::measure([&]()
+				{
+					matrix.transformPoints(x, y, z, xOut, yOut, zOut, numThreads);
+				});
+			DCBench::doNotOptimiseAway(xOut.data(), xOut.size() * sizeof(float));
+			DCBench::report(("transformPoints(x, y, z)" + threadsText).c_str(), dSeconds, (double)numPoints, "points");
+
+			dSeconds = DCBench::measure([&]()
+				{
+					matrix.transformDirections(points, pointsOut, numThreads);
+				});
+			DCBench::doNotOptimiseAway(pointsOut.data(), pointsOut.size() * sizeof(Vector3f));
+			DCBench::report(("transformDirections()" + threadsText).c_str(), dSeconds, (double)numPoints, "directions");
+
+			dSeconds = DCBench::measure([&]()
+				{
+					matrix.transformVectors(vector4fs, vector4fsOut, numThreads);
+				});
+			DCBench::doNotOptimiseAway(vector4fsOut.data(), vector4fsOut.size() * sizeof(Vector4f));
+			DCBench::report(("transformVectors()" + threadsText).c_str(), dSeconds, (double)numPoints, "vectors");
+		}
+	}
+}
+
+
+// Blending two poses of 100k bones, which is 1600 characters with 64 bones each, one bone at a time against the batch
+// methods of Quaternion and Matrix::multiplyHierarchy().
+DC_BENCHMARK(boneBlending)
+{
+	const size_t kNumCharacters = 1600;
+	const size_t kNumBonesPerCharacter = 64;
+	const size_t kNumBones = kNumCharacters * kNumBonesPerCharacter;
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+	std::vector<Quaternion> rotationsA(kNumBones);
+	std::vector<Quaternion> rotationsB(kNumBones);
+	std::vector<Vector3f> translations(kNumBones);
+	std::vector<int> parentIndicies(kNumBones);
+	for (size_t i = 0; i < kNumBones; i++)
+	{
+		rotationsA[i] = Quaternion(value(random), value(random), value(random), value(random));
+		rotationsA[i].normalise();
+		rotationsB[i] = rotationsA[i] + Quaternion(value(random), value(random), value(random), value(random)) * 0.2f;
+		rotationsB[i].normalise();
+		translations[i].set(value(random), value(random), value(random));
+
+		// Each character's bones form a binary tree, with each bone's parent before it
+		size_t bone = i % kNumBonesPerCharacter;
+		parentIndicies[i] = 0 == bone ? -1 : (int)(i - bone + (bone - 1) / 2);
+	}
+	std::vector<Quaternion> rotations(kNumBones);
+	std::vector<Matrix> localMatrices(kNumBones);
+	std::vector<Matrix> modelMatrices(kNumBones);
+
+	double dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumBones; i++)
+				rotations[i] = rotationsA[i].getSLERP(rotationsB[i], 0.3f);
+		});
+	DCBench::doNotOptimiseAway(rotations.data(), rotations.size() * sizeof(Quaternion));
+	DCBench::report("getSLERP() for each bone", dSeconds, (double)kNumBones, "bones");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			Quaternion::slerp(rotationsA, rotationsB, 0.3f, rotations);
+		});
+	DCBench::doNotOptimiseAway(rotations.data(), rotations.size() * sizeof(Quaternion));
+	DCBench::report("Quaternion::slerp()", dSeconds, (double)kNumBones, "bones");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumBones; i++)
+				rotations[i] = rotationsA[i].getLERP(rotationsB[i], 0.3f);
+		});
+	DCBench::doNotOptimiseAway(rotations.data(), rotations.size() * sizeof(Quaternion));
+	DCBench::report("getLERP() for each bone", dSeconds, (double)kNumBones, "bones");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			Quaternion::nlerp(rotationsA, rotationsB, 0.3f, rotations);
+		});
+	DCBench::doNotOptimiseAway(rotations.data(), rotations.size() * sizeof(Quaternion));
+	DCBench::report("Quaternion::nlerp()", dSeconds, (double)kNumBones, "bones");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumBones; i++)
+			{
+				localMatrices[i].setIdentity();
+				localMatrices[i].setFromQuaternion(rotations[i]);
+				localMatrices[i].setTranslation(translations[i]);
+			}
+		});
+	DCBench::doNotOptimiseAway(localMatrices.data(), localMatrices.size() * sizeof(Matrix));
+	DCBench::report("setFromQuaternion() for each bone", dSeconds, (double)kNumBones, "bones");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			Quaternion::getMatrices(rotations, translations, localMatrices);
+		});
+	DCBench::doNotOptimiseAway(localMatrices.data(), localMatrices.size() * sizeof(Matrix));
+	DCBench::report("Quaternion::getMatrices()", dSeconds, (double)kNumBones, "bones");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			for (size_t i = 0; i < kNumBones; i++)
+			{
+				if (parentIndicies[i] < 0)
+					modelMatrices[i] = localMatrices[i];
+				else
+					modelMatrices[i] = modelMatrices[parentIndicies[i]] * localMatrices[i];
+			}
+		});
+	DCBench::doNotOptimiseAway(modelMatrices.data(), modelMatrices.size() * sizeof(Matrix));
+	DCBench::report("Matrix * Matrix for each bone", dSeconds, (double)kNumBones, "bones");
+
+	dSeconds = DCBench::measure([&]()
+		{
+			Matrix::multiplyHierarchy(localMatrices, parentIndicies, modelMatrices);
+		});
+	DCBench::doNotOptimiseAway(modelMatrices.data(), modelMatrices.size() * sizeof(Matrix));
+	DCBench::report("Matrix::multiplyHierarchy()", dSeconds, (double)kNumBones, "bones");
+
+	// The whole of a frame's blend, as in the example in quaternion.h
+	dSeconds = DCBench::measure([&]()
+		{
+			Quaternion::nlerp(rotationsA, rotationsB, 0.3f, rotations);
+			Quaternion::getMatrices(rotations, translations, localMatrices);
+			Matrix::multiplyHierarchy(localMatrices, parentIndicies, modelMatrices);
+		});
+	DCBench::doNotOptimiseAway(modelMatrices.data(), modelMatrices.size() * sizeof(Matrix));
+	DCBench::report("nlerp(), getMatrices() and multiplyHierarchy()", dSeconds, (double)kNumBones, "bones");
+}
@@ -0,0 +1,555 @@
+#include "bench.h"
+#include "../DavesCodeLib/SpatialPartitioning/octTree.h"
+#include "../DavesCodeLib/SpatialPartitioning/quadTree.h"
+#include "../DavesCodeLib/SpatialPartitioning/spatialHashGrid2D.h"
+#include "../DavesCodeLib/SpatialPartitioning/sweepAndPrune.h"
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+
+using namespace DC;
+
+namespace
+{
+	// Number of each type of query the benchmarks below perform per call
+	const int kNumQueries = 1000;
+
+	// Returns the given number of positions, spread randomly across a cube which is sized so that there's one entity
+	// per 1000 cubic units however many entities there are, so that the queries find a similar number of entities at
+	// each size.
+	std::vector<Vector3f> createRandomPositions(size_t numPositionsPARAM)
+	{
+		float fHalfSize = 5.0f * cbrtf((float)numPositionsPARAM);
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(-fHalfSize, fHalfSize);
+		std::vector<Vector3f> positions(numPositionsPARAM);
+		for (size_t i = 0; i < numPositionsPARAM; i++)
+			positions[i].set(position(random), position(random), position(random));
+		return positions;
+	}
+
+	// Returns the given number of 2D positions, spread randomly across a square which is sized so that there's one
+	// entity per 100 square units however many entities there are
+	std::vector<std::pair<int, int>> createRandomPositions2D(size_t numPositionsPARAM)
+	{
+		int iHalfSize = (int)(5.0f * sqrtf((float)numPositionsPARAM));
+		std::mt19937 random(2);
+		std::uniform_int_distribution<int> position(-iHalfSize, iHalfSize);
+		std::vector<std::pair<int, int>> positions(numPositionsPARAM);
+		for (size_t i = 0; i < numPositionsPARAM; i++)
+			positions[i] = std::make_pair(position(random), position(random));
+		return positions;
+	}
+
+	// Returns the given number of names, one for each entity
+	std::vector<std::wstring> createNames(size_t numNamesPARAM)
+	{
+		std::vector<std::wstring> names(numNamesPARAM);
+		for (size_t i = 0; i < numNamesPARAM; i++)
+			names[i] = L"Entity" + std::to_wstring(i);
+		return names;
+	}
+}
+
+// Adding, querying, moving and removing entities in OctTree and QuadTree, at 10k, 100k and 1M entities.
+// This only uses the methods which take names rather than handles, as those were all the trees had before their nodes
+// were stored in a pool, so that the same code can be built against the old trees to compare the two.
+DC_BENCHMARK(treeNodeStorage)
+{
+	for (size_t numEntities = 10000; numEntities <= 1000000; numEntities *= 10)
+	{
+		std::vector<Vector3f> positions = createRandomPositions(numEntities);
+		std::vector<Vector3f> movedPositions(numEntities);
+		for (size_t i = 0; i < numEntities; i++)
+			movedPositions[i] = positions[i] + Vector3f(1.0f, -1.0f, 0.5f);
+		std::vector<std::wstring> names = createNames(numEntities);
+		std::vector<Vector3f> queryPositions = createRandomPositions(kNumQueries);
+		float fQueryScale = cbrtf((float)numEntities / (float)kNumQueries);
+		std::string numText = std::to_string(numEntities);
+
+		OctTree octTree;
+		double dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					octTree.addEntity(names[i], positions[i]);
+			});
+		DCBench::report(("OctTree add, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		size_t numFound = 0;
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+					numFound += octTree.getEntitiesWithinRange(queryPositions[i] * fQueryScale, 20.0f).size();
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("OctTree range queries, entities: " + numText).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+				{
+					Vector3f vCentre = queryPositions[i] * fQueryScale;
+					numFound += octTree.getEntitiesWithinAABB(AABB(vCentre - Vector3f(20.0f, 20.0f, 20.0f), vCentre + Vector3f(20.0f, 20.0f, 20.0f))).size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("OctTree AABB queries, entities: " + numText).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					octTree.setEntityPosition(names[i], movedPositions[i]);
+			});
+		DCBench::report(("OctTree move, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					octTree.removeEntity(names[i]);
+			});
+		DCBench::report(("OctTree remove, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		// The same for QuadTree, with the range and size of the queries chosen to find about as many entities
+		std::vector<std::pair<int, int>> positions2D = createRandomPositions2D(numEntities);
+		std::vector<std::pair<int, int>> queryPositions2D = createRandomPositions2D(kNumQueries);
+		int iQueryScale = (int)sqrtf((float)numEntities / (float)kNumQueries);
+		QuadTree quadTree;
+		dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					quadTree.addEntity(names[i], positions2D[i].first, positions2D[i].second);
+			});
+		DCBench::report(("QuadTree add, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+					numFound += quadTree.getEntitiesWithinRange(queryPositions2D[i].first * iQueryScale, queryPositions2D[i].second * iQueryScale, 30).size();
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("QuadTree range queries, entities: " + numText).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+				{
+					int iX = queryPositions2D[i].first * iQueryScale;
+					int iY = queryPositions2D[i].second * iQueryScale;
+					numFound += quadTree.getEntitiesWithinRect(Rect(iX - 30, iY - 30, iX + 30, iY + 30)).size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("QuadTree rect queries, entities: " + numText).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					quadTree.setEntityPosition(names[i], positions2D[i].first + 1, positions2D[i].second - 1);
+			});
+		DCBench::report(("QuadTree move, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					quadTree.removeEntity(names[i]);
+			});
+		DCBench::report(("QuadTree remove, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+	}
+}
+
+// Loading a level's worth of entities into an empty OctTree and QuadTree, at 100k and 1M entities, by adding them one
+// at a time with addEntity() against building the tree from all of them at once with buildFromPoints(), on 1, 2 and 4
+// threads and on all of them.
+// Each time is also given as how many times faster it is than adding them one at a time.
+DC_BENCHMARK(levelLoad)
+{
+	const unsigned int numThreads[] = { 1, 2, 4, 0 };
+	for (size_t numEntities = 100000; numEntities <= 1000000; numEntities *= 10)
+	{
+		std::vector<Vector3f> positions = createRandomPositions(numEntities);
+		std::vector<std::pair<int, int>> positions2D = createRandomPositions2D(numEntities);
+		std::vector<int> positionsX(numEntities);
+		std::vector<int> positionsY(numEntities);
+		std::vector<int> userData(numEntities);
+		for (size_t i = 0; i < numEntities; i++)
+		{
+			positionsX[i] = positions2D[i].first;
+			positionsY[i] = positions2D[i].second;
+			userData[i] = (int)i;
+		}
+		std::string numText = std::to_string(numEntities);
+
+		// Each tree is created and freed within the timed code, as buildFromPoints() would be given an empty tree
+		// when loading a level
+		double dAddSeconds = DCBench::measure([&]()
+			{
+				OctTree octTree;
+				for (size_t i = 0; i < numEntities; i++)
+					octTree.addEntity(positions[i], (int)i);
+			}, 1.0);
+		DCBench::report(("OctTree addEntity() for each entity, entities: " + numText).c_str(), dAddSeconds, (double)numEntities, "entities");
+		for (unsigned int threads : numThreads)
+		{
+			double dSeconds = DCBench::measure([&]()
+				{
+					OctTree octTree;
+					octTree.buildFromPoints(positions, userData, threads);
+				}, 1.0);
+			char name[128];
+			snprintf(name, sizeof(name), "OctTree buildFromPoints(), entities: %s, threads: %s (x%.2f)", numText.c_str(), threads ? std::to_string(threads).c_str() : "all", dAddSeconds / dSeconds);
+			DCBench::report(name, dSeconds, (double)numEntities, "entities");
+		}
+
+		dAddSeconds = DCBench::measure([&]()
+			{
+				QuadTree quadTree;
+				for (size_t i = 0; i < numEntities; i++)
+					quadTree.addEntity(positionsX[i], positionsY[i], (int)i);
+			}, 1.0);
+		DCBench::report(("QuadTree addEntity() for each entity, entities: " + numText).c_str(), dAddSeconds, (double)numEntities, "entities");
+		for (unsigned int threads : numThreads)
+		{
+			double dSeconds = DCBench::measure([&]()
+				{
+					QuadTree quadTree;
+					quadTree.buildFromPoints(positionsX, positionsY, userData, threads);
+				}, 1.0);
+			char name[128];
+			snprintf(name, sizeof(name), "QuadTree buildFromPoints(), entities: %s, threads: %s (x%.2f)", numText.c_str(), threads ? std::to_string(threads).c_str() : "all", dAddSeconds / dSeconds);
+			DCBench::report(name, dSeconds, (double)numEntities, "entities");
+		}
+	}
+}
+
+// Moving 50k of an OctTree's 200k entities each frame, one setEntityPosition() call at a time against one call to
+// setEntityPositions(). Each call moves them back and forth between two sets of positions, either a short way apart, so
+// that only a few of them move between nodes, or a long way, so that many of them do.
+DC_BENCHMARK(octTreeBatchMoves)
+{
+	const size_t kNumEntities = 200000;
+	const size_t kNumMoving = 50000;
+	std::vector<Vector3f> positions = createRandomPositions(kNumEntities);
+	for (float fDistance = 0.5f; fDistance <= 5.0f; fDistance *= 10.0f)
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> offset(-fDistance, fDistance);
+		std::vector<Vector3f> movedPositions[2];
+		for (int iSet = 0; iSet < 2; iSet++)
+		{
+			movedPositions[iSet].resize(kNumMoving);
+			for (size_t i = 0; i < kNumMoving; i++)
+				movedPositions[iSet][i] = positions[i] + Vector3f(offset(random), offset(random), offset(random));
+		}
+		for (int iBatch = 0; iBatch < 2; iBatch++)
+		{
+			OctTree octTree;
+			std::vector<SpatialEntityHandle> handles(kNumEntities);
+			for (size_t i = 0; i < kNumEntities; i++)
+				handles[i] = octTree.addEntity(positions[i]);
+			std::vector<SpatialEntityHandle> movingHandles(handles.begin(), handles.begin() + kNumMoving);
+
+			int iFrame = 0;
+			double dSeconds = DCBench::measure([&]()
+				{
+					const std::vector<Vector3f>& frameMovedPositions = movedPositions[iFrame++ & 1];
+					if (iBatch)
+						octTree.setEntityPositions(movingHandles, frameMovedPositions);
+					else
+					{
+						for (size_t i = 0; i < kNumMoving; i++)
+							octTree.setEntityPosition(movingHandles[i], frameMovedPositions[i]);
+					}
+				});
+			std::string name = std::string(iBatch ? "setEntityPositions()" : "setEntityPosition() for each entity") + ", distance: " + std::to_string((int)(fDistance * 10.0f) / 10.0f).substr(0, 3);
+			DCBench::report(name.c_str(), dSeconds, (double)kNumMoving, "moves");
+		}
+	}
+}
+
+// getNearestEntities() against what it replaced, which was querying a guessed range and doubling it until enough
+// entities were found, then sorting them by distance and keeping the k nearest, for 100k entities.
+DC_BENCHMARK(nearestEntities)
+{
+	const size_t kNumEntities = 100000;
+	std::vector<Vector3f> positions = createRandomPositions(kNumEntities);
+	std::vector<Vector3f> queryPositions = createRandomPositions(kNumQueries);
+	float fQueryScale = cbrtf((float)kNumEntities / (float)kNumQueries);
+	OctTree octTree;
+	for (size_t i = 0; i < kNumEntities; i++)
+		octTree.addEntity(positions[i]);
+
+	std::vector<std::pair<int, int>> positions2D = createRandomPositions2D(kNumEntities);
+	std::vector<std::pair<int, int>> queryPositions2D = createRandomPositions2D(kNumQueries);
+	int iQueryScale = (int)sqrtf((float)kNumEntities / (float)kNumQueries);
+	QuadTree quadTree;
+	for (size_t i = 0; i < kNumEntities; i++)
+		quadTree.addEntity(positions2D[i].first, positions2D[i].second);
+
+	std::vector<OctTreeEntity*> entities;
+	std::vector<QuadTreeEntity*> entities2D;
+	size_t numFound = 0;
+	for (unsigned int k = 1; k <= 64; k *= 8)
+	{
+		std::string kText = std::to_string(k);
+		double dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+				{
+					float fRange = 5.0f;
+					while (true)
+					{
+						entities.clear();
+						octTree.getEntitiesWithinRangeExact(queryPositions[i] * fQueryScale, fRange, entities, true);
+						if (entities.size() >= k)
+							break;
+						fRange *= 2.0f;
+					}
+					entities.resize(k);
+					numFound += entities.size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("OctTree growing range, k: " + kText).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+				{
+					entities.clear();
+					octTree.getNearestEntities(queryPositions[i] * fQueryScale, k, FLT_MAX, entities);
+					numFound += entities.size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("OctTree getNearestEntities(), k: " + kText).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+				{
+					int iRange = 5;
+					while (true)
+					{
+						entities2D.clear();
+						quadTree.getEntitiesWithinRangeExact(queryPositions2D[i].first * iQueryScale, queryPositions2D[i].second * iQueryScale, iRange, entities2D, true);
+						if (entities2D.size() >= k)
+							break;
+						iRange *= 2;
+					}
+					entities2D.resize(k);
+					numFound += entities2D.size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("QuadTree growing range, k: " + kText).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+				{
+					entities2D.clear();
+					quadTree.getNearestEntities(queryPositions2D[i].first * iQueryScale, queryPositions2D[i].second * iQueryScale, k, INT_MAX, entities2D);
+					numFound += entities2D.size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("QuadTree getNearestEntities(), k: " + kText).c_str(), dSeconds, (double)kNumQueries, "queries");
+	}
+}
+
+
+namespace
+{
+	// Adds, queries, moves and removes the given entities with either a QuadTree or a SpatialHashGrid2D, which have
+	// the same methods, reporting how long each took with the given name in front
+	template <typename Structure> void benchmark2DStructure(Structure& structurePARAM, const char* structureNamePARAM, const std::vector<std::pair<int, int>>& positionsPARAM, const std::vector<std::pair<int, int>>& queryPositionsPARAM, int queryScalePARAM)
+	{
+		size_t numEntities = positionsPARAM.size();
+		std::string namePrefix = std::string(structureNamePARAM) + " ";
+		std::string nameSuffix = ", entities: " + std::to_string(numEntities);
+		std::vector<SpatialEntityHandle> handles(numEntities);
+		double dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					handles[i] = structurePARAM.addEntity(positionsPARAM[i].first, positionsPARAM[i].second);
+			});
+		DCBench::report((namePrefix + "add" + nameSuffix).c_str(), dSeconds, (double)numEntities, "entities");
+
+		std::vector<QuadTreeEntity*> entities;
+		size_t numFound = 0;
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+				{
+					entities.clear();
+					structurePARAM.getEntitiesWithinRangeExact(queryPositionsPARAM[i].first * queryScalePARAM, queryPositionsPARAM[i].second * queryScalePARAM, 30, entities);
+					numFound += entities.size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report((namePrefix + "exact range queries" + nameSuffix).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		dSeconds = DCBench::measure([&]()
+			{
+				for (int i = 0; i < kNumQueries; i++)
+				{
+					int iX = queryPositionsPARAM[i].first * queryScalePARAM;
+					int iY = queryPositionsPARAM[i].second * queryScalePARAM;
+					entities.clear();
+					structurePARAM.getEntitiesWithinRect(Rect(iX - 30, iY - 30, iX + 30, iY + 30), entities);
+					numFound += entities.size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report((namePrefix + "rect queries" + nameSuffix).c_str(), dSeconds, (double)kNumQueries, "queries");
+
+		// Each entity moves by one unit, so most of them stay in their node or cell
+		dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					structurePARAM.setEntityPosition(handles[i], positionsPARAM[i].first + 1, positionsPARAM[i].second - 1);
+			});
+		DCBench::report((namePrefix + "short moves" + nameSuffix).c_str(), dSeconds, (double)numEntities, "entities");
+
+		// Each entity moves to the position of another one, so nearly all of them change node or cell
+		dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+				{
+					const std::pair<int, int>& position = positionsPARAM[(i + numEntities / 2) % numEntities];
+					structurePARAM.setEntityPosition(handles[i], position.first, position.second);
+				}
+			});
+		DCBench::report((namePrefix + "long moves" + nameSuffix).c_str(), dSeconds, (double)numEntities, "entities");
+
+		dSeconds = DCBench::measureOnce([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+					structurePARAM.removeEntity(handles[i]);
+			});
+		DCBench::report((namePrefix + "remove" + nameSuffix).c_str(), dSeconds, (double)numEntities, "entities");
+	}
+}
+
+// QuadTree and SpatialHashGrid2D side by side, for a dense 2D map with the entities evenly spread across it, at 10k,
+// 100k and 1M entities. The grid's cells are 32 units across, about the size of the queries.
+DC_BENCHMARK(quadTreeAgainstSpatialHashGrid2D)
+{
+	for (size_t numEntities = 10000; numEntities <= 1000000; numEntities *= 10)
+	{
+		std::vector<std::pair<int, int>> positions = createRandomPositions2D(numEntities);
+		std::vector<std::pair<int, int>> queryPositions = createRandomPositions2D(kNumQueries);
+		int iQueryScale = (int)sqrtf((float)numEntities / (float)kNumQueries);
+		QuadTree quadTree;
+		benchmark2DStructure(quadTree, "QuadTree", positions, queryPositions, iQueryScale);
+		SpatialHashGrid2D grid(32);
+		benchmark2DStructure(grid, "SpatialHashGrid2D", positions, queryPositions, iQueryScale);
+	}
+}
+
+
+// Finding every pair of entities within a range of each other, for the broad phase of collision detection, at 10k
+// and 100k entities. The workaround of calling getEntitiesWithinRangeExact() for every entity, which finds each pair
+// twice, against OctTree::getEntityPairsWithinRange(), QuadTree::getEntityPairsWithinRange() and SweepAndPrune.
+// SweepAndPrune is given a cube around each entity, with sides as long as the range, so it finds the pairs whose
+// cubes overlap, which is a few more than those within range.
+DC_BENCHMARK(broadPhasePairs)
+{
+	const float kRange = 5.0f;
+	for (size_t numEntities = 10000; numEntities <= 100000; numEntities *= 10)
+	{
+		std::string numText = std::to_string(numEntities);
+		std::vector<Vector3f> positions = createRandomPositions(numEntities);
+		OctTree octTree;
+		for (size_t i = 0; i < numEntities; i++)
+			octTree.addEntity(positions[i]);
+
+		std::vector<OctTreeEntity*> entities;
+		size_t numFound = 0;
+		double dSeconds = DCBench::measure([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+				{
+					entities.clear();
+					octTree.getEntitiesWithinRangeExact(positions[i], kRange, entities);
+					numFound += entities.size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("OctTree range query for each entity, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>> pairs;
+		dSeconds = DCBench::measure([&]()
+			{
+				pairs.clear();
+				octTree.getEntityPairsWithinRange(kRange, pairs);
+			});
+		DCBench::doNotOptimiseAway(pairs.data(), pairs.size() * sizeof(pairs[0]));
+		DCBench::report(("OctTree getEntityPairsWithinRange(), entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		std::vector<std::pair<int, int>> positions2D = createRandomPositions2D(numEntities);
+		QuadTree quadTree;
+		for (size_t i = 0; i < numEntities; i++)
+			quadTree.addEntity(positions2D[i].first, positions2D[i].second);
+
+		std::vector<QuadTreeEntity*> entities2D;
+		dSeconds = DCBench::measure([&]()
+			{
+				for (size_t i = 0; i < numEntities; i++)
+				{
+					entities2D.clear();
+					quadTree.getEntitiesWithinRangeExact(positions2D[i].first, positions2D[i].second, (int)kRange, entities2D);
+					numFound += entities2D.size();
+				}
+			});
+		DCBench::doNotOptimiseAway(&numFound, sizeof(numFound));
+		DCBench::report(("QuadTree range query for each entity, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>> pairs2D;
+		dSeconds = DCBench::measure([&]()
+			{
+				pairs2D.clear();
+				quadTree.getEntityPairsWithinRange((int)kRange, pairs2D);
+			});
+		DCBench::doNotOptimiseAway(pairs2D.data(), pairs2D.size() * sizeof(pairs2D[0]));
+		DCBench::report(("QuadTree getEntityPairsWithinRange(), entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		// Two sets of AABBs a little way apart, swapped between each call as if the objects were moving, so that the
+		// sorted order from the last call is nearly right
+		std::mt19937 random(4);
+		std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+		std::vector<AABB> aabbs[2];
+		for (int iSet = 0; iSet < 2; iSet++)
+		{
+			aabbs[iSet].resize(numEntities);
+			for (size_t i = 0; i < numEntities; i++)
+			{
+				Vector3f vCentre = positions[i] + Vector3f(offset(random), offset(random), offset(random));
+				aabbs[iSet][i].setMinMax(vCentre - Vector3f(kRange * 0.5f, kRange * 0.5f, kRange * 0.5f), vCentre + Vector3f(kRange * 0.5f, kRange * 0.5f, kRange * 0.5f));
+			}
+		}
+		SweepAndPrune sweepAndPrune;
+		std::vector<std::pair<unsigned int, unsigned int>> indexPairs;
+		int iFrame = 0;
+		dSeconds = DCBench::measure([&]()
+			{
+				sweepAndPrune.free();
+				indexPairs.clear();
+				sweepAndPrune.getOverlappingPairs(aabbs[iFrame++ & 1], indexPairs);
+			});
+		DCBench::doNotOptimiseAway(indexPairs.data(), indexPairs.size() * sizeof(indexPairs[0]));
+		DCBench::report(("SweepAndPrune sorting from scratch, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+
+		dSeconds = DCBench::measure([&]()
+			{
+				indexPairs.clear();
+				sweepAndPrune.getOverlappingPairs(aabbs[iFrame++ & 1], indexPairs);
+			});
+		DCBench::doNotOptimiseAway(indexPairs.data(), indexPairs.size() * sizeof(indexPairs[0]));
+		DCBench::report(("SweepAndPrune nearly sorted, entities: " + numText).c_str(), dSeconds, (double)numEntities, "entities");
+	}
+}
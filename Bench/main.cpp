@@ -0,0 +1,76 @@
+#include "bench.h"
+#include "../DavesCodeLib/Math/simd.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _DEBUG
+#pragma comment(lib, "../_build/DavesCodeLib/OutputDir/x64/Debug/DavesCodeLib.lib")
+#else
+#pragma comment(lib, "../_build/DavesCodeLib/OutputDir/x64/Release/DavesCodeLib.lib")
+#endif
+
+namespace DCBench
+{
+	namespace
+	{
+		// Written to by doNotOptimiseAway(), which the compiler has to assume is read by something
+		volatile unsigned char dataSink = 0;
+	}
+
+	std::vector<Benchmark>& getBenchmarks(void)
+	{
+		// Created upon first use, as the benchmarks are registered before main() is called
+		static std::vector<Benchmark> benchmarks;
+		return benchmarks;
+	}
+
+	BenchmarkRegistrar::BenchmarkRegistrar(const char* namePARAM, BenchmarkFunction functionPARAM)
+	{
+		getBenchmarks().push_back(Benchmark{ namePARAM, functionPARAM });
+	}
+
+	void report(const char* namePARAM, double secondsPerCallPARAM, double numItemsPerCallPARAM, const char* itemNamePARAM)
+	{
+		if (secondsPerCallPARAM < 0.001)
+			printf("    %-56s %12.3f us", namePARAM, secondsPerCallPARAM * 1000000.0);
+		else
+			printf("    %-56s %12.3f ms", namePARAM, secondsPerCallPARAM * 1000.0);
+		if (numItemsPerCallPARAM > 0.0)
+			printf("    %10.2f million %s/sec", numItemsPerCallPARAM / secondsPerCallPARAM / 1000000.0, itemNamePARAM);
+		printf("\n");
+	}
+
+	void doNotOptimiseAway(const void* pDataPARAM, size_t numBytesPARAM)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pDataPARAM;
+		unsigned char result = 0;
+		for (size_t i = 0; i < numBytesPARAM; i++)
+			result ^= pBytes[i];
+		dataSink = result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+#if defined(DC_SIMD_AVX2)
+	printf("SIMD: AVX2\n");
+#elif defined(DC_SIMD_SSE4_1)
+	printf("SIMD: SSE4.1\n");
+#else
+	printf("SIMD: None (DC_SIMD_SCALAR)\n");
+#endif
+	const char* instructionSetNames[] = { "None", "SSE4.1", "AVX2" };
+	printf("SIMD chosen while running: %s\n", instructionSetNames[(int)DC::simdGetInstructionSet()]);
+#ifdef _DEBUG
+	printf("This is a debug build, so the times below mean very little.\n");
+#endif
+	const char* filter = argc > 1 ? argv[1] : 0;
+	for (const DCBench::Benchmark& benchmark : DCBench::getBenchmarks())
+	{
+		if (filter && !strstr(benchmark.name, filter))
+			continue;
+		printf("%s\n", benchmark.name);
+		benchmark.function();
+	}
+	return 0;
+}
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include "templateManager.h"
 #include "templateManagerNoRef.h"
 #include "templateManagerNoRefLockable.h"
+#include "templateSmallArray.h"
 #include "timer.h"
 #include "timerMinimal.h"
 #include "utilities.h"
@@ -1,4 +1,7 @@
 #pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
 
 // This file contains comments to help explain threading and possibly helper code to help deal with multithreading.
 // 
@@ -117,5 +120,37 @@
 
 namespace DC
 {
+	// Splits the items numbered 0 to numItems - 1 into chunks and calls function(firstItem, numItemsInChunk) for each
+	// chunk, on up to numThreads threads, with 0 using as many as there are hardware threads.
+	// Each thread is given at least minItemsPerThread items, as starting a thread takes a while, so fewer threads
+	// are used for smaller numbers of items, down to just the calling thread, which always does the first chunk.
+	// The size of each chunk, other than the last, is a multiple of chunkMultiple, such as the number of floats
+	// which fit in a SIMD register, so that only the last chunk needs to deal with any leftover items.
+	// Returns once all of the chunks are done.
+	// Example:
+	// runInChunks(particles.size(), 0, 10000, 8, [&](size_t firstItem, size_t numItems)
+	//	{
+	//		updateParticles(particles.data() + firstItem, numItems);
+	//	});
+	template <typename Function> void runInChunks(size_t numItemsPARAM, unsigned int numThreadsPARAM, size_t minItemsPerThreadPARAM, size_t chunkMultiplePARAM, Function functionPARAM)
+	{
+		size_t maxThreads = numThreadsPARAM;
+		if (0 == maxThreads)
+			maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		maxThreads = std::min(maxThreads, std::max(numItemsPARAM / std::max(minItemsPerThreadPARAM, (size_t)1), (size_t)1));
+		if (maxThreads <= 1)
+		{
+			functionPARAM((size_t)0, numItemsPARAM);
+			return;
+		}
 
+		size_t chunkSize = (numItemsPARAM + maxThreads - 1) / maxThreads;
+		chunkSize = (chunkSize + chunkMultiplePARAM - 1) / chunkMultiplePARAM * chunkMultiplePARAM;
+		std::vector<std::thread> threads;
+		for (size_t firstItem = chunkSize; firstItem < numItemsPARAM; firstItem += chunkSize)
+			threads.push_back(std::thread(functionPARAM, firstItem, std::min(chunkSize, numItemsPARAM - firstItem)));
+		functionPARAM((size_t)0, std::min(chunkSize, numItemsPARAM));
+		for (size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+	}
 }
\ No newline at end of file
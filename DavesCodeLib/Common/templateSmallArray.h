@@ -0,0 +1,289 @@
+#pragma once
+#include "error.h"
+#include <cstring>
+#include <utility>
+
+namespace DC
+{
+	// Template class holding an array of values of the given type, which stores the first few values
+	// inside of the object itself and only allocates memory from the heap once the number of values
+	// grows beyond inlineCapacity.
+	// This is used by things such as the OctTreeNode and QuadTreeNode classes, where most nodes only hold
+	// a handful of values and we don't want each of them to perform a heap allocation, or to have their
+	// values scattered around memory.
+	// The type must be trivially copyable (pointers, ints, floats etc) as values are moved around with memcpy.
+	// Removal of values does not preserve the order of the values.
+	template <typename T, unsigned int inlineCapacity> class SmallArray
+	{
+	public:
+		// Constructor, the array is empty and uses the inline storage
+		SmallArray();
+
+		// Copy constructor
+		SmallArray(const SmallArray& other);
+
+		// Move constructor, steals the other array's heap memory if it has any
+		SmallArray(SmallArray&& other) noexcept;
+
+		// Destructor, frees heap memory if any was allocated
+		~SmallArray();
+
+		// Sets this array to contain a copy of the values of the other
+		SmallArray& operator=(const SmallArray& other);
+
+		// Steals the other array's values
+		SmallArray& operator=(SmallArray&& other) noexcept;
+
+		// Access the value at the given index.
+		// No bounds checking is performed.
+		T& operator[](unsigned int index);
+
+		// Access the value at the given index.
+		// No bounds checking is performed.
+		const T& operator[](unsigned int index) const;
+
+		// Adds a value to the end of the array, moving the values onto the heap if the inline storage is full
+		void push_back(const T& value);
+
+		// Removes the value at the given index by replacing it with the last value in the array.
+		// If the given index is invalid, an exception occurs.
+		void removeAndSwapWithLast(unsigned int index);
+
+		// Removes the last value in the array.
+		// If the array is empty, an exception occurs.
+		void pop_back(void);
+
+		// Returns the index of the given value or -1 if it couldn't be found.
+		int find(const T& value) const;
+
+		// Removes all values.
+		// Heap memory, if any was allocated, is kept for reuse.
+		void clear(void);
+
+		// Removes all values and frees any heap memory, returning to the inline storage.
+		void freeMemory(void);
+
+		// Returns the number of values in the array
+		unsigned int size(void) const;
+
+		// Returns whether the array is empty
+		bool empty(void) const;
+
+		// Returns the current capacity of the array before it needs to grow
+		unsigned int getCapacity(void) const;
+
+		// Returns whether the values are currently stored on the heap instead of inline
+		bool getIsOnHeap(void) const;
+
+		// Returns a pointer to the first value
+		T* data(void);
+
+		// Returns a pointer to the first value
+		const T* data(void) const;
+
+		// Iterator support so the array may be used with range based for loops
+		T* begin(void) { return data(); }
+		T* end(void) { return data() + count; }
+		const T* begin(void) const { return data(); }
+		const T* end(void) const { return data() + count; }
+	private:
+		T inlineValues[inlineCapacity];	// The inline storage used until more than inlineCapacity values are added
+		T* heapValues;					// Heap storage, 0 until the inline storage overflows
+		unsigned int count;				// Number of values in the array
+		unsigned int capacity;			// Number of values the current storage can hold
+	};
+
+	template <class T, unsigned int inlineCapacity>
+	SmallArray<T, inlineCapacity>::SmallArray()
+	{
+		heapValues = 0;
+		count = 0;
+		capacity = inlineCapacity;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	SmallArray<T, inlineCapacity>::SmallArray(const SmallArray& other)
+	{
+		heapValues = 0;
+		count = 0;
+		capacity = inlineCapacity;
+		*this = other;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	SmallArray<T, inlineCapacity>::SmallArray(SmallArray&& other) noexcept
+	{
+		heapValues = 0;
+		count = 0;
+		capacity = inlineCapacity;
+		*this = std::move(other);
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	SmallArray<T, inlineCapacity>::~SmallArray()
+	{
+		freeMemory();
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	SmallArray<T, inlineCapacity>& SmallArray<T, inlineCapacity>::operator=(const SmallArray& other)
+	{
+		// Guard against self assignment
+		if (this == &other)
+			return *this;
+
+		clear();
+		if (other.count > capacity)
+		{
+			freeMemory();
+			heapValues = new T[other.capacity];
+			ErrorIfFalse(heapValues, L"SmallArray::operator=() failed to allocate memory.");
+			capacity = other.capacity;
+		}
+		memcpy(data(), other.data(), sizeof(T) * other.count);
+		count = other.count;
+		return *this;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	SmallArray<T, inlineCapacity>& SmallArray<T, inlineCapacity>::operator=(SmallArray&& other) noexcept
+	{
+		// Guard against self assignment
+		if (this == &other)
+			return *this;
+
+		freeMemory();
+		if (other.heapValues)
+		{
+			// Steal the heap memory
+			heapValues = other.heapValues;
+			capacity = other.capacity;
+			count = other.count;
+			other.heapValues = 0;
+			other.capacity = inlineCapacity;
+			other.count = 0;
+			return *this;
+		}
+		memcpy(inlineValues, other.inlineValues, sizeof(T) * other.count);
+		count = other.count;
+		other.count = 0;
+		return *this;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	T& SmallArray<T, inlineCapacity>::operator[](unsigned int index)
+	{
+		return data()[index];
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	const T& SmallArray<T, inlineCapacity>::operator[](unsigned int index) const
+	{
+		return data()[index];
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	void SmallArray<T, inlineCapacity>::push_back(const T& value)
+	{
+		if (count == capacity)
+		{
+			// Double the capacity and move the values over to the new memory
+			unsigned int newCapacity = capacity * 2;
+			T* newValues = new T[newCapacity];
+			ErrorIfFalse(newValues, L"SmallArray::push_back() failed to allocate memory.");
+			memcpy(newValues, data(), sizeof(T) * count);
+			if (heapValues)
+				delete[] heapValues;
+			heapValues = newValues;
+			capacity = newCapacity;
+		}
+		data()[count] = value;
+		count++;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	void SmallArray<T, inlineCapacity>::removeAndSwapWithLast(unsigned int index)
+	{
+		ErrorIfTrue(index >= count, L"SmallArray::removeAndSwapWithLast() failed. Invalid index given.");
+		count--;
+		T* values = data();
+		values[index] = values[count];
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	void SmallArray<T, inlineCapacity>::pop_back(void)
+	{
+		ErrorIfTrue(0 == count, L"SmallArray::pop_back() failed. The array is empty.");
+		count--;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	int SmallArray<T, inlineCapacity>::find(const T& value) const
+	{
+		const T* values = data();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (values[i] == value)
+				return int(i);
+		}
+		return -1;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	void SmallArray<T, inlineCapacity>::clear(void)
+	{
+		count = 0;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	void SmallArray<T, inlineCapacity>::freeMemory(void)
+	{
+		if (heapValues)
+		{
+			delete[] heapValues;
+			heapValues = 0;
+		}
+		capacity = inlineCapacity;
+		count = 0;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	unsigned int SmallArray<T, inlineCapacity>::size(void) const
+	{
+		return count;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	bool SmallArray<T, inlineCapacity>::empty(void) const
+	{
+		return 0 == count;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	unsigned int SmallArray<T, inlineCapacity>::getCapacity(void) const
+	{
+		return capacity;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	bool SmallArray<T, inlineCapacity>::getIsOnHeap(void) const
+	{
+		return heapValues != 0;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	T* SmallArray<T, inlineCapacity>::data(void)
+	{
+		if (heapValues)
+			return heapValues;
+		return inlineValues;
+	}
+
+	template <class T, unsigned int inlineCapacity>
+	const T* SmallArray<T, inlineCapacity>::data(void) const
+	{
+		if (heapValues)
+			return heapValues;
+		return inlineValues;
+	}
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "../Common/utilities.h"
 #include "../Math/vector3f.h"
 #include "../Math/mathUtilities.h"
+#include "../Math/simd.h"
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../ThirdParty/stb/stb_image.h"
@@ -11,8 +13,625 @@
 #define __STDC_LIB_EXT1__
 #include "../ThirdParty/stb/stb_image_write.h"
 
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "../ThirdParty/stb/stb_image_resize2.h"
+
 namespace DC
 {
+	namespace
+	{
+		// The functions below each process numPixelsPARAM pixels, starting at pPixelsPARAM, which have iNumChannels
+		// channels each. The number of channels is a template parameter, so each loop is compiled for 3 and 4 channel
+		// images seperately, without checking the number of channels for each pixel.
+		// The results are exactly the same as the per pixel code they replace.
+		//
+		// Where there's a SIMD code path, it processes as many pixels as it can and the scalar code does the rest.
+		// 4 channel pixels never straddle a SIMD register, but 3 channel ones do, so for those, 16 pixels are
+		// processed at a time, see load16Pixels3() and store16Pixels3().
+		// Which code path is used is chosen while the program is running, from simdGetInstructionSet(), so the AVX2
+		// ones are used on CPUs which have it, without the whole program having to be compiled with DC_SIMD_AVX2.
+
+#if defined(DC_SIMD_SSE4_1)
+		// Loads the 16 3 channel pixels at pPixelsPARAM (48 bytes) into vGroupsPARAM, 4 pixels in each.
+		// Each group holds the 12 bytes of it's pixels in it's lowest 12 bytes and the highest 4 are undefined.
+		inline void load16Pixels3(const unsigned char* pPixelsPARAM, __m128i vGroupsPARAM[4])
+		{
+			__m128i vBytes0 = _mm_loadu_si128((const __m128i*)pPixelsPARAM);
+			__m128i vBytes1 = _mm_loadu_si128((const __m128i*)(pPixelsPARAM + 16));
+			__m128i vBytes2 = _mm_loadu_si128((const __m128i*)(pPixelsPARAM + 32));
+			vGroupsPARAM[0] = vBytes0;
+			vGroupsPARAM[1] = _mm_alignr_epi8(vBytes1, vBytes0, 12);
+			vGroupsPARAM[2] = _mm_alignr_epi8(vBytes2, vBytes1, 8);
+			vGroupsPARAM[3] = _mm_srli_si128(vBytes2, 4);
+		}
+
+		// Stores the 16 3 channel pixels in vGroupsPARAM, which are the same as load16Pixels3() loads, except the highest
+		// 4 bytes of each group must be zero, to pPixelsPARAM (48 bytes)
+		// Unlike loading and storing 16 bytes at a time, 5 or 4 pixels apart, no bytes are loaded or stored twice, so
+		// the loads don't have to wait for the previous stores.
+		inline void store16Pixels3(unsigned char* pPixelsPARAM, const __m128i vGroupsPARAM[4])
+		{
+			_mm_storeu_si128((__m128i*)pPixelsPARAM, _mm_or_si128(vGroupsPARAM[0], _mm_slli_si128(vGroupsPARAM[1], 12)));
+			_mm_storeu_si128((__m128i*)(pPixelsPARAM + 16), _mm_or_si128(_mm_srli_si128(vGroupsPARAM[1], 4), _mm_slli_si128(vGroupsPARAM[2], 8)));
+			_mm_storeu_si128((__m128i*)(pPixelsPARAM + 32), _mm_or_si128(_mm_srli_si128(vGroupsPARAM[2], 8), _mm_slli_si128(vGroupsPARAM[3], 4)));
+		}
+#endif
+
+#if defined(DC_SIMD_SSE4_1)
+		// The AVX2 code paths of the functions below, which each process as many pixels or bytes as they can, from the
+		// first, and return how many that was
+		DC_SIMD_TARGET_AVX2 size_t swapRedAndBlueOfPixels4AVX2(unsigned char* pPixelsPARAM, size_t numPixelsPARAM)
+		{
+			const __m256i vShuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+			size_t i = 0;
+			for (; i + 8 <= numPixelsPARAM; i += 8)
+			{
+				__m256i* pPixels = (__m256i*)(pPixelsPARAM + i * 4);
+				_mm256_storeu_si256(pPixels, _mm256_shuffle_epi8(_mm256_loadu_si256(pPixels), vShuffle));
+			}
+			return i;
+		}
+
+		// XORs each byte with the byte of iMaskPARAM at the same position within each 4 bytes
+		DC_SIMD_TARGET_AVX2 size_t xorBytesAVX2(unsigned char* pBytesPARAM, size_t numBytesPARAM, int iMaskPARAM)
+		{
+			const __m256i vMask = _mm256_set1_epi32(iMaskPARAM);
+			size_t i = 0;
+			for (; i + 32 <= numBytesPARAM; i += 32)
+			{
+				__m256i* pBytes = (__m256i*)(pBytesPARAM + i);
+				_mm256_storeu_si256(pBytes, _mm256_xor_si256(_mm256_loadu_si256(pBytes), vMask));
+			}
+			return i;
+		}
+
+		// Adds, with saturation, the byte of iAmountsPARAM at the same position within each 4 bytes to each byte, or
+		// subtracts it if bSubtractPARAM is true
+		DC_SIMD_TARGET_AVX2 size_t addBytesSaturatedAVX2(unsigned char* pBytesPARAM, size_t numBytesPARAM, int iAmountsPARAM, bool bSubtractPARAM)
+		{
+			const __m256i vAmounts = _mm256_set1_epi32(iAmountsPARAM);
+			size_t i = 0;
+			for (; i + 32 <= numBytesPARAM; i += 32)
+			{
+				__m256i* pBytes = (__m256i*)(pBytesPARAM + i);
+				__m256i vBytes = _mm256_loadu_si256(pBytes);
+				if (bSubtractPARAM)
+					_mm256_storeu_si256(pBytes, _mm256_subs_epu8(vBytes, vAmounts));
+				else
+					_mm256_storeu_si256(pBytes, _mm256_adds_epu8(vBytes, vAmounts));
+			}
+			return i;
+		}
+#endif
+
+		template <int iNumChannels> void swapRedAndBlueOfPixels(unsigned char* pPixelsPARAM, size_t numPixelsPARAM)
+		{
+			size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+			SIMDInstructionSet instructionSet = simdGetInstructionSet();
+			if (4 == iNumChannels && SIMDInstructionSet::SCALAR != instructionSet)
+			{
+				if (SIMDInstructionSet::AVX2 == instructionSet)
+					i = swapRedAndBlueOfPixels4AVX2(pPixelsPARAM, numPixelsPARAM);
+				const __m128i vShuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+				for (; i + 4 <= numPixelsPARAM; i += 4)
+				{
+					__m128i* pPixels = (__m128i*)(pPixelsPARAM + i * 4);
+					_mm_storeu_si128(pPixels, _mm_shuffle_epi8(_mm_loadu_si128(pPixels), vShuffle));
+				}
+			}
+			else if (3 == iNumChannels && SIMDInstructionSet::SCALAR != instructionSet)
+			{
+				const __m128i vShuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+				__m128i vGroups[4];
+				for (; i + 16 <= numPixelsPARAM; i += 16)
+				{
+					unsigned char* pPixels = pPixelsPARAM + i * 3;
+					load16Pixels3(pPixels, vGroups);
+					for (int iGroup = 0; iGroup < 4; iGroup++)
+						vGroups[iGroup] = _mm_shuffle_epi8(vGroups[iGroup], vShuffle);
+					store16Pixels3(pPixels, vGroups);
+				}
+			}
+#endif
+			for (; i < numPixelsPARAM; i++)
+			{
+				unsigned char* pPixel = pPixelsPARAM + i * iNumChannels;
+				unsigned char chTemp = pPixel[0];
+				pPixel[0] = pPixel[2];
+				pPixel[2] = chTemp;
+			}
+		}
+
+		// 255 - value is the same as value XOR 255, so the bytes are XORed with 255 where they're to be inverted and 0 where
+		// they aren't. As the pattern repeats every 4 bytes, the bytes can be done 16 or 32 at a time, whichever pixel
+		// they belong to.
+		template <int iNumChannels> void invertPixels(unsigned char* pPixelsPARAM, size_t numPixelsPARAM, bool bInvertColourPARAM, bool bInvertAlphaPARAM)
+		{
+			unsigned char colourMask = bInvertColourPARAM ? 255 : 0;
+			unsigned char mask[4] = { colourMask, colourMask, colourMask, colourMask };
+			if (4 == iNumChannels)
+				mask[3] = bInvertAlphaPARAM ? 255 : 0;
+			size_t numBytes = numPixelsPARAM * iNumChannels;
+			size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+			SIMDInstructionSet instructionSet = simdGetInstructionSet();
+			if (SIMDInstructionSet::SCALAR != instructionSet)
+			{
+				int iMask;
+				memcpy(&iMask, mask, 4);
+				if (SIMDInstructionSet::AVX2 == instructionSet)
+					i = xorBytesAVX2(pPixelsPARAM, numBytes, iMask);
+				const __m128i vMask = _mm_set1_epi32(iMask);
+				for (; i + 16 <= numBytes; i += 16)
+				{
+					__m128i* pBytes = (__m128i*)(pPixelsPARAM + i);
+					_mm_storeu_si128(pBytes, _mm_xor_si128(_mm_loadu_si128(pBytes), vMask));
+				}
+			}
+#endif
+			for (; i < numBytes; i++)
+				pPixelsPARAM[i] ^= mask[i % 4];
+		}
+
+		// Returns the mean of the given pixel's RGB components, the same as Image2D::greyscaleSimple() sets them to
+		inline unsigned char getGreyscaleSimple(const unsigned char* pPixelPARAM)
+		{
+			float fTmp = float(pPixelPARAM[0]);
+			fTmp += float(pPixelPARAM[1]);
+			fTmp += float(pPixelPARAM[2]);
+			fTmp *= 1.0f / 3.0f;
+			return (unsigned char)fTmp;
+		}
+
+		// Computes the normal Image2D::normalmap() stores for a pixel, from the differences between the pixel's height and
+		// the heights of the pixels to it's left and above it, and writes it to the three bytes at pNormalOut
+		inline void computeNormal(int iDeltaLeftPARAM, int iDeltaAbovePARAM, float scalePARAM, unsigned char* pNormalOutPARAM)
+		{
+			float fX = float(iDeltaLeftPARAM) / 255.0f;		// Convert to -1.0f to 1.0f
+			float fY = float(iDeltaAbovePARAM) / 255.0f;	// ....
+			float fZ = scalePARAM;
+
+			// Compute length of vector and normalize
+			float fLength = sqrt((fX * fX) + (fY * fY) + (fZ * fZ));
+			if (areFloatsEqual(fLength, 0.0f))	// If length is nearly zero, just set as up vector
+			{
+				fX = 0.0f;
+				fY = 0.0f;
+				fZ = scalePARAM;
+			}
+			else
+			{
+				fX = fX / fLength;
+				fY = fY / fLength;
+				fZ = fZ / fLength;
+			}
+
+			// Convert from -1, +1 to 0, 255
+			fX += 1.0f;	fX *= 127.0f;
+			fY += 1.0f;	fY *= 127.0f;
+			fZ += 1.0f;	fZ *= 127.0f;
+			pNormalOutPARAM[0] = (unsigned char)fX;
+			pNormalOutPARAM[1] = (unsigned char)fY;
+			pNormalOutPARAM[2] = (unsigned char)fZ;
+		}
+
+#if defined(DC_SIMD_SSE4_1)
+		// Computes the grey value of each of the pixels in vPixelsPARAM, which holds one pixel in each 32 bits, with it's red,
+		// green and blue components in the lowest three bytes.
+		// If bSimple is true, the grey value is the mean of the components, the same as getGreyscaleSimple(), otherwise it's
+		// the components multiplied by the sensitivities and summed, the same as greyscalePixels().
+		// Returns the pixels with the grey value in each of the lowest three bytes and zero in the highest.
+		// Like the scalar code's conversion to unsigned char, the grey value is the lowest byte of the truncated integer.
+		template <bool bSimple> inline __m128i getGreyPixels(__m128i vPixelsPARAM, __m128 vRedSensitivityPARAM, __m128 vGreenSensitivityPARAM, __m128 vBlueSensitivityPARAM)
+		{
+			const __m128i vByteMask = _mm_set1_epi32(0xFF);
+			__m128 vRed = _mm_cvtepi32_ps(_mm_and_si128(vPixelsPARAM, vByteMask));
+			__m128 vGreen = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(vPixelsPARAM, 8), vByteMask));
+			__m128 vBlue = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(vPixelsPARAM, 16), vByteMask));
+			__m128 vGrey;
+			if (bSimple)
+				vGrey = _mm_mul_ps(_mm_add_ps(_mm_add_ps(vRed, vGreen), vBlue), _mm_set1_ps(1.0f / 3.0f));
+			else
+			{
+				vGrey = _mm_mul_ps(vRed, vRedSensitivityPARAM);
+				vGrey = _mm_add_ps(vGrey, _mm_mul_ps(vGreen, vGreenSensitivityPARAM));
+				vGrey = _mm_add_ps(vGrey, _mm_mul_ps(vBlue, vBlueSensitivityPARAM));
+			}
+			__m128i vGreyBytes = _mm_and_si128(_mm_cvttps_epi32(vGrey), vByteMask);
+			return _mm_or_si128(vGreyBytes, _mm_or_si128(_mm_slli_epi32(vGreyBytes, 8), _mm_slli_epi32(vGreyBytes, 16)));
+		}
+
+		// The same as the above, for 8 pixels
+		template <bool bSimple> DC_SIMD_TARGET_AVX2 inline __m256i getGreyPixels(__m256i vPixelsPARAM, __m256 vRedSensitivityPARAM, __m256 vGreenSensitivityPARAM, __m256 vBlueSensitivityPARAM)
+		{
+			const __m256i vByteMask = _mm256_set1_epi32(0xFF);
+			__m256 vRed = _mm256_cvtepi32_ps(_mm256_and_si256(vPixelsPARAM, vByteMask));
+			__m256 vGreen = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(vPixelsPARAM, 8), vByteMask));
+			__m256 vBlue = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(vPixelsPARAM, 16), vByteMask));
+			__m256 vGrey;
+			if (bSimple)
+				vGrey = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(vRed, vGreen), vBlue), _mm256_set1_ps(1.0f / 3.0f));
+			else
+			{
+				vGrey = _mm256_mul_ps(vRed, vRedSensitivityPARAM);
+				vGrey = _mm256_add_ps(vGrey, _mm256_mul_ps(vGreen, vGreenSensitivityPARAM));
+				vGrey = _mm256_add_ps(vGrey, _mm256_mul_ps(vBlue, vBlueSensitivityPARAM));
+			}
+			__m256i vGreyBytes = _mm256_and_si256(_mm256_cvttps_epi32(vGrey), vByteMask);
+			return _mm256_or_si256(vGreyBytes, _mm256_or_si256(_mm256_slli_epi32(vGreyBytes, 8), _mm256_slli_epi32(vGreyBytes, 16)));
+		}
+
+		// The AVX2 code path of greyscalePixels() for 4 channel pixels, which processes as many pixels as it can, from the
+		// first, and returns how many that was
+		template <bool bSimple> DC_SIMD_TARGET_AVX2 size_t greyscalePixels4AVX2(unsigned char* pPixelsPARAM, size_t numPixelsPARAM, const Vector3f& vSensitivityPARAM)
+		{
+			const __m256 vRedSensitivity = _mm256_set1_ps(vSensitivityPARAM.x);
+			const __m256 vGreenSensitivity = _mm256_set1_ps(vSensitivityPARAM.y);
+			const __m256 vBlueSensitivity = _mm256_set1_ps(vSensitivityPARAM.z);
+			const __m256i vAlphaMask = _mm256_set1_epi32(0xFF000000);
+			size_t i = 0;
+			for (; i + 8 <= numPixelsPARAM; i += 8)
+			{
+				__m256i* pPixels = (__m256i*)(pPixelsPARAM + i * 4);
+				__m256i vPixels = _mm256_loadu_si256(pPixels);
+				__m256i vGrey = getGreyPixels<bSimple>(vPixels, vRedSensitivity, vGreenSensitivity, vBlueSensitivity);
+				_mm256_storeu_si256(pPixels, _mm256_or_si256(vGrey, _mm256_and_si256(vPixels, vAlphaMask)));
+			}
+			return i;
+		}
+#endif
+
+		// Sets the RGB components of each pixel to it's grey value, see getGreyPixels()
+		template <int iNumChannels, bool bSimple> void greyscalePixels(unsigned char* pPixelsPARAM, size_t numPixelsPARAM, const Vector3f& vSensitivityPARAM)
+		{
+			size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+			SIMDInstructionSet instructionSet = simdGetInstructionSet();
+			const __m128 vRedSensitivity = _mm_set1_ps(vSensitivityPARAM.x);
+			const __m128 vGreenSensitivity = _mm_set1_ps(vSensitivityPARAM.y);
+			const __m128 vBlueSensitivity = _mm_set1_ps(vSensitivityPARAM.z);
+			if (4 == iNumChannels && SIMDInstructionSet::SCALAR != instructionSet)
+			{
+				if (SIMDInstructionSet::AVX2 == instructionSet)
+					i = greyscalePixels4AVX2<bSimple>(pPixelsPARAM, numPixelsPARAM, vSensitivityPARAM);
+				const __m128i vAlphaMask = _mm_set1_epi32(0xFF000000);
+				for (; i + 4 <= numPixelsPARAM; i += 4)
+				{
+					__m128i* pPixels = (__m128i*)(pPixelsPARAM + i * 4);
+					__m128i vPixels = _mm_loadu_si128(pPixels);
+					__m128i vGrey = getGreyPixels<bSimple>(vPixels, vRedSensitivity, vGreenSensitivity, vBlueSensitivity);
+					_mm_storeu_si128(pPixels, _mm_or_si128(vGrey, _mm_and_si128(vPixels, vAlphaMask)));
+				}
+			}
+			else if (3 == iNumChannels && SIMDInstructionSet::SCALAR != instructionSet)
+			{
+				// Each group of 4 pixels is spread out to 32 bits each and packed back together again afterwards
+				const __m128i vSpread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+				const __m128i vPack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+				__m128i vGroups[4];
+				for (; i + 16 <= numPixelsPARAM; i += 16)
+				{
+					unsigned char* pPixels = pPixelsPARAM + i * 3;
+					load16Pixels3(pPixels, vGroups);
+					for (int iGroup = 0; iGroup < 4; iGroup++)
+					{
+						__m128i vGrey = getGreyPixels<bSimple>(_mm_shuffle_epi8(vGroups[iGroup], vSpread), vRedSensitivity, vGreenSensitivity, vBlueSensitivity);
+						vGroups[iGroup] = _mm_shuffle_epi8(vGrey, vPack);
+					}
+					store16Pixels3(pPixels, vGroups);
+				}
+			}
+#endif
+			for (; i < numPixelsPARAM; i++)
+			{
+				unsigned char* pPixel = pPixelsPARAM + i * iNumChannels;
+				unsigned char cTmp;
+				if (bSimple)
+					cTmp = getGreyscaleSimple(pPixel);
+				else
+				{
+					float fTmp = float(pPixel[0]) * vSensitivityPARAM.x;
+					fTmp += float(pPixel[1]) * vSensitivityPARAM.y;
+					fTmp += float(pPixel[2]) * vSensitivityPARAM.z;
+					cTmp = (unsigned char)fTmp;
+				}
+				pPixel[0] = cTmp;
+				pPixel[1] = cTmp;
+				pPixel[2] = cTmp;
+			}
+		}
+
+		// Adding to a byte and clamping the result to 0 to 255 is the same as a saturating add, or a saturating subtract
+		// if the value is negative, so the bytes are done 16 or 32 at a time, the same as invertPixels(). For 4 channel
+		// images, zero is added to the alpha channel.
+		template <int iNumChannels> void adjustBrightnessOfPixels(unsigned char* pPixelsPARAM, size_t numPixelsPARAM, int valuePARAM)
+		{
+			size_t numBytes = numPixelsPARAM * iNumChannels;
+			size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+			SIMDInstructionSet instructionSet = simdGetInstructionSet();
+			if (SIMDInstructionSet::SCALAR != instructionSet)
+			{
+				int iAmount = valuePARAM;
+				clamp(iAmount, -255, 255);
+				unsigned char amount = (unsigned char)(iAmount < 0 ? -iAmount : iAmount);
+				unsigned char amounts[4] = { amount, amount, amount, amount };
+				if (4 == iNumChannels)
+					amounts[3] = 0;
+				int iAmounts;
+				memcpy(&iAmounts, amounts, 4);
+				if (SIMDInstructionSet::AVX2 == instructionSet)
+					i = addBytesSaturatedAVX2(pPixelsPARAM, numBytes, iAmounts, valuePARAM < 0);
+				const __m128i vAmounts = _mm_set1_epi32(iAmounts);
+				for (; i + 16 <= numBytes; i += 16)
+				{
+					__m128i* pBytes = (__m128i*)(pPixelsPARAM + i);
+					__m128i vBytes = _mm_loadu_si128(pBytes);
+					if (valuePARAM < 0)
+						_mm_storeu_si128(pBytes, _mm_subs_epu8(vBytes, vAmounts));
+					else
+						_mm_storeu_si128(pBytes, _mm_adds_epu8(vBytes, vAmounts));
+				}
+			}
+#endif
+			for (; i < numBytes; i++)
+			{
+				if (4 == iNumChannels && 3 == i % 4)
+					continue;
+				int iCol = (int)pPixelsPARAM[i] + valuePARAM;
+				clamp(iCol, 0, 255);
+				pPixelsPARAM[i] = (unsigned char)iCol;
+			}
+		}
+
+		// There are only 256 possible values for each component, so pTablePARAM holds the result for each of them
+		template <int iNumChannels> void adjustContrastOfPixels(unsigned char* pPixelsPARAM, size_t numPixelsPARAM, const unsigned char* pTablePARAM)
+		{
+			for (size_t i = 0; i < numPixelsPARAM; i++)
+			{
+				unsigned char* pPixel = pPixelsPARAM + i * iNumChannels;
+				pPixel[0] = pTablePARAM[pPixel[0]];
+				pPixel[1] = pTablePARAM[pPixel[1]];
+				pPixel[2] = pTablePARAM[pPixel[2]];
+			}
+		}
+
+		// Copies the RGB components of each of the 4 channel pixels at pPixelsPARAM to the 3 channel pixels at pPixelsOutPARAM
+		void removeAlphaOfPixels(const unsigned char* pPixelsPARAM, size_t numPixelsPARAM, unsigned char* pPixelsOutPARAM)
+		{
+			size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+			if (SIMDInstructionSet::SCALAR != simdGetInstructionSet())
+			{
+				// The RGB components of each 4 pixels are packed into the lowest 12 bytes of a group
+				const __m128i vPack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+				__m128i vGroups[4];
+				for (; i + 16 <= numPixelsPARAM; i += 16)
+				{
+					for (int iGroup = 0; iGroup < 4; iGroup++)
+						vGroups[iGroup] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pPixelsPARAM + (i + iGroup * 4) * 4)), vPack);
+					store16Pixels3(pPixelsOutPARAM + i * 3, vGroups);
+				}
+			}
+#endif
+			for (; i < numPixelsPARAM; i++)
+			{
+				pPixelsOutPARAM[i * 3] = pPixelsPARAM[i * 4];			// Red
+				pPixelsOutPARAM[i * 3 + 1] = pPixelsPARAM[i * 4 + 1];	// Green
+				pPixelsOutPARAM[i * 3 + 2] = pPixelsPARAM[i * 4 + 2];	// Blue
+			}
+		}
+
+		// Returns whether the given pixel's RGB components are the given colour
+		inline bool isPixelColour(const unsigned char* pPixelPARAM, unsigned char redPARAM, unsigned char greenPARAM, unsigned char bluePARAM)
+		{
+			return pPixelPARAM[0] == redPARAM && pPixelPARAM[1] == greenPARAM && pPixelPARAM[2] == bluePARAM;
+		}
+
+		// Used by Image2D::edgeDetect()
+		// Returns whether the given pixel, which mustn't be on the edge of the image, isn't the given background colour
+		// and is next to a pixel which is, including diagonally.
+		template <int iNumChannels> bool isPixelEdge(const unsigned char* pPixelPARAM, size_t rowSizePARAM, unsigned char redPARAM, unsigned char greenPARAM, unsigned char bluePARAM)
+		{
+			if (isPixelColour(pPixelPARAM, redPARAM, greenPARAM, bluePARAM))
+				return false;
+			const unsigned char* pRowAbove = pPixelPARAM - rowSizePARAM;
+			const unsigned char* pRowBelow = pPixelPARAM + rowSizePARAM;
+			for (int iOffset = -iNumChannels; iOffset <= iNumChannels; iOffset += iNumChannels)
+			{
+				if (isPixelColour(pRowAbove + iOffset, redPARAM, greenPARAM, bluePARAM))
+					return true;
+				if (isPixelColour(pRowBelow + iOffset, redPARAM, greenPARAM, bluePARAM))
+					return true;
+			}
+			return isPixelColour(pPixelPARAM - iNumChannels, redPARAM, greenPARAM, bluePARAM) || isPixelColour(pPixelPARAM + iNumChannels, redPARAM, greenPARAM, bluePARAM);
+		}
+
+		template <int iNumChannels> void edgeDetectRows(const unsigned char* pDataPARAM, int widthPARAM, int heightPARAM, int firstRowPARAM, int numRowsPARAM, unsigned char* pDataOutPARAM, unsigned char redPARAM, unsigned char greenPARAM, unsigned char bluePARAM)
+		{
+			size_t rowSize = size_t(widthPARAM) * iNumChannels;
+			for (int iY = firstRowPARAM; iY < firstRowPARAM + numRowsPARAM; iY++)
+			{
+				// Pixels on the edge of the image are never edges
+				if (iY == 0 || iY >= heightPARAM - 1)
+					continue;
+				const unsigned char* pRow = pDataPARAM + size_t(iY) * rowSize;
+				unsigned char* pRowOut = pDataOutPARAM + size_t(iY) * widthPARAM * 4;
+				for (int iX = 1; iX < widthPARAM - 1; iX++)
+				{
+					if (isPixelEdge<iNumChannels>(pRow + size_t(iX) * iNumChannels, rowSize, redPARAM, greenPARAM, bluePARAM))
+						memset(pRowOut + size_t(iX) * 4, 255, 4);
+				}
+			}
+		}
+
+		// The functions below are the filters which stb_image_resize2 doesn't have itself, as kernel and support callbacks.
+		// stb_image_resize2 scales them itself when reducing the size, so they're all written for a scale of 1.
+
+		// Number of pixels either side of the centre which LANCZOS3 and KAISER cover
+		const float kfResampleFilterRadius = 3.0f;
+
+		// Alpha of the Kaiser window. Higher values reduce ringing, but blur more.
+		const double kdKaiserAlpha = 4.0;
+
+		// Returns sin(pi * x) / (pi * x), which is 1 when x is 0
+		float sinc(float xPARAM)
+		{
+			if (fabsf(xPARAM) < 0.0001f)
+				return 1.0f;
+			float fPiX = kfPi * xPARAM;
+			return sinf(fPiX) / fPiX;
+		}
+
+		// Returns the zeroth order modified Bessel function of the first kind, which the Kaiser window is made from
+		double besselI0(double xPARAM)
+		{
+			double dSum = 1.0;
+			double dTerm = 1.0;
+			double dQuarterXSquared = xPARAM * xPARAM * 0.25;
+			for (int k = 1; k < 50; k++)
+			{
+				dTerm *= dQuarterXSquared / double(k * k);
+				dSum += dTerm;
+				if (dTerm < dSum * 1e-12)
+					break;
+			}
+			return dSum;
+		}
+
+		float lanczos3Kernel(float xPARAM, float /*scalePARAM*/, void* /*pUserDataPARAM*/)
+		{
+			xPARAM = fabsf(xPARAM);
+			if (xPARAM >= kfResampleFilterRadius)
+				return 0.0f;
+			return sinc(xPARAM) * sinc(xPARAM / kfResampleFilterRadius);
+		}
+
+		float kaiserKernel(float xPARAM, float /*scalePARAM*/, void* /*pUserDataPARAM*/)
+		{
+			xPARAM = fabsf(xPARAM);
+			if (xPARAM >= kfResampleFilterRadius)
+				return 0.0f;
+			double dT = double(xPARAM) / double(kfResampleFilterRadius);
+			return sinc(xPARAM) * float(besselI0(kdKaiserAlpha * sqrt(1.0 - dT * dT)) / besselI0(kdKaiserAlpha));
+		}
+
+		float resampleFilterSupport(float /*scalePARAM*/, void* /*pUserDataPARAM*/)
+		{
+			return kfResampleFilterRadius;
+		}
+
+		// Resizes the pixels at pPixelsPARAM to the new dimensions, writing them to pPixelsOutPARAM, see Image2D::resize().
+		// Both sets of pixels have the given layout of channels and are stored as the given type.
+		// stb_image_resize2 splits the new pixels into bands, which are shared between up to numThreadsPARAM threads,
+		// each getting at least minPixelsPerThreadPARAM of the new pixels.
+		// Returns false if stb_image_resize2 fails.
+		bool resamplePixels(const void* pPixelsPARAM, int widthPARAM, int heightPARAM, stbir_pixel_layout layoutPARAM, stbir_datatype datatypePARAM, void* pPixelsOutPARAM, int widthOutPARAM, int heightOutPARAM, Image2D::ResampleFilter filterPARAM, unsigned int numThreadsPARAM, size_t minPixelsPerThreadPARAM)
+		{
+			STBIR_RESIZE resize;
+			stbir_resize_init(&resize, pPixelsPARAM, widthPARAM, heightPARAM, 0, pPixelsOutPARAM, widthOutPARAM, heightOutPARAM, 0, layoutPARAM, datatypePARAM);
+			switch (filterPARAM)
+			{
+			case Image2D::BOX:
+				stbir_set_filters(&resize, STBIR_FILTER_BOX, STBIR_FILTER_BOX);
+				break;
+			case Image2D::BILINEAR:
+				stbir_set_filters(&resize, STBIR_FILTER_TRIANGLE, STBIR_FILTER_TRIANGLE);
+				break;
+			case Image2D::LANCZOS3:
+				stbir_set_filter_callbacks(&resize, lanczos3Kernel, resampleFilterSupport, lanczos3Kernel, resampleFilterSupport);
+				break;
+			default:
+				stbir_set_filter_callbacks(&resize, kaiserKernel, resampleFilterSupport, kaiserKernel, resampleFilterSupport);
+			}
+
+			size_t maxThreads = numThreadsPARAM;
+			if (0 == maxThreads)
+				maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+			maxThreads = std::min(maxThreads, std::max(size_t(widthOutPARAM) * heightOutPARAM / minPixelsPerThreadPARAM, (size_t)1));
+			int numSplits = stbir_build_samplers_with_splits(&resize, int(maxThreads));
+			if (!numSplits)
+				return false;
+
+			// There are never more splits than threads, so each thread does one of them
+			std::vector<int> splitResults(numSplits, 1);
+			runInChunks(size_t(numSplits), (unsigned int)maxThreads, 1, 1, [&](size_t firstSplit, size_t splitCount)
+				{
+					splitResults[firstSplit] = stbir_resize_extended_split(&resize, int(firstSplit), int(splitCount));
+				});
+			stbir_free_samplers(&resize);
+			for (size_t i = 0; i < splitResults.size(); i++)
+			{
+				if (!splitResults[i])
+					return false;
+			}
+			return true;
+		}
+
+		// Fills tablePARAM with the linear value, from 0 to 1, of each 8 bit component value, see convertPixelsToLinear()
+		void computeToLinearTable(bool bSRGBPARAM, float tablePARAM[256])
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float fValue = float(i) / 255.0f;
+				if (bSRGBPARAM)
+					fValue = fValue <= 0.04045f ? fValue / 12.92f : powf((fValue + 0.055f) / 1.055f, 2.4f);
+				tablePARAM[i] = fValue;
+			}
+		}
+
+		// Converts the 8 bit pixels at pPixelsPARAM into floats at pPixelsOutPARAM, using the table computed by
+		// computeToLinearTable() for the RGB components, with the RGB components multiplied by alpha for 4 channel pixels.
+		// These are what generateMipChain() filters each level from, see convertPixelsFromLinear() for the other way.
+		void convertPixelsToLinear(const unsigned char* pPixelsPARAM, size_t numPixelsPARAM, int numChannelsPARAM, const float tablePARAM[256], float* pPixelsOutPARAM)
+		{
+			for (size_t i = 0; i < numPixelsPARAM; i++)
+			{
+				const unsigned char* pPixel = pPixelsPARAM + i * numChannelsPARAM;
+				float* pPixelOut = pPixelsOutPARAM + i * numChannelsPARAM;
+				float fAlpha = 1.0f;
+				if (4 == numChannelsPARAM)
+				{
+					fAlpha = float(pPixel[3]) / 255.0f;
+					pPixelOut[3] = fAlpha;
+				}
+				for (int j = 0; j < 3; j++)
+					pPixelOut[j] = tablePARAM[pPixel[j]] * fAlpha;
+			}
+		}
+
+		// Converts a linear value to an 8 bit component value, to the sRGB curve if bSRGBPARAM is true
+		unsigned char linearToByte(float fValuePARAM, bool bSRGBPARAM)
+		{
+			clamp(fValuePARAM, 0.0f, 1.0f);
+			if (bSRGBPARAM)
+				fValuePARAM = fValuePARAM <= 0.0031308f ? fValuePARAM * 12.92f : 1.055f * powf(fValuePARAM, 1.0f / 2.4f) - 0.055f;
+			return (unsigned char)(fValuePARAM * 255.0f + 0.5f);
+		}
+
+		// Converts the floats made by convertPixelsToLinear() back into 8 bit pixels, dividing the RGB components of
+		// 4 channel pixels by alpha again. The filters may overshoot, so the values are clamped first.
+		void convertPixelsFromLinear(const float* pPixelsPARAM, size_t numPixelsPARAM, int numChannelsPARAM, bool bSRGBPARAM, unsigned char* pPixelsOutPARAM)
+		{
+			for (size_t i = 0; i < numPixelsPARAM; i++)
+			{
+				const float* pPixel = pPixelsPARAM + i * numChannelsPARAM;
+				unsigned char* pPixelOut = pPixelsOutPARAM + i * numChannelsPARAM;
+				float fOneOverAlpha = 1.0f;
+				if (4 == numChannelsPARAM)
+				{
+					float fAlpha = pPixel[3];
+					clamp(fAlpha, 0.0f, 1.0f);
+					fOneOverAlpha = fAlpha > 0.0f ? 1.0f / fAlpha : 0.0f;
+					pPixelOut[3] = linearToByte(fAlpha, false);
+				}
+				for (int j = 0; j < 3; j++)
+					pPixelOut[j] = linearToByte(pPixel[j] * fOneOverAlpha, bSRGBPARAM);
+			}
+		}
+	}
+
 	Image2D::Image2D()
 	{
 		data = 0;
@@ -48,18 +667,25 @@ namespace DC
 
 	void Image2D::createBlank(unsigned int widthPARAM, unsigned int heightPARAM, unsigned short numberOfChannelsPARAM)
 	{
-		free();
 		ErrorIfTrue(widthPARAM < 1, L"Image2D::createBlank() failed as given width < 1.");
 		ErrorIfTrue(heightPARAM < 1, L"Image2D::createBlank() failed as given height < 1.");
 		ErrorIfTrue(numberOfChannelsPARAM < 3, L"Image2D::createBlank() failed as given number of channels < 1. (Only 3 or 4 is valid)");
 		ErrorIfTrue(numberOfChannelsPARAM > 4, L"Image2D::createBlank() failed as given number of channels > 4. (Only 3 or 4 is valid)");
 
+		// If the image already holds the same amount of data, it's memory is reused rather than freed and allocated again,
+		// as for large images which are created over and over, such as the output of normalmap(), that takes far longer
+		// than the zeroing below.
+		unsigned int iNewDataSize = widthPARAM * heightPARAM * numberOfChannelsPARAM;
+		if (!data || dataSize != iNewDataSize)
+		{
+			free();
+			data = new unsigned char[iNewDataSize];
+			ErrorIfTrue(!data, L"Image2D::createBlank() failed to allocate memory.");
+		}
 		width = widthPARAM;
 		height = heightPARAM;
 		numberOfChannels = numberOfChannelsPARAM;
-		dataSize = width * height * numberOfChannels;
-		data = new unsigned char[dataSize];
-		ErrorIfTrue(!data, L"Image2D::createBlank() failed to allocate memory.");
+		dataSize = iNewDataSize;
 
 		// Zero out the new memory all to zero
 		for (unsigned int i = 0; i < dataSize; ++i)
@@ -245,21 +871,19 @@ namespace DC
 		return true;
 	}
 
-	void Image2D::swapRedAndBlue(void)
+	void Image2D::swapRedAndBlue(unsigned int numThreadsPARAM)
 	{
 		ErrorIfTrue(!data, L"Image2D::swapRedAndBlue() failed. Image2D not yet created.");
 
-		unsigned int i = 0;
-		int i2;
-		unsigned char chTemp;
-		while (i < dataSize)
-		{
-			i2 = i+2;
-			chTemp = data[i];
-			data[i] = data[i2];
-			data[i2] = chTemp;
-			i += numberOfChannels;
-		}
+		parallelFor([&](int firstRow, int numRows)
+			{
+				unsigned char* pPixels = data + size_t(firstRow) * width * numberOfChannels;
+				size_t numPixels = size_t(numRows) * width;
+				if (4 == numberOfChannels)
+					swapRedAndBlueOfPixels<4>(pPixels, numPixels);
+				else
+					swapRedAndBlueOfPixels<3>(pPixels, numPixels);
+			}, numThreadsPARAM);
 	}
 
 	void Image2D::flipVertically(void)
@@ -293,105 +917,69 @@ namespace DC
 		data = pNewImageStartAddress;	// Make image data point to the new data
 	}
 
-	void Image2D::invert(bool invertColour, bool invertAlpha)
+	void Image2D::invert(bool invertColour, bool invertAlpha, unsigned int numThreadsPARAM)
 	{
 		ErrorIfTrue(!data, L"Image2D::invert() failed. Image2D not yet created.");
 
-		unsigned int i = 0;
-		int iIndex;
-		if (invertColour)
-		{
-			while (i < dataSize)
+		parallelFor([&](int firstRow, int numRows)
 			{
-				iIndex = i;
-				data[iIndex] = 255 - data[iIndex]; ++iIndex;
-				data[iIndex] = 255 - data[iIndex]; ++iIndex;
-				data[iIndex] = 255 - data[iIndex];
-				i += numberOfChannels;
-			}
-		}
-
-		if (numberOfChannels == 4 && invertAlpha)
-		{
-			i = 3;
-			while (i < dataSize)
-			{
-				data[i] = 255 - data[i];
-				i += numberOfChannels;
-			}
-		}
+				unsigned char* pPixels = data + size_t(firstRow) * width * numberOfChannels;
+				size_t numPixels = size_t(numRows) * width;
+				if (4 == numberOfChannels)
+					invertPixels<4>(pPixels, numPixels, invertColour, invertAlpha);
+				else
+					invertPixels<3>(pPixels, numPixels, invertColour, false);
+			}, numThreadsPARAM);
 	}
 
-	void Image2D::greyscaleSimple(void)
+	void Image2D::greyscaleSimple(unsigned int numThreadsPARAM)
 	{
 		ErrorIfTrue(!data, L"Image2D::greyscaleSimple() failed. Image2D not yet created.");
 
-		unsigned int i = 0;
-		float f1Over3 = 1.0f / 3.0f;
-		float fTmp;
-		unsigned char cTmp;
-		while (i < dataSize)
-		{
-			fTmp = float(data[i]);
-			fTmp += float(data[i+1]);
-			fTmp += float(data[i+2]);
-			fTmp *= f1Over3;
-			cTmp = (unsigned char)fTmp;
-			data[i] = cTmp;
-			data[i+1] = cTmp;
-			data[i+2] = cTmp;
-			i += numberOfChannels;
-		}
+		parallelFor([&](int firstRow, int numRows)
+			{
+				unsigned char* pPixels = data + size_t(firstRow) * width * numberOfChannels;
+				size_t numPixels = size_t(numRows) * width;
+				if (4 == numberOfChannels)
+					greyscalePixels<4, true>(pPixels, numPixels, Vector3f());
+				else
+					greyscalePixels<3, true>(pPixels, numPixels, Vector3f());
+			}, numThreadsPARAM);
 	}
 
-
-	void Image2D::greyscale(float redSensitivity, float greenSensitivity, float blueSensitivity)
+	void Image2D::greyscale(float redSensitivity, float greenSensitivity, float blueSensitivity, unsigned int numThreadsPARAM)
 	{
 		ErrorIfTrue(!data, L"Image2D::greyscale() failed. Image2D not yet created.");
 
 		Vector3f vCol(redSensitivity, greenSensitivity, blueSensitivity);
 
-		unsigned int i = 0;
-		float fTmp;
-		unsigned char cTmp;
-		while (i < dataSize)
-		{
-			fTmp = 0.0f;
-			fTmp = float(data[i]) * vCol.x;
-			fTmp += float(data[i+1]) * vCol.y;
-			fTmp += float(data[i+2]) * vCol.z;
-			cTmp = (unsigned char)fTmp;
-			data[i] = cTmp;
-			data[i+1] = cTmp;
-			data[i+2] = cTmp;
-			i += numberOfChannels;
-		}
+		parallelFor([&](int firstRow, int numRows)
+			{
+				unsigned char* pPixels = data + size_t(firstRow) * width * numberOfChannels;
+				size_t numPixels = size_t(numRows) * width;
+				if (4 == numberOfChannels)
+					greyscalePixels<4, false>(pPixels, numPixels, vCol);
+				else
+					greyscalePixels<3, false>(pPixels, numPixels, vCol);
+			}, numThreadsPARAM);
 	}
 
-	void Image2D::adjustBrightness(int value)
+	void Image2D::adjustBrightness(int value, unsigned int numThreadsPARAM)
 	{
 		ErrorIfTrue(!data, L"Image2D::adjustBrightness() failed. Image2D not yet created.");
 
-		unsigned int i = 0;
-		int iCol;
-		while (i < dataSize)
-		{
-			iCol = (int)data[i] + value;
-			clamp(iCol, 0, 255);
-			data[i] = unsigned char(iCol);
-
-			iCol = (int)data[i+1] + value;
-			clamp(iCol, 0, 255);
-			data[i+1] = unsigned char(iCol);
-
-			iCol = (int)data[i+2] + value;
-			clamp(iCol, 0, 255);
-			data[i+2] = unsigned char(iCol);
-			i += numberOfChannels;
-		}
+		parallelFor([&](int firstRow, int numRows)
+			{
+				unsigned char* pPixels = data + size_t(firstRow) * width * numberOfChannels;
+				size_t numPixels = size_t(numRows) * width;
+				if (4 == numberOfChannels)
+					adjustBrightnessOfPixels<4>(pPixels, numPixels, value);
+				else
+					adjustBrightnessOfPixels<3>(pPixels, numPixels, value);
+			}, numThreadsPARAM);
 	}
 
-	void Image2D::adjustContrast(int value)
+	void Image2D::adjustContrast(int value, unsigned int numThreadsPARAM)
 	{
 		ErrorIfTrue(!data, L"Image2D::adjustContrast() failed. Image2D not yet created.");
 
@@ -400,39 +988,29 @@ namespace DC
 		double d1Over255 = 1.0 / 255.0;
 		double dContrast = (100.0 + double(value)) * 0.01; // 0 and 2
 		dContrast *= dContrast;	// 0 and 4
-		unsigned int i = 0;
-		int iIndex;
-		while (i < dataSize)
-		{
-			iIndex = i;
-			dPixel = double(data[iIndex]) * d1Over255;
-			dPixel -= 0.5;
-			dPixel *= dContrast;
-			dPixel += 0.5;
-			dPixel *= 255;
-			clamp(dPixel, 0.0, 255.0);
-			data[iIndex] = unsigned char(dPixel);
-			++iIndex;
 
-			dPixel = double(data[iIndex]) * d1Over255;
-			dPixel -= 0.5;
-			dPixel *= dContrast;
-			dPixel += 0.5;
-			dPixel *= 255;
-			clamp(dPixel, 0.0, 255.0);
-			data[iIndex] = unsigned char(dPixel);
-			++iIndex;
-
-			dPixel = double(data[iIndex]) * d1Over255;
+		// Compute the new value of each of the 256 possible values
+		unsigned char table[256];
+		for (int i = 0; i < 256; i++)
+		{
+			dPixel = double(i) * d1Over255;
 			dPixel -= 0.5;
 			dPixel *= dContrast;
 			dPixel += 0.5;
 			dPixel *= 255;
 			clamp(dPixel, 0.0, 255.0);
-			data[iIndex] = unsigned char(dPixel);
-
-			i += numberOfChannels;
+			table[i] = (unsigned char)dPixel;
 		}
+
+		parallelFor([&](int firstRow, int numRows)
+			{
+				unsigned char* pPixels = data + size_t(firstRow) * width * numberOfChannels;
+				size_t numPixels = size_t(numRows) * width;
+				if (4 == numberOfChannels)
+					adjustContrastOfPixels<4>(pPixels, numPixels, table);
+				else
+					adjustContrastOfPixels<3>(pPixels, numPixels, table);
+			}, numThreadsPARAM);
 	}
 
 	void Image2D::copyTo(Image2D& destinationImage) const
@@ -582,52 +1160,43 @@ namespace DC
 		}
 	}
 
-	void Image2D::edgeDetect(Image2D& outputImage, unsigned char red, unsigned char green, unsigned char blue)
+	void Image2D::edgeDetect(Image2D& outputImage, unsigned char red, unsigned char green, unsigned char blue, unsigned int numThreadsPARAM)
 	{
 		ErrorIfTrue(!data, L"Image2D::edgeDetect() failed. Image2D data doesn't exist.");
 		ErrorIfTrue(numberOfChannels < 3, L"Image2D::edgeDetect() failed. Some image data exists, but doesn't have enough colour channels.");
 
+		// The output image is created with all pixels set to zero, so only the edges need setting
 		outputImage.createBlank(width, height, 4);
-		int iX = 0;
-		int iY = 0;
-		while (iX < (int)width)
-		{
-			while (iY < (int)height)
+		unsigned char* pDataOut = outputImage.data;
+		parallelFor([&](int firstRow, int numRows)
 			{
-				if (_isPixelEdge(iX, iY, red, green, blue))
-					outputImage.setPixel(iX, iY, 255, 255, 255, 255);
+				if (4 == numberOfChannels)
+					edgeDetectRows<4>(data, width, height, firstRow, numRows, pDataOut, red, green, blue);
 				else
-					outputImage.setPixel(iX, iY, 0, 0, 0, 0);
-				++iY;
-			}
-			++iX;
-			iY = 0;
-		}
+					edgeDetectRows<3>(data, width, height, firstRow, numRows, pDataOut, red, green, blue);
+			}, numThreadsPARAM);
 	}
 
-	void Image2D::removeAlphaChannel(void)
+	void Image2D::removeAlphaChannel(unsigned int numThreadsPARAM)
 	{
 		ErrorIfTrue(!data, L"Image2D::removeAlphaChannel() failed. Image2D data doesn't exist.");
 		ErrorIfTrue(numberOfChannels != 4, L"Image2D::removeAlphaChannel() failed. Some image data exists, but the alpha data doesn't exist (Image2D doesn't hold 4 channels)");
 
-		// Copy this image to a new tmp image
-		Image2D old;
-		copyTo(old);
-
-		// Recreate this one, but with 3 channels
-		createBlank(old.getWidth(), old.getHeight(), 3);
-
-		// Copy RGB from old to this...
-		unsigned int iIndex = 0;
-		int iIndexOld = 0;
-		while (iIndex < dataSize)
-		{
-			data[iIndex] = old.data[iIndexOld];		// Red
-			data[iIndex+1] = old.data[iIndexOld+1];	// Green
-			data[iIndex+2] = old.data[iIndexOld+2];	// Blue
-			iIndex+=3;
-			iIndexOld+=4;
-		}
+		// Copy RGB from this image into the new data...
+		unsigned int iNewDataSize = width * height * 3;
+		unsigned char* pNewData = new unsigned char[iNewDataSize];
+		ErrorIfTrue(!pNewData, L"Image2D::removeAlphaChannel() failed to allocate memory.");
+		parallelFor([&](int firstRow, int numRows)
+			{
+				size_t firstPixel = size_t(firstRow) * width;
+				removeAlphaOfPixels(data + firstPixel * 4, size_t(numRows) * width, pNewData + firstPixel * 3);
+			}, numThreadsPARAM);
+
+		// ...and replace it
+		delete[] data;
+		data = pNewData;
+		dataSize = iNewDataSize;
+		numberOfChannels = 3;
 	}
 
 	void Image2D::copyAlphaChannelToRGB(void)
@@ -645,68 +1214,159 @@ namespace DC
 		}
 	}
 
-	void Image2D::normalmap(Image2D& outputImage, float scale) const
+	void Image2D::resize(unsigned int newWidthPARAM, unsigned int newHeightPARAM, ResampleFilter filterPARAM, bool sRGBPARAM, unsigned int numThreadsPARAM)
+	{
+		ErrorIfTrue(!data, L"Image2D::resize() failed. Image2D not yet created.");
+		ErrorIfTrue(!newWidthPARAM || !newHeightPARAM, L"Image2D::resize() failed. The new dimensions must be at least 1.");
+
+		// The dimensions are given to stb_image_resize2 as ints and the size of the data has to fit into dataSize
+		size_t newDataSize = size_t(newWidthPARAM) * newHeightPARAM * numberOfChannels;
+		ErrorIfTrue(newWidthPARAM > (unsigned int)kMaxInt || newHeightPARAM > (unsigned int)kMaxInt || newDataSize > (std::numeric_limits<unsigned int>::max)(),
+			L"Image2D::resize() failed. The new dimensions are too large.");
+		unsigned char* pNewData = new unsigned char[newDataSize];
+		ErrorIfTrue(!pNewData, L"Image2D::resize() failed to allocate memory.");
+		bool bResized = resamplePixels(data, width, height, 4 == numberOfChannels ? STBIR_RGBA : STBIR_RGB, sRGBPARAM ? STBIR_TYPE_UINT8_SRGB : STBIR_TYPE_UINT8,
+			pNewData, int(newWidthPARAM), int(newHeightPARAM), filterPARAM, numThreadsPARAM, kMinPixelsPerThread);
+		if (!bResized)
+			delete[] pNewData;
+		ErrorIfTrue(!bResized, L"Image2D::resize() failed. stb_image_resize2 failed to resize the image.");
+
+		delete[] data;
+		data = pNewData;
+		dataSize = (unsigned int)newDataSize;
+		width = int(newWidthPARAM);
+		height = int(newHeightPARAM);
+	}
+
+	void Image2D::generateMipChain(std::vector<unsigned char>& mipDataPARAM, std::vector<MipLevel>& mipLevelsPARAM, ResampleFilter filterPARAM, bool sRGBPARAM, unsigned int numThreadsPARAM) const
+	{
+		ErrorIfTrue(!data, L"Image2D::generateMipChain() failed. Image2D not yet created.");
+
+		// Work out the dimensions and position of each level...
+		mipLevelsPARAM.clear();
+		MipLevel level;
+		level.width = (unsigned int)width;
+		level.height = (unsigned int)height;
+		level.offset = 0;
+		while (true)
+		{
+			level.size = size_t(level.width) * level.height * numberOfChannels;
+			mipLevelsPARAM.push_back(level);
+			if (1 == level.width && 1 == level.height)
+				break;
+			level.offset += level.size;
+			level.width = std::max(level.width / 2, 1u);
+			level.height = std::max(level.height / 2, 1u);
+		}
+		mipDataPARAM.resize(mipLevelsPARAM.back().offset + mipLevelsPARAM.back().size);
+
+		// ...copy this image into the first...
+		memcpy(mipDataPARAM.data(), data, mipLevelsPARAM[0].size);
+
+		// ...and filter each of the others from the one before it.
+		// The levels are filtered as linear floats, with alpha premultiplied, rather than from the 8 bit level before
+		// each of them, as rounding each level to 8 bits, and to the sRGB curve, before filtering the next from it
+		// adds up the error of every level, so the smallest levels drift. Each level is only rounded to 8 bits once,
+		// when it's written into mipData, and only the two levels being filtered between are kept as floats.
+		if (1 == mipLevelsPARAM.size())
+			return;
+		float toLinear[256];
+		computeToLinearTable(sRGBPARAM, toLinear);
+		std::vector<float> previousLevel(mipLevelsPARAM[0].size);
+		runInChunks(size_t(width) * height, numThreadsPARAM, kMinPixelsPerThread, 1, [&](size_t firstPixel, size_t numPixels)
+			{
+				convertPixelsToLinear(data + firstPixel * numberOfChannels, numPixels, numberOfChannels, toLinear, previousLevel.data() + firstPixel * numberOfChannels);
+			});
+		std::vector<float> currentLevel;
+		stbir_pixel_layout layout = 4 == numberOfChannels ? STBIR_RGBA_PM : STBIR_RGB;
+		for (size_t i = 1; i < mipLevelsPARAM.size(); i++)
+		{
+			const MipLevel& previous = mipLevelsPARAM[i - 1];
+			const MipLevel& current = mipLevelsPARAM[i];
+			currentLevel.resize(current.size);
+			bool bResized = resamplePixels(previousLevel.data(), int(previous.width), int(previous.height), layout, STBIR_TYPE_FLOAT,
+				currentLevel.data(), int(current.width), int(current.height), filterPARAM, numThreadsPARAM, kMinPixelsPerThread);
+			ErrorIfTrue(!bResized, L"Image2D::generateMipChain() failed. stb_image_resize2 failed to resize a level.");
+			runInChunks(size_t(current.width) * current.height, numThreadsPARAM, kMinPixelsPerThread, 1, [&](size_t firstPixel, size_t numPixels)
+				{
+					convertPixelsFromLinear(currentLevel.data() + firstPixel * numberOfChannels, numPixels, numberOfChannels, sRGBPARAM, &mipDataPARAM[current.offset + firstPixel * numberOfChannels]);
+				});
+			previousLevel.swap(currentLevel);
+		}
+	}
+
+	void Image2D::normalmap(Image2D& outputImage, float scale, unsigned int numThreadsPARAM) const
 	{
 		ErrorIfTrue(!data, L"Image2D::normalmap() failed. Image2D data doesn't exist.");
 
 		clamp(scale, 0.0f, 1.0f);
 
-		// Copy this image into a new one so this is left unaffected.
-		// This uses the copyToAddBorder() method which adds a border and copies the edge pixels to the new pixels in the border.
-		// This makes it so we don't have to mess around with edge cases.
-		Image2D imageGreyscale;
-		copyToAddBorder(imageGreyscale);
-
-		// Greyscale the image
-		imageGreyscale.greyscaleSimple();
+		// Compute the height of each pixel, which is the same value greyscaleSimple() would set the pixel's components to.
+		// This image is left unaffected.
+		std::vector<unsigned char> heights(size_t(width) * height);
+		parallelFor([&](int firstRow, int numRows)
+			{
+				const unsigned char* pPixel = data + size_t(firstRow) * width * numberOfChannels;
+				unsigned char* pHeight = heights.data() + size_t(firstRow) * width;
+				for (size_t i = 0; i < size_t(numRows) * width; i++)
+				{
+					pHeight[i] = getGreyscaleSimple(pPixel);
+					pPixel += numberOfChannels;
+				}
+			}, numThreadsPARAM);
 
 		// Create output image with the same size as this one
 		outputImage.createBlank(width, height, 3);
 
-		// Now loop through greyscale image, computing each normal and storing in the output image.
-		unsigned char r[3], g[3], b[3], a;
-		float fX, fY, fZ;
-		float fLength;
-		for (int y = 0; y < height; y++)
+		// Each normal only depends upon the differences between a pixel's height and the heights to it's left and above it,
+		// each of which is between -255 and 255, so for images with more pixels than there are pairs of differences, every
+		// possible normal is computed once up front and each pixel looks it's normal up, rather than computing it again.
+		const int kNumDeltas = 511;
+		std::vector<unsigned char> normals;
+		if (size_t(width) * height > size_t(kNumDeltas) * kNumDeltas)
 		{
-			for (int ix = 0; ix < width; ix++)
-			{
-				// we add +1 to imageGreyscale pixel positions as it has a border
-
-				// Get height values of centre and surrounding pixels
-				imageGreyscale.getPixel(ix + 1, y + 1, r[0], g[0], b[0], a);	// Current pixel
-				imageGreyscale.getPixel(ix, y + 1, r[1], g[1], b[1], a);		// Left pixel
-				imageGreyscale.getPixel(ix + 1, y + 2, r[2], g[2], b[2], a);	// Above pixel
-				
-				fX = float(r[1] - r[0]) / 255.0f;	// Convert to -1.0f to 1.0f
-				fY = float(r[2] - r[0]) / 255.0f;	// ....
-				fZ = scale;
-
-				// Compute length of vector and normalize
-				fLength = sqrt((fX * fX) + (fY * fY) + (fZ * fZ));
-				if (areFloatsEqual(fLength, 0.0f))	// If length is nearly zero, just set as up vector
+			normals.resize(size_t(kNumDeltas) * kNumDeltas * 3);
+			runInChunks(size_t(kNumDeltas), numThreadsPARAM, 1, 1, [&](size_t firstDelta, size_t numDeltas)
 				{
-					fX = 0.0f;
-					fY = 0.0f;
-					fZ = scale;
-				}
-				else
+					for (size_t iDeltaAbove = firstDelta; iDeltaAbove < firstDelta + numDeltas; iDeltaAbove++)
+					{
+						for (int iDeltaLeft = 0; iDeltaLeft < kNumDeltas; iDeltaLeft++)
+							computeNormal(iDeltaLeft - 255, int(iDeltaAbove) - 255, scale, &normals[(iDeltaAbove * kNumDeltas + iDeltaLeft) * 3]);
+					}
+				});
+		}
+
+		// Now loop through the heights, computing each normal and storing in the output image.
+		// The pixels beyond the left and bottom edges of the image are treated as being the same as the edge pixels,
+		// so we don't have to mess around with edge cases.
+		unsigned char* pDataOut = outputImage.data;
+		parallelFor([&](int firstRow, int numRows)
+			{
+				for (int y = firstRow; y < firstRow + numRows; y++)
 				{
-					fX = fX / fLength;
-					fY = fY / fLength;
-					fZ = fZ / fLength;
+					const unsigned char* pHeights = heights.data() + size_t(y) * width;
+					const unsigned char* pHeightsAbove = pHeights;
+					if (y < height - 1)
+						pHeightsAbove += width;
+					unsigned char* pPixelOut = pDataOut + size_t(y) * width * 3;
+					for (int ix = 0; ix < width; ix++)
+					{
+						int iHeight = pHeights[ix];							// Current pixel
+						int iHeightLeft = pHeights[ix > 0 ? ix - 1 : 0];	// Left pixel
+						int iHeightAbove = pHeightsAbove[ix];				// Above pixel
+						if (normals.empty())
+							computeNormal(iHeightLeft - iHeight, iHeightAbove - iHeight, scale, pPixelOut);
+						else
+						{
+							const unsigned char* pNormal = &normals[(size_t(iHeightAbove - iHeight + 255) * kNumDeltas + size_t(iHeightLeft - iHeight + 255)) * 3];
+							pPixelOut[0] = pNormal[0];
+							pPixelOut[1] = pNormal[1];
+							pPixelOut[2] = pNormal[2];
+						}
+						pPixelOut += 3;
+					}
 				}
-
-				// Convert from -1, +1 to 0, 255
-				fX += 1.0f;	fX *= 127.0f;
-				fY += 1.0f;	fY *= 127.0f;
-				fZ += 1.0f;	fZ *= 127.0f;
-				r[0] = unsigned char(fX);
-				g[0] = unsigned char(fY);
-				b[0] = unsigned char(fZ);
-				outputImage.setPixel(ix, y, r[0], g[0], b[0], a);
-			}
-		}
+			}, numThreadsPARAM);
 	}
 
 	/*
@@ -3,6 +3,8 @@
 #include "../Math/vector2f.h"
 #include "../Common/colour.h"
 #include "../Common/string.h"
+#include "../Common/multithreading.h"
+#include <vector>
 
 namespace DC
 {
@@ -21,6 +23,24 @@ namespace DC
 	class Image2D
 	{
 	public:
+		// The filters resize() and generateMipChain() can use, from the fastest, but blurriest, to the slowest, but sharpest.
+		enum ResampleFilter
+		{
+			BOX,		// Averages the pixels each new pixel covers. The fastest, and fine for halving the size.
+			BILINEAR,	// A triangle filter, the same as the GPU's bilinear filtering when increasing the size.
+			LANCZOS3,	// A sinc windowed by a wider sinc, 3 pixels either side. Sharp, but may ring around hard edges.
+			KAISER		// A sinc with a Kaiser window, 3 pixels either side. Nearly as sharp as LANCZOS3, with less ringing.
+		};
+
+		// Where a level of the mip chain generateMipChain() creates is within it's buffer
+		struct MipLevel
+		{
+			unsigned int width;		// Width of the level in pixels
+			unsigned int height;	// Height of the level in pixels
+			size_t offset;			// Offset of the level's first pixel from the start of the buffer, in bytes
+			size_t size;			// Size of the level's pixels, in bytes
+		};
+
 		Image2D();
 		~Image2D();
 
@@ -31,7 +51,7 @@ namespace DC
 		void free(void);
 
 		// Create a blank image.
-		// If already created, the previous image is freed
+		// If already created, the previous image is freed, unless it holds the same number of bytes, in which case it's memory is reused
 		// Each channel contains black
 		// Acceptable number of channels may be 3 or 4
 		// Both dimensions must be at least 1
@@ -113,9 +133,32 @@ namespace DC
 		// If you're wanting to modify many pixels, it's best to use the "unsafe" getData() method.
 		inline void getPixel(int positionX, int positionY, unsigned char& red, unsigned char& green, unsigned char& blue, unsigned char& alpha) const;
 
+		// Splits the rows of the image into bands and calls function(firstRow, numRows) for each band, on up to numThreads
+		// threads, with 0 using as many as there are hardware threads.
+		// Each band is a whole number of rows, so a function which only modifies the rows it's given needs no locking.
+		// Threads are only used for large images, as otherwise starting them takes longer than processing the pixels.
+		// Returns once all of the bands are done.
+		// Use this to write filters which process each pixel, or each row, on their own, using getData() to access the pixels.
+		// Example:
+		// unsigned char* pData = image.getData();
+		// unsigned int iRowSize = image.getWidth() * image.getNumChannels();
+		// image.parallelFor([&](int firstRow, int numRows)
+		//	{
+		//		unsigned char* pRow = pData + size_t(firstRow) * iRowSize;
+		//		for (size_t i = 0; i < size_t(numRows) * iRowSize; i++)
+		//			pRow[i] = pRow[i] / 2;
+		//	}, 0);
+		template <typename Function> void parallelFor(Function function, unsigned int numThreads) const;
+
+		// The methods below which take numThreads use parallelFor() to split the image between up to that many threads,
+		// with 0 using as many as there are hardware threads. The results are the same whatever the number of threads.
+		// swapRedAndBlue(), invert(), greyscaleSimple(), greyscale(), adjustBrightness() and removeAlphaChannel() also
+		// use SSE4.1 or AVX2 instructions, whichever the CPU supports, see simdGetInstructionSet() in Math/simd.h.
+		// The results are exactly the same as the scalar code's, whichever is used.
+
 		// Swap red and blue colour components around
 		// If this image contains no data, an error occurs.
-		void swapRedAndBlue(void);
+		void swapRedAndBlue(unsigned int numThreads = 1);
 
 		// Flip the image vertically
 		// If this image contains no data, an error occurs.
@@ -123,26 +166,26 @@ namespace DC
 
 		// Inverts the colours of the image, AKA new colour = 255 - current colour
 		// If this image contains no data, an error occurs.
-		void invert(bool invertColour = true, bool invertAlpha = false);
+		void invert(bool invertColour = true, bool invertAlpha = false, unsigned int numThreads = 1);
 
 		// Converts the image's RGB components to greyscale, simply finding mean average of RGB components
 		// If this image contains no data, an error occurs.
-		void greyscaleSimple(void);
+		void greyscaleSimple(unsigned int numThreads = 1);
 
 		// Converts the image's RGB components to greyscale, taking into consideration the average human's eye sensitivity to the individual RGB components.
 		// If default params are not used (They approximate the average human's eye sensitivity), they should be of unit length.
 		// If this image contains no data, an error occurs.
-		void greyscale(float redSensitivity = 0.299f, float greenSensitivity = 0.587f, float blueSensitivity = 0.144f);
+		void greyscale(float redSensitivity = 0.299f, float greenSensitivity = 0.587f, float blueSensitivity = 0.144f, unsigned int numThreads = 1);
 
 		// Adjusts brightness of colour components
 		// Accepted range for iAmount can be between -255 to +255 which would make entire image totally black or white.
 		// If this image contains no data, an error occurs.
-		void adjustBrightness(int value);
+		void adjustBrightness(int value, unsigned int numThreads = 1);
 
 		// Adjusts contrast of the colour components
 		// Accepted range for iAmount is between -100 and +100
 		// If this image contains no data, an error occurs.
-		void adjustContrast(int value);
+		void adjustContrast(int value, unsigned int numThreads = 1);
 
 		// Copies this image into the one given
 		// Silently fails if both this image and the one parsed are actually the same objects, or there is no image data to copy.
@@ -173,22 +216,49 @@ namespace DC
 		// I wish I could place images here in the code, as it'd be much easier to show what this does with images.
 		// Edges are detected by using the given colour value which should represent the colour of the image's background
 		// If this image contains no data, or doesn't have at least 3 channels, an error occurs.
-		void edgeDetect(Image2D& outputImage, unsigned char red, unsigned char green, unsigned char blue);
+		void edgeDetect(Image2D& outputImage, unsigned char red, unsigned char green, unsigned char blue, unsigned int numThreads = 1);
 
 		// Removes the alpha channel of the image, leaving the RGB components
 		// If this image contains no data, or doesn't have 4 channels, an error occurs.
-		void removeAlphaChannel(void);
+		void removeAlphaChannel(unsigned int numThreads = 1);
 
 		// Copies the alpha channel to each of the RGB components
 		// If this image contains no data, or doesn't have 4 channels, an error occurs.
 		void copyAlphaChannelToRGB(void);
 
+		// Resizes the image to the given dimensions, using the given filter.
+		// If sRGB is true, the RGB components are converted to linear space before they're filtered and back again afterwards,
+		// otherwise bright and dark pixels don't average to the right brightness. Pass false for images which aren't colours,
+		// such as normal maps and heightmaps.
+		// For 4 channel images, the RGB components are weighted by alpha, so that the colour of fully transparent pixels
+		// doesn't bleed into the pixels next to them. Alpha itself is always filtered linearly.
+		// The filtering is done by stb_image_resize2, which uses SSE2 or AVX instructions.
+		// If this image contains no data, either of the new dimensions is 0, or the new image would be too large for it's size
+		// in bytes to fit into an unsigned int, an error occurs.
+		void resize(unsigned int newWidth, unsigned int newHeight, ResampleFilter filter = LANCZOS3, bool sRGB = true, unsigned int numThreads = 1);
+
+		// Generates a mip chain from this image, with all of it's levels in mipData, one after another, largest first,
+		// with no padding between rows or levels, so that the buffer can be uploaded to the GPU as it is.
+		// The first level is a copy of this image, then each level is half the size of the one before, rounded down, but at
+		// least 1, down to a 1x1 level. Each level is filtered from the one before it, the same way as resize(), so sRGB
+		// and alpha are dealt with in the same way, except that the levels are kept as linear floats in between, so each
+		// level is only rounded to 8 bits once, rather than the rounding of every level before it adding up.
+		// mipLevels is set to the dimensions and position in mipData of each level, mipLevels[0] being the first level.
+		// If this image contains no data, an error occurs.
+		// Example:
+		// std::vector<unsigned char> mipData;
+		// std::vector<Image2D::MipLevel> mipLevels;
+		// image.generateMipChain(mipData, mipLevels, Image2D::KAISER, true, 0);
+		// for (unsigned int i = 0; i < mipLevels.size(); i++)
+		//	glTexImage2D(GL_TEXTURE_2D, i, GL_SRGB8_ALPHA8, mipLevels[i].width, mipLevels[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &mipData[mipLevels[i].offset]);
+		void generateMipChain(std::vector<unsigned char>& mipData, std::vector<MipLevel>& mipLevels, ResampleFilter filter = KAISER, bool sRGB = true, unsigned int numThreads = 1) const;
+
 		// Computes a normal map used for normal mapping from this image and stores the result in outputImage
 		// This image should be a heightmap, where each pixel represents the height of a surface. White being max height, black being the lowest.
 		// However, this image first creates a copy of itself in memory, then calls greyscaleSimple() on that to ensure proper computation of the normals.
 		// Scale should be between 0.0f and 1.0f and affects how "intense" the normals are generated. This value is clamped internally. Lower values increase the effect
 		// If this image contains no data, an error occurs.
-		void normalmap(Image2D& outputImage, float scale = 1.0f) const;
+		void normalmap(Image2D& outputImage, float scale = 1.0f, unsigned int numThreads = 1) const;
 
 		// Uses glReadPixels() to read the contents of the currently set backbuffer/framebuffer into this image.
 		// This image must already have dimensions and it is those dimensions which are used during the glReadPixels call.
@@ -218,8 +288,8 @@ namespace DC
 		int height;
 		int numberOfChannels;
 
-		// Used by edgeDetect()
-		inline bool _isPixelEdge(int positionX, int positionY, unsigned char red, unsigned char green, unsigned char blue);
+		// The fewest pixels parallelFor() gives to each thread
+		static const size_t kMinPixelsPerThread = 65536;
 	};
 
 
@@ -287,89 +357,15 @@ namespace DC
 		}
 	}
 
-	inline bool Image2D::_isPixelEdge(int positionX, int positionY, unsigned char red, unsigned char green, unsigned char blue)
+	template <typename Function> void Image2D::parallelFor(Function function, unsigned int numThreads) const
 	{
-		// Don't check edge pixels of image
-		if (positionX == 0)
-			return false;
-		if (positionY == 0)
-			return false;
-		if (positionX >= int(width) - 1)
-			return false;
-		if (positionY >= int(height) - 1)
-			return false;
-
-		// Get center pixel colour values
-		unsigned char col[4];
-		getPixel(positionX, positionY, col[0], col[1], col[2], col[3]);
-
-		// If the center pixel's colour is same as mask, it's not an edge
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return false;
-
-		// If we get here, the center pixel is not the same as the mask colour
-
-		// Get bordering pixels of center pixel
-		// If they are the same as the mask, then it's an edge
-
-		// Left
-		getPixel(positionX - 1, positionY, col[0], col[1], col[2], col[3]);
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return true;
-		// Right
-		getPixel(positionX + 1, positionY, col[0], col[1], col[2], col[3]);
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return true;
-
-		// Top
-		getPixel(positionX, positionY - 1, col[0], col[1], col[2], col[3]);
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return true;
-
-		// Bottom
-		getPixel(positionX, positionY + 1, col[0], col[1], col[2], col[3]);
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return true;
-
-		// Top left
-		getPixel(positionX - 1, positionY - 1, col[0], col[1], col[2], col[3]);
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return true;
-
-		// Top right
-		getPixel(positionX + 1, positionY - 1, col[0], col[1], col[2], col[3]);
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return true;
-
-		// Bottom left
-		getPixel(positionX - 1, positionY + 1, col[0], col[1], col[2], col[3]);
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return true;
-
-		// Bottom right
-		getPixel(positionX + 1, positionY + 1, col[0], col[1], col[2], col[3]);
-		if (col[0] == red)
-			if (col[1] == green)
-				if (col[2] == blue)
-					return true;
-
-		return false;	// Shouldn't get here, keep compiler happy
+		size_t minRowsPerThread = 1;
+		if (width > 0)
+			minRowsPerThread = std::max(kMinPixelsPerThread / size_t(width), (size_t)1);
+		runInChunks(size_t(height), numThreads, minRowsPerThread, 1, [&](size_t firstRow, size_t numRows)
+			{
+				function(int(firstRow), int(numRows));
+			});
 	}
 
 }
\ No newline at end of file
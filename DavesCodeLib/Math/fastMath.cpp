@@ -0,0 +1,200 @@
+#include "fastMath.h"
+#include "../Common/error.h"
+#include "simd.h"
+
+namespace DC
+{
+	namespace FastMath
+	{
+		namespace
+		{
+			// The SIMD versions of the single value functions in fastMath.h.
+			// These do exactly the same operations in exactly the same order, so that the results are the same.
+			inline SIMDFloats simdRsqrt(SIMDFloats vValue)
+			{
+				SIMDFloats vHalf = simdMul(vValue, simdSet(0.5f));
+				SIMDFloats vResult = simdCastToFloats(simdSubInts(simdSetInts(0x5F375A86u), simdShiftRightInts(simdCastToInts(vValue), 1)));
+				SIMDFloats vThreeHalves = simdSet(1.5f);
+				vResult = simdMul(vResult, simdSub(vThreeHalves, simdMul(simdMul(vHalf, vResult), vResult)));
+				vResult = simdMul(vResult, simdSub(vThreeHalves, simdMul(simdMul(vHalf, vResult), vResult)));
+				return vResult;
+			}
+
+			inline void simdSinCos(SIMDFloats vValue, SIMDFloats& vSinOut, SIMDFloats& vCosOut)
+			{
+				SIMDFloats vMagic = simdSet(12582912.0f);
+				SIMDFloats vRounded = simdAdd(simdMul(vValue, simdSet(0.636619772f)), vMagic);
+				SIMDFloats vQuadrant = simdSub(vRounded, vMagic);
+				SIMDFloats r = simdSub(vValue, simdMul(vQuadrant, simdSet(1.5703125f)));
+				r = simdSub(r, simdMul(vQuadrant, simdSet(4.837512969970703125e-4f)));
+				r = simdSub(r, simdMul(vQuadrant, simdSet(7.54978995489188216e-8f)));
+
+				SIMDFloats z = simdMul(r, r);
+				SIMDFloats vSin = simdAdd(simdMul(simdSet(-1.9515295891e-4f), z), simdSet(8.3321608736e-3f));
+				vSin = simdSub(simdMul(vSin, z), simdSet(1.6666654611e-1f));
+				vSin = simdAdd(simdMul(simdMul(vSin, z), r), r);
+				SIMDFloats vCos = simdSub(simdMul(simdSet(2.443315711809948e-5f), z), simdSet(1.388731625493765e-3f));
+				vCos = simdAdd(simdMul(vCos, z), simdSet(4.166664568298827e-2f));
+				vCos = simdAdd(simdSub(simdMul(simdMul(vCos, z), z), simdMul(simdSet(0.5f), z)), simdSet(1.0f));
+
+				SIMDInts vQuadrant32 = simdSubInts(simdCastToInts(vRounded), simdSetInts(0x4B400000u));
+				SIMDInts vSwap = simdShiftLeftInts(vQuadrant32, 31);
+				SIMDInts vSinSign = simdShiftLeftInts(simdAndInts(vQuadrant32, simdSetInts(2)), 30);
+				SIMDInts vCosSign = simdShiftLeftInts(simdAndInts(simdAddInts(vQuadrant32, simdSetInts(1)), simdSetInts(2)), 30);
+				vSinOut = simdCastToFloats(simdXorInts(simdCastToInts(simdSelect(vSwap, vCos, vSin)), vSinSign));
+				vCosOut = simdCastToFloats(simdXorInts(simdCastToInts(simdSelect(vSwap, vSin, vCos)), vCosSign));
+			}
+
+			inline SIMDFloats simdExp(SIMDFloats vValue)
+			{
+				vValue = simdMin(vValue, simdSet(88.0f));
+				vValue = simdMax(vValue, simdSet(-87.0f));
+
+				SIMDFloats vMagic = simdSet(12582912.0f);
+				SIMDFloats vRounded = simdAdd(simdMul(vValue, simdSet(1.44269504088896341f)), vMagic);
+				SIMDFloats vPower = simdSub(vRounded, vMagic);
+				SIMDFloats r = simdSub(vValue, simdMul(vPower, simdSet(0.693359375f)));
+				r = simdSub(r, simdMul(vPower, simdSet(-2.12194440e-4f)));
+
+				SIMDFloats z = simdMul(r, r);
+				SIMDFloats vResult = simdAdd(simdMul(simdSet(1.9875691500e-4f), r), simdSet(1.3981999507e-3f));
+				vResult = simdAdd(simdMul(vResult, r), simdSet(8.3334519073e-3f));
+				vResult = simdAdd(simdMul(vResult, r), simdSet(4.1665795894e-2f));
+				vResult = simdAdd(simdMul(vResult, r), simdSet(1.6666665459e-1f));
+				vResult = simdAdd(simdMul(vResult, r), simdSet(5.0000001201e-1f));
+				vResult = simdAdd(simdAdd(simdMul(vResult, z), r), simdSet(1.0f));
+				SIMDInts vPowerOf2 = simdShiftLeftInts(simdAddInts(simdSubInts(simdCastToInts(vRounded), simdSetInts(0x4B400000u)), simdSetInts(127)), 23);
+				return simdMul(vResult, simdCastToFloats(vPowerOf2));
+			}
+
+			inline SIMDFloats simdSigmoid(SIMDFloats vValue, SIMDFloats vResponse)
+			{
+				SIMDFloats vOne = simdSet(1.0f);
+				return simdDiv(vOne, simdAdd(vOne, simdExp(simdDiv(simdMul(vValue, simdSet(-1.0f)), vResponse))));
+			}
+
+			// Calls computePARAM(values) for each full SIMD register's worth of the given values and stores the
+			// results in the output span, then computeScalarPARAM(value) for the remaining values at the end.
+			template <typename Compute, typename ComputeScalar> void computeIntoSpan(std::span<const float> valuesPARAM, std::span<float> valuesOutPARAM, Compute computePARAM, ComputeScalar computeScalarPARAM)
+			{
+				size_t i = 0;
+				for (; i + kSIMDWidth <= valuesPARAM.size(); i += kSIMDWidth)
+					simdStoreUnaligned(valuesOutPARAM.data() + i, computePARAM(simdLoadUnaligned(valuesPARAM.data() + i)));
+				for (; i < valuesPARAM.size(); i++)
+					valuesOutPARAM[i] = computeScalarPARAM(valuesPARAM[i]);
+			}
+		}
+
+		void rsqrt(std::span<const float> valuesPARAM, std::span<float> valuesOutPARAM)
+		{
+			ErrorIfTrue(valuesOutPARAM.size() != valuesPARAM.size(), L"FastMath::rsqrt() failed. The output span is not the same size as the input span.");
+			computeIntoSpan(valuesPARAM, valuesOutPARAM, [](SIMDFloats vValue) { return simdRsqrt(vValue); }, [](float fValue) { return rsqrt(fValue); });
+		}
+
+		void sqrt(std::span<const float> valuesPARAM, std::span<float> valuesOutPARAM)
+		{
+			ErrorIfTrue(valuesOutPARAM.size() != valuesPARAM.size(), L"FastMath::sqrt() failed. The output span is not the same size as the input span.");
+			computeIntoSpan(valuesPARAM, valuesOutPARAM, [](SIMDFloats vValue) { return simdMul(vValue, simdRsqrt(vValue)); }, [](float fValue) { return sqrt(fValue); });
+		}
+
+		void sin(std::span<const float> valuesPARAM, std::span<float> valuesOutPARAM)
+		{
+			ErrorIfTrue(valuesOutPARAM.size() != valuesPARAM.size(), L"FastMath::sin() failed. The output span is not the same size as the input span.");
+			computeIntoSpan(valuesPARAM, valuesOutPARAM, [](SIMDFloats vValue)
+				{
+					SIMDFloats vSin, vCos;
+					simdSinCos(vValue, vSin, vCos);
+					return vSin;
+				},
+				[](float fValue) { return sin(fValue); });
+		}
+
+		void cos(std::span<const float> valuesPARAM, std::span<float> valuesOutPARAM)
+		{
+			ErrorIfTrue(valuesOutPARAM.size() != valuesPARAM.size(), L"FastMath::cos() failed. The output span is not the same size as the input span.");
+			computeIntoSpan(valuesPARAM, valuesOutPARAM, [](SIMDFloats vValue)
+				{
+					SIMDFloats vSin, vCos;
+					simdSinCos(vValue, vSin, vCos);
+					return vCos;
+				},
+				[](float fValue) { return cos(fValue); });
+		}
+
+		void sincos(std::span<const float> valuesPARAM, std::span<float> sinsOutPARAM, std::span<float> cossOutPARAM)
+		{
+			ErrorIfTrue(sinsOutPARAM.size() != valuesPARAM.size(), L"FastMath::sincos() failed. The sin output span is not the same size as the input span.");
+			ErrorIfTrue(cossOutPARAM.size() != valuesPARAM.size(), L"FastMath::sincos() failed. The cos output span is not the same size as the input span.");
+			size_t i = 0;
+			for (; i + kSIMDWidth <= valuesPARAM.size(); i += kSIMDWidth)
+			{
+				SIMDFloats vSin, vCos;
+				simdSinCos(simdLoadUnaligned(valuesPARAM.data() + i), vSin, vCos);
+				simdStoreUnaligned(sinsOutPARAM.data() + i, vSin);
+				simdStoreUnaligned(cossOutPARAM.data() + i, vCos);
+			}
+			for (; i < valuesPARAM.size(); i++)
+			{
+				// The value is copied first, in case the input is also one of the outputs
+				float fValue = valuesPARAM[i];
+				sincos(sinsOutPARAM[i], cossOutPARAM[i], fValue);
+			}
+		}
+
+		void exp(std::span<const float> valuesPARAM, std::span<float> valuesOutPARAM)
+		{
+			ErrorIfTrue(valuesOutPARAM.size() != valuesPARAM.size(), L"FastMath::exp() failed. The output span is not the same size as the input span.");
+			computeIntoSpan(valuesPARAM, valuesOutPARAM, [](SIMDFloats vValue) { return simdExp(vValue); }, [](float fValue) { return exp(fValue); });
+		}
+
+		void sigmoid(std::span<const float> valuesPARAM, std::span<float> valuesOutPARAM, float responsePARAM)
+		{
+			ErrorIfTrue(valuesOutPARAM.size() != valuesPARAM.size(), L"FastMath::sigmoid() failed. The output span is not the same size as the input span.");
+			ErrorIfTrue(0.0f == responsePARAM, L"FastMath::sigmoid() failed. The given response was zero.");
+			SIMDFloats vResponse = simdSet(responsePARAM);
+			computeIntoSpan(valuesPARAM, valuesOutPARAM, [vResponse](SIMDFloats vValue) { return simdSigmoid(vValue, vResponse); }, [responsePARAM](float fValue) { return sigmoid(fValue, responsePARAM); });
+		}
+
+		void normalise(Vector3fArray& vectorsPARAM)
+		{
+			// Vector3fArray's padding means whole SIMD registers can be used all the way to the end.
+			// Where the squared magnitude is zero or denormal, subtracting the bits of FLT_MIN sets the top bit,
+			// so those vectors are multiplied by one instead, the same as the check in normalise(Vector3f&).
+			float* pX = vectorsPARAM.getX();
+			float* pY = vectorsPARAM.getY();
+			float* pZ = vectorsPARAM.getZ();
+			size_t numVectors = vectorsPARAM.size();
+			for (size_t i = 0; i < numVectors; i += kSIMDWidth)
+			{
+				SIMDFloats vX = simdLoad(pX + i);
+				SIMDFloats vY = simdLoad(pY + i);
+				SIMDFloats vZ = simdLoad(pZ + i);
+				SIMDFloats vMagnitudeSquared = simdAdd(simdAdd(simdMul(vX, vX), simdMul(vY, vY)), simdMul(vZ, vZ));
+				SIMDInts vTooSmall = simdSubInts(simdCastToInts(vMagnitudeSquared), simdSetInts(std::bit_cast<unsigned int>(FLT_MIN)));
+				SIMDFloats vReciprocal = simdSelect(vTooSmall, simdSet(1.0f), simdRsqrt(vMagnitudeSquared));
+				simdStore(pX + i, simdMul(vX, vReciprocal));
+				simdStore(pY + i, simdMul(vY, vReciprocal));
+				simdStore(pZ + i, simdMul(vZ, vReciprocal));
+			}
+		}
+
+		void getMagnitude(const Vector3fArray& vectorsPARAM, std::span<float> magnitudesOutPARAM)
+		{
+			ErrorIfTrue(magnitudesOutPARAM.size() != vectorsPARAM.size(), L"FastMath::getMagnitude() failed. The given span is not the same size as the array.");
+			const float* pX = vectorsPARAM.getX();
+			const float* pY = vectorsPARAM.getY();
+			const float* pZ = vectorsPARAM.getZ();
+			size_t i = 0;
+			for (; i + kSIMDWidth <= magnitudesOutPARAM.size(); i += kSIMDWidth)
+			{
+				SIMDFloats vX = simdLoad(pX + i);
+				SIMDFloats vY = simdLoad(pY + i);
+				SIMDFloats vZ = simdLoad(pZ + i);
+				SIMDFloats vMagnitudeSquared = simdAdd(simdAdd(simdMul(vX, vX), simdMul(vY, vY)), simdMul(vZ, vZ));
+				simdStoreUnaligned(magnitudesOutPARAM.data() + i, simdMul(vMagnitudeSquared, simdRsqrt(vMagnitudeSquared)));
+			}
+			for (; i < magnitudesOutPARAM.size(); i++)
+				magnitudesOutPARAM[i] = getMagnitude(Vector3f(pX[i], pY[i], pZ[i]));
+		}
+	}
+}
\ No newline at end of file
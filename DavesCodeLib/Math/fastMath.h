@@ -0,0 +1,183 @@
+#pragma once
+#include "vector3f.h"
+#include "vector3fArray.h"
+#include <bit>
+#include <cfloat>
+#include <span>
+#include <utility>
+
+namespace DC
+{
+	// Faster, approximate versions of some of the maths functions, for when a little accuracy can be traded for
+	// speed, such as when steering lots of AI agents, updating particles or evaluating neural nets.
+	// These are opt-in, nothing else in the library uses them, so use FastMath::sin() and so on where the
+	// accuracy below is good enough, and the normal functions everywhere else.
+	//
+	// Maximum errors, measured against the double precision functions for every float in the given range...
+	// rsqrt()			Relative error less than 5e-6 for any positive normal float. rsqrt(0) is not infinity, but about
+	//					3e19, so check for zero first where that matters.
+	// sqrt()			Relative error less than 5e-6 for any positive normal float. sqrt(0) is 0.
+	// sin(), cos()		Absolute error less than 1e-7 for -8192 <= x <= 8192. Outside of that range, the results are useless.
+	// exp()			Relative error less than 1e-7 for -87 <= x <= 88. x is clamped to that range, so the results
+	//					are never zero or infinity.
+	// sigmoid()		Absolute error less than 1e-7 for any x, which is the same as the float sigmoid() in mathUtilities.h.
+	// normalise()		The magnitude of the resulting vector is within 5e-6 of 1. Vectors whose magnitude is less than
+	//					about 1.1e-19 are left unchanged, as their squared magnitude is too small for rsqrt().
+	// getMagnitude()	Relative error less than 5e-6 for vectors whose magnitude is at least about 1.1e-19. Below that,
+	//					the squared magnitude loses precision and the error grows to 30% or more.
+	// normalise() and getMagnitude() only work for vectors whose magnitude is less than about 1.8e19, as otherwise
+	// the squared magnitude is too large for a float. None of the functions work with NaN or infinity.
+	//
+	// rsqrt() starts with an estimate made by treating the bits of the float as an integer, then improves it with
+	// two iterations of Newton's method. sin() and cos() reduce x to within pi/4 of a multiple of pi/2, then use
+	// polynomials. exp() splits x into a power of 2 and the rest, the power of 2 is made by setting the exponent
+	// bits of a float and the rest is computed with a polynomial.
+	//
+	// The functions which take spans compute 4 or 8 values at once with the instruction set simd.h selects, which is
+	// where most of the speed comes from, and give exactly the same results as calling the single value versions for
+	// each value. On their own, the single value versions are only a little faster than the standard library's.
+	// The output spans must be the same size as the input span. They may be the same as the input, to compute
+	// the values in place, but must not otherwise overlap it.
+	//
+	// Example:
+	// float fSin, fCos;
+	// FastMath::sincos(fSin, fCos, fAngleRadians);
+	// FastMath::normalise(vDirection);
+	// FastMath::sigmoid(neuronInputs, neuronOutputs);
+	namespace FastMath
+	{
+		// Returns 1 / square root of the given value, which must be greater than zero.
+		// For zero, this returns about 3e19 rather than infinity.
+		inline float rsqrt(float value)
+		{
+			float fHalf = value * 0.5f;
+			float fResult = std::bit_cast<float>(0x5F375A86u - (std::bit_cast<unsigned int>(value) >> 1));
+			fResult = fResult * (1.5f - fHalf * fResult * fResult);
+			fResult = fResult * (1.5f - fHalf * fResult * fResult);
+			return fResult;
+		}
+
+		// Returns the square root of the given value, which must be positive or zero
+		inline float sqrt(float value)
+		{
+			return value * rsqrt(value);
+		}
+
+		// Computes both sin and cos of a scalar, which is in radians
+		inline void sincos(float& outSin, float& outCos, float scalar)
+		{
+			// Find the nearest multiple of pi/2 and subtract it. pi/2 is split into three parts, so that the
+			// first two multiplied by the multiple are exact.
+			// Adding 1.5 * 2^23 rounds to the nearest integer, which then sits in the low bits of the float.
+			float fRounded = scalar * 0.636619772f + 12582912.0f;
+			float fQuadrant = fRounded - 12582912.0f;
+			float r = scalar - fQuadrant * 1.5703125f;
+			r = r - fQuadrant * 4.837512969970703125e-4f;
+			r = r - fQuadrant * 7.54978995489188216e-8f;
+
+			float z = r * r;
+			float fSin = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+			float fCos = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+
+			// Each multiple of pi/2 rotates sin to cos, to -sin, to -cos
+			unsigned int quadrant = std::bit_cast<unsigned int>(fRounded) - 0x4B400000u;
+			if (quadrant & 1)
+				std::swap(fSin, fCos);
+			outSin = std::bit_cast<float>(std::bit_cast<unsigned int>(fSin) ^ ((quadrant & 2) << 30));
+			outCos = std::bit_cast<float>(std::bit_cast<unsigned int>(fCos) ^ (((quadrant + 1) & 2) << 30));
+		}
+
+		// Returns the sin of the given value, which is in radians
+		inline float sin(float value)
+		{
+			float fSin, fCos;
+			sincos(fSin, fCos, value);
+			return fSin;
+		}
+
+		// Returns the cos of the given value, which is in radians
+		inline float cos(float value)
+		{
+			float fSin, fCos;
+			sincos(fSin, fCos, value);
+			return fCos;
+		}
+
+		// Returns e to the power of the given value
+		inline float exp(float value)
+		{
+			value = value < 88.0f ? value : 88.0f;
+			value = value > -87.0f ? value : -87.0f;
+
+			// Split into value = power * ln(2) + r, where r is between -ln(2)/2 and ln(2)/2, so e to the power
+			// of value is 2 to the power of power multiplied by e to the power of r.
+			// ln(2) is split into two parts, so that the first multiplied by the power is exact.
+			float fRounded = value * 1.44269504088896341f + 12582912.0f;
+			float fPower = fRounded - 12582912.0f;
+			float r = value - fPower * 0.693359375f;
+			r = r - fPower * -2.12194440e-4f;
+
+			float z = r * r;
+			float fResult = (((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r + 4.1665795894e-2f) * r + 1.6666665459e-1f) * r + 5.0000001201e-1f) * z + r + 1.0f;
+			return fResult * std::bit_cast<float>((std::bit_cast<unsigned int>(fRounded) - 0x4B400000u + 127) << 23);
+		}
+
+		// Sigmoid function, see sigmoid() in mathUtilities.h
+		inline float sigmoid(float value)
+		{
+			return 1.0f / (1.0f + exp(-value));
+		}
+
+		// Sigmoid function, see sigmoid() in mathUtilities.h
+		// Do not set response to zero, this'll create a divide by zero error.
+		inline float sigmoid(float value, float response)
+		{
+			return 1.0f / (1.0f + exp(-value / response));
+		}
+
+		// Normalises the given vector so that it becomes a unit vector (Has a magnitude of 1)
+		inline void normalise(Vector3f& vector)
+		{
+			float fMagnitudeSquared = vector.x * vector.x + vector.y * vector.y + vector.z * vector.z;
+			if (fMagnitudeSquared < FLT_MIN)
+				return;
+			float fReciprocal = rsqrt(fMagnitudeSquared);
+			vector.x *= fReciprocal;
+			vector.y *= fReciprocal;
+			vector.z *= fReciprocal;
+		}
+
+		// Returns the magnitude of the given vector
+		inline float getMagnitude(const Vector3f& vector)
+		{
+			return sqrt(vector.x * vector.x + vector.y * vector.y + vector.z * vector.z);
+		}
+
+		// Computes rsqrt() of each of the given values
+		void rsqrt(std::span<const float> values, std::span<float> valuesOut);
+
+		// Computes sqrt() of each of the given values
+		void sqrt(std::span<const float> values, std::span<float> valuesOut);
+
+		// Computes sin() of each of the given values
+		void sin(std::span<const float> values, std::span<float> valuesOut);
+
+		// Computes cos() of each of the given values
+		void cos(std::span<const float> values, std::span<float> valuesOut);
+
+		// Computes both sin() and cos() of each of the given values
+		void sincos(std::span<const float> values, std::span<float> sinsOut, std::span<float> cossOut);
+
+		// Computes exp() of each of the given values
+		void exp(std::span<const float> values, std::span<float> valuesOut);
+
+		// Computes sigmoid() of each of the given values
+		void sigmoid(std::span<const float> values, std::span<float> valuesOut, float response = 1.0f);
+
+		// Normalises each of the vectors in the given array
+		void normalise(Vector3fArray& vectors);
+
+		// Computes the magnitude of each of the vectors in the given array
+		void getMagnitude(const Vector3fArray& vectors, std::span<float> magnitudesOut);
+	}
+}
\ No newline at end of file
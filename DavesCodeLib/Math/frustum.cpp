@@ -1,8 +1,129 @@
 #include "frustum.h"
 #include "../Math/mathUtilities.h"
+#include "../Common/error.h"
+#include "../Common/multithreading.h"
+#include "simd.h"
+#include <bit>
 
 namespace DC
 {
+	namespace
+	{
+		// The fewest spheres or AABBs the batch visibility methods give to each thread
+		const size_t kMinObjectsPerThread = 65536;
+
+		// The frustum's planes, in the order that they're tested
+		struct FrustumPlanes
+		{
+			float normals[6][3];
+			float distances[6];
+		};
+
+		void getFrustumPlanes(const Frustum& frustumPARAM, FrustumPlanes& planesOutPARAM)
+		{
+			const Plane* pPlanes[6] = { &frustumPARAM.planeNear, &frustumPARAM.planeFar, &frustumPARAM.planeLeft, &frustumPARAM.planeRight, &frustumPARAM.planeTop, &frustumPARAM.planeBottom };
+			for (int plane = 0; plane < 6; plane++)
+			{
+				Vector3f vNormal = pPlanes[plane]->getNormal();
+				planesOutPARAM.normals[plane][0] = vNormal.x;
+				planesOutPARAM.normals[plane][1] = vNormal.y;
+				planesOutPARAM.normals[plane][2] = vNormal.z;
+				planesOutPARAM.distances[plane] = pPlanes[plane]->getDistanceToOrigin();
+			}
+		}
+
+		// Sets the bits of the spheres from firstSphere to firstSphere + numSpheres - 1 which are visible.
+		// firstSphere must be a multiple of 32, so that no other thread writes to the same unsigned int.
+		// A sphere is visible if it's centre is no further than it's radius behind every plane.
+		void computeSphereVisibilityBits(const FrustumPlanes& planesPARAM, const float* pXPARAM, const float* pYPARAM, const float* pZPARAM, const float* pRadiiPARAM, size_t firstSpherePARAM, size_t numSpheresPARAM, unsigned int* pBitsOutPARAM)
+		{
+			SIMDFloats vZero = simdSet(0.0f);
+			size_t i = firstSpherePARAM;
+			size_t end = firstSpherePARAM + numSpheresPARAM;
+			for (; i + kSIMDWidth <= end; i += kSIMDWidth)
+			{
+				SIMDFloats vX = simdLoad(pXPARAM + i);
+				SIMDFloats vY = simdLoad(pYPARAM + i);
+				SIMDFloats vZ = simdLoad(pZPARAM + i);
+				SIMDFloats vRadius = simdLoadUnaligned(pRadiiPARAM + i);
+				int visibleMask = -1;
+				for (int plane = 0; plane < 6 && visibleMask; plane++)
+				{
+					SIMDFloats vDistance = simdAdd(simdMul(simdSet(planesPARAM.normals[plane][0]), vX), simdMul(simdSet(planesPARAM.normals[plane][1]), vY));
+					vDistance = simdSub(simdAdd(vDistance, simdMul(simdSet(planesPARAM.normals[plane][2]), vZ)), simdSet(planesPARAM.distances[plane]));
+					visibleMask &= simdGetGreaterOrEqualMask(simdAdd(vDistance, vRadius), vZero);
+				}
+				pBitsOutPARAM[i >> 5] |= (unsigned int)visibleMask << (i & 31);
+			}
+			for (; i < end; i++)
+			{
+				bool bVisible = true;
+				for (int plane = 0; plane < 6 && bVisible; plane++)
+				{
+					float fDistance = planesPARAM.normals[plane][0] * pXPARAM[i] + planesPARAM.normals[plane][1] * pYPARAM[i] + planesPARAM.normals[plane][2] * pZPARAM[i] - planesPARAM.distances[plane];
+					bVisible = fDistance + pRadiiPARAM[i] >= 0.0f;
+				}
+				if (bVisible)
+					pBitsOutPARAM[i >> 5] |= 1u << (i & 31);
+			}
+		}
+
+		// Sets the bits of the AABBs from firstAABB to firstAABB + numAABBs - 1 which are visible.
+		// firstAABB must be a multiple of 32, so that no other thread writes to the same unsigned int.
+		// An AABB is visible if, for every plane, the corner which is furthest along the plane's normal is in front of it.
+		// Which corner that is depends only upon the plane, so it's worked out once per plane rather than per AABB.
+		void computeAABBVisibilityBits(const FrustumPlanes& planesPARAM, const Vector3fArray& minsPARAM, const Vector3fArray& maxsPARAM, size_t firstAABBPARAM, size_t numAABBsPARAM, unsigned int* pBitsOutPARAM)
+		{
+			const float* pCorners[6][3];
+			for (int plane = 0; plane < 6; plane++)
+			{
+				pCorners[plane][0] = planesPARAM.normals[plane][0] >= 0.0f ? maxsPARAM.getX() : minsPARAM.getX();
+				pCorners[plane][1] = planesPARAM.normals[plane][1] >= 0.0f ? maxsPARAM.getY() : minsPARAM.getY();
+				pCorners[plane][2] = planesPARAM.normals[plane][2] >= 0.0f ? maxsPARAM.getZ() : minsPARAM.getZ();
+			}
+
+			SIMDFloats vZero = simdSet(0.0f);
+			size_t i = firstAABBPARAM;
+			size_t end = firstAABBPARAM + numAABBsPARAM;
+			for (; i + kSIMDWidth <= end; i += kSIMDWidth)
+			{
+				int visibleMask = -1;
+				for (int plane = 0; plane < 6 && visibleMask; plane++)
+				{
+					SIMDFloats vDistance = simdAdd(simdMul(simdSet(planesPARAM.normals[plane][0]), simdLoad(pCorners[plane][0] + i)), simdMul(simdSet(planesPARAM.normals[plane][1]), simdLoad(pCorners[plane][1] + i)));
+					vDistance = simdSub(simdAdd(vDistance, simdMul(simdSet(planesPARAM.normals[plane][2]), simdLoad(pCorners[plane][2] + i))), simdSet(planesPARAM.distances[plane]));
+					visibleMask &= simdGetGreaterOrEqualMask(vDistance, vZero);
+				}
+				pBitsOutPARAM[i >> 5] |= (unsigned int)visibleMask << (i & 31);
+			}
+			for (; i < end; i++)
+			{
+				bool bVisible = true;
+				for (int plane = 0; plane < 6 && bVisible; plane++)
+				{
+					float fDistance = planesPARAM.normals[plane][0] * pCorners[plane][0][i] + planesPARAM.normals[plane][1] * pCorners[plane][1][i] + planesPARAM.normals[plane][2] * pCorners[plane][2][i] - planesPARAM.distances[plane];
+					bVisible = fDistance >= 0.0f;
+				}
+				if (bVisible)
+					pBitsOutPARAM[i >> 5] |= 1u << (i & 31);
+			}
+		}
+
+		// Adds the index of each set bit to the end of the given vector
+		void addIndiciesOfSetBits(const std::vector<unsigned int>& bitsPARAM, std::vector<unsigned int>& indiciesOutPARAM)
+		{
+			for (size_t word = 0; word < bitsPARAM.size(); word++)
+			{
+				unsigned int bits = bitsPARAM[word];
+				while (bits)
+				{
+					indiciesOutPARAM.push_back((unsigned int)(word * 32) + (unsigned int)std::countr_zero(bits));
+					bits &= bits - 1;
+				}
+			}
+		}
+	}
+
 	Frustum::Frustum()
 	{
 
@@ -10,168 +131,113 @@ namespace DC
 
 	void Frustum::computeFromViewProjection(const Matrix& cameraViewMatrix, const Matrix& cameraProjectionMatrix)
 	{
-		/* Taken from Bard
-		// Get the view and projection matrices.
-		glm::mat4 viewMatrix = glm::lookAt(eye, center, up);
-		glm::mat4 projectionMatrix = glm::perspective(fov, aspect, planeNear, far);
-
-		// Compute the frustum planes.
-		std::vector<glm::Plane> frustumPlanes;
-		frustumPlanes.push_back(glm::Plane(viewMatrix * projectionMatrix * glm::vec4(1, 0, 0, 0), -1));
-		frustumPlanes.push_back(glm::Plane(viewMatrix * projectionMatrix * glm::vec4(-1, 0, 0, 0), 1));
-		frustumPlanes.push_back(glm::Plane(viewMatrix * projectionMatrix * glm::vec4(0, 1, 0, 0), -1));
-		frustumPlanes.push_back(glm::Plane(viewMatrix * projectionMatrix * glm::vec4(0, -1, 0, 0), 1));
-		frustumPlanes.push_back(glm::Plane(viewMatrix * projectionMatrix * glm::vec4(0, 0, 1, 0), -1));
-		frustumPlanes.push_back(glm::Plane(viewMatrix * projectionMatrix * glm::vec4(0, 0, -1, 0), 1));
-
-		// Normalize the frustum planes.
-		for (int i = 0; i < 6; i++) {
-		  frustumPlanes[i].normalize();
+		// The planes are extracted from the combined view and projection matrix, as described by Gil Gribb and
+		// Klaus Hartmann in "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix".
+		// A position is inside of the frustum if it's clip space position c = matrix * (position, 1) has
+		// -c.w <= c.x <= c.w, -c.w <= c.y <= c.w and 0 <= c.z <= c.w, as Matrix's projection matrices give depths
+		// from 0 to 1. Each of those six tests is the dot product of (position, 1) with one of the matrix's rows,
+		// or with the sum or difference of two of them, which gives a plane whose normal points inside.
+		Matrix matrixViewProj = cameraProjectionMatrix * cameraViewMatrix;
+		const float* m = matrixViewProj.getFloat();
+		float rows[4][4];
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+				rows[row][column] = m[column * 4 + row];
+		}
+
+		Plane* pPlanes[6] = { &planeNear, &planeFar, &planeLeft, &planeRight, &planeTop, &planeBottom };
+		float planes[6][4];
+		for (int i = 0; i < 4; i++)
+		{
+			planes[0][i] = rows[2][i];					// Near, 0 <= c.z
+			planes[1][i] = rows[3][i] - rows[2][i];		// Far, c.z <= c.w
+			planes[2][i] = rows[3][i] + rows[0][i];		// Left, -c.w <= c.x
+			planes[3][i] = rows[3][i] - rows[0][i];		// Right, c.x <= c.w
+			planes[4][i] = rows[3][i] - rows[1][i];		// Top, c.y <= c.w
+			planes[5][i] = rows[3][i] + rows[1][i];		// Bottom, -c.w <= c.y
+		}
+
+		// Normalise the planes, so that Plane::getDistanceFromPlane() gives the actual distance.
+		// Each plane is a * x + b * y + c * z + d >= 0, whereas getDistanceFromPlane() returns normal . position - distanceToOrigin
+		for (int plane = 0; plane < 6; plane++)
+		{
+			Vector3f vNormal(planes[plane][0], planes[plane][1], planes[plane][2]);
+			float fMag = vNormal.getMagnitude();
+			if (fMag > 0.0f)
+				pPlanes[plane]->set(vNormal * (1.0f / fMag), -planes[plane][3] / fMag);
+			else
+				pPlanes[plane]->set(vNormal, -planes[plane][3]);
 		}
-*/
-
-		// Combine the view and projection matrices
-		// Then create vectors with offsets for the six planes
-		// Then multiply them by the combined matrices
-		// and finally set the distance to origins accordingly
-		Matrix matrixViewProj = cameraViewMatrix * cameraProjectionMatrix;
-		Vector3f v;
-		float fMag;
-
-		v.set(1.0f, 0.0f, 0.0f);
-		v = matrixViewProj.multiply(v);
-		fMag = v.getMagnitude();
-		v.normalise();
-		planeRight.set(v, -fMag);
-
-		v.set(-1.0f,  0.0f,  0.0f);
-		v = matrixViewProj.multiply(v);
-		fMag = v.getMagnitude();
-		v.normalise();
-		planeLeft.set(v, fMag);
-
-		v.set( 0.0f,  1.0f,  0.0f);
-		v = matrixViewProj.multiply(v);
-		fMag = v.getMagnitude();
-		v.normalise();
-		planeTop.set(v, -fMag);
-
-		v.set( 0.0f, -1.0f,  0.0f);
-		v = matrixViewProj.multiply(v);
-		fMag = v.getMagnitude();
-		v.normalise();
-		planeBottom.set(v, fMag);
-
-		v.set( 0.0f,  0.0f,  1.0f);
-		v = matrixViewProj.multiply(v);
-		fMag = v.getMagnitude();
-		v.normalise();
-		planeNear.set(v, -fMag);
-
-		v.set( 0.0f,  0.0f, -1.0f);
-		v = matrixViewProj.multiply(v);
-		fMag = v.getMagnitude();
-		v.normalise();
-		planeFar.set(v, fMag);
 	}
 
 	bool Frustum::isPointInside(const Vector3f& position) const
 	{
-		/* Taken from Bard
-		bool isPointInsideFrustum(glm::vec3 point, std::vector<glm::Plane> frustumPlanes)
+		// The position is inside if it's in front of all of the planes, as their normals point inside
+		const Plane* pPlanes[6] = { &planeNear, &planeFar, &planeLeft, &planeRight, &planeTop, &planeBottom };
+		for (int plane = 0; plane < 6; plane++)
 		{
-			for (int i = 0; i < 6; i++)
-			{
-				if (frustumPlanes[i].dot(point) < 0)
-				{
-					return false;
-				}
-			}
-			return true;
+			if (pPlanes[plane]->getDistanceFromPlane(position) < 0.0f)
+				return false;
 		}
-		This code takes a point and a vector of frustum planes as input.
-		It then iterates through the frustum planes and checks if the point is on the "wrong" side of any of the planes.
-		If the point is on the wrong side of any of the planes, then it is not inside the frustum. Otherwise, the point is inside the frustum.
-		
-		The dot() function is used to calculate the dot product of the point and the plane normal.
-		The dot product is a measure of the angle between two vectors.
-		If the dot product is negative, then the point is on the "wrong" side of the plane.
-		*/
-
-		// Compute dot product between position and each plane's normal...
-		// If returned dot product is...
-		// > 0		vectors are pointing roughly in same direction (upto 90 degrees apart)
-		// = 0		vectors are perpendicular to one another (90 degrees)
-		// < 0		vectors are pointing in opposite directions (+90 degrees to 180 degrees)
-
-		Vector3f v;
-		v = planeNear.getNormal() * abs(planeNear.getDistanceToOrigin());
-		if (v.getDot(position) < 0)
-			return false;
-		v = planeFar.getNormal() * abs(planeFar.getDistanceToOrigin());
-		if (v.getDot(position) < 0)
-			return false;
-		v = planeLeft.getNormal() * abs(planeLeft.getDistanceToOrigin());
-		if (v.getDot(position) < 0)
-			return false;
-		v = planeRight.getNormal() * abs(planeRight.getDistanceToOrigin());
-		if (v.getDot(position) < 0)
-			return false;
-		v = planeTop.getNormal() * abs(planeTop.getDistanceToOrigin());
-		if (v.getDot(position) < 0)
-			return false;
-		v = planeBottom.getNormal() * abs(planeBottom.getDistanceToOrigin());
-		if (v.getDot(position) < 0)
-			return false;
 		return true;
 	}
 
 	bool Frustum::isAABBIntersecting(const AABB& aabb) const
 	{
-		/* Taken from Bard
-		bool isAABBIntersectingFrustum(glm::vec3 min, glm::vec3 max, std::vector<glm::Plane> frustumPlanes)
+		// For each plane, the corner of the AABB which is furthest along the plane's normal is tested.
+		// If that is behind the plane, the whole AABB is outside of the frustum.
+		// This is the same test as OctTree, LinearOctTree, BVH and computeAABBVisibility() use.
+		Vector3f vMin = aabb.getMin();
+		Vector3f vMax = aabb.getMax();
+		const Plane* pPlanes[6] = { &planeNear, &planeFar, &planeLeft, &planeRight, &planeTop, &planeBottom };
+		for (int plane = 0; plane < 6; plane++)
 		{
-			for (int i = 0; i < 6; i++)
-			{
-				// Check if any of the AABB's vertices are on the wrong side of the plane.
-				if (frustumPlanes[i].dot(min) < 0 || frustumPlanes[i].dot(max) > 0)
-				{
-					return false;
-				}
-			}
-			return true;
+			Vector3f vNormal = pPlanes[plane]->getNormal();
+			Vector3f vFurthest(vNormal.x >= 0.0f ? vMax.x : vMin.x, vNormal.y >= 0.0f ? vMax.y : vMin.y, vNormal.z >= 0.0f ? vMax.z : vMin.z);
+			if (pPlanes[plane]->getDistanceFromPlane(vFurthest) < 0.0f)
+				return false;
 		}
-		This code takes an AABB and a vector of frustum planes as input.
-		It then iterates through the frustum planes and checks if any of the AABB's vertices are on the "wrong" side of any of the planes.
-		If any of the AABB's vertices are on the wrong side of any of the planes, then the AABB is not intersecting the frustum.
-		Otherwise, the AABB is intersecting the frustum.
+		return true;
+	}
 
-		The dot() function is used to calculate the dot product of the AABB's vertices and the plane normals.
-		The dot product is a measure of the angle between two vectors. If the dot product is negative, then the vertex is on the "wrong" side of the plane.
-		*/
+	void Frustum::computeSphereVisibility(const Vector3fArray& centresPARAM, std::span<const float> radiiPARAM, std::vector<unsigned int>& visibilityBitsOutPARAM, unsigned int numThreadsPARAM) const
+	{
+		size_t numSpheres = centresPARAM.size();
+		ErrorIfTrue(radiiPARAM.size() != numSpheres, L"Frustum::computeSphereVisibility() failed. The given centres and radii are not the same size.");
+		FrustumPlanes planes;
+		getFrustumPlanes(*this, planes);
+		visibilityBitsOutPARAM.assign((numSpheres + 31) / 32, 0);
+		runInChunks(numSpheres, numThreadsPARAM, kMinObjectsPerThread, 32, [&](size_t firstSphere, size_t numSpheresInChunk)
+			{
+				computeSphereVisibilityBits(planes, centresPARAM.getX(), centresPARAM.getY(), centresPARAM.getZ(), radiiPARAM.data(), firstSphere, numSpheresInChunk, visibilityBitsOutPARAM.data());
+			});
+	}
 
-		Vector3f v;
-		Vector3f vMin = aabb.getMin();
-		Vector3f vMax = aabb.getMax();
+	void Frustum::getVisibleSpheres(const Vector3fArray& centresPARAM, std::span<const float> radiiPARAM, std::vector<unsigned int>& indiciesOutPARAM, unsigned int numThreadsPARAM) const
+	{
+		std::vector<unsigned int> visibilityBits;
+		computeSphereVisibility(centresPARAM, radiiPARAM, visibilityBits, numThreadsPARAM);
+		addIndiciesOfSetBits(visibilityBits, indiciesOutPARAM);
+	}
 
-		v = planeNear.getNormal() * abs(planeNear.getDistanceToOrigin());
-		if (v.getDot(vMin) < 0 || v.getDot(vMax) > 0)
-			return false;
-		v = planeFar.getNormal() * abs(planeFar.getDistanceToOrigin());
-		if (v.getDot(vMin) < 0 || v.getDot(vMax) > 0)
-			return false;
-		v = planeLeft.getNormal() * abs(planeLeft.getDistanceToOrigin());
-		if (v.getDot(vMin) < 0 || v.getDot(vMax) > 0)
-			return false;
-		v = planeRight.getNormal() * abs(planeRight.getDistanceToOrigin());
-		if (v.getDot(vMin) < 0 || v.getDot(vMax) > 0)
-			return false;
-		v = planeTop.getNormal() * abs(planeTop.getDistanceToOrigin());
-		if (v.getDot(vMin) < 0 || v.getDot(vMax) > 0)
-			return false;
-		v = planeBottom.getNormal() * abs(planeBottom.getDistanceToOrigin());
-		if (v.getDot(vMin) < 0 || v.getDot(vMax) > 0)
-			return false;
-		return true;
+	void Frustum::computeAABBVisibility(const Vector3fArray& minsPARAM, const Vector3fArray& maxsPARAM, std::vector<unsigned int>& visibilityBitsOutPARAM, unsigned int numThreadsPARAM) const
+	{
+		size_t numAABBs = minsPARAM.size();
+		ErrorIfTrue(maxsPARAM.size() != numAABBs, L"Frustum::computeAABBVisibility() failed. The given mins and maxs are not the same size.");
+		FrustumPlanes planes;
+		getFrustumPlanes(*this, planes);
+		visibilityBitsOutPARAM.assign((numAABBs + 31) / 32, 0);
+		runInChunks(numAABBs, numThreadsPARAM, kMinObjectsPerThread, 32, [&](size_t firstAABB, size_t numAABBsInChunk)
+			{
+				computeAABBVisibilityBits(planes, minsPARAM, maxsPARAM, firstAABB, numAABBsInChunk, visibilityBitsOutPARAM.data());
+			});
+	}
+
+	void Frustum::getVisibleAABBs(const Vector3fArray& minsPARAM, const Vector3fArray& maxsPARAM, std::vector<unsigned int>& indiciesOutPARAM, unsigned int numThreadsPARAM) const
+	{
+		std::vector<unsigned int> visibilityBits;
+		computeAABBVisibility(minsPARAM, maxsPARAM, visibilityBits, numThreadsPARAM);
+		addIndiciesOfSetBits(visibilityBits, indiciesOutPARAM);
 	}
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include "plane.h"
 #include "matrix.h"
 #include "AABB.h"
+#include "vector3fArray.h"
+#include <span>
+#include <vector>
 
 namespace DC
 {
@@ -14,14 +17,48 @@ namespace DC
 		Frustum();
 
 		// Sets this frustum's planes from the given matrices which are from a camera's view and projection matrices.
+		// The projection matrix is expected to give depths from 0 to 1, as Matrix::setProjectionPerspective() and
+		// Matrix::setProjectionOrthographic() do.
+		// Each plane's normal points towards the inside of the frustum and is of unit length, so that
+		// Plane::getDistanceFromPlane() gives the distance of a position in front of the plane, which is positive
+		// for positions inside of the frustum. All of the methods below, as well as OctTree, LinearOctTree and BVH
+		// expect the planes to be this way around.
 		void computeFromViewProjection(const Matrix& cameraViewMatrix, const Matrix& cameraProjectionMatrix);
 
 		// Returns true if the given position is inside the frustum, else false.
 		bool isPointInside(const Vector3f& position) const;
 
 		// Returns true if the given Axis Aligned Bounding Box is intersecting this frustum, else false.
+		// The test is conservative, so an AABB which is just outside of the frustum's corners may be treated as
+		// intersecting, which is fine for culling.
 		bool isAABBIntersecting(const AABB& aabb) const;
 
+		// The methods below test lots of spheres or AABBs against the frustum at once, several at a time with SIMD
+		// instructions, which is much faster than testing them one at a time.
+		// They give the same results as calling isAABBIntersecting() for each AABB, or testing each sphere's centre
+		// against the planes the same way isPointInside() does, allowing for the sphere's radius.
+		// The tests are conservative, so a few objects which are just outside of the frustum's corners are treated as
+		// visible, which is fine for culling.
+		// numThreads is the maximum number of threads to split the objects between, 0 uses as many as there are
+		// hardware threads. Threads are only used for very large numbers of objects.
+
+		// Computes which of the given spheres are visible, each sphere being centres[i] with a radius of radii[i].
+		// visibilityBitsOut is resized to hold a bit for each sphere, with bit (i % 32) of visibilityBitsOut[i / 32]
+		// set if sphere i is visible. Any bits after the last sphere are zero.
+		void computeSphereVisibility(const Vector3fArray& centres, std::span<const float> radii, std::vector<unsigned int>& visibilityBitsOut, unsigned int numThreads = 1) const;
+
+		// Adds the index of each visible sphere to the end of the given vector, in increasing order.
+		// The vector is not cleared first.
+		void getVisibleSpheres(const Vector3fArray& centres, std::span<const float> radii, std::vector<unsigned int>& indiciesOut, unsigned int numThreads = 1) const;
+
+		// Computes which of the given AABBs are visible, each AABB going from mins[i] to maxs[i].
+		// visibilityBitsOut is filled in the same way as computeSphereVisibility() does.
+		void computeAABBVisibility(const Vector3fArray& mins, const Vector3fArray& maxs, std::vector<unsigned int>& visibilityBitsOut, unsigned int numThreads = 1) const;
+
+		// Adds the index of each visible AABB to the end of the given vector, in increasing order.
+		// The vector is not cleared first.
+		void getVisibleAABBs(const Vector3fArray& mins, const Vector3fArray& maxs, std::vector<unsigned int>& indiciesOut, unsigned int numThreads = 1) const;
+
 		Plane planeNear;
 		Plane planeFar;
 		Plane planeLeft;
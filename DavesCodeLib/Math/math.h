@@ -1,11 +1,15 @@
 #pragma once
 #include "AABB.h"
+#include "fastMath.h"
 #include "frustum.h"
 #include "matrix.h"
+#include "matrixd.h"
 #include "plane.h"
 #include "quaternion.h"
 #include "rect.h"
 #include "mathUtilities.h"
 #include "vector2f.h"
+#include "vector3d.h"
 #include "vector3f.h"
+#include "vector3fArray.h"
 #include "vector4f.h"
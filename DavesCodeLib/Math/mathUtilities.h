@@ -3,6 +3,8 @@
 #include <math.h>
 #include <limits>
 #include <stdlib.h>
+#include <utility>
+#include <vector>
 
 namespace DC
 {
@@ -216,4 +218,65 @@ namespace DC
 		double zeroToOne = (double)rand() / double(RAND_MAX + 1.0);
 		return min + (max - min) * zeroToOne;
 	}
+
+	// Spreads the lower 10 bits of the given value out, so that there are two zero bits between each of them.
+	// Used to compute 3D Morton codes.
+	inline unsigned int mortonSpreadBits3D(unsigned int value)
+	{
+		value &= 0x000003FF;
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8)) & 0x0300F00F;
+		value = (value | (value << 4)) & 0x030C30C3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	// Spreads the lower 16 bits of the given value out, so that there is a zero bit between each of them.
+	// Used to compute 2D Morton codes.
+	inline unsigned int mortonSpreadBits2D(unsigned int value)
+	{
+		value &= 0x0000FFFF;
+		value = (value | (value << 8)) & 0x00FF00FF;
+		value = (value | (value << 4)) & 0x0F0F0F0F;
+		value = (value | (value << 2)) & 0x33333333;
+		value = (value | (value << 1)) & 0x55555555;
+		return value;
+	}
+
+	// Returns the 30 bit Morton code of the given 10 bit coordinates, by interleaving their bits.
+	// Sorting points by their Morton code orders them along a Z shaped curve through space, so that points
+	// which are close to each other in space are mostly close to each other in the sorted order too.
+	inline unsigned int mortonCode3D(unsigned int x, unsigned int y, unsigned int z)
+	{
+		return mortonSpreadBits3D(x) | (mortonSpreadBits3D(y) << 1) | (mortonSpreadBits3D(z) << 2);
+	}
+
+	// Returns the 32 bit Morton code of the given 16 bit coordinates, by interleaving their bits.
+	inline unsigned int mortonCode2D(unsigned int x, unsigned int y)
+	{
+		return mortonSpreadBits2D(x) | (mortonSpreadBits2D(y) << 1);
+	}
+
+	// Sorts the given Morton codes into ascending order, keeping the value paired with each code.
+	// The first of each pair is the Morton code and the second is usually the index of the point the code was
+	// computed from. Codes which are equal keep their existing order.
+	// This uses a radix sort, which is much faster than std::sort for the large numbers of codes we get when
+	// building spatial partitioning structures from lots of points.
+	inline void sortMortonCodes(std::vector<std::pair<unsigned int, unsigned int>>& codes)
+	{
+		std::vector<std::pair<unsigned int, unsigned int>> sorted(codes.size());
+		for (unsigned int shift = 0; shift < 32; shift += 11)
+		{
+			// Count the number of codes with each value of the current 11 bits, then use those counts to copy
+			// the codes into their sorted positions
+			unsigned int offsets[2049] = { 0 };
+			for (size_t i = 0; i < codes.size(); i++)
+				offsets[((codes[i].first >> shift) & 2047) + 1]++;
+			for (unsigned int i = 0; i < 2048; i++)
+				offsets[i + 1] += offsets[i];
+			for (size_t i = 0; i < codes.size(); i++)
+				sorted[offsets[(codes[i].first >> shift) & 2047]++] = codes[i];
+			codes.swap(sorted);
+		}
+	}
 }
\ No newline at end of file
@@ -4,9 +4,163 @@
 #include "mathUtilities.h"
 #include "vector2f.h"
 #include "../Common/error.h"
+#include "../Common/multithreading.h"
+#include "simd.h"
 
 namespace DC
 {
+	namespace
+	{
+		// The fewest vectors the batch transform methods give to each thread, as with fewer than this, starting the
+		// thread takes longer than transforming them.
+		const size_t kMinVectorsPerThread = 32768;
+
+		// Transforms the given points by the given matrix, or if bTranslate is false, directions, which aren't translated.
+		// The sums are done in the same order as Matrix::multiply(const Vector3f&), so the results are exactly the same.
+		template <bool bTranslate> void transformVector3fs(const float* mPARAM, const Vector3f* pVectorsPARAM, Vector3f* pVectorsOutPARAM, size_t numVectorsPARAM)
+		{
+			size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+			__m128 vM0 = _mm_set1_ps(mPARAM[0]);	__m128 vM4 = _mm_set1_ps(mPARAM[4]);	__m128 vM8 = _mm_set1_ps(mPARAM[8]);	__m128 vM12 = _mm_set1_ps(mPARAM[12]);
+			__m128 vM1 = _mm_set1_ps(mPARAM[1]);	__m128 vM5 = _mm_set1_ps(mPARAM[5]);	__m128 vM9 = _mm_set1_ps(mPARAM[9]);	__m128 vM13 = _mm_set1_ps(mPARAM[13]);
+			__m128 vM2 = _mm_set1_ps(mPARAM[2]);	__m128 vM6 = _mm_set1_ps(mPARAM[6]);	__m128 vM10 = _mm_set1_ps(mPARAM[10]);	__m128 vM14 = _mm_set1_ps(mPARAM[14]);
+			for (; i + 4 <= numVectorsPARAM; i += 4)
+			{
+				// Load four vectors, which are stored x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3, and shuffle them into
+				// a register for each of the x, y and z components.
+				const float* pIn = &pVectorsPARAM[i].x;
+				__m128 vA = _mm_loadu_ps(pIn);
+				__m128 vB = _mm_loadu_ps(pIn + 4);
+				__m128 vC = _mm_loadu_ps(pIn + 8);
+				__m128 vX = _mm_shuffle_ps(_mm_shuffle_ps(vA, vA, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+				__m128 vY = _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+				__m128 vZ = _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(vC, vC, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+				__m128 vResultX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vM0, vX), _mm_mul_ps(vM4, vY)), _mm_mul_ps(vM8, vZ));
+				__m128 vResultY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vM1, vX), _mm_mul_ps(vM5, vY)), _mm_mul_ps(vM9, vZ));
+				__m128 vResultZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vM2, vX), _mm_mul_ps(vM6, vY)), _mm_mul_ps(vM10, vZ));
+				if (bTranslate)
+				{
+					vResultX = _mm_add_ps(vResultX, vM12);
+					vResultY = _mm_add_ps(vResultY, vM13);
+					vResultZ = _mm_add_ps(vResultZ, vM14);
+				}
+
+				// Shuffle the components back into x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3 and store them
+				__m128 vXYLow = _mm_unpacklo_ps(vResultX, vResultY);
+				__m128 vXYHigh = _mm_unpackhi_ps(vResultX, vResultY);
+				float* pOut = &pVectorsOutPARAM[i].x;
+				_mm_storeu_ps(pOut, _mm_shuffle_ps(vXYLow, _mm_shuffle_ps(vResultZ, vResultX, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+				_mm_storeu_ps(pOut + 4, _mm_shuffle_ps(_mm_shuffle_ps(vResultY, vResultZ, _MM_SHUFFLE(1, 1, 1, 1)), vXYHigh, _MM_SHUFFLE(1, 0, 2, 0)));
+				_mm_storeu_ps(pOut + 8, _mm_shuffle_ps(_mm_shuffle_ps(vResultZ, vXYHigh, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_ps(vXYHigh, vResultZ, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+			}
+#endif
+			for (; i < numVectorsPARAM; i++)
+			{
+				const Vector3f& v = pVectorsPARAM[i];
+				float fX = mPARAM[0] * v.x + mPARAM[4] * v.y + mPARAM[8] * v.z;
+				float fY = mPARAM[1] * v.x + mPARAM[5] * v.y + mPARAM[9] * v.z;
+				float fZ = mPARAM[2] * v.x + mPARAM[6] * v.y + mPARAM[10] * v.z;
+				if (bTranslate)
+				{
+					fX += mPARAM[12];
+					fY += mPARAM[13];
+					fZ += mPARAM[14];
+				}
+				pVectorsOutPARAM[i].set(fX, fY, fZ);
+			}
+		}
+
+		// Transforms the given points, stored as seperate arrays of their components, by the given matrix
+		void transformPointComponents(const float* mPARAM, const float* pXPARAM, const float* pYPARAM, const float* pZPARAM, float* pXOutPARAM, float* pYOutPARAM, float* pZOutPARAM, size_t numPointsPARAM)
+		{
+			size_t i = 0;
+#if defined(DC_SIMD_AVX2)
+			__m256 vM0 = _mm256_set1_ps(mPARAM[0]);	__m256 vM4 = _mm256_set1_ps(mPARAM[4]);	__m256 vM8 = _mm256_set1_ps(mPARAM[8]);	__m256 vM12 = _mm256_set1_ps(mPARAM[12]);
+			__m256 vM1 = _mm256_set1_ps(mPARAM[1]);	__m256 vM5 = _mm256_set1_ps(mPARAM[5]);	__m256 vM9 = _mm256_set1_ps(mPARAM[9]);	__m256 vM13 = _mm256_set1_ps(mPARAM[13]);
+			__m256 vM2 = _mm256_set1_ps(mPARAM[2]);	__m256 vM6 = _mm256_set1_ps(mPARAM[6]);	__m256 vM10 = _mm256_set1_ps(mPARAM[10]);	__m256 vM14 = _mm256_set1_ps(mPARAM[14]);
+			for (; i + 8 <= numPointsPARAM; i += 8)
+			{
+				__m256 vX = _mm256_loadu_ps(pXPARAM + i);
+				__m256 vY = _mm256_loadu_ps(pYPARAM + i);
+				__m256 vZ = _mm256_loadu_ps(pZPARAM + i);
+				_mm256_storeu_ps(pXOutPARAM + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vM0, vX), _mm256_mul_ps(vM4, vY)), _mm256_mul_ps(vM8, vZ)), vM12));
+				_mm256_storeu_ps(pYOutPARAM + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vM1, vX), _mm256_mul_ps(vM5, vY)), _mm256_mul_ps(vM9, vZ)), vM13));
+				_mm256_storeu_ps(pZOutPARAM + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vM2, vX), _mm256_mul_ps(vM6, vY)), _mm256_mul_ps(vM10, vZ)), vM14));
+			}
+#elif defined(DC_SIMD_SSE4_1)
+			__m128 vM0 = _mm_set1_ps(mPARAM[0]);	__m128 vM4 = _mm_set1_ps(mPARAM[4]);	__m128 vM8 = _mm_set1_ps(mPARAM[8]);	__m128 vM12 = _mm_set1_ps(mPARAM[12]);
+			__m128 vM1 = _mm_set1_ps(mPARAM[1]);	__m128 vM5 = _mm_set1_ps(mPARAM[5]);	__m128 vM9 = _mm_set1_ps(mPARAM[9]);	__m128 vM13 = _mm_set1_ps(mPARAM[13]);
+			__m128 vM2 = _mm_set1_ps(mPARAM[2]);	__m128 vM6 = _mm_set1_ps(mPARAM[6]);	__m128 vM10 = _mm_set1_ps(mPARAM[10]);	__m128 vM14 = _mm_set1_ps(mPARAM[14]);
+			for (; i + 4 <= numPointsPARAM; i += 4)
+			{
+				__m128 vX = _mm_loadu_ps(pXPARAM + i);
+				__m128 vY = _mm_loadu_ps(pYPARAM + i);
+				__m128 vZ = _mm_loadu_ps(pZPARAM + i);
+				_mm_storeu_ps(pXOutPARAM + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vM0, vX), _mm_mul_ps(vM4, vY)), _mm_mul_ps(vM8, vZ)), vM12));
+				_mm_storeu_ps(pYOutPARAM + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vM1, vX), _mm_mul_ps(vM5, vY)), _mm_mul_ps(vM9, vZ)), vM13));
+				_mm_storeu_ps(pZOutPARAM + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vM2, vX), _mm_mul_ps(vM6, vY)), _mm_mul_ps(vM10, vZ)), vM14));
+			}
+#endif
+			for (; i < numPointsPARAM; i++)
+			{
+				float fX = pXPARAM[i];
+				float fY = pYPARAM[i];
+				float fZ = pZPARAM[i];
+				pXOutPARAM[i] = mPARAM[0] * fX + mPARAM[4] * fY + mPARAM[8] * fZ + mPARAM[12];
+				pYOutPARAM[i] = mPARAM[1] * fX + mPARAM[5] * fY + mPARAM[9] * fZ + mPARAM[13];
+				pZOutPARAM[i] = mPARAM[2] * fX + mPARAM[6] * fY + mPARAM[10] * fZ + mPARAM[14];
+			}
+		}
+
+		// Transforms the given 4D vectors by the given matrix
+		void transformVector4fs(const float* mPARAM, const Vector4f* pVectorsPARAM, Vector4f* pVectorsOutPARAM, size_t numVectorsPARAM)
+		{
+			size_t i = 0;
+#if defined(DC_SIMD_AVX2)
+			// Two vectors at a time, one in each 128 bit half of the registers
+			__m256 vCol0 = _mm256_broadcast_ps((const __m128*)&mPARAM[0]);
+			__m256 vCol1 = _mm256_broadcast_ps((const __m128*)&mPARAM[4]);
+			__m256 vCol2 = _mm256_broadcast_ps((const __m128*)&mPARAM[8]);
+			__m256 vCol3 = _mm256_broadcast_ps((const __m128*)&mPARAM[12]);
+			for (; i + 2 <= numVectorsPARAM; i += 2)
+			{
+				__m256 vV = _mm256_loadu_ps(&pVectorsPARAM[i].x);
+				__m256 vResult = _mm256_mul_ps(vCol0, _mm256_shuffle_ps(vV, vV, _MM_SHUFFLE(0, 0, 0, 0)));
+				vResult = _mm256_add_ps(vResult, _mm256_mul_ps(vCol1, _mm256_shuffle_ps(vV, vV, _MM_SHUFFLE(1, 1, 1, 1))));
+				vResult = _mm256_add_ps(vResult, _mm256_mul_ps(vCol2, _mm256_shuffle_ps(vV, vV, _MM_SHUFFLE(2, 2, 2, 2))));
+				vResult = _mm256_add_ps(vResult, _mm256_mul_ps(vCol3, _mm256_shuffle_ps(vV, vV, _MM_SHUFFLE(3, 3, 3, 3))));
+				_mm256_storeu_ps(&pVectorsOutPARAM[i].x, vResult);
+			}
+#endif
+#if defined(DC_SIMD_SSE4_1)
+			__m128 vColumn0 = _mm_loadu_ps(&mPARAM[0]);
+			__m128 vColumn1 = _mm_loadu_ps(&mPARAM[4]);
+			__m128 vColumn2 = _mm_loadu_ps(&mPARAM[8]);
+			__m128 vColumn3 = _mm_loadu_ps(&mPARAM[12]);
+			for (; i < numVectorsPARAM; i++)
+			{
+				__m128 vV = _mm_loadu_ps(&pVectorsPARAM[i].x);
+				__m128 vResult = _mm_mul_ps(vColumn0, _mm_shuffle_ps(vV, vV, _MM_SHUFFLE(0, 0, 0, 0)));
+				vResult = _mm_add_ps(vResult, _mm_mul_ps(vColumn1, _mm_shuffle_ps(vV, vV, _MM_SHUFFLE(1, 1, 1, 1))));
+				vResult = _mm_add_ps(vResult, _mm_mul_ps(vColumn2, _mm_shuffle_ps(vV, vV, _MM_SHUFFLE(2, 2, 2, 2))));
+				vResult = _mm_add_ps(vResult, _mm_mul_ps(vColumn3, _mm_shuffle_ps(vV, vV, _MM_SHUFFLE(3, 3, 3, 3))));
+				_mm_storeu_ps(&pVectorsOutPARAM[i].x, vResult);
+			}
+#else
+			for (; i < numVectorsPARAM; i++)
+			{
+				const Vector4f& v = pVectorsPARAM[i];
+				pVectorsOutPARAM[i].set(
+					mPARAM[0] * v.x + mPARAM[4] * v.y + mPARAM[8] * v.z + mPARAM[12] * v.w,
+					mPARAM[1] * v.x + mPARAM[5] * v.y + mPARAM[9] * v.z + mPARAM[13] * v.w,
+					mPARAM[2] * v.x + mPARAM[6] * v.y + mPARAM[10] * v.z + mPARAM[14] * v.w,
+					mPARAM[3] * v.x + mPARAM[7] * v.y + mPARAM[11] * v.z + mPARAM[15] * v.w);
+			}
+#endif
+		}
+	}
+
 	Matrix::Matrix()
 	{
 		setIdentity();
@@ -20,6 +174,57 @@ namespace DC
 	const Matrix Matrix::operator *(const Matrix& n) const
 	{
 		Matrix r;
+#if defined(DC_SIMD_AVX2)
+		// Two columns of the result at a time, one in each 128 bit half of the registers.
+		// Each column of the result is this matrix's columns multiplied by the values in the other matrix's column and summed.
+		__m256 vCol0 = _mm256_broadcast_ps((const __m128*)&m[0]);
+		__m256 vCol1 = _mm256_broadcast_ps((const __m128*)&m[4]);
+		__m256 vCol2 = _mm256_broadcast_ps((const __m128*)&m[8]);
+		__m256 vCol3 = _mm256_broadcast_ps((const __m128*)&m[12]);
+		__m256 vN01 = _mm256_loadu_ps(&n.m[0]);
+		__m256 vN23 = _mm256_loadu_ps(&n.m[8]);
+		__m256 vResult01 = _mm256_mul_ps(vCol0, _mm256_shuffle_ps(vN01, vN01, _MM_SHUFFLE(0, 0, 0, 0)));
+		__m256 vResult23 = _mm256_mul_ps(vCol0, _mm256_shuffle_ps(vN23, vN23, _MM_SHUFFLE(0, 0, 0, 0)));
+		vResult01 = _mm256_add_ps(vResult01, _mm256_mul_ps(vCol1, _mm256_shuffle_ps(vN01, vN01, _MM_SHUFFLE(1, 1, 1, 1))));
+		vResult23 = _mm256_add_ps(vResult23, _mm256_mul_ps(vCol1, _mm256_shuffle_ps(vN23, vN23, _MM_SHUFFLE(1, 1, 1, 1))));
+		vResult01 = _mm256_add_ps(vResult01, _mm256_mul_ps(vCol2, _mm256_shuffle_ps(vN01, vN01, _MM_SHUFFLE(2, 2, 2, 2))));
+		vResult23 = _mm256_add_ps(vResult23, _mm256_mul_ps(vCol2, _mm256_shuffle_ps(vN23, vN23, _MM_SHUFFLE(2, 2, 2, 2))));
+		vResult01 = _mm256_add_ps(vResult01, _mm256_mul_ps(vCol3, _mm256_shuffle_ps(vN01, vN01, _MM_SHUFFLE(3, 3, 3, 3))));
+		vResult23 = _mm256_add_ps(vResult23, _mm256_mul_ps(vCol3, _mm256_shuffle_ps(vN23, vN23, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm256_storeu_ps(&r.m[0], vResult01);
+		_mm256_storeu_ps(&r.m[8], vResult23);
+#elif defined(DC_SIMD_SSE4_1)
+		// Each column of the result is this matrix's columns multiplied by the values in the other matrix's column and summed.
+		// The sums are done in the same order as the scalar code below, so the results are exactly the same.
+		__m128 vCol0 = _mm_loadu_ps(&m[0]);
+		__m128 vCol1 = _mm_loadu_ps(&m[4]);
+		__m128 vCol2 = _mm_loadu_ps(&m[8]);
+		__m128 vCol3 = _mm_loadu_ps(&m[12]);
+		__m128 vN0 = _mm_loadu_ps(&n.m[0]);
+		__m128 vN1 = _mm_loadu_ps(&n.m[4]);
+		__m128 vN2 = _mm_loadu_ps(&n.m[8]);
+		__m128 vN3 = _mm_loadu_ps(&n.m[12]);
+		__m128 vResult0 = _mm_mul_ps(vCol0, _mm_shuffle_ps(vN0, vN0, _MM_SHUFFLE(0, 0, 0, 0)));
+		__m128 vResult1 = _mm_mul_ps(vCol0, _mm_shuffle_ps(vN1, vN1, _MM_SHUFFLE(0, 0, 0, 0)));
+		__m128 vResult2 = _mm_mul_ps(vCol0, _mm_shuffle_ps(vN2, vN2, _MM_SHUFFLE(0, 0, 0, 0)));
+		__m128 vResult3 = _mm_mul_ps(vCol0, _mm_shuffle_ps(vN3, vN3, _MM_SHUFFLE(0, 0, 0, 0)));
+		vResult0 = _mm_add_ps(vResult0, _mm_mul_ps(vCol1, _mm_shuffle_ps(vN0, vN0, _MM_SHUFFLE(1, 1, 1, 1))));
+		vResult1 = _mm_add_ps(vResult1, _mm_mul_ps(vCol1, _mm_shuffle_ps(vN1, vN1, _MM_SHUFFLE(1, 1, 1, 1))));
+		vResult2 = _mm_add_ps(vResult2, _mm_mul_ps(vCol1, _mm_shuffle_ps(vN2, vN2, _MM_SHUFFLE(1, 1, 1, 1))));
+		vResult3 = _mm_add_ps(vResult3, _mm_mul_ps(vCol1, _mm_shuffle_ps(vN3, vN3, _MM_SHUFFLE(1, 1, 1, 1))));
+		vResult0 = _mm_add_ps(vResult0, _mm_mul_ps(vCol2, _mm_shuffle_ps(vN0, vN0, _MM_SHUFFLE(2, 2, 2, 2))));
+		vResult1 = _mm_add_ps(vResult1, _mm_mul_ps(vCol2, _mm_shuffle_ps(vN1, vN1, _MM_SHUFFLE(2, 2, 2, 2))));
+		vResult2 = _mm_add_ps(vResult2, _mm_mul_ps(vCol2, _mm_shuffle_ps(vN2, vN2, _MM_SHUFFLE(2, 2, 2, 2))));
+		vResult3 = _mm_add_ps(vResult3, _mm_mul_ps(vCol2, _mm_shuffle_ps(vN3, vN3, _MM_SHUFFLE(2, 2, 2, 2))));
+		vResult0 = _mm_add_ps(vResult0, _mm_mul_ps(vCol3, _mm_shuffle_ps(vN0, vN0, _MM_SHUFFLE(3, 3, 3, 3))));
+		vResult1 = _mm_add_ps(vResult1, _mm_mul_ps(vCol3, _mm_shuffle_ps(vN1, vN1, _MM_SHUFFLE(3, 3, 3, 3))));
+		vResult2 = _mm_add_ps(vResult2, _mm_mul_ps(vCol3, _mm_shuffle_ps(vN2, vN2, _MM_SHUFFLE(3, 3, 3, 3))));
+		vResult3 = _mm_add_ps(vResult3, _mm_mul_ps(vCol3, _mm_shuffle_ps(vN3, vN3, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm_storeu_ps(&r.m[0], vResult0);
+		_mm_storeu_ps(&r.m[4], vResult1);
+		_mm_storeu_ps(&r.m[8], vResult2);
+		_mm_storeu_ps(&r.m[12], vResult3);
+#else
 		r.m[0] = m[0] * n.m[0] + m[4] * n.m[1] + m[8] * n.m[2] + m[12] * n.m[3];
 		r.m[1] = m[1] * n.m[0] + m[5] * n.m[1] + m[9] * n.m[2] + m[13] * n.m[3];
 		r.m[2] = m[2] * n.m[0] + m[6] * n.m[1] + m[10] * n.m[2] + m[14] * n.m[3];
@@ -39,6 +244,7 @@ namespace DC
 		r.m[13] = m[1] * n.m[12] + m[5] * n.m[13] + m[9] * n.m[14] + m[13] * n.m[15];
 		r.m[14] = m[2] * n.m[12] + m[6] * n.m[13] + m[10] * n.m[14] + m[14] * n.m[15];
 		r.m[15] = m[3] * n.m[12] + m[7] * n.m[13] + m[11] * n.m[14] + m[15] * n.m[15];
+#endif
 		return r;
 	}
 
@@ -250,57 +456,125 @@ namespace DC
 	Matrix Matrix::transpose(void)
 	{
 		Matrix mt;
+#if defined(DC_SIMD_SSE4_1)
+		__m128 vCol0 = _mm_loadu_ps(&m[0]);
+		__m128 vCol1 = _mm_loadu_ps(&m[4]);
+		__m128 vCol2 = _mm_loadu_ps(&m[8]);
+		__m128 vCol3 = _mm_loadu_ps(&m[12]);
+		_MM_TRANSPOSE4_PS(vCol0, vCol1, vCol2, vCol3);
+		_mm_storeu_ps(&mt.m[0], vCol0);
+		_mm_storeu_ps(&mt.m[4], vCol1);
+		_mm_storeu_ps(&mt.m[8], vCol2);
+		_mm_storeu_ps(&mt.m[12], vCol3);
+#else
 		mt.m[0] = m[0];		mt.m[1] = m[4];		mt.m[2] = m[8];		mt.m[3] = m[12];
 		mt.m[4] = m[1];		mt.m[5] = m[5];		mt.m[6] = m[9];		mt.m[7] = m[13];
 		mt.m[8] = m[2];		mt.m[9] = m[6];		mt.m[10] = m[10];	mt.m[11] = m[14];
 		mt.m[12] = m[3];	mt.m[13] = m[7];	mt.m[14] = m[11];	mt.m[15] = m[15];
+#endif
 		return mt;
 	}
 
 	Matrix Matrix::multiply(const Matrix& n)
 	{
-		Matrix r;
-		r.m[0] = m[0] * n.m[0] + m[4] * n.m[1] + m[8] * n.m[2] + m[12] * n.m[3];
-		r.m[1] = m[1] * n.m[0] + m[5] * n.m[1] + m[9] * n.m[2] + m[13] * n.m[3];
-		r.m[2] = m[2] * n.m[0] + m[6] * n.m[1] + m[10] * n.m[2] + m[14] * n.m[3];
-		r.m[3] = m[3] * n.m[0] + m[7] * n.m[1] + m[11] * n.m[2] + m[15] * n.m[3];
-
-		r.m[4] = m[0] * n.m[4] + m[4] * n.m[5] + m[8] * n.m[6] + m[12] * n.m[7];
-		r.m[5] = m[1] * n.m[4] + m[5] * n.m[5] + m[9] * n.m[6] + m[13] * n.m[7];
-		r.m[6] = m[2] * n.m[4] + m[6] * n.m[5] + m[10] * n.m[6] + m[14] * n.m[7];
-		r.m[7] = m[3] * n.m[4] + m[7] * n.m[5] + m[11] * n.m[6] + m[15] * n.m[7];
-
-		r.m[8] = m[0] * n.m[8] + m[4] * n.m[9] + m[8] * n.m[10] + m[12] * n.m[11];
-		r.m[9] = m[1] * n.m[8] + m[5] * n.m[9] + m[9] * n.m[10] + m[13] * n.m[11];
-		r.m[10] = m[2] * n.m[8] + m[6] * n.m[9] + m[10] * n.m[10] + m[14] * n.m[11];
-		r.m[11] = m[3] * n.m[8] + m[7] * n.m[9] + m[11] * n.m[10] + m[15] * n.m[11];
-
-		r.m[12] = m[0] * n.m[12] + m[4] * n.m[13] + m[8] * n.m[14] + m[12] * n.m[15];
-		r.m[13] = m[1] * n.m[12] + m[5] * n.m[13] + m[9] * n.m[14] + m[13] * n.m[15];
-		r.m[14] = m[2] * n.m[12] + m[6] * n.m[13] + m[10] * n.m[14] + m[14] * n.m[15];
-		r.m[15] = m[3] * n.m[12] + m[7] * n.m[13] + m[11] * n.m[14] + m[15] * n.m[15];
-		return r;
+		return *this * n;
 	}
 
 	Vector3f Matrix::multiply(const Vector3f& v)
 	{
 		Vector3f r;
+#if defined(DC_SIMD_SSE4_1)
+		__m128 vResult = _mm_mul_ps(_mm_loadu_ps(&m[0]), _mm_set1_ps(v.x));
+		vResult = _mm_add_ps(vResult, _mm_mul_ps(_mm_loadu_ps(&m[4]), _mm_set1_ps(v.y)));
+		vResult = _mm_add_ps(vResult, _mm_mul_ps(_mm_loadu_ps(&m[8]), _mm_set1_ps(v.z)));
+		vResult = _mm_add_ps(vResult, _mm_loadu_ps(&m[12]));
+		r.x = _mm_cvtss_f32(vResult);
+		r.y = _mm_cvtss_f32(_mm_shuffle_ps(vResult, vResult, _MM_SHUFFLE(1, 1, 1, 1)));
+		r.z = _mm_cvtss_f32(_mm_movehl_ps(vResult, vResult));
+#else
 		r.x = m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12];
 		r.y = m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13];
 		r.z = m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14];
+#endif
 		return r;
 	}
 
 	Matrix Matrix::multiply(const float scalar)
 	{
 		Matrix r = *this;
+#if defined(DC_SIMD_SSE4_1)
+		__m128 vScalar = _mm_set1_ps(scalar);
+		for (int i = 0; i < 16; i += 4)
+			_mm_storeu_ps(&r.m[i], _mm_mul_ps(_mm_loadu_ps(&m[i]), vScalar));
+#else
 		r.m[0] *= scalar;	r.m[1] *= scalar;	r.m[2] *= scalar;	r.m[3] *= scalar;
 		r.m[4] *= scalar;	r.m[5] *= scalar;	r.m[6] *= scalar;	r.m[7] *= scalar;
 		r.m[8] *= scalar;	r.m[9] *= scalar;	r.m[10] *= scalar;	r.m[11] *= scalar;
 		r.m[12] *= scalar;	r.m[13] *= scalar;	r.m[14] *= scalar;	r.m[15] *= scalar;
+#endif
 		return r;
 	}
 
+	void Matrix::transformPoints(std::span<const Vector3f> pointsPARAM, std::span<Vector3f> pointsOutPARAM, unsigned int numThreadsPARAM) const
+	{
+		ErrorIfTrue(pointsOutPARAM.size() != pointsPARAM.size(), L"Matrix::transformPoints() failed. The given output is not the same size as the given points.");
+		runInChunks(pointsPARAM.size(), numThreadsPARAM, kMinVectorsPerThread, 8, [&](size_t firstPoint, size_t numPoints)
+			{
+				transformVector3fs<true>(m, pointsPARAM.data() + firstPoint, pointsOutPARAM.data() + firstPoint, numPoints);
+			});
+	}
+
+	void Matrix::transformPoints(std::span<const float> xPARAM, std::span<const float> yPARAM, std::span<const float> zPARAM, std::span<float> xOutPARAM, std::span<float> yOutPARAM, std::span<float> zOutPARAM, unsigned int numThreadsPARAM) const
+	{
+		size_t numPoints = xPARAM.size();
+		ErrorIfTrue(yPARAM.size() != numPoints || zPARAM.size() != numPoints, L"Matrix::transformPoints() failed. The given x, y and z components are not all the same size.");
+		ErrorIfTrue(xOutPARAM.size() != numPoints || yOutPARAM.size() != numPoints || zOutPARAM.size() != numPoints, L"Matrix::transformPoints() failed. The given output is not the same size as the given points.");
+		runInChunks(numPoints, numThreadsPARAM, kMinVectorsPerThread, 8, [&](size_t firstPoint, size_t numPointsInChunk)
+			{
+				transformPointComponents(m, xPARAM.data() + firstPoint, yPARAM.data() + firstPoint, zPARAM.data() + firstPoint,
+					xOutPARAM.data() + firstPoint, yOutPARAM.data() + firstPoint, zOutPARAM.data() + firstPoint, numPointsInChunk);
+			});
+	}
+
+	void Matrix::transformDirections(std::span<const Vector3f> directionsPARAM, std::span<Vector3f> directionsOutPARAM, unsigned int numThreadsPARAM) const
+	{
+		ErrorIfTrue(directionsOutPARAM.size() != directionsPARAM.size(), L"Matrix::transformDirections() failed. The given output is not the same size as the given directions.");
+		runInChunks(directionsPARAM.size(), numThreadsPARAM, kMinVectorsPerThread, 8, [&](size_t firstDirection, size_t numDirections)
+			{
+				transformVector3fs<false>(m, directionsPARAM.data() + firstDirection, directionsOutPARAM.data() + firstDirection, numDirections);
+			});
+	}
+
+	void Matrix::transformVectors(std::span<const Vector4f> vectorsPARAM, std::span<Vector4f> vectorsOutPARAM, unsigned int numThreadsPARAM) const
+	{
+		ErrorIfTrue(vectorsOutPARAM.size() != vectorsPARAM.size(), L"Matrix::transformVectors() failed. The given output is not the same size as the given vectors.");
+		runInChunks(vectorsPARAM.size(), numThreadsPARAM, kMinVectorsPerThread, 8, [&](size_t firstVector, size_t numVectors)
+			{
+				transformVector4fs(m, vectorsPARAM.data() + firstVector, vectorsOutPARAM.data() + firstVector, numVectors);
+			});
+	}
+
+	void Matrix::multiplyHierarchy(std::span<const Matrix> localMatricesPARAM, std::span<const int> parentIndiciesPARAM, std::span<Matrix> matricesOutPARAM)
+	{
+		ErrorIfTrue(parentIndiciesPARAM.size() != localMatricesPARAM.size(), L"Matrix::multiplyHierarchy() failed. The given parent indicies are not the same size as the given local matrices.");
+		ErrorIfTrue(matricesOutPARAM.size() != localMatricesPARAM.size(), L"Matrix::multiplyHierarchy() failed. The given output is not the same size as the given local matrices.");
+		// If the output started part way through the local matrices, a bone's local matrix would be overwritten before it's used
+		const Matrix* pLocal = localMatricesPARAM.data();
+		const Matrix* pOut = matricesOutPARAM.data();
+		ErrorIfTrue(pOut != pLocal && pOut < pLocal + localMatricesPARAM.size() && pLocal < pOut + matricesOutPARAM.size(), L"Matrix::multiplyHierarchy() failed. The given output overlaps the given local matrices without being the same as them.");
+		for (size_t i = 0; i < localMatricesPARAM.size(); i++)
+		{
+			int parentIndex = parentIndiciesPARAM[i];
+			if (parentIndex < 0)
+			{
+				matricesOutPARAM[i] = localMatricesPARAM[i];
+				continue;
+			}
+			ErrorIfTrue((size_t)parentIndex >= i, L"Matrix::multiplyHierarchy() failed. A parent index was not less than the index of it's child.");
+			matricesOutPARAM[i] = matricesOutPARAM[parentIndex] * localMatricesPARAM[i];
+		}
+	}
+
 	void Matrix::setProjectionPerspective(
 		float fieldOfViewInDegrees,
 		float nearClippingPlaneDistance,
@@ -408,6 +682,62 @@ namespace DC
 
 	Matrix Matrix::inverse(void)
 	{
+		// Both code paths below compute the same values in the same order, so the results are exactly the same.
+		// The 2x2 determinants made from the bottom two rows are computed first (The coefXX values), these are combined into
+		// the cofactors and divided by the determinant of the matrix, which is the dot product of the first column and the
+		// first row of the cofactors.
+#if defined(DC_SIMD_SSE4_1)
+		// Each of these holds one of the rows of the matrix
+		__m128 vRow0 = _mm_loadu_ps(&m[0]);
+		__m128 vRow1 = _mm_loadu_ps(&m[4]);
+		__m128 vRow2 = _mm_loadu_ps(&m[8]);
+		__m128 vRow3 = _mm_loadu_ps(&m[12]);
+		_MM_TRANSPOSE4_PS(vRow0, vRow1, vRow2, vRow3);
+
+		// The 2x2 determinants, each of them made from two of the rows and the columns (2,3), (2,3), (1,3) and (1,2).
+		// fac0 is made from rows 2 and 3, fac1 from rows 1 and 3 and so on, the same as the scalar code.
+		__m128 vRow0Left = _mm_shuffle_ps(vRow0, vRow0, _MM_SHUFFLE(1, 1, 2, 2));
+		__m128 vRow1Left = _mm_shuffle_ps(vRow1, vRow1, _MM_SHUFFLE(1, 1, 2, 2));
+		__m128 vRow2Left = _mm_shuffle_ps(vRow2, vRow2, _MM_SHUFFLE(1, 1, 2, 2));
+		__m128 vRow3Left = _mm_shuffle_ps(vRow3, vRow3, _MM_SHUFFLE(1, 1, 2, 2));
+		__m128 vRow0Right = _mm_shuffle_ps(vRow0, vRow0, _MM_SHUFFLE(2, 3, 3, 3));
+		__m128 vRow1Right = _mm_shuffle_ps(vRow1, vRow1, _MM_SHUFFLE(2, 3, 3, 3));
+		__m128 vRow2Right = _mm_shuffle_ps(vRow2, vRow2, _MM_SHUFFLE(2, 3, 3, 3));
+		__m128 vRow3Right = _mm_shuffle_ps(vRow3, vRow3, _MM_SHUFFLE(2, 3, 3, 3));
+		__m128 vFac0 = _mm_sub_ps(_mm_mul_ps(vRow2Left, vRow3Right), _mm_mul_ps(vRow2Right, vRow3Left));
+		__m128 vFac1 = _mm_sub_ps(_mm_mul_ps(vRow1Left, vRow3Right), _mm_mul_ps(vRow1Right, vRow3Left));
+		__m128 vFac2 = _mm_sub_ps(_mm_mul_ps(vRow1Left, vRow2Right), _mm_mul_ps(vRow1Right, vRow2Left));
+		__m128 vFac3 = _mm_sub_ps(_mm_mul_ps(vRow0Left, vRow3Right), _mm_mul_ps(vRow0Right, vRow3Left));
+		__m128 vFac4 = _mm_sub_ps(_mm_mul_ps(vRow0Left, vRow2Right), _mm_mul_ps(vRow0Right, vRow2Left));
+		__m128 vFac5 = _mm_sub_ps(_mm_mul_ps(vRow0Left, vRow1Right), _mm_mul_ps(vRow0Right, vRow1Left));
+
+		__m128 vVec0 = _mm_shuffle_ps(vRow0, vRow0, _MM_SHUFFLE(0, 0, 0, 1));
+		__m128 vVec1 = _mm_shuffle_ps(vRow1, vRow1, _MM_SHUFFLE(0, 0, 0, 1));
+		__m128 vVec2 = _mm_shuffle_ps(vRow2, vRow2, _MM_SHUFFLE(0, 0, 0, 1));
+		__m128 vVec3 = _mm_shuffle_ps(vRow3, vRow3, _MM_SHUFFLE(0, 0, 0, 1));
+
+		__m128 vSignA = _mm_set_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+		__m128 vSignB = _mm_set_ps(1.0f, -1.0f, 1.0f, -1.0f);
+		__m128 vInv0 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(vVec1, vFac0), _mm_mul_ps(vVec2, vFac1)), _mm_mul_ps(vVec3, vFac2));
+		__m128 vInv1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(vVec0, vFac0), _mm_mul_ps(vVec2, vFac3)), _mm_mul_ps(vVec3, vFac4));
+		__m128 vInv2 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(vVec0, vFac1), _mm_mul_ps(vVec1, vFac3)), _mm_mul_ps(vVec3, vFac5));
+		__m128 vInv3 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(vVec0, vFac2), _mm_mul_ps(vVec1, vFac4)), _mm_mul_ps(vVec2, vFac5));
+		vInv0 = _mm_mul_ps(vInv0, vSignA);
+		vInv1 = _mm_mul_ps(vInv1, vSignB);
+		vInv2 = _mm_mul_ps(vInv2, vSignA);
+		vInv3 = _mm_mul_ps(vInv3, vSignB);
+
+		// _mm_dp_ps() sums the products as (x + y) + (z + w), the same as the scalar code
+		__m128 vFirstRow = _mm_movelh_ps(_mm_unpacklo_ps(vInv0, vInv1), _mm_unpacklo_ps(vInv2, vInv3));
+		__m128 vDeterminant = _mm_dp_ps(_mm_loadu_ps(&m[0]), vFirstRow, 0xFF);
+		__m128 vOneOverDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), vDeterminant);
+		Matrix matinv;
+		_mm_storeu_ps(&matinv.m[0], _mm_mul_ps(vInv0, vOneOverDeterminant));
+		_mm_storeu_ps(&matinv.m[4], _mm_mul_ps(vInv1, vOneOverDeterminant));
+		_mm_storeu_ps(&matinv.m[8], _mm_mul_ps(vInv2, vOneOverDeterminant));
+		_mm_storeu_ps(&matinv.m[12], _mm_mul_ps(vInv3, vOneOverDeterminant));
+		return matinv;
+#else
 		float coef00 = m[10] * m[15] - m[14] * m[11];
 		float coef02 = m[6] * m[15] - m[14] * m[7];
 		float coef03 = m[6] * m[11] - m[10] * m[7];
@@ -458,10 +788,12 @@ namespace DC
 		matinv.m[12] = vResult3.x;	matinv.m[13] = vResult3.y;	matinv.m[14] = vResult3.z;	matinv.m[15] = vResult3.w;
 
 		Vector4f row0(matinv.m[0], matinv.m[4], matinv.m[8], matinv.m[12]);
-		Vector4f dot0 = row0 * m[0];
+		Vector4f col0(m[0], m[1], m[2], m[3]);
+		Vector4f dot0 = row0 * col0;
 		float fDot1 = (dot0.x + dot0.y) + (dot0.z + dot0.w);
 		float fOneOverDeterminant = 1.0f / fDot1;
 		return matinv.multiply(fOneOverDeterminant);
+#endif
 	}
 
 	Vector3f Matrix::getTranslation(void) const
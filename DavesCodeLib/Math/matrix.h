@@ -1,6 +1,8 @@
 ﻿#pragma once
 #include "vector3f.h"
+#include "vector4f.h"
 #include "quaternion.h"
+#include <span>
 
 namespace DC
 {
@@ -62,10 +64,14 @@ namespace DC
 	// Remember that the order of matrix multiplication is important and we go from right to left, like this in a shader...
 	// gl_Position = projectionMatrix * viewMatrix * modelMatrix * in_Position;
 	// 
+	// Multiplication, inverse() and transpose() use SSE4.1 or AVX2 instructions, see simd.h for how to choose which.
+	// The results are exactly the same as the scalar code's, whichever is used.
+	// 
 	class Matrix
 	{
 	public:
 		friend class Quaternion;
+		friend class Matrixd;
 
 		// Default constructor, sets to identity matrix
 		Matrix();
@@ -166,6 +172,42 @@ namespace DC
 		// Multiplies each value in the matrix by the given scalar and returns the resulting matrix
 		Matrix multiply(const float scalar);
 
+		// The methods below transform lots of vectors by this matrix in one go, which is much faster than calling
+		// multiply() for each one, as the matrix is only loaded once and the vectors are transformed several at a
+		// time with SIMD instructions.
+		// The output must be the same size as the input. It may be the same as the input, to transform the vectors
+		// in place, but must not otherwise overlap it.
+		// numThreads is the maximum number of threads to split the vectors between, 0 uses as many as there are
+		// hardware threads. Threads are only used for very large numbers of vectors, as otherwise starting them
+		// takes longer than transforming the vectors.
+		// Example:
+		// std::vector<Vector3f> positions;
+		// matrix.transformPoints(positions, positions);
+
+		// Transforms each of the given points, the same as multiply(const Vector3f&) does, so they are translated
+		// as well as rotated and scaled.
+		void transformPoints(std::span<const Vector3f> points, std::span<Vector3f> pointsOut, unsigned int numThreads = 1) const;
+
+		// The same as the above, except the points are given as seperate arrays of their x, y and z components.
+		// This is faster still, as the components don't need to be shuffled into SIMD registers.
+		void transformPoints(std::span<const float> x, std::span<const float> y, std::span<const float> z, std::span<float> xOut, std::span<float> yOut, std::span<float> zOut, unsigned int numThreads = 1) const;
+
+		// Transforms each of the given directions, such as normals, which are rotated and scaled, but not translated.
+		void transformDirections(std::span<const Vector3f> directions, std::span<Vector3f> directionsOut, unsigned int numThreads = 1) const;
+
+		// Transforms each of the given vectors by the whole of this matrix, including their w components.
+		void transformVectors(std::span<const Vector4f> vectors, std::span<Vector4f> vectorsOut, unsigned int numThreads = 1) const;
+
+		// Computes the model space matrix of each bone of a skeleton, or each node of any other hierarchy, from
+		// their matrices relative to their parent.
+		// parentIndicies holds the index of each bone's parent, or -1 for a bone with no parent, and each bone's
+		// parent must come before it, so each model space matrix is the parent's model space matrix multiplied by
+		// the bone's local matrix.
+		// matricesOut must be the same size as localMatrices. It may be the same as localMatrices, to compute the
+		// matrices in place, but must not otherwise overlap it.
+		// If a bone's parent doesn't come before it, or matricesOut partly overlaps localMatrices, an exception occurs.
+		static void multiplyHierarchy(std::span<const Matrix> localMatrices, std::span<const int> parentIndicies, std::span<Matrix> matricesOut);
+
 		// Sets the matrix to represent a perspective projection matrix
 		// Aspect ration is width / height of whatever we're rendering to
 		void setProjectionPerspective(
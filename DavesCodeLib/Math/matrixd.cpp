@@ -0,0 +1,352 @@
+#include "matrixd.h"
+#include <cmath>
+#include <cstring>
+#include "mathUtilities.h"
+#include "../Common/error.h"
+#include "../Common/multithreading.h"
+#include "simd.h"
+
+namespace DC
+{
+	namespace
+	{
+		// The fewest matrices getRelativeTo() gives to each thread, as with fewer than this, starting the
+		// thread takes longer than converting them.
+		const size_t kMinMatricesPerThread = 8192;
+	}
+
+	Matrixd::Matrixd()
+	{
+		setIdentity();
+	}
+
+	const void Matrixd::operator =(const Matrixd& matrix)
+	{
+		memcpy(m, matrix.m, sizeof(double[16]));
+	}
+
+	const Matrixd Matrixd::operator *(const Matrixd& n) const
+	{
+		Matrixd r;
+		r.m[0] = m[0] * n.m[0] + m[4] * n.m[1] + m[8] * n.m[2] + m[12] * n.m[3];
+		r.m[1] = m[1] * n.m[0] + m[5] * n.m[1] + m[9] * n.m[2] + m[13] * n.m[3];
+		r.m[2] = m[2] * n.m[0] + m[6] * n.m[1] + m[10] * n.m[2] + m[14] * n.m[3];
+		r.m[3] = m[3] * n.m[0] + m[7] * n.m[1] + m[11] * n.m[2] + m[15] * n.m[3];
+
+		r.m[4] = m[0] * n.m[4] + m[4] * n.m[5] + m[8] * n.m[6] + m[12] * n.m[7];
+		r.m[5] = m[1] * n.m[4] + m[5] * n.m[5] + m[9] * n.m[6] + m[13] * n.m[7];
+		r.m[6] = m[2] * n.m[4] + m[6] * n.m[5] + m[10] * n.m[6] + m[14] * n.m[7];
+		r.m[7] = m[3] * n.m[4] + m[7] * n.m[5] + m[11] * n.m[6] + m[15] * n.m[7];
+
+		r.m[8] = m[0] * n.m[8] + m[4] * n.m[9] + m[8] * n.m[10] + m[12] * n.m[11];
+		r.m[9] = m[1] * n.m[8] + m[5] * n.m[9] + m[9] * n.m[10] + m[13] * n.m[11];
+		r.m[10] = m[2] * n.m[8] + m[6] * n.m[9] + m[10] * n.m[10] + m[14] * n.m[11];
+		r.m[11] = m[3] * n.m[8] + m[7] * n.m[9] + m[11] * n.m[10] + m[15] * n.m[11];
+
+		r.m[12] = m[0] * n.m[12] + m[4] * n.m[13] + m[8] * n.m[14] + m[12] * n.m[15];
+		r.m[13] = m[1] * n.m[12] + m[5] * n.m[13] + m[9] * n.m[14] + m[13] * n.m[15];
+		r.m[14] = m[2] * n.m[12] + m[6] * n.m[13] + m[10] * n.m[14] + m[14] * n.m[15];
+		r.m[15] = m[3] * n.m[12] + m[7] * n.m[13] + m[11] * n.m[14] + m[15] * n.m[15];
+		return r;
+	}
+
+	const void Matrixd::operator *= (const Matrixd& n)
+	{
+		*this = *this * n;
+	}
+
+	bool Matrixd::operator==(const Matrixd& n) const
+	{
+		return	(m[0] == n.m[0]) && (m[1] == n.m[1]) && (m[2] == n.m[2]) && (m[3] == n.m[3]) &&
+			(m[4] == n.m[4]) && (m[5] == n.m[5]) && (m[6] == n.m[6]) && (m[7] == n.m[7]) &&
+			(m[8] == n.m[8]) && (m[9] == n.m[9]) && (m[10] == n.m[10]) && (m[11] == n.m[11]) &&
+			(m[12] == n.m[12]) && (m[13] == n.m[13]) && (m[14] == n.m[14]) && (m[15] == n.m[15]);
+	}
+
+	bool Matrixd::operator!=(const Matrixd& n) const
+	{
+		return	(m[0] != n.m[0]) || (m[1] != n.m[1]) || (m[2] != n.m[2]) || (m[3] != n.m[3]) ||
+			(m[4] != n.m[4]) || (m[5] != n.m[5]) || (m[6] != n.m[6]) || (m[7] != n.m[7]) ||
+			(m[8] != n.m[8]) || (m[9] != n.m[9]) || (m[10] != n.m[10]) || (m[11] != n.m[11]) ||
+			(m[12] != n.m[12]) || (m[13] != n.m[13]) || (m[14] != n.m[14]) || (m[15] != n.m[15]);
+	}
+
+	void Matrixd::setIdentity(void)
+	{
+		m[0] = m[5] = m[10] = m[15] = 1.0;
+		m[1] = m[2] = m[3] = m[4] = m[6] = m[7] = m[8] = m[9] = m[11] = m[12] = m[13] = m[14] = 0.0;
+	}
+
+	void Matrixd::setZero(void)
+	{
+		m[0] = m[1] = m[2] = m[3] = m[4] = m[5] = m[6] = m[7] = m[8] = m[9] = m[10] = m[11] = m[12] = m[13] = m[14] = m[15] = 0.0;
+	}
+
+	void Matrixd::set(const double src[16])
+	{
+		memcpy(m, src, sizeof(double[16]));
+	}
+
+	void Matrixd::set(const Matrixd& src)
+	{
+		memcpy(m, src.m, sizeof(double[16]));
+	}
+
+	void Matrixd::set(const Matrix& src)
+	{
+		for (int i = 0; i < 16; i++)
+			m[i] = src.m[i];
+	}
+
+	void Matrixd::setTranslation(double X, double Y, double Z)
+	{
+		m[12] = X;
+		m[13] = Y;
+		m[14] = Z;
+	}
+
+	void Matrixd::setTranslation(const Vector3d& translation)
+	{
+		m[12] = translation.x;
+		m[13] = translation.y;
+		m[14] = translation.z;
+	}
+
+	void Matrixd::setScale(double X, double Y, double Z)
+	{
+		m[0] = X;
+		m[5] = Y;
+		m[10] = Z;
+	}
+
+	void Matrixd::setScale(const Vector3d& scale)
+	{
+		m[0] = scale.x;
+		m[5] = scale.y;
+		m[10] = scale.z;
+	}
+
+	void Matrixd::setFromAxisAngleDegrees(const Vector3d& axis, double angleDegrees)
+	{
+		setFromAxisAngleRadians(axis, deg2rad(angleDegrees));
+	}
+
+	void Matrixd::setFromAxisAngleRadians(const Vector3d& axis, double angleRadians)
+	{
+		double dCos = cos(angleRadians);
+		double dSin = sin(angleRadians);
+		double dOMC = 1.0 - dCos;
+
+		m[0] = dCos + (axis.x * axis.x) * dOMC;
+		m[5] = dCos + (axis.y * axis.y) * dOMC;
+		m[10] = dCos + (axis.z * axis.z) * dOMC;
+		m[15] = 1.0;
+		m[4] = axis.x * axis.y * dOMC + axis.z * dSin;
+		m[1] = axis.x * axis.y * dOMC - axis.z * dSin;
+		m[8] = axis.x * axis.z * dOMC + axis.y * dSin;
+		m[2] = axis.x * axis.z * dOMC - axis.y * dSin;
+		m[9] = axis.y * axis.z * dOMC + axis.x * dSin;
+		m[6] = axis.y * axis.z * dOMC - axis.x * dSin;
+	}
+
+	void Matrixd::setFromQuaternion(const Quaternion& quaternion)
+	{
+		double x = quaternion.q[0];
+		double y = quaternion.q[1];
+		double z = quaternion.q[2];
+		double w = quaternion.q[3];
+		m[0] = 1.0 - 2.0 * (y * y + z * z);
+		m[1] = 2.0 * (x * y - z * w);
+		m[2] = 2.0 * (x * z + y * w);
+
+		m[4] = 2.0 * (x * y + z * w);
+		m[5] = 1.0 - 2.0 * (x * x + z * z);
+		m[6] = 2.0 * (y * z - x * w);
+
+		m[8] = 2.0 * (x * z - y * w);
+		m[9] = 2.0 * (y * z + x * w);
+		m[10] = 1.0 - 2.0 * (x * x + y * y);
+
+		m[15] = 1.0;
+	}
+
+	void Matrixd::getRightVector(Vector3d& vector) const
+	{
+		vector.x = m[0];
+		vector.y = m[1];
+		vector.z = m[2];
+	}
+
+	void Matrixd::getUpVector(Vector3d& vector) const
+	{
+		vector.x = m[4];
+		vector.y = m[5];
+		vector.z = m[6];
+	}
+
+	void Matrixd::getForwardVector(Vector3d& vector) const
+	{
+		vector.x = m[8];
+		vector.y = m[9];
+		vector.z = m[10];
+	}
+
+	Matrixd Matrixd::transpose(void)
+	{
+		Matrixd mt;
+		mt.m[0] = m[0];		mt.m[1] = m[4];		mt.m[2] = m[8];		mt.m[3] = m[12];
+		mt.m[4] = m[1];		mt.m[5] = m[5];		mt.m[6] = m[9];		mt.m[7] = m[13];
+		mt.m[8] = m[2];		mt.m[9] = m[6];		mt.m[10] = m[10];	mt.m[11] = m[14];
+		mt.m[12] = m[3];	mt.m[13] = m[7];	mt.m[14] = m[11];	mt.m[15] = m[15];
+		return mt;
+	}
+
+	Matrixd Matrixd::inverse(void)
+	{
+		// The same as Matrix::inverse()'s scalar code, with doubles.
+		double coef00 = m[10] * m[15] - m[14] * m[11];
+		double coef02 = m[6] * m[15] - m[14] * m[7];
+		double coef03 = m[6] * m[11] - m[10] * m[7];
+		double coef04 = m[9] * m[15] - m[13] * m[11];
+		double coef06 = m[5] * m[15] - m[13] * m[7];
+		double coef07 = m[5] * m[11] - m[9] * m[7];
+		double coef08 = m[9] * m[14] - m[13] * m[10];
+		double coef10 = m[5] * m[14] - m[13] * m[6];
+		double coef11 = m[5] * m[10] - m[9] * m[6];
+		double coef12 = m[8] * m[15] - m[12] * m[11];
+		double coef14 = m[4] * m[15] - m[12] * m[7];
+		double coef15 = m[4] * m[11] - m[8] * m[7];
+		double coef16 = m[8] * m[14] - m[12] * m[10];
+		double coef18 = m[4] * m[14] - m[12] * m[6];
+		double coef19 = m[4] * m[10] - m[8] * m[6];
+		double coef20 = m[8] * m[13] - m[12] * m[9];
+		double coef22 = m[4] * m[13] - m[12] * m[5];
+		double coef23 = m[4] * m[9] - m[8] * m[5];
+
+		double fac0[4] = { coef00, coef00, coef02, coef03 };
+		double fac1[4] = { coef04, coef04, coef06, coef07 };
+		double fac2[4] = { coef08, coef08, coef10, coef11 };
+		double fac3[4] = { coef12, coef12, coef14, coef15 };
+		double fac4[4] = { coef16, coef16, coef18, coef19 };
+		double fac5[4] = { coef20, coef20, coef22, coef23 };
+
+		double vec0[4] = { m[4], m[0], m[0], m[0] };
+		double vec1[4] = { m[5], m[1], m[1], m[1] };
+		double vec2[4] = { m[6], m[2], m[2], m[2] };
+		double vec3[4] = { m[7], m[3], m[3], m[3] };
+
+		double signA[4] = { +1, -1, +1, -1 };
+		double signB[4] = { -1, +1, -1, +1 };
+
+		Matrixd matinv;
+		for (int i = 0; i < 4; i++)
+		{
+			matinv.m[i] = (vec1[i] * fac0[i] - vec2[i] * fac1[i] + vec3[i] * fac2[i]) * signA[i];
+			matinv.m[4 + i] = (vec0[i] * fac0[i] - vec2[i] * fac3[i] + vec3[i] * fac4[i]) * signB[i];
+			matinv.m[8 + i] = (vec0[i] * fac1[i] - vec1[i] * fac3[i] + vec3[i] * fac5[i]) * signA[i];
+			matinv.m[12 + i] = (vec0[i] * fac2[i] - vec1[i] * fac4[i] + vec2[i] * fac5[i]) * signB[i];
+		}
+
+		double dDot1 = (matinv.m[0] * m[0] + matinv.m[4] * m[1]) + (matinv.m[8] * m[2] + matinv.m[12] * m[3]);
+		double dOneOverDeterminant = 1.0 / dDot1;
+		return matinv.multiply(dOneOverDeterminant);
+	}
+
+	Matrixd Matrixd::multiply(const Matrixd& n)
+	{
+		return *this * n;
+	}
+
+	Vector3d Matrixd::multiply(const Vector3d& v)
+	{
+		Vector3d r;
+		r.x = m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12];
+		r.y = m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13];
+		r.z = m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14];
+		return r;
+	}
+
+	Matrixd Matrixd::multiply(const double scalar)
+	{
+		Matrixd r = *this;
+		for (int i = 0; i < 16; i++)
+			r.m[i] *= scalar;
+		return r;
+	}
+
+	const double* Matrixd::getDouble(void) const
+	{
+		return &m[0];
+	}
+
+	Vector3d Matrixd::getTranslation(void) const
+	{
+		return Vector3d(m[12], m[13], m[14]);
+	}
+
+	Matrix Matrixd::getMatrix(void) const
+	{
+		Matrix r;
+		for (int i = 0; i < 16; i++)
+			r.m[i] = (float)m[i];
+		return r;
+	}
+
+	Matrix Matrixd::getRelativeTo(const Vector3d& origin) const
+	{
+		// This is a translation by -origin, multiplied by this matrix, so the origin times the bottom value of each column
+		// is subtracted from the top three values of the column. For the usual matrices whose bottom row is 0 0 0 1, this
+		// just subtracts the origin from the translation.
+		Matrix r;
+		for (int iColumn = 0; iColumn < 16; iColumn += 4)
+		{
+			double dW = m[iColumn + 3];
+			r.m[iColumn] = (float)(m[iColumn] - origin.x * dW);
+			r.m[iColumn + 1] = (float)(m[iColumn + 1] - origin.y * dW);
+			r.m[iColumn + 2] = (float)(m[iColumn + 2] - origin.z * dW);
+			r.m[iColumn + 3] = (float)(m[iColumn + 3] - 0.0 * dW);
+		}
+		return r;
+	}
+
+	void Matrixd::getRelativeTo(std::span<const Matrixd> matricesPARAM, const Vector3d& originPARAM, std::span<Matrix> matricesOutPARAM, unsigned int numThreadsPARAM)
+	{
+		ErrorIfTrue(matricesOutPARAM.size() != matricesPARAM.size(), L"Matrixd::getRelativeTo() failed. The given output is not the same size as the given matrices.");
+		runInChunks(matricesPARAM.size(), numThreadsPARAM, kMinMatricesPerThread, 1, [&](size_t firstMatrix, size_t numMatrices)
+			{
+				// The same as the single matrix version above, a column at a time.
+				// The bottom value of each column has zero times itself subtracted, so that all four values of the column
+				// are computed the same way.
+				const Matrixd* pMatrices = matricesPARAM.data() + firstMatrix;
+				Matrix* pMatricesOut = matricesOutPARAM.data() + firstMatrix;
+#if defined(DC_SIMD_AVX2)
+				__m256d vOrigin = _mm256_setr_pd(originPARAM.x, originPARAM.y, originPARAM.z, 0.0);
+#elif defined(DC_SIMD_SSE4_1)
+				__m128d vOriginXY = _mm_setr_pd(originPARAM.x, originPARAM.y);
+				__m128d vOriginZ0 = _mm_setr_pd(originPARAM.z, 0.0);
+#endif
+				for (size_t iMatrix = 0; iMatrix < numMatrices; iMatrix++)
+				{
+					const double* pIn = pMatrices[iMatrix].m;
+					float* pOut = pMatricesOut[iMatrix].m;
+#if defined(DC_SIMD_AVX2)
+					for (int iColumn = 0; iColumn < 16; iColumn += 4)
+					{
+						__m256d vW = _mm256_broadcast_sd(pIn + iColumn + 3);
+						_mm_storeu_ps(pOut + iColumn, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(pIn + iColumn), _mm256_mul_pd(vOrigin, vW))));
+					}
+#elif defined(DC_SIMD_SSE4_1)
+					for (int iColumn = 0; iColumn < 16; iColumn += 4)
+					{
+						__m128d vW = _mm_set1_pd(pIn[iColumn + 3]);
+						__m128 vXY = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pIn + iColumn), _mm_mul_pd(vOriginXY, vW)));
+						__m128 vZW = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pIn + iColumn + 2), _mm_mul_pd(vOriginZ0, vW)));
+						_mm_storeu_ps(pOut + iColumn, _mm_movelh_ps(vXY, vZW));
+					}
+#else
+					pMatricesOut[iMatrix] = pMatrices[iMatrix].getRelativeTo(originPARAM);
+#endif
+				}
+			});
+	}
+}
\ No newline at end of file
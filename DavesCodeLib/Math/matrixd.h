@@ -0,0 +1,135 @@
+#pragma once
+#include "matrix.h"
+#include "vector3d.h"
+#include <span>
+
+namespace DC
+{
+	// Matrix class, using doubles
+	// This is the same as Matrix, except it uses doubles, for placing objects in very large worlds, see Vector3d for why.
+	// It's column-major, the same as Matrix, so the elements of the matrix are stored like this..
+	// [ 0  4  8 12 ]
+	// [ 1  5  9 13 ]
+	// [ 2  6 10 14 ]
+	// [ 3  7 11 15 ]
+	//
+	// Use it for the model matrices of objects, then each frame, convert them to Matrix with getRelativeTo(), passing
+	// the camera's position, before multiplying them by the view matrix, which is built with the camera at the origin.
+	// Only the conversion uses SIMD instructions, the rest of the methods are plain C++.
+	//
+	// Example:
+	// std::vector<Matrixd> modelMatrices;
+	// std::vector<Matrix> relativeModelMatrices(modelMatrices.size());
+	// Each frame...
+	// Matrixd::getRelativeTo(modelMatrices, cameraPosition, relativeModelMatrices);
+	class Matrixd
+	{
+	public:
+		// Default constructor, sets to identity matrix
+		Matrixd();
+
+		// Sets this matrix to the one on the right
+		const void operator = (const Matrixd& matrix);
+
+		// Multiply this matrix by another and return the result
+		const Matrixd operator * (const Matrixd& matrix) const;
+
+		// Multiply this matrix by another
+		const void operator *= (const Matrixd& matrix);
+
+		// Compares whether this matrix and the one to the right of the == operator are equal.
+		// This is an exact compare, no teeny epsilon value.
+		bool operator==(const Matrixd& matrix) const;
+
+		// Compares whether this matrix and the one to the right of the != operator are equal.
+		// This is an exact compare, no teeny epsilon value.
+		bool operator!=(const Matrixd& matrix) const;
+
+		// Sets matrix to identity matrix
+		void setIdentity(void);
+
+		// Fills the matrix with zeros
+		void setZero(void);
+
+		// Sets this matrix from the given array of doubles
+		void set(const double src[16]);
+
+		// Sets the matrix from the one given
+		void set(const Matrixd& src);
+
+		// Sets the matrix from the one given
+		void set(const Matrix& src);
+
+		// Set the matrix to hold a translation transformation
+		void setTranslation(double X, double Y, double Z);
+
+		// Set the matrix to hold a translation transformation
+		void setTranslation(const Vector3d& translation);
+
+		// Set the matrix to hold a scale transformation
+		void setScale(double X, double Y, double Z);
+
+		// Set the matrix to hold a scale transformation
+		void setScale(const Vector3d& scale);
+
+		// Sets the matrix to hold a rotation transformation
+		// The rotation is specified from the give amount of rotation in degrees around the given axis.
+		void setFromAxisAngleDegrees(const Vector3d& axis, double angleDegrees);
+
+		// Sets the matrix to hold a rotation transformation
+		// The rotation is specified from the give amount of rotation in radians around the given axis.
+		void setFromAxisAngleRadians(const Vector3d& axis, double angleRadians);
+
+		// Sets the matrix to hold a rotation transformation from a quaternion
+		void setFromQuaternion(const Quaternion& quaternion);
+
+		// Sets the given vector to hold this matrix's right vector/axis
+		void getRightVector(Vector3d& vector) const;
+
+		// Sets the given vector to hold this matrix's up vector/axis
+		void getUpVector(Vector3d& vector) const;
+
+		// Sets the given vector to hold this matrix's forward vector/axis
+		void getForwardVector(Vector3d& vector) const;
+
+		// Returns a matrix which is the transpose of this matrix
+		Matrixd transpose(void);
+
+		// Returns a matrix which is the inverse of this matrix
+		Matrixd inverse(void);
+
+		// Multiplies this matrix by the one given and returns the resulting matrix
+		Matrixd multiply(const Matrixd& matrix);
+
+		// Multiplies the given vector by this matrix and returns the resulting vector
+		Vector3d multiply(const Vector3d& vector);
+
+		// Multiplies each value in the matrix by the given scalar and returns the resulting matrix
+		Matrixd multiply(const double scalar);
+
+		// Returns a pointer to the double array containing the matrix
+		const double* getDouble(void) const;
+
+		// Returns the current translation stored in the matrix as a Vector3d
+		Vector3d getTranslation(void) const;
+
+		// Returns this matrix as a Matrix, which loses precision if it's far from the origin.
+		Matrix getMatrix(void) const;
+
+		// Returns this matrix as a Matrix which transforms into a space whose origin is at the given position, usually
+		// the camera's, instead of the origin of the world.
+		// The translation is subtracted with doubles, so the result is as precise as a float can be, however far from
+		// the origin of the world both of them are.
+		Matrix getRelativeTo(const Vector3d& origin) const;
+
+		// The same as the above, for each of the given matrices, which is faster than calling the above for each one,
+		// as the values are converted with SIMD instructions.
+		// The results are exactly the same as the above's.
+		// matricesOut must be the same size as matrices.
+		// numThreads is the maximum number of threads to split the matrices between, 0 uses as many as there are
+		// hardware threads.
+		static void getRelativeTo(std::span<const Matrixd> matrices, const Vector3d& origin, std::span<Matrix> matricesOut, unsigned int numThreads = 1);
+	private:
+		double m[16];	// Values for the matrix
+	};
+}
\ No newline at end of file
@@ -1,10 +1,137 @@
 #include "quaternion.h"
 #include "matrix.h"
+#include "../Common/error.h"
+#include "simd.h"
 #include <cstring>
 #include <math.h>
 
 namespace DC
 {
+	namespace
+	{
+		// The number of terms of the series which slerp() uses to compute sin(interval * angle) / sin(angle)
+		const int kNumSLERPTerms = 14;
+
+		// Used to scale the last term of the series, to make up for the terms after it which aren't computed.
+		// This was found by searching for the value which gives the smallest error.
+		const float kSLERPLastTermScale = 1.90659f;
+
+		// Loads kSIMDWidth quaternions from each of the given arrays, calls computePARAM(a, b, out) with the x, y, z
+		// and w of each of them in a seperate SIMD register, then stores the kSIMDWidth results.
+		// The remaining quaternions at the end are copied into arrays of kSIMDWidth first, as loading or storing a
+		// whole register's worth of them would go past the end of the arrays.
+		template <typename Compute> void computeQuaternions(std::span<const Quaternion> quaternionsAPARAM, std::span<const Quaternion> quaternionsBPARAM, std::span<Quaternion> quaternionsOutPARAM, Compute computePARAM)
+		{
+			auto computeGroup = [&computePARAM](const Quaternion* pA, const Quaternion* pB, Quaternion* pOut)
+				{
+					SIMDFloats vA[4], vB[4], vOut[4];
+					simdLoadTransposed(pA->q, 4, vA[0], vA[1], vA[2], vA[3]);
+					simdLoadTransposed(pB->q, 4, vB[0], vB[1], vB[2], vB[3]);
+					computePARAM(vA, vB, vOut);
+					simdStoreTransposed(pOut->q, 4, vOut[0], vOut[1], vOut[2], vOut[3]);
+				};
+
+			size_t numQuaternions = quaternionsAPARAM.size();
+			size_t i = 0;
+			for (; i + kSIMDWidth <= numQuaternions; i += kSIMDWidth)
+				computeGroup(&quaternionsAPARAM[i], &quaternionsBPARAM[i], &quaternionsOutPARAM[i]);
+			if (i == numQuaternions)
+				return;
+
+			Quaternion tailA[kSIMDWidth], tailB[kSIMDWidth], tailOut[kSIMDWidth];
+			for (size_t j = i; j < numQuaternions; j++)
+			{
+				tailA[j - i] = quaternionsAPARAM[j];
+				tailB[j - i] = quaternionsBPARAM[j];
+			}
+			computeGroup(tailA, tailB, tailOut);
+			for (size_t j = i; j < numQuaternions; j++)
+				quaternionsOutPARAM[j] = tailOut[j - i];
+		}
+
+		// Sets vDotOut to the dot product of each pair of quaternions. Where it's negative, the quaternion from vB
+		// is negated, so that the interpolation takes the shortest path, and so is the dot product.
+		void simdGetDotAndFlip(const SIMDFloats vA[4], SIMDFloats vB[4], SIMDFloats& vDotOut)
+		{
+			vDotOut = simdAdd(simdAdd(simdAdd(simdMul(vA[0], vB[0]), simdMul(vA[1], vB[1])), simdMul(vA[2], vB[2])), simdMul(vA[3], vB[3]));
+			SIMDInts vSign = simdAndInts(simdCastToInts(vDotOut), simdSetInts(0x80000000u));
+			for (int i = 0; i < 4; i++)
+				vB[i] = simdCastToFloats(simdXorInts(simdCastToInts(vB[i]), vSign));
+			vDotOut = simdCastToFloats(simdXorInts(simdCastToInts(vDotOut), vSign));
+		}
+
+		// Computes sin(interval * angle) / sin(angle), where cosMinusOne is cos(angle) - 1, using the coefficients
+		// computed by slerp() from the interval.
+		SIMDFloats simdGetSLERPScale(SIMDFloats vCosMinusOne, const float coefficientsPARAM[kNumSLERPTerms], float intervalPARAM)
+		{
+			SIMDFloats vOne = simdSet(1.0f);
+			SIMDFloats vScale = vOne;
+			for (int i = kNumSLERPTerms - 1; i >= 0; i--)
+				vScale = simdAdd(vOne, simdMul(simdMul(simdSet(coefficientsPARAM[i]), vCosMinusOne), vScale));
+			return simdMul(vScale, simdSet(intervalPARAM));
+		}
+
+		// Computes the matrices of kSIMDWidth quaternions, the same as Matrix::setFromQuaternion() does for an
+		// identity matrix. The matrices' floats are written to pMatricesOut, one after the other.
+		// If pTranslations isn't zero, the translation of each matrix is then set from it, while the matrices are
+		// still in the cache.
+		void getMatricesOfGroup(const Quaternion* pQuaternionsPARAM, const Vector3f* pTranslationsPARAM, float* pMatricesOutPARAM)
+		{
+			SIMDFloats x, y, z, w;
+			simdLoadTransposed(pQuaternionsPARAM->q, 4, x, y, z, w);
+			SIMDFloats vOne = simdSet(1.0f);
+			SIMDFloats vTwo = simdSet(2.0f);
+			SIMDFloats vZero = simdSet(0.0f);
+			SIMDFloats m0 = simdSub(vOne, simdMul(vTwo, simdAdd(simdMul(y, y), simdMul(z, z))));
+			SIMDFloats m1 = simdMul(vTwo, simdSub(simdMul(x, y), simdMul(z, w)));
+			SIMDFloats m2 = simdMul(vTwo, simdAdd(simdMul(x, z), simdMul(y, w)));
+			SIMDFloats m4 = simdMul(vTwo, simdAdd(simdMul(x, y), simdMul(z, w)));
+			SIMDFloats m5 = simdSub(vOne, simdMul(vTwo, simdAdd(simdMul(x, x), simdMul(z, z))));
+			SIMDFloats m6 = simdMul(vTwo, simdSub(simdMul(y, z), simdMul(x, w)));
+			SIMDFloats m8 = simdMul(vTwo, simdSub(simdMul(x, z), simdMul(y, w)));
+			SIMDFloats m9 = simdMul(vTwo, simdAdd(simdMul(y, z), simdMul(x, w)));
+			SIMDFloats m10 = simdSub(vOne, simdMul(vTwo, simdAdd(simdMul(x, x), simdMul(y, y))));
+			simdStoreTransposed(pMatricesOutPARAM, 16, m0, m1, m2, vZero);
+			simdStoreTransposed(pMatricesOutPARAM + 4, 16, m4, m5, m6, vZero);
+			simdStoreTransposed(pMatricesOutPARAM + 8, 16, m8, m9, m10, vZero);
+			simdStoreTransposed(pMatricesOutPARAM + 12, 16, vZero, vZero, vZero, vOne);
+			if (!pTranslationsPARAM)
+				return;
+			for (size_t i = 0; i < kSIMDWidth; i++)
+			{
+				pMatricesOutPARAM[i * 16 + 12] = pTranslationsPARAM[i].x;
+				pMatricesOutPARAM[i * 16 + 13] = pTranslationsPARAM[i].y;
+				pMatricesOutPARAM[i * 16 + 14] = pTranslationsPARAM[i].z;
+			}
+		}
+
+		// Computes the matrices of all of the given quaternions with getMatricesOfGroup().
+		// The remaining quaternions at the end are copied into an array of kSIMDWidth first, so the stores don't go
+		// past the end of the matrices.
+		// Matrices are given as pointers to their floats, as Matrix::m is only accessible from Quaternion's methods.
+		void getMatrices(std::span<const Quaternion> quaternionsPARAM, const Vector3f* pTranslationsPARAM, float* pMatricesOutPARAM)
+		{
+			size_t numQuaternions = quaternionsPARAM.size();
+			size_t i = 0;
+			for (; i + kSIMDWidth <= numQuaternions; i += kSIMDWidth)
+				getMatricesOfGroup(&quaternionsPARAM[i], pTranslationsPARAM ? pTranslationsPARAM + i : 0, pMatricesOutPARAM + i * 16);
+			if (i == numQuaternions)
+				return;
+
+			Quaternion tailQuaternions[kSIMDWidth];
+			Vector3f tailTranslations[kSIMDWidth];
+			float tailMatrices[kSIMDWidth * 16];
+			for (size_t j = i; j < numQuaternions; j++)
+			{
+				tailQuaternions[j - i] = quaternionsPARAM[j];
+				if (pTranslationsPARAM)
+					tailTranslations[j - i] = pTranslationsPARAM[j];
+			}
+			getMatricesOfGroup(tailQuaternions, pTranslationsPARAM ? tailTranslations : 0, tailMatrices);
+			memcpy(pMatricesOutPARAM + i * 16, tailMatrices, (numQuaternions - i) * 16 * sizeof(float));
+		}
+	}
+
 	Quaternion::Quaternion()
 	{
 		setIdentity();
@@ -270,25 +397,25 @@ namespace DC
 
 	Quaternion Quaternion::getSLERP(const Quaternion& quaternion, float interval) const
 	{
-		Quaternion q(quaternion);
+		Quaternion quat(quaternion);
 
-		float fDot = q[0] * q.q[0] + q[1] * q.q[1] + q[2] * q.q[2] + q[3] * q.q[3];
+		float fDot = q[0] * quat.q[0] + q[1] * quat.q[1] + q[2] * quat.q[2] + q[3] * quat.q[3];
 		if (fDot < 0.0f)
 		{
-			q = q.getNegative();
+			quat = quat.getNegative();
 			fDot = -fDot;
 		}
 
 		// Inaccurate, use lerp instead
 		if (fDot < 1.00001f && fDot > 0.99999f)
 		{
-			return getLERP(q, interval);
+			return getLERP(quat, interval);
 		}
 
 		// Calculate the angle between the quaternions 
 		float fTheta = acosf(fDot);
 
-		return ((*this * sinf(fTheta * (1 - interval)) + q * sinf(fTheta * interval)) / sinf(fTheta));
+		return ((*this * sinf(fTheta * (1 - interval)) + quat * sinf(fTheta * interval)) / sinf(fTheta));
 	}
 
 	Quaternion Quaternion::getLERP(const Quaternion& quaternion, float interval) const
@@ -297,4 +424,77 @@ namespace DC
 		ret.normalise();
 		return ret;
 	}
+
+	void Quaternion::slerp(std::span<const Quaternion> quaternionsAPARAM, std::span<const Quaternion> quaternionsBPARAM, float intervalPARAM, std::span<Quaternion> quaternionsOutPARAM)
+	{
+		ErrorIfTrue(quaternionsBPARAM.size() != quaternionsAPARAM.size(), L"Quaternion::slerp() failed. The given arrays of quaternions are not the same size.");
+		ErrorIfTrue(quaternionsOutPARAM.size() != quaternionsAPARAM.size(), L"Quaternion::slerp() failed. The given output is not the same size as the given quaternions.");
+
+		// The series is 1 + b1 * (1 + b2 * (1 + b3 * ...)), where bi = (ui * interval^2 - vi) * (cos(angle) - 1).
+		// The part of each bi which only depends upon the interval is the same for every quaternion, so it's
+		// computed here, for both the interval and 1 - interval.
+		float fIntervalB = intervalPARAM;
+		float fIntervalA = 1.0f - intervalPARAM;
+		float fCoefficientsA[kNumSLERPTerms];
+		float fCoefficientsB[kNumSLERPTerms];
+		for (int i = 0; i < kNumSLERPTerms; i++)
+		{
+			float fTerm = float(i + 1);
+			float fU = 1.0f / (fTerm * (2.0f * fTerm + 1.0f));
+			float fV = fTerm / (2.0f * fTerm + 1.0f);
+			if (kNumSLERPTerms - 1 == i)
+			{
+				fU *= kSLERPLastTermScale;
+				fV *= kSLERPLastTermScale;
+			}
+			fCoefficientsA[i] = fU * fIntervalA * fIntervalA - fV;
+			fCoefficientsB[i] = fU * fIntervalB * fIntervalB - fV;
+		}
+
+		computeQuaternions(quaternionsAPARAM, quaternionsBPARAM, quaternionsOutPARAM, [&](const SIMDFloats vA[4], SIMDFloats vB[4], SIMDFloats vOut[4])
+			{
+				SIMDFloats vDot;
+				simdGetDotAndFlip(vA, vB, vDot);
+				SIMDFloats vCosMinusOne = simdSub(vDot, simdSet(1.0f));
+				SIMDFloats vScaleA = simdGetSLERPScale(vCosMinusOne, fCoefficientsA, fIntervalA);
+				SIMDFloats vScaleB = simdGetSLERPScale(vCosMinusOne, fCoefficientsB, fIntervalB);
+				for (int i = 0; i < 4; i++)
+					vOut[i] = simdAdd(simdMul(vA[i], vScaleA), simdMul(vB[i], vScaleB));
+			});
+	}
+
+	void Quaternion::nlerp(std::span<const Quaternion> quaternionsAPARAM, std::span<const Quaternion> quaternionsBPARAM, float intervalPARAM, std::span<Quaternion> quaternionsOutPARAM)
+	{
+		ErrorIfTrue(quaternionsBPARAM.size() != quaternionsAPARAM.size(), L"Quaternion::nlerp() failed. The given arrays of quaternions are not the same size.");
+		ErrorIfTrue(quaternionsOutPARAM.size() != quaternionsAPARAM.size(), L"Quaternion::nlerp() failed. The given output is not the same size as the given quaternions.");
+		computeQuaternions(quaternionsAPARAM, quaternionsBPARAM, quaternionsOutPARAM, [intervalPARAM](const SIMDFloats vA[4], SIMDFloats vB[4], SIMDFloats vOut[4])
+			{
+				SIMDFloats vDot;
+				simdGetDotAndFlip(vA, vB, vDot);
+				SIMDFloats vInterval = simdSet(intervalPARAM);
+				for (int i = 0; i < 4; i++)
+					vOut[i] = simdAdd(simdMul(simdSub(vB[i], vA[i]), vInterval), vA[i]);
+				SIMDFloats vMagnitudeSquared = simdAdd(simdAdd(simdAdd(simdMul(vOut[0], vOut[0]), simdMul(vOut[1], vOut[1])), simdMul(vOut[2], vOut[2])), simdMul(vOut[3], vOut[3]));
+				SIMDFloats vReciprocal = simdDiv(simdSet(1.0f), simdSqrt(vMagnitudeSquared));
+				for (int i = 0; i < 4; i++)
+					vOut[i] = simdMul(vOut[i], vReciprocal);
+			});
+	}
+
+	void Quaternion::getMatrices(std::span<const Quaternion> quaternionsPARAM, std::span<Matrix> matricesOutPARAM)
+	{
+		ErrorIfTrue(matricesOutPARAM.size() != quaternionsPARAM.size(), L"Quaternion::getMatrices() failed. The given output is not the same size as the given quaternions.");
+		if (quaternionsPARAM.empty())
+			return;
+		DC::getMatrices(quaternionsPARAM, 0, matricesOutPARAM[0].m);
+	}
+
+	void Quaternion::getMatrices(std::span<const Quaternion> quaternionsPARAM, std::span<const Vector3f> translationsPARAM, std::span<Matrix> matricesOutPARAM)
+	{
+		ErrorIfTrue(translationsPARAM.size() != quaternionsPARAM.size(), L"Quaternion::getMatrices() failed. The given translations are not the same size as the given quaternions.");
+		ErrorIfTrue(matricesOutPARAM.size() != quaternionsPARAM.size(), L"Quaternion::getMatrices() failed. The given output is not the same size as the given quaternions.");
+		if (quaternionsPARAM.empty())
+			return;
+		DC::getMatrices(quaternionsPARAM, translationsPARAM.data(), matricesOutPARAM[0].m);
+	}
 }
\ No newline at end of file
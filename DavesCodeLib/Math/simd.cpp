@@ -0,0 +1,87 @@
+#include "simd.h"
+#include <atomic>
+#if !defined(DC_SIMD_SCALAR)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace DC
+{
+	namespace
+	{
+		// The instruction set which simdLimitInstructionSet() was last given
+		std::atomic<SIMDInstructionSet> instructionSetLimit(SIMDInstructionSet::AVX2);
+
+#if !defined(DC_SIMD_SCALAR)
+		// Sets registersPARAM to EAX, EBX, ECX and EDX, as returned by the cpuid instruction for the given leaf and subleaf
+		void getCPUID(unsigned int leafPARAM, unsigned int subleafPARAM, unsigned int registersPARAM[4])
+		{
+#if defined(_MSC_VER)
+			int registers[4];
+			__cpuidex(registers, (int)leafPARAM, (int)subleafPARAM);
+			for (int i = 0; i < 4; i++)
+				registersPARAM[i] = (unsigned int)registers[i];
+#else
+			__cpuid_count(leafPARAM, subleafPARAM, registersPARAM[0], registersPARAM[1], registersPARAM[2], registersPARAM[3]);
+#endif
+		}
+
+		// Returns the lowest 32 bits of the XCR0 register, which says which registers the operating system saves when
+		// switching between threads
+		unsigned int getXCR0(void)
+		{
+#if defined(_MSC_VER)
+			return (unsigned int)_xgetbv(0);
+#else
+			unsigned int eax, edx;
+			__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return eax;
+#endif
+		}
+#endif
+
+		// Returns the best instruction set which the CPU and operating system support
+		SIMDInstructionSet findInstructionSet(void)
+		{
+#if defined(DC_SIMD_SCALAR)
+			return SIMDInstructionSet::SCALAR;
+#else
+			unsigned int registers[4];
+			getCPUID(0, 0, registers);
+			unsigned int maxLeaf = registers[0];
+			if (maxLeaf < 1)
+				return SIMDInstructionSet::SCALAR;
+
+			getCPUID(1, 0, registers);
+			bool bSSE4_1 = 0 != (registers[2] & (1u << 19));
+			bool bOSXSAVE = 0 != (registers[2] & (1u << 27));
+			bool bAVX = 0 != (registers[2] & (1u << 28));
+			if (!bSSE4_1)
+				return SIMDInstructionSet::SCALAR;
+
+			// AVX2 also needs the operating system to save the upper halves of the YMM registers, as well as the XMM ones
+			if (maxLeaf < 7 || !bOSXSAVE || !bAVX || (getXCR0() & 6) != 6)
+				return SIMDInstructionSet::SSE4_1;
+			getCPUID(7, 0, registers);
+			if (0 == (registers[1] & (1u << 5)))
+				return SIMDInstructionSet::SSE4_1;
+			return SIMDInstructionSet::AVX2;
+#endif
+		}
+	}
+
+	SIMDInstructionSet simdGetInstructionSet(void)
+	{
+		static const SIMDInstructionSet instructionSet = findInstructionSet();
+		SIMDInstructionSet limit = instructionSetLimit.load(std::memory_order_relaxed);
+		return instructionSet < limit ? instructionSet : limit;
+	}
+
+	void simdLimitInstructionSet(SIMDInstructionSet instructionSetPARAM)
+	{
+		instructionSetLimit.store(instructionSetPARAM, std::memory_order_relaxed);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,246 @@
+#pragma once
+
+// Selects which instruction set the Math and Image classes use for their SIMD code paths.
+// This is decided at compile time, by adding one of the following to the project's preprocessor definitions...
+// DC_SIMD_AVX2		Uses AVX2, where it helps, and SSE4.1 everywhere else. The project must also be compiled with /arch:AVX2.
+// DC_SIMD_SCALAR	Uses no SIMD instructions at all, just plain C++.
+// If neither is defined, SSE4.1 is used, which is supported by every x64 CPU from the last 15 years or so.
+//
+// FMA instructions are never used, even with DC_SIMD_AVX2, as they round differently and the results would
+// no longer be the same as the scalar code's.
+// The layout of the classes is the same whichever is used, so a Matrix is still 16 floats in column major order.
+//
+// A few places, such as Image2D's colour operations, also have an AVX2 version which is compiled whichever is used and
+// chosen while the program is running, see simdGetInstructionSet(). Functions which use AVX2 without DC_SIMD_AVX2
+// must be marked with DC_SIMD_TARGET_AVX2, which lets compilers other than MSVC use AVX2 instructions within them.
+#if defined(DC_SIMD_SCALAR)
+#elif defined(DC_SIMD_AVX2)
+#define DC_SIMD_SSE4_1
+#include <immintrin.h>
+#else
+#define DC_SIMD_SSE4_1
+#include <immintrin.h>
+#endif
+#if defined(DC_SIMD_AVX2) || defined(_MSC_VER)
+#define DC_SIMD_TARGET_AVX2
+#else
+#define DC_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#include <bit>
+#include <cmath>
+#include <cstddef>
+
+namespace DC
+{
+	// The instruction sets which code can choose between while the program is running.
+	// simdGetInstructionSet() returns the best one which the CPU and operating system support, which is found with the
+	// cpuid instruction the first time it's called. With DC_SIMD_SCALAR, it's always SCALAR.
+	// The rest of the SIMD code is chosen when it's compiled, so a build without DC_SIMD_SCALAR still needs SSE4.1.
+	// simdLimitInstructionSet() stops simdGetInstructionSet() returning anything better than the given instruction set,
+	// so that the tests and benchmarks can compare each of the code paths on the same CPU.
+	enum class SIMDInstructionSet
+	{
+		SCALAR,
+		SSE4_1,
+		AVX2
+	};
+	SIMDInstructionSet simdGetInstructionSet(void);
+	void simdLimitInstructionSet(SIMDInstructionSet instructionSet);
+
+	// A few wrappers around the instruction set chosen above, so that code which works on lots of floats at once
+	// only needs writing once. SIMDFloats holds kSIMDWidth floats. With DC_SIMD_SCALAR, it's just a float.
+	// simdLoad() and simdStore() need the address to be aligned to the size of SIMDFloats.
+	// simdGetGreaterOrEqualMask() returns a bit for each float, set where a >= b, with the first float in bit 0.
+	// simdGetLessOrEqualMask() is the same, but set where a <= b. Neither sets the bit of a float which is NaN.
+	// simdReciprocalOrOne() returns 1 / v, or 1 where v is zero.
+	//
+	// SIMDInts holds the same number of 32 bit integers, for code which needs to work on the bits of the floats.
+	// simdCastToInts() and simdCastToFloats() reinterpret the bits without changing them.
+	// simdShiftRightInts() shifts in zeros, whatever the top bit is.
+	// simdCompareLessOrEqual() and simdCompareGreaterOrEqual() return all of the bits of each integer set where the
+	// floats compare true and none where they don't, so that several comparisons can be combined with simdAndInts()
+	// and simdOrInts() before simdGetMask() turns them into a bit for each, the same as simdGetGreaterOrEqualMask().
+	// simdCompareIntsGreater() does the same for integers, comparing them as signed ones, for code such as QuadTree's
+	// which stores positions as ints.
+	// simdSelect() returns ifSet for each float whose integer in mask has it's top bit set, otherwise ifClear.
+	//
+	// simdLoadTransposed() loads 4 floats for each of the kSIMDWidth structures starting at p, each stride floats after
+	// the one before, such as the x, y, z and w of kSIMDWidth quaternions. a is set to the first float of each of them,
+	// b to the second, and so on. simdStoreTransposed() does the opposite.
+#if defined(DC_SIMD_AVX2)
+	typedef __m256 SIMDFloats;
+	const size_t kSIMDWidth = 8;
+	inline SIMDFloats simdLoad(const float* p) { return _mm256_load_ps(p); }
+	inline SIMDFloats simdLoadUnaligned(const float* p) { return _mm256_loadu_ps(p); }
+	inline void simdStore(float* p, SIMDFloats v) { _mm256_store_ps(p, v); }
+	inline void simdStoreUnaligned(float* p, SIMDFloats v) { _mm256_storeu_ps(p, v); }
+	inline SIMDFloats simdSet(float f) { return _mm256_set1_ps(f); }
+	inline SIMDFloats simdAdd(SIMDFloats a, SIMDFloats b) { return _mm256_add_ps(a, b); }
+	inline SIMDFloats simdSub(SIMDFloats a, SIMDFloats b) { return _mm256_sub_ps(a, b); }
+	inline SIMDFloats simdMul(SIMDFloats a, SIMDFloats b) { return _mm256_mul_ps(a, b); }
+	inline SIMDFloats simdMin(SIMDFloats a, SIMDFloats b) { return _mm256_min_ps(a, b); }
+	inline SIMDFloats simdSqrt(SIMDFloats v) { return _mm256_sqrt_ps(v); }
+	inline int simdGetGreaterOrEqualMask(SIMDFloats a, SIMDFloats b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+	inline int simdGetLessOrEqualMask(SIMDFloats a, SIMDFloats b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+	inline SIMDFloats simdDiv(SIMDFloats a, SIMDFloats b) { return _mm256_div_ps(a, b); }
+	inline SIMDFloats simdMax(SIMDFloats a, SIMDFloats b) { return _mm256_max_ps(a, b); }
+	inline SIMDFloats simdReciprocalOrOne(SIMDFloats v)
+	{
+		__m256 vOne = _mm256_set1_ps(1.0f);
+		return _mm256_blendv_ps(vOne, _mm256_div_ps(vOne, v), _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+	}
+	typedef __m256i SIMDInts;
+	inline SIMDInts simdSetInts(unsigned int i) { return _mm256_set1_epi32((int)i); }
+	inline SIMDInts simdLoadUnalignedInts(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	inline SIMDInts simdOrInts(SIMDInts a, SIMDInts b) { return _mm256_or_si256(a, b); }
+	inline SIMDInts simdCompareLessOrEqual(SIMDFloats a, SIMDFloats b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+	inline SIMDInts simdCompareGreaterOrEqual(SIMDFloats a, SIMDFloats b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+	inline SIMDInts simdCompareIntsGreater(SIMDInts a, SIMDInts b) { return _mm256_cmpgt_epi32(a, b); }
+	inline int simdGetMask(SIMDInts v) { return _mm256_movemask_ps(_mm256_castsi256_ps(v)); }
+	inline SIMDInts simdAddInts(SIMDInts a, SIMDInts b) { return _mm256_add_epi32(a, b); }
+	inline SIMDInts simdSubInts(SIMDInts a, SIMDInts b) { return _mm256_sub_epi32(a, b); }
+	inline SIMDInts simdAndInts(SIMDInts a, SIMDInts b) { return _mm256_and_si256(a, b); }
+	inline SIMDInts simdXorInts(SIMDInts a, SIMDInts b) { return _mm256_xor_si256(a, b); }
+	inline SIMDInts simdShiftLeftInts(SIMDInts v, int numBits) { return _mm256_slli_epi32(v, numBits); }
+	inline SIMDInts simdShiftRightInts(SIMDInts v, int numBits) { return _mm256_srli_epi32(v, numBits); }
+	inline SIMDInts simdCastToInts(SIMDFloats v) { return _mm256_castps_si256(v); }
+	inline SIMDFloats simdCastToFloats(SIMDInts v) { return _mm256_castsi256_ps(v); }
+	inline SIMDFloats simdSelect(SIMDInts mask, SIMDFloats ifSet, SIMDFloats ifClear) { return _mm256_blendv_ps(ifClear, ifSet, _mm256_castsi256_ps(mask)); }
+	inline void simdTranspose4x4(SIMDFloats& a, SIMDFloats& b, SIMDFloats& c, SIMDFloats& d)
+	{
+		// Transposes the 4x4 matrix in each 128 bit half of the registers, the same as _MM_TRANSPOSE4_PS()
+		__m256 vTemp0 = _mm256_unpacklo_ps(a, b);
+		__m256 vTemp1 = _mm256_unpackhi_ps(a, b);
+		__m256 vTemp2 = _mm256_unpacklo_ps(c, d);
+		__m256 vTemp3 = _mm256_unpackhi_ps(c, d);
+		a = _mm256_shuffle_ps(vTemp0, vTemp2, 0x44);
+		b = _mm256_shuffle_ps(vTemp0, vTemp2, 0xEE);
+		c = _mm256_shuffle_ps(vTemp1, vTemp3, 0x44);
+		d = _mm256_shuffle_ps(vTemp1, vTemp3, 0xEE);
+	}
+	inline void simdLoadTransposed(const float* p, size_t stride, SIMDFloats& a, SIMDFloats& b, SIMDFloats& c, SIMDFloats& d)
+	{
+		a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + stride * 4), 1);
+		b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + stride)), _mm_loadu_ps(p + stride * 5), 1);
+		c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + stride * 2)), _mm_loadu_ps(p + stride * 6), 1);
+		d = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + stride * 3)), _mm_loadu_ps(p + stride * 7), 1);
+		simdTranspose4x4(a, b, c, d);
+	}
+	inline void simdStoreTransposed(float* p, size_t stride, SIMDFloats a, SIMDFloats b, SIMDFloats c, SIMDFloats d)
+	{
+		simdTranspose4x4(a, b, c, d);
+		_mm_storeu_ps(p, _mm256_castps256_ps128(a));
+		_mm_storeu_ps(p + stride, _mm256_castps256_ps128(b));
+		_mm_storeu_ps(p + stride * 2, _mm256_castps256_ps128(c));
+		_mm_storeu_ps(p + stride * 3, _mm256_castps256_ps128(d));
+		_mm_storeu_ps(p + stride * 4, _mm256_extractf128_ps(a, 1));
+		_mm_storeu_ps(p + stride * 5, _mm256_extractf128_ps(b, 1));
+		_mm_storeu_ps(p + stride * 6, _mm256_extractf128_ps(c, 1));
+		_mm_storeu_ps(p + stride * 7, _mm256_extractf128_ps(d, 1));
+	}
+#elif defined(DC_SIMD_SSE4_1)
+	typedef __m128 SIMDFloats;
+	const size_t kSIMDWidth = 4;
+	inline SIMDFloats simdLoad(const float* p) { return _mm_load_ps(p); }
+	inline SIMDFloats simdLoadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+	inline void simdStore(float* p, SIMDFloats v) { _mm_store_ps(p, v); }
+	inline void simdStoreUnaligned(float* p, SIMDFloats v) { _mm_storeu_ps(p, v); }
+	inline SIMDFloats simdSet(float f) { return _mm_set1_ps(f); }
+	inline SIMDFloats simdAdd(SIMDFloats a, SIMDFloats b) { return _mm_add_ps(a, b); }
+	inline SIMDFloats simdSub(SIMDFloats a, SIMDFloats b) { return _mm_sub_ps(a, b); }
+	inline SIMDFloats simdMul(SIMDFloats a, SIMDFloats b) { return _mm_mul_ps(a, b); }
+	inline SIMDFloats simdMin(SIMDFloats a, SIMDFloats b) { return _mm_min_ps(a, b); }
+	inline SIMDFloats simdSqrt(SIMDFloats v) { return _mm_sqrt_ps(v); }
+	inline int simdGetGreaterOrEqualMask(SIMDFloats a, SIMDFloats b) { return _mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+	inline int simdGetLessOrEqualMask(SIMDFloats a, SIMDFloats b) { return _mm_movemask_ps(_mm_cmple_ps(a, b)); }
+	inline SIMDFloats simdDiv(SIMDFloats a, SIMDFloats b) { return _mm_div_ps(a, b); }
+	inline SIMDFloats simdMax(SIMDFloats a, SIMDFloats b) { return _mm_max_ps(a, b); }
+	inline SIMDFloats simdReciprocalOrOne(SIMDFloats v)
+	{
+		__m128 vOne = _mm_set1_ps(1.0f);
+		return _mm_blendv_ps(vOne, _mm_div_ps(vOne, v), _mm_cmpneq_ps(v, _mm_setzero_ps()));
+	}
+	typedef __m128i SIMDInts;
+	inline SIMDInts simdSetInts(unsigned int i) { return _mm_set1_epi32((int)i); }
+	inline SIMDInts simdLoadUnalignedInts(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+	inline SIMDInts simdOrInts(SIMDInts a, SIMDInts b) { return _mm_or_si128(a, b); }
+	inline SIMDInts simdCompareLessOrEqual(SIMDFloats a, SIMDFloats b) { return _mm_castps_si128(_mm_cmple_ps(a, b)); }
+	inline SIMDInts simdCompareGreaterOrEqual(SIMDFloats a, SIMDFloats b) { return _mm_castps_si128(_mm_cmpge_ps(a, b)); }
+	inline SIMDInts simdCompareIntsGreater(SIMDInts a, SIMDInts b) { return _mm_cmpgt_epi32(a, b); }
+	inline int simdGetMask(SIMDInts v) { return _mm_movemask_ps(_mm_castsi128_ps(v)); }
+	inline SIMDInts simdAddInts(SIMDInts a, SIMDInts b) { return _mm_add_epi32(a, b); }
+	inline SIMDInts simdSubInts(SIMDInts a, SIMDInts b) { return _mm_sub_epi32(a, b); }
+	inline SIMDInts simdAndInts(SIMDInts a, SIMDInts b) { return _mm_and_si128(a, b); }
+	inline SIMDInts simdXorInts(SIMDInts a, SIMDInts b) { return _mm_xor_si128(a, b); }
+	inline SIMDInts simdShiftLeftInts(SIMDInts v, int numBits) { return _mm_slli_epi32(v, numBits); }
+	inline SIMDInts simdShiftRightInts(SIMDInts v, int numBits) { return _mm_srli_epi32(v, numBits); }
+	inline SIMDInts simdCastToInts(SIMDFloats v) { return _mm_castps_si128(v); }
+	inline SIMDFloats simdCastToFloats(SIMDInts v) { return _mm_castsi128_ps(v); }
+	inline SIMDFloats simdSelect(SIMDInts mask, SIMDFloats ifSet, SIMDFloats ifClear) { return _mm_blendv_ps(ifClear, ifSet, _mm_castsi128_ps(mask)); }
+	inline void simdLoadTransposed(const float* p, size_t stride, SIMDFloats& a, SIMDFloats& b, SIMDFloats& c, SIMDFloats& d)
+	{
+		a = _mm_loadu_ps(p);
+		b = _mm_loadu_ps(p + stride);
+		c = _mm_loadu_ps(p + stride * 2);
+		d = _mm_loadu_ps(p + stride * 3);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+	}
+	inline void simdStoreTransposed(float* p, size_t stride, SIMDFloats a, SIMDFloats b, SIMDFloats c, SIMDFloats d)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		_mm_storeu_ps(p, a);
+		_mm_storeu_ps(p + stride, b);
+		_mm_storeu_ps(p + stride * 2, c);
+		_mm_storeu_ps(p + stride * 3, d);
+	}
+#else
+	typedef float SIMDFloats;
+	const size_t kSIMDWidth = 1;
+	inline SIMDFloats simdLoad(const float* p) { return *p; }
+	inline SIMDFloats simdLoadUnaligned(const float* p) { return *p; }
+	inline void simdStore(float* p, SIMDFloats v) { *p = v; }
+	inline void simdStoreUnaligned(float* p, SIMDFloats v) { *p = v; }
+	inline SIMDFloats simdSet(float f) { return f; }
+	inline SIMDFloats simdAdd(SIMDFloats a, SIMDFloats b) { return a + b; }
+	inline SIMDFloats simdSub(SIMDFloats a, SIMDFloats b) { return a - b; }
+	inline SIMDFloats simdMul(SIMDFloats a, SIMDFloats b) { return a * b; }
+	inline SIMDFloats simdMin(SIMDFloats a, SIMDFloats b) { return a < b ? a : b; }
+	inline SIMDFloats simdSqrt(SIMDFloats v) { return sqrtf(v); }
+	inline int simdGetGreaterOrEqualMask(SIMDFloats a, SIMDFloats b) { return a >= b ? 1 : 0; }
+	inline int simdGetLessOrEqualMask(SIMDFloats a, SIMDFloats b) { return a <= b ? 1 : 0; }
+	inline SIMDFloats simdDiv(SIMDFloats a, SIMDFloats b) { return a / b; }
+	inline SIMDFloats simdMax(SIMDFloats a, SIMDFloats b) { return a > b ? a : b; }
+	inline SIMDFloats simdReciprocalOrOne(SIMDFloats v) { return v != 0.0f ? 1.0f / v : 1.0f; }
+	typedef unsigned int SIMDInts;
+	inline SIMDInts simdSetInts(unsigned int i) { return i; }
+	inline SIMDInts simdLoadUnalignedInts(const int* p) { return (SIMDInts)*p; }
+	inline SIMDInts simdOrInts(SIMDInts a, SIMDInts b) { return a | b; }
+	inline SIMDInts simdCompareLessOrEqual(SIMDFloats a, SIMDFloats b) { return a <= b ? 0xFFFFFFFF : 0; }
+	inline SIMDInts simdCompareGreaterOrEqual(SIMDFloats a, SIMDFloats b) { return a >= b ? 0xFFFFFFFF : 0; }
+	inline SIMDInts simdCompareIntsGreater(SIMDInts a, SIMDInts b) { return (int)a > (int)b ? 0xFFFFFFFF : 0; }
+	inline int simdGetMask(SIMDInts v) { return (int)(v >> 31); }
+	inline SIMDInts simdAddInts(SIMDInts a, SIMDInts b) { return a + b; }
+	inline SIMDInts simdSubInts(SIMDInts a, SIMDInts b) { return a - b; }
+	inline SIMDInts simdAndInts(SIMDInts a, SIMDInts b) { return a & b; }
+	inline SIMDInts simdXorInts(SIMDInts a, SIMDInts b) { return a ^ b; }
+	inline SIMDInts simdShiftLeftInts(SIMDInts v, int numBits) { return v << numBits; }
+	inline SIMDInts simdShiftRightInts(SIMDInts v, int numBits) { return v >> numBits; }
+	inline SIMDInts simdCastToInts(SIMDFloats v) { return std::bit_cast<SIMDInts>(v); }
+	inline SIMDFloats simdCastToFloats(SIMDInts v) { return std::bit_cast<SIMDFloats>(v); }
+	inline SIMDFloats simdSelect(SIMDInts mask, SIMDFloats ifSet, SIMDFloats ifClear) { return (mask & 0x80000000) ? ifSet : ifClear; }
+	inline void simdLoadTransposed(const float* p, size_t /*stride*/, SIMDFloats& a, SIMDFloats& b, SIMDFloats& c, SIMDFloats& d)
+	{
+		a = p[0];
+		b = p[1];
+		c = p[2];
+		d = p[3];
+	}
+	inline void simdStoreTransposed(float* p, size_t /*stride*/, SIMDFloats a, SIMDFloats b, SIMDFloats c, SIMDFloats d)
+	{
+		p[0] = a;
+		p[1] = b;
+		p[2] = c;
+		p[3] = d;
+	}
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "vector3d.h"
+#include "../Common/error.h"
+#include "../Common/multithreading.h"
+#include "simd.h"
+#include <cmath>
+
+namespace DC
+{
+	namespace
+	{
+		// The fewest positions the batch methods give to each thread, as with fewer than this, starting the
+		// thread takes longer than converting them.
+		const size_t kMinPositionsPerThread = 32768;
+
+#if defined(DC_SIMD_AVX2)
+		// The origin's x, y and z repeated to line up with the doubles of four Vector3ds, which are stored
+		// x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3
+		struct OriginPattern
+		{
+			OriginPattern(const Vector3d& originPARAM)
+			{
+				v0 = _mm256_setr_pd(originPARAM.x, originPARAM.y, originPARAM.z, originPARAM.x);
+				v1 = _mm256_setr_pd(originPARAM.y, originPARAM.z, originPARAM.x, originPARAM.y);
+				v2 = _mm256_setr_pd(originPARAM.z, originPARAM.x, originPARAM.y, originPARAM.z);
+			}
+			__m256d v0, v1, v2;
+		};
+
+		// Subtracts the origin from the four Vector3ds at pInPARAM and converts the results to floats, which are
+		// left stored the same way, x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3
+		inline void getRelativeToFour(const double* pInPARAM, const OriginPattern& originPARAM, __m128& vAPARAM, __m128& vBPARAM, __m128& vCPARAM)
+		{
+			vAPARAM = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(pInPARAM), originPARAM.v0));
+			vBPARAM = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(pInPARAM + 4), originPARAM.v1));
+			vCPARAM = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(pInPARAM + 8), originPARAM.v2));
+		}
+#elif defined(DC_SIMD_SSE4_1)
+		// The origin's x, y and z repeated to line up with the doubles of two Vector3ds, which are stored
+		// x0 y0, z0 x1, y1 z1
+		struct OriginPattern
+		{
+			OriginPattern(const Vector3d& originPARAM)
+			{
+				v0 = _mm_setr_pd(originPARAM.x, originPARAM.y);
+				v1 = _mm_setr_pd(originPARAM.z, originPARAM.x);
+				v2 = _mm_setr_pd(originPARAM.y, originPARAM.z);
+			}
+			__m128d v0, v1, v2;
+		};
+
+		// Subtracts the origin from the four Vector3ds at pInPARAM and converts the results to floats, which are
+		// left stored the same way, x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3
+		inline void getRelativeToFour(const double* pInPARAM, const OriginPattern& originPARAM, __m128& vAPARAM, __m128& vBPARAM, __m128& vCPARAM)
+		{
+			vAPARAM = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pInPARAM), originPARAM.v0)), _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pInPARAM + 2), originPARAM.v1)));
+			vBPARAM = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pInPARAM + 4), originPARAM.v2)), _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pInPARAM + 6), originPARAM.v0)));
+			vCPARAM = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pInPARAM + 8), originPARAM.v1)), _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pInPARAM + 10), originPARAM.v2)));
+		}
+#endif
+
+		// Converts the given positions to Vector3fs relative to the given origin.
+		// Converting a double to a float rounds it the same way whichever code path does it, so the results are
+		// exactly the same as Vector3d::getRelativeTo().
+		void getRelativeToVector3fs(const Vector3d* pPositionsPARAM, const Vector3d& originPARAM, Vector3f* pPositionsOutPARAM, size_t numPositionsPARAM)
+		{
+			size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+			OriginPattern origin(originPARAM);
+			for (; i + 4 <= numPositionsPARAM; i += 4)
+			{
+				__m128 vA, vB, vC;
+				getRelativeToFour(&pPositionsPARAM[i].x, origin, vA, vB, vC);
+				float* pOut = &pPositionsOutPARAM[i].x;
+				_mm_storeu_ps(pOut, vA);
+				_mm_storeu_ps(pOut + 4, vB);
+				_mm_storeu_ps(pOut + 8, vC);
+			}
+#endif
+			for (; i < numPositionsPARAM; i++)
+				pPositionsOutPARAM[i] = pPositionsPARAM[i].getRelativeTo(originPARAM);
+		}
+
+		// The same as the above, except the results are stored as seperate arrays of their x, y and z components.
+		// pXOutPARAM, pYOutPARAM and pZOutPARAM must be aligned to 16 bytes.
+		void getRelativeToComponents(const Vector3d* pPositionsPARAM, const Vector3d& originPARAM, float* pXOutPARAM, float* pYOutPARAM, float* pZOutPARAM, size_t numPositionsPARAM)
+		{
+			size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+			OriginPattern origin(originPARAM);
+			for (; i + 4 <= numPositionsPARAM; i += 4)
+			{
+				// Shuffle the four vectors into a register for each of the x, y and z components, the same as
+				// Vector3fArray::setFromVector3fs() does.
+				__m128 vA, vB, vC;
+				getRelativeToFour(&pPositionsPARAM[i].x, origin, vA, vB, vC);
+				_mm_store_ps(pXOutPARAM + i, _mm_shuffle_ps(_mm_shuffle_ps(vA, vA, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_store_ps(pYOutPARAM + i, _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_store_ps(pZOutPARAM + i, _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(vC, vC, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+			}
+#endif
+			for (; i < numPositionsPARAM; i++)
+			{
+				pXOutPARAM[i] = (float)(pPositionsPARAM[i].x - originPARAM.x);
+				pYOutPARAM[i] = (float)(pPositionsPARAM[i].y - originPARAM.y);
+				pZOutPARAM[i] = (float)(pPositionsPARAM[i].z - originPARAM.z);
+			}
+		}
+	}
+
+	Vector3d::Vector3d()
+	{
+		x = y = z = 0.0;
+	}
+
+	Vector3d::Vector3d(double X, double Y, double Z)
+	{
+		x = X;
+		y = Y;
+		z = Z;
+	}
+
+	Vector3d::Vector3d(const Vector3d& vector)
+	{
+		x = vector.x;
+		y = vector.y;
+		z = vector.z;
+	}
+
+	Vector3d::Vector3d(const Vector3f& vector)
+	{
+		x = vector.x;
+		y = vector.y;
+		z = vector.z;
+	}
+
+	Vector3d Vector3d::operator +(const Vector3d& vector) const
+	{
+		return Vector3d(x + vector.x, y + vector.y, z + vector.z);
+	}
+
+	Vector3d& Vector3d::operator +=(const Vector3d& vector)
+	{
+		x += vector.x;
+		y += vector.y;
+		z += vector.z;
+		return *this;
+	}
+
+	Vector3d Vector3d::operator -(const Vector3d& vector) const
+	{
+		return Vector3d(x - vector.x, y - vector.y, z - vector.z);
+	}
+
+	Vector3d& Vector3d::operator -=(const Vector3d& vector)
+	{
+		x -= vector.x;
+		y -= vector.y;
+		z -= vector.z;
+		return *this;
+	}
+
+	const Vector3d Vector3d::operator*(const double scalar) const
+	{
+		return Vector3d(x * scalar, y * scalar, z * scalar);
+	}
+
+	void Vector3d::operator*=(const double scalar)
+	{
+		x = x * scalar;
+		y = y * scalar;
+		z = z * scalar;
+	}
+
+	bool Vector3d::operator ==(const Vector3d& vector) const
+	{
+		return x == vector.x && y == vector.y && z == vector.z;
+	}
+
+	bool Vector3d::operator !=(const Vector3d& vector) const
+	{
+		return x != vector.x || y != vector.y || z != vector.z;
+	}
+
+	void Vector3d::set(double X, double Y, double Z)
+	{
+		x = X;
+		y = Y;
+		z = Z;
+	}
+
+	void Vector3d::setZero(void)
+	{
+		x = y = z = 0.0;
+	}
+
+	bool Vector3d::isZero(void) const
+	{
+		return x == 0 && y == 0 && z == 0;
+	}
+
+	void Vector3d::negate(void)
+	{
+		x = -x;
+		y = -y;
+		z = -z;
+	}
+
+	double Vector3d::getMagnitude(void) const
+	{
+		double dMagnitude = x * x;
+		dMagnitude += y * y;
+		dMagnitude += z * z;
+		dMagnitude = sqrt(dMagnitude);
+		return dMagnitude;
+	}
+
+	void Vector3d::normalise(void)
+	{
+		// Compute magnitude aka length
+		double dMagnitude = x * x;
+		dMagnitude += y * y;
+		dMagnitude += z * z;
+		dMagnitude = sqrt(dMagnitude);
+		if (dMagnitude == 0.0)	// Prevent divide by zero
+			return;
+		double dReciprocal = 1.0 / dMagnitude;
+		x *= dReciprocal;
+		y *= dReciprocal;
+		z *= dReciprocal;
+	}
+
+	double Vector3d::getDot(const Vector3d& vector) const
+	{
+		return x * vector.x + y * vector.y + z * vector.z;
+	}
+
+	Vector3d Vector3d::getCross(const Vector3d& vector) const
+	{
+		Vector3d vCross;
+		vCross.x = y * vector.z - z * vector.y;
+		vCross.y = z * vector.x - x * vector.z;
+		vCross.z = x * vector.y - y * vector.x;
+		return vCross;
+	}
+
+	double Vector3d::getAngle(const Vector3d& vector) const
+	{
+		return acos(getDot(vector));
+	}
+
+	double Vector3d::getDistance(const Vector3d& vector) const
+	{
+		double dx = x - vector.x;
+		double dy = y - vector.y;
+		double dz = z - vector.z;
+		return sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	double Vector3d::getDistanceSquared(const Vector3d& vector) const
+	{
+		double dx = x - vector.x;
+		double dy = y - vector.y;
+		double dz = z - vector.z;
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	void Vector3d::getAsArray(double* pArray) const
+	{
+		pArray[0] = x;
+		pArray[1] = y;
+		pArray[2] = z;
+	}
+
+	void Vector3d::multiply(double scalar)
+	{
+		x *= scalar;
+		y *= scalar;
+		z *= scalar;
+	}
+
+	Vector3f Vector3d::getVector3f(void) const
+	{
+		return Vector3f((float)x, (float)y, (float)z);
+	}
+
+	Vector3f Vector3d::getRelativeTo(const Vector3d& origin) const
+	{
+		return Vector3f((float)(x - origin.x), (float)(y - origin.y), (float)(z - origin.z));
+	}
+
+	void Vector3d::getRelativeTo(std::span<const Vector3d> positionsPARAM, const Vector3d& originPARAM, std::span<Vector3f> positionsOutPARAM, unsigned int numThreadsPARAM)
+	{
+		ErrorIfTrue(positionsOutPARAM.size() != positionsPARAM.size(), L"Vector3d::getRelativeTo() failed. The given output is not the same size as the given positions.");
+		runInChunks(positionsPARAM.size(), numThreadsPARAM, kMinPositionsPerThread, 8, [&](size_t firstPosition, size_t numPositions)
+			{
+				getRelativeToVector3fs(positionsPARAM.data() + firstPosition, originPARAM, positionsOutPARAM.data() + firstPosition, numPositions);
+			});
+	}
+
+	void Vector3d::getRelativeTo(std::span<const Vector3d> positionsPARAM, const Vector3d& originPARAM, Vector3fArray& positionsOutPARAM, unsigned int numThreadsPARAM)
+	{
+		positionsOutPARAM.resize(positionsPARAM.size());
+		float* pX = positionsOutPARAM.getX();
+		float* pY = positionsOutPARAM.getY();
+		float* pZ = positionsOutPARAM.getZ();
+		// Each chunk starts at a multiple of 8 positions, so the components stay aligned
+		runInChunks(positionsPARAM.size(), numThreadsPARAM, kMinPositionsPerThread, 8, [&](size_t firstPosition, size_t numPositions)
+			{
+				getRelativeToComponents(positionsPARAM.data() + firstPosition, originPARAM, pX + firstPosition, pY + firstPosition, pZ + firstPosition, numPositions);
+			});
+	}
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include "vector3f.h"
+#include "vector3fArray.h"
+#include <span>
+
+namespace DC
+{
+	// Vector class, using doubles
+	// This is the same as Vector3f, except it uses doubles, for positions in very large worlds.
+	// A float only has 24 bits of precision, so 10km from the origin, positions can only be stored to within a
+	// millimetre or so and things start to jitter as they move. A double is precise to well below a micrometre
+	// anywhere in a world the size of the solar system.
+	//
+	// The GPU and most of the rest of the code work with floats though, so instead of moving the whole world back
+	// towards the origin every now and then, store positions as Vector3d and each frame, convert them to floats
+	// relative to the camera with getRelativeTo(). Everything near the camera, which is all that can be seen clearly,
+	// then has as much precision as it would have near the origin.
+	// The view matrix is then built with the camera at the origin, and frustum culling is done with the camera
+	// relative positions too.
+	//
+	// Example:
+	// std::vector<Vector3d> objectPositions;
+	// Vector3d cameraPosition;
+	// Each frame...
+	// Vector3fArray relativePositions;
+	// Vector3d::getRelativeTo(objectPositions, cameraPosition, relativePositions);
+	// Matrix view;
+	// view.setViewLookat(Vector3f(0.0f, 0.0f, 0.0f), cameraTarget.getRelativeTo(cameraPosition));
+	// frustum.computeFromViewProjection(view, projection);
+	// frustum.getVisibleSpheres(relativePositions, radii, visibleIndicies);
+	class Vector3d
+	{
+	public:
+		// Constructor, sets all values to zero
+		Vector3d();
+
+		// Constructor, sets all values to the ones given
+		Vector3d(double X, double Y, double Z);
+
+		// Constructor, sets all values from the given Vector3d
+		Vector3d(const Vector3d& vector);
+
+		// Constructor, sets all values from the given Vector3f
+		Vector3d(const Vector3f& vector);
+
+		// Addition operator which adds two vectors together
+		Vector3d operator +(const Vector3d& vector) const;
+
+		// Addition operator which adds two vectors together
+		Vector3d& operator +=(const Vector3d& vector);
+
+		// Subtraction operator
+		Vector3d operator -(const Vector3d& vector) const;
+
+		// Subtraction operator
+		Vector3d& operator -=(const Vector3d& vector);
+
+		// Multiplication by scalar
+		const Vector3d operator *(const double scalar) const;
+
+		// Multiplication by scalar
+		void operator *=(const double scalar);
+
+		// Check for equality
+		bool operator ==(const Vector3d& vector) const;
+
+		// Check for inequality
+		bool operator !=(const Vector3d& vector) const;
+
+		// Sets each element to the values given
+		void set(double X, double Y, double Z);
+
+		// Sets each element within the vector's set to zero.
+		void setZero(void);
+
+		// Returns true if the vector is a zero vector.
+		bool isZero(void) const;
+
+		// Negates the vector.
+		void negate(void);
+
+		// Computes and returns the vector's magnitude
+		double getMagnitude(void) const;
+
+		// Normalises this vector so that it becomes a unit vector (Has a magnitude of 1)
+		// If the vector has zero length(magnitude), then it is not modified.
+		void normalise(void);
+
+		// Computes the dot product (also known as inner product) between this vector and the one given.
+		double getDot(const Vector3d& vector) const;
+
+		// Computes the cross product between this vector and the one given.
+		Vector3d getCross(const Vector3d& vector) const;
+
+		// Computes the angle (in radians) between two UNIT VECTORS (Length of 1)
+		// No checking of vectors are unit length here.
+		double getAngle(const Vector3d& vector) const;
+
+		// Computes distance between this vector and the one given, treating each vector as a point in 3D space.
+		double getDistance(const Vector3d& vector) const;
+
+		// Computes distance squared between this vector and the one given, treating each vector as a point in 3D space.
+		double getDistanceSquared(const Vector3d& vector) const;
+
+		// Returns x,y and z as an array of doubles
+		void getAsArray(double* pArray) const;
+
+		// Multiplies this vector by the given scalar
+		void multiply(double scalar);
+
+		// Returns this vector as a Vector3f, which loses precision if it's far from the origin.
+		Vector3f getVector3f(void) const;
+
+		// Returns this vector relative to the given origin, usually the camera's position, as a Vector3f.
+		// The subtraction is done with doubles, so the result is as precise as a float can be, however far from
+		// the origin of the world both of them are.
+		Vector3f getRelativeTo(const Vector3d& origin) const;
+
+		// The same as the above, for each of the given positions, which is much faster than calling the above for each
+		// one, as several are converted at a time with SIMD instructions.
+		// The results are exactly the same as the above's.
+		// positionsOut must be the same size as positions.
+		// numThreads is the maximum number of threads to split the positions between, 0 uses as many as there are
+		// hardware threads. Threads are only used for very large numbers of positions, as otherwise starting them
+		// takes longer than converting the positions.
+		static void getRelativeTo(std::span<const Vector3d> positions, const Vector3d& origin, std::span<Vector3f> positionsOut, unsigned int numThreads = 1);
+
+		// The same as the above, except the results are stored in a Vector3fArray, ready for Frustum's batch
+		// visibility tests. positionsOut is resized to the number of positions given.
+		static void getRelativeTo(std::span<const Vector3d> positions, const Vector3d& origin, Vector3fArray& positionsOut, unsigned int numThreads = 1);
+
+		double x;
+		double y;
+		double z;
+	};
+}
\ No newline at end of file
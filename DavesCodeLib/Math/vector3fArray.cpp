@@ -0,0 +1,521 @@
+#include "vector3fArray.h"
+#include "../Common/error.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace DC
+{
+	namespace
+	{
+		// Calls computePARAM(index) for each full SIMD register's worth of vectors, which returns the values for them,
+		// then stores them in the given span. The remaining values at the end of the span are computed with
+		// computeScalarPARAM(index), as storing a whole register there would write past the end of the span.
+		template <typename Compute, typename ComputeScalar> void computeIntoSpan(std::span<float> valuesOutPARAM, Compute computePARAM, ComputeScalar computeScalarPARAM)
+		{
+			size_t i = 0;
+			for (; i + kSIMDWidth <= valuesOutPARAM.size(); i += kSIMDWidth)
+				simdStoreUnaligned(valuesOutPARAM.data() + i, computePARAM(i));
+			for (; i < valuesOutPARAM.size(); i++)
+				valuesOutPARAM[i] = computeScalarPARAM(i);
+		}
+	}
+
+	Vector3fArray::Vector3fArray()
+	{
+		pData = 0;
+		numVectors = 0;
+		capacity = 0;
+	}
+
+	Vector3fArray::Vector3fArray(size_t sizePARAM)
+	{
+		pData = 0;
+		numVectors = 0;
+		capacity = 0;
+		resize(sizePARAM);
+	}
+
+	Vector3fArray::Vector3fArray(std::span<const Vector3f> vectorsPARAM)
+	{
+		pData = 0;
+		numVectors = 0;
+		capacity = 0;
+		setFromVector3fs(vectorsPARAM);
+	}
+
+	Vector3fArray::Vector3fArray(const Vector3fArray& vectorsPARAM)
+	{
+		pData = 0;
+		numVectors = 0;
+		capacity = 0;
+		*this = vectorsPARAM;
+	}
+
+	Vector3fArray::Vector3fArray(Vector3fArray&& vectorsPARAM) noexcept
+	{
+		pData = vectorsPARAM.pData;
+		numVectors = vectorsPARAM.numVectors;
+		capacity = vectorsPARAM.capacity;
+		vectorsPARAM.pData = 0;
+		vectorsPARAM.numVectors = 0;
+		vectorsPARAM.capacity = 0;
+	}
+
+	Vector3fArray::~Vector3fArray()
+	{
+		free();
+	}
+
+	Vector3fArray& Vector3fArray::operator =(const Vector3fArray& vectorsPARAM)
+	{
+		if (this == &vectorsPARAM)
+			return *this;
+		// The arrays may have different capacities, so each of the x, y and z arrays are copied seperately
+		resize(vectorsPARAM.numVectors);
+		for (int component = 0; component < 3; component++)
+		{
+			if (numVectors)
+				memcpy(pData + component * capacity, vectorsPARAM.pData + component * vectorsPARAM.capacity, sizeof(float) * numVectors);
+		}
+		return *this;
+	}
+
+	Vector3fArray& Vector3fArray::operator =(Vector3fArray&& vectorsPARAM) noexcept
+	{
+		if (this == &vectorsPARAM)
+			return *this;
+		free();
+		pData = vectorsPARAM.pData;
+		numVectors = vectorsPARAM.numVectors;
+		capacity = vectorsPARAM.capacity;
+		vectorsPARAM.pData = 0;
+		vectorsPARAM.numVectors = 0;
+		vectorsPARAM.capacity = 0;
+		return *this;
+	}
+
+	size_t Vector3fArray::size(void) const
+	{
+		return numVectors;
+	}
+
+	void Vector3fArray::resize(size_t sizePARAM)
+	{
+		if (sizePARAM > capacity)
+			reserve(std::max(sizePARAM, capacity * 2));
+		else if (sizePARAM < numVectors)
+		{
+			// Set the removed vectors to zero, as they are now padding
+			for (int component = 0; component < 3; component++)
+				memset(pData + component * capacity + sizePARAM, 0, sizeof(float) * (numVectors - sizePARAM));
+		}
+		numVectors = sizePARAM;
+	}
+
+	void Vector3fArray::reserve(size_t capacityPARAM)
+	{
+		ErrorIfTrue(capacityPARAM > (std::numeric_limits<size_t>::max)() / (sizeof(float) * 3) - kPadding, L"Vector3fArray::reserve() failed. The given capacity is too large.");
+		size_t newCapacity = (capacityPARAM + kPadding - 1) / kPadding * kPadding;
+		if (newCapacity <= capacity)
+			return;
+
+		// Copy the vectors into the new arrays, the rest of which are already zero
+		float* pOldData = pData;
+		size_t oldCapacity = capacity;
+		allocate(newCapacity);
+		for (int component = 0; component < 3; component++)
+		{
+			if (numVectors)
+				memcpy(pData + component * capacity, pOldData + component * oldCapacity, sizeof(float) * numVectors);
+		}
+		if (pOldData)
+			::operator delete[](pOldData, std::align_val_t(kAlignment));
+	}
+
+	size_t Vector3fArray::getCapacity(void) const
+	{
+		return capacity;
+	}
+
+	void Vector3fArray::clear(void)
+	{
+		free();
+	}
+
+	void Vector3fArray::set(size_t indexPARAM, const Vector3f& vectorPARAM)
+	{
+		ErrorIfTrue(indexPARAM >= numVectors, L"Vector3fArray::set() failed. Given index is out of range.");
+		pData[indexPARAM] = vectorPARAM.x;
+		pData[capacity + indexPARAM] = vectorPARAM.y;
+		pData[capacity * 2 + indexPARAM] = vectorPARAM.z;
+	}
+
+	Vector3f Vector3fArray::get(size_t indexPARAM) const
+	{
+		ErrorIfTrue(indexPARAM >= numVectors, L"Vector3fArray::get() failed. Given index is out of range.");
+		return Vector3f(pData[indexPARAM], pData[capacity + indexPARAM], pData[capacity * 2 + indexPARAM]);
+	}
+
+	void Vector3fArray::setFromVector3fs(std::span<const Vector3f> vectorsPARAM)
+	{
+		resize(vectorsPARAM.size());
+		float* pX = getX();
+		float* pY = getY();
+		float* pZ = getZ();
+		const Vector3f* pVectors = vectorsPARAM.data();
+		size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+		// Load four vectors, which are stored x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3, and shuffle them into
+		// a register for each of the x, y and z components.
+		for (; i + 4 <= numVectors; i += 4)
+		{
+			const float* pIn = &pVectors[i].x;
+			__m128 vA = _mm_loadu_ps(pIn);
+			__m128 vB = _mm_loadu_ps(pIn + 4);
+			__m128 vC = _mm_loadu_ps(pIn + 8);
+			_mm_store_ps(pX + i, _mm_shuffle_ps(_mm_shuffle_ps(vA, vA, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_store_ps(pY + i, _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_store_ps(pZ + i, _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(vC, vC, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+		}
+#endif
+		for (; i < numVectors; i++)
+		{
+			pX[i] = pVectors[i].x;
+			pY[i] = pVectors[i].y;
+			pZ[i] = pVectors[i].z;
+		}
+	}
+
+	void Vector3fArray::getAsVector3fs(std::span<Vector3f> vectorsOutPARAM) const
+	{
+		ErrorIfTrue(vectorsOutPARAM.size() != numVectors, L"Vector3fArray::getAsVector3fs() failed. The given span is not the same size as the array.");
+		const float* pX = getX();
+		const float* pY = getY();
+		const float* pZ = getZ();
+		Vector3f* pVectors = vectorsOutPARAM.data();
+		size_t i = 0;
+#if defined(DC_SIMD_SSE4_1)
+		// Shuffle four vectors' components into x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3 and store them
+		for (; i + 4 <= numVectors; i += 4)
+		{
+			__m128 vX = _mm_load_ps(pX + i);
+			__m128 vY = _mm_load_ps(pY + i);
+			__m128 vZ = _mm_load_ps(pZ + i);
+			__m128 vXYLow = _mm_unpacklo_ps(vX, vY);
+			__m128 vXYHigh = _mm_unpackhi_ps(vX, vY);
+			float* pOut = &pVectors[i].x;
+			_mm_storeu_ps(pOut, _mm_shuffle_ps(vXYLow, _mm_shuffle_ps(vZ, vX, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(pOut + 4, _mm_shuffle_ps(_mm_shuffle_ps(vY, vZ, _MM_SHUFFLE(1, 1, 1, 1)), vXYHigh, _MM_SHUFFLE(1, 0, 2, 0)));
+			_mm_storeu_ps(pOut + 8, _mm_shuffle_ps(_mm_shuffle_ps(vZ, vXYHigh, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_ps(vXYHigh, vZ, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+		}
+#endif
+		for (; i < numVectors; i++)
+			pVectors[i].set(pX[i], pY[i], pZ[i]);
+	}
+
+	std::vector<Vector3f> Vector3fArray::getAsVector3fs(void) const
+	{
+		std::vector<Vector3f> vResult(numVectors);
+		getAsVector3fs(vResult);
+		return vResult;
+	}
+
+	float* Vector3fArray::getX(void)
+	{
+		return pData;
+	}
+
+	float* Vector3fArray::getY(void)
+	{
+		return pData + capacity;
+	}
+
+	float* Vector3fArray::getZ(void)
+	{
+		return pData + capacity * 2;
+	}
+
+	const float* Vector3fArray::getX(void) const
+	{
+		return pData;
+	}
+
+	const float* Vector3fArray::getY(void) const
+	{
+		return pData + capacity;
+	}
+
+	const float* Vector3fArray::getZ(void) const
+	{
+		return pData + capacity * 2;
+	}
+
+	void Vector3fArray::add(const Vector3f& vectorPARAM)
+	{
+		// The padding is skipped here, as adding the vector to it would make it non zero
+		float* pX = getX();
+		float* pY = getY();
+		float* pZ = getZ();
+		SIMDFloats vX = simdSet(vectorPARAM.x);
+		SIMDFloats vY = simdSet(vectorPARAM.y);
+		SIMDFloats vZ = simdSet(vectorPARAM.z);
+		size_t i = 0;
+		for (; i + kSIMDWidth <= numVectors; i += kSIMDWidth)
+		{
+			simdStore(pX + i, simdAdd(simdLoad(pX + i), vX));
+			simdStore(pY + i, simdAdd(simdLoad(pY + i), vY));
+			simdStore(pZ + i, simdAdd(simdLoad(pZ + i), vZ));
+		}
+		for (; i < numVectors; i++)
+		{
+			pX[i] += vectorPARAM.x;
+			pY[i] += vectorPARAM.y;
+			pZ[i] += vectorPARAM.z;
+		}
+	}
+
+	void Vector3fArray::add(const Vector3fArray& vectorsPARAM)
+	{
+		ErrorIfTrue(vectorsPARAM.numVectors != numVectors, L"Vector3fArray::add() failed. The given array is not the same size as this one.");
+		// The vectors and the padding after them are a multiple of kSIMDWidth long, so there's no need for scalar code
+		// at the end. Both arrays' padding is zero, so adding it together leaves it as zero.
+		size_t numPadded = getNumPadded();
+		for (int component = 0; component < 3; component++)
+		{
+			float* p = pData + component * capacity;
+			const float* pOther = vectorsPARAM.pData + component * vectorsPARAM.capacity;
+			for (size_t i = 0; i < numPadded; i += kSIMDWidth)
+				simdStore(p + i, simdAdd(simdLoad(p + i), simdLoad(pOther + i)));
+		}
+	}
+
+	void Vector3fArray::subtract(const Vector3fArray& vectorsPARAM)
+	{
+		ErrorIfTrue(vectorsPARAM.numVectors != numVectors, L"Vector3fArray::subtract() failed. The given array is not the same size as this one.");
+		size_t numPadded = getNumPadded();
+		for (int component = 0; component < 3; component++)
+		{
+			float* p = pData + component * capacity;
+			const float* pOther = vectorsPARAM.pData + component * vectorsPARAM.capacity;
+			for (size_t i = 0; i < numPadded; i += kSIMDWidth)
+				simdStore(p + i, simdSub(simdLoad(p + i), simdLoad(pOther + i)));
+		}
+	}
+
+	void Vector3fArray::addScaled(const Vector3fArray& vectorsPARAM, float scalarPARAM)
+	{
+		ErrorIfTrue(vectorsPARAM.numVectors != numVectors, L"Vector3fArray::addScaled() failed. The given array is not the same size as this one.");
+		SIMDFloats vScalar = simdSet(scalarPARAM);
+		size_t numPadded = getNumPadded();
+		for (int component = 0; component < 3; component++)
+		{
+			float* p = pData + component * capacity;
+			const float* pOther = vectorsPARAM.pData + component * vectorsPARAM.capacity;
+			for (size_t i = 0; i < numPadded; i += kSIMDWidth)
+				simdStore(p + i, simdAdd(simdLoad(p + i), simdMul(simdLoad(pOther + i), vScalar)));
+		}
+		// Zero multiplied by an infinite or NaN scalar is NaN
+		clearPadding();
+	}
+
+	void Vector3fArray::multiply(float scalarPARAM)
+	{
+		SIMDFloats vScalar = simdSet(scalarPARAM);
+		size_t numPadded = getNumPadded();
+		for (int component = 0; component < 3; component++)
+		{
+			float* p = pData + component * capacity;
+			for (size_t i = 0; i < numPadded; i += kSIMDWidth)
+				simdStore(p + i, simdMul(simdLoad(p + i), vScalar));
+		}
+		// Zero multiplied by an infinite or NaN scalar is NaN
+		clearPadding();
+	}
+
+	void Vector3fArray::interpolate(const Vector3fArray& vectorsPARAM, float positionPARAM)
+	{
+		ErrorIfTrue(vectorsPARAM.numVectors != numVectors, L"Vector3fArray::interpolate() failed. The given array is not the same size as this one.");
+		SIMDFloats vPosition = simdSet(positionPARAM);
+		size_t numPadded = getNumPadded();
+		for (int component = 0; component < 3; component++)
+		{
+			float* p = pData + component * capacity;
+			const float* pOther = vectorsPARAM.pData + component * vectorsPARAM.capacity;
+			for (size_t i = 0; i < numPadded; i += kSIMDWidth)
+			{
+				SIMDFloats vA = simdLoad(p + i);
+				simdStore(p + i, simdAdd(vA, simdMul(simdSub(simdLoad(pOther + i), vA), vPosition)));
+			}
+		}
+		// Zero multiplied by an infinite or NaN position is NaN
+		clearPadding();
+	}
+
+	void Vector3fArray::normalise(void)
+	{
+		float* pX = getX();
+		float* pY = getY();
+		float* pZ = getZ();
+		size_t numPadded = getNumPadded();
+		for (size_t i = 0; i < numPadded; i += kSIMDWidth)
+		{
+			SIMDFloats vX = simdLoad(pX + i);
+			SIMDFloats vY = simdLoad(pY + i);
+			SIMDFloats vZ = simdLoad(pZ + i);
+			SIMDFloats vMagnitude = simdSqrt(simdAdd(simdAdd(simdMul(vX, vX), simdMul(vY, vY)), simdMul(vZ, vZ)));
+			SIMDFloats vReciprocal = simdReciprocalOrOne(vMagnitude);
+			simdStore(pX + i, simdMul(vX, vReciprocal));
+			simdStore(pY + i, simdMul(vY, vReciprocal));
+			simdStore(pZ + i, simdMul(vZ, vReciprocal));
+		}
+	}
+
+	void Vector3fArray::getMagnitude(std::span<float> magnitudesOutPARAM) const
+	{
+		ErrorIfTrue(magnitudesOutPARAM.size() != numVectors, L"Vector3fArray::getMagnitude() failed. The given span is not the same size as the array.");
+		const float* pX = getX();
+		const float* pY = getY();
+		const float* pZ = getZ();
+		computeIntoSpan(magnitudesOutPARAM, [&](size_t i)
+			{
+				SIMDFloats vX = simdLoad(pX + i);
+				SIMDFloats vY = simdLoad(pY + i);
+				SIMDFloats vZ = simdLoad(pZ + i);
+				return simdSqrt(simdAdd(simdAdd(simdMul(vX, vX), simdMul(vY, vY)), simdMul(vZ, vZ)));
+			},
+			[&](size_t i)
+			{
+				return sqrtf(pX[i] * pX[i] + pY[i] * pY[i] + pZ[i] * pZ[i]);
+			});
+	}
+
+	void Vector3fArray::getDot(const Vector3fArray& vectorsPARAM, std::span<float> dotsOutPARAM) const
+	{
+		ErrorIfTrue(vectorsPARAM.numVectors != numVectors, L"Vector3fArray::getDot() failed. The given array is not the same size as this one.");
+		ErrorIfTrue(dotsOutPARAM.size() != numVectors, L"Vector3fArray::getDot() failed. The given span is not the same size as the array.");
+		const float* pX = getX();
+		const float* pY = getY();
+		const float* pZ = getZ();
+		const float* pOtherX = vectorsPARAM.getX();
+		const float* pOtherY = vectorsPARAM.getY();
+		const float* pOtherZ = vectorsPARAM.getZ();
+		computeIntoSpan(dotsOutPARAM, [&](size_t i)
+			{
+				return simdAdd(simdAdd(simdMul(simdLoad(pX + i), simdLoad(pOtherX + i)), simdMul(simdLoad(pY + i), simdLoad(pOtherY + i))), simdMul(simdLoad(pZ + i), simdLoad(pOtherZ + i)));
+			},
+			[&](size_t i)
+			{
+				return pX[i] * pOtherX[i] + pY[i] * pOtherY[i] + pZ[i] * pOtherZ[i];
+			});
+	}
+
+	void Vector3fArray::getDistance(const Vector3fArray& vectorsPARAM, std::span<float> distancesOutPARAM) const
+	{
+		ErrorIfTrue(vectorsPARAM.numVectors != numVectors, L"Vector3fArray::getDistance() failed. The given array is not the same size as this one.");
+		ErrorIfTrue(distancesOutPARAM.size() != numVectors, L"Vector3fArray::getDistance() failed. The given span is not the same size as the array.");
+		const float* pX = getX();
+		const float* pY = getY();
+		const float* pZ = getZ();
+		const float* pOtherX = vectorsPARAM.getX();
+		const float* pOtherY = vectorsPARAM.getY();
+		const float* pOtherZ = vectorsPARAM.getZ();
+		computeIntoSpan(distancesOutPARAM, [&](size_t i)
+			{
+				SIMDFloats vX = simdSub(simdLoad(pX + i), simdLoad(pOtherX + i));
+				SIMDFloats vY = simdSub(simdLoad(pY + i), simdLoad(pOtherY + i));
+				SIMDFloats vZ = simdSub(simdLoad(pZ + i), simdLoad(pOtherZ + i));
+				return simdSqrt(simdAdd(simdAdd(simdMul(vX, vX), simdMul(vY, vY)), simdMul(vZ, vZ)));
+			},
+			[&](size_t i)
+			{
+				float fX = pX[i] - pOtherX[i];
+				float fY = pY[i] - pOtherY[i];
+				float fZ = pZ[i] - pOtherZ[i];
+				return sqrtf(fX * fX + fY * fY + fZ * fZ);
+			});
+	}
+
+	void Vector3fArray::getDistance(const Vector3f& pointPARAM, std::span<float> distancesOutPARAM) const
+	{
+		ErrorIfTrue(distancesOutPARAM.size() != numVectors, L"Vector3fArray::getDistance() failed. The given span is not the same size as the array.");
+		const float* pX = getX();
+		const float* pY = getY();
+		const float* pZ = getZ();
+		SIMDFloats vPointX = simdSet(pointPARAM.x);
+		SIMDFloats vPointY = simdSet(pointPARAM.y);
+		SIMDFloats vPointZ = simdSet(pointPARAM.z);
+		computeIntoSpan(distancesOutPARAM, [&](size_t i)
+			{
+				SIMDFloats vX = simdSub(simdLoad(pX + i), vPointX);
+				SIMDFloats vY = simdSub(simdLoad(pY + i), vPointY);
+				SIMDFloats vZ = simdSub(simdLoad(pZ + i), vPointZ);
+				return simdSqrt(simdAdd(simdAdd(simdMul(vX, vX), simdMul(vY, vY)), simdMul(vZ, vZ)));
+			},
+			[&](size_t i)
+			{
+				return pointPARAM.getDistance(Vector3f(pX[i], pY[i], pZ[i]));
+			});
+	}
+
+	void Vector3fArray::getDistanceSquared(const Vector3f& pointPARAM, std::span<float> distancesOutPARAM) const
+	{
+		ErrorIfTrue(distancesOutPARAM.size() != numVectors, L"Vector3fArray::getDistanceSquared() failed. The given span is not the same size as the array.");
+		const float* pX = getX();
+		const float* pY = getY();
+		const float* pZ = getZ();
+		SIMDFloats vPointX = simdSet(pointPARAM.x);
+		SIMDFloats vPointY = simdSet(pointPARAM.y);
+		SIMDFloats vPointZ = simdSet(pointPARAM.z);
+		computeIntoSpan(distancesOutPARAM, [&](size_t i)
+			{
+				SIMDFloats vX = simdSub(simdLoad(pX + i), vPointX);
+				SIMDFloats vY = simdSub(simdLoad(pY + i), vPointY);
+				SIMDFloats vZ = simdSub(simdLoad(pZ + i), vPointZ);
+				return simdAdd(simdAdd(simdMul(vX, vX), simdMul(vY, vY)), simdMul(vZ, vZ));
+			},
+			[&](size_t i)
+			{
+				float fX = pX[i] - pointPARAM.x;
+				float fY = pY[i] - pointPARAM.y;
+				float fZ = pZ[i] - pointPARAM.z;
+				return fX * fX + fY * fY + fZ * fZ;
+			});
+	}
+
+	size_t Vector3fArray::getNumPadded(void) const
+	{
+		return (numVectors + kPadding - 1) / kPadding * kPadding;
+	}
+
+	void Vector3fArray::clearPadding(void)
+	{
+		size_t numPadded = getNumPadded();
+		if (numPadded == numVectors)
+			return;
+		for (int component = 0; component < 3; component++)
+			memset(pData + component * capacity + numVectors, 0, sizeof(float) * (numPadded - numVectors));
+	}
+
+	void Vector3fArray::allocate(size_t capacityPARAM)
+	{
+		capacity = capacityPARAM;
+		pData = 0;
+		if (!capacity)
+			return;
+		pData = static_cast<float*>(::operator new[](sizeof(float) * capacity * 3, std::align_val_t(kAlignment)));
+		memset(pData, 0, sizeof(float) * capacity * 3);
+	}
+
+	void Vector3fArray::free(void)
+	{
+		if (pData)
+			::operator delete[](pData, std::align_val_t(kAlignment));
+		pData = 0;
+		numVectors = 0;
+		capacity = 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,174 @@
+#pragma once
+#include "vector3f.h"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace DC
+{
+	// An array of 3D vectors, stored as a structure of arrays.
+	// Instead of storing x, y and z next to each other for each vector, like an array of Vector3f does, all of the
+	// x components are stored in one array, all of the y components in another and all of the z components in a third.
+	// This means that the same component of several vectors can be loaded into a SIMD register at once, so the
+	// methods below work on 4 or 8 vectors at a time, depending upon which instruction set simd.h selects.
+	// Use this for large numbers of vectors which all have the same thing done to them, such as the positions and
+	// velocities of particles.
+	//
+	// Each array is aligned to, and padded to a multiple of, 32 bytes, so that the methods never need to handle
+	// a partial SIMD register. The padding is always zero.
+	// Like a std::vector, the arrays have room for more vectors than are in use, which grows geometrically, so that
+	// an array whose size changes a little at a time, such as when particles are created and destroyed each frame,
+	// is rarely reallocated. The space which isn't in use is zero as well.
+	// The results of each method are exactly the same as calling the equivalent method of Vector3f for each vector.
+	//
+	// Example:
+	// Vector3fArray positions(particlePositions);	// From a std::vector<Vector3f>
+	// Vector3fArray velocities(particleVelocities);
+	// Each frame...
+	// velocities.add(Vector3f(0.0f, -9.8f * fTimeDeltaSeconds, 0.0f));
+	// positions.addScaled(velocities, fTimeDeltaSeconds);
+	class Vector3fArray
+	{
+	public:
+		// Constructor, the array is empty
+		Vector3fArray();
+
+		// Constructor, the array holds the given number of zero vectors
+		Vector3fArray(size_t size);
+
+		// Constructor, the array holds a copy of the given vectors
+		Vector3fArray(std::span<const Vector3f> vectors);
+
+		// Copy constructor
+		Vector3fArray(const Vector3fArray& vectors);
+
+		// Move constructor, the given array is left empty
+		Vector3fArray(Vector3fArray&& vectors) noexcept;
+
+		// Destructor, frees the memory
+		~Vector3fArray();
+
+		// Copies the given array into this one
+		Vector3fArray& operator =(const Vector3fArray& vectors);
+
+		// Moves the given array into this one, the given array is left empty
+		Vector3fArray& operator =(Vector3fArray&& vectors) noexcept;
+
+		// Returns the number of vectors in the array
+		size_t size(void) const;
+
+		// Changes the number of vectors in the array.
+		// Vectors which were already in the array keep their values, new ones are set to zero.
+		// The memory is only reallocated if the new size is greater than getCapacity(), in which case the capacity is
+		// at least doubled.
+		void resize(size_t size);
+
+		// Makes sure that the array has room for at least the given number of vectors, so that it isn't reallocated
+		// until it grows past them. This never makes the capacity smaller.
+		void reserve(size_t capacity);
+
+		// Returns the number of vectors the array has room for before it needs reallocating
+		size_t getCapacity(void) const;
+
+		// Removes all vectors from the array and frees the memory, including the capacity
+		void clear(void);
+
+		// Sets the vector at the given index
+		void set(size_t index, const Vector3f& vector);
+
+		// Returns the vector at the given index
+		Vector3f get(size_t index) const;
+
+		// Replaces the contents of the array with the given vectors
+		void setFromVector3fs(std::span<const Vector3f> vectors);
+
+		// Copies the vectors into the given span, which must be the same size as the array
+		void getAsVector3fs(std::span<Vector3f> vectorsOut) const;
+
+		// Returns the vectors as a std::vector
+		std::vector<Vector3f> getAsVector3fs(void) const;
+
+		// Returns a pointer to the x, y or z components of the vectors.
+		// Each is aligned to 32 bytes and there are size() of them, followed by the padding.
+		// The pointers are invalidated by resize(), reserve(), clear(), setFromVector3fs() and assignment.
+		float* getX(void);
+		float* getY(void);
+		float* getZ(void);
+		const float* getX(void) const;
+		const float* getY(void) const;
+		const float* getZ(void) const;
+
+		// The methods below work on each vector in the array.
+		// Where another array is given, it must be the same size as this one and vector [i] of this array is used
+		// with vector [i] of the other array.
+
+		// Adds the given vector to each vector
+		void add(const Vector3f& vector);
+
+		// Adds the vectors of the given array to this array's
+		void add(const Vector3fArray& vectors);
+
+		// Subtracts the vectors of the given array from this array's
+		void subtract(const Vector3fArray& vectors);
+
+		// Adds the vectors of the given array, multiplied by the given scalar, to this array's.
+		// This is the one to use for moving things by their velocity. positions.addScaled(velocities, fTimeDeltaSeconds);
+		void addScaled(const Vector3fArray& vectors, float scalar);
+
+		// Multiplies each vector by the given scalar
+		void multiply(float scalar);
+
+		// Interpolates each vector towards the vector in the given array, given a position between 0.0f and 1.0f,
+		// the same as interpolate() in mathUtilities.h does for each component.
+		void interpolate(const Vector3fArray& vectors, float position);
+
+		// Normalises each vector so that it becomes a unit vector.
+		// Vectors which have zero length are not modified, the same as Vector3f::normalise().
+		void normalise(void);
+
+		// The methods below compute a value for each vector and store it in the given span, which must be the same size
+		// as the array.
+
+		// Computes the magnitude of each vector
+		void getMagnitude(std::span<float> magnitudesOut) const;
+
+		// Computes the dot product between each vector and the vector in the given array
+		void getDot(const Vector3fArray& vectors, std::span<float> dotsOut) const;
+
+		// Computes the distance between each vector and the vector in the given array, treating each vector as a point in 3D space
+		void getDistance(const Vector3fArray& vectors, std::span<float> distancesOut) const;
+
+		// Computes the distance between each vector and the given point
+		void getDistance(const Vector3f& point, std::span<float> distancesOut) const;
+
+		// Computes the distance squared between each vector and the given point.
+		// This is faster than getDistance(), as no square root is used.
+		void getDistanceSquared(const Vector3f& point, std::span<float> distancesOut) const;
+	private:
+		// The arrays are aligned to this many bytes and padded to a multiple of kPadding vectors
+		static const size_t kAlignment = 32;
+		static const size_t kPadding = kAlignment / sizeof(float);
+
+		// The x components, followed by the y components, followed by the z components, each capacity long
+		float* pData;
+
+		// The number of vectors in the array
+		size_t numVectors;
+
+		// The length of each of the x, y and z arrays within pData, which is a multiple of kPadding and at least numVectors
+		size_t capacity;
+
+		// Returns numVectors rounded up to a multiple of kPadding, which is how much of each of the x, y and z arrays
+		// the methods which work on whole SIMD registers use
+		size_t getNumPadded(void) const;
+
+		// Sets the padding after the vectors in each of the x, y and z arrays, up to getNumPadded(), back to zero
+		void clearPadding(void);
+
+		// Allocates pData to hold the given capacity, with all values set to zero. Does not free the old pData.
+		void allocate(size_t capacity);
+
+		// Frees pData
+		void free(void);
+	};
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "vector4f.h"
 #include <math.h>
+#include "simd.h"
 
 namespace DC
 {
@@ -16,54 +17,89 @@ namespace DC
 		w = fW;
 	}
 
+	// The SIMD code below loads and stores x, y, z and w as one, which relies on them being next to each other in memory
 	Vector4f Vector4f::operator +(const Vector4f& vec) const
 	{
+#if defined(DC_SIMD_SSE4_1)
+		Vector4f result;
+		_mm_storeu_ps(&result.x, _mm_add_ps(_mm_loadu_ps(&x), _mm_loadu_ps(&vec.x)));
+		return result;
+#else
 		return Vector4f(x + vec.x, y + vec.y, z + vec.z, w + vec.w);
+#endif
 	}
 
 	Vector4f& Vector4f::operator +=(const Vector4f& vec)
 	{
+#if defined(DC_SIMD_SSE4_1)
+		_mm_storeu_ps(&x, _mm_add_ps(_mm_loadu_ps(&x), _mm_loadu_ps(&vec.x)));
+#else
 		x += vec.x;
 		y += vec.y;
 		z += vec.z;
 		w += vec.w;
+#endif
 		return *this;
 	}
 
 	Vector4f Vector4f::operator -(const Vector4f& vec) const
 	{
+#if defined(DC_SIMD_SSE4_1)
+		Vector4f result;
+		_mm_storeu_ps(&result.x, _mm_sub_ps(_mm_loadu_ps(&x), _mm_loadu_ps(&vec.x)));
+		return result;
+#else
 		return Vector4f(x - vec.x, y - vec.y, z - vec.z, w - vec.w);
+#endif
 	}
 
 	Vector4f& Vector4f::operator -=(const Vector4f& vec)
 	{
+#if defined(DC_SIMD_SSE4_1)
+		_mm_storeu_ps(&x, _mm_sub_ps(_mm_loadu_ps(&x), _mm_loadu_ps(&vec.x)));
+#else
 		x -= vec.x;
 		y -= vec.y;
 		z -= vec.z;
 		w -= vec.w;
+#endif
 		return *this;
 	}
 
 	const Vector4f Vector4f::operator*(const float f) const
 	{
+#if defined(DC_SIMD_SSE4_1)
+		Vector4f result;
+		_mm_storeu_ps(&result.x, _mm_mul_ps(_mm_loadu_ps(&x), _mm_set1_ps(f)));
+		return result;
+#else
 		return Vector4f(x * f, y * f, z * f, w * f);
+#endif
 	}
 
 	void Vector4f::operator*=(const float f)
 	{
+#if defined(DC_SIMD_SSE4_1)
+		_mm_storeu_ps(&x, _mm_mul_ps(_mm_loadu_ps(&x), _mm_set1_ps(f)));
+#else
 		x = x * f;
 		y = y * f;
 		z = z * f;
 		w = w * f;
+#endif
 	}
 
 	const Vector4f Vector4f::operator *(const Vector4f& v) const
 	{
 		Vector4f result;
+#if defined(DC_SIMD_SSE4_1)
+		_mm_storeu_ps(&result.x, _mm_mul_ps(_mm_loadu_ps(&x), _mm_loadu_ps(&v.x)));
+#else
 		result.x = x * v.x;
 		result.y = y * v.y;
 		result.z = z * v.z;
 		result.w = w * v.w;
+#endif
 		return result;
 	}
 
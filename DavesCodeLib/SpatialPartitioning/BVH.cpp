@@ -0,0 +1,731 @@
+#include "BVH.h"
+#include "../Common/error.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace DC
+{
+	namespace
+	{
+		// Returns half of the surface area of the given box, which is all that's needed to compare the surface areas of boxes
+		float computeHalfSurfaceArea(const float* minPARAM, const float* maxPARAM)
+		{
+			float fDimX = maxPARAM[0] - minPARAM[0];
+			float fDimY = maxPARAM[1] - minPARAM[1];
+			float fDimZ = maxPARAM[2] - minPARAM[2];
+			return fDimX * fDimY + fDimY * fDimZ + fDimZ * fDimX;
+		}
+	}
+
+	BVH::BVH()
+	{
+		maxNodeDepth = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			bounds.min[i] = 0.0f;
+			bounds.max[i] = 0.0f;
+		}
+	}
+
+	BVH::~BVH()
+	{
+		free();
+	}
+
+	void BVH::build(const std::vector<AABB>& aabbsPARAM, unsigned int maxPrimitivesPerLeafPARAM)
+	{
+		free();
+
+		ErrorIfTrue(maxPrimitivesPerLeafPARAM < 1, L"BVH::build() failed. Given invalid number for maxPrimitivesPerLeaf. Must be at least one.");
+		if (aabbsPARAM.empty())
+			return;
+
+		// Copy the primitives' AABBs and compute their centres
+		unsigned int numPrimitives = (unsigned int)aabbsPARAM.size();
+		primitives.resize(numPrimitives);
+		primitiveIndicies.resize(numPrimitives);
+		std::vector<float> centroids(numPrimitives * 3);
+		for (unsigned int ui = 0; ui < numPrimitives; ui++)
+		{
+			Vector3f vMin = aabbsPARAM[ui].getMin();
+			Vector3f vMax = aabbsPARAM[ui].getMax();
+			PrimitiveBounds& primitive = primitives[ui];
+			primitive.min[0] = vMin.x;
+			primitive.min[1] = vMin.y;
+			primitive.min[2] = vMin.z;
+			primitive.max[0] = vMax.x;
+			primitive.max[1] = vMax.y;
+			primitive.max[2] = vMax.z;
+			for (int i = 0; i < 3; i++)
+				centroids[ui * 3 + i] = (primitive.min[i] + primitive.max[i]) * 0.5f;
+			primitiveIndicies[ui] = ui;
+		}
+
+		// Build the tree, starting with the root node which holds all of the primitives
+		BuildRange range;
+		range.first = 0;
+		range.count = numPrimitives;
+		computeBuildRangeBounds(range);
+		bounds = range.bounds;
+		nodes.reserve(numPrimitives / 2 + 1);
+		buildNode(range, centroids, maxPrimitivesPerLeafPARAM, 0);
+
+		ErrorIfTrue(maxNodeDepth * (kNodeWidth - 1) + 1 >= kMaxStackSize, L"BVH::build() failed. The tree is too deep to be walked, the primitives given are unable to be split evenly.");
+	}
+
+	void BVH::free(void)
+	{
+		std::vector<Node>().swap(nodes);
+		std::vector<PrimitiveBounds>().swap(primitives);
+		std::vector<unsigned int>().swap(primitiveIndicies);
+		maxNodeDepth = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			bounds.min[i] = 0.0f;
+			bounds.max[i] = 0.0f;
+		}
+	}
+
+	unsigned int BVH::getNumPrimitives(void) const
+	{
+		return (unsigned int)primitives.size();
+	}
+
+	unsigned int BVH::getNumNodes(void) const
+	{
+		return (unsigned int)nodes.size();
+	}
+
+	unsigned int BVH::getMaxNodeDepth(void) const
+	{
+		return maxNodeDepth;
+	}
+
+	AABB BVH::getBounds(void) const
+	{
+		return AABB(Vector3f(bounds.min[0], bounds.min[1], bounds.min[2]), Vector3f(bounds.max[0], bounds.max[1], bounds.max[2]));
+	}
+
+	bool BVH::getRayIntersection(const Vector3f& originPARAM, const Vector3f& directionPARAM, float maxDistancePARAM, unsigned int& primitiveIndexOutPARAM, float& distanceOutPARAM) const
+	{
+		float fLength = directionPARAM.getMagnitude();
+		ErrorIfTrue(fLength <= 0.0f, L"BVH::getRayIntersection() failed. The given direction has a length of zero.");
+		Vector3f vDirection(directionPARAM.x / fLength, directionPARAM.y / fLength, directionPARAM.z / fLength);
+		return traceRay(originPARAM, vDirection, maxDistancePARAM, false, primitiveIndexOutPARAM, distanceOutPARAM);
+	}
+
+	bool BVH::getRayIntersectsAny(const Vector3f& originPARAM, const Vector3f& directionPARAM, float maxDistancePARAM) const
+	{
+		float fLength = directionPARAM.getMagnitude();
+		ErrorIfTrue(fLength <= 0.0f, L"BVH::getRayIntersectsAny() failed. The given direction has a length of zero.");
+		Vector3f vDirection(directionPARAM.x / fLength, directionPARAM.y / fLength, directionPARAM.z / fLength);
+		unsigned int primitiveIndex;
+		float fDistance;
+		return traceRay(originPARAM, vDirection, maxDistancePARAM, true, primitiveIndex, fDistance);
+	}
+
+	bool BVH::getSegmentIntersection(const Vector3f& startPARAM, const Vector3f& endPARAM, unsigned int& primitiveIndexOutPARAM, float& fractionOutPARAM) const
+	{
+		// By using the segment as the ray's direction, the position along the ray is how far along the segment it is
+		return traceRay(startPARAM, endPARAM - startPARAM, 1.0f, false, primitiveIndexOutPARAM, fractionOutPARAM);
+	}
+
+	bool BVH::getSegmentIntersectsAny(const Vector3f& startPARAM, const Vector3f& endPARAM) const
+	{
+		unsigned int primitiveIndex;
+		float fFraction;
+		return traceRay(startPARAM, endPARAM - startPARAM, 1.0f, true, primitiveIndex, fFraction);
+	}
+
+	std::vector<unsigned int> BVH::getPrimitivesWithinAABB(const AABB& aabbPARAM) const
+	{
+		std::vector<unsigned int> vResult;
+		getPrimitivesWithinAABB(aabbPARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<unsigned int> BVH::getPrimitivesWithinFrustum(const Frustum& frustumPARAM) const
+	{
+		std::vector<unsigned int> vResult;
+		getPrimitivesWithinFrustum(frustumPARAM, vResult);
+		return vResult;
+	}
+
+	void BVH::getPrimitivesWithinAABB(const AABB& aabbPARAM, std::vector<unsigned int>& primitivesOutPARAM) const
+	{
+		if (nodes.empty())
+			return;
+
+		Vector3f vMin = aabbPARAM.getMin();
+		Vector3f vMax = aabbPARAM.getMax();
+		SIMDFloats vMinX = simdSet(vMin.x);
+		SIMDFloats vMinY = simdSet(vMin.y);
+		SIMDFloats vMinZ = simdSet(vMin.z);
+		SIMDFloats vMaxX = simdSet(vMax.x);
+		SIMDFloats vMaxY = simdSet(vMax.y);
+		SIMDFloats vMaxZ = simdSet(vMax.z);
+
+		unsigned int stack[kMaxStackSize];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+
+			// Test the AABB against all of the node's children at once, kSIMDWidth at a time.
+			// Unused children have their minimum greater than their maximum, so never intersect.
+			int mask = 0;
+			for (unsigned int i = 0; i < kNodeWidth; i += kSIMDWidth)
+			{
+				SIMDInts vIntersects = simdAndInts(simdCompareLessOrEqual(simdLoad(node.childMinX + i), vMaxX), simdCompareGreaterOrEqual(simdLoad(node.childMaxX + i), vMinX));
+				vIntersects = simdAndInts(vIntersects, simdAndInts(simdCompareLessOrEqual(simdLoad(node.childMinY + i), vMaxY), simdCompareGreaterOrEqual(simdLoad(node.childMaxY + i), vMinY)));
+				vIntersects = simdAndInts(vIntersects, simdAndInts(simdCompareLessOrEqual(simdLoad(node.childMinZ + i), vMaxZ), simdCompareGreaterOrEqual(simdLoad(node.childMaxZ + i), vMinZ)));
+				mask |= simdGetMask(vIntersects) << i;
+			}
+			for (unsigned int i = 0; i < kNodeWidth; i++)
+			{
+				if (!(mask & (1 << i)))
+					continue;
+
+				if (!node.childNumPrimitives[i])
+				{
+					stack[stackSize++] = node.childIndex[i];
+					continue;
+				}
+
+				// The child is a leaf, so test each of it's primitives
+				unsigned int last = node.childIndex[i] + node.childNumPrimitives[i];
+				for (unsigned int primitive = node.childIndex[i]; primitive < last; primitive++)
+				{
+					const PrimitiveBounds& primitiveBounds = primitives[primitive];
+					if (primitiveBounds.min[0] <= vMax.x && primitiveBounds.max[0] >= vMin.x &&
+						primitiveBounds.min[1] <= vMax.y && primitiveBounds.max[1] >= vMin.y &&
+						primitiveBounds.min[2] <= vMax.z && primitiveBounds.max[2] >= vMin.z)
+						primitivesOutPARAM.push_back(primitiveIndicies[primitive]);
+				}
+			}
+		}
+	}
+
+	void BVH::getPrimitivesWithinFrustum(const Frustum& frustumPARAM, std::vector<unsigned int>& primitivesOutPARAM) const
+	{
+		if (nodes.empty())
+			return;
+
+		// Store each plane's normal and distance to origin
+		const Plane* pPlanes[6] = { &frustumPARAM.planeNear, &frustumPARAM.planeFar, &frustumPARAM.planeLeft, &frustumPARAM.planeRight, &frustumPARAM.planeTop, &frustumPARAM.planeBottom };
+		float fNormals[6][3];
+		float fDistances[6];
+		for (int plane = 0; plane < 6; plane++)
+		{
+			Vector3f vNormal = pPlanes[plane]->getNormal();
+			fNormals[plane][0] = vNormal.x;
+			fNormals[plane][1] = vNormal.y;
+			fNormals[plane][2] = vNormal.z;
+			fDistances[plane] = pPlanes[plane]->getDistanceToOrigin();
+		}
+
+		unsigned int stack[kMaxStackSize];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+
+			// Test all of the node's children against each plane at once, kSIMDWidth at a time.
+			// For each plane, the corner of each child's AABB which is furthest along the plane's normal is outside of
+			// the plane if the whole AABB is and the nearest corner is inside of the plane if the whole AABB is.
+			int insideMask = 0;
+			int fullyInsideMask = 0;
+			for (unsigned int i = 0; i < kNodeWidth; i += kSIMDWidth)
+			{
+				SIMDInts vInside = simdSetInts(0xFFFFFFFF);
+				SIMDInts vFullyInside = simdSetInts(0xFFFFFFFF);
+				for (int plane = 0; plane < 6; plane++)
+				{
+					SIMDFloats vNormalX = simdSet(fNormals[plane][0]);
+					SIMDFloats vNormalY = simdSet(fNormals[plane][1]);
+					SIMDFloats vNormalZ = simdSet(fNormals[plane][2]);
+					SIMDFloats vDistance = simdSet(fDistances[plane]);
+					const float* pFurthestX = fNormals[plane][0] >= 0.0f ? node.childMaxX : node.childMinX;
+					const float* pFurthestY = fNormals[plane][1] >= 0.0f ? node.childMaxY : node.childMinY;
+					const float* pFurthestZ = fNormals[plane][2] >= 0.0f ? node.childMaxZ : node.childMinZ;
+					const float* pNearestX = fNormals[plane][0] >= 0.0f ? node.childMinX : node.childMaxX;
+					const float* pNearestY = fNormals[plane][1] >= 0.0f ? node.childMinY : node.childMaxY;
+					const float* pNearestZ = fNormals[plane][2] >= 0.0f ? node.childMinZ : node.childMaxZ;
+					SIMDFloats vFurthest = simdAdd(simdAdd(simdMul(vNormalX, simdLoad(pFurthestX + i)), simdMul(vNormalY, simdLoad(pFurthestY + i))), simdMul(vNormalZ, simdLoad(pFurthestZ + i)));
+					SIMDFloats vNearest = simdAdd(simdAdd(simdMul(vNormalX, simdLoad(pNearestX + i)), simdMul(vNormalY, simdLoad(pNearestY + i))), simdMul(vNormalZ, simdLoad(pNearestZ + i)));
+					vInside = simdAndInts(vInside, simdCompareGreaterOrEqual(vFurthest, vDistance));
+					vFullyInside = simdAndInts(vFullyInside, simdCompareGreaterOrEqual(vNearest, vDistance));
+				}
+				insideMask |= simdGetMask(vInside) << i;
+				fullyInsideMask |= simdGetMask(vFullyInside) << i;
+			}
+
+			for (unsigned int i = 0; i < kNodeWidth; i++)
+			{
+				if (!(insideMask & (1 << i)))
+					continue;
+
+				// Unused children have their minimum greater than their maximum, which may not be outside of a plane
+				// whose normal has components of zero, so skip them.
+				if (!node.childNumPrimitives[i] && !node.childIndex[i])
+					continue;
+
+				// If the child is fully inside of the frustum, so are all of it's primitives
+				if (fullyInsideMask & (1 << i))
+				{
+					addAllPrimitivesOfChild(node, i, primitivesOutPARAM);
+					continue;
+				}
+
+				if (!node.childNumPrimitives[i])
+				{
+					stack[stackSize++] = node.childIndex[i];
+					continue;
+				}
+
+				// The child is a leaf, so test each of it's primitives
+				unsigned int last = node.childIndex[i] + node.childNumPrimitives[i];
+				for (unsigned int primitive = node.childIndex[i]; primitive < last; primitive++)
+				{
+					const PrimitiveBounds& primitiveBounds = primitives[primitive];
+					bool bOutside = false;
+					for (int plane = 0; plane < 6 && !bOutside; plane++)
+					{
+						float fFurthest = 0.0f;
+						for (int axis = 0; axis < 3; axis++)
+							fFurthest += fNormals[plane][axis] * (fNormals[plane][axis] >= 0.0f ? primitiveBounds.max[axis] : primitiveBounds.min[axis]);
+						bOutside = fFurthest < fDistances[plane];
+					}
+					if (!bOutside)
+						primitivesOutPARAM.push_back(primitiveIndicies[primitive]);
+				}
+			}
+		}
+	}
+
+	void BVH::computeBuildRangeBounds(BuildRange& rangePARAM) const
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			rangePARAM.bounds.min[i] = FLT_MAX;
+			rangePARAM.bounds.max[i] = -FLT_MAX;
+		}
+		unsigned int last = rangePARAM.first + rangePARAM.count;
+		for (unsigned int primitive = rangePARAM.first; primitive < last; primitive++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				if (primitives[primitive].min[i] < rangePARAM.bounds.min[i])
+					rangePARAM.bounds.min[i] = primitives[primitive].min[i];
+				if (primitives[primitive].max[i] > rangePARAM.bounds.max[i])
+					rangePARAM.bounds.max[i] = primitives[primitive].max[i];
+			}
+		}
+	}
+
+	void BVH::splitBuildRange(const BuildRange& rangePARAM, std::vector<float>& centroidsPARAM, BuildRange& leftOutPARAM, BuildRange& rightOutPARAM)
+	{
+		unsigned int last = rangePARAM.first + rangePARAM.count;
+
+		// Compute the bounds of the primitives' centres, which is the region the bins are spread across
+		float fCentroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float fCentroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (unsigned int primitive = rangePARAM.first; primitive < last; primitive++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				float fCentroid = centroidsPARAM[primitive * 3 + i];
+				if (fCentroid < fCentroidMin[i])
+					fCentroidMin[i] = fCentroid;
+				if (fCentroid > fCentroidMax[i])
+					fCentroidMax[i] = fCentroid;
+			}
+		}
+
+		// For each axis, sort the primitives into bins by their centres, then find the split between two bins which
+		// gives the lowest cost, which is the surface area of each side multiplied by the number of primitives within it.
+		int iBestAxis = -1;
+		unsigned int iBestSplit = 0;
+		float fBestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float fExtent = fCentroidMax[axis] - fCentroidMin[axis];
+			if (fExtent <= 0.0f)
+				continue;
+
+			unsigned int binCounts[kNumBins] = {};
+			PrimitiveBounds binBounds[kNumBins];
+			for (unsigned int bin = 0; bin < kNumBins; bin++)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					binBounds[bin].min[i] = FLT_MAX;
+					binBounds[bin].max[i] = -FLT_MAX;
+				}
+			}
+			float fBinsPerUnit = float(kNumBins) / fExtent;
+			for (unsigned int primitive = rangePARAM.first; primitive < last; primitive++)
+			{
+				unsigned int bin = (unsigned int)((centroidsPARAM[primitive * 3 + axis] - fCentroidMin[axis]) * fBinsPerUnit);
+				if (bin >= kNumBins)
+					bin = kNumBins - 1;
+				binCounts[bin]++;
+				for (int i = 0; i < 3; i++)
+				{
+					if (primitives[primitive].min[i] < binBounds[bin].min[i])
+						binBounds[bin].min[i] = primitives[primitive].min[i];
+					if (primitives[primitive].max[i] > binBounds[bin].max[i])
+						binBounds[bin].max[i] = primitives[primitive].max[i];
+				}
+			}
+
+			// Sweep from the right, storing the area and count of everything to the right of each split
+			float fRightAreas[kNumBins];
+			unsigned int rightCounts[kNumBins];
+			PrimitiveBounds accumulated = binBounds[kNumBins - 1];
+			unsigned int accumulatedCount = 0;
+			for (unsigned int bin = kNumBins - 1; bin > 0; bin--)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					if (binBounds[bin].min[i] < accumulated.min[i])
+						accumulated.min[i] = binBounds[bin].min[i];
+					if (binBounds[bin].max[i] > accumulated.max[i])
+						accumulated.max[i] = binBounds[bin].max[i];
+				}
+				accumulatedCount += binCounts[bin];
+				fRightAreas[bin] = computeHalfSurfaceArea(accumulated.min, accumulated.max);
+				rightCounts[bin] = accumulatedCount;
+			}
+
+			// Then sweep from the left, computing the cost of splitting between each bin and the next
+			accumulated = binBounds[0];
+			accumulatedCount = 0;
+			for (unsigned int bin = 0; bin < kNumBins - 1; bin++)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					if (binBounds[bin].min[i] < accumulated.min[i])
+						accumulated.min[i] = binBounds[bin].min[i];
+					if (binBounds[bin].max[i] > accumulated.max[i])
+						accumulated.max[i] = binBounds[bin].max[i];
+				}
+				accumulatedCount += binCounts[bin];
+				if (!accumulatedCount || !rightCounts[bin + 1])
+					continue;
+				float fCost = computeHalfSurfaceArea(accumulated.min, accumulated.max) * float(accumulatedCount) + fRightAreas[bin + 1] * float(rightCounts[bin + 1]);
+				if (fCost < fBestCost)
+				{
+					fBestCost = fCost;
+					iBestAxis = axis;
+					iBestSplit = bin;
+				}
+			}
+		}
+
+		unsigned int middle;
+		if (iBestAxis >= 0)
+		{
+			// Move the primitives which are in the bins on the left of the split to the start of the range
+			float fBinsPerUnit = float(kNumBins) / (fCentroidMax[iBestAxis] - fCentroidMin[iBestAxis]);
+			middle = rangePARAM.first;
+			for (unsigned int primitive = rangePARAM.first; primitive < last; primitive++)
+			{
+				unsigned int bin = (unsigned int)((centroidsPARAM[primitive * 3 + iBestAxis] - fCentroidMin[iBestAxis]) * fBinsPerUnit);
+				if (bin >= kNumBins)
+					bin = kNumBins - 1;
+				if (bin > iBestSplit)
+					continue;
+				std::swap(primitives[primitive], primitives[middle]);
+				std::swap(primitiveIndicies[primitive], primitiveIndicies[middle]);
+				for (int i = 0; i < 3; i++)
+					std::swap(centroidsPARAM[primitive * 3 + i], centroidsPARAM[middle * 3 + i]);
+				middle++;
+			}
+		}
+		else
+		{
+			// All of the primitives' centres are at the same position, so simply split them in half
+			middle = rangePARAM.first + rangePARAM.count / 2;
+		}
+
+		leftOutPARAM.first = rangePARAM.first;
+		leftOutPARAM.count = middle - rangePARAM.first;
+		rightOutPARAM.first = middle;
+		rightOutPARAM.count = last - middle;
+		computeBuildRangeBounds(leftOutPARAM);
+		computeBuildRangeBounds(rightOutPARAM);
+	}
+
+	unsigned int BVH::buildNode(const BuildRange& rangePARAM, std::vector<float>& centroidsPARAM, unsigned int maxPrimitivesPerLeafPARAM, unsigned int nodeDepthPARAM)
+	{
+		if (nodeDepthPARAM > maxNodeDepth)
+			maxNodeDepth = nodeDepthPARAM;
+
+		// Split the range into up to kNodeWidth children, by repeatedly splitting whichever child has the largest
+		// surface area and more primitives than a leaf may hold.
+		BuildRange children[kNodeWidth];
+		unsigned int numChildren = 1;
+		children[0] = rangePARAM;
+		while (numChildren < kNodeWidth)
+		{
+			int iLargestChild = -1;
+			float fLargestArea = -1.0f;
+			for (unsigned int i = 0; i < numChildren; i++)
+			{
+				if (children[i].count <= maxPrimitivesPerLeafPARAM)
+					continue;
+				float fArea = computeHalfSurfaceArea(children[i].bounds.min, children[i].bounds.max);
+				if (fArea > fLargestArea)
+				{
+					fLargestArea = fArea;
+					iLargestChild = int(i);
+				}
+			}
+			if (iLargestChild < 0)
+				break;
+
+			BuildRange left;
+			BuildRange right;
+			splitBuildRange(children[iLargestChild], centroidsPARAM, left, right);
+			children[iLargestChild] = left;
+			children[numChildren++] = right;
+		}
+
+		// Create the node, with all of it's children unused
+		unsigned int nodeIndex = (unsigned int)nodes.size();
+		nodes.emplace_back();
+		for (unsigned int i = 0; i < kNodeWidth; i++)
+		{
+			nodes[nodeIndex].childMinX[i] = FLT_MAX;
+			nodes[nodeIndex].childMinY[i] = FLT_MAX;
+			nodes[nodeIndex].childMinZ[i] = FLT_MAX;
+			nodes[nodeIndex].childMaxX[i] = -FLT_MAX;
+			nodes[nodeIndex].childMaxY[i] = -FLT_MAX;
+			nodes[nodeIndex].childMaxZ[i] = -FLT_MAX;
+			nodes[nodeIndex].childIndex[i] = 0;
+			nodes[nodeIndex].childNumPrimitives[i] = 0;
+		}
+
+		// Fill in each child, creating nodes for those with too many primitives to be a leaf.
+		// Creating a node may move the nodes in memory, so the node is accessed by index each time.
+		for (unsigned int i = 0; i < numChildren; i++)
+		{
+			unsigned int childIndex;
+			unsigned int childNumPrimitives;
+			if (children[i].count <= maxPrimitivesPerLeafPARAM)
+			{
+				childIndex = children[i].first;
+				childNumPrimitives = children[i].count;
+			}
+			else
+			{
+				childIndex = buildNode(children[i], centroidsPARAM, maxPrimitivesPerLeafPARAM, nodeDepthPARAM + 1);
+				childNumPrimitives = 0;
+			}
+			Node& node = nodes[nodeIndex];
+			node.childMinX[i] = children[i].bounds.min[0];
+			node.childMinY[i] = children[i].bounds.min[1];
+			node.childMinZ[i] = children[i].bounds.min[2];
+			node.childMaxX[i] = children[i].bounds.max[0];
+			node.childMaxY[i] = children[i].bounds.max[1];
+			node.childMaxZ[i] = children[i].bounds.max[2];
+			node.childIndex[i] = childIndex;
+			node.childNumPrimitives[i] = childNumPrimitives;
+		}
+		return nodeIndex;
+	}
+
+	bool BVH::traceRay(const Vector3f& originPARAM, const Vector3f& directionPARAM, float maxTPARAM, bool anyHitPARAM, unsigned int& primitiveIndexOutPARAM, float& tOutPARAM) const
+	{
+		if (nodes.empty())
+			return false;
+
+		// Along any axis which the ray is parallel to, it's position doesn't change, so it only hits an AABB whose range
+		// along that axis includes it's position, including on either of it's faces. Those axes are tested seperately
+		// and use the enter and exit positions of one of the other axes, or if the ray doesn't move at all, an inverse
+		// direction of zero which makes them zero.
+		float fOrigin[3] = { originPARAM.x, originPARAM.y, originPARAM.z };
+		float fDirection[3] = { directionPARAM.x, directionPARAM.y, directionPARAM.z };
+		float fInvDirection[3];
+		bool bParallel[3];
+		unsigned int parallelAxes[3];
+		unsigned int numParallelAxes = 0;
+		int slabAxis = -1;
+		for (int i = 0; i < 3; i++)
+		{
+			bParallel[i] = fabsf(fDirection[i]) < 1e-20f;
+			fInvDirection[i] = bParallel[i] ? 0.0f : 1.0f / fDirection[i];
+			if (bParallel[i])
+				parallelAxes[numParallelAxes++] = i;
+			else if (slabAxis < 0)
+				slabAxis = i;
+		}
+		if (slabAxis < 0)
+			slabAxis = 0;
+		unsigned int axisUsed[3];
+		for (int i = 0; i < 3; i++)
+			axisUsed[i] = bParallel[i] ? slabAxis : i;
+
+		// Along each axis, the ray enters an AABB through it's minimum if it's moving in the positive direction,
+		// otherwise through it's maximum. Choosing which side is which once here means that unused children, whose
+		// minimum is greater than their maximum, are never hit.
+		bool bNegative[3] = { fInvDirection[0] < 0.0f, fInvDirection[1] < 0.0f, fInvDirection[2] < 0.0f };
+		SIMDFloats vOriginX = simdSet(fOrigin[axisUsed[0]]);
+		SIMDFloats vOriginY = simdSet(fOrigin[axisUsed[1]]);
+		SIMDFloats vOriginZ = simdSet(fOrigin[axisUsed[2]]);
+		SIMDFloats vInvDirectionX = simdSet(fInvDirection[axisUsed[0]]);
+		SIMDFloats vInvDirectionY = simdSet(fInvDirection[axisUsed[1]]);
+		SIMDFloats vInvDirectionZ = simdSet(fInvDirection[axisUsed[2]]);
+		SIMDFloats vParallelOrigin[3];
+		for (unsigned int i = 0; i < numParallelAxes; i++)
+			vParallelOrigin[i] = simdSet(fOrigin[parallelAxes[i]]);
+		SIMDFloats vZero = simdSet(0.0f);
+
+		bool bHit = false;
+		float fNearestT = maxTPARAM;
+
+		// Each entry of the stack holds a node to visit and the position along the ray at which it's AABB was entered,
+		// so that nodes which are further away than the nearest hit found since they were added can be skipped.
+		struct StackEntry
+		{
+			unsigned int node;
+			float tEnter;
+		};
+		StackEntry stack[kMaxStackSize];
+		unsigned int stackSize = 0;
+		stack[stackSize].node = 0;
+		stack[stackSize].tEnter = 0.0f;
+		stackSize++;
+		while (stackSize)
+		{
+			stackSize--;
+			if (stack[stackSize].tEnter > fNearestT)
+				continue;
+			const Node& node = nodes[stack[stackSize].node];
+
+			// Test the ray against all of the node's children at once, kSIMDWidth at a time
+			const float* pChildMin[3] = { node.childMinX, node.childMinY, node.childMinZ };
+			const float* pChildMax[3] = { node.childMaxX, node.childMaxY, node.childMaxZ };
+			const float* pEnterX = bNegative[axisUsed[0]] ? pChildMax[axisUsed[0]] : pChildMin[axisUsed[0]];
+			const float* pEnterY = bNegative[axisUsed[1]] ? pChildMax[axisUsed[1]] : pChildMin[axisUsed[1]];
+			const float* pEnterZ = bNegative[axisUsed[2]] ? pChildMax[axisUsed[2]] : pChildMin[axisUsed[2]];
+			const float* pExitX = bNegative[axisUsed[0]] ? pChildMin[axisUsed[0]] : pChildMax[axisUsed[0]];
+			const float* pExitY = bNegative[axisUsed[1]] ? pChildMin[axisUsed[1]] : pChildMax[axisUsed[1]];
+			const float* pExitZ = bNegative[axisUsed[2]] ? pChildMin[axisUsed[2]] : pChildMax[axisUsed[2]];
+			SIMDFloats vNearestT = simdSet(fNearestT);
+			float fEnter[kNodeWidth];
+			int mask = 0;
+			for (unsigned int i = 0; i < kNodeWidth; i += kSIMDWidth)
+			{
+				SIMDFloats vEnterX = simdMul(simdSub(simdLoad(pEnterX + i), vOriginX), vInvDirectionX);
+				SIMDFloats vEnterY = simdMul(simdSub(simdLoad(pEnterY + i), vOriginY), vInvDirectionY);
+				SIMDFloats vEnterZ = simdMul(simdSub(simdLoad(pEnterZ + i), vOriginZ), vInvDirectionZ);
+				SIMDFloats vExitX = simdMul(simdSub(simdLoad(pExitX + i), vOriginX), vInvDirectionX);
+				SIMDFloats vExitY = simdMul(simdSub(simdLoad(pExitY + i), vOriginY), vInvDirectionY);
+				SIMDFloats vExitZ = simdMul(simdSub(simdLoad(pExitZ + i), vOriginZ), vInvDirectionZ);
+				SIMDFloats vEnter = simdMax(simdMax(vEnterX, vEnterY), simdMax(vEnterZ, vZero));
+				SIMDFloats vExit = simdMin(simdMin(vExitX, vExitY), simdMin(vExitZ, vNearestT));
+				SIMDInts vHit = simdCompareLessOrEqual(vEnter, vExit);
+				for (unsigned int j = 0; j < numParallelAxes; j++)
+				{
+					vHit = simdAndInts(vHit, simdCompareLessOrEqual(simdLoad(pChildMin[parallelAxes[j]] + i), vParallelOrigin[j]));
+					vHit = simdAndInts(vHit, simdCompareGreaterOrEqual(simdLoad(pChildMax[parallelAxes[j]] + i), vParallelOrigin[j]));
+				}
+				mask |= simdGetMask(vHit) << i;
+				simdStoreUnaligned(fEnter + i, vEnter);
+			}
+			if (!mask)
+				continue;
+
+			// Gather the child nodes which were hit, testing the primitives of any leaves straight away
+			unsigned int hitChildren[kNodeWidth];
+			unsigned int numHitChildren = 0;
+			for (unsigned int i = 0; i < kNodeWidth; i++)
+			{
+				if (!(mask & (1 << i)))
+					continue;
+
+				if (!node.childNumPrimitives[i])
+				{
+					hitChildren[numHitChildren++] = i;
+					continue;
+				}
+
+				unsigned int last = node.childIndex[i] + node.childNumPrimitives[i];
+				for (unsigned int primitive = node.childIndex[i]; primitive < last; primitive++)
+				{
+					const PrimitiveBounds& primitiveBounds = primitives[primitive];
+					float fEnterT = 0.0f;
+					float fExitT = fNearestT;
+					bool bOutside = false;
+					for (int axis = 0; axis < 3; axis++)
+					{
+						if (bParallel[axis])
+						{
+							if (fOrigin[axis] < primitiveBounds.min[axis] || fOrigin[axis] > primitiveBounds.max[axis])
+								bOutside = true;
+							continue;
+						}
+						float fEnterAxis = ((bNegative[axis] ? primitiveBounds.max[axis] : primitiveBounds.min[axis]) - fOrigin[axis]) * fInvDirection[axis];
+						float fExitAxis = ((bNegative[axis] ? primitiveBounds.min[axis] : primitiveBounds.max[axis]) - fOrigin[axis]) * fInvDirection[axis];
+						if (fEnterAxis > fEnterT)
+							fEnterT = fEnterAxis;
+						if (fExitAxis < fExitT)
+							fExitT = fExitAxis;
+					}
+					if (bOutside || fEnterT > fExitT)
+						continue;
+
+					bHit = true;
+					fNearestT = fEnterT;
+					primitiveIndexOutPARAM = primitiveIndicies[primitive];
+					tOutPARAM = fEnterT;
+					if (anyHitPARAM)
+						return true;
+				}
+			}
+
+			// Sort the child nodes so that the furthest is added to the stack first and the nearest is visited next
+			for (unsigned int i = 1; i < numHitChildren; i++)
+			{
+				unsigned int child = hitChildren[i];
+				unsigned int j = i;
+				while (j > 0 && fEnter[hitChildren[j - 1]] < fEnter[child])
+				{
+					hitChildren[j] = hitChildren[j - 1];
+					j--;
+				}
+				hitChildren[j] = child;
+			}
+			for (unsigned int i = 0; i < numHitChildren; i++)
+			{
+				stack[stackSize].node = node.childIndex[hitChildren[i]];
+				stack[stackSize].tEnter = fEnter[hitChildren[i]];
+				stackSize++;
+			}
+		}
+		return bHit;
+	}
+
+	void BVH::addAllPrimitivesOfChild(const Node& nodePARAM, unsigned int childPARAM, std::vector<unsigned int>& primitivesOutPARAM) const
+	{
+		if (nodePARAM.childNumPrimitives[childPARAM])
+		{
+			unsigned int last = nodePARAM.childIndex[childPARAM] + nodePARAM.childNumPrimitives[childPARAM];
+			for (unsigned int primitive = nodePARAM.childIndex[childPARAM]; primitive < last; primitive++)
+				primitivesOutPARAM.push_back(primitiveIndicies[primitive]);
+			return;
+		}
+
+		const Node& childNode = nodes[nodePARAM.childIndex[childPARAM]];
+		for (unsigned int i = 0; i < kNodeWidth; i++)
+		{
+			if (childNode.childNumPrimitives[i] || childNode.childIndex[i])
+				addAllPrimitivesOfChild(childNode, i, primitivesOutPARAM);
+		}
+	}
+}
\ No newline at end of file
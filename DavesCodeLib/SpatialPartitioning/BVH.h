@@ -0,0 +1,202 @@
+#pragma once
+#include "../Math/AABB.h"
+#include "../Math/frustum.h"
+#include "../Math/simd.h"
+#include <vector>
+
+namespace DC
+{
+	// A bounding volume hierarchy, used to quickly find which of lots of static objects a ray, line segment, AABB
+	// or frustum hits, for things such as picking, line of sight checks and culling of static meshes.
+	//
+	// Unlike the OctTree, which stores points, the BVH stores objects with a size. Each object, which we'll call a
+	// primitive, is given to the BVH as an AABB which encloses it and is referred to by it's index within the
+	// vector of AABBs given to build(). The queries return these indicies, so the user can look up the objects
+	// they represent in their own arrays.
+	//
+	// The primitives are grouped together into a tree of nodes, each of which has up to four child nodes and an
+	// AABB around each of it's children. A query only has to visit the children whose AABBs it hits, so most of the
+	// primitives are never looked at. The four AABBs of each node's children are stored together, so that all four
+	// of them can be tested against a ray, AABB or frustum at once with SIMD instructions.
+	// With DC_SIMD_AVX2, which tests eight floats at once, each node has up to eight children instead (See Math/simd.h).
+	// The tree is built using the surface area heuristic, which groups the primitives in whichever way gives the
+	// smallest total surface area of the child AABBs, as the chance of a ray hitting an AABB is roughly proportional
+	// to it's surface area. Finding the best grouping is done by sorting the primitives into a number of bins along
+	// each axis and only testing the groupings between the bins, which is much faster than testing all of them.
+	// The nodes are stored within a single array, with the root node at index 0. As the root node can never be a
+	// child of another node, a child node index of 0 means that there is no child.
+	//
+	// The BVH is built once and does not change until build() is called again, so it is best suited to static
+	// geometry. For moving objects, use the OctTree instead.
+	// As the queries do not modify the BVH, any number of threads may query it at once, so long as none of them are
+	// calling build() or free() at the same time.
+	//
+	// Example:
+	// std::vector<AABB> aabbs;
+	// for (each of the static meshes)
+	//     aabbs.push_back(mesh.getAABB());
+	// BVH bvh;
+	// bvh.build(aabbs);
+	// if (!bvh.getSegmentIntersectsAny(agentEyePosition, targetPosition))
+	//     // The agent can see the target.
+	class BVH
+	{
+	public:
+		// Constructor, the BVH is empty until build() is called
+		BVH();
+
+		// Destructor, frees all memory
+		~BVH();
+
+		// Builds the BVH from the given AABBs, each of which encloses a primitive.
+		// Each primitive is referred to by it's index within the given vector.
+		// Any existing nodes are freed first.
+		// maxPrimitivesPerLeaf is the number of primitives which are grouped together before they're split into
+		// child nodes. This must be at least 1, otherwise an exception occurs.
+		void build(const std::vector<AABB>& aabbs, unsigned int maxPrimitivesPerLeaf = 4);
+
+		// Frees all nodes and primitives, leaving the BVH empty
+		void free(void);
+
+		// Returns the number of primitives which the BVH was built from
+		unsigned int getNumPrimitives(void) const;
+
+		// Returns the number of nodes within the BVH
+		unsigned int getNumNodes(void) const;
+
+		// Returns the maximum depth of the nodes, where the root node is at depth 0.
+		unsigned int getMaxNodeDepth(void) const;
+
+		// Returns an AABB which encloses all of the primitives
+		// If the BVH is empty, an AABB with it's min and max at the origin is returned.
+		AABB getBounds(void) const;
+
+		// Finds the nearest primitive which the given ray hits.
+		// direction does not have to be of unit length.
+		// maxDistance is the furthest distance along the ray from origin which primitives are hit.
+		// Returns true if a primitive was hit, in which case primitiveIndexOut is set to the primitive's index and
+		// distanceOut is set to the distance along the ray at which the primitive's AABB was hit.
+		// If the ray starts inside of a primitive's AABB, the primitive is hit at a distance of 0.
+		// A ray which runs along one of the faces of a primitive's AABB hits it.
+		// If nothing was hit, false is returned and the outputs are left alone.
+		bool getRayIntersection(const Vector3f& origin, const Vector3f& direction, float maxDistance, unsigned int& primitiveIndexOut, float& distanceOut) const;
+
+		// Returns whether the given ray hits any primitive within maxDistance of origin.
+		// This is faster than getRayIntersection() as it stops at the first primitive it finds, instead of finding
+		// the nearest one.
+		bool getRayIntersectsAny(const Vector3f& origin, const Vector3f& direction, float maxDistance) const;
+
+		// Finds the primitive nearest to start, which the line segment from start to end hits.
+		// Returns true if a primitive was hit, in which case primitiveIndexOut is set to the primitive's index and
+		// fractionOut is set to how far along the segment the primitive's AABB was hit, between 0 (start) and 1 (end).
+		// If nothing was hit, false is returned and the outputs are left alone.
+		bool getSegmentIntersection(const Vector3f& start, const Vector3f& end, unsigned int& primitiveIndexOut, float& fractionOut) const;
+
+		// Returns whether the line segment from start to end hits any primitive.
+		// This is the one to use for line of sight checks.
+		bool getSegmentIntersectsAny(const Vector3f& start, const Vector3f& end) const;
+
+		// Returns the indicies of the primitives whose AABBs intersect with the given AABB.
+		std::vector<unsigned int> getPrimitivesWithinAABB(const AABB& aabb) const;
+
+		// Returns the indicies of the primitives whose AABBs intersect with the given frustum.
+		// Each of the frustum's planes' normals must point towards the inside of the frustum, so that
+		// Plane::getDistanceFromPlane() is positive for positions inside of it, as Frustum::computeFromViewProjection()
+		// creates them.
+		// The test is conservative, so a few primitives which are just outside of the frustum's corners may be
+		// returned, which is fine for culling.
+		std::vector<unsigned int> getPrimitivesWithinFrustum(const Frustum& frustum) const;
+
+		// The methods below are the same as the ones above which return a vector, except that they add the
+		// primitive indicies to the end of the given vector instead. The vector is not cleared first.
+		// Reusing the same vector between calls avoids allocating memory for each query.
+		void getPrimitivesWithinAABB(const AABB& aabb, std::vector<unsigned int>& primitivesOut) const;
+		void getPrimitivesWithinFrustum(const Frustum& frustum, std::vector<unsigned int>& primitivesOut) const;
+	private:
+		// Maximum number of children of each node, which is a whole number of SIMD registers' worth of floats.
+		// This is 8 with DC_SIMD_AVX2 and 4 otherwise, including with DC_SIMD_SCALAR, where each child is tested in turn.
+		static const unsigned int kNodeWidth = kSIMDWidth > 4 ? (unsigned int)kSIMDWidth : 4;
+
+		// A node of the tree
+		// The AABBs of the node's children are stored with each axis in it's own array, so that all of them can be
+		// loaded into SIMD registers at once.
+		struct alignas(kNodeWidth * sizeof(float)) Node
+		{
+			float childMinX[kNodeWidth];		// Minimum position of each child's AABB along the X axis
+			float childMinY[kNodeWidth];		// Minimum position of each child's AABB along the Y axis
+			float childMinZ[kNodeWidth];		// Minimum position of each child's AABB along the Z axis
+			float childMaxX[kNodeWidth];		// Maximum position of each child's AABB along the X axis
+			float childMaxY[kNodeWidth];		// Maximum position of each child's AABB along the Y axis
+			float childMaxZ[kNodeWidth];		// Maximum position of each child's AABB along the Z axis
+
+			// If childNumPrimitives is 0, this is the index of the child node within the nodes array, or 0 for no child.
+			// Otherwise the child is a leaf and this is the index of it's first primitive within the primitives array.
+			unsigned int childIndex[kNodeWidth];
+
+			// Number of primitives within each child if the child is a leaf, or 0 if it's a node
+			unsigned int childNumPrimitives[kNodeWidth];
+		};
+
+		// The AABB of a primitive, stored as floats so they don't need copying out of an AABB object to be tested.
+		struct PrimitiveBounds
+		{
+			float min[3];
+			float max[3];
+		};
+
+		// Size of the stack used when walking the tree.
+		// Each node on the way down can add up to kNodeWidth - 1 more nodes to the stack than it removes, so this must
+		// be more than kNodeWidth - 1 times the depth of the tree, which is checked by build().
+		static const unsigned int kMaxStackSize = 64 * kNodeWidth;
+
+		// Number of bins the primitives are sorted into along each axis when finding the best way to split them
+		static const unsigned int kNumBins = 16;
+
+		// All nodes, with the root node at index 0
+		std::vector<Node> nodes;
+
+		// The AABBs of each of the primitives, in the order they're stored within the leaves
+		std::vector<PrimitiveBounds> primitives;
+
+		// The index within the vector given to build() of each of the primitives within the primitives array
+		std::vector<unsigned int> primitiveIndicies;
+
+		// Bounds of all of the primitives
+		PrimitiveBounds bounds;
+
+		// Maximum depth of the nodes, see getMaxNodeDepth()
+		unsigned int maxNodeDepth;
+
+		// A range of primitives used while building the tree
+		struct BuildRange
+		{
+			unsigned int first;			// Index of the first primitive within the primitives array
+			unsigned int count;			// Number of primitives
+			PrimitiveBounds bounds;		// Bounds of all of the primitives' AABBs
+		};
+
+		// Computes the bounds of the range's primitives and stores them in the range
+		void computeBuildRangeBounds(BuildRange& range) const;
+
+		// Splits the given range of primitives into two, using the surface area heuristic, reordering the primitives
+		// within the range so that each of the two ranges is contiguous.
+		// centroids holds the centre of each primitive's AABB, in the same order as the primitives array and is
+		// reordered along with the primitives.
+		void splitBuildRange(const BuildRange& range, std::vector<float>& centroids, BuildRange& leftOut, BuildRange& rightOut);
+
+		// Creates a node for the given range of primitives, splitting it into up to kNodeWidth children and then creating
+		// nodes for any of those which hold more than maxPrimitivesPerLeaf primitives.
+		// Returns the index of the new node.
+		unsigned int buildNode(const BuildRange& range, std::vector<float>& centroids, unsigned int maxPrimitivesPerLeaf, unsigned int nodeDepth);
+
+		// Walks the tree, finding the nearest primitive the ray hits, or any primitive if anyHit is true.
+		// The ray is given as a position and a direction, where positions along the ray are origin + direction * t.
+		// Only primitives hit with t between 0 and maxT are found.
+		// Returns true if a primitive was hit, in which case primitiveIndexOut and tOut are set.
+		bool traceRay(const Vector3f& origin, const Vector3f& direction, float maxT, bool anyHit, unsigned int& primitiveIndexOut, float& tOut) const;
+
+		// Adds the indicies of each of the primitives within the given child of the given node, and all of it's
+		// children, to the given vector. Used by the frustum query once a child is known to be fully inside.
+		void addAllPrimitivesOfChild(const Node& node, unsigned int child, std::vector<unsigned int>& primitivesOut) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,724 @@
+#include "linearOctTree.h"
+#include "../Math/mathUtilities.h"
+#include "../Math/simd.h"
+
+namespace DC
+{
+	LinearOctTree::LinearOctTree(int maxEntitiesPerNodePARAM)
+	{
+		numEntities = 0;
+		init(maxEntitiesPerNodePARAM);
+	}
+
+	LinearOctTree::~LinearOctTree()
+	{
+		free();
+	}
+
+	void LinearOctTree::init(int maxEntitiesPerNodePARAM)
+	{
+		free();
+
+		// Make sure valid values were given
+		ErrorIfTrue(maxEntitiesPerNodePARAM < 1, L"LinearOctTree::init() failed. Given invalid number for maxEntitiesPerNode. Must be at least one.");
+
+		// Store settings
+		maxEntitiesPerNode = (unsigned int)maxEntitiesPerNodePARAM;
+	}
+
+	void LinearOctTree::free(void)
+	{
+		std::vector<unsigned int>().swap(codes);
+		std::vector<OctTreeEntity*>().swap(entities);
+		std::vector<float>().swap(entityPositionsX);
+		std::vector<float>().swap(entityPositionsY);
+		std::vector<float>().swap(entityPositionsZ);
+
+		// Delete all entities
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+		{
+			if (entitySlots[ui].entity)
+				delete entitySlots[ui].entity;
+		}
+		std::vector<EntitySlot>().swap(entitySlots);
+		std::vector<unsigned int>().swap(freeEntitySlots);
+		entityNames.clear();
+		numEntities = 0;
+
+		// An empty tree with a region of -8, +8 along each axis, the same as the OctTree's initial region
+		needsRebuild = false;
+		regionMin.set(-8.0f, -8.0f, -8.0f);
+		regionSize = 16.0f;
+		smallestNodeSizeInv = float(1 << kNumLevels) / regionSize;
+	}
+
+	SpatialEntityHandle LinearOctTree::addEntity(const std::wstring& namePARAM, const Vector3f& positionPARAM, int userDataPARAM, void* pUserDataPARAM)
+	{
+		// Make sure the entity doesn't already exist by checking the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() != it, L"LinearOctTree::addEntity() failed. The entity name of " + namePARAM + L" already exists.");
+
+		// Create new entity and add it's handle to the hashmap for lookup by name
+		OctTreeEntity* pEntity = createEntity(namePARAM, positionPARAM, userDataPARAM, pUserDataPARAM);
+		entityNames[namePARAM] = pEntity->handle;
+		needsRebuild = true;
+		return pEntity->handle;
+	}
+
+	SpatialEntityHandle LinearOctTree::addEntity(const Vector3f& positionPARAM, int userDataPARAM, void* pUserDataPARAM)
+	{
+		OctTreeEntity* pEntity = createEntity(L"", positionPARAM, userDataPARAM, pUserDataPARAM);
+		needsRebuild = true;
+		return pEntity->handle;
+	}
+
+	void LinearOctTree::removeEntity(const std::wstring& namePARAM)
+	{
+		// Make sure the entity exists by checking the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"LinearOctTree::removeEntity() failed. The entity name of " + namePARAM + L" doesn't exist.");
+
+		OctTreeEntity* pEntity = findEntity(it->second);
+		entityNames.erase(it);
+		deleteEntity(pEntity);
+		needsRebuild = true;
+	}
+
+	void LinearOctTree::removeEntity(SpatialEntityHandle handlePARAM)
+	{
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"LinearOctTree::removeEntity() failed. The given entity handle is invalid.");
+
+		// If the entity was given a name, remove that too
+		if (!pEntity->name.empty())
+			entityNames.erase(pEntity->name);
+		deleteEntity(pEntity);
+		needsRebuild = true;
+	}
+
+	bool LinearOctTree::getEntityExists(const std::wstring& namePARAM) const
+	{
+		// Check the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		return(entityNames.end() != it);
+	}
+
+	bool LinearOctTree::getEntityExists(SpatialEntityHandle handlePARAM) const
+	{
+		return findEntity(handlePARAM) != 0;
+	}
+
+	SpatialEntityHandle LinearOctTree::getEntityHandle(const std::wstring& namePARAM) const
+	{
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"LinearOctTree::getEntityHandle() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		return it->second;
+	}
+
+	OctTreeEntity* LinearOctTree::getEntity(SpatialEntityHandle handlePARAM) const
+	{
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"LinearOctTree::getEntity() failed. The given entity handle is invalid.");
+		return pEntity;
+	}
+
+	void LinearOctTree::removeAllEntities(void)
+	{
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+		{
+			if (entitySlots[ui].entity)
+				deleteEntity(entitySlots[ui].entity);
+		}
+		entityNames.clear();
+
+		// The arrays' memory is kept for when entities are next added
+		codes.clear();
+		entities.clear();
+		entityPositionsX.clear();
+		entityPositionsY.clear();
+		entityPositionsZ.clear();
+		needsRebuild = false;
+	}
+
+	std::vector<SpatialEntityHandle> LinearOctTree::buildFromPoints(std::span<const Vector3f> positionsPARAM, std::span<const int> userDataPARAM)
+	{
+		ErrorIfTrue(userDataPARAM.size() && userDataPARAM.size() != positionsPARAM.size(), L"LinearOctTree::buildFromPoints() failed. The number of userData values and positions given are not the same.");
+
+		removeAllEntities();
+		std::vector<SpatialEntityHandle> handles(positionsPARAM.size());
+		entitySlots.reserve(positionsPARAM.size());
+		for (size_t i = 0; i < positionsPARAM.size(); i++)
+			handles[i] = createEntity(L"", positionsPARAM[i], userDataPARAM.size() ? userDataPARAM[i] : 0, 0)->handle;
+		needsRebuild = true;
+		rebuild();
+		return handles;
+	}
+
+	void LinearOctTree::rebuild(void)
+	{
+		if (!needsRebuild)
+			return;
+		needsRebuild = false;
+
+		codes.clear();
+		entities.clear();
+		entityPositionsX.clear();
+		entityPositionsY.clear();
+		entityPositionsZ.clear();
+		if (!numEntities)
+			return;
+
+		// Compute the bounds of all of the entities' positions
+		Vector3f vMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3f vMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+		{
+			const OctTreeEntity* pEntity = entitySlots[ui].entity;
+			if (!pEntity)
+				continue;
+			vMin.x = std::min(vMin.x, pEntity->position.x);
+			vMin.y = std::min(vMin.y, pEntity->position.y);
+			vMin.z = std::min(vMin.z, pEntity->position.z);
+			vMax.x = std::max(vMax.x, pEntity->position.x);
+			vMax.y = std::max(vMax.y, pEntity->position.y);
+			vMax.z = std::max(vMax.z, pEntity->position.z);
+		}
+
+		// The region is a cube around the bounds, a quarter larger than them so that entities can move a little
+		// before they leave the region and need to be rebuilt
+		float fSize = std::max(std::max(vMax.x - vMin.x, vMax.y - vMin.y), vMax.z - vMin.z) * 1.25f;
+		if (fSize < 1.0f)
+			fSize = 1.0f;
+		regionSize = fSize;
+		regionMin.set((vMin.x + vMax.x - fSize) * 0.5f, (vMin.y + vMax.y - fSize) * 0.5f, (vMin.z + vMax.z - fSize) * 0.5f);
+		smallestNodeSizeInv = float(1 << kNumLevels) / regionSize;
+
+		// Compute the Morton code of each entity and sort them with a radix sort
+		std::vector<std::pair<unsigned int, unsigned int>> mortonOrder;
+		mortonOrder.reserve(numEntities);
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+		{
+			const OctTreeEntity* pEntity = entitySlots[ui].entity;
+			if (!pEntity)
+				continue;
+			unsigned int code;
+			computeCode(pEntity->position, code);
+			mortonOrder.push_back(std::pair<unsigned int, unsigned int>(code, ui));
+		}
+		sortMortonCodes(mortonOrder);
+
+		// Copy the entities into the arrays in their sorted order, storing each entity's index within the arrays
+		codes.resize(numEntities);
+		entities.resize(numEntities);
+		entityPositionsX.resize(numEntities);
+		entityPositionsY.resize(numEntities);
+		entityPositionsZ.resize(numEntities);
+		for (unsigned int ui = 0; ui < numEntities; ui++)
+		{
+			OctTreeEntity* pEntity = entitySlots[mortonOrder[ui].second].entity;
+			codes[ui] = mortonOrder[ui].first;
+			entities[ui] = pEntity;
+			entityPositionsX[ui] = pEntity->position.x;
+			entityPositionsY[ui] = pEntity->position.y;
+			entityPositionsZ[ui] = pEntity->position.z;
+			pEntity->nodeOwner = ui;
+		}
+	}
+
+	bool LinearOctTree::getNeedsRebuild(void) const
+	{
+		return needsRebuild;
+	}
+
+	void LinearOctTree::setEntityPosition(const std::wstring& namePARAM, const Vector3f& positionPARAM)
+	{
+		// First make sure the named entity exists
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(it == entityNames.end(), L"LinearOctTree::setEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		setEntityPosition(it->second, positionPARAM);
+	}
+
+	void LinearOctTree::setEntityPosition(SpatialEntityHandle handlePARAM, const Vector3f& positionPARAM)
+	{
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"LinearOctTree::setEntityPosition() failed. The given entity handle is invalid.");
+		pEntity->position = positionPARAM;
+		if (needsRebuild)
+			return;
+
+		// If the entity is still within the same smallest node, it's still in the correct place within the sorted
+		// arrays, so simply update it's position. Otherwise the arrays need sorting again.
+		unsigned int code;
+		if (computeCode(positionPARAM, code) && code == codes[pEntity->nodeOwner])
+		{
+			entityPositionsX[pEntity->nodeOwner] = positionPARAM.x;
+			entityPositionsY[pEntity->nodeOwner] = positionPARAM.y;
+			entityPositionsZ[pEntity->nodeOwner] = positionPARAM.z;
+			return;
+		}
+		needsRebuild = true;
+	}
+
+	void LinearOctTree::getEntityPosition(const std::wstring& namePARAM, Vector3f& positionPARAM) const
+	{
+		// First make sure the named entity exists
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(it == entityNames.end(), L"LinearOctTree::getEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		positionPARAM = findEntity(it->second)->position;
+	}
+
+	void LinearOctTree::getEntityPosition(SpatialEntityHandle handlePARAM, Vector3f& positionPARAM) const
+	{
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"LinearOctTree::getEntityPosition() failed. The given entity handle is invalid.");
+		positionPARAM = pEntity->position;
+	}
+
+	unsigned int LinearOctTree::getNumEntities(void) const
+	{
+		return numEntities;
+	}
+
+	AABB LinearOctTree::getRegion(void) const
+	{
+		return AABB(regionMin, Vector3f(regionMin.x + regionSize, regionMin.y + regionSize, regionMin.z + regionSize));
+	}
+
+	std::vector<OctTreeEntity*> LinearOctTree::getEntitiesWithinRange(const Vector3f& positionPARAM, float rangePARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinRange(positionPARAM, rangePARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<OctTreeEntity*> LinearOctTree::getEntitiesWithinAABB(const AABB& aabbPARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinAABB(aabbPARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<OctTreeEntity*> LinearOctTree::getEntitiesWithinFrustum(const Frustum& frustumPARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinFrustum(frustumPARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<OctTreeEntity*> LinearOctTree::getEntitiesWithinRangeExact(const Vector3f& positionPARAM, float rangePARAM, bool sortByDistancePARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinRangeExact(positionPARAM, rangePARAM, vResult, sortByDistancePARAM);
+		return vResult;
+	}
+
+	std::vector<OctTreeEntity*> LinearOctTree::getEntitiesWithinAABBExact(const AABB& aabbPARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinAABBExact(aabbPARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<OctTreeEntity*> LinearOctTree::getNearestEntities(const Vector3f& positionPARAM, unsigned int kPARAM, float maxRangePARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getNearestEntities(positionPARAM, kPARAM, maxRangePARAM, vResult);
+		return vResult;
+	}
+
+	void LinearOctTree::getEntitiesWithinRange(const Vector3f& positionPARAM, float rangePARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		visitEntitiesWithinRange(positionPARAM, rangePARAM, [&entitiesOutPARAM](OctTreeEntity* entity) { entitiesOutPARAM.push_back(entity); });
+	}
+
+	void LinearOctTree::getEntitiesWithinAABB(const AABB& aabbPARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		visitEntitiesWithinAABB(aabbPARAM, [&entitiesOutPARAM](OctTreeEntity* entity) { entitiesOutPARAM.push_back(entity); });
+	}
+
+	void LinearOctTree::getEntitiesWithinFrustum(const Frustum& frustumPARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		visitEntitiesWithinFrustum(frustumPARAM, [&entitiesOutPARAM](OctTreeEntity* entity) { entitiesOutPARAM.push_back(entity); });
+	}
+
+	void LinearOctTree::getEntitiesWithinRangeExact(const Vector3f& positionPARAM, float rangePARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM, bool sortByDistancePARAM) const
+	{
+		// Go through the nodes which intersect the range, adding all of the entities of those which are fully
+		// within range and testing each entity of the rest
+		size_t firstResult = entitiesOutPARAM.size();
+		auto nodeTest = [&positionPARAM, rangePARAM](const AABB& nodeRegion)
+		{
+			return computeNodeIntersection(nodeRegion, positionPARAM, rangePARAM);
+		};
+		auto rangeVisitor = [&](unsigned int first, unsigned int last, bool inside)
+		{
+			if (inside)
+				entitiesOutPARAM.insert(entitiesOutPARAM.end(), entities.begin() + first, entities.begin() + last);
+			else
+				addEntitiesWithinRange(first, last, positionPARAM, rangePARAM, entitiesOutPARAM);
+		};
+		visitEntityRanges(nodeTest, rangeVisitor);
+
+		// Sort the entities we've just added, leaving any which were already in the vector alone
+		if (sortByDistancePARAM)
+		{
+			std::sort(entitiesOutPARAM.begin() + firstResult, entitiesOutPARAM.end(), [&positionPARAM](const OctTreeEntity* entityA, const OctTreeEntity* entityB)
+				{
+					return entityA->position.getDistanceSquared(positionPARAM) < entityB->position.getDistanceSquared(positionPARAM);
+				});
+		}
+	}
+
+	void LinearOctTree::getEntitiesWithinAABBExact(const AABB& aabbPARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		// Go through the nodes which intersect the AABB, adding all of the entities of those which are fully
+		// inside of it and testing each entity of the rest
+		auto nodeTest = [&aabbPARAM](const AABB& nodeRegion)
+		{
+			return computeNodeIntersection(nodeRegion, aabbPARAM);
+		};
+		auto rangeVisitor = [&](unsigned int first, unsigned int last, bool inside)
+		{
+			if (inside)
+				entitiesOutPARAM.insert(entitiesOutPARAM.end(), entities.begin() + first, entities.begin() + last);
+			else
+				addEntitiesWithinAABB(first, last, aabbPARAM, entitiesOutPARAM);
+		};
+		visitEntityRanges(nodeTest, rangeVisitor);
+	}
+
+	void LinearOctTree::getNearestEntities(const Vector3f& positionPARAM, unsigned int kPARAM, float maxRangePARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		ErrorIfTrue(needsRebuild, L"LinearOctTree::getNearestEntities() failed. The tree has been modified since rebuild() was last called.");
+		if (0 == kPARAM || codes.empty())
+			return;
+
+		// Search the tree, starting at the root node, keeping the nearest entities found as a max heap
+		size_t firstResult = entitiesOutPARAM.size();
+		float fSearchDistanceSquared = maxRangePARAM * maxRangePARAM;
+		getNearestEntitiesInNode(0, (unsigned int)codes.size(), 0, 0, 0, 0, positionPARAM, kPARAM, firstResult, fSearchDistanceSquared, entitiesOutPARAM);
+
+		// Sort the heap so the entities go from the nearest to the furthest
+		std::sort_heap(entitiesOutPARAM.begin() + firstResult, entitiesOutPARAM.end(), [&positionPARAM](const OctTreeEntity* entityA, const OctTreeEntity* entityB)
+			{
+				return entityA->position.getDistanceSquared(positionPARAM) < entityB->position.getDistanceSquared(positionPARAM);
+			});
+	}
+
+	bool LinearOctTree::computeCode(const Vector3f& positionPARAM, unsigned int& codeOutPARAM) const
+	{
+		// Compute which of the smallest nodes the position is in along each axis
+		float fX = (positionPARAM.x - regionMin.x) * smallestNodeSizeInv;
+		float fY = (positionPARAM.y - regionMin.y) * smallestNodeSizeInv;
+		float fZ = (positionPARAM.z - regionMin.z) * smallestNodeSizeInv;
+		const float fNumNodes = float(1 << kNumLevels);
+		bool bInside = fX >= 0.0f && fX < fNumNodes && fY >= 0.0f && fY < fNumNodes && fZ >= 0.0f && fZ < fNumNodes;
+
+		// Keep the position within the region, in case rounding has put a position which rebuild() computed the
+		// region around just outside of it
+		const float fLastNode = fNumNodes - 1.0f;
+		fX = std::min(std::max(fX, 0.0f), fLastNode);
+		fY = std::min(std::max(fY, 0.0f), fLastNode);
+		fZ = std::min(std::max(fZ, 0.0f), fLastNode);
+		codeOutPARAM = mortonCode3D((unsigned int)fX, (unsigned int)fY, (unsigned int)fZ);
+		return bInside;
+	}
+
+	AABB LinearOctTree::computeNodeRegion(unsigned int levelPARAM, unsigned int xPARAM, unsigned int yPARAM, unsigned int zPARAM) const
+	{
+		float fNodeSize = regionSize / float(1 << levelPARAM);
+		float fMargin = regionSize * (0.01f / float(1 << kNumLevels));
+		Vector3f vMin(regionMin.x + float(xPARAM) * fNodeSize - fMargin, regionMin.y + float(yPARAM) * fNodeSize - fMargin, regionMin.z + float(zPARAM) * fNodeSize - fMargin);
+		Vector3f vMax(vMin.x + fNodeSize + fMargin * 2.0f, vMin.y + fNodeSize + fMargin * 2.0f, vMin.z + fNodeSize + fMargin * 2.0f);
+		return AABB(vMin, vMax);
+	}
+
+	unsigned int LinearOctTree::findFirstEntityWithCode(unsigned int firstPARAM, unsigned int lastPARAM, unsigned int codePARAM) const
+	{
+		return (unsigned int)(std::lower_bound(codes.begin() + firstPARAM, codes.begin() + lastPARAM, codePARAM) - codes.begin());
+	}
+
+	LinearOctTree::NodeIntersection LinearOctTree::computeNodeIntersection(const AABB& nodeRegionPARAM, const Vector3f& positionPARAM, float rangePARAM)
+	{
+		Vector3f vMin = nodeRegionPARAM.getMin();
+		Vector3f vMax = nodeRegionPARAM.getMax();
+		float fRangeSquared = rangePARAM * rangePARAM;
+
+		// If the nearest point of the node is out of range, the whole node is
+		float fDiffX = std::max(std::max(vMin.x - positionPARAM.x, positionPARAM.x - vMax.x), 0.0f);
+		float fDiffY = std::max(std::max(vMin.y - positionPARAM.y, positionPARAM.y - vMax.y), 0.0f);
+		float fDiffZ = std::max(std::max(vMin.z - positionPARAM.z, positionPARAM.z - vMax.z), 0.0f);
+		if (fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ > fRangeSquared)
+			return NODE_OUTSIDE;
+
+		// If the furthest corner of the node is within range, the whole node is
+		fDiffX = std::max(positionPARAM.x - vMin.x, vMax.x - positionPARAM.x);
+		fDiffY = std::max(positionPARAM.y - vMin.y, vMax.y - positionPARAM.y);
+		fDiffZ = std::max(positionPARAM.z - vMin.z, vMax.z - positionPARAM.z);
+		if (fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ <= fRangeSquared)
+			return NODE_INSIDE;
+		return NODE_INTERSECTS;
+	}
+
+	LinearOctTree::NodeIntersection LinearOctTree::computeNodeIntersection(const AABB& nodeRegionPARAM, const AABB& aabbPARAM)
+	{
+		Vector3f vNodeMin = nodeRegionPARAM.getMin();
+		Vector3f vNodeMax = nodeRegionPARAM.getMax();
+		Vector3f vMin = aabbPARAM.getMin();
+		Vector3f vMax = aabbPARAM.getMax();
+		if (vNodeMax.x < vMin.x || vNodeMin.x > vMax.x ||
+			vNodeMax.y < vMin.y || vNodeMin.y > vMax.y ||
+			vNodeMax.z < vMin.z || vNodeMin.z > vMax.z)
+			return NODE_OUTSIDE;
+		if (vNodeMin.x >= vMin.x && vNodeMax.x <= vMax.x &&
+			vNodeMin.y >= vMin.y && vNodeMax.y <= vMax.y &&
+			vNodeMin.z >= vMin.z && vNodeMax.z <= vMax.z)
+			return NODE_INSIDE;
+		return NODE_INTERSECTS;
+	}
+
+	LinearOctTree::NodeIntersection LinearOctTree::computeNodeIntersection(const AABB& nodeRegionPARAM, const Frustum& frustumPARAM)
+	{
+		// For each plane, if the corner of the node which is furthest along the plane's normal is behind the plane,
+		// the whole node is outside of the frustum. If the nearest corner is in front of every plane, the whole node
+		// is inside of it.
+		Vector3f vMin = nodeRegionPARAM.getMin();
+		Vector3f vMax = nodeRegionPARAM.getMax();
+		const Plane* pPlanes[6] = { &frustumPARAM.planeNear, &frustumPARAM.planeFar, &frustumPARAM.planeLeft, &frustumPARAM.planeRight, &frustumPARAM.planeTop, &frustumPARAM.planeBottom };
+		NodeIntersection result = NODE_INSIDE;
+		for (int plane = 0; plane < 6; plane++)
+		{
+			Vector3f vNormal = pPlanes[plane]->getNormal();
+			Vector3f vFurthest(vNormal.x >= 0.0f ? vMax.x : vMin.x, vNormal.y >= 0.0f ? vMax.y : vMin.y, vNormal.z >= 0.0f ? vMax.z : vMin.z);
+			if (pPlanes[plane]->getDistanceFromPlane(vFurthest) < 0.0f)
+				return NODE_OUTSIDE;
+			Vector3f vNearest(vNormal.x >= 0.0f ? vMin.x : vMax.x, vNormal.y >= 0.0f ? vMin.y : vMax.y, vNormal.z >= 0.0f ? vMin.z : vMax.z);
+			if (pPlanes[plane]->getDistanceFromPlane(vNearest) < 0.0f)
+				result = NODE_INTERSECTS;
+		}
+		return result;
+	}
+
+	void LinearOctTree::addEntitiesWithinRange(unsigned int firstPARAM, unsigned int lastPARAM, const Vector3f& positionPARAM, float rangePARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		const float* pPositionsX = entityPositionsX.data();
+		const float* pPositionsY = entityPositionsY.data();
+		const float* pPositionsZ = entityPositionsZ.data();
+		float fRangeSquared = rangePARAM * rangePARAM;
+
+		// Test kSIMDWidth entities at a time
+		SIMDFloats vPositionX = simdSet(positionPARAM.x);
+		SIMDFloats vPositionY = simdSet(positionPARAM.y);
+		SIMDFloats vPositionZ = simdSet(positionPARAM.z);
+		SIMDFloats vRangeSquared = simdSet(fRangeSquared);
+		unsigned int i = firstPARAM;
+		for (; i + kSIMDWidth <= lastPARAM; i += kSIMDWidth)
+		{
+			SIMDFloats vDiffX = simdSub(simdLoadUnaligned(pPositionsX + i), vPositionX);
+			SIMDFloats vDiffY = simdSub(simdLoadUnaligned(pPositionsY + i), vPositionY);
+			SIMDFloats vDiffZ = simdSub(simdLoadUnaligned(pPositionsZ + i), vPositionZ);
+			SIMDFloats vDistSquared = simdAdd(simdAdd(simdMul(vDiffX, vDiffX), simdMul(vDiffY, vDiffY)), simdMul(vDiffZ, vDiffZ));
+			int mask = simdGetLessOrEqualMask(vDistSquared, vRangeSquared);
+			for (unsigned int j = 0; j < kSIMDWidth; j++)
+			{
+				if (mask & (1 << j))
+					entitiesOutPARAM.push_back(entities[i + j]);
+			}
+		}
+
+		// Then test the remaining entities one at a time
+		for (; i < lastPARAM; i++)
+		{
+			float fDiffX = pPositionsX[i] - positionPARAM.x;
+			float fDiffY = pPositionsY[i] - positionPARAM.y;
+			float fDiffZ = pPositionsZ[i] - positionPARAM.z;
+			if (fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ <= fRangeSquared)
+				entitiesOutPARAM.push_back(entities[i]);
+		}
+	}
+
+	void LinearOctTree::addEntitiesWithinAABB(unsigned int firstPARAM, unsigned int lastPARAM, const AABB& aabbPARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		const float* pPositionsX = entityPositionsX.data();
+		const float* pPositionsY = entityPositionsY.data();
+		const float* pPositionsZ = entityPositionsZ.data();
+		Vector3f vMin = aabbPARAM.getMin();
+		Vector3f vMax = aabbPARAM.getMax();
+
+		// Test kSIMDWidth entities at a time
+		SIMDFloats vMinX = simdSet(vMin.x);
+		SIMDFloats vMinY = simdSet(vMin.y);
+		SIMDFloats vMinZ = simdSet(vMin.z);
+		SIMDFloats vMaxX = simdSet(vMax.x);
+		SIMDFloats vMaxY = simdSet(vMax.y);
+		SIMDFloats vMaxZ = simdSet(vMax.z);
+		unsigned int i = firstPARAM;
+		for (; i + kSIMDWidth <= lastPARAM; i += kSIMDWidth)
+		{
+			SIMDFloats vX = simdLoadUnaligned(pPositionsX + i);
+			SIMDFloats vY = simdLoadUnaligned(pPositionsY + i);
+			SIMDFloats vZ = simdLoadUnaligned(pPositionsZ + i);
+			SIMDInts vInside = simdAndInts(simdCompareGreaterOrEqual(vX, vMinX), simdCompareLessOrEqual(vX, vMaxX));
+			vInside = simdAndInts(vInside, simdAndInts(simdCompareGreaterOrEqual(vY, vMinY), simdCompareLessOrEqual(vY, vMaxY)));
+			vInside = simdAndInts(vInside, simdAndInts(simdCompareGreaterOrEqual(vZ, vMinZ), simdCompareLessOrEqual(vZ, vMaxZ)));
+			int mask = simdGetMask(vInside);
+			for (unsigned int j = 0; j < kSIMDWidth; j++)
+			{
+				if (mask & (1 << j))
+					entitiesOutPARAM.push_back(entities[i + j]);
+			}
+		}
+
+		// Then test the remaining entities one at a time
+		for (; i < lastPARAM; i++)
+		{
+			if (pPositionsX[i] >= vMin.x && pPositionsX[i] <= vMax.x &&
+				pPositionsY[i] >= vMin.y && pPositionsY[i] <= vMax.y &&
+				pPositionsZ[i] >= vMin.z && pPositionsZ[i] <= vMax.z)
+				entitiesOutPARAM.push_back(entities[i]);
+		}
+	}
+
+	void LinearOctTree::getNearestEntitiesInNode(unsigned int firstPARAM, unsigned int lastPARAM, unsigned int levelPARAM, unsigned int xPARAM, unsigned int yPARAM, unsigned int zPARAM, const Vector3f& positionPARAM, unsigned int kPARAM, size_t firstResultPARAM, float& searchDistanceSquaredPARAM, std::vector<OctTreeEntity*>& nearestEntitiesPARAM) const
+	{
+		auto isNearer = [&positionPARAM](const OctTreeEntity* entityA, const OctTreeEntity* entityB)
+		{
+			return entityA->position.getDistanceSquared(positionPARAM) < entityB->position.getDistanceSquared(positionPARAM);
+		};
+
+		// If this node holds few enough entities, test each of them
+		if (lastPARAM - firstPARAM <= maxEntitiesPerNode || kNumLevels == levelPARAM)
+		{
+			for (unsigned int i = firstPARAM; i < lastPARAM; i++)
+			{
+				float fDiffX = entityPositionsX[i] - positionPARAM.x;
+				float fDiffY = entityPositionsY[i] - positionPARAM.y;
+				float fDiffZ = entityPositionsZ[i] - positionPARAM.z;
+				float fDistanceSquared = fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ;
+				if (fDistanceSquared > searchDistanceSquaredPARAM)
+					continue;
+
+				// Once we've found k entities, replace the furthest of them
+				size_t numFound = nearestEntitiesPARAM.size() - firstResultPARAM;
+				if (numFound == kPARAM)
+				{
+					if (fDistanceSquared >= searchDistanceSquaredPARAM)
+						continue;
+					std::pop_heap(nearestEntitiesPARAM.begin() + firstResultPARAM, nearestEntitiesPARAM.end(), isNearer);
+					nearestEntitiesPARAM.pop_back();
+					numFound--;
+				}
+				nearestEntitiesPARAM.push_back(entities[i]);
+				std::push_heap(nearestEntitiesPARAM.begin() + firstResultPARAM, nearestEntitiesPARAM.end(), isNearer);
+
+				// Now we've found k entities, we only need to search as far as the furthest of them
+				if (numFound + 1 == kPARAM)
+					searchDistanceSquaredPARAM = nearestEntitiesPARAM[firstResultPARAM]->position.getDistanceSquared(positionPARAM);
+			}
+			return;
+		}
+
+		// Find the range of entities within each of the child nodes and the squared distance from the position to
+		// each child node's region
+		unsigned int childShift = 3 * (kNumLevels - levelPARAM - 1);
+		unsigned int nodeCode = (codes[firstPARAM] >> (childShift + 3)) << 3;
+		unsigned int childFirsts[8];
+		unsigned int childLasts[8];
+		unsigned int childIndicies[8];
+		float childDistancesSquared[8];
+		unsigned int numChildNodes = 0;
+		unsigned int childFirst = firstPARAM;
+		for (unsigned int child = 0; child < 8; child++)
+		{
+			unsigned int childLast = lastPARAM;
+			if (child < 7)
+				childLast = findFirstEntityWithCode(childFirst, lastPARAM, (nodeCode + child + 1) << childShift);
+			childFirsts[child] = childFirst;
+			childLasts[child] = childLast;
+			childFirst = childLast;
+			if (childLasts[child] == childFirsts[child])
+				continue;
+
+			AABB childRegion = computeNodeRegion(levelPARAM + 1, xPARAM * 2 + (child & 1), yPARAM * 2 + ((child >> 1) & 1), zPARAM * 2 + (child >> 2));
+			Vector3f vMin = childRegion.getMin();
+			Vector3f vMax = childRegion.getMax();
+			float fDiffX = std::max(std::max(vMin.x - positionPARAM.x, positionPARAM.x - vMax.x), 0.0f);
+			float fDiffY = std::max(std::max(vMin.y - positionPARAM.y, positionPARAM.y - vMax.y), 0.0f);
+			float fDiffZ = std::max(std::max(vMin.z - positionPARAM.z, positionPARAM.z - vMax.z), 0.0f);
+			float fDistanceSquared = fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ;
+
+			// Insert the child, keeping them sorted from the nearest to the furthest
+			unsigned int j = numChildNodes;
+			while (j > 0 && childDistancesSquared[j - 1] > fDistanceSquared)
+			{
+				childIndicies[j] = childIndicies[j - 1];
+				childDistancesSquared[j] = childDistancesSquared[j - 1];
+				j--;
+			}
+			childIndicies[j] = child;
+			childDistancesSquared[j] = fDistanceSquared;
+			numChildNodes++;
+		}
+
+		// Search the child nodes, nearest first, stopping once the rest are further away than the entities found
+		for (unsigned int i = 0; i < numChildNodes; i++)
+		{
+			if (childDistancesSquared[i] > searchDistanceSquaredPARAM)
+				break;
+			unsigned int child = childIndicies[i];
+			getNearestEntitiesInNode(childFirsts[child], childLasts[child], levelPARAM + 1, xPARAM * 2 + (child & 1), yPARAM * 2 + ((child >> 1) & 1), zPARAM * 2 + (child >> 2), positionPARAM, kPARAM, firstResultPARAM, searchDistanceSquaredPARAM, nearestEntitiesPARAM);
+		}
+	}
+
+	OctTreeEntity* LinearOctTree::findEntity(SpatialEntityHandle handlePARAM) const
+	{
+		unsigned int slotIndex = spatialEntityHandleGetIndex(handlePARAM);
+		if (slotIndex >= entitySlots.size())
+			return 0;
+		const EntitySlot& slot = entitySlots[slotIndex];
+		if (slot.generation != spatialEntityHandleGetGeneration(handlePARAM))
+			return 0;
+		return slot.entity;
+	}
+
+	OctTreeEntity* LinearOctTree::createEntity(const std::wstring& namePARAM, const Vector3f& positionPARAM, int userDataPARAM, void* pUserDataPARAM)
+	{
+		// Use a previously freed slot if there is one, otherwise add a new slot
+		unsigned int slotIndex;
+		if (freeEntitySlots.size())
+		{
+			slotIndex = freeEntitySlots.back();
+			freeEntitySlots.pop_back();
+		}
+		else
+		{
+			ErrorIfTrue(entitySlots.size() >= kSpatialEntityHandleMaxSlots, L"LinearOctTree::createEntity() failed. The maximum number of entities has been reached.");
+			slotIndex = (unsigned int)entitySlots.size();
+			EntitySlot slot;
+			slot.entity = 0;
+			slot.generation = 0;
+			entitySlots.push_back(slot);
+		}
+		EntitySlot& slot = entitySlots[slotIndex];
+
+		// Create new entity, it's index within the sorted arrays is set by rebuild()
+		OctTreeEntity* pEntity = new OctTreeEntity(namePARAM, positionPARAM, 0, spatialEntityHandleCreate(slotIndex, slot.generation), userDataPARAM, pUserDataPARAM);
+		ErrorIfFalse(pEntity, L"LinearOctTree::createEntity() failed to allocate memory for new entity.");
+		slot.entity = pEntity;
+		numEntities++;
+		return pEntity;
+	}
+
+	void LinearOctTree::deleteEntity(OctTreeEntity* entityPARAM)
+	{
+		// Increase the slot's generation so that any remaining handles to the entity become invalid.
+		// Once the generation no longer fits into a handle, the slot is retired instead of being reused.
+		EntitySlot& slot = entitySlots[spatialEntityHandleGetIndex(entityPARAM->handle)];
+		slot.entity = 0;
+		slot.generation++;
+		if (spatialEntityHandleGetSlotCanBeReused(slot.generation))
+			freeEntitySlots.push_back(spatialEntityHandleGetIndex(entityPARAM->handle));
+		numEntities--;
+		delete entityPARAM;
+	}
+}
\ No newline at end of file
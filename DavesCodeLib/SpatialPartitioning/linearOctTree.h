@@ -0,0 +1,407 @@
+#pragma once
+#include "octTreeEntity.h"
+#include "../Math/AABB.h"
+#include "../Math/frustum.h"
+#include "../Common/error.h"
+#include <algorithm>
+#include <cfloat>
+#include <map>
+#include <span>
+#include <vector>
+
+namespace DC
+{
+	// A 3D spatial partitioning class with the same queries as the OctTree class, but which has no nodes.
+	//
+	// Instead of a tree of nodes which point to their children, the entities are stored in arrays sorted by the
+	// Morton code of their position. The Morton code of a position is made by interleaving the bits of the position's
+	// coordinates within the tree's region, so the first three bits of the code say which of the eight children of
+	// the root node the position is inside of, the next three bits say which of that node's children it's inside of
+	// and so on. Because of this, the entities within any node of the oct tree are always next to each other within
+	// the sorted arrays, so a node is simply a range of the arrays, which is found with a binary search.
+	// The queries walk down through the nodes in the same way as the OctTree's queries, but instead of following
+	// pointers to nodes scattered around memory, they search and then scan through contiguous arrays, which is much
+	// friendlier to the CPU's cache once there are lots of entities and the tree would be deep.
+	// The entities' positions are stored in seperate arrays for each axis, so the exact queries can test several
+	// entities at a time with the SIMD instructions chosen by Math/simd.h.
+	//
+	// The catch is that the arrays have to be sorted again whenever entities are added, removed, or move from one of
+	// the smallest nodes into another. Rather than doing this each time, the tree is marked as needing a rebuild and
+	// rebuild() has to be called before the tree is queried again, otherwise an exception occurs. Sorting uses a
+	// radix sort, which is fast enough that all entities can be moved and the tree rebuilt every frame.
+	// Entities which only move within the smallest node they're in, which is 1/1024th of the tree's region along
+	// each axis, are updated straight away without needing a rebuild.
+	// The tree's region is computed by rebuild() so that it encloses all of the entities with some room to spare.
+	// Entities which move outside of it cause the next rebuild() to compute a larger region.
+	//
+	// So, this class is best for large numbers of entities which move every frame and are queried lots, such as
+	// the particles or units of a large simulation. The OctTree is better when only a few entities change each
+	// frame, as it doesn't need to rebuild anything.
+	//
+	// Like the OctTree, entities may be added either with a unique name, or without one and adding an entity
+	// returns a SpatialEntityHandle which can be used to move, query and remove the entity.
+	// Example:
+	// LinearOctTree tree;
+	// std::vector<SpatialEntityHandle> handles = tree.buildFromPoints(positions);
+	// Then each frame...
+	// for (size_t i = 0; i < handles.size(); i++)
+	//     tree.setEntityPosition(handles[i], positions[i]);
+	// tree.rebuild();
+	// std::vector<OctTreeEntity*> entities = tree.getEntitiesWithinRangeExact(position, range);
+	class LinearOctTree
+	{
+	public:
+		// Constructor
+		// maxEntitiesPerNode is the number of entities a node may hold before the queries look at it's child nodes
+		// instead of it. This must be at least 1, otherwise an exception occurs.
+		LinearOctTree(int maxEntitiesPerNode = 10);
+
+		// Destructor
+		// Deletes all entities.
+		~LinearOctTree();
+
+		// Initialise the tree using the new given settings.
+		// This will free all existing entities.
+		// maxEntitiesPerNode is the number of entities a node may hold before the queries look at it's child nodes
+		// instead of it. This must be at least 1, otherwise an exception occurs.
+		void init(int maxEntitiesPerNode = 10);
+
+		// Deletes all entities
+		void free(void);
+
+		// Add entity to the tree.
+		// Each entity needs a unique name, if the name given already exists, an exception occurs.
+		// Returns the handle of the new entity, which may be used instead of the name for faster access.
+		// The tree needs rebuilding afterwards.
+		SpatialEntityHandle addEntity(const std::wstring& name, const Vector3f& position, int userData = 0, void* pUserData = 0);
+
+		// Add an entity which has no name to the tree.
+		// Returns the handle of the new entity, which is used to refer to it from then on.
+		// Handles are only valid until the entity is removed, or the tree is freed or initialised again.
+		// The tree needs rebuilding afterwards.
+		SpatialEntityHandle addEntity(const Vector3f& position, int userData = 0, void* pUserData = 0);
+
+		// Removes the named entity from the tree.
+		// If the unique name doesn't exist, an exception occurs.
+		// The tree needs rebuilding afterwards.
+		void removeEntity(const std::wstring& name);
+
+		// Removes the entity with the given handle from the tree.
+		// If the handle is invalid, or the entity has already been removed, an exception occurs.
+		// The tree needs rebuilding afterwards.
+		void removeEntity(SpatialEntityHandle handle);
+
+		// Returns whether the named entity exists or not
+		bool getEntityExists(const std::wstring& name) const;
+
+		// Returns whether the entity with the given handle exists or not
+		bool getEntityExists(SpatialEntityHandle handle) const;
+
+		// Returns the handle of the named entity
+		// If the named entity doesn't exist, an exception occurs
+		SpatialEntityHandle getEntityHandle(const std::wstring& name) const;
+
+		// Returns a pointer to the entity with the given handle
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		OctTreeEntity* getEntity(SpatialEntityHandle handle) const;
+
+		// Removes all entities from the tree
+		void removeAllEntities(void);
+
+		// Removes all entities from the tree and then adds an unnamed entity at each of the given positions, then
+		// rebuilds the tree, which is faster than adding each of them and then calling rebuild().
+		// userData may either be empty, or hold the userData value for each of the entities.
+		// Returns the handle of each of the new entities, in the same order as the given positions.
+		std::vector<SpatialEntityHandle> buildFromPoints(std::span<const Vector3f> positions, std::span<const int> userData = std::span<const int>());
+
+		// Sorts the entities by the Morton code of their positions, so that the tree can be queried.
+		// This must be called after adding or removing entities, or moving them, before the tree is next queried.
+		// If the tree doesn't need rebuilding, this does nothing.
+		void rebuild(void);
+
+		// Returns whether the tree has been modified in a way which means rebuild() needs calling before it is
+		// next queried.
+		bool getNeedsRebuild(void) const;
+
+		// Set an existing entity's position to the one given.
+		// If the new position is within the same smallest node as before, the entity is updated straight away,
+		// otherwise the tree needs rebuilding afterwards.
+		// If the named entity doesn't exist, an exception occurs
+		void setEntityPosition(const std::wstring& name, const Vector3f& position);
+
+		// Set the position of the entity with the given handle.
+		// If the new position is within the same smallest node as before, the entity is updated straight away,
+		// otherwise the tree needs rebuilding afterwards.
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		void setEntityPosition(SpatialEntityHandle handle, const Vector3f& position);
+
+		// Sets the given Vector3f to the named entity's position.
+		// If the named entity doesn't exist, an exception occurs
+		void getEntityPosition(const std::wstring& name, Vector3f& position) const;
+
+		// Sets the given Vector3f to the position of the entity with the given handle.
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		void getEntityPosition(SpatialEntityHandle handle, Vector3f& position) const;
+
+		// Returns the number of entities within the tree
+		unsigned int getNumEntities(void) const;
+
+		// Returns the region which the tree covers, computed by the last call to rebuild()
+		AABB getRegion(void) const;
+
+		// The queries below are the same as those of the OctTree class.
+		// If the tree needs rebuilding, an exception occurs.
+
+		// Returns a vector of entities which are within range of the given position.
+		// This returns all of the entities within the nodes which intersect the range, so may return some entities
+		// which are outside of the range.
+		// To only get the entities which are within range, use getEntitiesWithinRangeExact()
+		std::vector<OctTreeEntity*> getEntitiesWithinRange(const Vector3f& position, float range) const;
+
+		// Returns a vector of entities which are within the given AABB.
+		// This returns all of the entities within the nodes which intersect the AABB, so may return some entities
+		// which are outside of the AABB.
+		// To only get the entities which are inside of the AABB, use getEntitiesWithinAABBExact()
+		std::vector<OctTreeEntity*> getEntitiesWithinAABB(const AABB& aabb) const;
+
+		// Returns a vector of entities which are within the nodes which intersect with the given frustum.
+		// This may return some entities which are outside of the frustum, as only the nodes are tested.
+		std::vector<OctTreeEntity*> getEntitiesWithinFrustum(const Frustum& frustum) const;
+
+		// Returns a vector of the entities which are within range of the given position.
+		// Unlike getEntitiesWithinRange(), the distance to each entity is tested, so only the entities which are
+		// within range are returned.
+		// If sortByDistance is true, the entities are sorted from the nearest to the furthest.
+		std::vector<OctTreeEntity*> getEntitiesWithinRangeExact(const Vector3f& position, float range, bool sortByDistance = false) const;
+
+		// Returns a vector of the entities whose positions are inside of the given AABB.
+		// Unlike getEntitiesWithinAABB(), each entity's position is tested, so only the entities which are inside of
+		// the AABB are returned.
+		std::vector<OctTreeEntity*> getEntitiesWithinAABBExact(const AABB& aabb) const;
+
+		// Returns a vector of up to k entities which are nearest to the given position, sorted from the nearest to
+		// the furthest. Only entities which are within maxRange of the position are returned.
+		std::vector<OctTreeEntity*> getNearestEntities(const Vector3f& position, unsigned int k, float maxRange = FLT_MAX) const;
+
+		// The methods below are the same as the ones above which return a vector, except that they add the
+		// entities to the end of the given vector instead. The vector is not cleared first.
+		void getEntitiesWithinRange(const Vector3f& position, float range, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinAABB(const AABB& aabb, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinFrustum(const Frustum& frustum, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinRangeExact(const Vector3f& position, float range, std::vector<OctTreeEntity*>& entitiesOut, bool sortByDistance = false) const;
+		void getEntitiesWithinAABBExact(const AABB& aabb, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getNearestEntities(const Vector3f& position, unsigned int k, float maxRange, std::vector<OctTreeEntity*>& entitiesOut) const;
+
+		// The methods below call the given visitor for each entity which getEntitiesWithinRange(),
+		// getEntitiesWithinAABB() and getEntitiesWithinFrustum() would have returned, instead of storing them in a vector.
+		// The visitor may be a lambda or any other callable object and is passed an OctTreeEntity*
+		// The tree must not be modified from within the visitor.
+		template <typename Visitor> void visitEntitiesWithinRange(const Vector3f& position, float range, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinAABB(const AABB& aabb, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinFrustum(const Frustum& frustum, Visitor&& visitor) const;
+	private:
+		// Number of times the tree's region is divided in half along each axis, to get the smallest nodes.
+		// Each level uses three bits of the Morton codes, which are 30 bits.
+		static const unsigned int kNumLevels = 10;
+
+		// The result of testing a node's region against a query's shape
+		enum NodeIntersection
+		{
+			NODE_OUTSIDE,		// The node is completely outside of the shape
+			NODE_INTERSECTS,	// The node is partly inside of the shape, or may be
+			NODE_INSIDE			// The node is completely inside of the shape
+		};
+
+		// Number of entities a node may hold before the queries look at it's child nodes instead
+		unsigned int maxEntitiesPerNode;
+
+		// Whether the tree has been modified in a way which means it needs rebuilding before being queried
+		bool needsRebuild;
+
+		// The tree's region, computed by rebuild()
+		Vector3f regionMin;			// Minimum position of the tree's region along each axis
+		float regionSize;			// Width, height and depth of the tree's region
+		float smallestNodeSizeInv;	// 1 divided by the size of the smallest nodes, which is regionSize / 1024
+
+		// The Morton code of each of the entities' positions, sorted in ascending order
+		std::vector<unsigned int> codes;
+
+		// The entities, in the same order as codes
+		std::vector<OctTreeEntity*> entities;
+
+		// The position of each of the entities along each axis, in the same order as codes.
+		std::vector<float> entityPositionsX;
+		std::vector<float> entityPositionsY;
+		std::vector<float> entityPositionsZ;
+
+		// A slot which holds an entity, the index of which is stored within the entity's handle
+		struct EntitySlot
+		{
+			OctTreeEntity* entity;		// Pointer to the entity in this slot, or 0 if the slot is unused
+			unsigned int generation;	// Increased each time the slot's entity is removed, to invalidate old handles
+		};
+
+		// Slots holding pointers to each of the added entities, indexed by the entity handles.
+		std::vector<EntitySlot> entitySlots;
+
+		// Indicies of slots within entitySlots which are no longer used and can be reused
+		std::vector<unsigned int> freeEntitySlots;
+
+		// Number of entities within the entitySlots
+		unsigned int numEntities;
+
+		// Hashmap holding the handle of each of the named entities
+		std::map<std::wstring, SpatialEntityHandle> entityNames;
+
+		// Computes the Morton code of the given position within the tree's region.
+		// Returns false if the position is outside of the tree's region, in which case the code of the nearest
+		// smallest node within the region is computed.
+		bool computeCode(const Vector3f& position, unsigned int& codeOut) const;
+
+		// Returns the region of the node at the given level, with the given coordinates.
+		// The coordinates are the node's position in units of the node's size, within the tree's region.
+		// The region is enlarged very slightly, so that rounding can never cause an entity to be outside of it.
+		AABB computeNodeRegion(unsigned int level, unsigned int x, unsigned int y, unsigned int z) const;
+
+		// Walks the nodes, calling nodeTest with each node's region, which returns a NodeIntersection.
+		// The child nodes of nodes which intersect are then tested, until the node holds no more than
+		// maxEntitiesPerNode entities, at which point rangeVisitor is called with the index of the node's first
+		// entity, one past it's last entity and whether nodeTest said the node was fully inside of the shape.
+		// Nodes which are fully inside of the shape are given to rangeVisitor without testing their children.
+		// If the tree needs rebuilding, an exception occurs.
+		template <typename NodeTest, typename RangeVisitor> void visitEntityRanges(NodeTest& nodeTest, RangeVisitor& rangeVisitor) const;
+
+		// Returns the index of the first entity within the given range of the arrays, whose code is not less than the one given
+		unsigned int findFirstEntityWithCode(unsigned int first, unsigned int last, unsigned int code) const;
+
+		// Returns how the given node region intersects with the sphere at the given position with the given range
+		static NodeIntersection computeNodeIntersection(const AABB& nodeRegion, const Vector3f& position, float range);
+
+		// Returns how the given node region intersects with the given AABB
+		static NodeIntersection computeNodeIntersection(const AABB& nodeRegion, const AABB& aabb);
+
+		// Returns how the given node region intersects with the given frustum.
+		// This is the same test as the OctTree uses for it's nodes, so it's conservative in the same way.
+		static NodeIntersection computeNodeIntersection(const AABB& nodeRegion, const Frustum& frustum);
+
+		// Adds the entities within the given range of the arrays, which are within range of the given position,
+		// to the given vector, testing kSIMDWidth entities at a time.
+		void addEntitiesWithinRange(unsigned int first, unsigned int last, const Vector3f& position, float range, std::vector<OctTreeEntity*>& entitiesOut) const;
+
+		// Adds the entities within the given range of the arrays, whose positions are inside of the given AABB,
+		// to the given vector, testing kSIMDWidth entities at a time.
+		void addEntitiesWithinAABB(unsigned int first, unsigned int last, const AABB& aabb, std::vector<OctTreeEntity*>& entitiesOut) const;
+
+		// Recursively searches the given node and it's children for the k nearest entities to the given position.
+		// first and last are the range of the arrays which the node's entities are within and level, x, y and z
+		// identify the node, see computeNodeRegion().
+		// The entities found so far are kept as a max heap at the end of nearestEntities, starting at firstResult.
+		// searchDistanceSquared is reduced once k entities have been found.
+		void getNearestEntitiesInNode(unsigned int first, unsigned int last, unsigned int level, unsigned int x, unsigned int y, unsigned int z, const Vector3f& position, unsigned int k, size_t firstResult, float& searchDistanceSquared, std::vector<OctTreeEntity*>& nearestEntities) const;
+
+		// Returns a pointer to the entity with the given handle, or 0 if the handle is invalid or the entity has been removed
+		OctTreeEntity* findEntity(SpatialEntityHandle handle) const;
+
+		// Creates a new entity and places it into a slot
+		OctTreeEntity* createEntity(const std::wstring& name, const Vector3f& position, int userData, void* pUserData);
+
+		// Deletes the given entity and frees it's slot, increasing the slot's generation
+		void deleteEntity(OctTreeEntity* entity);
+	};
+
+	template <typename Visitor>
+	void LinearOctTree::visitEntitiesWithinRange(const Vector3f& positionPARAM, float rangePARAM, Visitor&& visitorPARAM) const
+	{
+		auto nodeTest = [&positionPARAM, rangePARAM](const AABB& nodeRegion)
+		{
+			return computeNodeIntersection(nodeRegion, positionPARAM, rangePARAM);
+		};
+		auto rangeVisitor = [this, &visitorPARAM](unsigned int first, unsigned int last, bool)
+		{
+			for (unsigned int i = first; i < last; i++)
+				visitorPARAM(entities[i]);
+		};
+		visitEntityRanges(nodeTest, rangeVisitor);
+	}
+
+	template <typename Visitor>
+	void LinearOctTree::visitEntitiesWithinAABB(const AABB& aabbPARAM, Visitor&& visitorPARAM) const
+	{
+		auto nodeTest = [&aabbPARAM](const AABB& nodeRegion)
+		{
+			return computeNodeIntersection(nodeRegion, aabbPARAM);
+		};
+		auto rangeVisitor = [this, &visitorPARAM](unsigned int first, unsigned int last, bool)
+		{
+			for (unsigned int i = first; i < last; i++)
+				visitorPARAM(entities[i]);
+		};
+		visitEntityRanges(nodeTest, rangeVisitor);
+	}
+
+	template <typename Visitor>
+	void LinearOctTree::visitEntitiesWithinFrustum(const Frustum& frustumPARAM, Visitor&& visitorPARAM) const
+	{
+		auto nodeTest = [&frustumPARAM](const AABB& nodeRegion)
+		{
+			return computeNodeIntersection(nodeRegion, frustumPARAM);
+		};
+		auto rangeVisitor = [this, &visitorPARAM](unsigned int first, unsigned int last, bool)
+		{
+			for (unsigned int i = first; i < last; i++)
+				visitorPARAM(entities[i]);
+		};
+		visitEntityRanges(nodeTest, rangeVisitor);
+	}
+
+	template <typename NodeTest, typename RangeVisitor>
+	void LinearOctTree::visitEntityRanges(NodeTest& nodeTestPARAM, RangeVisitor& rangeVisitorPARAM) const
+	{
+		ErrorIfTrue(needsRebuild, L"LinearOctTree::visitEntityRanges() failed. The tree has been modified since rebuild() was last called.");
+		if (codes.empty())
+			return;
+
+		// A node which is waiting to be tested
+		struct StackEntry
+		{
+			unsigned int first;		// Index of the node's first entity
+			unsigned int last;		// Index one past the node's last entity
+			unsigned int level;		// Level of the node, where the root node is level 0
+			unsigned int x;			// Coordinates of the node, see computeNodeRegion()
+			unsigned int y;
+			unsigned int z;
+		};
+		// Each node on the way down can add up to seven more nodes to the stack than it removes
+		StackEntry stack[kNumLevels * 7 + 1];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = { 0, (unsigned int)codes.size(), 0, 0, 0, 0 };
+		while (stackSize)
+		{
+			StackEntry node = stack[--stackSize];
+			NodeIntersection intersection = nodeTestPARAM(computeNodeRegion(node.level, node.x, node.y, node.z));
+			if (NODE_OUTSIDE == intersection)
+				continue;
+
+			if (NODE_INSIDE == intersection || node.last - node.first <= maxEntitiesPerNode || kNumLevels == node.level)
+			{
+				rangeVisitorPARAM(node.first, node.last, NODE_INSIDE == intersection);
+				continue;
+			}
+
+			// All of the node's entities share the same first bits of their codes, which identify the node.
+			// The next three bits say which child each entity is in, so find where each child's entities start.
+			unsigned int childShift = 3 * (kNumLevels - node.level - 1);
+			unsigned int nodeCode = (codes[node.first] >> (childShift + 3)) << 3;
+			unsigned int childFirst = node.first;
+			for (unsigned int child = 0; child < 8; child++)
+			{
+				unsigned int childLast = node.last;
+				if (child < 7)
+					childLast = findFirstEntityWithCode(childFirst, node.last, (nodeCode + child + 1) << childShift);
+				if (childLast > childFirst)
+					stack[stackSize++] = { childFirst, childLast, node.level + 1, node.x * 2 + (child & 1), node.y * 2 + ((child >> 1) & 1), node.z * 2 + (child >> 2) };
+				childFirst = childLast;
+			}
+		}
+	}
+}
\ No newline at end of file
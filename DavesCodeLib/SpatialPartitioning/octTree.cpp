@@ -1,37 +1,36 @@
 #include "octTree.h"
 #include "../Common/error.h"
+#include "../Math/mathUtilities.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 namespace DC
 {
-	OctTree::OctTree(int maxEntitiesPerNodePARAM, float sizeIncreaseMultiplierPARAM)
+	OctTree::OctTree(int maxEntitiesPerNodePARAM, float sizeIncreaseMultiplierPARAM, float looseFactorPARAM)
 	{
-		rootNode = 0;
-		init(maxEntitiesPerNodePARAM, sizeIncreaseMultiplierPARAM);
+		init(maxEntitiesPerNodePARAM, sizeIncreaseMultiplierPARAM, looseFactorPARAM);
 	}
 
-	void OctTree::init(int maxEntitiesPerNodePARAM, float sizeIncreaseMultiplierPARAM)
+	void OctTree::init(int maxEntitiesPerNodePARAM, float sizeIncreaseMultiplierPARAM, float looseFactorPARAM)
 	{
 		free();
 
-		AABB aabbInitialRootNodeRegion(Vector3f(-8, -8, -8), Vector3f(8, 8, 8));
-
-		// Attempt to create root node, passing 0 as the pointer to the parent node
-		rootNode = new OctTreeNode(aabbInitialRootNodeRegion, 0, this);
-		ErrorIfFalse(rootNode, L"OctTree::init() failed. Unable to allocate memory for root node.");
-
 		// Make sure valid values were given
 		ErrorIfTrue(maxEntitiesPerNodePARAM < 1, L"OctTree::init() failed. Given invalid number for iMaxEntitiesPerNode. Must be at least one.");
 		ErrorIfTrue(sizeIncreaseMultiplierPARAM < 2, L"OctTree::init() failed. Given invalid number for fSizeIncreaseMultiplier. Must be at least 2.0f.");
+		ErrorIfTrue(looseFactorPARAM < 1 || looseFactorPARAM > 2, L"OctTree::init() failed. Given invalid number for looseFactor. Must be from 1.0f to 2.0f.");
 
 		// Store settings
 		maxEntitiesPerNode = maxEntitiesPerNodePARAM;
 		sizeIncreaseMultiplier = sizeIncreaseMultiplierPARAM;
+		looseFactor = looseFactorPARAM;
+		numReinsertions = 0;
+		nodeCollapseThreshold = (unsigned int)maxEntitiesPerNodePARAM / 2;
 
-		// Current maximum node depth
-		currentMaxNodeDepth = 0;
-
-		// Compute maximum node depth before node division is forbidden.
-		computeMaxNodeDepth();
+		// Create root node, now that the loose factor is known
+		AABB aabbInitialRootNodeRegion(Vector3f(-8, -8, -8), Vector3f(8, 8, 8));
+		resetNodes(aabbInitialRootNodeRegion);
 	}
 
 	OctTree::~OctTree()
@@ -41,24 +40,23 @@ namespace DC
 
 	void OctTree::free(void)
 	{
-		// Delete root node, which will delete all children and their children and so on.
+		// Free the node pool, which holds the root node and all children and their children and so on.
 		// Although this obviously removes the entities from the nodes, because the nodes themselves
 		// no longer exist, this does NOT delete the entity pointers. They are stored in this object's
-		// _mmapEntities hashmap.
-		if (rootNode)
-		{
-			delete rootNode;
-			rootNode = 0;
-		}
+		// entitySlots array.
+		std::vector<OctTreeNode>().swap(nodes);
+		std::vector<unsigned int>().swap(freeNodes);
 
 		// Delete all entities
-		std::map<std::wstring, OctTreeEntity*>::iterator it = entities.begin();
-		while (it != entities.end())
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
 		{
-			delete it->second;
-			it++;
+			if (entitySlots[ui].entity)
+				delete entitySlots[ui].entity;
 		}
-		entities.clear();
+		std::vector<EntitySlot>().swap(entitySlots);
+		std::vector<unsigned int>().swap(freeEntitySlots);
+		numRetiredEntitySlots = 0;
+		entityNames.clear();
 	}
 /*
 	void OctTree::debugRender(CSMCamera& camera) const
@@ -123,189 +121,459 @@ namespace DC
 		}
 	}
 	*/
-	void OctTree::addEntity(const std::wstring& namePARAM, const Vector3f& positionPARAM, int userDataPARAM, void* pUserDataPARAM)
+	std::shared_lock<std::shared_mutex> OctTree::lockForReading(void) const
 	{
-		// Make sure the entity doesn't already exist by checking the hashmap
-		std::map<std::wstring, OctTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(entities.end() != it, L"OctTree::addEntity() failed. The entity name of " + namePARAM + L" already exists.");
-
-		// Create new entity, setting it's owner to 0
-		OctTreeEntity* pEntity = new OctTreeEntity(namePARAM, positionPARAM, 0, userDataPARAM, pUserDataPARAM);
-		ErrorIfFalse(pEntity, L"OctTree::addEntity() failed to allocate memory for new entity.");
+		return std::shared_lock<std::shared_mutex>(mutex);
+	}
 
-		// Add entity to hashmap for fast lookup
-		entities[namePARAM] = pEntity;
+	std::unique_lock<std::shared_mutex> OctTree::lockForWriting(void)
+	{
+		return std::unique_lock<std::shared_mutex>(mutex);
+	}
 
-		// Determine whether the given position of the entity fits in the root node
-		if (!rootNode->region.getPointIsInside(positionPARAM))
-		{
-			// The position of the new entity doesn't fit within the root node's area
-			// We're going to have to recreate the entire tree
+	SpatialEntityHandle OctTree::addEntity(const std::wstring& namePARAM, const Vector3f& positionPARAM, int userDataPARAM, void* pUserDataPARAM, float radiusPARAM)
+	{
+		// Make sure the entity doesn't already exist by checking the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() != it, L"OctTree::addEntity() failed. The entity name of " + namePARAM + L" already exists.");
 
-			// Delete root node, which will delete all children and their children and so on.
-			// This does not delete the entities (As they're stored in the _mmapEntities hashmap)
-			// But before deleting the root node, get it's currently set region which we will multiply to get
-			// the root node's new dimensions
-			AABB aabbOldRootNodeRegion = rootNode->region;
-			delete rootNode;
+		// Create new entity and add it's handle to the hashmap for lookup by name
+		OctTreeEntity* pEntity = createEntity(namePARAM, positionPARAM, userDataPARAM, pUserDataPARAM, radiusPARAM);
+		entityNames[namePARAM] = pEntity->handle;
 
-			// Inscrease the old root node's region size until the new entity's position fits within
-			bool bNewPositionFits = false;
-			while (!bNewPositionFits)
-			{
-				aabbOldRootNodeRegion.resizeArea(sizeIncreaseMultiplier);
-				bNewPositionFits = aabbOldRootNodeRegion.getPointIsInside(positionPARAM);
-			}
+		insertEntityIntoTree(pEntity);
+		return pEntity->handle;
+	}
 
-			// Now re-create the root node, passing 0 as the pointer to the parent node and the new region size
-			rootNode = new OctTreeNode(aabbOldRootNodeRegion, 0, this);
-			ErrorIfFalse(rootNode, L"OctTree::addEntity() failed. Unable to allocate memory for new root node.");
+	SpatialEntityHandle OctTree::addEntity(const Vector3f& positionPARAM, int userDataPARAM, void* pUserDataPARAM, float radiusPARAM)
+	{
+		OctTreeEntity* pEntity = createEntity(L"", positionPARAM, userDataPARAM, pUserDataPARAM, radiusPARAM);
+		insertEntityIntoTree(pEntity);
+		return pEntity->handle;
+	}
 
-			// Now re-insert all entities stored in the hash map back into the tree
-			// The new entity has already been added to the hash map, so no need to insert it seperately
-			it = entities.begin();
-			while (it != entities.end())
-			{
-				rootNode->addEntity(it->second);
-				it++;
-			}
-		}
-		else  // The entity position does fit inside the area of this node, simply add it
-		{
-			rootNode->addEntity(pEntity);
-		}
+	void OctTree::setEntityRadius(SpatialEntityHandle handlePARAM, float radiusPARAM)
+	{
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"OctTree::setEntityRadius() failed. The given entity handle is invalid.");
+		ErrorIfTrue(radiusPARAM < 0, L"OctTree::setEntityRadius() failed. The given radius is negative.");
+		pEntity->radius = radiusPARAM;
 	}
 
 	void OctTree::removeEntity(const std::wstring& namePARAM)
 	{
 		// Make sure the entity exists by checking the hashmap
-		std::map<std::wstring, OctTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(entities.end() == it, L"OctTree::removeEntity() failed. The entity name of " + namePARAM + L" doesn't exist.");
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"OctTree::removeEntity() failed. The entity name of " + namePARAM + L" doesn't exist.");
 
-		// Get the node the entity is stored in to remove the entity from itself.
-		OctTreeNode* pNodeContainingRemovedEntity = it->second->nodeOwner;
-		pNodeContainingRemovedEntity->removeEntity(it->second);
+		OctTreeEntity* pEntity = findEntity(it->second);
+		entityNames.erase(it);
+		removeEntityFromTree(pEntity);
+		deleteEntity(pEntity);
+	}
 
-		// Remove the entity from the hashmap and delete it
-		OctTreeEntity* pEntity = it->second;
-		entities.erase(it);
-		delete pEntity;
+	void OctTree::removeEntity(SpatialEntityHandle handlePARAM)
+	{
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"OctTree::removeEntity() failed. The given entity handle is invalid.");
 
-		// Now check to see if the node is now empty and if so, remove it
-		if (!pNodeContainingRemovedEntity->hasEntitiesInThisAndAllChildren())
-		{
-			// Is the node which held the removed entity, the root node
-			bool bNodeIsRoot = rootNode == pNodeContainingRemovedEntity;
+		// If the entity was given a name, remove that too
+		if (!pEntity->name.empty())
+			entityNames.erase(pEntity->name);
+		removeEntityFromTree(pEntity);
+		deleteEntity(pEntity);
+	}
 
-			if (!bNodeIsRoot)  // The node wasn't the root node and therefore pNodeParent will contain a valid pointer to it's parent node.
-			{
-				// Store pointer to the parent
-				OctTreeNode* pNodeParent = pNodeContainingRemovedEntity->parentNode;
+	bool OctTree::getEntityExists(const std::wstring& namePARAM) const
+	{
+		// Check the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		return(entityNames.end() != it);
+	}
 
-				// We're done, except...
-				// We need to traverse up to the root node and delete any NOW empty nodes, which may 
-				// have only existed to hold the now deleted node.
-				// We also have to remove any parent node's _mpChildNode[8] pointers if we delete a node.
-				while (pNodeParent)
-				{
-					// Go through each of the eight possible child nodes of the parent
-					for (int i = 0; i < 8; i++)
-					{
-						if (pNodeParent->childNodes[i])	// There is a child at this array position
-						{
-							if (!pNodeParent->childNodes[i]->hasEntitiesInThisAndAllChildren())	// Node is empty
-							{
-								delete pNodeParent->childNodes[i];
-								pNodeParent->childNodes[i] = 0;
-							}
-						}
-					}
-					pNodeParent = pNodeParent->parentNode;
-				}
+	bool OctTree::getEntityExists(SpatialEntityHandle handlePARAM) const
+	{
+		return findEntity(handlePARAM) != 0;
+	}
 
-				// This will delete the node and all it's children.
-				// No need to delete, as it's deleted above when deleting children.
-				// If we attempted to delete again, all hell breaks loose!
-//				delete pNodeContainingRemovedEntity;
-			}
-		}
-		// The node which contained the entity has other entities, leave it alone.
+	SpatialEntityHandle OctTree::getEntityHandle(const std::wstring& namePARAM) const
+	{
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"OctTree::getEntityHandle() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		return it->second;
 	}
 
-	bool OctTree::getEntityExists(const std::wstring& namePARAM) const
+	OctTreeEntity* OctTree::getEntity(SpatialEntityHandle handlePARAM) const
 	{
-		// Check the hashmap
-		std::map<std::wstring, OctTreeEntity*>::iterator it = entities.find(namePARAM);
-		return(entities.end() != it);
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"OctTree::getEntity() failed. The given entity handle is invalid.");
+		return pEntity;
 	}
 
 	void OctTree::removeAllEntities(bool resetTreePARAM)
 	{
 		// Go through each entity, asking each node which it's in to remove itself
-		std::map<std::wstring, OctTreeEntity*>::iterator it = entities.begin();
-		while (it != entities.end())
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
 		{
+			OctTreeEntity* pEntity = entitySlots[ui].entity;
+			if (!pEntity)
+				continue;
+
 			// Get the node the entity is stored in to remove the entity from itself.
-			it->second->nodeOwner->removeEntity(it->second);
+			removeEntityFromNode(pEntity->nodeOwner, pEntity);
 
-			// Remove the entity from the hashmap and delete it
-			OctTreeEntity* pEntity = it->second;
-			entities.erase(it);
-			delete pEntity;
-			it = entities.begin();
+			// Delete the entity and free it's slot
+			deleteEntity(pEntity);
 		}
+		entityNames.clear();
 
 		// Now all entities are removed and deleted, reset the tree if bResetTree desires it
 		if (resetTreePARAM)
 		{
 			// Get the root node's AABB, so we can re-create it
-			AABB aabbRootNode = rootNode->region;
-			delete rootNode;
-			rootNode = new OctTreeNode(aabbRootNode, 0, this);
+			AABB aabbRootNode = nodes[0].region;
+			resetNodes(aabbRootNode);
+		}
+	}
+
+	std::vector<SpatialEntityHandle> OctTree::buildFromPoints(std::span<const Vector3f> positionsPARAM, std::span<const int> userDataPARAM, unsigned int numThreadsPARAM)
+	{
+		ErrorIfTrue(userDataPARAM.size() && userDataPARAM.size() != positionsPARAM.size(), L"OctTree::buildFromPoints() failed. The number of userData values and positions given are not the same.");
+
+		// Remove all existing entities and nodes
+		removeAllEntities(true);
+		std::vector<SpatialEntityHandle> handles(positionsPARAM.size(), kSpatialEntityHandleInvalid);
+		if (positionsPARAM.empty())
+			return handles;
+
+		// Compute the region covering all of the positions, then increase the root node's region size until that
+		// region fits within it, the same as would happen if the entities were added one at a time, but without
+		// rebuilding the tree each time.
+		Vector3f vMin = positionsPARAM[0];
+		Vector3f vMax = positionsPARAM[0];
+		for (size_t i = 1; i < positionsPARAM.size(); i++)
+		{
+			const Vector3f& vPos = positionsPARAM[i];
+			vMin.x = std::min(vMin.x, vPos.x);
+			vMin.y = std::min(vMin.y, vPos.y);
+			vMin.z = std::min(vMin.z, vPos.z);
+			vMax.x = std::max(vMax.x, vPos.x);
+			vMax.y = std::max(vMax.y, vPos.y);
+			vMax.z = std::max(vMax.z, vPos.z);
+		}
+		AABB aabbRootNodeRegion = nodes[0].region;
+		while (!aabbRootNodeRegion.getPointIsInside(vMin) || !aabbRootNodeRegion.getPointIsInside(vMax))
+			aabbRootNodeRegion.resizeArea(sizeIncreaseMultiplier);
+		resetNodes(aabbRootNodeRegion);
+
+		// Sort the positions by the Morton code of their position within the root node's region, so that
+		// entities which are close together within the world are created next to each other in memory and
+		// are kept next to each other as they are sorted into the nodes below.
+		Vector3f vRegionMin = aabbRootNodeRegion.getMin();
+		Vector3f vRegionDims = aabbRootNodeRegion.getDimensions();
+		Vector3f vScale(1023.0f / vRegionDims.x, 1023.0f / vRegionDims.y, 1023.0f / vRegionDims.z);
+		std::vector<std::pair<unsigned int, unsigned int>> mortonOrder(positionsPARAM.size());
+		for (size_t i = 0; i < positionsPARAM.size(); i++)
+		{
+			Vector3f vCell = positionsPARAM[i] - vRegionMin;
+			unsigned int x = (unsigned int)std::min(std::max(vCell.x * vScale.x, 0.0f), 1023.0f);
+			unsigned int y = (unsigned int)std::min(std::max(vCell.y * vScale.y, 0.0f), 1023.0f);
+			unsigned int z = (unsigned int)std::min(std::max(vCell.z * vScale.z, 0.0f), 1023.0f);
+			mortonOrder[i].first = mortonCode3D(x, y, z);
+			mortonOrder[i].second = (unsigned int)i;
+		}
+		sortMortonCodes(mortonOrder);
+
+		// Create the entities in Morton order
+		entitySlots.reserve(positionsPARAM.size());
+		std::vector<OctTreeEntity*> entities(positionsPARAM.size());
+		for (size_t i = 0; i < mortonOrder.size(); i++)
+		{
+			unsigned int index = mortonOrder[i].second;
+			entities[i] = createEntity(L"", positionsPARAM[index], userDataPARAM.size() ? userDataPARAM[index] : 0, 0, 0.0f);
+			handles[index] = entities[i]->handle;
+		}
+		std::vector<std::pair<unsigned int, unsigned int>>().swap(mortonOrder);
+
+		// If all the entities fit inside of the root node, there's nothing more to do
+		std::vector<OctTreeEntity*> scratch(entities.size());
+		if (entities.size() <= (size_t)maxEntitiesPerNode || 0 == maxNodeDepth)
+		{
+			buildNodes(nodes, 0, entities.data(), scratch.data(), entities.size());
+			return handles;
+		}
+
+		// Determine the number of threads to use
+		unsigned int numThreads = numThreadsPARAM;
+		if (0 == numThreads)
+			numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		// Split the tree into subtrees which can be built independently of each other.
+		// Begin with the root node's children, then keep splitting the subtree with the most entities into it's
+		// children until there are plenty of subtrees to share out between the threads.
+		std::vector<BuildTask> tasks;
+		size_t childCounts[8];
+		sortEntitiesByChildNode(nodes[0], entities.data(), scratch.data(), entities.size(), childCounts);
+		size_t firstEntity = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			if (childCounts[i])
+			{
+				BuildTask task;
+				task.parentNode = 0;
+				task.childNode = (OctTreeNode::ChildNode)i;
+				task.firstEntity = firstEntity;
+				task.numEntities = childCounts[i];
+				tasks.push_back(std::move(task));
+			}
+			firstEntity += childCounts[i];
+		}
+		while (tasks.size() < (size_t)numThreads * 4)
+		{
+			// Find the subtree with the most entities which would still be split into child nodes
+			size_t largestTask = tasks.size();
+			for (size_t i = 0; i < tasks.size(); i++)
+			{
+				if (tasks[i].numEntities <= (size_t)maxEntitiesPerNode || nodes[tasks[i].parentNode].nodeDepth + 1 >= maxNodeDepth)
+					continue;
+				if (largestTask == tasks.size() || tasks[i].numEntities > tasks[largestTask].numEntities)
+					largestTask = i;
+			}
+			if (largestTask == tasks.size())
+				break;
 
-			// Reset current max node depth
-			currentMaxNodeDepth = 0;
+			// Create the subtree's root node within the tree and replace the subtree with a subtree for each of it's children
+			BuildTask task = std::move(tasks[largestTask]);
+			tasks[largestTask] = std::move(tasks.back());
+			tasks.pop_back();
+			unsigned int nodeIndex = createChildNode(task.parentNode, task.childNode);
+			sortEntitiesByChildNode(nodes[nodeIndex], entities.data() + task.firstEntity, scratch.data(), task.numEntities, childCounts);
+			firstEntity = task.firstEntity;
+			for (int i = 0; i < 8; i++)
+			{
+				if (childCounts[i])
+				{
+					BuildTask childTask;
+					childTask.parentNode = nodeIndex;
+					childTask.childNode = (OctTreeNode::ChildNode)i;
+					childTask.firstEntity = firstEntity;
+					childTask.numEntities = childCounts[i];
+					tasks.push_back(std::move(childTask));
+				}
+				firstEntity += childCounts[i];
+			}
+		}
+
+		// Create each subtree's root node within it's own node pool
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			const OctTreeNode& parent = nodes[tasks[i].parentNode];
+			tasks[i].nodes.push_back(OctTreeNode(parent.computeChildNodeRegion(tasks[i].childNode), 0, parent.nodeDepth + 1, 0, looseFactor));
+		}
 
-			// Compute new maximum node depth
-			computeMaxNodeDepth();
+		// Build the subtrees, with each thread taking the next subtree which hasn't been built yet.
+		// Each subtree's entities and it's part of the scratch space do not overlap any other's, so the threads
+		// never touch the same memory.
+		std::atomic<size_t> nextTask(0);
+		auto buildTasks = [&]()
+		{
+			size_t taskIndex;
+			while ((taskIndex = nextTask.fetch_add(1)) < tasks.size())
+			{
+				BuildTask& task = tasks[taskIndex];
+				buildNodes(task.nodes, 0, entities.data() + task.firstEntity, scratch.data() + task.firstEntity, task.numEntities);
+			}
+		};
+		numThreads = (unsigned int)std::min((size_t)numThreads, tasks.size());
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < numThreads; i++)
+			threads.push_back(std::thread(buildTasks));
+		buildTasks();
+		for (size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+
+		// Add each subtree's nodes to the end of the tree's node pool, offsetting their indicies to match
+		size_t numNodes = nodes.size();
+		for (size_t i = 0; i < tasks.size(); i++)
+			numNodes += tasks[i].nodes.size();
+		nodes.reserve(numNodes);
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			BuildTask& task = tasks[i];
+			unsigned int offset = (unsigned int)nodes.size();
+			for (size_t j = 0; j < task.nodes.size(); j++)
+			{
+				OctTreeNode& node = task.nodes[j];
+				node.octTree = this;
+				node.parentNode = (0 == j) ? task.parentNode : node.parentNode + offset;
+				for (int k = 0; k < 8; k++)
+				{
+					if (node.childNodes[k])
+						node.childNodes[k] += offset;
+				}
+				for (unsigned int k = 0; k < node.entities.size(); k++)
+					node.entities[k]->nodeOwner = offset + (unsigned int)j;
+				if (node.nodeDepth > currentMaxNodeDepth)
+					currentMaxNodeDepth = node.nodeDepth;
+				nodes.push_back(std::move(node));
+			}
+			nodes[task.parentNode].childNodes[task.childNode] = offset;
 		}
+		return handles;
 	}
 
 	void OctTree::setEntityPosition(const std::wstring& namePARAM, const Vector3f& positionPARAM)
 	{
 		// First make sure the named entity exists
-		std::map<std::wstring, OctTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(it == entities.end(), L"OctTree::setEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(it == entityNames.end(), L"OctTree::setEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		setEntityPosition(it->second, positionPARAM);
+	}
+
+	void OctTree::setEntityPosition(SpatialEntityHandle handlePARAM, const Vector3f& positionPARAM)
+	{
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"OctTree::setEntityPosition() failed. The given entity handle is invalid.");
 
 		// First check to see if the new entity position still fits within it's current node
 		// If it does, we simply update the position
-		if (it->second->nodeOwner->region.getPointIsInside(positionPARAM))
+		pEntity->position = positionPARAM;
+		if (getEntityCanStayInNode(pEntity))
 		{
-			it->second->position = positionPARAM;
+			nodes[pEntity->nodeOwner].updateEntityPosition(pEntity);
 			return;
 		}
 
 		// If we get here, the new position doesn't fit within the entity's current node
 
 		// Remove the entity from the tree and then re-insert it
-		int iUserData = it->second->userData;
-		void* pUserData = it->second->pUserData;
-		removeEntity(namePARAM);
-		addEntity(namePARAM, positionPARAM, iUserData, pUserData);
+		// The entity itself is kept, so it's handle remains valid.
+		removeEntityFromTree(pEntity);
+		insertEntityIntoTree(pEntity);
+		numReinsertions++;
+	}
+
+	void OctTree::setEntityPositions(std::span<const SpatialEntityHandle> handlesPARAM, std::span<const Vector3f> positionsPARAM)
+	{
+		ErrorIfTrue(handlesPARAM.size() != positionsPARAM.size(), L"OctTree::setEntityPositions() failed. The number of handles and positions given are not the same.");
+
+		// First pass, update the position of the entities which remain inside of their current node and take
+		// the others out of their nodes, leaving any now empty nodes alone until the end.
+		// Entities usually move into a neighbouring node, so rather than later inserting them starting at the root
+		// node, we find the node to insert them from now, by going up the tree from the node they were in until
+		// we find a node which they fit inside of, while that part of the tree is still in the cache.
+		movedEntities.clear();
+		bool bRootNeedsResizing = false;
+		for (size_t i = 0; i < handlesPARAM.size(); i++)
+		{
+			OctTreeEntity* pEntity = findEntity(handlesPARAM[i]);
+			ErrorIfFalse(pEntity, L"OctTree::setEntityPositions() failed. One of the given entity handles is invalid.");
+
+			pEntity->position = positionsPARAM[i];
+			if (getEntityCanStayInNode(pEntity))
+			{
+				nodes[pEntity->nodeOwner].updateEntityPosition(pEntity);
+				continue;
+			}
+
+			MovedEntity movedEntity;
+			movedEntity.sourceNode = pEntity->nodeOwner;
+			movedEntity.entity = pEntity;
+			removeEntityFromNode(pEntity->nodeOwner, pEntity);
+			if (nodes[0].region.getPointIsInside(pEntity->position))
+				movedEntity.insertNode = findDeepestNodeForPosition(pEntity->position, pEntity->radius, movedEntity.sourceNode);
+			else
+			{
+				movedEntity.insertNode = 0;
+				bRootNeedsResizing = true;
+			}
+			movedEntities.push_back(movedEntity);
+		}
+		if (movedEntities.empty())
+			return;
+		numReinsertions += (unsigned int)movedEntities.size();
+
+		// If any of the entities have moved outside of the root node, the entire tree has to be recreated
+		// so there's no point in inserting the entities individually.
+		if (bRootNeedsResizing)
+		{
+			// Inscrease the old root node's region size until all of the moved entities fit within
+			AABB aabbNewRootNodeRegion = nodes[0].region;
+			for (size_t i = 0; i < movedEntities.size(); i++)
+			{
+				while (!aabbNewRootNodeRegion.getPointIsInside(movedEntities[i].entity->position))
+					aabbNewRootNodeRegion.resizeArea(sizeIncreaseMultiplier);
+			}
+
+			// Empty the node pool and re-insert all entities
+			resetNodes(aabbNewRootNodeRegion);
+			for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+			{
+				if (entitySlots[ui].entity)
+					addEntityToNode(0, entitySlots[ui].entity);
+			}
+			return;
+		}
+
+		// Group the entities by the node they are to be inserted from, so that entities which are going into the
+		// same part of the tree are inserted one after another.
+		// This sorts only the moved entities, rather than counting them into a slot for every node in the pool, as
+		// usually only a few of the entities move between nodes each frame and there are many more nodes than that.
+		std::sort(movedEntities.begin(), movedEntities.end(), [](const MovedEntity& a, const MovedEntity& b)
+			{
+				if (a.insertNode != b.insertNode)
+					return a.insertNode < b.insertNode;
+				return spatialEntityHandleGetIndex(a.entity->handle) < spatialEntityHandleGetIndex(b.entity->handle);
+			});
+
+		// Re-insert the entities.
+		// No nodes are freed until all entities have been inserted, so the node indicies found above remain valid,
+		// although those nodes may have been split into child nodes, which addEntityToNode() deals with.
+		for (size_t i = 0; i < movedEntities.size(); i++)
+			addEntityToNode(movedEntities[i].insertNode, movedEntities[i].entity);
+
+		// Now free any of the nodes which the entities were taken out of, which are now empty, or collapse them
+		// into their parents if they now hold too few entities
+		for (size_t i = 0; i < movedEntities.size(); i++)
+		{
+			freeNodeIfEmpty(movedEntities[i].sourceNode);
+			collapseUnderfilledNodes(movedEntities[i].sourceNode);
+		}
+	}
+
+	void OctTree::setEntityPositions(std::span<const std::wstring> namesPARAM, std::span<const Vector3f> positionsPARAM)
+	{
+		// Find the handle of each of the named entities
+		std::vector<SpatialEntityHandle> vHandles;
+		vHandles.reserve(namesPARAM.size());
+		for (size_t i = 0; i < namesPARAM.size(); i++)
+		{
+			std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namesPARAM[i]);
+			ErrorIfTrue(it == entityNames.end(), L"OctTree::setEntityPositions() failed. The named entity of " + namesPARAM[i] + L" doesn't exist.");
+			vHandles.push_back(it->second);
+		}
+		setEntityPositions(std::span<const SpatialEntityHandle>(vHandles), positionsPARAM);
 	}
 
 	void OctTree::getEntityPosition(const std::wstring& namePARAM, Vector3f& positionPARAM) const
 	{
 		// First make sure the named entity exists
-		std::map<std::wstring, OctTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(it == entities.end(), L"OctTree::getEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
-		positionPARAM = it->second->position;
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(it == entityNames.end(), L"OctTree::getEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		positionPARAM = findEntity(it->second)->position;
+	}
+
+	void OctTree::getEntityPosition(SpatialEntityHandle handlePARAM, Vector3f& positionPARAM) const
+	{
+		OctTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"OctTree::getEntityPosition() failed. The given entity handle is invalid.");
+		positionPARAM = pEntity->position;
 	}
 
 	void OctTree::computeMaxNodeDepth(void)
 	{
 		// Obtain smallest dimension of root node
-		Vector3f vRootNodeDims = rootNode->region.getDimensions();
+		Vector3f vRootNodeDims = nodes[0].region.getDimensions();
 		float fSmallestDim = vRootNodeDims.x;
 		if (vRootNodeDims.y < fSmallestDim)
 			fSmallestDim = vRootNodeDims.y;
@@ -321,91 +589,196 @@ namespace DC
 		}
 	}
 
-	std::vector<OctTreeNode*> OctTree::getNodesWithEntities(void) const
+	std::vector<const OctTreeNode*> OctTree::getNodesWithEntities(void) const
 	{
-		std::vector<OctTreeNode*> vResult;
-		rootNode->getNodesWithEntities(vResult);
+		std::vector<const OctTreeNode*> vResult;
+		nodes[0].getNodesWithEntities(vResult);
 		return vResult;
 	}
 
-	std::vector<OctTreeNode*> OctTree::getNodesWithEntitiesWhichIntersect(const AABB& aabbPARAM) const
+	std::vector<const OctTreeNode*> OctTree::getNodesWithEntitiesWhichIntersect(const AABB& aabbPARAM) const
 	{
-		std::vector<OctTreeNode*> vResult;
-		rootNode->getNodesWithEntitiesWhichIntersect(vResult, aabbPARAM);
+		std::vector<const OctTreeNode*> vResult;
+		getNodesWithEntitiesWhichIntersect(aabbPARAM, vResult);
 		return vResult;
 	}
 
-	std::vector<OctTreeNode*> OctTree::getNodesWithEntitiesWhichIntersect(const Frustum& frustumPARAM) const
+	std::vector<const OctTreeNode*> OctTree::getNodesWithEntitiesWhichIntersect(const Frustum& frustumPARAM) const
 	{
-		std::vector<OctTreeNode*> vResult;
-		rootNode->getNodesWithEntitiesWhichIntersect(vResult, frustumPARAM);
+		std::vector<const OctTreeNode*> vResult;
+		getNodesWithEntitiesWhichIntersect(frustumPARAM, vResult);
 		return vResult;
 	}
 
 	std::vector<OctTreeEntity*> OctTree::getEntitiesWithinRange(const Vector3f& positionPARAM, float rangePARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinRange(positionPARAM, rangePARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<OctTreeEntity*> OctTree::getEntitiesWithinAABB(const AABB& aabbPARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinAABB(aabbPARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<OctTreeEntity*> OctTree::getEntitiesWithinFrustum(const Frustum& frustumPARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinFrustum(frustumPARAM, vResult);
+		return vResult;
+	}
+
+	void OctTree::getNodesWithEntitiesWhichIntersect(const AABB& aabbPARAM, std::vector<const OctTreeNode*>& nodesOutPARAM) const
+	{
+		visitNodesWithEntitiesWhichIntersect(aabbPARAM, [&nodesOutPARAM](const OctTreeNode* node) { nodesOutPARAM.push_back(node); });
+	}
+
+	void OctTree::getNodesWithEntitiesWhichIntersect(const Frustum& frustumPARAM, std::vector<const OctTreeNode*>& nodesOutPARAM) const
+	{
+		visitNodesWithEntitiesWhichIntersect(frustumPARAM, [&nodesOutPARAM](const OctTreeNode* node) { nodesOutPARAM.push_back(node); });
+	}
+
+	void OctTree::getEntitiesWithinRange(const Vector3f& positionPARAM, float rangePARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
 	{
 		// Create an AABB which covers the maximum range from the given position
 		AABB aabb;
 		float fRangeTimesTwo = rangePARAM * 2.0f;
 		aabb.setPosDims(positionPARAM, Vector3f(fRangeTimesTwo, fRangeTimesTwo, fRangeTimesTwo));
+		getEntitiesWithinAABB(aabb, entitiesOutPARAM);
+	}
 
-		// Go through the nodes and get a vector of nodes which intersect the AABB and have entities in them
-		std::vector<OctTreeNode*> vNodes = getNodesWithEntitiesWhichIntersect(aabb);
-		std::vector<OctTreeEntity*> vResult;
-		for (unsigned int ui = 0; ui < vNodes.size(); ui++)
-		{
-			// Go through each entity within each node and add them to the resulting vector
-			std::map<std::wstring, OctTreeEntity*>::iterator it = vNodes[ui]->entities.begin();
-			while (it != vNodes[ui]->entities.end())
+	void OctTree::getEntitiesWithinAABB(const AABB& aabbPARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		// Go through the nodes which intersect the AABB and have entities in them, adding each of their entities
+		visitNodesWithEntitiesWhichIntersect(aabbPARAM, [&entitiesOutPARAM](const OctTreeNode* node)
 			{
-				vResult.push_back(it->second);
-				it++;
-			}
-		}
+				entitiesOutPARAM.insert(entitiesOutPARAM.end(), node->entities.begin(), node->entities.end());
+			});
+	}
+
+	void OctTree::getEntitiesWithinFrustum(const Frustum& frustumPARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		// Go through the nodes which intersect the frustum and have entities in them, adding each of their entities
+		visitNodesWithEntitiesWhichIntersect(frustumPARAM, [&entitiesOutPARAM](const OctTreeNode* node)
+			{
+				entitiesOutPARAM.insert(entitiesOutPARAM.end(), node->entities.begin(), node->entities.end());
+			});
+	}
+
+	OctTree::FrustumCullingState::FrustumCullingState()
+	{
+		numNodesVisited = 0;
+		numPlaneTests = 0;
+	}
+
+	void OctTree::getNodesWithEntitiesWhichIntersect(const Frustum& frustumPARAM, std::vector<const OctTreeNode*>& nodesOutPARAM, FrustumCullingState& statePARAM) const
+	{
+		visitNodesWithEntitiesWhichIntersect(frustumPARAM, statePARAM, [&nodesOutPARAM](const OctTreeNode* node) { nodesOutPARAM.push_back(node); });
+	}
+
+	void OctTree::getEntitiesWithinFrustum(const Frustum& frustumPARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM, FrustumCullingState& statePARAM) const
+	{
+		visitNodesWithEntitiesWhichIntersect(frustumPARAM, statePARAM, [&entitiesOutPARAM](const OctTreeNode* node)
+			{
+				entitiesOutPARAM.insert(entitiesOutPARAM.end(), node->entities.begin(), node->entities.end());
+			});
+	}
+
+	std::vector<OctTreeEntity*> OctTree::getEntitiesWithinRangeExact(const Vector3f& positionPARAM, float rangePARAM, bool sortByDistancePARAM) const
+	{
+		std::vector<OctTreeEntity*> vResult;
+		getEntitiesWithinRangeExact(positionPARAM, rangePARAM, vResult, sortByDistancePARAM);
 		return vResult;
 	}
 
-	std::vector<OctTreeEntity*> OctTree::getEntitiesWithinAABB(const AABB& aabbPARAM) const
+	std::vector<OctTreeEntity*> OctTree::getEntitiesWithinAABBExact(const AABB& aabbPARAM) const
 	{
-		// Go through the nodes and get a vector of the nodes which intersect the AABB and have entities in them
-		std::vector<OctTreeNode*> vNodes = getNodesWithEntitiesWhichIntersect(aabbPARAM);
 		std::vector<OctTreeEntity*> vResult;
-		for (unsigned int ui = 0; ui < vNodes.size(); ui++)
-		{
-			// Go through each entity within each node and add them to the resulting vector
-			std::map<std::wstring, OctTreeEntity*>::iterator it = vNodes[ui]->entities.begin();
-			while (it != vNodes[ui]->entities.end())
+		getEntitiesWithinAABBExact(aabbPARAM, vResult);
+		return vResult;
+	}
+
+	void OctTree::getEntitiesWithinRangeExact(const Vector3f& positionPARAM, float rangePARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM, bool sortByDistancePARAM) const
+	{
+		// Create an AABB which covers the maximum range from the given position
+		AABB aabb;
+		float fRangeTimesTwo = rangePARAM * 2.0f;
+		aabb.setPosDims(positionPARAM, Vector3f(fRangeTimesTwo, fRangeTimesTwo, fRangeTimesTwo));
+
+		// Go through the nodes which intersect the AABB and have entities in them, adding each of their entities
+		// which are within range
+		size_t firstResult = entitiesOutPARAM.size();
+		float fRangeSquared = rangePARAM * rangePARAM;
+		visitNodesWithEntitiesWhichIntersect(aabb, [&](const OctTreeNode* node)
 			{
-				vResult.push_back(it->second);
-				it++;
-			}
+				node->getEntitiesWithinRange(entitiesOutPARAM, positionPARAM, fRangeSquared);
+			});
+
+		// Sort the entities we've just added, leaving any which were already in the vector alone
+		if (sortByDistancePARAM)
+		{
+			std::sort(entitiesOutPARAM.begin() + firstResult, entitiesOutPARAM.end(), [&positionPARAM](const OctTreeEntity* entityA, const OctTreeEntity* entityB)
+				{
+					return entityA->position.getDistanceSquared(positionPARAM) < entityB->position.getDistanceSquared(positionPARAM);
+				});
 		}
-		return vResult;
 	}
 
-	std::vector<OctTreeEntity*> OctTree::getEntitiesWithinFrustum(const Frustum& frustumPARAM) const
+	void OctTree::getEntitiesWithinAABBExact(const AABB& aabbPARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		// Go through the nodes which intersect the AABB and have entities in them, adding each of their entities
+		// which are inside of the AABB
+		visitNodesWithEntitiesWhichIntersect(aabbPARAM, [&](const OctTreeNode* node)
+			{
+				node->getEntitiesWithinAABB(entitiesOutPARAM, aabbPARAM);
+			});
+	}
+
+	std::vector<OctTreeEntity*> OctTree::getNearestEntities(const Vector3f& positionPARAM, unsigned int kPARAM, float maxRangePARAM) const
 	{
-		// Go through the nodes and get a vector of the nodes which intersect the frustum and have entities in them
-		std::vector<OctTreeNode*> vNodes = getNodesWithEntitiesWhichIntersect(frustumPARAM);
 		std::vector<OctTreeEntity*> vResult;
-		for (unsigned int ui = 0; ui < vNodes.size(); ui++)
-		{
-			// Go through each entity within each node and add them to the resulting vector
-			std::map<std::wstring, OctTreeEntity*>::iterator it = vNodes[ui]->entities.begin();
-			while (it != vNodes[ui]->entities.end())
+		getNearestEntities(positionPARAM, kPARAM, maxRangePARAM, vResult);
+		return vResult;
+	}
+
+	void OctTree::getNearestEntities(const Vector3f& positionPARAM, unsigned int kPARAM, float maxRangePARAM, std::vector<OctTreeEntity*>& entitiesOutPARAM) const
+	{
+		if (0 == kPARAM)
+			return;
+
+		// Search the tree, starting at the root node, keeping the nearest entities found as a max heap
+		size_t firstResult = entitiesOutPARAM.size();
+		float fSearchDistanceSquared = maxRangePARAM * maxRangePARAM;
+		getNearestEntitiesInNode(0, positionPARAM, kPARAM, firstResult, fSearchDistanceSquared, entitiesOutPARAM);
+
+		// Sort the heap so the entities go from the nearest to the furthest
+		std::sort_heap(entitiesOutPARAM.begin() + firstResult, entitiesOutPARAM.end(), [&positionPARAM](const OctTreeEntity* entityA, const OctTreeEntity* entityB)
 			{
-				vResult.push_back(it->second);
-				it++;
-			}
-		}
+				return entityA->position.getDistanceSquared(positionPARAM) < entityB->position.getDistanceSquared(positionPARAM);
+			});
+	}
+
+	std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>> OctTree::getEntityPairsWithinRange(float rangePARAM) const
+	{
+		std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>> vResult;
+		getEntityPairsWithinRange(rangePARAM, vResult);
 		return vResult;
 	}
 
+	void OctTree::getEntityPairsWithinRange(float rangePARAM, std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairsOutPARAM) const
+	{
+		ErrorIfTrue(rangePARAM < 0.0f, L"OctTree::getEntityPairsWithinRange() failed. The given range is negative.");
+		getEntityPairsWithinRangeInNode(0, rangePARAM, pairsOutPARAM);
+	}
+
 	unsigned int OctTree::getNodeDepthCurrent(void)
 	{
 		// We have to recompute this, so go through all nodes, get their depth and compare
 		currentMaxNodeDepth = 0;
-		rootNode->getMaxNodeDepth(currentMaxNodeDepth);
+		nodes[0].getMaxNodeDepth(currentMaxNodeDepth);
 		return currentMaxNodeDepth;
 	}
 
@@ -414,4 +787,861 @@ namespace DC
 		return maxNodeDepth;
 	}
 
+	void OctTree::setNodeCollapseThreshold(unsigned int thresholdPARAM)
+	{
+		ErrorIfTrue(thresholdPARAM >= (unsigned int)maxEntitiesPerNode, L"OctTree::setNodeCollapseThreshold() failed. The threshold must be less than the maximum number of entities per node.");
+		nodeCollapseThreshold = thresholdPARAM;
+	}
+
+	unsigned int OctTree::getNodeCollapseThreshold(void) const
+	{
+		return nodeCollapseThreshold;
+	}
+
+	void OctTree::compact(void)
+	{
+		// Compute the new index of each node which is in use, in depth first order
+		std::vector<unsigned int> vNewIndicies(nodes.size(), 0);
+		std::vector<unsigned int> vOrder;
+		vOrder.reserve(nodes.size() - freeNodes.size());
+		std::vector<unsigned int> vStack;
+		vStack.push_back(0);
+		while (vStack.size())
+		{
+			unsigned int nodeIndex = vStack.back();
+			vStack.pop_back();
+			vNewIndicies[nodeIndex] = (unsigned int)vOrder.size();
+			vOrder.push_back(nodeIndex);
+
+			// Push the children in reverse, so that they are visited in the order of the ChildNode enum
+			for (int i = 7; i >= 0; i--)
+			{
+				if (nodes[nodeIndex].childNodes[i])
+					vStack.push_back(nodes[nodeIndex].childNodes[i]);
+			}
+		}
+
+		// Move the nodes into the new pool, updating the indicies they use to refer to each other and their entities
+		std::vector<OctTreeNode> vNewNodes;
+		vNewNodes.reserve(vOrder.size());
+		for (size_t i = 0; i < vOrder.size(); i++)
+		{
+			OctTreeNode& node = nodes[vOrder[i]];
+			node.parentNode = vNewIndicies[node.parentNode];
+			for (int j = 0; j < 8; j++)
+			{
+				if (node.childNodes[j])
+					node.childNodes[j] = vNewIndicies[node.childNodes[j]];
+			}
+			for (unsigned int j = 0; j < node.entities.size(); j++)
+				node.entities[j]->nodeOwner = (unsigned int)i;
+			vNewNodes.push_back(std::move(node));
+		}
+		nodes.swap(vNewNodes);
+		std::vector<unsigned int>().swap(freeNodes);
+	}
+
+	unsigned int OctTree::getNumNodes(void) const
+	{
+		return (unsigned int)(nodes.size() - freeNodes.size());
+	}
+
+	unsigned int OctTree::getNumEmptyNodes(void) const
+	{
+		unsigned int numEmptyNodes = 0;
+		std::vector<unsigned int> vStack;
+		vStack.push_back(0);
+		while (vStack.size())
+		{
+			const OctTreeNode& node = nodes[vStack.back()];
+			vStack.pop_back();
+			if (!node.hasAnyChildNodes() && node.entities.empty())
+				numEmptyNodes++;
+			for (int i = 0; i < 8; i++)
+			{
+				if (node.childNodes[i])
+					vStack.push_back(node.childNodes[i]);
+			}
+		}
+		return numEmptyNodes;
+	}
+
+	unsigned int OctTree::getNumFreeNodes(void) const
+	{
+		return (unsigned int)freeNodes.size();
+	}
+
+	size_t OctTree::getMemoryUsage(void) const
+	{
+		size_t memoryUsage = sizeof(OctTree);
+		memoryUsage += nodes.capacity() * sizeof(OctTreeNode);
+		memoryUsage += freeNodes.capacity() * sizeof(unsigned int);
+		memoryUsage += entitySlots.capacity() * sizeof(EntitySlot);
+		memoryUsage += freeEntitySlots.capacity() * sizeof(unsigned int);
+		memoryUsage += movedEntities.capacity() * sizeof(MovedEntity);
+		memoryUsage += entityNames.size() * sizeof(std::pair<const std::wstring, SpatialEntityHandle>);
+
+		// Add the memory used by the entities and by any nodes whose entities no longer fit in their inline arrays
+		memoryUsage += (entitySlots.size() - freeEntitySlots.size() - numRetiredEntitySlots) * sizeof(OctTreeEntity);
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const OctTreeNode& node = nodes[i];
+			if (node.entities.getIsOnHeap())
+				memoryUsage += node.entities.getCapacity() * sizeof(OctTreeEntity*);
+			if (node.entityPositionsX.getIsOnHeap())
+				memoryUsage += node.entityPositionsX.getCapacity() * sizeof(float) * 3;
+		}
+		return memoryUsage;
+	}
+
+	unsigned int OctTree::getNumReinsertions(void) const
+	{
+		return numReinsertions;
+	}
+
+	void OctTree::resetNumReinsertions(void)
+	{
+		numReinsertions = 0;
+	}
+
+	void OctTree::resetNodes(const AABB& rootNodeRegionPARAM)
+	{
+		// Empty the pool, keeping it's memory around for the new nodes
+		nodes.clear();
+		freeNodes.clear();
+
+		// Reset current max node depth
+		currentMaxNodeDepth = 0;
+
+		// Create the root node at index 0, with no parent
+		nodes.push_back(OctTreeNode(rootNodeRegionPARAM, 0, 0, this, looseFactor));
+
+		// Compute the maximum node depth before node division is forbidden for the new root node's region.
+		// This is done here so that the tree is divided the same however the root node came to be resized.
+		computeMaxNodeDepth();
+	}
+
+	unsigned int OctTree::createChildNode(unsigned int nodeIndexPARAM, OctTreeNode::ChildNode childNodePARAM)
+	{
+		if (nodes[nodeIndexPARAM].childNodes[childNodePARAM])
+			return nodes[nodeIndexPARAM].childNodes[childNodePARAM];
+
+		// Compute region of the new child node
+		OctTreeNode newNode(nodes[nodeIndexPARAM].computeChildNodeRegion(childNodePARAM), nodeIndexPARAM, nodes[nodeIndexPARAM].nodeDepth + 1, this, looseFactor);
+
+		// Use a previously freed node if there is one, otherwise add a new node to the end of the pool
+		unsigned int childNodeIndex;
+		if (freeNodes.size())
+		{
+			childNodeIndex = freeNodes.back();
+			freeNodes.pop_back();
+			nodes[childNodeIndex] = std::move(newNode);
+		}
+		else
+		{
+			childNodeIndex = (unsigned int)nodes.size();
+			nodes.push_back(std::move(newNode));
+		}
+		nodes[nodeIndexPARAM].childNodes[childNodePARAM] = childNodeIndex;
+		return childNodeIndex;
+	}
+
+	bool OctTree::getEntityCanStayInNode(const OctTreeEntity* entityPARAM) const
+	{
+		const OctTreeNode& node = nodes[entityPARAM->nodeOwner];
+		if (1.0f == looseFactor)
+			return node.region.getPointIsInside(entityPARAM->position);
+
+		// The entity has to stay inside of the root node's region, otherwise the root node would need resizing
+		if (!nodes[0].region.getPointIsInside(entityPARAM->position))
+			return false;
+
+		// The root node holds the entities whose radius is too large to fit into any of it's children
+		if (0 == entityPARAM->nodeOwner)
+			return true;
+
+		// Check that the sphere around the entity is inside of the node's loose region.
+		// addEntityToNode() only places an entity into a node whose loose margin it's radius fits within, so this
+		// holds for as long as the entity's position is inside of the node's region and is the same test which
+		// decided where to insert the entity.
+		Vector3f vRadius(entityPARAM->radius, entityPARAM->radius, entityPARAM->radius);
+		Vector3f vMin = node.looseRegion.getMin() + vRadius;
+		Vector3f vMax = node.looseRegion.getMax() - vRadius;
+		const Vector3f& vPosition = entityPARAM->position;
+		return vPosition.x >= vMin.x && vPosition.x <= vMax.x &&
+			vPosition.y >= vMin.y && vPosition.y <= vMax.y &&
+			vPosition.z >= vMin.z && vPosition.z <= vMax.z;
+	}
+
+	bool OctTree::getRadiusFitsInLooseMargin(const Vector3f& regionDimsPARAM, float radiusPARAM) const
+	{
+		// A tree which isn't loose ignores the radius and places entities by their position alone
+		if (1.0f == looseFactor)
+			return true;
+		Vector3f vMargin = regionDimsPARAM * ((looseFactor - 1.0f) * 0.5f);
+		return radiusPARAM <= vMargin.x && radiusPARAM <= vMargin.y && radiusPARAM <= vMargin.z;
+	}
+
+	void OctTree::freeNode(unsigned int nodeIndexPARAM)
+	{
+		OctTreeNode& node = nodes[nodeIndexPARAM];
+
+		// Free each child node
+		// This will recursively free each child node's children
+		for (int i = 0; i < 8; i++)
+		{
+			if (node.childNodes[i])
+			{
+				freeNode(node.childNodes[i]);
+				node.childNodes[i] = 0;
+			}
+		}
+
+		// This does NOT delete the entity pointers. They are stored in the entitySlots array.
+		node.removeAllEntities(true);
+		freeNodes.push_back(nodeIndexPARAM);
+	}
+
+	void OctTree::addEntityToNode(unsigned int nodeIndexPARAM, OctTreeEntity* entityPARAM)
+	{
+		unsigned int nodeIndex = nodeIndexPARAM;
+		while (true)
+		{
+			OctTreeNode& node = nodes[nodeIndex];
+
+			// With a loose tree, an entity only goes down into a child node if it's radius fits within the child
+			// node's loose margin, so that the sphere around it is inside of the child's loose region, otherwise it
+			// stays in this node, whether this node has children or not.
+			Vector3f vChildDims = node.region.getHalfDimensions();
+			bool bFitsInChildNode = getRadiusFitsInLooseMargin(vChildDims, entityPARAM->radius);
+
+			// If this node has no children, attempt to add the entity to this node
+			if (!node.hasAnyChildNodes())
+			{
+				// We haven't reached max capacity for this node
+				// OR we've reached maximum node depth with this node
+				// OR the entity is too large to go into any of the child nodes, so splitting this node won't help
+				if (node.entities.size() < (unsigned int)maxEntitiesPerNode ||
+					node.nodeDepth == maxNodeDepth ||
+					!bFitsInChildNode)
+				{
+					// Add the entity to this node
+					// No need to check if the new entity name already exists, as OctTree::addEntity() has already checked
+					node.addEntity(entityPARAM);
+					entityPARAM->nodeOwner = nodeIndex;	// Set node owner for the entity
+					return;
+				}
+
+				// We've reached maximum capacity for this node and max node depth hasn't been reached.
+				// We need to create child node/s then move all the entities from this node which fit into the
+				// children, as well as the new entity.
+				// Take the entities out of this node first, as creating child nodes may move this node in memory.
+				// This node may hold more than the maximum number of entities, if some of them are too large to go
+				// into any of the child nodes.
+				SmallArray<OctTreeEntity*, OctTreeNode::kInlineEntityCapacity + 1> entitiesToMove;
+				for (unsigned int i = 0; i < node.entities.size(); i++)
+					entitiesToMove.push_back(node.entities[i]);
+				entitiesToMove.push_back(entityPARAM);
+				node.removeAllEntities(false);
+
+				// Move all the entities from this node, into the child nodes
+				for (unsigned int i = 0; i < entitiesToMove.size(); i++)
+				{
+					// Entities which are too large to go into any of the child nodes stay in this node
+					OctTreeEntity* pEntity = entitiesToMove[i];
+					if (!getRadiusFitsInLooseMargin(vChildDims, pEntity->radius))
+					{
+						nodes[nodeIndex].addEntity(pEntity);
+						pEntity->nodeOwner = nodeIndex;
+						continue;
+					}
+
+					// Determine which child node the entity fits in, regardless of whether the child node exists or not
+					OctTreeNode::ChildNode childNode = nodes[nodeIndex].computeChildNodeForPosition(pEntity->position);
+
+					// With a loose tree, the entity may have been left in this node after moving outside of
+					// it's region, in which case it may not be inside of any of the child nodes' loose regions
+					// either, so re-insert it from the node it's now inside of instead.
+					if (OctTreeNode::ChildNode::NONE == childNode && looseFactor > 1.0f)
+					{
+						addEntityToNode(findDeepestNodeForPosition(pEntity->position, pEntity->radius, nodeIndex), pEntity);
+						numReinsertions++;
+						continue;
+					}
+
+					// Error checking, making sure the entity could fit in one of the eight possible children
+					ErrorIfTrue(OctTreeNode::ChildNode::NONE == childNode, L"OctTree::addEntityToNode() failed when trying to add entity " + pEntity->name + L" to any of the eight child nodes as it's position doesn't fit inside any of them.");
+
+					// Create the child node if it doesn't exist and add the entity to it
+					addEntityToNode(createChildNode(nodeIndex, childNode), pEntity);
+				}
+				return;
+			}
+
+			// If we get here, then this node has children, so add the new entity to this node if it's too large
+			// to go into any of them, otherwise to one of those...
+			if (!bFitsInChildNode)
+			{
+				node.addEntity(entityPARAM);
+				entityPARAM->nodeOwner = nodeIndex;
+				return;
+			}
+
+			// Determine which child node the entity fits in
+			OctTreeNode::ChildNode childNode = node.computeChildNodeForPosition(entityPARAM->position);
+
+			// Error checking, making sure the entity could fit in one of the eight possible children
+			ErrorIfTrue(OctTreeNode::ChildNode::NONE == childNode, L"OctTree::addEntityToNode() failed when trying to add entity " + entityPARAM->name + L" to any of the eight child nodes as it's position doesn't fit inside any of them.");
+
+			// Create the child node if it doesn't exist, then carry on down the tree with it
+			nodeIndex = createChildNode(nodeIndex, childNode);
+		}
+	}
+
+	void OctTree::removeEntityFromNode(unsigned int nodeIndexPARAM, OctTreeEntity* entityPARAM)
+	{
+		// The entity knows where it is within the node, so there's no need to search for it
+		OctTreeNode& node = nodes[nodeIndexPARAM];
+		unsigned int index = entityPARAM->indexInNode;
+		ErrorIfTrue(index >= node.entities.size() || node.entities[index] != entityPARAM, L"OctTree::removeEntityFromNode() failed. The entity named " + entityPARAM->name + L" could not be found");
+		node.removeEntity(index);
+		// No need to delete entity, the OctTree::removeAllEntities() or OctTree::deleteEntity() does this
+	}
+
+	OctTreeEntity* OctTree::findEntity(SpatialEntityHandle handlePARAM) const
+	{
+		unsigned int slotIndex = spatialEntityHandleGetIndex(handlePARAM);
+		if (slotIndex >= entitySlots.size())
+			return 0;
+		const EntitySlot& slot = entitySlots[slotIndex];
+		if (slot.generation != spatialEntityHandleGetGeneration(handlePARAM))
+			return 0;
+		return slot.entity;
+	}
+
+	OctTreeEntity* OctTree::createEntity(const std::wstring& namePARAM, const Vector3f& positionPARAM, int userDataPARAM, void* pUserDataPARAM, float radiusPARAM)
+	{
+		ErrorIfTrue(radiusPARAM < 0, L"OctTree::addEntity() failed. The given radius is negative.");
+
+		// Use a previously freed slot if there is one, otherwise add a new slot
+		unsigned int slotIndex;
+		if (freeEntitySlots.size())
+		{
+			slotIndex = freeEntitySlots.back();
+			freeEntitySlots.pop_back();
+		}
+		else
+		{
+			ErrorIfTrue(entitySlots.size() >= kSpatialEntityHandleMaxSlots, L"OctTree::createEntity() failed. The maximum number of entities has been reached.");
+			slotIndex = (unsigned int)entitySlots.size();
+			EntitySlot slot;
+			slot.entity = 0;
+			slot.generation = 0;
+			entitySlots.push_back(slot);
+		}
+		EntitySlot& slot = entitySlots[slotIndex];
+
+		// Create new entity, setting it's owner to 0
+		OctTreeEntity* pEntity = new OctTreeEntity(namePARAM, positionPARAM, 0, spatialEntityHandleCreate(slotIndex, slot.generation), userDataPARAM, pUserDataPARAM, radiusPARAM);
+		ErrorIfFalse(pEntity, L"OctTree::createEntity() failed to allocate memory for new entity.");
+		slot.entity = pEntity;
+		return pEntity;
+	}
+
+	void OctTree::deleteEntity(OctTreeEntity* entityPARAM)
+	{
+		// Increase the slot's generation so that any remaining handles to the entity become invalid.
+		// Once the generation no longer fits into a handle, the slot is retired instead of being reused.
+		EntitySlot& slot = entitySlots[spatialEntityHandleGetIndex(entityPARAM->handle)];
+		slot.entity = 0;
+		slot.generation++;
+		if (spatialEntityHandleGetSlotCanBeReused(slot.generation))
+			freeEntitySlots.push_back(spatialEntityHandleGetIndex(entityPARAM->handle));
+		else
+			numRetiredEntitySlots++;
+		delete entityPARAM;
+	}
+
+	void OctTree::insertEntityIntoTree(OctTreeEntity* entityPARAM)
+	{
+		// Determine whether the given position of the entity fits in the root node
+		if (!nodes[0].region.getPointIsInside(entityPARAM->position))
+		{
+			// The position of the new entity doesn't fit within the root node's area
+			// We're going to have to recreate the entire tree
+
+			// Get the root node's currently set region which we will multiply to get the root node's new dimensions
+			AABB aabbOldRootNodeRegion = nodes[0].region;
+
+			// Inscrease the old root node's region size until the new entity's position fits within
+			bool bNewPositionFits = false;
+			while (!bNewPositionFits)
+			{
+				aabbOldRootNodeRegion.resizeArea(sizeIncreaseMultiplier);
+				bNewPositionFits = aabbOldRootNodeRegion.getPointIsInside(entityPARAM->position);
+			}
+
+			// Now empty the node pool and re-create the root node with the new region size.
+			// This does not delete the entities (As they're stored in the entitySlots array)
+			// and the pool's memory is kept for the new nodes.
+			resetNodes(aabbOldRootNodeRegion);
+
+			// Now re-insert all entities stored in the slots back into the tree
+			// The new entity has already been given a slot, so no need to insert it seperately
+			for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+			{
+				if (entitySlots[ui].entity)
+					addEntityToNode(0, entitySlots[ui].entity);
+			}
+		}
+		else  // The entity position does fit inside the area of this node, simply add it
+		{
+			addEntityToNode(0, entityPARAM);
+		}
+	}
+
+	void OctTree::removeEntityFromTree(OctTreeEntity* entityPARAM)
+	{
+		// Get the node the entity is stored in to remove the entity from itself.
+		unsigned int nodeContainingRemovedEntity = entityPARAM->nodeOwner;
+		removeEntityFromNode(nodeContainingRemovedEntity, entityPARAM);
+
+		// Now check to see if the node is now empty and if so, remove it
+		if (!nodes[nodeContainingRemovedEntity].hasEntitiesInThisAndAllChildren())
+		{
+			// Is the node which held the removed entity, the root node
+			bool bNodeIsRoot = 0 == nodeContainingRemovedEntity;
+
+			if (!bNodeIsRoot)  // The node wasn't the root node and therefore nodeParent will contain a valid index of it's parent node.
+			{
+				// Store index of the parent
+				unsigned int nodeParent = nodes[nodeContainingRemovedEntity].parentNode;
+
+				// We're done, except...
+				// We need to traverse up to the root node and free any NOW empty nodes, which may 
+				// have only existed to hold the now freed node.
+				// We also have to remove any parent node's childNodes[8] indicies if we free a node.
+				while (true)
+				{
+					// Go through each of the eight possible child nodes of the parent
+					OctTreeNode& parent = nodes[nodeParent];
+					for (int i = 0; i < 8; i++)
+					{
+						if (parent.childNodes[i])	// There is a child at this array position
+						{
+							if (!nodes[parent.childNodes[i]].hasEntitiesInThisAndAllChildren())	// Node is empty
+							{
+								freeNode(parent.childNodes[i]);
+								parent.childNodes[i] = 0;
+							}
+						}
+					}
+
+					// Stop once we've dealt with the root node
+					if (0 == nodeParent)
+						break;
+					nodeParent = parent.parentNode;
+				}
+			}
+		}
+		// The node which contained the entity has other entities, leave it alone.
+
+		// Now that the node, or it's parents, hold fewer entities, they may need collapsing
+		collapseUnderfilledNodes(nodeContainingRemovedEntity);
+	}
+
+	unsigned int OctTree::findDeepestNodeForPosition(const Vector3f& positionPARAM, float radiusPARAM, unsigned int startNodeIndexPARAM) const
+	{
+		// Go up the tree until we reach a node which the position is inside of and whose loose margin the radius
+		// fits within
+		unsigned int nodeIndex = startNodeIndexPARAM;
+		while (0 != nodeIndex &&
+			(!nodes[nodeIndex].region.getPointIsInside(positionPARAM) || !getRadiusFitsInLooseMargin(nodes[nodeIndex].region.getDimensions(), radiusPARAM)))
+			nodeIndex = nodes[nodeIndex].parentNode;
+
+		// Now go down the tree, following the existing child nodes which the radius fits into
+		while (nodes[nodeIndex].hasAnyChildNodes())
+		{
+			if (!getRadiusFitsInLooseMargin(nodes[nodeIndex].region.getHalfDimensions(), radiusPARAM))
+				break;
+			OctTreeNode::ChildNode childNode = nodes[nodeIndex].computeChildNodeForPosition(positionPARAM);
+			if (OctTreeNode::ChildNode::NONE == childNode)
+				break;
+			if (!nodes[nodeIndex].childNodes[childNode])
+				break;
+			nodeIndex = nodes[nodeIndex].childNodes[childNode];
+		}
+		return nodeIndex;
+	}
+
+	void OctTree::buildNodes(std::vector<OctTreeNode>& nodePoolPARAM, unsigned int nodeIndexPARAM, OctTreeEntity** entitiesPARAM, OctTreeEntity** scratchPARAM, size_t numEntitiesPARAM)
+	{
+		// If the entities fit inside of this node, or we've reached maximum node depth, add them to this node
+		if (numEntitiesPARAM <= (size_t)maxEntitiesPerNode || nodePoolPARAM[nodeIndexPARAM].nodeDepth >= maxNodeDepth)
+		{
+			OctTreeNode& node = nodePoolPARAM[nodeIndexPARAM];
+			for (size_t i = 0; i < numEntitiesPARAM; i++)
+			{
+				node.addEntity(entitiesPARAM[i]);
+				entitiesPARAM[i]->nodeOwner = nodeIndexPARAM;
+			}
+			return;
+		}
+
+		// Otherwise, sort the entities into the child nodes they fit in, then create those child nodes and build them
+		size_t childCounts[8];
+		sortEntitiesByChildNode(nodePoolPARAM[nodeIndexPARAM], entitiesPARAM, scratchPARAM, numEntitiesPARAM, childCounts);
+		size_t firstEntity = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			if (!childCounts[i])
+				continue;
+
+			// Adding the child node may move this node in memory, so don't hold a reference to it
+			unsigned int childNodeIndex = (unsigned int)nodePoolPARAM.size();
+			const OctTreeNode& node = nodePoolPARAM[nodeIndexPARAM];
+			OctTreeNode childNode(node.computeChildNodeRegion((OctTreeNode::ChildNode)i), nodeIndexPARAM, node.nodeDepth + 1, node.octTree, looseFactor);
+			nodePoolPARAM.push_back(std::move(childNode));
+			nodePoolPARAM[nodeIndexPARAM].childNodes[i] = childNodeIndex;
+			buildNodes(nodePoolPARAM, childNodeIndex, entitiesPARAM + firstEntity, scratchPARAM + firstEntity, childCounts[i]);
+			firstEntity += childCounts[i];
+		}
+	}
+
+	void OctTree::sortEntitiesByChildNode(const OctTreeNode& nodePARAM, OctTreeEntity** entitiesPARAM, OctTreeEntity** scratchPARAM, size_t numEntitiesPARAM, size_t childCountsPARAM[8]) const
+	{
+		// Count the number of entities in each child node.
+		// The entities aren't in any node yet, so each entity's nodeOwner is used to remember it's child node.
+		for (int i = 0; i < 8; i++)
+			childCountsPARAM[i] = 0;
+		for (size_t i = 0; i < numEntitiesPARAM; i++)
+		{
+			OctTreeNode::ChildNode childNode = nodePARAM.computeChildNodeForPosition(entitiesPARAM[i]->position);
+			ErrorIfTrue(OctTreeNode::ChildNode::NONE == childNode, L"OctTree::sortEntitiesByChildNode() failed as an entity's position doesn't fit inside any of the eight child nodes.");
+			entitiesPARAM[i]->nodeOwner = childNode;
+			childCountsPARAM[childNode]++;
+		}
+
+		// Copy each entity into it's child node's place within the scratch space, then copy them all back
+		size_t childOffsets[8];
+		size_t offset = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			childOffsets[i] = offset;
+			offset += childCountsPARAM[i];
+		}
+		for (size_t i = 0; i < numEntitiesPARAM; i++)
+			scratchPARAM[childOffsets[entitiesPARAM[i]->nodeOwner]++] = entitiesPARAM[i];
+		memcpy(entitiesPARAM, scratchPARAM, sizeof(OctTreeEntity*) * numEntitiesPARAM);
+	}
+
+
+	void OctTree::getFrustumPlanes(const Frustum& frustumPARAM, FrustumPlanes& planesOutPARAM)
+	{
+		const Plane* pPlanes[6] = { &frustumPARAM.planeNear, &frustumPARAM.planeFar, &frustumPARAM.planeLeft, &frustumPARAM.planeRight, &frustumPARAM.planeTop, &frustumPARAM.planeBottom };
+		for (int plane = 0; plane < 6; plane++)
+		{
+			Vector3f vNormal = pPlanes[plane]->getNormal();
+			planesOutPARAM.normals[plane][0] = vNormal.x;
+			planesOutPARAM.normals[plane][1] = vNormal.y;
+			planesOutPARAM.normals[plane][2] = vNormal.z;
+			planesOutPARAM.distances[plane] = pPlanes[plane]->getDistanceToOrigin();
+		}
+	}
+
+	void OctTree::prepareFrustumCullingState(FrustumCullingState& statePARAM) const
+	{
+		statePARAM.numNodesVisited = 0;
+		statePARAM.numPlaneTests = 0;
+		if (statePARAM.lastRejectingPlanes.size() < nodes.size())
+			statePARAM.lastRejectingPlanes.resize(nodes.size(), 0);
+	}
+
+	void OctTree::getNearestEntitiesInNode(unsigned int nodeIndexPARAM, const Vector3f& positionPARAM, unsigned int kPARAM, size_t firstResultPARAM, float& searchDistanceSquaredPARAM, std::vector<OctTreeEntity*>& nearestEntitiesPARAM) const
+	{
+		const OctTreeNode& node = nodes[nodeIndexPARAM];
+		auto isNearer = [&positionPARAM](const OctTreeEntity* entityA, const OctTreeEntity* entityB)
+		{
+			return entityA->position.getDistanceSquared(positionPARAM) < entityB->position.getDistanceSquared(positionPARAM);
+		};
+
+		// Test each of the entities stored within this node, which with a loose tree may have children too
+		for (unsigned int i = 0; i < node.entities.size(); i++)
+		{
+			float fDiffX = node.entityPositionsX[i] - positionPARAM.x;
+			float fDiffY = node.entityPositionsY[i] - positionPARAM.y;
+			float fDiffZ = node.entityPositionsZ[i] - positionPARAM.z;
+			float fDistanceSquared = fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ;
+			if (fDistanceSquared > searchDistanceSquaredPARAM)
+				continue;
+
+			// Once we've found k entities, replace the furthest of them
+			size_t numFound = nearestEntitiesPARAM.size() - firstResultPARAM;
+			if (numFound == kPARAM)
+			{
+				if (fDistanceSquared >= searchDistanceSquaredPARAM)
+					continue;
+				std::pop_heap(nearestEntitiesPARAM.begin() + firstResultPARAM, nearestEntitiesPARAM.end(), isNearer);
+				nearestEntitiesPARAM.pop_back();
+				numFound--;
+			}
+			nearestEntitiesPARAM.push_back(node.entities[i]);
+			std::push_heap(nearestEntitiesPARAM.begin() + firstResultPARAM, nearestEntitiesPARAM.end(), isNearer);
+
+			// Now we've found k entities, we only need to search as far as the furthest of them
+			if (numFound + 1 == kPARAM)
+				searchDistanceSquaredPARAM = nearestEntitiesPARAM[firstResultPARAM]->position.getDistanceSquared(positionPARAM);
+		}
+
+		if (!node.hasAnyChildNodes())
+			return;
+
+		// Compute the squared distance from the position to each of the child nodes' regions
+		unsigned int childNodes[8];
+		float childDistancesSquared[8];
+		unsigned int numChildNodes = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			if (!node.childNodes[i])
+				continue;
+			Vector3f vMin = nodes[node.childNodes[i]].looseRegion.getMin();
+			Vector3f vMax = nodes[node.childNodes[i]].looseRegion.getMax();
+			float fDiffX = std::max(std::max(vMin.x - positionPARAM.x, positionPARAM.x - vMax.x), 0.0f);
+			float fDiffY = std::max(std::max(vMin.y - positionPARAM.y, positionPARAM.y - vMax.y), 0.0f);
+			float fDiffZ = std::max(std::max(vMin.z - positionPARAM.z, positionPARAM.z - vMax.z), 0.0f);
+			float fDistanceSquared = fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ;
+
+			// Insert the child, keeping them sorted from the nearest to the furthest
+			unsigned int j = numChildNodes;
+			while (j > 0 && childDistancesSquared[j - 1] > fDistanceSquared)
+			{
+				childNodes[j] = childNodes[j - 1];
+				childDistancesSquared[j] = childDistancesSquared[j - 1];
+				j--;
+			}
+			childNodes[j] = node.childNodes[i];
+			childDistancesSquared[j] = fDistanceSquared;
+			numChildNodes++;
+		}
+
+		// Search the child nodes, nearest first, stopping once the rest are further away than the entities found
+		for (unsigned int i = 0; i < numChildNodes; i++)
+		{
+			if (childDistancesSquared[i] > searchDistanceSquaredPARAM)
+				break;
+			getNearestEntitiesInNode(childNodes[i], positionPARAM, kPARAM, firstResultPARAM, searchDistanceSquaredPARAM, nearestEntitiesPARAM);
+		}
+	}
+
+	void OctTree::getEntityPairsWithinRangeInNode(unsigned int nodeIndexPARAM, float rangePARAM, std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairsPARAM) const
+	{
+		const OctTreeNode& node = nodes[nodeIndexPARAM];
+
+		// Test the entities stored within this node against each other
+		node.getEntityPairsWithinRange(pairsPARAM, rangePARAM);
+		if (!node.hasAnyChildNodes())
+			return;
+
+		// Then against those of each child, find the pairs within each child and then the pairs between each two
+		// of the children
+		for (int i = 0; i < 8; i++)
+		{
+			if (!node.childNodes[i])
+				continue;
+			if (node.entities.size())
+				getEntityPairsWithinRangeOfNodeEntities(nodeIndexPARAM, node.childNodes[i], rangePARAM, pairsPARAM);
+			getEntityPairsWithinRangeInNode(node.childNodes[i], rangePARAM, pairsPARAM);
+			for (int j = i + 1; j < 8; j++)
+			{
+				if (node.childNodes[j])
+					getEntityPairsWithinRangeBetweenNodes(node.childNodes[i], node.childNodes[j], rangePARAM, pairsPARAM);
+			}
+		}
+	}
+
+	void OctTree::getEntityPairsWithinRangeBetweenNodes(unsigned int nodeIndexAPARAM, unsigned int nodeIndexBPARAM, float rangePARAM, std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairsPARAM) const
+	{
+		const OctTreeNode& nodeA = nodes[nodeIndexAPARAM];
+		const OctTreeNode& nodeB = nodes[nodeIndexBPARAM];
+		bool bHasChildrenA = nodeA.hasAnyChildNodes();
+		bool bHasChildrenB = nodeB.hasAnyChildNodes();
+
+		// If either node is a leaf without any entities, there are no pairs
+		if ((!bHasChildrenA && !nodeA.entities.size()) || (!bHasChildrenB && !nodeB.entities.size()))
+			return;
+
+		// If the nodes' loose regions are further apart than the range along any axis, none of their entities are
+		// within range of each other
+		if (!getLooseRegionsWithinRange(nodeA, nodeB, rangePARAM))
+			return;
+
+		// If both nodes are leaves, test their entities against each other
+		if (!bHasChildrenA && !bHasChildrenB)
+		{
+			nodeA.getEntityPairsWithinRange(pairsPARAM, nodeB, rangePARAM);
+			return;
+		}
+
+		// Otherwise, descend into the children of the larger node, or of the one which has children, after testing
+		// the entities stored within that node itself against the other node and it's children
+		if (!bHasChildrenB || (bHasChildrenA && nodeA.region.getDimensions().x >= nodeB.region.getDimensions().x))
+		{
+			if (nodeA.entities.size())
+				getEntityPairsWithinRangeOfNodeEntities(nodeIndexAPARAM, nodeIndexBPARAM, rangePARAM, pairsPARAM);
+			for (int i = 0; i < 8; i++)
+			{
+				if (nodeA.childNodes[i])
+					getEntityPairsWithinRangeBetweenNodes(nodeA.childNodes[i], nodeIndexBPARAM, rangePARAM, pairsPARAM);
+			}
+		}
+		else
+		{
+			if (nodeB.entities.size())
+				getEntityPairsWithinRangeOfNodeEntities(nodeIndexBPARAM, nodeIndexAPARAM, rangePARAM, pairsPARAM);
+			for (int i = 0; i < 8; i++)
+			{
+				if (nodeB.childNodes[i])
+					getEntityPairsWithinRangeBetweenNodes(nodeIndexAPARAM, nodeB.childNodes[i], rangePARAM, pairsPARAM);
+			}
+		}
+	}
+
+	void OctTree::getEntityPairsWithinRangeOfNodeEntities(unsigned int entitiesNodeIndexPARAM, unsigned int nodeIndexPARAM, float rangePARAM, std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairsPARAM) const
+	{
+		const OctTreeNode& entitiesNode = nodes[entitiesNodeIndexPARAM];
+		const OctTreeNode& node = nodes[nodeIndexPARAM];
+		if (!getLooseRegionsWithinRange(entitiesNode, node, rangePARAM))
+			return;
+		if (node.entities.size())
+			entitiesNode.getEntityPairsWithinRange(pairsPARAM, node, rangePARAM);
+		for (int i = 0; i < 8; i++)
+		{
+			if (node.childNodes[i])
+				getEntityPairsWithinRangeOfNodeEntities(entitiesNodeIndexPARAM, node.childNodes[i], rangePARAM, pairsPARAM);
+		}
+	}
+
+	bool OctTree::getLooseRegionsWithinRange(const OctTreeNode& nodeAPARAM, const OctTreeNode& nodeBPARAM, float rangePARAM)
+	{
+		Vector3f vMinA = nodeAPARAM.looseRegion.getMin();
+		Vector3f vMaxA = nodeAPARAM.looseRegion.getMax();
+		Vector3f vMinB = nodeBPARAM.looseRegion.getMin();
+		Vector3f vMaxB = nodeBPARAM.looseRegion.getMax();
+		return !(vMinA.x - rangePARAM > vMaxB.x || vMaxA.x + rangePARAM < vMinB.x ||
+			vMinA.y - rangePARAM > vMaxB.y || vMaxA.y + rangePARAM < vMinB.y ||
+			vMinA.z - rangePARAM > vMaxB.z || vMaxA.z + rangePARAM < vMinB.z);
+	}
+
+	void OctTree::freeNodeIfEmpty(unsigned int nodeIndexPARAM)
+	{
+		unsigned int nodeIndex = nodeIndexPARAM;
+		while (0 != nodeIndex)
+		{
+			// If the node's parent no longer refers to the node, it has already been freed
+			OctTreeNode& parent = nodes[nodes[nodeIndex].parentNode];
+			int childNode = -1;
+			for (int i = 0; i < 8; i++)
+			{
+				if (parent.childNodes[i] == nodeIndex)
+				{
+					childNode = i;
+					break;
+				}
+			}
+			if (childNode < 0)
+				return;
+
+			// If the node still holds entities, then so do all of it's parents
+			if (nodes[nodeIndex].hasEntitiesInThisAndAllChildren())
+				return;
+
+			freeNode(nodeIndex);
+			parent.childNodes[childNode] = 0;
+			nodeIndex = nodes[nodeIndex].parentNode;
+		}
+	}
+
+	bool OctTree::getNodeIsInUse(unsigned int nodeIndexPARAM) const
+	{
+		// The root node is always in use, other nodes are in use if their parent still refers to them
+		if (0 == nodeIndexPARAM)
+			return true;
+		const OctTreeNode& parent = nodes[nodes[nodeIndexPARAM].parentNode];
+		for (int i = 0; i < 8; i++)
+		{
+			if (parent.childNodes[i] == nodeIndexPARAM)
+				return true;
+		}
+		return false;
+	}
+
+	void OctTree::collapseUnderfilledNodes(unsigned int nodeIndexPARAM)
+	{
+		if (0 == nodeCollapseThreshold)
+			return;
+
+		// Find the nearest node, starting with the given one, which hasn't been freed
+		unsigned int nodeIndex = nodeIndexPARAM;
+		while (!getNodeIsInUse(nodeIndex))
+			nodeIndex = nodes[nodeIndex].parentNode;
+
+		while (true)
+		{
+			// Nodes without children have nothing to collapse
+			if (nodes[nodeIndex].hasAnyChildNodes())
+			{
+				// If this node holds too many entities, then so do all of it's parents
+				if (countEntitiesInNode(nodeIndex, nodeCollapseThreshold + 1) > nodeCollapseThreshold)
+					return;
+
+				// Move the entities of the child nodes into this node, then free the child nodes
+				OctTreeNode& node = nodes[nodeIndex];
+				for (int i = 0; i < 8; i++)
+				{
+					if (node.childNodes[i])
+					{
+						moveEntitiesIntoNode(node.childNodes[i], nodeIndex);
+						freeNode(node.childNodes[i]);
+						node.childNodes[i] = 0;
+					}
+				}
+			}
+
+			// Stop once we've dealt with the root node
+			if (0 == nodeIndex)
+				return;
+			nodeIndex = nodes[nodeIndex].parentNode;
+		}
+	}
+
+	unsigned int OctTree::countEntitiesInNode(unsigned int nodeIndexPARAM, unsigned int maxCountPARAM) const
+	{
+		const OctTreeNode& node = nodes[nodeIndexPARAM];
+		unsigned int count = node.entities.size();
+		for (int i = 0; i < 8; i++)
+		{
+			if (count >= maxCountPARAM)
+				break;
+			if (node.childNodes[i])
+				count += countEntitiesInNode(node.childNodes[i], maxCountPARAM - count);
+		}
+		return count;
+	}
+
+	void OctTree::moveEntitiesIntoNode(unsigned int nodeIndexPARAM, unsigned int toNodeIndexPARAM)
+	{
+		OctTreeNode& node = nodes[nodeIndexPARAM];
+		OctTreeNode& toNode = nodes[toNodeIndexPARAM];
+		for (unsigned int i = 0; i < node.entities.size(); i++)
+		{
+			toNode.addEntity(node.entities[i]);
+			node.entities[i]->nodeOwner = toNodeIndexPARAM;
+		}
+		node.removeAllEntities(false);
+		for (int i = 0; i < 8; i++)
+		{
+			if (node.childNodes[i])
+				moveEntitiesIntoNode(node.childNodes[i], toNodeIndexPARAM);
+		}
+	}
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 #include "octTreeNode.h"
 #include "../Math/frustum.h"
+#include <cfloat>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
 
 namespace DC
 {
@@ -32,6 +37,52 @@ namespace DC
 	// child nodes and cause a stack overflow.
 	//
 	// The intial region is set to -8, +8 along each axis. 
+	//
+	// The nodes of the tree are not allocated one at a time, they are stored in a contiguous pool owned by the
+	// tree and refer to each other by their 32-bit index within the pool. Nodes which are removed from the tree
+	// are placed into a free list and reused when new nodes are needed, so once a tree has grown to it's working
+	// size, moving entities around causes no memory allocations. Each node stores it's entities in a small
+	// inline array, so traversing the tree and it's entities mostly touches memory which is close together.
+	//
+	// Entities may be added either with a unique name, or without one. Either way, adding an entity returns a
+	// SpatialEntityHandle which can be used to move, query and remove the entity. The methods which accept a handle
+	// find the entity by indexing into an array, whereas the methods which accept a name have to search a
+	// hashmap of names first, so the handle methods should be preferred for anything which is called often, such
+	// as moving lots of entities each frame. The name based methods are there for tools and debugging.
+	//
+	// The tree may be initialised as a "loose" oct tree, by giving init() a loose factor greater than 1.
+	// Each node then also has a loose region, which is it's region enlarged about it's centre by the loose factor,
+	// and an entity which moves is left in the node it's in for as long as it stays within that node's loose
+	// region, instead of being moved into another node as soon as it crosses the node's boundary.
+	// This stops entities which sit upon the boundary between two nodes from being moved back and forth between
+	// them each frame, which may also cause the nodes to be split and freed again and again.
+	// Entities may be given a radius, in which case it's the whole of the sphere around the entity's position
+	// which has to stay within the loose region. So that it can, an entity is only inserted as deep into the tree
+	// as the nodes whose loose margin, (looseFactor - 1) / 2 times the node's size, is at least it's radius, so
+	// entities which are too large to go into any of a node's children are stored in the node itself, even once
+	// it has children. The larger the loose factor, the further entities may move before they have to be moved
+	// into another node. getNumReinsertions() may be used to measure how many entities are being moved between
+	// nodes.
+	// The queries test the nodes' loose regions instead of their regions, as that's where their entities are.
+	//
+	// Concurrency.
+	// The tree does not lock anything itself, so that it costs nothing when it's only used from one thread.
+	// All of the const methods, such as the queries, only ever read from the tree, so any number of threads may
+	// call them at the same time, so long as no thread is modifying the tree while they do so.
+	// When the tree is modified on one thread, such as the main thread during the simulation, while other threads
+	// perform queries, such as for AI, audio occlusion or culling, use the tree's reader/writer lock...
+	// Threads performing queries hold the lock returned by lockForReading() while they perform their queries and
+	// use the results, as the nodes and entities returned may be changed or deleted once the tree is modified.
+	// The thread modifying the tree holds the lock returned by lockForWriting() while doing so, which waits for
+	// any readers to finish and stops any more from starting until the lock is released.
+	// As taking a lock isn't free, it's best to take it once for a batch of queries or modifications, such as
+	// once per frame for all of the entity movements, rather than for each call.
+	// Example:
+	// {
+	//     std::shared_lock<std::shared_mutex> lock = octTree.lockForReading();
+	//     octTree.getEntitiesWithinRangeExact(position, range, entities);
+	//     ...
+	// }
 	class OctTree
 	{
 		friend class OctTreeNode;
@@ -47,7 +98,10 @@ namespace DC
 		// amount to increase the root node's dimensions by until the new entity's
 		// position fits. A value of 2 would double the new root node's dimensions
 		// each time. It must be at least 2 otherwise an exception occurs.
-		OctTree(int maxEntitiesPerNode = 10, float sizeIncreaseMultiplier = 2.0f);
+		// looseFactor is the amount each node's region is enlarged by to give it's loose region. A value of 1
+		// gives a normal oct tree and a value of 2 gives each node a loose region which is twice the size of it's
+		// region. It must be from 1 to 2, otherwise an exception occurs.
+		OctTree(int maxEntitiesPerNode = 10, float sizeIncreaseMultiplier = 2.0f, float looseFactor = 1.0f);
 
 		// Destructor
 		// Deletes the root node, which will delete all children and their children and so on.
@@ -64,11 +118,24 @@ namespace DC
 		// amount to increase the root node's dimensions by until the new entity's
 		// position fits. A value of 2 would double the new root node's dimensions
 		// each time. It must be at least 2 otherwise an exception occurs.
-		void init(int maxEntitiesPerNode = 10, float sizeIncreaseMultiplier = 2.0f);
+		// looseFactor is the amount each node's region is enlarged by to give it's loose region. A value of 1
+		// gives a normal oct tree and a value of 2 gives each node a loose region which is twice the size of it's
+		// region. It must be from 1 to 2, otherwise an exception occurs.
+		void init(int maxEntitiesPerNode = 10, float sizeIncreaseMultiplier = 2.0f, float looseFactor = 1.0f);
 
 		// Deletes the root node and in turn all of it's children and all entities
 		void free(void);
 
+		// Returns a lock which, while held, allows the calling thread to call the const methods of the tree, such as
+		// the queries, while other threads do the same. It waits for any thread holding the lock returned by
+		// lockForWriting() to release it. See the concurrency notes at the top of this class.
+		std::shared_lock<std::shared_mutex> lockForReading(void) const;
+
+		// Returns a lock which, while held, allows the calling thread to modify the tree. It waits until all other
+		// threads have released their locks, whether for reading or writing, and stops any more from being taken.
+		// See the concurrency notes at the top of this class.
+		std::unique_lock<std::shared_mutex> lockForWriting(void);
+
 		
 		// Debug rendering of the oct tree's nodes
 //		void debugRender(CSMCamera& camera) const;
@@ -84,60 +151,273 @@ namespace DC
 		// Add entity to the oct tree.
 		// Each entity needs a unique name, if the name given already exists, an exception occurs.
 		// If the specified position is outside of the tree's region, the tree is rebuilt
-		void addEntity(const std::wstring& name, const Vector3f& position, int userData = 0, void* pUserData = 0);
+		// Returns the handle of the new entity, which may be used instead of the name for faster access.
+		// radius is the radius of the sphere around the entity's position which the entity occupies. It's only
+		// used by a loose oct tree, to decide how deep into the tree the entity may be inserted and when it has
+		// moved far enough to be moved into another node.
+		SpatialEntityHandle addEntity(const std::wstring& name, const Vector3f& position, int userData = 0, void* pUserData = 0, float radius = 0.0f);
+
+		// Add an entity which has no name to the oct tree.
+		// If the specified position is outside of the tree's region, the tree is rebuilt
+		// Returns the handle of the new entity, which is used to refer to it from then on.
+		// Handles are only valid until the entity is removed, or the tree is freed or initialised again.
+		SpatialEntityHandle addEntity(const Vector3f& position, int userData = 0, void* pUserData = 0, float radius = 0.0f);
+
+		// Sets the radius of the entity with the given handle, see addEntity().
+		// The entity isn't moved, the new radius is used from the next time the entity's position is set.
+		// If the handle is invalid, the entity has been removed, or the radius is negative, an exception occurs
+		void setEntityRadius(SpatialEntityHandle handle, float radius);
 
 		// Removes the named entity from the tree.
 		// If the unique name doesn't exist, an exception occurs.
 		// To determine whether an entity exists, use getEntityExists()
 		void removeEntity(const std::wstring& name);
 
+		// Removes the entity with the given handle from the tree.
+		// If the handle is invalid, or the entity has already been removed, an exception occurs.
+		void removeEntity(SpatialEntityHandle handle);
+
 		// Returns whether the named entity exists or not
 		bool getEntityExists(const std::wstring& name) const;
 
+		// Returns whether the entity with the given handle exists or not
+		bool getEntityExists(SpatialEntityHandle handle) const;
+
+		// Returns the handle of the named entity
+		// If the named entity doesn't exist, an exception occurs
+		SpatialEntityHandle getEntityHandle(const std::wstring& name) const;
+
+		// Returns a pointer to the entity with the given handle
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		OctTreeEntity* getEntity(SpatialEntityHandle handle) const;
+
 		// Removes all entities from the tree and depending upon the passed bool, resets the tree to contain
 		// just the root node.
 		void removeAllEntities(bool resetTree = false);
 
+		// Removes all entities from the tree, then adds an entity for each of the given positions and builds the
+		// tree's nodes from them in one go.
+		// This is much faster than calling addEntity() for each position, as the root node's region is computed up
+		// front, instead of the tree being rebuilt each time an entity is outside of it, and each node is created
+		// just once, instead of nodes being split again and again as the entities are added.
+		// The entities are sorted by their Morton code, so that entities which are close to each other within the
+		// world are close to each other in memory, then the nodes are built from the top down, with the subtrees
+		// being built in parallel.
+		// userData, if not empty, must be the same size as positions and holds the userData value of each entity.
+		// numThreads is the number of threads to use, 0 uses as many as there are hardware threads.
+		// Returns the handles of the new entities, the handle at [i] being that of the entity at positions[i].
+		// The new entities have no names.
+		std::vector<SpatialEntityHandle> buildFromPoints(std::span<const Vector3f> positions, std::span<const int> userData = std::span<const int>(), unsigned int numThreads = 0);
+
 		// Set an existing entity's position to the one given, moving to the correct node if needed.
 		// If the named entity doesn't exist, an exception occurs
 		void setEntityPosition(const std::wstring& name, const Vector3f& position);
 
+		// Set the position of the entity with the given handle, moving it to the correct node if needed.
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		void setEntityPosition(SpatialEntityHandle handle, const Vector3f& position);
+
+		// Sets the positions of many entities at once, which is much faster than calling setEntityPosition()
+		// for each of them when lots of entities move every frame.
+		// handles and positions must be the same size, positions[i] being the new position for handles[i].
+		// Entities which remain inside of their current node simply have their position updated. The remaining
+		// entities are taken out of their nodes, grouped by the node they are to be inserted from and re-inserted
+		// in one pass. Any nodes which are left empty are freed once all entities have been re-inserted, rather
+		// than after each entity.
+		// If any handle is invalid, or the two spans are of different sizes, an exception occurs
+		void setEntityPositions(std::span<const SpatialEntityHandle> handles, std::span<const Vector3f> positions);
+
+		// Same as above, but accepts the names of the entities.
+		// If any of the named entities don't exist, an exception occurs
+		void setEntityPositions(std::span<const std::wstring> names, std::span<const Vector3f> positions);
+
 		// Sets the given vector to the named entity's position.
 		// If the named entity doesn't exist, an exception occurs
 		void getEntityPosition(const std::wstring& name, Vector3f &position) const;
 
+		// Sets the given vector to the position of the entity with the given handle.
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		void getEntityPosition(SpatialEntityHandle handle, Vector3f& position) const;
+
 		// Returns a vector of COctTreeNodes which holds all nodes which have entities in them
-		std::vector<OctTreeNode*> getNodesWithEntities(void) const;
+		// The returned pointers are only valid until the tree is next modified, as the node pool may move in memory.
+		std::vector<const OctTreeNode*> getNodesWithEntities(void) const;
 
 		// Returns a vector of COctTreeNodes which holds all nodes which intersect with the given AABB and have entities
-		std::vector<OctTreeNode*> getNodesWithEntitiesWhichIntersect(const AABB& aabb) const;
+		std::vector<const OctTreeNode*> getNodesWithEntitiesWhichIntersect(const AABB& aabb) const;
 
 		// Returns a vector of COctTreeNodes which holds all nodes which intersect with the given Frustum and have entities
-		std::vector<OctTreeNode*> getNodesWithEntitiesWhichIntersect(const Frustum& frustum) const;
+		// Each of the frustum's planes' normals must point towards the inside of the frustum, so that
+		// Plane::getDistanceFromPlane() is positive for positions inside of it, as Frustum::computeFromViewProjection()
+		// creates them.
+		// The nodes are culled hierarchically. A node which is outside of one of the planes is skipped along with all
+		// of it's children, the planes which a node is fully inside of are not tested again for it's children and
+		// once a node is fully inside of all of the planes, all of it's children are visited without being tested.
+		// See FrustumCullingState for a way of making this cheaper still from one frame to the next.
+		std::vector<const OctTreeNode*> getNodesWithEntitiesWhichIntersect(const Frustum& frustum) const;
 
 		// Returns a vector of entities which are within range of the given position.
 		// This may return some entities which are outside of the range, as the test to see
 		// whether the entities aren't in range isn't 100% accurate.
+		// To only get the entities which are within range, use getEntitiesWithinRangeExact()
 		std::vector<OctTreeEntity*> getEntitiesWithinRange(const Vector3f& position, float range) const;
 
 		// Returns a vector of entities which are within the given AABB
 		// This may return some entities which are outside of the range, as the test to see
 		// whether the entities aren't in range isn't 100% accurate.
+		// To only get the entities which are inside of the AABB, use getEntitiesWithinAABBExact()
 		std::vector<OctTreeEntity*> getEntitiesWithinAABB(const AABB& aabb) const;
 
-		// Returns a vector of entities which are within the given Frustum
-		// TODO check this
+		// Returns a vector of entities which are within the nodes which intersect with the given Frustum.
+		// This may return some entities which are outside of the frustum, as only the nodes are tested.
+		// See getNodesWithEntitiesWhichIntersect() for how the nodes are culled.
 		std::vector<OctTreeEntity*> getEntitiesWithinFrustum(const Frustum& frustum) const;
 
+		// Returns a vector of the entities which are within range of the given position.
+		// Unlike getEntitiesWithinRange(), the distance to each entity is tested, so only the entities which are
+		// within range are returned and there's no need for the caller to test them again.
+		// If sortByDistance is true, the entities are sorted from the nearest to the furthest.
+		std::vector<OctTreeEntity*> getEntitiesWithinRangeExact(const Vector3f& position, float range, bool sortByDistance = false) const;
+
+		// Returns a vector of the entities whose positions are inside of the given AABB.
+		// Unlike getEntitiesWithinAABB(), each entity's position is tested, so only the entities which are inside
+		// of the AABB are returned.
+		std::vector<OctTreeEntity*> getEntitiesWithinAABBExact(const AABB& aabb) const;
+
+		// Returns a vector of the k entities which are nearest to the given position, sorted from the nearest to
+		// the furthest. Entities further away than maxRange are ignored, so fewer than k entities may be returned.
+		// Nodes are visited nearest first and any node which is further away than the furthest of the k nearest
+		// entities found so far is skipped, along with all of it's children, so only a small part of the tree is
+		// searched, instead of having to query an ever growing range until enough entities have been found.
+		std::vector<OctTreeEntity*> getNearestEntities(const Vector3f& position, unsigned int k, float maxRange = FLT_MAX) const;
+
+		// Returns each pair of entities whose positions are within range of each other, for use as the broad phase
+		// of collision detection.
+		// Calling getEntitiesWithinRangeExact() for every entity finds each pair twice and walks the tree once for
+		// each entity. Instead, this walks the tree once, testing the entities of each node against each other
+		// and against those of any other node whose loose region is within range of it's own, so each pair is
+		// only found once. The order of the pairs and of the two entities within each pair is undefined.
+		// The entities' radii are not used. To find the entities whose spheres may touch, pass the range plus twice
+		// the largest radius, then test each pair with their own radii.
+		// If range is negative, an exception occurs.
+		std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>> getEntityPairsWithinRange(float range) const;
+
+		// The methods below are the same as the ones above which return a vector, except that they add the nodes
+		// or entities to the end of the given vector instead. The vector is not cleared first.
+		// Keeping the same vector around and clearing it before each call means that once it has grown large
+		// enough, performing a query doesn't allocate any memory.
+		void getNodesWithEntitiesWhichIntersect(const AABB& aabb, std::vector<const OctTreeNode*>& nodesOut) const;
+		void getNodesWithEntitiesWhichIntersect(const Frustum& frustum, std::vector<const OctTreeNode*>& nodesOut) const;
+		void getEntitiesWithinRange(const Vector3f& position, float range, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinAABB(const AABB& aabb, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinFrustum(const Frustum& frustum, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinRangeExact(const Vector3f& position, float range, std::vector<OctTreeEntity*>& entitiesOut, bool sortByDistance = false) const;
+		void getEntitiesWithinAABBExact(const AABB& aabb, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getNearestEntities(const Vector3f& position, unsigned int k, float maxRange, std::vector<OctTreeEntity*>& entitiesOut) const;
+		void getEntityPairsWithinRange(float range, std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairsOut) const;
+
+		// The methods below call the given visitor for each node or entity which the above methods would have
+		// returned, instead of storing them in a vector, so they never allocate any memory.
+		// The visitor may be a lambda or any other callable object and is passed a const OctTreeNode* or an OctTreeEntity*
+		// Example:
+		// octTree.visitEntitiesWithinRange(position, 10.0f, [&](OctTreeEntity* entity) { numInRange++; });
+		// The tree must not be modified from within the visitor.
+		template <typename Visitor> void visitNodesWithEntitiesWhichIntersect(const AABB& aabb, Visitor&& visitor) const;
+		template <typename Visitor> void visitNodesWithEntitiesWhichIntersect(const Frustum& frustum, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinRange(const Vector3f& position, float range, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinAABB(const AABB& aabb, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinFrustum(const Frustum& frustum, Visitor&& visitor) const;
+
+		// Holds what the frustum queries below remember from one query to the next, along with how much work the
+		// last query did.
+		// For each node, the plane of the frustum which last found the node to be outside of it is remembered and
+		// tested first by the next query. As a camera usually only moves a little from one frame to the next, that
+		// plane usually finds the node to be outside again, so the node's other planes don't need to be tested.
+		// Each camera should have it's own state, which is kept from one frame to the next. As the queries modify
+		// the state, it must not be used by more than one thread at a time.
+		struct FrustumCullingState
+		{
+			// Constructor, sets the counts to zero
+			FrustumCullingState();
+
+			// Index of the frustum plane which last found each node to be outside of the frustum, indexed by the
+			// node's index within the tree's node pool. The queries enlarge this to match the node pool.
+			std::vector<unsigned char> lastRejectingPlanes;
+
+			unsigned int numNodesVisited;	// Number of nodes visited by the last query
+			unsigned int numPlaneTests;		// Number of times a node was tested against one of the frustum's planes by the last query
+		};
+
+		// The same as the frustum queries above, except that the given state is used to remember which plane last
+		// culled each node and the state's counts are set to how much work the query did.
+		void getNodesWithEntitiesWhichIntersect(const Frustum& frustum, std::vector<const OctTreeNode*>& nodesOut, FrustumCullingState& state) const;
+		void getEntitiesWithinFrustum(const Frustum& frustum, std::vector<OctTreeEntity*>& entitiesOut, FrustumCullingState& state) const;
+		template <typename Visitor> void visitNodesWithEntitiesWhichIntersect(const Frustum& frustum, FrustumCullingState& state, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinFrustum(const Frustum& frustum, FrustumCullingState& state, Visitor&& visitor) const;
+
 		// Returns current node depth stat
 		unsigned int getNodeDepthCurrent(void);
 
 		// Returns current node depth stat
 		unsigned int getNodeDepthMax(void) const;
 
+		// Returns the number of times an entity has been taken out of the node it was in and re-inserted into the
+		// tree, since the tree was initialised or resetNumReinsertions() was last called.
+		// This happens when an entity's position is set and it's no longer inside of it's node, or it's node's loose
+		// region for a loose tree. Calling resetNumReinsertions() once per frame gives the number of re-inserts per
+		// frame, which shows how much work the tree is doing to keep up with the moving entities.
+		unsigned int getNumReinsertions(void) const;
+
+		// Resets the count returned by getNumReinsertions() to zero
+		void resetNumReinsertions(void);
+
+		// Sets the number of entities which a node and all of it's children have to hold no more than, before the
+		// child nodes are freed and their entities moved back up into the node.
+		// This is checked whenever entities are removed from the tree or move into another node, so that parts of
+		// the tree which entities have moved away from don't remain split up into lots of nodes holding only a
+		// few entities.
+		// As a node is only split once it holds more than the maximum number of entities per node, keeping this
+		// below that number means that a node which has just been collapsed won't be split again as soon as another
+		// entity is added to it. By default, it is half of the maximum number of entities per node.
+		// A threshold of 0 disables collapsing, so that nodes are only freed once they are empty.
+		// If the threshold is not less than the maximum number of entities per node, an exception occurs.
+		void setNodeCollapseThreshold(unsigned int threshold);
+
+		// Returns the threshold set with setNodeCollapseThreshold()
+		unsigned int getNodeCollapseThreshold(void) const;
+
+		// Rebuilds the node pool so that it holds only the nodes which are in use by the tree, in depth first order,
+		// so that each node is followed by it's children and traversing the tree walks forwards through memory.
+		// Over time, as nodes are freed and reused, the nodes of the tree end up scattered around the pool and
+		// the pool stays as large as the tree has ever been, so this may be called once in a while, such as when
+		// loading a level, to improve the speed of the queries and free the unused memory.
+		// Any pointers to nodes are invalid afterwards.
+		void compact(void);
+
+		// Returns the number of nodes which are in use by the tree, including the root node
+		unsigned int getNumNodes(void) const;
+
+		// Returns the number of nodes which are in use by the tree which have no child nodes and no entities.
+		unsigned int getNumEmptyNodes(void) const;
+
+		// Returns the number of nodes within the node pool which have been freed and are waiting to be reused.
+		// compact() frees these.
+		unsigned int getNumFreeNodes(void) const;
+
+		// Returns the approximate number of bytes of memory used by the tree's node pool, entities and the arrays
+		// used to look them up, not including the memory used by the entities' names.
+		size_t getMemoryUsage(void) const;
+
 	private:
-		// Root node of the tree which holds all child nodes and their entities
-		OctTreeNode* rootNode;
+		// Pool of nodes, the root node of the tree which holds all child nodes and their entities is always at index 0.
+		// Nodes refer to their parent and child nodes by their index within this pool.
+		std::vector<OctTreeNode> nodes;
+
+		// The reader/writer lock returned by lockForReading() and lockForWriting()
+		mutable std::shared_mutex mutex;
+
+		// Indicies of nodes within the pool which are no longer used by the tree and can be reused
+		std::vector<unsigned int> freeNodes;
 
 		// Maximum number of entities able to be stored within a node before that node will
 		// be subdivided again into child nodes.
@@ -151,9 +431,52 @@ namespace DC
 		// Set during construction
 		float sizeIncreaseMultiplier;
 
-		// Hashmap holding pointers to each of the added entities
+		// Amount each node's region is enlarged by to give it's loose region.
+		// 1 for a normal oct tree.
+		// Set during construction
+		float looseFactor;
+
+		// Number of times an entity has been re-inserted into the tree, see getNumReinsertions()
+		unsigned int numReinsertions;
+
+		// Number of entities a node and all of it's children have to hold no more than, before the children are
+		// collapsed back into the node. See setNodeCollapseThreshold()
+		unsigned int nodeCollapseThreshold;
+
+		// A slot which holds an entity, the index of which is stored within the entity's handle
+		struct EntitySlot
+		{
+			OctTreeEntity* entity;		// Pointer to the entity in this slot, or 0 if the slot is unused
+			unsigned int generation;	// Increased each time the slot's entity is removed, to invalidate old handles
+		};
+
+		// Slots holding pointers to each of the added entities, indexed by the entity handles.
 		// This is used for fast retrieval or removal of single entities
-		mutable std::map<std::wstring, OctTreeEntity*> entities;
+		std::vector<EntitySlot> entitySlots;
+
+		// Indicies of slots within entitySlots which are no longer used and can be reused
+		std::vector<unsigned int> freeEntitySlots;
+
+		// Number of slots within entitySlots which have been retired, as their generation has run out
+		unsigned int numRetiredEntitySlots;
+
+		// Hashmap holding the handle of each of the named entities
+		// This is used by the name based methods to find an entity's handle
+		std::map<std::wstring, SpatialEntityHandle> entityNames;
+
+		// Holds an entity which has moved outside of it's node, along with the node it was taken out of and the
+		// node it is to be inserted from. Used by setEntityPositions()
+		struct MovedEntity
+		{
+			unsigned int insertNode;
+			unsigned int sourceNode;
+			OctTreeEntity* entity;
+		};
+
+		// The entities which have moved outside of their nodes, used by setEntityPositions().
+		// This is kept from one call to the next so that, once it has grown large enough, moving lots of entities
+		// every frame doesn't allocate any memory.
+		std::vector<MovedEntity> movedEntities;
 
 		// Holds the current maximum depth of the nodes.
 		// If there are no child nodes, this would be zero.
@@ -178,5 +501,330 @@ namespace DC
 		// and sets _muiMaxNodeDepth.
 		void computeMaxNodeDepth(void);
 
+		// Empties the node pool and creates a new root node covering the given region, then computes maxNodeDepth for it
+		void resetNodes(const AABB& rootNodeRegion);
+
+		// Creates the specified child node of the given node, taking a node from the free list if there is one.
+		// If the child node already exists, this does nothing.
+		// Returns the index of the child node.
+		// This may move the node pool in memory, so any references to nodes are invalid afterwards.
+		unsigned int createChildNode(unsigned int nodeIndex, OctTreeNode::ChildNode childNode);
+
+		// Returns whether the given entity, which has just been moved, may stay in the node it is in.
+		// For a tree which isn't loose, that's when the entity's position is still inside of the node's region.
+		// For a loose tree, it's when the sphere around the entity is inside of the node's loose region, so long as
+		// the entity's position remains inside of the root node's region, so that the tree can always find a node
+		// to move the entity into.
+		bool getEntityCanStayInNode(const OctTreeEntity* entity) const;
+
+		// Returns whether an entity with the given radius may be stored in a node with a region of the given
+		// dimensions, which is when the radius fits within the node's loose margin, so that the sphere around the
+		// entity is inside of the node's loose region for as long as the entity's position is inside of the node's
+		// region. Always true if the tree isn't loose.
+		bool getRadiusFitsInLooseMargin(const Vector3f& regionDims, float radius) const;
+
+		// Returns the given node and all of it's children to the free list
+		void freeNode(unsigned int nodeIndex);
+
+		// Adds an entity into the given node, or it's children which the entity's radius fits into
+		void addEntityToNode(unsigned int nodeIndex, OctTreeEntity* entity);
+
+		// Removes an entity from the given node
+		// If the entity couldn't be found, an exception occurs
+		void removeEntityFromNode(unsigned int nodeIndex, OctTreeEntity* entity);
+
+		// Returns a pointer to the entity with the given handle, or 0 if the handle is invalid or the entity has been removed
+		OctTreeEntity* findEntity(SpatialEntityHandle handle) const;
+
+		// Creates a new entity and places it into a slot, but does not insert it into the tree's nodes
+		OctTreeEntity* createEntity(const std::wstring& name, const Vector3f& position, int userData, void* pUserData, float radius);
+
+		// Deletes the given entity and frees it's slot, increasing the slot's generation
+		// The entity must have already been removed from the tree's nodes
+		void deleteEntity(OctTreeEntity* entity);
+
+		// Inserts an entity into the tree's nodes, rebuilding the tree if the entity's position is
+		// outside of the root node's region
+		void insertEntityIntoTree(OctTreeEntity* entity);
+
+		// Removes an entity from the node it is in and frees any nodes which are now empty
+		void removeEntityFromTree(OctTreeEntity* entity);
+
+		// Starting at the given node, goes up the tree until the given position is inside of a node which the given
+		// radius fits into, then follows the existing child nodes which the radius fits into down the tree and
+		// returns the index of the deepest node which an entity would be inserted from.
+		unsigned int findDeepestNodeForPosition(const Vector3f& position, float radius, unsigned int startNodeIndex = 0) const;
+
+		// A subtree of the tree which buildFromPoints() builds on one of it's threads.
+		// Each subtree is built into it's own node pool which is then added to the end of the tree's node pool.
+		struct BuildTask
+		{
+			unsigned int parentNode;			// Index of the node within the tree's node pool which the subtree is a child of
+			OctTreeNode::ChildNode childNode;	// Which of the parent node's children the subtree is
+			size_t firstEntity;					// Index of the subtree's first entity within the sorted entities
+			size_t numEntities;					// Number of entities within the subtree
+			std::vector<OctTreeNode> nodes;		// Node pool the subtree is built into, with the subtree's root node at index 0
+		};
+
+		// Builds the given node of the given node pool and all of it's children, from the given entities.
+		// scratch must point to space for the same number of entity pointers, which is used when sorting the
+		// entities into the child nodes.
+		void buildNodes(std::vector<OctTreeNode>& nodePool, unsigned int nodeIndex, OctTreeEntity** entities, OctTreeEntity** scratch, size_t numEntities);
+
+		// Sorts the given entities into the order of the child nodes of the given node which they fit inside of,
+		// keeping the existing order of the entities within each child node and sets childCounts to the number of
+		// entities within each of the eight child nodes.
+		void sortEntitiesByChildNode(const OctTreeNode& node, OctTreeEntity** entities, OctTreeEntity** scratch, size_t numEntities, size_t childCounts[8]) const;
+
+		// Calls the given visitor for each node, starting at the given node and going down through it's children,
+		// which has entities and intersects with the given AABB.
+		// Nodes which don't intersect the AABB are skipped along with all of their children.
+		template <typename Visitor> void visitNodesWhichIntersect(unsigned int nodeIndex, const AABB& aabb, Visitor& visitor) const;
+
+		// The planes of a frustum, copied out of the Frustum so that they can be quickly tested against the nodes
+		struct FrustumPlanes
+		{
+			float normals[6][3];	// Normal of each plane
+			float distances[6];		// Distance to the origin of each plane
+		};
+
+		// A plane mask with a bit set for each of the six planes of a frustum
+		static const unsigned int kAllFrustumPlanes = 0x3F;
+
+		// Copies the planes of the given frustum into planesOut
+		static void getFrustumPlanes(const Frustum& frustum, FrustumPlanes& planesOut);
+
+		// Resets the counts of the given state and enlarges it's array of planes to match the node pool
+		void prepareFrustumCullingState(FrustumCullingState& state) const;
+
+		// Calls the given visitor for each node, starting at the given node and going down through it's children,
+		// which has entities and intersects with the given frustum.
+		// planeMask has a bit set for each of the planes which the node may be outside of. The planes which the
+		// node's parent is fully inside of are not set, as the node is fully inside of them too.
+		// state may be 0, in which case no plane is remembered for each node and no counts are kept.
+		template <typename Visitor> void visitNodesWhichIntersect(unsigned int nodeIndex, const FrustumPlanes& planes, unsigned int planeMask, FrustumCullingState* state, Visitor& visitor) const;
+
+		// Calls the given visitor for each node, starting at the given node and going down through it's children,
+		// which has entities, without testing them.
+		// Used once a node is known to be fully inside of a frustum.
+		template <typename Visitor> void visitAllNodes(unsigned int nodeIndex, FrustumCullingState* state, Visitor& visitor) const;
+
+		// Used by getNearestEntities() to search the given node and it's children, nearest child first.
+		// The entities found so far are stored from nearestEntities[firstResult] onwards as a max heap, so that the
+		// furthest of them can quickly be replaced by a nearer one once k have been found.
+		// searchDistanceSquared is the squared distance beyond which nodes and entities are ignored, which is
+		// reduced to the squared distance of the furthest entity found, once k have been found.
+		void getNearestEntitiesInNode(unsigned int nodeIndex, const Vector3f& position, unsigned int k, size_t firstResult, float& searchDistanceSquared, std::vector<OctTreeEntity*>& nearestEntities) const;
+
+		// Used by getEntityPairsWithinRange() to add the pairs of entities within range of each other, which are both
+		// within the given node or it's children.
+		void getEntityPairsWithinRangeInNode(unsigned int nodeIndex, float range, std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairs) const;
+
+		// Used by getEntityPairsWithinRange() to add the pairs of entities within range of each other, where one is
+		// within the first node or it's children and the other is within the second node or it's children.
+		// Neither node may be a child of the other.
+		void getEntityPairsWithinRangeBetweenNodes(unsigned int nodeIndexA, unsigned int nodeIndexB, float range, std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairs) const;
+
+		// Used by the two methods above to add the pairs of entities within range of each other, where one is stored
+		// within the first node itself and the other is within the second node or it's children.
+		// The second node may not be the first node or one of it's parents.
+		void getEntityPairsWithinRangeOfNodeEntities(unsigned int entitiesNodeIndex, unsigned int nodeIndex, float range, std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairs) const;
+
+		// Returns whether the loose regions of the two nodes are within range of each other along every axis
+		static bool getLooseRegionsWithinRange(const OctTreeNode& nodeA, const OctTreeNode& nodeB, float range);
+
+		// If the given node is not the root node and it and it's children no longer hold any entities, frees the
+		// node, then does the same for it's parent and so on up the tree.
+		// Does nothing if the node has already been freed.
+		void freeNodeIfEmpty(unsigned int nodeIndex);
+
+		// Returns whether the given node is in use by the tree, rather than having been freed.
+		bool getNodeIsInUse(unsigned int nodeIndex) const;
+
+		// Starting at the given node, which has just had entities taken out of it, goes up the tree and collapses
+		// the first node whose entities and those of it's children number no more than nodeCollapseThreshold,
+		// then carries on up the tree collapsing it's parents until a node holds too many entities.
+		// If the given node has been freed, this starts from the nearest of it's parents which hasn't been.
+		void collapseUnderfilledNodes(unsigned int nodeIndex);
+
+		// Returns the number of entities held by the given node and all of it's children, but stops counting once
+		// maxCount has been reached, so the value returned may be less than the total
+		unsigned int countEntitiesInNode(unsigned int nodeIndex, unsigned int maxCount) const;
+
+		// Moves the entities held by the given node and all of it's children into the node given by toNodeIndex
+		void moveEntitiesIntoNode(unsigned int nodeIndex, unsigned int toNodeIndex);
+
 	};
+
+	template <typename Visitor>
+	void OctTree::visitNodesWithEntitiesWhichIntersect(const AABB& aabbPARAM, Visitor&& visitorPARAM) const
+	{
+		visitNodesWhichIntersect(0, aabbPARAM, visitorPARAM);
+	}
+
+	template <typename Visitor>
+	void OctTree::visitNodesWithEntitiesWhichIntersect(const Frustum& frustumPARAM, Visitor&& visitorPARAM) const
+	{
+		FrustumPlanes planes;
+		getFrustumPlanes(frustumPARAM, planes);
+		visitNodesWhichIntersect(0, planes, kAllFrustumPlanes, 0, visitorPARAM);
+	}
+
+	template <typename Visitor>
+	void OctTree::visitEntitiesWithinRange(const Vector3f& positionPARAM, float rangePARAM, Visitor&& visitorPARAM) const
+	{
+		// Create an AABB which covers the maximum range from the given position
+		AABB aabb;
+		float fRangeTimesTwo = rangePARAM * 2.0f;
+		aabb.setPosDims(positionPARAM, Vector3f(fRangeTimesTwo, fRangeTimesTwo, fRangeTimesTwo));
+		visitEntitiesWithinAABB(aabb, visitorPARAM);
+	}
+
+	template <typename Visitor>
+	void OctTree::visitEntitiesWithinAABB(const AABB& aabbPARAM, Visitor&& visitorPARAM) const
+	{
+		auto visitNode = [&visitorPARAM](const OctTreeNode* node)
+		{
+			for (unsigned int i = 0; i < node->entities.size(); i++)
+				visitorPARAM(node->entities[i]);
+		};
+		visitNodesWhichIntersect(0, aabbPARAM, visitNode);
+	}
+
+	template <typename Visitor>
+	void OctTree::visitEntitiesWithinFrustum(const Frustum& frustumPARAM, Visitor&& visitorPARAM) const
+	{
+		auto visitNode = [&visitorPARAM](const OctTreeNode* node)
+		{
+			for (unsigned int i = 0; i < node->entities.size(); i++)
+				visitorPARAM(node->entities[i]);
+		};
+		FrustumPlanes planes;
+		getFrustumPlanes(frustumPARAM, planes);
+		visitNodesWhichIntersect(0, planes, kAllFrustumPlanes, 0, visitNode);
+	}
+
+	template <typename Visitor>
+	void OctTree::visitNodesWithEntitiesWhichIntersect(const Frustum& frustumPARAM, FrustumCullingState& statePARAM, Visitor&& visitorPARAM) const
+	{
+		FrustumPlanes planes;
+		getFrustumPlanes(frustumPARAM, planes);
+		prepareFrustumCullingState(statePARAM);
+		visitNodesWhichIntersect(0, planes, kAllFrustumPlanes, &statePARAM, visitorPARAM);
+	}
+
+	template <typename Visitor>
+	void OctTree::visitEntitiesWithinFrustum(const Frustum& frustumPARAM, FrustumCullingState& statePARAM, Visitor&& visitorPARAM) const
+	{
+		auto visitNode = [&visitorPARAM](const OctTreeNode* node)
+		{
+			for (unsigned int i = 0; i < node->entities.size(); i++)
+				visitorPARAM(node->entities[i]);
+		};
+		visitNodesWithEntitiesWhichIntersect(frustumPARAM, statePARAM, visitNode);
+	}
+
+	template <typename Visitor>
+	void OctTree::visitNodesWhichIntersect(unsigned int nodeIndexPARAM, const AABB& aabbPARAM, Visitor& visitorPARAM) const
+	{
+		const OctTreeNode& node = nodes[nodeIndexPARAM];
+
+		// If this node doesn't intersect, then none of it's children do either
+		if (!node.looseRegion.getAABBintersects(aabbPARAM))
+			return;
+
+		// Visit this node if it has entities, which with a loose tree, it may have as well as children
+		if (node.entities.size())
+			visitorPARAM(&node);
+
+		// Check this node's children
+		for (int i = 0; i < 8; i++)
+		{
+			if (node.childNodes[i])
+				visitNodesWhichIntersect(node.childNodes[i], aabbPARAM, visitorPARAM);
+		}
+	}
+
+	template <typename Visitor>
+	void OctTree::visitNodesWhichIntersect(unsigned int nodeIndexPARAM, const FrustumPlanes& planesPARAM, unsigned int planeMaskPARAM, FrustumCullingState* statePARAM, Visitor& visitorPARAM) const
+	{
+		const OctTreeNode& node = nodes[nodeIndexPARAM];
+		bool bHasChildren = node.hasAnyChildNodes();
+
+		// If this node has no children and no entities, there's nothing to visit
+		if (!bHasChildren && !node.entities.size())
+			return;
+		if (statePARAM)
+			statePARAM->numNodesVisited++;
+
+		// Test the node against each of the planes in the mask, starting with the plane which last found it to be
+		// outside of the frustum.
+		// For each plane, the corner of the node's loose region which is furthest along the plane's normal is
+		// outside of the plane if the whole region is and the nearest corner is inside if the whole region is.
+		Vector3f vMin = node.looseRegion.getMin();
+		Vector3f vMax = node.looseRegion.getMax();
+		unsigned int firstPlane = statePARAM ? statePARAM->lastRejectingPlanes[nodeIndexPARAM] : 0;
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			unsigned int plane = (firstPlane + i) % 6;
+			if (!(planeMaskPARAM & (1 << plane)))
+				continue;
+			if (statePARAM)
+				statePARAM->numPlaneTests++;
+
+			const float* pNormal = planesPARAM.normals[plane];
+			float fFurthest = pNormal[0] * (pNormal[0] >= 0.0f ? vMax.x : vMin.x) +
+				pNormal[1] * (pNormal[1] >= 0.0f ? vMax.y : vMin.y) +
+				pNormal[2] * (pNormal[2] >= 0.0f ? vMax.z : vMin.z);
+			if (fFurthest < planesPARAM.distances[plane])
+			{
+				// The node and all of it's children are outside of the frustum
+				if (statePARAM)
+					statePARAM->lastRejectingPlanes[nodeIndexPARAM] = (unsigned char)plane;
+				return;
+			}
+			float fNearest = pNormal[0] * (pNormal[0] >= 0.0f ? vMin.x : vMax.x) +
+				pNormal[1] * (pNormal[1] >= 0.0f ? vMin.y : vMax.y) +
+				pNormal[2] * (pNormal[2] >= 0.0f ? vMin.z : vMax.z);
+			if (fNearest >= planesPARAM.distances[plane])
+				planeMaskPARAM &= ~(1 << plane);
+		}
+
+		// Visit this node if it has entities, which with a loose tree, it may have as well as children
+		if (node.entities.size())
+			visitorPARAM(&node);
+		if (!bHasChildren)
+			return;
+
+		// This node has children, check those.
+		// If this node is fully inside of all of the planes, so are all of it's children, so they don't need testing.
+		for (int i = 0; i < 8; i++)
+		{
+			if (!node.childNodes[i])
+				continue;
+			if (planeMaskPARAM)
+				visitNodesWhichIntersect(node.childNodes[i], planesPARAM, planeMaskPARAM, statePARAM, visitorPARAM);
+			else
+				visitAllNodes(node.childNodes[i], statePARAM, visitorPARAM);
+		}
+	}
+
+	template <typename Visitor>
+	void OctTree::visitAllNodes(unsigned int nodeIndexPARAM, FrustumCullingState* statePARAM, Visitor& visitorPARAM) const
+	{
+		const OctTreeNode& node = nodes[nodeIndexPARAM];
+		bool bHasChildren = node.hasAnyChildNodes();
+		if (!bHasChildren && !node.entities.size())
+			return;
+
+		if (statePARAM)
+			statePARAM->numNodesVisited++;
+		if (node.entities.size())
+			visitorPARAM(&node);
+		for (int i = 0; i < 8; i++)
+		{
+			if (node.childNodes[i])
+				visitAllNodes(node.childNodes[i], statePARAM, visitorPARAM);
+		}
+	}
 }
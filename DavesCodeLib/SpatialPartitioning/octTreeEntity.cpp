@@ -3,11 +3,14 @@
 
 namespace DC
 {
-	OctTreeEntity::OctTreeEntity(const std::wstring& namePARAM, const Vector3f& positionPARAM, OctTreeNode* nodeOwnerPARAM, int userDataPARAM, void* pUserDataPARAM)
+	OctTreeEntity::OctTreeEntity(const std::wstring& namePARAM, const Vector3f& positionPARAM, unsigned int nodeOwnerPARAM, SpatialEntityHandle handlePARAM, int userDataPARAM, void* pUserDataPARAM, float radiusPARAM)
 	{
 		name = namePARAM;
 		position = positionPARAM;
+		radius = radiusPARAM;
 		nodeOwner = nodeOwnerPARAM;
+		indexInNode = 0;
+		handle = handlePARAM;
 
 		// Store user data
 		userData = userDataPARAM;
@@ -24,8 +27,18 @@ namespace DC
 		return position;;
 	}
 
+	float OctTreeEntity::getRadius(void) const
+	{
+		return radius;
+	}
+
 	std::wstring OctTreeEntity::getName(void)
 	{
 		return name;
 	}
+
+	SpatialEntityHandle OctTreeEntity::getHandle(void) const
+	{
+		return handle;
+	}
 }
\ No newline at end of file
@@ -2,22 +2,25 @@
 #include "../Math/vector3f.h"
 #include "../Common/colour.h"
 #include "../Common/string.h"
+#include "spatialEntityHandle.h"
 
 namespace DC
 {
 	class OctTreeNode;
 
-	// An entity which is assigned into an OctTreeNode
-	// It contains it's unique name, it's position within the world and the node it belongs to.
+	// An entity which is assigned into an OctTreeNode, or stored within a LinearOctTree
+	// It contains it's handle, it's optional unique name, it's position within the world and the node it belongs to.
 	class OctTreeEntity
 	{
 		friend class OctTree;
 		friend class OctTreeNode;
+		friend class LinearOctTree;
 	public:
 		// Constructor.
-		// name is the unique name given to this entity.
+		// name is the unique name given to this entity, or an empty string if the entity was added by handle only.
 		// position is this entity's position within the world
-		OctTreeEntity(const std::wstring& name, const Vector3f& position, OctTreeNode* nodeOwner, int userData = 0, void* pUserData = 0);
+		// radius is the radius of the sphere around the entity's position which the entity occupies, see OctTree::addEntity()
+		OctTreeEntity(const std::wstring& name, const Vector3f& position, unsigned int nodeOwner, SpatialEntityHandle handle, int userData = 0, void* pUserData = 0, float radius = 0.0f);
 
 		// Set the debug colour of the entity
 		void debugSetColour(Colour& colour);
@@ -25,9 +28,15 @@ namespace DC
 		// Returns position of entity
 		Vector3f getPosition(void);
 
+		// Returns the radius of the entity
+		float getRadius(void) const;
+
 		// Returns name of the entity
 		std::wstring getName(void);
 
+		// Returns the handle of the entity, which was returned by the tree when the entity was added
+		SpatialEntityHandle getHandle(void) const;
+
 		// Below are members which may be set to store various information.
 		// They have nothing to do with the oct tree itself.
 		int userData;
@@ -36,7 +45,10 @@ namespace DC
 	private:
 		std::wstring name;				// Unique name of this entity
 		Vector3f position;				// Position of this entity
-		OctTreeNode* nodeOwner;			// The node this entity is in
+		float radius;					// Radius of the sphere around the position which this entity occupies
+		SpatialEntityHandle handle;		// Handle of this entity, used by the tree to find it quickly
+		unsigned int nodeOwner;			// Index of the node this entity is in, within the OctTree's node pool, or of the entity within the LinearOctTree's sorted arrays
+		unsigned int indexInNode;		// Index of this entity within the entity arrays of the OctTreeNode which it is in
 		Colour debugColour;				// The colour used when debug rendering this entity
 	};
 }
@@ -1,21 +1,25 @@
 #include "octTreeNode.h"
 #include "octTree.h"
 #include "../Common/error.h"
+#include "../Math/simd.h"
 
 namespace DC
 {
-	OctTreeNode::OctTreeNode(const AABB& regionPARAM, OctTreeNode* parentNodePARAM, OctTree* octTreePARAM)
+	OctTreeNode::OctTreeNode(const AABB& regionPARAM, unsigned int parentNodePARAM, unsigned int nodeDepthPARAM, OctTree* octTreePARAM, float looseFactorPARAM)
 	{
 		region = regionPARAM;
+
+		// Enlarge the region about it's centre to get the loose region.
+		// The min and max are offset, rather than setting the position and dimensions, so that with a loose
+		// factor of 1, the loose region is exactly the same as the region.
+		Vector3f vOffset = regionPARAM.getDimensions() * ((looseFactorPARAM - 1.0f) * 0.5f);
+		looseRegion.setMinMax(regionPARAM.getMin() - vOffset, regionPARAM.getMax() + vOffset);
+
 		parentNode = parentNodePARAM;
 		octTree = octTreePARAM;
-		// Is this the root node?
-		if (!parentNodePARAM)
-			nodeDepth = 0;
-		else
-			nodeDepth = parentNodePARAM->nodeDepth + 1;
+		nodeDepth = nodeDepthPARAM;
 
-		if (nodeDepth > octTreePARAM->currentMaxNodeDepth)
+		if (octTreePARAM && nodeDepth > octTreePARAM->currentMaxNodeDepth)
 			octTreePARAM->currentMaxNodeDepth = nodeDepth;
 
 		// No children yet
@@ -23,18 +27,6 @@ namespace DC
 			childNodes[i] = 0;
 	}
 
-	OctTreeNode::~OctTreeNode()
-	{
-		// Destroy each child node
-		// This will recursively call each child node's destructor
-		for (int i = 0; i < 8; i++)
-		{
-			// If child node exists
-			if (childNodes[i])
-				delete childNodes[i];
-		}
-	}
-
 /*
 	void OctTreeNode::debugRenderNodes(CResourceVertexBufferLine* line, Colour colour) const
 	{
@@ -106,7 +98,7 @@ namespace DC
 
 	bool OctTreeNode::hasChildNode(ChildNode childNodePARAM) const
 	{
-		return childNodes[childNodePARAM];
+		return childNodes[childNodePARAM] != 0;
 	}
 
 	bool OctTreeNode::hasAnyChildNodes(void) const
@@ -131,7 +123,7 @@ namespace DC
 			// If node exists
 			if (childNodes[i])
 			{
-				if (childNodes[i]->hasEntitiesInThisAndAllChildren())
+				if (octTree->nodes[childNodes[i]].hasEntitiesInThisAndAllChildren())
 					return true;
 			}
 		}
@@ -140,18 +132,6 @@ namespace DC
 		return false;
 	}
 
-	void OctTreeNode::createChildNode(ChildNode childNodePARAM)
-	{
-		if (hasChildNode(childNodePARAM))
-			return;
-
-		// Compute region of the new child node
-		AABB childNodeRegion = computeChildNodeRegion(childNodePARAM);
-
-		childNodes[childNodePARAM] = new OctTreeNode(childNodeRegion, this, octTree);
-		ErrorIfFalse(childNodes[childNodePARAM], L"OctTreeNode::createChildNode() failed. Unable to allocate memory for the new child node.");
-	}
-
 	AABB OctTreeNode::computeChildNodeRegion(ChildNode childNodePARAM) const
 	{
 		// Compute dimensions of new child node using the region of this parent node.
@@ -218,221 +198,283 @@ namespace DC
 		return childNodeRegion;
 	}
 
-	void OctTreeNode::addEntity(OctTreeEntity* entityPARAM)
+	OctTreeNode::ChildNode OctTreeNode::computeChildNodeForPosition(const Vector3f& positionPARAM) const
 	{
-		// If this node has no children, attempt to add the entity to this node
-		if (!hasAnyChildNodes())
+		// Compute the regions of the negative and positive child nodes along each axis in exactly the same way
+		// as computeChildNodeRegion() does, so that positions upon the boundary between two children end up in
+		// the same child as they would if we were to test each of the eight child regions in order.
+		Vector3f vChildDims = region.getHalfDimensions();
+		Vector3f vParentPosition = region.getPosition();
+		Vector3f vHalfChildDims = vChildDims * 0.5f;
+		Vector3f vNegPosition = vParentPosition - vHalfChildDims;
+		Vector3f vPosPosition = vParentPosition + vHalfChildDims;
+		Vector3f vNegMin = vNegPosition - vHalfChildDims;
+		Vector3f vNegMax = vNegPosition + vHalfChildDims;
+		Vector3f vPosMin = vPosPosition - vHalfChildDims;
+		Vector3f vPosMax = vPosPosition + vHalfChildDims;
+
+		// The children are tested in the order of the ChildNode enum, negative before positive along each axis,
+		// and as the tests along each axis are independent, we can pick the side along each axis seperately.
+		int childNode = 0;
+		if (positionPARAM.x < vNegMin.x || positionPARAM.x > vNegMax.x)
 		{
-			// We haven't reached max capacity for this node
-			// OR we've reached maximum node depth with this node
-			if (entities.size() < octTree->maxEntitiesPerNode ||
-				nodeDepth == octTree->maxNodeDepth)
-			{
-				// Add the entity to this node
-				// No need to check if the new entity name already exists, as OctTree::addEntity() has already checked
-				entities[entityPARAM->name] = entityPARAM;
-				entityPARAM->nodeOwner = this;	// Set node owner for the entity
-				return;
-			}
-			// If we've reached maximum capacity for this node and max node depth hasn't been reached
-			if (entities.size() == octTree->maxEntitiesPerNode)
-			{
-				// We need to create child node/s then move all the entities from this node into the children, 
-				// as well as the new entity
-
-				// Compute potential child node regions
-				AABB aabbNNN = computeChildNodeRegion(ChildNode::NEGX_NEGY_NEGZ);
-				AABB aabbNNP = computeChildNodeRegion(ChildNode::NEGX_NEGY_POSZ);
-				AABB aabbNPN = computeChildNodeRegion(ChildNode::NEGX_POSY_NEGZ);
-				AABB aabbNPP = computeChildNodeRegion(ChildNode::NEGX_POSY_POSZ);
-				AABB aabbPNN = computeChildNodeRegion(ChildNode::POSX_NEGY_NEGZ);
-				AABB aabbPNP = computeChildNodeRegion(ChildNode::POSX_NEGY_POSZ);
-				AABB aabbPPN = computeChildNodeRegion(ChildNode::POSX_POSY_NEGZ);
-				AABB aabbPPP = computeChildNodeRegion(ChildNode::POSX_POSY_POSZ);
-
-				// Add the new entity to this node's entity map, so it'll be moved to the correct child node below
-				entities[entityPARAM->name] = entityPARAM;
-				entityPARAM->nodeOwner = this;	// Set node owner for the entity
-
-				// Move all the entities from this node, into the child nodes
-				std::map<std::wstring, OctTreeEntity*>::iterator it = entities.begin();
-				while (it != entities.end())
-				{
-					// Determine which child node the entity fits in, regardless of whether the child node exists or not
-					ChildNode childNode = ChildNode::NONE;
-					if (aabbNNN.getPointIsInside(it->second->position))
-						childNode = ChildNode::NEGX_NEGY_NEGZ;
-					else if (aabbNNP.getPointIsInside(it->second->position))
-						childNode = ChildNode::NEGX_NEGY_POSZ;
-					else if (aabbNPN.getPointIsInside(it->second->position))
-						childNode = ChildNode::NEGX_POSY_NEGZ;
-					else if (aabbNPP.getPointIsInside(it->second->position))
-						childNode = ChildNode::NEGX_POSY_POSZ;
-					else if (aabbPNN.getPointIsInside(it->second->position))
-						childNode = ChildNode::POSX_NEGY_NEGZ;
-					else if (aabbPNP.getPointIsInside(it->second->position))
-						childNode = ChildNode::POSX_NEGY_POSZ;
-					else if (aabbPPN.getPointIsInside(it->second->position))
-						childNode = ChildNode::POSX_POSY_NEGZ;
-					else if (aabbPPP.getPointIsInside(it->second->position))
-						childNode = ChildNode::POSX_POSY_POSZ;
-
-					// Error checking, making sure the entity could fit in one of the eight possible children
-					ErrorIfTrue(ChildNode::NONE == childNode, L"OctTreeNode::addEntity() failed when trying to add entity " + it->second->name + L" to any of the eight child nodes as it's position doesn't fit inside any of them.");
-
-					// Create the child node if it doesn't exist
-					if (!childNodes[childNode])
-					{
-						childNodes[childNode] = new OctTreeNode(computeChildNodeRegion(childNode), this, octTree);
-						ErrorIfFalse(childNodes[childNode], L"OctTreeNode::addEntity() failed when trying to add entity " + it->second->name + L" to any of the eight child nodes as it was unable to allocate memory for the child node.");
-					}
-					childNodes[childNode]->addEntity(it->second);
-					it++;
-				}
-				// Remove all entities from this node as they are now stored in the children
-				entities.clear();
-				return;
-			}
+			if (positionPARAM.x < vPosMin.x || positionPARAM.x > vPosMax.x)
+				return ChildNode::NONE;
+			childNode += 4;
+		}
+		if (positionPARAM.y < vNegMin.y || positionPARAM.y > vNegMax.y)
+		{
+			if (positionPARAM.y < vPosMin.y || positionPARAM.y > vPosMax.y)
+				return ChildNode::NONE;
+			childNode += 1;
 		}
+		if (positionPARAM.z < vNegMin.z || positionPARAM.z > vNegMax.z)
+		{
+			if (positionPARAM.z < vPosMin.z || positionPARAM.z > vPosMax.z)
+				return ChildNode::NONE;
+			childNode += 2;
+		}
+		return ChildNode(childNode);
+	}
 
-		// If we get here, then this node has children, so add the new entity to one of those...
-		// Determine which child node the entity fits in
-		// Compute potential child node regions
-		AABB aabbNNN = computeChildNodeRegion(ChildNode::NEGX_NEGY_NEGZ);
-		AABB aabbNNP = computeChildNodeRegion(ChildNode::NEGX_NEGY_POSZ);
-		AABB aabbNPN = computeChildNodeRegion(ChildNode::NEGX_POSY_NEGZ);
-		AABB aabbNPP = computeChildNodeRegion(ChildNode::NEGX_POSY_POSZ);
-		AABB aabbPNN = computeChildNodeRegion(ChildNode::POSX_NEGY_NEGZ);
-		AABB aabbPNP = computeChildNodeRegion(ChildNode::POSX_NEGY_POSZ);
-		AABB aabbPPN = computeChildNodeRegion(ChildNode::POSX_POSY_NEGZ);
-		AABB aabbPPP = computeChildNodeRegion(ChildNode::POSX_POSY_POSZ);
-
-		ChildNode childNode = ChildNode::NONE;
-		if (aabbNNN.getPointIsInside(entityPARAM->position))
-			childNode = ChildNode::NEGX_NEGY_NEGZ;
-		else if (aabbNNP.getPointIsInside(entityPARAM->position))
-			childNode = ChildNode::NEGX_NEGY_POSZ;
-		else if (aabbNPN.getPointIsInside(entityPARAM->position))
-			childNode = ChildNode::NEGX_POSY_NEGZ;
-		else if (aabbNPP.getPointIsInside(entityPARAM->position))
-			childNode = ChildNode::NEGX_POSY_POSZ;
-		else if (aabbPNN.getPointIsInside(entityPARAM->position))
-			childNode = ChildNode::POSX_NEGY_NEGZ;
-		else if (aabbPNP.getPointIsInside(entityPARAM->position))
-			childNode = ChildNode::POSX_NEGY_POSZ;
-		else if (aabbPPN.getPointIsInside(entityPARAM->position))
-			childNode = ChildNode::POSX_POSY_NEGZ;
-		else if (aabbPPP.getPointIsInside(entityPARAM->position))
-			childNode = ChildNode::POSX_POSY_POSZ;
-
-		// Error checking, making sure the entity could fit in one of the eight possible children
-		ErrorIfTrue(ChildNode::NONE == childNode, L"OctTreeNode::addEntity() failed when trying to add entity " + entityPARAM->name + L" to any of the eight child nodes as it's position doesn't fit inside any of them.");
-
-		// Create the child node if it doesn't exist
-		if (!childNodes[childNode])
+	void OctTreeNode::getNodesWithEntities(std::vector<const OctTreeNode*>& nodesPARAM) const
+	{
+		// Add this node if it has entities, which with a loose tree, it may have as well as children
+		if (entities.size())
+			nodesPARAM.push_back(this);
+
+		// Then check this node's children
+		for (int i = 0; i < 8; i++)
 		{
-			childNodes[childNode] = new OctTreeNode(computeChildNodeRegion(childNode), this, octTree);
-			ErrorIfFalse(childNodes[childNode], L"OctTreeNode::addEntity() failed when trying to add entity " + entityPARAM->name + L" to any of the eight child nodes as it was unable to allocate memory for the child node.");
+			if (childNodes[i])
+				octTree->nodes[childNodes[i]].getNodesWithEntities(nodesPARAM);
 		}
+	}
+
+	void OctTreeNode::getMaxNodeDepth(unsigned int& maxNodeDepthPARAM) const
+	{
+		if (nodeDepth > maxNodeDepthPARAM)
+			maxNodeDepthPARAM = nodeDepth;
 
-		// Add the new entity
-		childNodes[childNode]->addEntity(entityPARAM);
+		// Call this method for all children of this node
+		for (int i = 0; i < 8; i++)
+		{
+			if (childNodes[i])	// If child exists
+				octTree->nodes[childNodes[i]].getMaxNodeDepth(maxNodeDepthPARAM);
+		}
 	}
 
-	void OctTreeNode::removeEntity(OctTreeEntity* entityPARAM)
+	const AABB& OctTreeNode::getRegion(void) const
 	{
-		// Attempt to find the entity
-		std::map<std::wstring, OctTreeEntity*>::iterator it = entities.find(entityPARAM->name);
-		ErrorIfTrue(it == entities.end(), L"OctTreeNode::removeEntity() failed. The entity named " + entityPARAM->name + L" could not be found");
-		entities.erase(it);
-		// No need to delete entity, the OctTree::removeAllEntities() or OctTree::removeEntity() does this
+		return region;
 	}
 
-	void OctTreeNode::getNodesWithEntities(std::vector<OctTreeNode*>& nodesPARAM)
+	const AABB& OctTreeNode::getLooseRegion(void) const
 	{
-		// If this node doesn't have any children, just check this node
-		if (!hasAnyChildNodes())
-		{
-			// If this node doesn't have any entities
-			if (0 == entities.size())
-				return;
+		return looseRegion;
+	}
 
-			// Add this node
-			nodesPARAM.push_back(this);
-			return;
-		}
-		else  // This node has children, check those
+	unsigned int OctTreeNode::getNumEntities(void) const
+	{
+		return entities.size();
+	}
+
+	void OctTreeNode::getEntitiesWithinRange(std::vector<OctTreeEntity*>& entitiesPARAM, const Vector3f& positionPARAM, float rangeSquaredPARAM) const
+	{
+		const float* pPositionsX = entityPositionsX.data();
+		const float* pPositionsY = entityPositionsY.data();
+		const float* pPositionsZ = entityPositionsZ.data();
+		unsigned int numEntities = entities.size();
+
+		// Test kSIMDWidth entities at a time
+		SIMDFloats vPositionX = simdSet(positionPARAM.x);
+		SIMDFloats vPositionY = simdSet(positionPARAM.y);
+		SIMDFloats vPositionZ = simdSet(positionPARAM.z);
+		SIMDFloats vRangeSquared = simdSet(rangeSquaredPARAM);
+		unsigned int i = 0;
+		for (; i + kSIMDWidth <= numEntities; i += kSIMDWidth)
 		{
-			for (int i = 0; i < 8; i++)
+			SIMDFloats vDiffX = simdSub(simdLoadUnaligned(pPositionsX + i), vPositionX);
+			SIMDFloats vDiffY = simdSub(simdLoadUnaligned(pPositionsY + i), vPositionY);
+			SIMDFloats vDiffZ = simdSub(simdLoadUnaligned(pPositionsZ + i), vPositionZ);
+			SIMDFloats vDistSquared = simdAdd(simdAdd(simdMul(vDiffX, vDiffX), simdMul(vDiffY, vDiffY)), simdMul(vDiffZ, vDiffZ));
+			int mask = simdGetLessOrEqualMask(vDistSquared, vRangeSquared);
+			for (unsigned int j = 0; j < kSIMDWidth; j++)
 			{
-				if (childNodes[i])
-					childNodes[i]->getNodesWithEntities(nodesPARAM);
+				if (mask & (1 << j))
+					entitiesPARAM.push_back(entities[i + j]);
 			}
 		}
+
+		// Then test the remaining entities one at a time
+		for (; i < numEntities; i++)
+		{
+			float fDiffX = pPositionsX[i] - positionPARAM.x;
+			float fDiffY = pPositionsY[i] - positionPARAM.y;
+			float fDiffZ = pPositionsZ[i] - positionPARAM.z;
+			if (fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ <= rangeSquaredPARAM)
+				entitiesPARAM.push_back(entities[i]);
+		}
 	}
 
-	void OctTreeNode::getNodesWithEntitiesWhichIntersect(std::vector<OctTreeNode*>& nodesPARAM, const AABB& aabbPARAM)
+	void OctTreeNode::getEntitiesWithinAABB(std::vector<OctTreeEntity*>& entitiesPARAM, const AABB& aabbPARAM) const
 	{
-		// If this node doesn't have any children, just check this node
-		if (!hasAnyChildNodes())
+		const float* pPositionsX = entityPositionsX.data();
+		const float* pPositionsY = entityPositionsY.data();
+		const float* pPositionsZ = entityPositionsZ.data();
+		unsigned int numEntities = entities.size();
+		Vector3f vMin = aabbPARAM.getMin();
+		Vector3f vMax = aabbPARAM.getMax();
+
+		// Test kSIMDWidth entities at a time
+		SIMDFloats vMinX = simdSet(vMin.x);
+		SIMDFloats vMinY = simdSet(vMin.y);
+		SIMDFloats vMinZ = simdSet(vMin.z);
+		SIMDFloats vMaxX = simdSet(vMax.x);
+		SIMDFloats vMaxY = simdSet(vMax.y);
+		SIMDFloats vMaxZ = simdSet(vMax.z);
+		unsigned int i = 0;
+		for (; i + kSIMDWidth <= numEntities; i += kSIMDWidth)
 		{
-			// If this node doesn't have any entities
-			if (0 == entities.size())
-				return;
-
-			// If the AABB interects with this node, add this node
-			if (region.getAABBintersects(aabbPARAM))
+			SIMDFloats vX = simdLoadUnaligned(pPositionsX + i);
+			SIMDFloats vY = simdLoadUnaligned(pPositionsY + i);
+			SIMDFloats vZ = simdLoadUnaligned(pPositionsZ + i);
+			SIMDInts vInside = simdAndInts(simdCompareGreaterOrEqual(vX, vMinX), simdCompareLessOrEqual(vX, vMaxX));
+			vInside = simdAndInts(vInside, simdAndInts(simdCompareGreaterOrEqual(vY, vMinY), simdCompareLessOrEqual(vY, vMaxY)));
+			vInside = simdAndInts(vInside, simdAndInts(simdCompareGreaterOrEqual(vZ, vMinZ), simdCompareLessOrEqual(vZ, vMaxZ)));
+			int mask = simdGetMask(vInside);
+			for (unsigned int j = 0; j < kSIMDWidth; j++)
 			{
-				nodesPARAM.push_back(this);
-				return;
+				if (mask & (1 << j))
+					entitiesPARAM.push_back(entities[i + j]);
 			}
 		}
-		else  // This node has children, check those
+
+		// Then test the remaining entities one at a time
+		for (; i < numEntities; i++)
 		{
-			for (int i = 0; i < 8; i++)
-			{
-				if (childNodes[i])
-					childNodes[i]->getNodesWithEntitiesWhichIntersect(nodesPARAM, aabbPARAM);
-			}
+			if (pPositionsX[i] >= vMin.x && pPositionsX[i] <= vMax.x &&
+				pPositionsY[i] >= vMin.y && pPositionsY[i] <= vMax.y &&
+				pPositionsZ[i] >= vMin.z && pPositionsZ[i] <= vMax.z)
+				entitiesPARAM.push_back(entities[i]);
 		}
 	}
 
-	void OctTreeNode::getNodesWithEntitiesWhichIntersect(std::vector<OctTreeNode*>& nodesPARAM, const Frustum& frustumPARAM)
+	void OctTreeNode::getEntityPairsWithinRange(std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairsPARAM, float rangePARAM) const
+	{
+		// Only test each entity against those after it, so that each pair is only added once
+		float fRangeSquared = rangePARAM * rangePARAM;
+		for (unsigned int i = 0; i < entities.size(); i++)
+			addEntityPairsWithinRange(pairsPARAM, i, *this, i + 1, fRangeSquared);
+	}
+
+	void OctTreeNode::getEntityPairsWithinRange(std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairsPARAM, const OctTreeNode& otherNodePARAM, float rangePARAM) const
 	{
-		// If this node doesn't have any children, just check this node
-		if (!hasAnyChildNodes())
+		float fRangeSquared = rangePARAM * rangePARAM;
+		Vector3f vMin = otherNodePARAM.looseRegion.getMin();
+		Vector3f vMax = otherNodePARAM.looseRegion.getMax();
+		vMin.x -= rangePARAM;
+		vMin.y -= rangePARAM;
+		vMin.z -= rangePARAM;
+		vMax.x += rangePARAM;
+		vMax.y += rangePARAM;
+		vMax.z += rangePARAM;
+		for (unsigned int i = 0; i < entities.size(); i++)
 		{
-			// If this node doesn't have any entities
-			if (0 == entities.size())
-				return;
+			if (entityPositionsX[i] < vMin.x || entityPositionsX[i] > vMax.x ||
+				entityPositionsY[i] < vMin.y || entityPositionsY[i] > vMax.y ||
+				entityPositionsZ[i] < vMin.z || entityPositionsZ[i] > vMax.z)
+				continue;
+			addEntityPairsWithinRange(pairsPARAM, i, otherNodePARAM, 0, fRangeSquared);
+		}
+	}
 
-			// If the AABB interects with this node, add this node
-			if (frustumPARAM.isAABBIntersecting(region))
-			{
-				nodesPARAM.push_back(this);
-				return;
-			}
+	void OctTreeNode::addEntity(OctTreeEntity* entityPARAM)
+	{
+		entityPARAM->indexInNode = entities.size();
+		entities.push_back(entityPARAM);
+		entityPositionsX.push_back(entityPARAM->position.x);
+		entityPositionsY.push_back(entityPARAM->position.y);
+		entityPositionsZ.push_back(entityPARAM->position.z);
+	}
+
+	void OctTreeNode::removeEntity(unsigned int indexPARAM)
+	{
+		entities.removeAndSwapWithLast(indexPARAM);
+		entityPositionsX.removeAndSwapWithLast(indexPARAM);
+		entityPositionsY.removeAndSwapWithLast(indexPARAM);
+		entityPositionsZ.removeAndSwapWithLast(indexPARAM);
+
+		// The last entity has been moved into the removed entity's place
+		if (indexPARAM < entities.size())
+			entities[indexPARAM]->indexInNode = indexPARAM;
+	}
+
+	void OctTreeNode::removeAllEntities(bool freeMemoryPARAM)
+	{
+		if (freeMemoryPARAM)
+		{
+			entities.freeMemory();
+			entityPositionsX.freeMemory();
+			entityPositionsY.freeMemory();
+			entityPositionsZ.freeMemory();
 		}
-		else  // This node has children, check those
+		else
 		{
-			for (int i = 0; i < 8; i++)
-			{
-				if (childNodes[i])
-					childNodes[i]->getNodesWithEntitiesWhichIntersect(nodesPARAM, frustumPARAM);
-			}
+			entities.clear();
+			entityPositionsX.clear();
+			entityPositionsY.clear();
+			entityPositionsZ.clear();
 		}
 	}
 
-	void OctTreeNode::getMaxNodeDepth(unsigned int& maxNodeDepthPARAM)
+	void OctTreeNode::updateEntityPosition(const OctTreeEntity* entityPARAM)
 	{
-		if (nodeDepth > maxNodeDepthPARAM)
-			maxNodeDepthPARAM = nodeDepth;
+		unsigned int index = entityPARAM->indexInNode;
+		ErrorIfTrue(index >= entities.size() || entities[index] != entityPARAM, L"OctTreeNode::updateEntityPosition() failed. The entity named " + entityPARAM->name + L" could not be found");
+		entityPositionsX[index] = entityPARAM->position.x;
+		entityPositionsY[index] = entityPARAM->position.y;
+		entityPositionsZ[index] = entityPARAM->position.z;
+	}
+	void OctTreeNode::addEntityPairsWithinRange(std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairsPARAM, unsigned int entityIndexPARAM, const OctTreeNode& otherNodePARAM, unsigned int firstOtherEntityPARAM, float rangeSquaredPARAM) const
+	{
+		OctTreeEntity* pEntity = entities[entityIndexPARAM];
+		float fPositionX = entityPositionsX[entityIndexPARAM];
+		float fPositionY = entityPositionsY[entityIndexPARAM];
+		float fPositionZ = entityPositionsZ[entityIndexPARAM];
+		const float* pPositionsX = otherNodePARAM.entityPositionsX.data();
+		const float* pPositionsY = otherNodePARAM.entityPositionsY.data();
+		const float* pPositionsZ = otherNodePARAM.entityPositionsZ.data();
+		unsigned int numEntities = otherNodePARAM.entities.size();
+
+		// Test kSIMDWidth entities at a time
+		SIMDFloats vPositionX = simdSet(fPositionX);
+		SIMDFloats vPositionY = simdSet(fPositionY);
+		SIMDFloats vPositionZ = simdSet(fPositionZ);
+		SIMDFloats vRangeSquared = simdSet(rangeSquaredPARAM);
+		unsigned int i = firstOtherEntityPARAM;
+		for (; i + kSIMDWidth <= numEntities; i += kSIMDWidth)
+		{
+			SIMDFloats vDiffX = simdSub(simdLoadUnaligned(pPositionsX + i), vPositionX);
+			SIMDFloats vDiffY = simdSub(simdLoadUnaligned(pPositionsY + i), vPositionY);
+			SIMDFloats vDiffZ = simdSub(simdLoadUnaligned(pPositionsZ + i), vPositionZ);
+			SIMDFloats vDistSquared = simdAdd(simdAdd(simdMul(vDiffX, vDiffX), simdMul(vDiffY, vDiffY)), simdMul(vDiffZ, vDiffZ));
+			int mask = simdGetLessOrEqualMask(vDistSquared, vRangeSquared);
+			for (unsigned int j = 0; j < kSIMDWidth; j++)
+			{
+				if (mask & (1 << j))
+					pairsPARAM.push_back(std::pair<OctTreeEntity*, OctTreeEntity*>(pEntity, otherNodePARAM.entities[i + j]));
+			}
+		}
 
-		// Call this method for all children of this node
-		for (int i = 0; i < 4; i++)
+		// Then test the remaining entities one at a time
+		for (; i < numEntities; i++)
 		{
-			if (childNodes[i])	// If child exists
-				childNodes[i]->getMaxNodeDepth(maxNodeDepthPARAM);
+			float fDiffX = pPositionsX[i] - fPositionX;
+			float fDiffY = pPositionsY[i] - fPositionY;
+			float fDiffZ = pPositionsZ[i] - fPositionZ;
+			if (fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ <= rangeSquaredPARAM)
+				pairsPARAM.push_back(std::pair<OctTreeEntity*, OctTreeEntity*>(pEntity, otherNodePARAM.entities[i]));
 		}
 	}
 }
\ No newline at end of file
@@ -1,14 +1,21 @@
 #pragma once
 #include "../Math/AABB.h"
 #include "octTreeEntity.h"
-#include "../Math/frustum.h"
-#include <map>
+#include "../Common/templateSmallArray.h"
+#include <utility>
+#include <vector>
 
 namespace DC
 {
 	class OctTree;
 
 	// A node used by the OctTree class
+	// Nodes are not allocated individually, they live inside of the OctTree's node pool and refer to
+	// their parent and child nodes by their index within that pool.
+	// The root node is always at index 0 and as the root node can never be a child of another node,
+	// a child node index of 0 means that there is no child node.
+	// Pointers to nodes returned by the OctTree are only valid until the tree is next modified, as
+	// adding nodes to the pool may move them in memory.
 	class OctTreeNode
 	{
 		friend class OctTree;
@@ -27,20 +34,19 @@ namespace DC
 			NONE
 		};
 
+		// Number of entities a node can hold before it's entity array is moved onto the heap.
+		// This matches the OctTree's default maximum number of entities per node.
+		static const unsigned int kInlineEntityCapacity = 10;
+
 		// Constructor.
 		// Sets up the node to represent the given region within the 3D world, with no child nodes.
-		// parentNode is a pointer to this node's parent node. However, if this node is to represent
-		// the root node, this will be 0.
-		OctTreeNode(const AABB& region, OctTreeNode* parentNode, OctTree* octTree);
-
-		// Destructor
-		// Removes all child nodes
-		// Although this obviously removes the entities from the nodes, because the nodes themselves
-		// no longer exist, this does NOT delete the entity pointers. They are stored in the OctTree's
-		// _mmapEntities hashmap.
-		~OctTreeNode();
-
-		
+		// parentNode is the index of this node's parent node within the OctTree's node pool.
+		// However, if this node is to represent the root node, this will be 0 and nodeDepth will be 0.
+		// octTree may be 0 for nodes which are being built on another thread by OctTree::buildFromPoints(), which
+		// sets it once the nodes have been added to the tree's node pool.
+		// looseFactor is the tree's loose factor, which the node's region is multiplied by to give it's loose region.
+		OctTreeNode(const AABB& region, unsigned int parentNode, unsigned int nodeDepth, OctTree* octTree, float looseFactor);
+
 		// Debug renders this node and it's child nodes', node boundaries
 		// line is the CResourceLine object which is being used to add vertices to be rendered
 		// vertex is the vertex object we're using to add vertices using the pLine object.
@@ -61,54 +67,100 @@ namespace DC
 		// Returns whether this node and all it's children have any entities within
 		bool hasEntitiesInThisAndAllChildren(void) const;
 
-		// Creates the specified child node
-		// If the node already exists, this does nothing.
-		void createChildNode(ChildNode childNode);
-
 		// Calculates and returns a child's region.
 		AABB computeChildNodeRegion(ChildNode childNode) const;
 
-		// Adds an entity into this node, or it's children
-		void addEntity(OctTreeEntity* entity);
-
-		// Removes an entity from this node
-		// If the entity couldn't be found, an exception occurs
-		void removeEntity(OctTreeEntity* entity);
+		// Returns which of the eight child nodes the given position would be inside of.
+		// If the position is outside of this node's region, NONE is returned.
+		ChildNode computeChildNodeForPosition(const Vector3f& position) const;
 
 		// Adds nodes to a vector of COctTreeNodes which have entities in them
-		void getNodesWithEntities(std::vector<OctTreeNode*>& nodes);
+		void getNodesWithEntities(std::vector<const OctTreeNode*>& nodes) const;
 
-		// Adds nodes to a vector of COctTreeNodes which intersect with the given AABB and have entities
-		void getNodesWithEntitiesWhichIntersect(std::vector<OctTreeNode*>& nodes, const AABB& aabb);
+		// Go through all children and if their depth is greater, increases given uiMaxNodeDepth
+		void getMaxNodeDepth(unsigned int& maxNodeDepth) const;
 
-		// Adds nodes to a vector of COctTreeNodes which intersect with the given Frustum and have entities
-		void getNodesWithEntitiesWhichIntersect(std::vector<OctTreeNode*>& nodes, const Frustum& frustum);
+		// Returns the region which this node covers
+		const AABB& getRegion(void) const;
 
-		// Go through all children and if their depth is greater, increases given uiMaxNodeDepth
-		void getMaxNodeDepth(unsigned int& maxNodeDepth);
+		// Returns the loose region of this node, which the positions of the node's entities are inside of.
+		// This is the same as the node's region, unless the OctTree was initialised with a loose factor greater
+		// than 1, in which case it is the node's region enlarged about it's centre by the loose factor.
+		const AABB& getLooseRegion(void) const;
+
+		// Returns the number of entities stored directly within this node
+		unsigned int getNumEntities(void) const;
+
+		// Adds the entities stored directly within this node which are within range of the given position to the
+		// given vector. rangeSquared is the range multiplied by itself.
+		// Unlike the methods above, each entity's position is tested, kSIMDWidth entities at a time.
+		void getEntitiesWithinRange(std::vector<OctTreeEntity*>& entities, const Vector3f& position, float rangeSquared) const;
+
+		// Adds the entities stored directly within this node whose positions are inside of the given AABB to the
+		// given vector, testing kSIMDWidth entities at a time.
+		void getEntitiesWithinAABB(std::vector<OctTreeEntity*>& entities, const AABB& aabb) const;
+
+		// Adds each pair of the entities stored directly within this node which are within range of each other to
+		// the given vector, testing kSIMDWidth entities at a time.
+		void getEntityPairsWithinRange(std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairs, float range) const;
+
+		// Adds each pair made up of an entity stored directly within this node and an entity stored directly within
+		// the given other node, which are within range of each other, to the given vector.
+		// Only the entities of this node which are within range of the other node's loose region are tested against
+		// the other node's entities, which is usually only the few which are near to the boundary between them.
+		void getEntityPairsWithinRange(std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairs, const OctTreeNode& otherNode, float range) const;
 	private:
 		// Holds the region which this node covers
 		// Must be a multiple of 2, otherwise child nodes' regions will not cover all space.
 		AABB region;
 
-		// Pointer to the parent of this node. May be 0 if this is the root node
-		OctTreeNode* parentNode;
+		// Holds the loose region of this node, see getLooseRegion()
+		AABB looseRegion;
+
+		// Index of the parent of this node within the OctTree's node pool. 0 if this is the root node
+		unsigned int parentNode;
 
-		// Pointer to the eight possible child nodes.
-		// A pointer may be 0 for no child node allocated yet.
+		// Indicies of the eight possible child nodes within the OctTree's node pool.
+		// An index may be 0 for no child node allocated yet.
 		// Use the ChildNode enum with this array to access the correct child node.
-		OctTreeNode* childNodes[8];
+		unsigned int childNodes[8];
 
-		// The quad tree which owns this node, this is passed to the constructor
+		// The oct tree which owns this node, this is passed to the constructor
 		OctTree* octTree;
 
 		// Depth of this node.
 		// How many nodes there are above this node.
 		unsigned int nodeDepth;
 
-		// Hashmap holding pointers to each of the added entities, until
-		// this node has children, in which case this would be empty as 
-		// the child nodes now own the entities (or their siblings)
-		mutable std::map<std::wstring, OctTreeEntity*> entities;
+		// Pointers to each of the added entities, until this node has children, in which
+		// case this would be empty as the child nodes now own the entities (or their siblings), except for
+		// any entities of a loose tree whose radius is too large for them to go into any of the child nodes
+		SmallArray<OctTreeEntity*, kInlineEntityCapacity> entities;
+
+		// The position of each of the entities along each axis, in the same order as the entities array.
+		// These are stored seperately from the entities so that the exact queries can test several entities at
+		// once with SIMD instructions, without having to follow each entity pointer.
+		SmallArray<float, kInlineEntityCapacity> entityPositionsX;
+		SmallArray<float, kInlineEntityCapacity> entityPositionsY;
+		SmallArray<float, kInlineEntityCapacity> entityPositionsZ;
+
+		// Adds the given entity to the end of this node's entities, along with it's position, and sets the entity's indexInNode
+		void addEntity(OctTreeEntity* entity);
+
+		// Removes the entity at the given index by replacing it with the last entity, along with it's position, and updates
+		// the indexInNode of the entity which was moved
+		void removeEntity(unsigned int index);
+
+		// Removes all of this node's entities.
+		// If freeMemory is true, any heap memory used to store them is also freed.
+		void removeAllEntities(bool freeMemory);
+
+		// Copies the position of the given entity, which must be stored within this node, into entityPositionsX/Y/Z
+		// This must be called whenever the entity's position changes while it stays within this node.
+		void updateEntityPosition(const OctTreeEntity* entity);
+
+		// Adds each pair made up of the entity at entityIndex within this node and one of the entities within the
+		// given other node, starting at firstOtherEntity, which are within range of each other, to the given vector.
+		void addEntityPairsWithinRange(std::vector<std::pair<OctTreeEntity*, OctTreeEntity*>>& pairs, unsigned int entityIndex, const OctTreeNode& otherNode, unsigned int firstOtherEntity, float rangeSquared) const;
 	};
-}
+}
\ No newline at end of file
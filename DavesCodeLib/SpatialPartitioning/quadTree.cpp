@@ -1,12 +1,14 @@
 #include "quadTree.h"
 #include "../Common/error.h"
+#include "../Math/mathUtilities.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 namespace DC
 {
 	QuadTree::QuadTree(int maxEntitiesPerNodePARAM, int rectSizeIncreaseMultiplierPARAM)
 	{
-		rootNode = 0;
-
 		init(maxEntitiesPerNodePARAM, rectSizeIncreaseMultiplierPARAM);
 	}
 
@@ -16,9 +18,8 @@ namespace DC
 
 		Rect rctInitialRootNodeRegion(-1024, -1024, 1024, 1024);
 
-		// Attempt to create root node, passing 0 as the pointer to the parent node
-		rootNode = new QuadTreeNode(rctInitialRootNodeRegion, 0, this);
-		ErrorIfFalse(rootNode, L"QuadTree::init() failed. Unable to allocate memory for root node.");
+		// Create root node
+		resetNodes(rctInitialRootNodeRegion);
 
 		// Make sure valid values were given
 		ErrorIfTrue(maxEntitiesPerNodePARAM < 1, L"QuadTree::init() failed. Given invalid number for iMaxEntitiesPerNode. Must be at least one.");
@@ -27,12 +28,7 @@ namespace DC
 		// Store settings
 		maxEntitiesPerNode = maxEntitiesPerNodePARAM;
 		rectSizeIncreaseMultiplier = rectSizeIncreaseMultiplierPARAM;
-
-		// Current maximum node depth
-		currentMaxNodeDepth = 0;
-
-		// Compute maximum node depth before node division is forbidden.
-		computeMaxNodeDepth();
+		nodeCollapseThreshold = (unsigned int)maxEntitiesPerNodePARAM / 2;
 	}
 
 	QuadTree::~QuadTree()
@@ -42,24 +38,23 @@ namespace DC
 
 	void QuadTree::free(void)
 	{
-		// Delete root node, which will delete all children and their children and so on.
+		// Free the node pool, which holds the root node and all children and their children and so on.
 		// Although this obviously removes the entities from the nodes, because the nodes themselves
 		// no longer exist, this does NOT delete the entity pointers. They are stored in this object's
-		// _mmapEntities hashmap.
-		if (rootNode)
-		{
-			delete rootNode;
-			rootNode = 0;
-		}
+		// entitySlots array.
+		std::vector<QuadTreeNode>().swap(nodes);
+		std::vector<unsigned int>().swap(freeNodes);
 
 		// Delete all entities
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.begin();
-		while (it != entities.end())
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
 		{
-			delete it->second;
-			it++;
+			if (entitySlots[ui].entity)
+				delete entitySlots[ui].entity;
 		}
-		entities.clear();
+		std::vector<EntitySlot>().swap(entitySlots);
+		std::vector<unsigned int>().swap(freeEntitySlots);
+		numRetiredEntitySlots = 0;
+		entityNames.clear();
 	}
 /*
 	void QuadTree::debugRender(const Vector3f& cameraPosition, bool renderNodes, bool renderEntities, int entityCircleRadius, unsigned int entityCircleNumSegments) const
@@ -126,207 +121,363 @@ namespace DC
 	void QuadTree::debugSetEntityColour(const std::wstring& namePARAM, Colour& colourPARAM)
 	{
 		// Find the entity
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(entities.end() == it, L"QuadTree::debugSetEntityColour() failed. The entity name of " + namePARAM + L" doesn't exist.");
-		it->second->debugColour = colourPARAM;
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"QuadTree::debugSetEntityColour() failed. The entity name of " + namePARAM + L" doesn't exist.");
+		findEntity(it->second)->debugColour = colourPARAM;
+	}
+
+	void QuadTree::debugSetEntityColour(SpatialEntityHandle handlePARAM, Colour& colourPARAM)
+	{
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"QuadTree::debugSetEntityColour() failed. The given entity handle is invalid.");
+		pEntity->debugColour = colourPARAM;
 	}
 
 	void QuadTree::debugSetAllEntitiesColour(Colour& colourPARAM)
 	{
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.begin();
-		while (it != entities.end())
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
 		{
-			it->second->debugColour = colourPARAM;
-			it++;
+			if (entitySlots[ui].entity)
+				entitySlots[ui].entity->debugColour = colourPARAM;
 		}
 	}
 
-	void QuadTree::addEntity(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM, int userDataPARAM, void* pUserDataPARAM)
+	SpatialEntityHandle QuadTree::addEntity(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM, int userDataPARAM, void* pUserDataPARAM)
 	{
 		// Make sure the entity doesn't already exist by checking the hashmap
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(entities.end() != it, L"QuadTree::addEntity() failed. The entity name of " + namePARAM + L" already exists.");
-
-		// Create new entity, setting it's owner to 0
-		QuadTreeEntity* pEntity = new QuadTreeEntity(namePARAM, positionXPARAM, positionYPARAM, 0, userDataPARAM, pUserDataPARAM);
-		ErrorIfFalse(pEntity, L"QuadTree::addEntity() failed to allocate memory for new entity.");
-
-		// Add entity to hashmap for fast lookup
-		entities[namePARAM] = pEntity;
-
-		// Determine whether the given position of the entity fits in the root node
-		if (!rootNode->rectRegion.doesPositionFitWithin(positionXPARAM, positionYPARAM))
-		{
-			// The position of the new entity doesn't fit within the root node's area
-			// We're going to have to recreate the entire tree
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() != it, L"QuadTree::addEntity() failed. The entity name of " + namePARAM + L" already exists.");
 
-			// Delete root node, which will delete all children and their children and so on.
-			// This does not delete the entities (As they're stored in the _mmapEntities hashmap)
-			// But before deleting the root node, get it's currently set region which we will multiply to get
-			// the root node's new dimensions
-			Rect rectOldRootNodeRegion = rootNode->rectRegion;
-			delete rootNode;
-
-			// Inscrease the old root node's region size until the new entity's position fits within
-			bool bNewPositionFits = false;
-			while (!bNewPositionFits)
-			{
-				rectOldRootNodeRegion.resizeArea(rectSizeIncreaseMultiplier);
-				bNewPositionFits = rectOldRootNodeRegion.doesPositionFitWithin(positionXPARAM, positionYPARAM);
-			}
+		// Create new entity and add it's handle to the hashmap for lookup by name
+		QuadTreeEntity* pEntity = createEntity(namePARAM, positionXPARAM, positionYPARAM, userDataPARAM, pUserDataPARAM);
+		entityNames[namePARAM] = pEntity->handle;
 
-			// Now re-create the root node, passing 0 as the pointer to the parent node and the new region size
-			rootNode = new QuadTreeNode(rectOldRootNodeRegion, 0, this);
-			ErrorIfFalse(rootNode, L"QuadTree::addEntity() failed. Unable to allocate memory for new root node.");
+		insertEntityIntoTree(pEntity);
+		return pEntity->handle;
+	}
 
-			// Now re-insert all entities stored in the hash map back into the tree
-			// The new entity has already been added to the hash map, so no need to insert it seperately
-			it = entities.begin();
-			while (it != entities.end())
-			{
-				rootNode->addEntity(it->second);
-				it++;
-			}
-		}
-		else  // The entity position does fit inside the rect of this node, simply add it
-		{
-			rootNode->addEntity(pEntity);
-		}
+	SpatialEntityHandle QuadTree::addEntity(int positionXPARAM, int positionYPARAM, int userDataPARAM, void* pUserDataPARAM)
+	{
+		QuadTreeEntity* pEntity = createEntity(L"", positionXPARAM, positionYPARAM, userDataPARAM, pUserDataPARAM);
+		insertEntityIntoTree(pEntity);
+		return pEntity->handle;
 	}
 
 	void QuadTree::removeEntity(const std::wstring& namePARAM)
 	{
 		// Make sure the entity exists by checking the hashmap
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(entities.end() == it, L"QuadTree::removeEntity() failed. The entity name of " + namePARAM + L" doesn't exist.");
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"QuadTree::removeEntity() failed. The entity name of " + namePARAM + L" doesn't exist.");
 
-		// Get the node the entity is stored in to remove the entity from itself.
-		QuadTreeNode* pNodeContainingRemovedEntity = it->second->nodeOwner;
-		pNodeContainingRemovedEntity->removeEntity(it->second);
+		QuadTreeEntity* pEntity = findEntity(it->second);
+		entityNames.erase(it);
+		removeEntityFromTree(pEntity);
+		deleteEntity(pEntity);
+	}
 
-		// Remove the entity from the hashmap and delete it
-		QuadTreeEntity* pEntity = it->second;
-		entities.erase(it);
-		delete pEntity;
+	void QuadTree::removeEntity(SpatialEntityHandle handlePARAM)
+	{
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"QuadTree::removeEntity() failed. The given entity handle is invalid.");
 
-		// Now check to see if the node is now empty and if so, remove it
-		if (!pNodeContainingRemovedEntity->hasEntitiesInThisAndAllChildren())
-		{
-			// Is the node which held the removed entity, the root node
-			bool bNodeIsRoot = rootNode == pNodeContainingRemovedEntity;
+		// If the entity was given a name, remove that too
+		if (!pEntity->name.empty())
+			entityNames.erase(pEntity->name);
+		removeEntityFromTree(pEntity);
+		deleteEntity(pEntity);
+	}
 
-			if (!bNodeIsRoot)  // The node wasn't the root node and therefore pNodeParent will contain a valid pointer to it's parent node.
-			{
-				// Store pointer to the parent
-				QuadTreeNode* pNodeParent = pNodeContainingRemovedEntity->parentNode;
+	bool QuadTree::getEntityExists(const std::wstring& namePARAM) const
+	{
+		// Check the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		return(entityNames.end() != it);
+	}
 
-				// We're done, except...
-				// We need to traverse up to the root node and delete any NOW empty nodes, which may 
-				// have only existed to hold the now deleted node.
-				// We also have to remove any parent node's _mpChildNode[4] pointers if we delete a node.
-				while (pNodeParent)
-				{
-					// Go through each of the four possible child nodes of the parent
-					for (int i = 0; i < 4; i++)
-					{
-						if (pNodeParent->childNodes[i])	// There is a child at this array position
-						{
-							if (!pNodeParent->childNodes[i]->hasEntitiesInThisAndAllChildren())	// Node is empty
-							{
-								delete pNodeParent->childNodes[i];
-								pNodeParent->childNodes[i] = 0;
-							}
-						}
-					}
-					pNodeParent = pNodeParent->parentNode;
-				}
+	bool QuadTree::getEntityExists(SpatialEntityHandle handlePARAM) const
+	{
+		return findEntity(handlePARAM) != 0;
+	}
 
-				// This will delete the node and all it's children.
-				// No need to delete, as it's deleted above when deleting children.
-				// If we attempted to delete again, all hell breaks loose!
-//				delete pNodeContainingRemovedEntity;
-			}
-		}	
-		// The node which contained the entity has other entities, leave it alone.
+	SpatialEntityHandle QuadTree::getEntityHandle(const std::wstring& namePARAM) const
+	{
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"QuadTree::getEntityHandle() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		return it->second;
 	}
 
-	bool QuadTree::getEntityExists(const std::wstring& namePARAM) const
+	QuadTreeEntity* QuadTree::getEntity(SpatialEntityHandle handlePARAM) const
 	{
-		// Check the hashmap
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.find(namePARAM);
-		return(entities.end() != it);
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"QuadTree::getEntity() failed. The given entity handle is invalid.");
+		return pEntity;
 	}
 
 	void QuadTree::removeAllEntities(bool resetTreePARAM)
 	{
 		// Go through each entity, asking each node which it's in to remove itself
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.begin();
-		while (it != entities.end())
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
 		{
+			QuadTreeEntity* pEntity = entitySlots[ui].entity;
+			if (!pEntity)
+				continue;
+
 			// Get the node the entity is stored in to remove the entity from itself.
-			it->second->nodeOwner->removeEntity(it->second);
+			removeEntityFromNode(pEntity->nodeOwner, pEntity);
 
-			// Remove the entity from the hashmap and delete it
-			QuadTreeEntity* pEntity = it->second;
-			entities.erase(it);
-			delete pEntity;
-			it = entities.begin();
+			// Delete the entity and free it's slot
+			deleteEntity(pEntity);
 		}
+		entityNames.clear();
 
 		// Now all entities are removed and deleted, reset the tree if bResetTree desires it
 		if (resetTreePARAM)
 		{
 			// Get the root node's rect, so we can re-create it
-			Rect rectRootNode = rootNode->rectRegion;
-			delete rootNode;
-			rootNode = new QuadTreeNode(rectRootNode, 0, this);
+			Rect rectRootNode = nodes[0].rectRegion;
+			resetNodes(rectRootNode);
+		}
+	}
+
+	std::vector<SpatialEntityHandle> QuadTree::buildFromPoints(std::span<const int> positionsXPARAM, std::span<const int> positionsYPARAM, std::span<const int> userDataPARAM, unsigned int numThreadsPARAM)
+	{
+		ErrorIfTrue(positionsXPARAM.size() != positionsYPARAM.size(), L"QuadTree::buildFromPoints() failed. The number of X and Y positions given are not the same.");
+		ErrorIfTrue(userDataPARAM.size() && userDataPARAM.size() != positionsXPARAM.size(), L"QuadTree::buildFromPoints() failed. The number of userData values and positions given are not the same.");
+
+		// Remove all existing entities and nodes
+		removeAllEntities(true);
+		std::vector<SpatialEntityHandle> handles(positionsXPARAM.size(), kSpatialEntityHandleInvalid);
+		if (positionsXPARAM.empty())
+			return handles;
+
+		// Compute the rect covering all of the positions, then increase the root node's rect size until that
+		// rect fits within it, the same as would happen if the entities were added one at a time, but without
+		// rebuilding the tree each time.
+		int iMinX = positionsXPARAM[0];
+		int iMinY = positionsYPARAM[0];
+		int iMaxX = positionsXPARAM[0];
+		int iMaxY = positionsYPARAM[0];
+		for (size_t i = 1; i < positionsXPARAM.size(); i++)
+		{
+			iMinX = std::min(iMinX, positionsXPARAM[i]);
+			iMinY = std::min(iMinY, positionsYPARAM[i]);
+			iMaxX = std::max(iMaxX, positionsXPARAM[i]);
+			iMaxY = std::max(iMaxY, positionsYPARAM[i]);
+		}
+		Rect rectRootNodeRegion = nodes[0].rectRegion;
+		while (!rectRootNodeRegion.doesPositionFitWithin(iMinX, iMinY) || !rectRootNodeRegion.doesPositionFitWithin(iMaxX, iMaxY))
+			rectRootNodeRegion.resizeArea(rectSizeIncreaseMultiplier);
+		resetNodes(rectRootNodeRegion);
+
+		// Sort the positions by the Morton code of their position within the root node's rect, so that
+		// entities which are close together within the world are created next to each other in memory and
+		// are kept next to each other as they are sorted into the nodes below.
+		double dScaleX = 65535.0 / double((long long)rectRootNodeRegion.maxX - rectRootNodeRegion.minX);
+		double dScaleY = 65535.0 / double((long long)rectRootNodeRegion.maxY - rectRootNodeRegion.minY);
+		std::vector<std::pair<unsigned int, unsigned int>> mortonOrder(positionsXPARAM.size());
+		for (size_t i = 0; i < positionsXPARAM.size(); i++)
+		{
+			unsigned int x = (unsigned int)(double((long long)positionsXPARAM[i] - rectRootNodeRegion.minX) * dScaleX);
+			unsigned int y = (unsigned int)(double((long long)positionsYPARAM[i] - rectRootNodeRegion.minY) * dScaleY);
+			mortonOrder[i].first = mortonCode2D(x, y);
+			mortonOrder[i].second = (unsigned int)i;
+		}
+		sortMortonCodes(mortonOrder);
+
+		// Create the entities in Morton order
+		entitySlots.reserve(positionsXPARAM.size());
+		std::vector<QuadTreeEntity*> entities(positionsXPARAM.size());
+		for (size_t i = 0; i < mortonOrder.size(); i++)
+		{
+			unsigned int index = mortonOrder[i].second;
+			entities[i] = createEntity(L"", positionsXPARAM[index], positionsYPARAM[index], userDataPARAM.size() ? userDataPARAM[index] : 0, 0);
+			handles[index] = entities[i]->handle;
+		}
+		std::vector<std::pair<unsigned int, unsigned int>>().swap(mortonOrder);
+
+		// If all the entities fit inside of the root node, there's nothing more to do
+		std::vector<QuadTreeEntity*> scratch(entities.size());
+		if (entities.size() <= (size_t)maxEntitiesPerNode || 0 == maxNodeDepth)
+		{
+			buildNodes(nodes, 0, entities.data(), scratch.data(), entities.size());
+			return handles;
+		}
+
+		// Determine the number of threads to use
+		unsigned int numThreads = numThreadsPARAM;
+		if (0 == numThreads)
+			numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		// Split the tree into subtrees which can be built independently of each other.
+		// Begin with the root node's children, then keep splitting the subtree with the most entities into it's
+		// children until there are plenty of subtrees to share out between the threads.
+		std::vector<BuildTask> tasks;
+		size_t childCounts[4];
+		sortEntitiesByChildNode(nodes[0], entities.data(), scratch.data(), entities.size(), childCounts);
+		size_t firstEntity = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (childCounts[i])
+			{
+				BuildTask task;
+				task.parentNode = 0;
+				task.childNode = (QuadTreeNode::ChildNode)i;
+				task.firstEntity = firstEntity;
+				task.numEntities = childCounts[i];
+				tasks.push_back(std::move(task));
+			}
+			firstEntity += childCounts[i];
+		}
+		while (tasks.size() < (size_t)numThreads * 4)
+		{
+			// Find the subtree with the most entities which would still be split into child nodes
+			size_t largestTask = tasks.size();
+			for (size_t i = 0; i < tasks.size(); i++)
+			{
+				if (tasks[i].numEntities <= (size_t)maxEntitiesPerNode || nodes[tasks[i].parentNode].nodeDepth + 1 >= maxNodeDepth)
+					continue;
+				if (largestTask == tasks.size() || tasks[i].numEntities > tasks[largestTask].numEntities)
+					largestTask = i;
+			}
+			if (largestTask == tasks.size())
+				break;
 
-			// Reset current max node depth
-			currentMaxNodeDepth = 0;
+			// Create the subtree's root node within the tree and replace the subtree with a subtree for each of it's children
+			BuildTask task = std::move(tasks[largestTask]);
+			tasks[largestTask] = std::move(tasks.back());
+			tasks.pop_back();
+			unsigned int nodeIndex = createChildNode(task.parentNode, task.childNode);
+			sortEntitiesByChildNode(nodes[nodeIndex], entities.data() + task.firstEntity, scratch.data(), task.numEntities, childCounts);
+			firstEntity = task.firstEntity;
+			for (int i = 0; i < 4; i++)
+			{
+				if (childCounts[i])
+				{
+					BuildTask childTask;
+					childTask.parentNode = nodeIndex;
+					childTask.childNode = (QuadTreeNode::ChildNode)i;
+					childTask.firstEntity = firstEntity;
+					childTask.numEntities = childCounts[i];
+					tasks.push_back(std::move(childTask));
+				}
+				firstEntity += childCounts[i];
+			}
+		}
 
-			// Compute new maximum node depth
-			computeMaxNodeDepth();
+		// Create each subtree's root node within it's own node pool
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			const QuadTreeNode& parent = nodes[tasks[i].parentNode];
+			tasks[i].nodes.push_back(QuadTreeNode(parent.computeChildNodeRegion(tasks[i].childNode), 0, parent.nodeDepth + 1, 0));
 		}
+
+		// Build the subtrees, with each thread taking the next subtree which hasn't been built yet.
+		// Each subtree's entities and it's part of the scratch space do not overlap any other's, so the threads
+		// never touch the same memory.
+		std::atomic<size_t> nextTask(0);
+		auto buildTasks = [&]()
+		{
+			size_t taskIndex;
+			while ((taskIndex = nextTask.fetch_add(1)) < tasks.size())
+			{
+				BuildTask& task = tasks[taskIndex];
+				buildNodes(task.nodes, 0, entities.data() + task.firstEntity, scratch.data() + task.firstEntity, task.numEntities);
+			}
+		};
+		numThreads = (unsigned int)std::min((size_t)numThreads, tasks.size());
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < numThreads; i++)
+			threads.push_back(std::thread(buildTasks));
+		buildTasks();
+		for (size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+
+		// Add each subtree's nodes to the end of the tree's node pool, offsetting their indicies to match
+		size_t numNodes = nodes.size();
+		for (size_t i = 0; i < tasks.size(); i++)
+			numNodes += tasks[i].nodes.size();
+		nodes.reserve(numNodes);
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			BuildTask& task = tasks[i];
+			unsigned int offset = (unsigned int)nodes.size();
+			for (size_t j = 0; j < task.nodes.size(); j++)
+			{
+				QuadTreeNode& node = task.nodes[j];
+				node.quadTree = this;
+				node.parentNode = (0 == j) ? task.parentNode : node.parentNode + offset;
+				for (int k = 0; k < 4; k++)
+				{
+					if (node.childNodes[k])
+						node.childNodes[k] += offset;
+				}
+				for (unsigned int k = 0; k < node.entities.size(); k++)
+					node.entities[k]->nodeOwner = offset + (unsigned int)j;
+				if (node.nodeDepth > currentMaxNodeDepth)
+					currentMaxNodeDepth = node.nodeDepth;
+				nodes.push_back(std::move(node));
+			}
+			nodes[task.parentNode].childNodes[task.childNode] = offset;
+		}
+		return handles;
 	}
 
 	void QuadTree::setEntityPosition(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM)
 	{
 		// First make sure the named entity exists
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(it == entities.end(), L"QuadTree::setEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(it == entityNames.end(), L"QuadTree::setEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		setEntityPosition(it->second, positionXPARAM, positionYPARAM);
+	}
+
+	void QuadTree::setEntityPosition(SpatialEntityHandle handlePARAM, int positionXPARAM, int positionYPARAM)
+	{
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"QuadTree::setEntityPosition() failed. The given entity handle is invalid.");
 
 		// First check to see if the new entity position still fits within it's current node
 		// If it does, we simply update the position
-		if (it->second->nodeOwner->rectRegion.doesPositionFitWithin(positionXPARAM, positionYPARAM))
+		if (nodes[pEntity->nodeOwner].rectRegion.doesPositionFitWithin(positionXPARAM, positionYPARAM))
 		{
-			it->second->positionX = positionXPARAM;
-			it->second->positionY = positionYPARAM;
+			pEntity->positionX = positionXPARAM;
+			pEntity->positionY = positionYPARAM;
+			nodes[pEntity->nodeOwner].updateEntityPosition(pEntity);
 			return;
 		}
 
 		// If we get here, the new position doesn't fit within the entity's current node
 
 		// Remove the entity from the tree and then re-insert it
-		int iUserData = it->second->userData;
-		void* pUserData = it->second->pUserData;
-		removeEntity(namePARAM);
-		addEntity(namePARAM, positionXPARAM, positionYPARAM, iUserData, pUserData);
+		// The entity itself is kept, so it's handle remains valid.
+		removeEntityFromTree(pEntity);
+		pEntity->positionX = positionXPARAM;
+		pEntity->positionY = positionYPARAM;
+		insertEntityIntoTree(pEntity);
 	}
 
 	void QuadTree::getEntityPosition(const std::wstring& namePARAM, int& positionXPARAM, int& positionYPARAM) const
 	{
 		// First make sure the named entity exists
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.find(namePARAM);
-		ErrorIfTrue(it == entities.end(), L"QuadTree::getEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
-		positionXPARAM = it->second->positionX;
-		positionYPARAM = it->second->positionY;
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(it == entityNames.end(), L"QuadTree::getEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		QuadTreeEntity* pEntity = findEntity(it->second);
+		positionXPARAM = pEntity->positionX;
+		positionYPARAM = pEntity->positionY;
+	}
+
+	void QuadTree::getEntityPosition(SpatialEntityHandle handlePARAM, int& positionXPARAM, int& positionYPARAM) const
+	{
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"QuadTree::getEntityPosition() failed. The given entity handle is invalid.");
+		positionXPARAM = pEntity->positionX;
+		positionYPARAM = pEntity->positionY;
 	}
 
 	void QuadTree::computeMaxNodeDepth(void)
 	{
 		// Obtain smallest dimension of root node
-		int iDimOfRootX = rootNode->rectRegion.maxX - rootNode->rectRegion.minX;
-		int iDimOfRootY = rootNode->rectRegion.maxY - rootNode->rectRegion.minY;
+		int iDimOfRootX = nodes[0].rectRegion.maxX - nodes[0].rectRegion.minX;
+		int iDimOfRootY = nodes[0].rectRegion.maxY - nodes[0].rectRegion.minY;
 		int iSmallestDim = iDimOfRootX;
 		if (iDimOfRootY < iDimOfRootX)
 			iSmallestDim = iDimOfRootY;
@@ -342,18 +493,37 @@ namespace DC
 	std::vector<QuadTreeNode*> QuadTree::getNodesWithEntities(void) const
 	{
 		std::vector<QuadTreeNode*> vResult;
-		rootNode->getNodesWithEntities(vResult);
+		nodes[0].getNodesWithEntities(vResult);
 		return vResult;
 	}
 
 	std::vector<QuadTreeNode*> QuadTree::getNodesWithEntitiesWhichIntersect(const Rect& rectPARAM) const
 	{
 		std::vector<QuadTreeNode*> vResult;
-		rootNode->getNodesWithEntitiesWhichIntersect(vResult, rectPARAM);
+		getNodesWithEntitiesWhichIntersect(rectPARAM, vResult);
 		return vResult;
 	}
 
 	std::vector<QuadTreeEntity*> QuadTree::getEntitiesWithinRange(int positionXPARAM, int positionYPARAM, int rangePARAM) const
+	{
+		std::vector<QuadTreeEntity*> vResult;
+		getEntitiesWithinRange(positionXPARAM, positionYPARAM, rangePARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<QuadTreeEntity*> QuadTree::getEntitiesWithinRect(const Rect& rectPARAM) const
+	{
+		std::vector<QuadTreeEntity*> vResult;
+		getEntitiesWithinRect(rectPARAM, vResult);
+		return vResult;
+	}
+
+	void QuadTree::getNodesWithEntitiesWhichIntersect(const Rect& rectPARAM, std::vector<QuadTreeNode*>& nodesOutPARAM) const
+	{
+		visitNodesWithEntitiesWhichIntersect(rectPARAM, [&nodesOutPARAM](QuadTreeNode* node) { nodesOutPARAM.push_back(node); });
+	}
+
+	void QuadTree::getEntitiesWithinRange(int positionXPARAM, int positionYPARAM, int rangePARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM) const
 	{
 		// Create a rect which covers the maximum range from the given position
 		Rect rectRange;
@@ -361,46 +531,119 @@ namespace DC
 		rectRange.maxX = positionXPARAM + rangePARAM;
 		rectRange.minY = positionYPARAM - rangePARAM;
 		rectRange.maxY = positionYPARAM + rangePARAM;
+		getEntitiesWithinRect(rectRange, entitiesOutPARAM);
+	}
 
-		// Go through the nodes and get a vector of nodes which intersect the rect and have entities in them
-		std::vector<QuadTreeNode*> vNodes = getNodesWithEntitiesWhichIntersect(rectRange);
-		std::vector<QuadTreeEntity*> vResult;
-		for (unsigned int ui = 0; ui < vNodes.size(); ui++)
-		{
-			// Go through each entity within each node and add them to the resulting vector
-			std::map<std::wstring, QuadTreeEntity*>::iterator it = vNodes[ui]->entities.begin();
-			while (it != vNodes[ui]->entities.end())
+	void QuadTree::getEntitiesWithinRect(const Rect& rectPARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM) const
+	{
+		// Go through the nodes which intersect the rect and have entities in them, adding each of their entities
+		visitNodesWithEntitiesWhichIntersect(rectPARAM, [&entitiesOutPARAM](QuadTreeNode* node)
 			{
-				vResult.push_back(it->second);
-				it++;
-			}
-		}
+				entitiesOutPARAM.insert(entitiesOutPARAM.end(), node->entities.begin(), node->entities.end());
+			});
+	}
+
+	std::vector<QuadTreeEntity*> QuadTree::getEntitiesWithinRangeExact(int positionXPARAM, int positionYPARAM, int rangePARAM, bool sortByDistancePARAM) const
+	{
+		std::vector<QuadTreeEntity*> vResult;
+		getEntitiesWithinRangeExact(positionXPARAM, positionYPARAM, rangePARAM, vResult, sortByDistancePARAM);
 		return vResult;
 	}
 
-	std::vector<QuadTreeEntity*> QuadTree::getEntitiesWithinRect(const Rect& rectPARAM) const
+	std::vector<QuadTreeEntity*> QuadTree::getEntitiesWithinRectExact(const Rect& rectPARAM) const
 	{
-		// Go through the nodes and get a vector of the nodes which intersect the rect and have entities in them
-		std::vector<QuadTreeNode*> vNodes = getNodesWithEntitiesWhichIntersect(rectPARAM);
 		std::vector<QuadTreeEntity*> vResult;
-		for (unsigned int ui = 0; ui < vNodes.size(); ui++)
-		{
-			// Go through each entity within each node and add them to the resulting vector
-			std::map<std::wstring, QuadTreeEntity*>::iterator it = vNodes[ui]->entities.begin();
-			while (it != vNodes[ui]->entities.end())
+		getEntitiesWithinRectExact(rectPARAM, vResult);
+		return vResult;
+	}
+
+	void QuadTree::getEntitiesWithinRangeExact(int positionXPARAM, int positionYPARAM, int rangePARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM, bool sortByDistancePARAM) const
+	{
+		// Create a rect which covers the maximum range from the given position
+		Rect rectRange;
+		rectRange.minX = positionXPARAM - rangePARAM;
+		rectRange.maxX = positionXPARAM + rangePARAM;
+		rectRange.minY = positionYPARAM - rangePARAM;
+		rectRange.maxY = positionYPARAM + rangePARAM;
+
+		// Go through the nodes which intersect the rect and have entities in them, adding each of their entities
+		// which are within range
+		size_t firstResult = entitiesOutPARAM.size();
+		visitNodesWithEntitiesWhichIntersect(rectRange, [&](QuadTreeNode* node)
 			{
-				vResult.push_back(it->second);
-				it++;
-			}
+				node->getEntitiesWithinRange(entitiesOutPARAM, positionXPARAM, positionYPARAM, rangePARAM);
+			});
+
+		// Sort the entities we've just added, leaving any which were already in the vector alone
+		if (sortByDistancePARAM)
+		{
+			std::sort(entitiesOutPARAM.begin() + firstResult, entitiesOutPARAM.end(), [positionXPARAM, positionYPARAM](const QuadTreeEntity* entityA, const QuadTreeEntity* entityB)
+				{
+					long long iDiffAX = (long long)entityA->positionX - positionXPARAM;
+					long long iDiffAY = (long long)entityA->positionY - positionYPARAM;
+					long long iDiffBX = (long long)entityB->positionX - positionXPARAM;
+					long long iDiffBY = (long long)entityB->positionY - positionYPARAM;
+					return iDiffAX * iDiffAX + iDiffAY * iDiffAY < iDiffBX * iDiffBX + iDiffBY * iDiffBY;
+				});
 		}
+	}
+
+	void QuadTree::getEntitiesWithinRectExact(const Rect& rectPARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM) const
+	{
+		// Go through the nodes which intersect the rect and have entities in them, adding each of their entities
+		// which are inside of the rect
+		visitNodesWithEntitiesWhichIntersect(rectPARAM, [&](QuadTreeNode* node)
+			{
+				node->getEntitiesWithinRect(entitiesOutPARAM, rectPARAM);
+			});
+	}
+
+	std::vector<QuadTreeEntity*> QuadTree::getNearestEntities(int positionXPARAM, int positionYPARAM, unsigned int kPARAM, int maxRangePARAM) const
+	{
+		std::vector<QuadTreeEntity*> vResult;
+		getNearestEntities(positionXPARAM, positionYPARAM, kPARAM, maxRangePARAM, vResult);
 		return vResult;
 	}
 
+	void QuadTree::getNearestEntities(int positionXPARAM, int positionYPARAM, unsigned int kPARAM, int maxRangePARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM) const
+	{
+		if (0 == kPARAM)
+			return;
+
+		// Search the tree, starting at the root node, keeping the nearest entities found as a max heap
+		size_t firstResult = entitiesOutPARAM.size();
+		long long iSearchDistanceSquared = (long long)maxRangePARAM * maxRangePARAM;
+		getNearestEntitiesInNode(0, positionXPARAM, positionYPARAM, kPARAM, firstResult, iSearchDistanceSquared, entitiesOutPARAM);
+
+		// Sort the heap so the entities go from the nearest to the furthest
+		std::sort_heap(entitiesOutPARAM.begin() + firstResult, entitiesOutPARAM.end(), [positionXPARAM, positionYPARAM](const QuadTreeEntity* entityA, const QuadTreeEntity* entityB)
+			{
+				long long iDiffAX = (long long)entityA->positionX - positionXPARAM;
+				long long iDiffAY = (long long)entityA->positionY - positionYPARAM;
+				long long iDiffBX = (long long)entityB->positionX - positionXPARAM;
+				long long iDiffBY = (long long)entityB->positionY - positionYPARAM;
+				return iDiffAX * iDiffAX + iDiffAY * iDiffAY < iDiffBX * iDiffBX + iDiffBY * iDiffBY;
+			});
+	}
+
+	std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>> QuadTree::getEntityPairsWithinRange(int rangePARAM) const
+	{
+		std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>> vResult;
+		getEntityPairsWithinRange(rangePARAM, vResult);
+		return vResult;
+	}
+
+	void QuadTree::getEntityPairsWithinRange(int rangePARAM, std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairsOutPARAM) const
+	{
+		ErrorIfTrue(rangePARAM < 0, L"QuadTree::getEntityPairsWithinRange() failed. The given range is negative.");
+		getEntityPairsWithinRangeInNode(0, rangePARAM, pairsOutPARAM);
+	}
+
 	unsigned int QuadTree::getNodeDepthCurrent(void)
 	{
 		// We have to recompute this, so go through all nodes, get their depth and compare
 		currentMaxNodeDepth = 0;
-		rootNode->getMaxNodeDepth(currentMaxNodeDepth);
+		nodes[0].getMaxNodeDepth(currentMaxNodeDepth);
 		return currentMaxNodeDepth;
 	}
 
@@ -409,4 +652,679 @@ namespace DC
 		return maxNodeDepth;
 	}
 
+	void QuadTree::setNodeCollapseThreshold(unsigned int thresholdPARAM)
+	{
+		ErrorIfTrue(thresholdPARAM >= (unsigned int)maxEntitiesPerNode, L"QuadTree::setNodeCollapseThreshold() failed. The threshold must be less than the maximum number of entities per node.");
+		nodeCollapseThreshold = thresholdPARAM;
+	}
+
+	unsigned int QuadTree::getNodeCollapseThreshold(void) const
+	{
+		return nodeCollapseThreshold;
+	}
+
+	void QuadTree::compact(void)
+	{
+		// Compute the new index of each node which is in use, in depth first order
+		std::vector<unsigned int> vNewIndicies(nodes.size(), 0);
+		std::vector<unsigned int> vOrder;
+		vOrder.reserve(nodes.size() - freeNodes.size());
+		std::vector<unsigned int> vStack;
+		vStack.push_back(0);
+		while (vStack.size())
+		{
+			unsigned int nodeIndex = vStack.back();
+			vStack.pop_back();
+			vNewIndicies[nodeIndex] = (unsigned int)vOrder.size();
+			vOrder.push_back(nodeIndex);
+
+			// Push the children in reverse, so that they are visited in the order of the ChildNode enum
+			for (int i = 3; i >= 0; i--)
+			{
+				if (nodes[nodeIndex].childNodes[i])
+					vStack.push_back(nodes[nodeIndex].childNodes[i]);
+			}
+		}
+
+		// Move the nodes into the new pool, updating the indicies they use to refer to each other and their entities
+		std::vector<QuadTreeNode> vNewNodes;
+		vNewNodes.reserve(vOrder.size());
+		for (size_t i = 0; i < vOrder.size(); i++)
+		{
+			QuadTreeNode& node = nodes[vOrder[i]];
+			node.parentNode = vNewIndicies[node.parentNode];
+			for (int j = 0; j < 4; j++)
+			{
+				if (node.childNodes[j])
+					node.childNodes[j] = vNewIndicies[node.childNodes[j]];
+			}
+			for (unsigned int j = 0; j < node.entities.size(); j++)
+				node.entities[j]->nodeOwner = (unsigned int)i;
+			vNewNodes.push_back(std::move(node));
+		}
+		nodes.swap(vNewNodes);
+		std::vector<unsigned int>().swap(freeNodes);
+	}
+
+	unsigned int QuadTree::getNumNodes(void) const
+	{
+		return (unsigned int)(nodes.size() - freeNodes.size());
+	}
+
+	unsigned int QuadTree::getNumEmptyNodes(void) const
+	{
+		unsigned int numEmptyNodes = 0;
+		std::vector<unsigned int> vStack;
+		vStack.push_back(0);
+		while (vStack.size())
+		{
+			const QuadTreeNode& node = nodes[vStack.back()];
+			vStack.pop_back();
+			if (!node.hasAnyChildNodes() && node.entities.empty())
+				numEmptyNodes++;
+			for (int i = 0; i < 4; i++)
+			{
+				if (node.childNodes[i])
+					vStack.push_back(node.childNodes[i]);
+			}
+		}
+		return numEmptyNodes;
+	}
+
+	unsigned int QuadTree::getNumFreeNodes(void) const
+	{
+		return (unsigned int)freeNodes.size();
+	}
+
+	size_t QuadTree::getMemoryUsage(void) const
+	{
+		size_t memoryUsage = sizeof(QuadTree);
+		memoryUsage += nodes.capacity() * sizeof(QuadTreeNode);
+		memoryUsage += freeNodes.capacity() * sizeof(unsigned int);
+		memoryUsage += entitySlots.capacity() * sizeof(EntitySlot);
+		memoryUsage += freeEntitySlots.capacity() * sizeof(unsigned int);
+		memoryUsage += entityNames.size() * sizeof(std::pair<const std::wstring, SpatialEntityHandle>);
+
+		// Add the memory used by the entities and by any nodes whose entities no longer fit in their inline arrays
+		memoryUsage += (entitySlots.size() - freeEntitySlots.size() - numRetiredEntitySlots) * sizeof(QuadTreeEntity);
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const QuadTreeNode& node = nodes[i];
+			if (node.entities.getIsOnHeap())
+				memoryUsage += node.entities.getCapacity() * sizeof(QuadTreeEntity*);
+			if (node.entityPositionsX.getIsOnHeap())
+				memoryUsage += node.entityPositionsX.getCapacity() * sizeof(int) * 2;
+		}
+		return memoryUsage;
+	}
+
+	void QuadTree::resetNodes(const Rect& rootNodeRegionPARAM)
+	{
+		// Empty the pool, keeping it's memory around for the new nodes
+		nodes.clear();
+		freeNodes.clear();
+
+		// Reset current max node depth
+		currentMaxNodeDepth = 0;
+
+		// Create the root node at index 0, with no parent
+		nodes.push_back(QuadTreeNode(rootNodeRegionPARAM, 0, 0, this));
+
+		// Compute the maximum node depth before node division is forbidden for the new root node's region.
+		// This is done here so that the tree is divided the same however the root node came to be resized.
+		computeMaxNodeDepth();
+	}
+
+	unsigned int QuadTree::createChildNode(unsigned int nodeIndexPARAM, QuadTreeNode::ChildNode childNodePARAM)
+	{
+		if (nodes[nodeIndexPARAM].childNodes[childNodePARAM])
+			return nodes[nodeIndexPARAM].childNodes[childNodePARAM];
+
+		// Compute region of the new child node
+		QuadTreeNode newNode(nodes[nodeIndexPARAM].computeChildNodeRegion(childNodePARAM), nodeIndexPARAM, nodes[nodeIndexPARAM].nodeDepth + 1, this);
+
+		// Use a previously freed node if there is one, otherwise add a new node to the end of the pool
+		unsigned int childNodeIndex;
+		if (freeNodes.size())
+		{
+			childNodeIndex = freeNodes.back();
+			freeNodes.pop_back();
+			nodes[childNodeIndex] = std::move(newNode);
+		}
+		else
+		{
+			childNodeIndex = (unsigned int)nodes.size();
+			nodes.push_back(std::move(newNode));
+		}
+		nodes[nodeIndexPARAM].childNodes[childNodePARAM] = childNodeIndex;
+		return childNodeIndex;
+	}
+
+	void QuadTree::freeNode(unsigned int nodeIndexPARAM)
+	{
+		QuadTreeNode& node = nodes[nodeIndexPARAM];
+
+		// Free each child node
+		// This will recursively free each child node's children
+		for (int i = 0; i < 4; i++)
+		{
+			if (node.childNodes[i])
+			{
+				freeNode(node.childNodes[i]);
+				node.childNodes[i] = 0;
+			}
+		}
+
+		// This does NOT delete the entity pointers. They are stored in the entitySlots array.
+		node.removeAllEntities(true);
+		freeNodes.push_back(nodeIndexPARAM);
+	}
+
+	void QuadTree::addEntityToNode(unsigned int nodeIndexPARAM, QuadTreeEntity* entityPARAM)
+	{
+		unsigned int nodeIndex = nodeIndexPARAM;
+		while (true)
+		{
+			QuadTreeNode& node = nodes[nodeIndex];
+
+			// If this node has no children, attempt to add the entity to this node
+			if (!node.hasAnyChildNodes())
+			{
+				// We haven't reached max capacity for this node
+				// OR we've reached maximum node depth with this node
+				if (node.entities.size() < (unsigned int)maxEntitiesPerNode ||
+					node.nodeDepth == maxNodeDepth)
+				{
+					// Add the entity to this node
+					// No need to check if the new entity name already exists, as QuadTree::addEntity() has already checked
+					node.addEntity(entityPARAM);
+					entityPARAM->nodeOwner = nodeIndex;	// Set node owner for the entity
+					return;
+				}
+				// If we've reached maximum capacity for this node and max node depth hasn't been reached
+				if (node.entities.size() == (unsigned int)maxEntitiesPerNode)
+				{
+					// We need to create child node/s then move all the entities from this node into the children, 
+					// as well as the new entity.
+					// Take the entities out of this node first, as creating child nodes may move this node in memory.
+					SmallArray<QuadTreeEntity*, QuadTreeNode::kInlineEntityCapacity + 1> entitiesToMove;
+					for (unsigned int i = 0; i < node.entities.size(); i++)
+						entitiesToMove.push_back(node.entities[i]);
+					entitiesToMove.push_back(entityPARAM);
+					node.removeAllEntities(false);
+
+					// Move all the entities from this node, into the child nodes
+					for (unsigned int i = 0; i < entitiesToMove.size(); i++)
+					{
+						// Determine which child node the entity fits in, regardless of whether the child node exists or not
+						QuadTreeEntity* pEntity = entitiesToMove[i];
+						QuadTreeNode::ChildNode childNode = nodes[nodeIndex].computeChildNodeForPosition(pEntity->positionX, pEntity->positionY);
+
+						// Error checking, making sure the entity could fit in one of the four possible children
+						ErrorIfTrue(QuadTreeNode::ChildNode::NONE == childNode, L"QuadTree::addEntityToNode() failed when trying to add entity " + pEntity->name + L" to any of the four child nodes as it's position doesn't fit inside any of them.");
+
+						// Create the child node if it doesn't exist and add the entity to it
+						addEntityToNode(createChildNode(nodeIndex, childNode), pEntity);
+					}
+					return;
+				}
+			}
+
+			// If we get here, then this node has children, so add the new entity to one of those...
+			// Determine which child node the entity fits in
+			QuadTreeNode::ChildNode childNode = node.computeChildNodeForPosition(entityPARAM->positionX, entityPARAM->positionY);
+
+			// Error checking, making sure the entity could fit in one of the four possible children
+			ErrorIfTrue(QuadTreeNode::ChildNode::NONE == childNode, L"QuadTree::addEntityToNode() failed when trying to add entity " + entityPARAM->name + L" to any of the four child nodes as it's position doesn't fit inside any of them.");
+
+			// Create the child node if it doesn't exist, then carry on down the tree with it
+			nodeIndex = createChildNode(nodeIndex, childNode);
+		}
+	}
+
+	void QuadTree::removeEntityFromNode(unsigned int nodeIndexPARAM, QuadTreeEntity* entityPARAM)
+	{
+		// The entity knows where it is within the node, so there's no need to search for it
+		QuadTreeNode& node = nodes[nodeIndexPARAM];
+		unsigned int index = entityPARAM->indexInNode;
+		ErrorIfTrue(index >= node.entities.size() || node.entities[index] != entityPARAM, L"QuadTree::removeEntityFromNode() failed. The entity named " + entityPARAM->name + L" could not be found");
+		node.removeEntity(index);
+		// No need to delete entity, the QuadTree::removeAllEntities() or QuadTree::deleteEntity() does this
+	}
+
+	QuadTreeEntity* QuadTree::findEntity(SpatialEntityHandle handlePARAM) const
+	{
+		unsigned int slotIndex = spatialEntityHandleGetIndex(handlePARAM);
+		if (slotIndex >= entitySlots.size())
+			return 0;
+		const EntitySlot& slot = entitySlots[slotIndex];
+		if (slot.generation != spatialEntityHandleGetGeneration(handlePARAM))
+			return 0;
+		return slot.entity;
+	}
+
+	QuadTreeEntity* QuadTree::createEntity(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM, int userDataPARAM, void* pUserDataPARAM)
+	{
+		// Use a previously freed slot if there is one, otherwise add a new slot
+		unsigned int slotIndex;
+		if (freeEntitySlots.size())
+		{
+			slotIndex = freeEntitySlots.back();
+			freeEntitySlots.pop_back();
+		}
+		else
+		{
+			ErrorIfTrue(entitySlots.size() >= kSpatialEntityHandleMaxSlots, L"QuadTree::createEntity() failed. The maximum number of entities has been reached.");
+			slotIndex = (unsigned int)entitySlots.size();
+			EntitySlot slot;
+			slot.entity = 0;
+			slot.generation = 0;
+			entitySlots.push_back(slot);
+		}
+		EntitySlot& slot = entitySlots[slotIndex];
+
+		// Create new entity, setting it's owner to 0
+		QuadTreeEntity* pEntity = new QuadTreeEntity(namePARAM, positionXPARAM, positionYPARAM, 0, spatialEntityHandleCreate(slotIndex, slot.generation), userDataPARAM, pUserDataPARAM);
+		ErrorIfFalse(pEntity, L"QuadTree::createEntity() failed to allocate memory for new entity.");
+		slot.entity = pEntity;
+		return pEntity;
+	}
+
+	void QuadTree::deleteEntity(QuadTreeEntity* entityPARAM)
+	{
+		// Increase the slot's generation so that any remaining handles to the entity become invalid.
+		// Once the generation no longer fits into a handle, the slot is retired instead of being reused.
+		EntitySlot& slot = entitySlots[spatialEntityHandleGetIndex(entityPARAM->handle)];
+		slot.entity = 0;
+		slot.generation++;
+		if (spatialEntityHandleGetSlotCanBeReused(slot.generation))
+			freeEntitySlots.push_back(spatialEntityHandleGetIndex(entityPARAM->handle));
+		else
+			numRetiredEntitySlots++;
+		delete entityPARAM;
+	}
+
+	void QuadTree::insertEntityIntoTree(QuadTreeEntity* entityPARAM)
+	{
+		// Determine whether the given position of the entity fits in the root node
+		if (!nodes[0].rectRegion.doesPositionFitWithin(entityPARAM->positionX, entityPARAM->positionY))
+		{
+			// The position of the new entity doesn't fit within the root node's area
+			// We're going to have to recreate the entire tree
+
+			// Get the root node's currently set region which we will multiply to get the root node's new dimensions
+			Rect rectOldRootNodeRegion = nodes[0].rectRegion;
+
+			// Inscrease the old root node's region size until the new entity's position fits within
+			bool bNewPositionFits = false;
+			while (!bNewPositionFits)
+			{
+				rectOldRootNodeRegion.resizeArea(rectSizeIncreaseMultiplier);
+				bNewPositionFits = rectOldRootNodeRegion.doesPositionFitWithin(entityPARAM->positionX, entityPARAM->positionY);
+			}
+
+			// Now empty the node pool and re-create the root node with the new region size.
+			// This does not delete the entities (As they're stored in the entitySlots array)
+			// and the pool's memory is kept for the new nodes.
+			resetNodes(rectOldRootNodeRegion);
+
+			// Now re-insert all entities stored in the slots back into the tree
+			// The new entity has already been given a slot, so no need to insert it seperately
+			for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+			{
+				if (entitySlots[ui].entity)
+					addEntityToNode(0, entitySlots[ui].entity);
+			}
+		}
+		else  // The entity position does fit inside the area of this node, simply add it
+		{
+			addEntityToNode(0, entityPARAM);
+		}
+	}
+
+	void QuadTree::removeEntityFromTree(QuadTreeEntity* entityPARAM)
+	{
+		// Get the node the entity is stored in to remove the entity from itself.
+		unsigned int nodeContainingRemovedEntity = entityPARAM->nodeOwner;
+		removeEntityFromNode(nodeContainingRemovedEntity, entityPARAM);
+
+		// Now check to see if the node is now empty and if so, remove it
+		if (!nodes[nodeContainingRemovedEntity].hasEntitiesInThisAndAllChildren())
+		{
+			// Is the node which held the removed entity, the root node
+			bool bNodeIsRoot = 0 == nodeContainingRemovedEntity;
+
+			if (!bNodeIsRoot)  // The node wasn't the root node and therefore nodeParent will contain a valid index of it's parent node.
+			{
+				// Store index of the parent
+				unsigned int nodeParent = nodes[nodeContainingRemovedEntity].parentNode;
+
+				// We're done, except...
+				// We need to traverse up to the root node and free any NOW empty nodes, which may 
+				// have only existed to hold the now freed node.
+				// We also have to remove any parent node's childNodes[4] indicies if we free a node.
+				while (true)
+				{
+					// Go through each of the four possible child nodes of the parent
+					QuadTreeNode& parent = nodes[nodeParent];
+					for (int i = 0; i < 4; i++)
+					{
+						if (parent.childNodes[i])	// There is a child at this array position
+						{
+							if (!nodes[parent.childNodes[i]].hasEntitiesInThisAndAllChildren())	// Node is empty
+							{
+								freeNode(parent.childNodes[i]);
+								parent.childNodes[i] = 0;
+							}
+						}
+					}
+
+					// Stop once we've dealt with the root node
+					if (0 == nodeParent)
+						break;
+					nodeParent = parent.parentNode;
+				}
+			}
+		}
+		// The node which contained the entity has other entities, leave it alone.
+
+		// Now that the node, or it's parents, hold fewer entities, they may need collapsing
+		collapseUnderfilledNodes(nodeContainingRemovedEntity);
+	}
+
+	void QuadTree::getNearestEntitiesInNode(unsigned int nodeIndexPARAM, int positionXPARAM, int positionYPARAM, unsigned int kPARAM, size_t firstResultPARAM, long long& searchDistanceSquaredPARAM, std::vector<QuadTreeEntity*>& nearestEntitiesPARAM) const
+	{
+		const QuadTreeNode& node = nodes[nodeIndexPARAM];
+		auto getDistanceSquared = [positionXPARAM, positionYPARAM](const QuadTreeEntity* entity)
+		{
+			long long iDiffX = (long long)entity->positionX - positionXPARAM;
+			long long iDiffY = (long long)entity->positionY - positionYPARAM;
+			return iDiffX * iDiffX + iDiffY * iDiffY;
+		};
+		auto isNearer = [&getDistanceSquared](const QuadTreeEntity* entityA, const QuadTreeEntity* entityB)
+		{
+			return getDistanceSquared(entityA) < getDistanceSquared(entityB);
+		};
+
+		// If this node has no children, test each of it's entities
+		if (!node.hasAnyChildNodes())
+		{
+			for (unsigned int i = 0; i < node.entities.size(); i++)
+			{
+				long long iDiffX = (long long)node.entityPositionsX[i] - positionXPARAM;
+				long long iDiffY = (long long)node.entityPositionsY[i] - positionYPARAM;
+				long long iDistanceSquared = iDiffX * iDiffX + iDiffY * iDiffY;
+				if (iDistanceSquared > searchDistanceSquaredPARAM)
+					continue;
+
+				// Once we've found k entities, replace the furthest of them
+				size_t numFound = nearestEntitiesPARAM.size() - firstResultPARAM;
+				if (numFound == kPARAM)
+				{
+					if (iDistanceSquared >= searchDistanceSquaredPARAM)
+						continue;
+					std::pop_heap(nearestEntitiesPARAM.begin() + firstResultPARAM, nearestEntitiesPARAM.end(), isNearer);
+					nearestEntitiesPARAM.pop_back();
+					numFound--;
+				}
+				nearestEntitiesPARAM.push_back(node.entities[i]);
+				std::push_heap(nearestEntitiesPARAM.begin() + firstResultPARAM, nearestEntitiesPARAM.end(), isNearer);
+
+				// Now we've found k entities, we only need to search as far as the furthest of them
+				if (numFound + 1 == kPARAM)
+					searchDistanceSquaredPARAM = getDistanceSquared(nearestEntitiesPARAM[firstResultPARAM]);
+			}
+			return;
+		}
+
+		// Compute the squared distance from the position to each of the child nodes' rects
+		unsigned int childNodes[4];
+		long long childDistancesSquared[4];
+		unsigned int numChildNodes = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (!node.childNodes[i])
+				continue;
+			const Rect& rect = nodes[node.childNodes[i]].rectRegion;
+			long long iDiffX = std::max(std::max((long long)rect.minX - positionXPARAM, (long long)positionXPARAM - rect.maxX), 0LL);
+			long long iDiffY = std::max(std::max((long long)rect.minY - positionYPARAM, (long long)positionYPARAM - rect.maxY), 0LL);
+			long long iDistanceSquared = iDiffX * iDiffX + iDiffY * iDiffY;
+
+			// Insert the child, keeping them sorted from the nearest to the furthest
+			unsigned int j = numChildNodes;
+			while (j > 0 && childDistancesSquared[j - 1] > iDistanceSquared)
+			{
+				childNodes[j] = childNodes[j - 1];
+				childDistancesSquared[j] = childDistancesSquared[j - 1];
+				j--;
+			}
+			childNodes[j] = node.childNodes[i];
+			childDistancesSquared[j] = iDistanceSquared;
+			numChildNodes++;
+		}
+
+		// Search the child nodes, nearest first, stopping once the rest are further away than the entities found
+		for (unsigned int i = 0; i < numChildNodes; i++)
+		{
+			if (childDistancesSquared[i] > searchDistanceSquaredPARAM)
+				break;
+			getNearestEntitiesInNode(childNodes[i], positionXPARAM, positionYPARAM, kPARAM, firstResultPARAM, searchDistanceSquaredPARAM, nearestEntitiesPARAM);
+		}
+	}
+
+	void QuadTree::getEntityPairsWithinRangeInNode(unsigned int nodeIndexPARAM, int rangePARAM, std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairsPARAM) const
+	{
+		const QuadTreeNode& node = nodes[nodeIndexPARAM];
+
+		// If this node has no children, test it's entities against each other
+		if (!node.hasAnyChildNodes())
+		{
+			node.getEntityPairsWithinRange(pairsPARAM, rangePARAM);
+			return;
+		}
+
+		// Otherwise, find the pairs within each child and then the pairs between each two of the children
+		for (int i = 0; i < 4; i++)
+		{
+			if (!node.childNodes[i])
+				continue;
+			getEntityPairsWithinRangeInNode(node.childNodes[i], rangePARAM, pairsPARAM);
+			for (int j = i + 1; j < 4; j++)
+			{
+				if (node.childNodes[j])
+					getEntityPairsWithinRangeBetweenNodes(node.childNodes[i], node.childNodes[j], rangePARAM, pairsPARAM);
+			}
+		}
+	}
+
+	void QuadTree::getEntityPairsWithinRangeBetweenNodes(unsigned int nodeIndexAPARAM, unsigned int nodeIndexBPARAM, int rangePARAM, std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairsPARAM) const
+	{
+		const QuadTreeNode& nodeA = nodes[nodeIndexAPARAM];
+		const QuadTreeNode& nodeB = nodes[nodeIndexBPARAM];
+		bool bHasChildrenA = nodeA.hasAnyChildNodes();
+		bool bHasChildrenB = nodeB.hasAnyChildNodes();
+
+		// If either node is a leaf without any entities, there are no pairs
+		if ((!bHasChildrenA && !nodeA.entities.size()) || (!bHasChildrenB && !nodeB.entities.size()))
+			return;
+
+		// If the nodes' regions are further apart than the range along either axis, none of their entities are
+		// within range of each other. This is done with 64 bit integers so that large regions don't overflow.
+		const Rect& rectA = nodeA.rectRegion;
+		const Rect& rectB = nodeB.rectRegion;
+		if ((long long)rectA.minX - rangePARAM > rectB.maxX || (long long)rectA.maxX + rangePARAM < rectB.minX ||
+			(long long)rectA.minY - rangePARAM > rectB.maxY || (long long)rectA.maxY + rangePARAM < rectB.minY)
+			return;
+
+		// If both nodes are leaves, test their entities against each other
+		if (!bHasChildrenA && !bHasChildrenB)
+		{
+			nodeA.getEntityPairsWithinRange(pairsPARAM, nodeB, rangePARAM);
+			return;
+		}
+
+		// Otherwise, descend into the children of the larger node, or of the one which has children
+		if (!bHasChildrenB || (bHasChildrenA && (long long)rectA.maxX - rectA.minX >= (long long)rectB.maxX - rectB.minX))
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				if (nodeA.childNodes[i])
+					getEntityPairsWithinRangeBetweenNodes(nodeA.childNodes[i], nodeIndexBPARAM, rangePARAM, pairsPARAM);
+			}
+		}
+		else
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				if (nodeB.childNodes[i])
+					getEntityPairsWithinRangeBetweenNodes(nodeIndexAPARAM, nodeB.childNodes[i], rangePARAM, pairsPARAM);
+			}
+		}
+	}
+
+	void QuadTree::buildNodes(std::vector<QuadTreeNode>& nodePoolPARAM, unsigned int nodeIndexPARAM, QuadTreeEntity** entitiesPARAM, QuadTreeEntity** scratchPARAM, size_t numEntitiesPARAM)
+	{
+		// If the entities fit inside of this node, or we've reached maximum node depth, add them to this node
+		if (numEntitiesPARAM <= (size_t)maxEntitiesPerNode || nodePoolPARAM[nodeIndexPARAM].nodeDepth >= maxNodeDepth)
+		{
+			QuadTreeNode& node = nodePoolPARAM[nodeIndexPARAM];
+			for (size_t i = 0; i < numEntitiesPARAM; i++)
+			{
+				node.addEntity(entitiesPARAM[i]);
+				entitiesPARAM[i]->nodeOwner = nodeIndexPARAM;
+			}
+			return;
+		}
+
+		// Otherwise, sort the entities into the child nodes they fit in, then create those child nodes and build them
+		size_t childCounts[4];
+		sortEntitiesByChildNode(nodePoolPARAM[nodeIndexPARAM], entitiesPARAM, scratchPARAM, numEntitiesPARAM, childCounts);
+		size_t firstEntity = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (!childCounts[i])
+				continue;
+
+			// Adding the child node may move this node in memory, so don't hold a reference to it
+			unsigned int childNodeIndex = (unsigned int)nodePoolPARAM.size();
+			const QuadTreeNode& node = nodePoolPARAM[nodeIndexPARAM];
+			QuadTreeNode childNode(node.computeChildNodeRegion((QuadTreeNode::ChildNode)i), nodeIndexPARAM, node.nodeDepth + 1, node.quadTree);
+			nodePoolPARAM.push_back(std::move(childNode));
+			nodePoolPARAM[nodeIndexPARAM].childNodes[i] = childNodeIndex;
+			buildNodes(nodePoolPARAM, childNodeIndex, entitiesPARAM + firstEntity, scratchPARAM + firstEntity, childCounts[i]);
+			firstEntity += childCounts[i];
+		}
+	}
+
+	void QuadTree::sortEntitiesByChildNode(const QuadTreeNode& nodePARAM, QuadTreeEntity** entitiesPARAM, QuadTreeEntity** scratchPARAM, size_t numEntitiesPARAM, size_t childCountsPARAM[4]) const
+	{
+		// Count the number of entities in each child node.
+		// The entities aren't in any node yet, so each entity's nodeOwner is used to remember it's child node.
+		for (int i = 0; i < 4; i++)
+			childCountsPARAM[i] = 0;
+		for (size_t i = 0; i < numEntitiesPARAM; i++)
+		{
+			QuadTreeNode::ChildNode childNode = nodePARAM.computeChildNodeForPosition(entitiesPARAM[i]->positionX, entitiesPARAM[i]->positionY);
+			ErrorIfTrue(QuadTreeNode::ChildNode::NONE == childNode, L"QuadTree::sortEntitiesByChildNode() failed as an entity's position doesn't fit inside any of the four child nodes.");
+			entitiesPARAM[i]->nodeOwner = childNode;
+			childCountsPARAM[childNode]++;
+		}
+
+		// Copy each entity into it's child node's place within the scratch space, then copy them all back
+		size_t childOffsets[4];
+		size_t offset = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			childOffsets[i] = offset;
+			offset += childCountsPARAM[i];
+		}
+		for (size_t i = 0; i < numEntitiesPARAM; i++)
+			scratchPARAM[childOffsets[entitiesPARAM[i]->nodeOwner]++] = entitiesPARAM[i];
+		memcpy(entitiesPARAM, scratchPARAM, sizeof(QuadTreeEntity*) * numEntitiesPARAM);
+	}
+
+	bool QuadTree::getNodeIsInUse(unsigned int nodeIndexPARAM) const
+	{
+		// The root node is always in use, other nodes are in use if their parent still refers to them
+		if (0 == nodeIndexPARAM)
+			return true;
+		const QuadTreeNode& parent = nodes[nodes[nodeIndexPARAM].parentNode];
+		for (int i = 0; i < 4; i++)
+		{
+			if (parent.childNodes[i] == nodeIndexPARAM)
+				return true;
+		}
+		return false;
+	}
+
+	void QuadTree::collapseUnderfilledNodes(unsigned int nodeIndexPARAM)
+	{
+		if (0 == nodeCollapseThreshold)
+			return;
+
+		// Find the nearest node, starting with the given one, which hasn't been freed
+		unsigned int nodeIndex = nodeIndexPARAM;
+		while (!getNodeIsInUse(nodeIndex))
+			nodeIndex = nodes[nodeIndex].parentNode;
+
+		while (true)
+		{
+			// Nodes without children have nothing to collapse
+			if (nodes[nodeIndex].hasAnyChildNodes())
+			{
+				// If this node holds too many entities, then so do all of it's parents
+				if (countEntitiesInNode(nodeIndex, nodeCollapseThreshold + 1) > nodeCollapseThreshold)
+					return;
+
+				// Move the entities of the child nodes into this node, then free the child nodes
+				QuadTreeNode& node = nodes[nodeIndex];
+				for (int i = 0; i < 4; i++)
+				{
+					if (node.childNodes[i])
+					{
+						moveEntitiesIntoNode(node.childNodes[i], nodeIndex);
+						freeNode(node.childNodes[i]);
+						node.childNodes[i] = 0;
+					}
+				}
+			}
+
+			// Stop once we've dealt with the root node
+			if (0 == nodeIndex)
+				return;
+			nodeIndex = nodes[nodeIndex].parentNode;
+		}
+	}
+
+	unsigned int QuadTree::countEntitiesInNode(unsigned int nodeIndexPARAM, unsigned int maxCountPARAM) const
+	{
+		const QuadTreeNode& node = nodes[nodeIndexPARAM];
+		unsigned int count = node.entities.size();
+		for (int i = 0; i < 4; i++)
+		{
+			if (count >= maxCountPARAM)
+				break;
+			if (node.childNodes[i])
+				count += countEntitiesInNode(node.childNodes[i], maxCountPARAM - count);
+		}
+		return count;
+	}
+
+	void QuadTree::moveEntitiesIntoNode(unsigned int nodeIndexPARAM, unsigned int toNodeIndexPARAM)
+	{
+		QuadTreeNode& node = nodes[nodeIndexPARAM];
+		QuadTreeNode& toNode = nodes[toNodeIndexPARAM];
+		for (unsigned int i = 0; i < node.entities.size(); i++)
+		{
+			toNode.addEntity(node.entities[i]);
+			node.entities[i]->nodeOwner = toNodeIndexPARAM;
+		}
+		node.removeAllEntities(false);
+		for (int i = 0; i < 4; i++)
+		{
+			if (node.childNodes[i])
+				moveEntitiesIntoNode(node.childNodes[i], toNodeIndexPARAM);
+		}
+	}
+
 }
\ No newline at end of file
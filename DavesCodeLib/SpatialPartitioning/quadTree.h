@@ -1,5 +1,8 @@
 #pragma once
 #include "quadTreeNode.h"
+#include <climits>
+#include <map>
+#include <span>
 
 namespace DC
 {
@@ -35,6 +38,17 @@ namespace DC
 	// creating the child nodes, their dims would be (1, 1) meaning half the region of the parent node would not
 	// be covered and make it so an entity within the uncovered area would not fit.
 	// The intial region is set to -1024, +1024 along each axis.
+	//
+	// The nodes of the tree are not allocated one at a time, they are stored in a contiguous pool owned by the
+	// tree and refer to each other by their 32-bit index within the pool. Nodes which are removed from the tree
+	// are placed into a free list and reused when new nodes are needed, so once a tree has grown to it's working
+	// size, moving entities around causes no memory allocations.
+	//
+	// Entities may be added either with a unique name, or without one. Either way, adding an entity returns a
+	// SpatialEntityHandle which can be used to move, query and remove the entity. The methods which accept a handle
+	// find the entity by indexing into an array, whereas the methods which accept a name have to search a
+	// hashmap of names first, so the handle methods should be preferred for anything which is called often, such
+	// as moving lots of entities each frame. The name based methods are there for tools and debugging.
 	class QuadTree
 	{
 		friend class QuadTreeNode;
@@ -79,35 +93,85 @@ namespace DC
 		// If the named entity doesn't exist, an exception occurs.
 		void debugSetEntityColour(const std::wstring& name, Colour& colour);
 
+		// For debug rendering, sets the rendered colour of the entity with the given handle
+		// If the handle is invalid, or the entity has been removed, an exception occurs.
+		void debugSetEntityColour(SpatialEntityHandle handle, Colour& colour);
+
 		// For debug rendering, sets all entities' rendered colour to the one given
 		void debugSetAllEntitiesColour(Colour& colour);
 
 		// Add entity to the quad tree.
 		// Each entity needs a unique name, if the name given already exists, an exception occurs.
 		// If the specified position is outside of the tree's region, the tree is rebuilt
-		void addEntity(const std::wstring& name, int positionX, int positionY, int userData = 0, void *pUserData = 0);
+		// Returns the handle of the new entity, which may be used instead of the name for faster access.
+		SpatialEntityHandle addEntity(const std::wstring& name, int positionX, int positionY, int userData = 0, void *pUserData = 0);
+
+		// Add an entity which has no name to the quad tree.
+		// If the specified position is outside of the tree's region, the tree is rebuilt
+		// Returns the handle of the new entity, which is used to refer to it from then on.
+		// Handles are only valid until the entity is removed, or the tree is freed or initialised again.
+		SpatialEntityHandle addEntity(int positionX, int positionY, int userData = 0, void* pUserData = 0);
 
 		// Removes the named entity from the tree.
 		// If the unique name doesn't exist, an exception occurs.
 		// To determine whether an entity exists, use getEntityExists()
 		void removeEntity(const std::wstring& name);
 
+		// Removes the entity with the given handle from the tree.
+		// If the handle is invalid, or the entity has already been removed, an exception occurs.
+		void removeEntity(SpatialEntityHandle handle);
+
 		// Returns whether the named entity exists or not
 		bool getEntityExists(const std::wstring& name) const;
 
+		// Returns whether the entity with the given handle exists or not
+		bool getEntityExists(SpatialEntityHandle handle) const;
+
+		// Returns the handle of the named entity
+		// If the named entity doesn't exist, an exception occurs
+		SpatialEntityHandle getEntityHandle(const std::wstring& name) const;
+
+		// Returns a pointer to the entity with the given handle
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		QuadTreeEntity* getEntity(SpatialEntityHandle handle) const;
+
 		// Removes all entities from the tree and depending upon the passed bool, resets the tree to contain
 		// just the root node.
 		void removeAllEntities(bool resetTree = false);
 
+		// Removes all entities from the tree, then adds an entity for each of the given positions and builds the
+		// tree's nodes from them in one go.
+		// This is much faster than calling addEntity() for each position, as the root node's region is computed up
+		// front, instead of the tree being rebuilt each time an entity is outside of it, and each node is created
+		// just once, instead of nodes being split again and again as the entities are added.
+		// The entities are sorted by their Morton code, so that entities which are close to each other within the
+		// world are close to each other in memory, then the nodes are built from the top down, with the subtrees
+		// being built in parallel.
+		// positionsX and positionsY must be the same size, holding the position of each entity along each axis.
+		// userData, if not empty, must be the same size as the positions and holds the userData value of each entity.
+		// numThreads is the number of threads to use, 0 uses as many as there are hardware threads.
+		// Returns the handles of the new entities, the handle at [i] being that of the entity at positionsX[i], positionsY[i].
+		// The new entities have no names.
+		std::vector<SpatialEntityHandle> buildFromPoints(std::span<const int> positionsX, std::span<const int> positionsY, std::span<const int> userData = std::span<const int>(), unsigned int numThreads = 0);
+
 		// Set an existing entity's position to the one given, moving to the correct node if needed.
 		// If the named entity doesn't exist, an exception occurs
 		void setEntityPosition(const std::wstring& name, int positionX, int positionY);
 
+		// Set the position of the entity with the given handle, moving it to the correct node if needed.
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		void setEntityPosition(SpatialEntityHandle handle, int positionX, int positionY);
+
 		// Sets the given ints to the named entity's position.
 		// If the named entity doesn't exist, an exception occurs
 		void getEntityPosition(const std::wstring& name, int &positionX, int &positionY) const;
 
+		// Sets the given ints to the position of the entity with the given handle.
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		void getEntityPosition(SpatialEntityHandle handle, int& positionX, int& positionY) const;
+
 		// Returns a vector of CQuadTreeNodes which holds all nodes which have entities in them
+		// The returned pointers are only valid until the tree is next modified, as the node pool may move in memory.
 		std::vector<QuadTreeNode*> getNodesWithEntities(void) const;
 
 		// Returns a vector of CQuadTreeNodes which holds all nodes which intersect with the given rect and have entities
@@ -116,22 +180,114 @@ namespace DC
 		// Returns a vector of entities which are within range of the given position.
 		// This may return some entities which are outside of the range, as the test to see
 		// whether the entities aren't in range isn't 100% accurate.
+		// To only get the entities which are within range, use getEntitiesWithinRangeExact()
 		std::vector<QuadTreeEntity*> getEntitiesWithinRange(int positionX, int positionY, int range) const;
 
 		// Returns a vector of entities which are within the given Rect
 		// This may return some entities which are outside of the range, as the test to see
 		// whether the entities aren't in range isn't 100% accurate.
+		// To only get the entities which are inside of the rect, use getEntitiesWithinRectExact()
 		std::vector<QuadTreeEntity*> getEntitiesWithinRect(const Rect& rect) const;
 
+		// Returns a vector of the entities which are within range of the given position.
+		// Unlike getEntitiesWithinRange(), the distance to each entity is tested, so only the entities which are
+		// within range are returned and there's no need for the caller to test them again.
+		// If sortByDistance is true, the entities are sorted from the nearest to the furthest.
+		std::vector<QuadTreeEntity*> getEntitiesWithinRangeExact(int positionX, int positionY, int range, bool sortByDistance = false) const;
+
+		// Returns a vector of the entities whose positions are inside of the given rect.
+		// Unlike getEntitiesWithinRect(), each entity's position is tested, so only the entities which are inside
+		// of the rect are returned.
+		std::vector<QuadTreeEntity*> getEntitiesWithinRectExact(const Rect& rect) const;
+
+		// Returns a vector of the k entities which are nearest to the given position, sorted from the nearest to
+		// the furthest. Entities further away than maxRange are ignored, so fewer than k entities may be returned.
+		// Nodes are visited nearest first and any node which is further away than the furthest of the k nearest
+		// entities found so far is skipped, along with all of it's children, so only a small part of the tree is
+		// searched, instead of having to query an ever growing range until enough entities have been found.
+		std::vector<QuadTreeEntity*> getNearestEntities(int positionX, int positionY, unsigned int k, int maxRange = INT_MAX) const;
+
+		// Returns each pair of entities whose positions are within range of each other, for use as the broad phase
+		// of collision detection.
+		// Calling getEntitiesWithinRangeExact() for every entity finds each pair twice and walks the tree once for
+		// each entity. Instead, this walks the tree once, testing the entities of each leaf node against each other
+		// and against those of any other leaf node whose region is within range of it's own, so each pair is only
+		// found once. The order of the pairs and of the two entities within each pair is undefined.
+		// If range is negative, an exception occurs.
+		std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>> getEntityPairsWithinRange(int range) const;
+
+		// The methods below are the same as the ones above which return a vector, except that they add the nodes
+		// or entities to the end of the given vector instead. The vector is not cleared first.
+		// Keeping the same vector around and clearing it before each call means that once it has grown large
+		// enough, performing a query doesn't allocate any memory.
+		void getNodesWithEntitiesWhichIntersect(const Rect& rect, std::vector<QuadTreeNode*>& nodesOut) const;
+		void getEntitiesWithinRange(int positionX, int positionY, int range, std::vector<QuadTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinRect(const Rect& rect, std::vector<QuadTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinRangeExact(int positionX, int positionY, int range, std::vector<QuadTreeEntity*>& entitiesOut, bool sortByDistance = false) const;
+		void getEntitiesWithinRectExact(const Rect& rect, std::vector<QuadTreeEntity*>& entitiesOut) const;
+		void getNearestEntities(int positionX, int positionY, unsigned int k, int maxRange, std::vector<QuadTreeEntity*>& entitiesOut) const;
+		void getEntityPairsWithinRange(int range, std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairsOut) const;
+
+		// The methods below call the given visitor for each node or entity which the above methods would have
+		// returned, instead of storing them in a vector, so they never allocate any memory.
+		// The visitor may be a lambda or any other callable object and is passed a QuadTreeNode* or a QuadTreeEntity*
+		// Example:
+		// quadTree.visitEntitiesWithinRange(x, y, 10, [&](QuadTreeEntity* entity) { numInRange++; });
+		// The tree must not be modified from within the visitor.
+		template <typename Visitor> void visitNodesWithEntitiesWhichIntersect(const Rect& rect, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinRange(int positionX, int positionY, int range, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinRect(const Rect& rect, Visitor&& visitor) const;
+
 		// Returns current node depth stat
 		unsigned int getNodeDepthCurrent(void);
 
 		// Returns current node depth stat
 		unsigned int getNodeDepthMax(void) const;
 
+		// Sets the number of entities which a node and all of it's children have to hold no more than, before the
+		// child nodes are freed and their entities moved back up into the node.
+		// This is checked whenever entities are removed from the tree or move into another node, so that parts of
+		// the tree which entities have moved away from don't remain split up into lots of nodes holding only a
+		// few entities.
+		// As a node is only split once it holds more than the maximum number of entities per node, keeping this
+		// below that number means that a node which has just been collapsed won't be split again as soon as another
+		// entity is added to it. By default, it is half of the maximum number of entities per node.
+		// A threshold of 0 disables collapsing, so that nodes are only freed once they are empty.
+		// If the threshold is not less than the maximum number of entities per node, an exception occurs.
+		void setNodeCollapseThreshold(unsigned int threshold);
+
+		// Returns the threshold set with setNodeCollapseThreshold()
+		unsigned int getNodeCollapseThreshold(void) const;
+
+		// Rebuilds the node pool so that it holds only the nodes which are in use by the tree, in depth first order,
+		// so that each node is followed by it's children and traversing the tree walks forwards through memory.
+		// Over time, as nodes are freed and reused, the nodes of the tree end up scattered around the pool and
+		// the pool stays as large as the tree has ever been, so this may be called once in a while, such as when
+		// loading a level, to improve the speed of the queries and free the unused memory.
+		// Any pointers to nodes are invalid afterwards.
+		void compact(void);
+
+		// Returns the number of nodes which are in use by the tree, including the root node
+		unsigned int getNumNodes(void) const;
+
+		// Returns the number of nodes which are in use by the tree which have no child nodes and no entities.
+		unsigned int getNumEmptyNodes(void) const;
+
+		// Returns the number of nodes within the node pool which have been freed and are waiting to be reused.
+		// compact() frees these.
+		unsigned int getNumFreeNodes(void) const;
+
+		// Returns the approximate number of bytes of memory used by the tree's node pool, entities and the arrays
+		// used to look them up, not including the memory used by the entities' names.
+		size_t getMemoryUsage(void) const;
+
 	private:
-		// Root node of the tree which holds all child nodes and their entities
-		QuadTreeNode* rootNode;
+		// Pool of nodes, the root node of the tree which holds all child nodes and their entities is always at index 0.
+		// Nodes refer to their parent and child nodes by their index within this pool.
+		mutable std::vector<QuadTreeNode> nodes;
+
+		// Indicies of nodes within the pool which are no longer used by the tree and can be reused
+		std::vector<unsigned int> freeNodes;
 
 		// Maximum number of entities able to be stored within a node before that node will
 		// be subdivided again into child nodes.
@@ -145,9 +301,30 @@ namespace DC
 		// Set during construction
 		int rectSizeIncreaseMultiplier;
 
-		// Hashmap holding pointers to each of the added entities
+		// Number of entities a node and all of it's children have to hold no more than, before the children are
+		// collapsed back into the node. See setNodeCollapseThreshold()
+		unsigned int nodeCollapseThreshold;
+
+		// A slot which holds an entity, the index of which is stored within the entity's handle
+		struct EntitySlot
+		{
+			QuadTreeEntity* entity;		// Pointer to the entity in this slot, or 0 if the slot is unused
+			unsigned int generation;	// Increased each time the slot's entity is removed, to invalidate old handles
+		};
+
+		// Slots holding pointers to each of the added entities, indexed by the entity handles.
 		// This is used for fast retrieval or removal of single entities
-		mutable std::map<std::wstring, QuadTreeEntity*> entities;
+		std::vector<EntitySlot> entitySlots;
+
+		// Indicies of slots within entitySlots which are no longer used and can be reused
+		std::vector<unsigned int> freeEntitySlots;
+
+		// Number of slots within entitySlots which have been retired, as their generation has run out
+		unsigned int numRetiredEntitySlots;
+
+		// Hashmap holding the handle of each of the named entities
+		// This is used by the name based methods to find an entity's handle
+		std::map<std::wstring, SpatialEntityHandle> entityNames;
 
 		// Holds the current maximum depth of the nodes.
 		// If there are no child nodes, this would be zero.
@@ -172,5 +349,153 @@ namespace DC
 		// and sets _muiMaxNodeDepth.
 		void computeMaxNodeDepth(void);
 
+		// Empties the node pool and creates a new root node covering the given region, then computes maxNodeDepth for it
+		void resetNodes(const Rect& rootNodeRegion);
+
+		// Creates the specified child node of the given node, taking a node from the free list if there is one.
+		// If the child node already exists, this does nothing.
+		// Returns the index of the child node.
+		// This may move the node pool in memory, so any references to nodes are invalid afterwards.
+		unsigned int createChildNode(unsigned int nodeIndex, QuadTreeNode::ChildNode childNode);
+
+		// Returns the given node and all of it's children to the free list
+		void freeNode(unsigned int nodeIndex);
+
+		// Adds an entity into the given node, or it's children
+		void addEntityToNode(unsigned int nodeIndex, QuadTreeEntity* entity);
+
+		// Removes an entity from the given node
+		// If the entity couldn't be found, an exception occurs
+		void removeEntityFromNode(unsigned int nodeIndex, QuadTreeEntity* entity);
+
+		// Returns a pointer to the entity with the given handle, or 0 if the handle is invalid or the entity has been removed
+		QuadTreeEntity* findEntity(SpatialEntityHandle handle) const;
+
+		// Creates a new entity and places it into a slot, but does not insert it into the tree's nodes
+		QuadTreeEntity* createEntity(const std::wstring& name, int positionX, int positionY, int userData, void* pUserData);
+
+		// Deletes the given entity and frees it's slot, increasing the slot's generation
+		// The entity must have already been removed from the tree's nodes
+		void deleteEntity(QuadTreeEntity* entity);
+
+		// Inserts an entity into the tree's nodes, rebuilding the tree if the entity's position is
+		// outside of the root node's region
+		void insertEntityIntoTree(QuadTreeEntity* entity);
+
+		// Removes an entity from the node it is in and frees any nodes which are now empty
+		void removeEntityFromTree(QuadTreeEntity* entity);
+
+		// Calls the given visitor for each node, starting at the given node and going down through it's children,
+		// which has no children, has entities and intersects with the given rect.
+		// Nodes which don't intersect the rect are skipped along with all of their children.
+		template <typename Visitor> void visitLeafNodesWhichIntersect(unsigned int nodeIndex, const Rect& rect, Visitor& visitor) const;
+
+		// Used by getNearestEntities() to search the given node and it's children, nearest child first.
+		// The entities found so far are stored from nearestEntities[firstResult] onwards as a max heap, so that the
+		// furthest of them can quickly be replaced by a nearer one once k have been found.
+		// searchDistanceSquared is the squared distance beyond which nodes and entities are ignored, which is
+		// reduced to the squared distance of the furthest entity found, once k have been found.
+		void getNearestEntitiesInNode(unsigned int nodeIndex, int positionX, int positionY, unsigned int k, size_t firstResult, long long& searchDistanceSquared, std::vector<QuadTreeEntity*>& nearestEntities) const;
+
+		// Used by getEntityPairsWithinRange() to add the pairs of entities within range of each other, which are both
+		// within the given node or it's children.
+		void getEntityPairsWithinRangeInNode(unsigned int nodeIndex, int range, std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairs) const;
+
+		// Used by getEntityPairsWithinRange() to add the pairs of entities within range of each other, where one is
+		// within the first node or it's children and the other is within the second node or it's children.
+		// Neither node may be a child of the other.
+		void getEntityPairsWithinRangeBetweenNodes(unsigned int nodeIndexA, unsigned int nodeIndexB, int range, std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairs) const;
+
+		// A subtree of the tree which buildFromPoints() builds on one of it's threads.
+		// Each subtree is built into it's own node pool which is then added to the end of the tree's node pool.
+		struct BuildTask
+		{
+			unsigned int parentNode;			// Index of the node within the tree's node pool which the subtree is a child of
+			QuadTreeNode::ChildNode childNode;	// Which of the parent node's children the subtree is
+			size_t firstEntity;					// Index of the subtree's first entity within the sorted entities
+			size_t numEntities;					// Number of entities within the subtree
+			std::vector<QuadTreeNode> nodes;	// Node pool the subtree is built into, with the subtree's root node at index 0
+		};
+
+		// Builds the given node of the given node pool and all of it's children, from the given entities.
+		// scratch must point to space for the same number of entity pointers, which is used when sorting the
+		// entities into the child nodes.
+		void buildNodes(std::vector<QuadTreeNode>& nodePool, unsigned int nodeIndex, QuadTreeEntity** entities, QuadTreeEntity** scratch, size_t numEntities);
+
+		// Sorts the given entities into the order of the child nodes of the given node which they fit inside of,
+		// keeping the existing order of the entities within each child node and sets childCounts to the number of
+		// entities within each of the four child nodes.
+		void sortEntitiesByChildNode(const QuadTreeNode& node, QuadTreeEntity** entities, QuadTreeEntity** scratch, size_t numEntities, size_t childCounts[4]) const;
+
+		// Returns whether the given node is in use by the tree, rather than having been freed.
+		bool getNodeIsInUse(unsigned int nodeIndex) const;
+
+		// Starting at the given node, which has just had entities taken out of it, goes up the tree and collapses
+		// the first node whose entities and those of it's children number no more than nodeCollapseThreshold,
+		// then carries on up the tree collapsing it's parents until a node holds too many entities.
+		// If the given node has been freed, this starts from the nearest of it's parents which hasn't been.
+		void collapseUnderfilledNodes(unsigned int nodeIndex);
+
+		// Returns the number of entities held by the given node and all of it's children, but stops counting once
+		// maxCount has been reached, so the value returned may be less than the total
+		unsigned int countEntitiesInNode(unsigned int nodeIndex, unsigned int maxCount) const;
+
+		// Moves the entities held by the given node and all of it's children into the node given by toNodeIndex
+		void moveEntitiesIntoNode(unsigned int nodeIndex, unsigned int toNodeIndex);
+
 	};
+
+	template <typename Visitor>
+	void QuadTree::visitNodesWithEntitiesWhichIntersect(const Rect& rectPARAM, Visitor&& visitorPARAM) const
+	{
+		visitLeafNodesWhichIntersect(0, rectPARAM, visitorPARAM);
+	}
+
+	template <typename Visitor>
+	void QuadTree::visitEntitiesWithinRange(int positionXPARAM, int positionYPARAM, int rangePARAM, Visitor&& visitorPARAM) const
+	{
+		// Create a rect which covers the maximum range from the given position
+		Rect rectRange;
+		rectRange.minX = positionXPARAM - rangePARAM;
+		rectRange.maxX = positionXPARAM + rangePARAM;
+		rectRange.minY = positionYPARAM - rangePARAM;
+		rectRange.maxY = positionYPARAM + rangePARAM;
+		visitEntitiesWithinRect(rectRange, visitorPARAM);
+	}
+
+	template <typename Visitor>
+	void QuadTree::visitEntitiesWithinRect(const Rect& rectPARAM, Visitor&& visitorPARAM) const
+	{
+		auto visitNode = [&visitorPARAM](QuadTreeNode* node)
+		{
+			for (unsigned int i = 0; i < node->entities.size(); i++)
+				visitorPARAM(node->entities[i]);
+		};
+		visitLeafNodesWhichIntersect(0, rectPARAM, visitNode);
+	}
+
+	template <typename Visitor>
+	void QuadTree::visitLeafNodesWhichIntersect(unsigned int nodeIndexPARAM, const Rect& rectPARAM, Visitor& visitorPARAM) const
+	{
+		QuadTreeNode& node = nodes[nodeIndexPARAM];
+
+		// If this node doesn't intersect, then none of it's children do either
+		if (!node.rectRegion.intersects(rectPARAM))
+			return;
+
+		// If this node doesn't have any children, visit it if it has entities
+		if (!node.hasAnyChildNodes())
+		{
+			if (node.entities.size())
+				visitorPARAM(&node);
+			return;
+		}
+
+		// This node has children, check those
+		for (int i = 0; i < 4; i++)
+		{
+			if (node.childNodes[i])
+				visitLeafNodesWhichIntersect(node.childNodes[i], rectPARAM, visitorPARAM);
+		}
+	}
 }
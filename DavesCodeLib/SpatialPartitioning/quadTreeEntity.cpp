@@ -3,12 +3,14 @@
 
 namespace DC
 {
-	QuadTreeEntity::QuadTreeEntity(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM, QuadTreeNode* nodeOwnerPARAM, int userDataPARAM, void* pUserDataPARAM)
+	QuadTreeEntity::QuadTreeEntity(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM, unsigned int nodeOwnerPARAM, SpatialEntityHandle handlePARAM, int userDataPARAM, void* pUserDataPARAM)
 	{
 		name = namePARAM;
 		positionX = positionXPARAM;
 		positionY = positionYPARAM;
 		nodeOwner = nodeOwnerPARAM;
+		indexInNode = 0;
+		handle = handlePARAM;
 
 		// Store user data
 		userData = userDataPARAM;
@@ -32,4 +34,9 @@ namespace DC
 	{
 		return name;
 	}
+
+	SpatialEntityHandle QuadTreeEntity::getHandle(void) const
+	{
+		return handle;
+	}
 }
\ No newline at end of file
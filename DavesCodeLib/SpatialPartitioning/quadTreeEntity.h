@@ -2,22 +2,24 @@
 #include "../Math/vector2f.h"
 #include "../Common/colour.h"
 #include "../Common/string.h"
+#include "spatialEntityHandle.h"
 
 namespace DC
 {
 	class QuadTreeNode;
 
-	// An entity which is assigned into a QuadTreeNode
-	// It contains it's unique name, it's position within the world and the node it belongs to.
+	// An entity which is assigned into a QuadTreeNode, or into a cell of a SpatialHashGrid2D
+	// It contains it's handle, it's optional unique name, it's position within the world and the node it belongs to.
 	class QuadTreeEntity
 	{
 		friend class QuadTree;
 		friend class QuadTreeNode;
+		friend class SpatialHashGrid2D;
 	public:
 		// Constructor.
-		// name is the unique name given to this entity.
+		// name is the unique name given to this entity, or an empty string if the entity was added by handle only.
 		// positionX and positionX are this entity's position within the world
-		QuadTreeEntity(const std::wstring& name, int positionX, int positionY, QuadTreeNode* nodeOwner, int userData = 0, void *pUserData = 0);
+		QuadTreeEntity(const std::wstring& name, int positionX, int positionY, unsigned int nodeOwner, SpatialEntityHandle handle, int userData = 0, void *pUserData = 0);
 
 		// Set the debug colour of the entity
 		void debugSetColour(Colour& colour);
@@ -28,6 +30,9 @@ namespace DC
 		// Returns name of the entity
 		std::wstring getName(void);
 
+		// Returns the handle of the entity, which was returned by the tree when the entity was added
+		SpatialEntityHandle getHandle(void) const;
+
 		// Below are members which may be set to store various information.
 		// They have nothing to do with the quad tree itself.
 		int userData;
@@ -37,7 +42,9 @@ namespace DC
 		std::wstring name;			// Unique name of this entity
 		int positionX;				// Position of this entity along X axis
 		int positionY;				// Position of this entity along Y axis
-		QuadTreeNode* nodeOwner;	// The node this entity is in
+		SpatialEntityHandle handle;	// Handle of this entity, used by the tree to find it quickly
+		unsigned int nodeOwner;		// Index of the node this entity is in, within the QuadTree's node pool, or of the cell within the SpatialHashGrid2D's cells
+		unsigned int indexInNode;	// Index of this entity within the entity arrays of the QuadTreeNode or SpatialHashGrid2D cell which it is in
 		Colour debugColour;			// The colour used when debug rendering this entity
 	};
 }
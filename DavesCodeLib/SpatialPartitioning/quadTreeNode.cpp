@@ -1,21 +1,18 @@
 #include "quadTreeNode.h"
 #include "quadTree.h"
 #include "../Common/error.h"
+#include "../Math/simd.h"
 
 namespace DC
 {
-	QuadTreeNode::QuadTreeNode(const Rect& rectRegionPARAM, QuadTreeNode* parentNodePARAM, QuadTree* quadTreePARAM)
+	QuadTreeNode::QuadTreeNode(const Rect& rectRegionPARAM, unsigned int parentNodePARAM, unsigned int nodeDepthPARAM, QuadTree* quadTreePARAM)
 	{
 		rectRegion = rectRegionPARAM;
 		parentNode = parentNodePARAM;
 		quadTree = quadTreePARAM;
-		// Is this the root node?
-		if (!parentNodePARAM)
-			nodeDepth = 0;
-		else
-			nodeDepth = parentNodePARAM->nodeDepth + 1;
+		nodeDepth = nodeDepthPARAM;
 
-		if (nodeDepth > quadTreePARAM->currentMaxNodeDepth)
+		if (quadTreePARAM && nodeDepth > quadTreePARAM->currentMaxNodeDepth)
 			quadTreePARAM->currentMaxNodeDepth = nodeDepth;
 
 		// No children yet
@@ -23,17 +20,6 @@ namespace DC
 			childNodes[i] = 0;
 	}
 
-	QuadTreeNode::~QuadTreeNode()
-	{
-		// Destroy each child node
-		// This will recursively call each child node's destructor
-		for (int i = 0; i < 4; i++)
-		{
-			// If child node exists
-			if (childNodes[i])
-				delete childNodes[i];
-		}
-	}
 /*
 	void QuadTreeNode::debugRenderNodes(CResourceVertexBufferLine* line, CResourceVertexBufferLine::Vertex& vertex, Colour colour) const
 	{
@@ -101,7 +87,7 @@ namespace DC
 */
 	bool QuadTreeNode::hasChildNode(ChildNode childNodePARAM) const
 	{
-		return childNodes[childNodePARAM];
+		return childNodes[childNodePARAM] != 0;
 	}
 
 	bool QuadTreeNode::hasAnyChildNodes(void) const
@@ -126,7 +112,7 @@ namespace DC
 			// If node exists
 			if (childNodes[i])
 			{
-				if (childNodes[i]->hasEntitiesInThisAndAllChildren())
+				if (quadTree->nodes[childNodes[i]].hasEntitiesInThisAndAllChildren())
 					return true;
 			}
 		}
@@ -135,18 +121,6 @@ namespace DC
 		return false;
 	}
 
-	void QuadTreeNode::createChildNode(ChildNode childNodePARAM)
-	{
-		if (hasChildNode(childNodePARAM))
-			return;
-
-		// Compute rect area of the new child node
-		Rect childNodeRect = computeChildNodeRegion(childNodePARAM);
-
-		childNodes[childNodePARAM] = new QuadTreeNode(childNodeRect, this, quadTree);
-		ErrorIfFalse(childNodes[childNodePARAM], L"QuadTreeNode::createChildNode() failed. Unable to allocate memory for the new child node.");
-	}
-
 	Rect QuadTreeNode::computeChildNodeRegion(ChildNode childNodePARAM) const
 	{
 		// Compute dimensions of new child node using the rect region of this parent node.
@@ -189,109 +163,30 @@ namespace DC
 		return childNodeRegion;
 	}
 
-	void QuadTreeNode::addEntity(QuadTreeEntity* entityPARAM)
+	QuadTreeNode::ChildNode QuadTreeNode::computeChildNodeForPosition(int positionX, int positionY) const
 	{
-		// If this node has no children, attempt to add the entity to this node
-		if (!hasAnyChildNodes())
+		// Compute where the child nodes' rects meet, in exactly the same way as computeChildNodeRegion() does
+		int iMiddleX = rectRegion.minX + (rectRegion.maxX - rectRegion.minX) / 2;
+		int iMiddleY = rectRegion.minY + (rectRegion.maxY - rectRegion.minY) / 2;
+
+		// The children are tested in the order of the ChildNode enum, bottom before top and left before right,
+		// and as the tests along each axis are independent, we can pick the side along each axis seperately.
+		// Positions upon the boundary between two children end up in the same child as they would if we were
+		// to test each of the four child rects in order.
+		int childNode = 0;
+		if (positionY < rectRegion.minY || positionY > iMiddleY)
 		{
-			// We haven't reached max capacity for this node
-			// OR we've reached maximum node depth with this node
-			if (entities.size() < quadTree->maxEntitiesPerNode ||
-				nodeDepth == quadTree->maxNodeDepth)
-			{
-				// Add the entity to this node
-				// No need to check if the new entity name already exists, as QuadTree::addEntity() has already checked
-				entities[entityPARAM->name] = entityPARAM;
-				entityPARAM->nodeOwner = this;	// Set node owner for the entity
-				return;
-			}
-			// If we've reached maximum capacity for this node and max node depth hasn't been reached
-			if (entities.size() == quadTree->maxEntitiesPerNode)
-			{
-				// We need to create child node/s then move all the entities from this node into the children, 
-				// as well as the new entity
-
-				// Compute potential child node rects
-				Rect rctBL = computeChildNodeRegion(ChildNode::BL);
-				Rect rctBR = computeChildNodeRegion(ChildNode::BR);
-				Rect rctTL = computeChildNodeRegion(ChildNode::TL);
-				Rect rctTR = computeChildNodeRegion(ChildNode::TR);
-
-				// Add the new entity to this node's entity map, so it'll be moved to the correct child node below
-				entities[entityPARAM->name] = entityPARAM;
-				entityPARAM->nodeOwner = this;	// Set node owner for the entity
-
-				// Move all the entities from this node, into the child nodes
-				std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.begin();
-				while (it != entities.end())
-				{
-					// Determine which child node the entity fits in, regardless of whether the child node exists or not
-					ChildNode childNode = ChildNode::NONE;
-					if (rctBL.doesPositionFitWithin(it->second->positionX, it->second->positionY))
-						childNode = ChildNode::BL;
-					else if (rctBR.doesPositionFitWithin(it->second->positionX, it->second->positionY))
-						childNode = ChildNode::BR;
-					else if (rctTL.doesPositionFitWithin(it->second->positionX, it->second->positionY))
-						childNode = ChildNode::TL;
-					else if (rctTR.doesPositionFitWithin(it->second->positionX, it->second->positionY))
-						childNode = ChildNode::TR;
-
-					// Error checking, making sure the entity could fit in one of the four possible children
-					ErrorIfTrue(ChildNode::NONE == childNode, L"QuadTreeNode::addEntity() failed when trying to add entity " + it->second->name + L" to any of the four child nodes as it's position doesn't fit inside any of them.");
-
-					// Create the child node if it doesn't exist
-					if (!childNodes[childNode])
-					{
-						childNodes[childNode] = new QuadTreeNode(computeChildNodeRegion(childNode), this, quadTree);
-						ErrorIfFalse(childNodes[childNode], L"QuadTreeNode::addEntity() failed when trying to add entity " + it->second->name + L" to any of the four child nodes as it was unable to allocate memory for the child node.");
-					}
-					childNodes[childNode]->addEntity(it->second);
-					it++;
-				}
-				// Remove all entities from this node as they are now stored in the children
-				entities.clear();
-				return;
-			}
+			if (positionY < iMiddleY || positionY > rectRegion.maxY)
+				return ChildNode::NONE;
+			childNode += 2;
 		}
-
-		// If we get here, then this node has children, so add the new entity to one of those...
-		// Determine which child node the entity fits in
-		// Compute potential child node rects
-		Rect rctBL = computeChildNodeRegion(ChildNode::BL);
-		Rect rctBR = computeChildNodeRegion(ChildNode::BR);
-		Rect rctTL = computeChildNodeRegion(ChildNode::TL);
-		Rect rctTR = computeChildNodeRegion(ChildNode::TR);
-
-		ChildNode childNode = ChildNode::NONE;
-		if (rctBL.doesPositionFitWithin(entityPARAM->positionX, entityPARAM->positionY))
-			childNode = ChildNode::BL;
-		else if (rctBR.doesPositionFitWithin(entityPARAM->positionX, entityPARAM->positionY))
-			childNode = ChildNode::BR;
-		else if (rctTL.doesPositionFitWithin(entityPARAM->positionX, entityPARAM->positionY))
-			childNode = ChildNode::TL;
-		else if (rctTR.doesPositionFitWithin(entityPARAM->positionX, entityPARAM->positionY))
-			childNode = ChildNode::TR;
-		// Error checking, making sure the entity could fit in one of the four possible children
-		ErrorIfTrue(ChildNode::NONE == childNode, L"QuadTreeNode::addEntity() failed when trying to add entity " + entityPARAM->name + L" to any of the four child nodes as it's position doesn't fit inside any of them.");
-
-		// Create the child node if it doesn't exist
-		if (!childNodes[childNode])
+		if (positionX < rectRegion.minX || positionX > iMiddleX)
 		{
-			childNodes[childNode] = new QuadTreeNode(computeChildNodeRegion(childNode), this, quadTree);
-			ErrorIfFalse(childNodes[childNode], L"QuadTreeNode::addEntity() failed when trying to add entity " + entityPARAM->name + L" to any of the four child nodes as it was unable to allocate memory for the child node.");
+			if (positionX < iMiddleX || positionX > rectRegion.maxX)
+				return ChildNode::NONE;
+			childNode += 1;
 		}
-
-		// Add the new entity
-		childNodes[childNode]->addEntity(entityPARAM);
-	}
-
-	void QuadTreeNode::removeEntity(QuadTreeEntity* entityPARAM)
-	{
-		// Attempt to find the entity
-		std::map<std::wstring, QuadTreeEntity*>::iterator it = entities.find(entityPARAM->name);
-		ErrorIfTrue(it == entities.end(), L"QuadTreeNode::removeEntity() failed. The entity named " + entityPARAM->name + L" could not be found");
-		entities.erase(it);
-		// No need to delete entity, the QuadTree::removeAllEntities() or QuadTree::removeEntity() does this
+		return ChildNode(childNode);
 	}
 
 	void QuadTreeNode::getNodesWithEntities(std::vector<QuadTreeNode*>& nodesPARAM)
@@ -312,47 +207,215 @@ namespace DC
 			for (int i = 0; i < 4; i++)
 			{
 				if (childNodes[i])
-					childNodes[i]->getNodesWithEntities(nodesPARAM);
+					quadTree->nodes[childNodes[i]].getNodesWithEntities(nodesPARAM);
 			}
 		}
 	}
 
-	void QuadTreeNode::getNodesWithEntitiesWhichIntersect(std::vector<QuadTreeNode*>& nodesPARAM, const Rect& rectPARAM)
+	void QuadTreeNode::getMaxNodeDepth(unsigned int& maxNodeDepthPARAM)
 	{
-		// If this node doesn't have any children, just check this node
-		if (!hasAnyChildNodes())
+		if (nodeDepth > maxNodeDepthPARAM)
+			maxNodeDepthPARAM = nodeDepth;
+
+		// Call this method for all children of this node
+		for (int i = 0; i < 4; i++)
 		{
-			// If this node doesn't have any entities
-			if (0 == entities.size())
-				return;
+			if (childNodes[i])	// If child exists
+				quadTree->nodes[childNodes[i]].getMaxNodeDepth(maxNodeDepthPARAM);
+		}
+	}
+
+	const Rect& QuadTreeNode::getRegion(void) const
+	{
+		return rectRegion;
+	}
 
-			// If the rect interects with this node, add this node
-			if (rectRegion.intersects(rectPARAM))
+	unsigned int QuadTreeNode::getNumEntities(void) const
+	{
+		return entities.size();
+	}
+
+	void QuadTreeNode::getEntitiesWithinRange(std::vector<QuadTreeEntity*>& entitiesPARAM, int positionXPARAM, int positionYPARAM, int rangePARAM) const
+	{
+		const int* pPositionsX = entityPositionsX.data();
+		const int* pPositionsY = entityPositionsY.data();
+		unsigned int numEntities = entities.size();
+		long long iRangeSquared = (long long)rangePARAM * rangePARAM;
+
+		// Test kSIMDWidth entities at a time against the square which covers the range, which rejects most of the
+		// entities which are out of range, then test the distance to those which are inside of the square.
+		// The distance is computed with 64 bit integers so that large positions don't overflow.
+		SIMDInts vMinX = simdSetInts((unsigned int)(positionXPARAM - rangePARAM));
+		SIMDInts vMinY = simdSetInts((unsigned int)(positionYPARAM - rangePARAM));
+		SIMDInts vMaxX = simdSetInts((unsigned int)(positionXPARAM + rangePARAM));
+		SIMDInts vMaxY = simdSetInts((unsigned int)(positionYPARAM + rangePARAM));
+		unsigned int i = 0;
+		for (; i + kSIMDWidth <= numEntities; i += kSIMDWidth)
+		{
+			SIMDInts vX = simdLoadUnalignedInts(pPositionsX + i);
+			SIMDInts vY = simdLoadUnalignedInts(pPositionsY + i);
+			SIMDInts vOutside = simdOrInts(simdCompareIntsGreater(vMinX, vX), simdCompareIntsGreater(vX, vMaxX));
+			vOutside = simdOrInts(vOutside, simdOrInts(simdCompareIntsGreater(vMinY, vY), simdCompareIntsGreater(vY, vMaxY)));
+			int mask = ~simdGetMask(vOutside);
+			for (unsigned int j = 0; j < kSIMDWidth; j++)
 			{
-				nodesPARAM.push_back(this);
-				return;
+				if (!(mask & (1 << j)))
+					continue;
+				long long iDiffX = (long long)pPositionsX[i + j] - positionXPARAM;
+				long long iDiffY = (long long)pPositionsY[i + j] - positionYPARAM;
+				if (iDiffX * iDiffX + iDiffY * iDiffY <= iRangeSquared)
+					entitiesPARAM.push_back(entities[i + j]);
 			}
 		}
-		else  // This node has children, check those
+
+		// Then test the remaining entities one at a time
+		for (; i < numEntities; i++)
 		{
-			for (int i = 0; i < 4; i++)
+			long long iDiffX = (long long)pPositionsX[i] - positionXPARAM;
+			long long iDiffY = (long long)pPositionsY[i] - positionYPARAM;
+			if (iDiffX * iDiffX + iDiffY * iDiffY <= iRangeSquared)
+				entitiesPARAM.push_back(entities[i]);
+		}
+	}
+
+	void QuadTreeNode::getEntitiesWithinRect(std::vector<QuadTreeEntity*>& entitiesPARAM, const Rect& rectPARAM) const
+	{
+		const int* pPositionsX = entityPositionsX.data();
+		const int* pPositionsY = entityPositionsY.data();
+		unsigned int numEntities = entities.size();
+
+		// Test kSIMDWidth entities at a time
+		SIMDInts vMinX = simdSetInts((unsigned int)rectPARAM.minX);
+		SIMDInts vMinY = simdSetInts((unsigned int)rectPARAM.minY);
+		SIMDInts vMaxX = simdSetInts((unsigned int)rectPARAM.maxX);
+		SIMDInts vMaxY = simdSetInts((unsigned int)rectPARAM.maxY);
+		unsigned int i = 0;
+		for (; i + kSIMDWidth <= numEntities; i += kSIMDWidth)
+		{
+			SIMDInts vX = simdLoadUnalignedInts(pPositionsX + i);
+			SIMDInts vY = simdLoadUnalignedInts(pPositionsY + i);
+			SIMDInts vOutside = simdOrInts(simdCompareIntsGreater(vMinX, vX), simdCompareIntsGreater(vX, vMaxX));
+			vOutside = simdOrInts(vOutside, simdOrInts(simdCompareIntsGreater(vMinY, vY), simdCompareIntsGreater(vY, vMaxY)));
+			int mask = ~simdGetMask(vOutside);
+			for (unsigned int j = 0; j < kSIMDWidth; j++)
 			{
-				if (childNodes[i])
-					childNodes[i]->getNodesWithEntitiesWhichIntersect(nodesPARAM, rectPARAM);
+				if (mask & (1 << j))
+					entitiesPARAM.push_back(entities[i + j]);
 			}
 		}
+
+		// Then test the remaining entities one at a time
+		for (; i < numEntities; i++)
+		{
+			if (pPositionsX[i] >= rectPARAM.minX && pPositionsX[i] <= rectPARAM.maxX &&
+				pPositionsY[i] >= rectPARAM.minY && pPositionsY[i] <= rectPARAM.maxY)
+				entitiesPARAM.push_back(entities[i]);
+		}
 	}
 
-	void QuadTreeNode::getMaxNodeDepth(unsigned int& maxNodeDepthPARAM)
+	void QuadTreeNode::getEntityPairsWithinRange(std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairsPARAM, int rangePARAM) const
 	{
-		if (nodeDepth > maxNodeDepthPARAM)
-			maxNodeDepthPARAM = nodeDepth;
+		// Only test each entity against those after it, so that each pair is only added once
+		for (unsigned int i = 0; i < entities.size(); i++)
+			addEntityPairsWithinRange(pairsPARAM, i, *this, i + 1, rangePARAM);
+	}
 
-		// Call this method for all children of this node
-		for (int i = 0; i < 4; i++)
+	void QuadTreeNode::getEntityPairsWithinRange(std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairsPARAM, const QuadTreeNode& otherNodePARAM, int rangePARAM) const
+	{
+		const Rect& otherRect = otherNodePARAM.rectRegion;
+		for (unsigned int i = 0; i < entities.size(); i++)
 		{
-			if (childNodes[i])	// If child exists
-				childNodes[i]->getMaxNodeDepth(maxNodeDepthPARAM);
+			if ((long long)entityPositionsX[i] + rangePARAM < otherRect.minX || (long long)entityPositionsX[i] - rangePARAM > otherRect.maxX ||
+				(long long)entityPositionsY[i] + rangePARAM < otherRect.minY || (long long)entityPositionsY[i] - rangePARAM > otherRect.maxY)
+				continue;
+			addEntityPairsWithinRange(pairsPARAM, i, otherNodePARAM, 0, rangePARAM);
+		}
+	}
+
+	void QuadTreeNode::addEntity(QuadTreeEntity* entityPARAM)
+	{
+		entityPARAM->indexInNode = entities.size();
+		entities.push_back(entityPARAM);
+		entityPositionsX.push_back(entityPARAM->positionX);
+		entityPositionsY.push_back(entityPARAM->positionY);
+	}
+
+	void QuadTreeNode::removeEntity(unsigned int indexPARAM)
+	{
+		entities.removeAndSwapWithLast(indexPARAM);
+		entityPositionsX.removeAndSwapWithLast(indexPARAM);
+		entityPositionsY.removeAndSwapWithLast(indexPARAM);
+
+		// The last entity has been moved into the removed entity's place
+		if (indexPARAM < entities.size())
+			entities[indexPARAM]->indexInNode = indexPARAM;
+	}
+
+	void QuadTreeNode::removeAllEntities(bool freeMemoryPARAM)
+	{
+		if (freeMemoryPARAM)
+		{
+			entities.freeMemory();
+			entityPositionsX.freeMemory();
+			entityPositionsY.freeMemory();
+		}
+		else
+		{
+			entities.clear();
+			entityPositionsX.clear();
+			entityPositionsY.clear();
+		}
+	}
+
+	void QuadTreeNode::updateEntityPosition(const QuadTreeEntity* entityPARAM)
+	{
+		unsigned int index = entityPARAM->indexInNode;
+		ErrorIfTrue(index >= entities.size() || entities[index] != entityPARAM, L"QuadTreeNode::updateEntityPosition() failed. The entity named " + entityPARAM->name + L" could not be found");
+		entityPositionsX[index] = entityPARAM->positionX;
+		entityPositionsY[index] = entityPARAM->positionY;
+	}
+	void QuadTreeNode::addEntityPairsWithinRange(std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairsPARAM, unsigned int entityIndexPARAM, const QuadTreeNode& otherNodePARAM, unsigned int firstOtherEntityPARAM, int rangePARAM) const
+	{
+		QuadTreeEntity* pEntity = entities[entityIndexPARAM];
+		int iPositionX = entityPositionsX[entityIndexPARAM];
+		int iPositionY = entityPositionsY[entityIndexPARAM];
+		const int* pPositionsX = otherNodePARAM.entityPositionsX.data();
+		const int* pPositionsY = otherNodePARAM.entityPositionsY.data();
+		unsigned int numEntities = otherNodePARAM.entities.size();
+		long long iRangeSquared = (long long)rangePARAM * rangePARAM;
+
+		// Test kSIMDWidth entities at a time against the square which covers the range, as getEntitiesWithinRange() does,
+		// then test the distance to those which are inside of the square.
+		SIMDInts vMinX = simdSetInts((unsigned int)(iPositionX - rangePARAM));
+		SIMDInts vMinY = simdSetInts((unsigned int)(iPositionY - rangePARAM));
+		SIMDInts vMaxX = simdSetInts((unsigned int)(iPositionX + rangePARAM));
+		SIMDInts vMaxY = simdSetInts((unsigned int)(iPositionY + rangePARAM));
+		unsigned int i = firstOtherEntityPARAM;
+		for (; i + kSIMDWidth <= numEntities; i += kSIMDWidth)
+		{
+			SIMDInts vX = simdLoadUnalignedInts(pPositionsX + i);
+			SIMDInts vY = simdLoadUnalignedInts(pPositionsY + i);
+			SIMDInts vOutside = simdOrInts(simdCompareIntsGreater(vMinX, vX), simdCompareIntsGreater(vX, vMaxX));
+			vOutside = simdOrInts(vOutside, simdOrInts(simdCompareIntsGreater(vMinY, vY), simdCompareIntsGreater(vY, vMaxY)));
+			int mask = ~simdGetMask(vOutside);
+			for (unsigned int j = 0; j < kSIMDWidth; j++)
+			{
+				if (!(mask & (1 << j)))
+					continue;
+				long long iDiffX = (long long)pPositionsX[i + j] - iPositionX;
+				long long iDiffY = (long long)pPositionsY[i + j] - iPositionY;
+				if (iDiffX * iDiffX + iDiffY * iDiffY <= iRangeSquared)
+					pairsPARAM.push_back(std::pair<QuadTreeEntity*, QuadTreeEntity*>(pEntity, otherNodePARAM.entities[i + j]));
+			}
+		}
+
+		// Then test the remaining entities one at a time
+		for (; i < numEntities; i++)
+		{
+			long long iDiffX = (long long)pPositionsX[i] - iPositionX;
+			long long iDiffY = (long long)pPositionsY[i] - iPositionY;
+			if (iDiffX * iDiffX + iDiffY * iDiffY <= iRangeSquared)
+				pairsPARAM.push_back(std::pair<QuadTreeEntity*, QuadTreeEntity*>(pEntity, otherNodePARAM.entities[i]));
 		}
 	}
 }
\ No newline at end of file
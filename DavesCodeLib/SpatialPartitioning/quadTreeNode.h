@@ -1,13 +1,21 @@
 #pragma once
 #include "../Math/rect.h"
 #include "quadTreeEntity.h"
-#include <map>
+#include "../Common/templateSmallArray.h"
+#include <utility>
+#include <vector>
 
 namespace DC
 {
 	class QuadTree;
 
 	// A node used by the QuadTree class
+	// Nodes are not allocated individually, they live inside of the QuadTree's node pool and refer to
+	// their parent and child nodes by their index within that pool.
+	// The root node is always at index 0 and as the root node can never be a child of another node,
+	// a child node index of 0 means that there is no child node.
+	// Pointers to nodes returned by the QuadTree are only valid until the tree is next modified, as
+	// adding nodes to the pool may move them in memory.
 	class QuadTreeNode
 	{
 		friend class QuadTree;
@@ -22,18 +30,17 @@ namespace DC
 			NONE
 		};
 
+		// Number of entities a node can hold before it's entity array is moved onto the heap.
+		// This matches the QuadTree's default maximum number of entities per node.
+		static const unsigned int kInlineEntityCapacity = 10;
+
 		// Constructor.
 		// Sets up the node to represent the given region within the 2D world, with no child nodes.
-		// parentNode is a pointer to this node's parent node. However, if this node is to represent
-		// the root node, this will be 0.
-		QuadTreeNode(const Rect& rectRegion, QuadTreeNode* parentNode, QuadTree* quadTree);
-
-		// Destructor
-		// Removes all child nodes
-		// Although this obviously removes the entities from the nodes, because the nodes themselves
-		// no longer exist, this does NOT delete the entity pointers. They are stored in the QuadTree's
-		// _mmapEntities hashmap.
-		~QuadTreeNode();
+		// parentNode is the index of this node's parent node within the QuadTree's node pool.
+		// However, if this node is to represent the root node, this will be 0 and nodeDepth will be 0.
+		// quadTree may be 0 for nodes which are being built on another thread by QuadTree::buildFromPoints(), which
+		// sets it once the nodes have been added to the tree's node pool.
+		QuadTreeNode(const Rect& rectRegion, unsigned int parentNode, unsigned int nodeDepth, QuadTree* quadTree);
 
 		// Debug renders this node and it's child nodes', node boundaries
 		// line is the CResourceLine object which is being used to add vertices to be rendered
@@ -53,40 +60,55 @@ namespace DC
 		// Returns whether this node and all it's children have any entities within
 		bool hasEntitiesInThisAndAllChildren(void) const;
 
-		// Creates the specified child node
-		// If the node already exists, this does nothing.
-		void createChildNode(ChildNode childNode);
-
 		// Calculates and returns a child's rect region.
 		Rect computeChildNodeRegion(ChildNode childNode) const;
 
-		// Adds an entity into this node, or it's children
-		void addEntity(QuadTreeEntity* entity);
-
-		// Removes an entity from this node
-		// If the entity couldn't be found, an exception occurs
-		void removeEntity(QuadTreeEntity* entity);
+		// Returns which of the four child nodes the given position would be inside of.
+		// If the position is outside of this node's region, NONE is returned.
+		ChildNode computeChildNodeForPosition(int positionX, int positionY) const;
 
 		// Adds nodes to a vector of CQuadTreeNodes which have entities in them
 		void getNodesWithEntities(std::vector<QuadTreeNode*>& nodes);
 
-		// Adds nodes to a vector of CQuadTreeNodes which intersect with the given rect and have entities
-		void getNodesWithEntitiesWhichIntersect(std::vector<QuadTreeNode*>& nodes, const Rect& rect);
-
 		// Go through all children and if their depth is greater, increases given uiMaxNodeDepth
 		void getMaxNodeDepth(unsigned int& maxNodeDepth);
+
+		// Returns the rectangular region which this node covers
+		const Rect& getRegion(void) const;
+
+		// Returns the number of entities stored directly within this node
+		unsigned int getNumEntities(void) const;
+
+		// Adds the entities stored directly within this node which are within range of the given position to the
+		// given vector.
+		// Unlike the methods above, each entity's position is tested, kSIMDWidth entities at a time.
+		void getEntitiesWithinRange(std::vector<QuadTreeEntity*>& entities, int positionX, int positionY, int range) const;
+
+		// Adds the entities stored directly within this node whose positions are inside of the given rect to the
+		// given vector, testing kSIMDWidth entities at a time.
+		void getEntitiesWithinRect(std::vector<QuadTreeEntity*>& entities, const Rect& rect) const;
+
+		// Adds each pair of the entities stored directly within this node which are within range of each other to
+		// the given vector, testing kSIMDWidth entities at a time.
+		void getEntityPairsWithinRange(std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairs, int range) const;
+
+		// Adds each pair made up of an entity stored directly within this node and an entity stored directly within
+		// the given other node, which are within range of each other, to the given vector.
+		// Only the entities of this node which are within range of the other node's region are tested against the
+		// other node's entities, which is usually only the few which are near to the boundary between them.
+		void getEntityPairsWithinRange(std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairs, const QuadTreeNode& otherNode, int range) const;
 	private:
 		// Holds the rectangular region which this node covers
 		// Must be a multiple of 2, otherwise child nodes' regions will not cover all space.
 		Rect rectRegion;
 
-		// Pointer to the parent of this node. May be 0 if this is the root node
-		QuadTreeNode* parentNode;
+		// Index of the parent of this node within the QuadTree's node pool. 0 if this is the root node
+		unsigned int parentNode;
 
-		// Pointer to the four possible child nodes.
-		// A pointer may be 0 for no child node allocated yet.
+		// Indicies of the four possible child nodes within the QuadTree's node pool.
+		// An index may be 0 for no child node allocated yet.
 		// Use the ChildNode enum with this array to access the correct child node.
-		QuadTreeNode* childNodes[4];
+		unsigned int childNodes[4];
 
 		// The quad tree which owns this node, this is passed to the constructor
 		QuadTree* quadTree;
@@ -95,9 +117,33 @@ namespace DC
 		// How many nodes there are above this node.
 		unsigned int nodeDepth;
 
-		// Hashmap holding pointers to each of the added entities, until
-		// this node has children, in which case this would be empty as 
-		// the child nodes now own the entities (or their siblings)
-		mutable std::map<std::wstring, QuadTreeEntity*> entities;
+		// Pointers to each of the added entities, until this node has children, in which
+		// case this would be empty as the child nodes now own the entities (or their siblings)
+		SmallArray<QuadTreeEntity*, kInlineEntityCapacity> entities;
+
+		// The position of each of the entities along each axis, in the same order as the entities array.
+		// These are stored seperately from the entities so that the exact queries can test several entities at
+		// once with SIMD instructions, without having to follow each entity pointer.
+		SmallArray<int, kInlineEntityCapacity> entityPositionsX;
+		SmallArray<int, kInlineEntityCapacity> entityPositionsY;
+
+		// Adds the given entity to the end of this node's entities, along with it's position, and sets the entity's indexInNode
+		void addEntity(QuadTreeEntity* entity);
+
+		// Removes the entity at the given index by replacing it with the last entity, along with it's position, and updates
+		// the indexInNode of the entity which was moved
+		void removeEntity(unsigned int index);
+
+		// Removes all of this node's entities.
+		// If freeMemory is true, any heap memory used to store them is also freed.
+		void removeAllEntities(bool freeMemory);
+
+		// Copies the position of the given entity, which must be stored within this node, into entityPositionsX/Y
+		// This must be called whenever the entity's position changes while it stays within this node.
+		void updateEntityPosition(const QuadTreeEntity* entity);
+
+		// Adds each pair made up of the entity at entityIndex within this node and one of the entities within the
+		// given other node, starting at firstOtherEntity, which are within range of each other, to the given vector.
+		void addEntityPairsWithinRange(std::vector<std::pair<QuadTreeEntity*, QuadTreeEntity*>>& pairs, unsigned int entityIndex, const QuadTreeNode& otherNode, unsigned int firstOtherEntity, int range) const;
 	};
 }
@@ -0,0 +1,53 @@
+#pragma once
+
+namespace DC
+{
+	// A handle to an entity which has been added to a QuadTree or OctTree.
+	// Using a handle instead of an entity's name means the tree can find the entity by indexing into an array,
+	// instead of searching a hashmap of names and performing lots of string comparisons.
+	// The lower bits of the handle hold the index of the entity's slot within the tree and the upper bits hold
+	// the slot's generation. Each time an entity is removed from a tree, the generation of the slot it was in
+	// is increased, so that any handles to the removed entity which are still lying around are no longer valid
+	// and do not refer to whichever new entity is later added into that slot.
+	// Once a slot's generation has used up all of it's bits, the slot is retired and never used again, rather
+	// than wrapping it's generation back around to zero, which would make the handles given out for the slot
+	// long ago valid again, see spatialEntityHandleGetSlotCanBeReused().
+	typedef unsigned int SpatialEntityHandle;
+
+	// Value of a handle which does not refer to any entity
+	const SpatialEntityHandle kSpatialEntityHandleInvalid = 0xFFFFFFFF;
+
+	// Number of bits of the handle used to store the slot index, the remaining bits store the generation
+	const unsigned int kSpatialEntityHandleIndexBits = 20;
+
+	// Maximum number of entity slots a tree may have
+	const unsigned int kSpatialEntityHandleMaxSlots = (1u << kSpatialEntityHandleIndexBits) - 1;
+
+	// Largest generation which fits into the bits of a handle
+	const unsigned int kSpatialEntityHandleMaxGeneration = (1u << (32 - kSpatialEntityHandleIndexBits)) - 1;
+
+	// Returns a handle made up from the given slot index and generation
+	inline SpatialEntityHandle spatialEntityHandleCreate(unsigned int slotIndex, unsigned int generation)
+	{
+		return (generation << kSpatialEntityHandleIndexBits) | slotIndex;
+	}
+
+	// Returns the slot index stored in the given handle
+	inline unsigned int spatialEntityHandleGetIndex(SpatialEntityHandle handle)
+	{
+		return handle & kSpatialEntityHandleMaxSlots;
+	}
+
+	// Returns the generation stored in the given handle
+	inline unsigned int spatialEntityHandleGetGeneration(SpatialEntityHandle handle)
+	{
+		return handle >> kSpatialEntityHandleIndexBits;
+	}
+
+	// Returns whether a slot whose generation has just been increased to the given generation, after it's entity was
+	// removed, may be given to a new entity, which is when the generation still fits into the bits of a handle
+	inline bool spatialEntityHandleGetSlotCanBeReused(unsigned int generation)
+	{
+		return generation <= kSpatialEntityHandleMaxGeneration;
+	}
+}
\ No newline at end of file
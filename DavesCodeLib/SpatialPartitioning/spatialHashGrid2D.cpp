@@ -0,0 +1,471 @@
+#include "spatialHashGrid2D.h"
+#include "../Common/error.h"
+#include <algorithm>
+
+namespace DC
+{
+	SpatialHashGrid2D::SpatialHashGrid2D(int cellSizePARAM)
+	{
+		numUsedCells = 0;
+		init(cellSizePARAM);
+	}
+
+	SpatialHashGrid2D::~SpatialHashGrid2D()
+	{
+		free();
+	}
+
+	void SpatialHashGrid2D::init(int cellSizePARAM)
+	{
+		free();
+
+		// Make sure valid values were given
+		ErrorIfTrue(cellSizePARAM < 1, L"SpatialHashGrid2D::init() failed. Given invalid cell size. Must be at least one.");
+
+		// Store settings
+		cellSize = cellSizePARAM;
+	}
+
+	void SpatialHashGrid2D::free(void)
+	{
+		std::vector<Cell>().swap(cells);
+		numUsedCells = 0;
+
+		// Delete all entities
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+		{
+			if (entitySlots[ui].entity)
+				delete entitySlots[ui].entity;
+		}
+		std::vector<EntitySlot>().swap(entitySlots);
+		std::vector<unsigned int>().swap(freeEntitySlots);
+		entityNames.clear();
+	}
+
+	SpatialEntityHandle SpatialHashGrid2D::addEntity(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM, int userDataPARAM, void* pUserDataPARAM)
+	{
+		// Make sure the entity doesn't already exist by checking the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() != it, L"SpatialHashGrid2D::addEntity() failed. The entity name of " + namePARAM + L" already exists.");
+
+		// Create new entity and add it's handle to the hashmap for lookup by name
+		QuadTreeEntity* pEntity = createEntity(namePARAM, positionXPARAM, positionYPARAM, userDataPARAM, pUserDataPARAM);
+		entityNames[namePARAM] = pEntity->handle;
+
+		addEntityToCell(pEntity);
+		return pEntity->handle;
+	}
+
+	SpatialEntityHandle SpatialHashGrid2D::addEntity(int positionXPARAM, int positionYPARAM, int userDataPARAM, void* pUserDataPARAM)
+	{
+		QuadTreeEntity* pEntity = createEntity(L"", positionXPARAM, positionYPARAM, userDataPARAM, pUserDataPARAM);
+		addEntityToCell(pEntity);
+		return pEntity->handle;
+	}
+
+	void SpatialHashGrid2D::removeEntity(const std::wstring& namePARAM)
+	{
+		// Make sure the entity exists by checking the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"SpatialHashGrid2D::removeEntity() failed. The entity name of " + namePARAM + L" doesn't exist.");
+
+		QuadTreeEntity* pEntity = findEntity(it->second);
+		entityNames.erase(it);
+		removeEntityFromCell(pEntity);
+		deleteEntity(pEntity);
+	}
+
+	void SpatialHashGrid2D::removeEntity(SpatialEntityHandle handlePARAM)
+	{
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"SpatialHashGrid2D::removeEntity() failed. The given entity handle is invalid.");
+
+		// If the entity was given a name, remove that too
+		if (!pEntity->name.empty())
+			entityNames.erase(pEntity->name);
+		removeEntityFromCell(pEntity);
+		deleteEntity(pEntity);
+	}
+
+	bool SpatialHashGrid2D::getEntityExists(const std::wstring& namePARAM) const
+	{
+		// Check the hashmap
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		return(entityNames.end() != it);
+	}
+
+	bool SpatialHashGrid2D::getEntityExists(SpatialEntityHandle handlePARAM) const
+	{
+		return findEntity(handlePARAM) != 0;
+	}
+
+	SpatialEntityHandle SpatialHashGrid2D::getEntityHandle(const std::wstring& namePARAM) const
+	{
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(entityNames.end() == it, L"SpatialHashGrid2D::getEntityHandle() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		return it->second;
+	}
+
+	QuadTreeEntity* SpatialHashGrid2D::getEntity(SpatialEntityHandle handlePARAM) const
+	{
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"SpatialHashGrid2D::getEntity() failed. The given entity handle is invalid.");
+		return pEntity;
+	}
+
+	void SpatialHashGrid2D::removeAllEntities(void)
+	{
+		// Delete each entity and free it's slot
+		for (unsigned int ui = 0; ui < entitySlots.size(); ui++)
+		{
+			if (entitySlots[ui].entity)
+				deleteEntity(entitySlots[ui].entity);
+		}
+		entityNames.clear();
+
+		// Mark every entry of the hash table as unused, keeping any memory the cells' arrays have allocated
+		for (size_t i = 0; i < cells.size(); i++)
+		{
+			cells[i].used = false;
+			cells[i].entities.clear();
+			cells[i].entityPositionsX.clear();
+			cells[i].entityPositionsY.clear();
+		}
+		numUsedCells = 0;
+	}
+
+	void SpatialHashGrid2D::setEntityPosition(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM)
+	{
+		// First make sure the named entity exists
+		std::map<std::wstring, SpatialEntityHandle>::iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(it == entityNames.end(), L"SpatialHashGrid2D::setEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		setEntityPosition(it->second, positionXPARAM, positionYPARAM);
+	}
+
+	void SpatialHashGrid2D::setEntityPosition(SpatialEntityHandle handlePARAM, int positionXPARAM, int positionYPARAM)
+	{
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"SpatialHashGrid2D::setEntityPosition() failed. The given entity handle is invalid.");
+
+		// If the new position is inside of the same cell, we simply update the position, both in the entity and in
+		// the cell's position arrays, where the entity is at the index it stores.
+		Cell& cell = cells[pEntity->nodeOwner];
+		if (computeCellCoordinate(positionXPARAM) == cell.cellX && computeCellCoordinate(positionYPARAM) == cell.cellY)
+		{
+			pEntity->positionX = positionXPARAM;
+			pEntity->positionY = positionYPARAM;
+			cell.entityPositionsX[pEntity->indexInNode] = positionXPARAM;
+			cell.entityPositionsY[pEntity->indexInNode] = positionYPARAM;
+			return;
+		}
+
+		// Otherwise, move the entity to the cell it's new position is inside of
+		// The entity itself is kept, so it's handle remains valid.
+		removeEntityFromCell(pEntity);
+		pEntity->positionX = positionXPARAM;
+		pEntity->positionY = positionYPARAM;
+		addEntityToCell(pEntity);
+	}
+
+	void SpatialHashGrid2D::getEntityPosition(const std::wstring& namePARAM, int& positionXPARAM, int& positionYPARAM) const
+	{
+		// First make sure the named entity exists
+		std::map<std::wstring, SpatialEntityHandle>::const_iterator it = entityNames.find(namePARAM);
+		ErrorIfTrue(it == entityNames.end(), L"SpatialHashGrid2D::getEntityPosition() failed. The named entity of " + namePARAM + L" doesn't exist.");
+		QuadTreeEntity* pEntity = findEntity(it->second);
+		positionXPARAM = pEntity->positionX;
+		positionYPARAM = pEntity->positionY;
+	}
+
+	void SpatialHashGrid2D::getEntityPosition(SpatialEntityHandle handlePARAM, int& positionXPARAM, int& positionYPARAM) const
+	{
+		QuadTreeEntity* pEntity = findEntity(handlePARAM);
+		ErrorIfFalse(pEntity, L"SpatialHashGrid2D::getEntityPosition() failed. The given entity handle is invalid.");
+		positionXPARAM = pEntity->positionX;
+		positionYPARAM = pEntity->positionY;
+	}
+
+	std::vector<QuadTreeEntity*> SpatialHashGrid2D::getEntitiesWithinRange(int positionXPARAM, int positionYPARAM, int rangePARAM) const
+	{
+		std::vector<QuadTreeEntity*> vResult;
+		getEntitiesWithinRange(positionXPARAM, positionYPARAM, rangePARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<QuadTreeEntity*> SpatialHashGrid2D::getEntitiesWithinRect(const Rect& rectPARAM) const
+	{
+		std::vector<QuadTreeEntity*> vResult;
+		getEntitiesWithinRect(rectPARAM, vResult);
+		return vResult;
+	}
+
+	std::vector<QuadTreeEntity*> SpatialHashGrid2D::getEntitiesWithinRangeExact(int positionXPARAM, int positionYPARAM, int rangePARAM, bool sortByDistancePARAM) const
+	{
+		std::vector<QuadTreeEntity*> vResult;
+		getEntitiesWithinRangeExact(positionXPARAM, positionYPARAM, rangePARAM, vResult, sortByDistancePARAM);
+		return vResult;
+	}
+
+	std::vector<QuadTreeEntity*> SpatialHashGrid2D::getEntitiesWithinRectExact(const Rect& rectPARAM) const
+	{
+		std::vector<QuadTreeEntity*> vResult;
+		getEntitiesWithinRectExact(rectPARAM, vResult);
+		return vResult;
+	}
+
+	void SpatialHashGrid2D::getEntitiesWithinRange(int positionXPARAM, int positionYPARAM, int rangePARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM) const
+	{
+		visitEntitiesWithinRange(positionXPARAM, positionYPARAM, rangePARAM, [&entitiesOutPARAM](QuadTreeEntity* entity)
+			{
+				entitiesOutPARAM.push_back(entity);
+			});
+	}
+
+	void SpatialHashGrid2D::getEntitiesWithinRect(const Rect& rectPARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM) const
+	{
+		visitEntitiesWithinRect(rectPARAM, [&entitiesOutPARAM](QuadTreeEntity* entity)
+			{
+				entitiesOutPARAM.push_back(entity);
+			});
+	}
+
+	void SpatialHashGrid2D::getEntitiesWithinRangeExact(int positionXPARAM, int positionYPARAM, int rangePARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM, bool sortByDistancePARAM) const
+	{
+		// Create a rect which covers the maximum range from the given position
+		Rect rectRange;
+		rectRange.minX = positionXPARAM - rangePARAM;
+		rectRange.maxX = positionXPARAM + rangePARAM;
+		rectRange.minY = positionYPARAM - rangePARAM;
+		rectRange.maxY = positionYPARAM + rangePARAM;
+
+		// Go through the cells which the rect covers, adding each of their entities which are within range.
+		// The distance is computed with 64 bit integers so that large positions don't overflow.
+		size_t firstResult = entitiesOutPARAM.size();
+		long long iRangeSquared = (long long)rangePARAM * rangePARAM;
+		auto visitCell = [&](const Cell& cell)
+		{
+			const int* pPositionsX = cell.entityPositionsX.data();
+			const int* pPositionsY = cell.entityPositionsY.data();
+			for (unsigned int i = 0; i < cell.entities.size(); i++)
+			{
+				long long iDiffX = (long long)pPositionsX[i] - positionXPARAM;
+				long long iDiffY = (long long)pPositionsY[i] - positionYPARAM;
+				if (iDiffX * iDiffX + iDiffY * iDiffY <= iRangeSquared)
+					entitiesOutPARAM.push_back(cell.entities[i]);
+			}
+		};
+		visitCellsWhichIntersect(rectRange, visitCell);
+
+		// Sort the entities we've just added, leaving any which were already in the vector alone
+		if (sortByDistancePARAM)
+		{
+			std::sort(entitiesOutPARAM.begin() + firstResult, entitiesOutPARAM.end(), [positionXPARAM, positionYPARAM](const QuadTreeEntity* entityA, const QuadTreeEntity* entityB)
+				{
+					long long iDiffAX = (long long)entityA->positionX - positionXPARAM;
+					long long iDiffAY = (long long)entityA->positionY - positionYPARAM;
+					long long iDiffBX = (long long)entityB->positionX - positionXPARAM;
+					long long iDiffBY = (long long)entityB->positionY - positionYPARAM;
+					return iDiffAX * iDiffAX + iDiffAY * iDiffAY < iDiffBX * iDiffBX + iDiffBY * iDiffBY;
+				});
+		}
+	}
+
+	void SpatialHashGrid2D::getEntitiesWithinRectExact(const Rect& rectPARAM, std::vector<QuadTreeEntity*>& entitiesOutPARAM) const
+	{
+		// Go through the cells which the rect covers, adding each of their entities which are inside of the rect
+		auto visitCell = [&](const Cell& cell)
+		{
+			const int* pPositionsX = cell.entityPositionsX.data();
+			const int* pPositionsY = cell.entityPositionsY.data();
+			for (unsigned int i = 0; i < cell.entities.size(); i++)
+			{
+				if (pPositionsX[i] >= rectPARAM.minX && pPositionsX[i] <= rectPARAM.maxX &&
+					pPositionsY[i] >= rectPARAM.minY && pPositionsY[i] <= rectPARAM.maxY)
+					entitiesOutPARAM.push_back(cell.entities[i]);
+			}
+		};
+		visitCellsWhichIntersect(rectPARAM, visitCell);
+	}
+
+	int SpatialHashGrid2D::getCellSize(void) const
+	{
+		return cellSize;
+	}
+
+	unsigned int SpatialHashGrid2D::getNumCellsWithEntities(void) const
+	{
+		unsigned int numCells = 0;
+		for (size_t i = 0; i < cells.size(); i++)
+		{
+			if (cells[i].used && !cells[i].entities.empty())
+				numCells++;
+		}
+		return numCells;
+	}
+
+	int SpatialHashGrid2D::computeCellCoordinate(int positionPARAM) const
+	{
+		// Round towards negative infinity, so that positions either side of zero don't share a cell
+		if (positionPARAM >= 0)
+			return positionPARAM / cellSize;
+		return -1 - ((-1 - positionPARAM) / cellSize);
+	}
+
+	unsigned int SpatialHashGrid2D::computeCellHash(int cellXPARAM, int cellYPARAM) const
+	{
+		// Multiply each coordinate by a large odd constant to spread neighbouring cells across the table, then
+		// mix the upper bits into the lower bits, as only the lower bits are used to index the table.
+		unsigned int hash = (unsigned int)cellXPARAM * 0x9E3779B1u ^ (unsigned int)cellYPARAM * 0x85EBCA77u;
+		hash ^= hash >> 16;
+		return hash & (unsigned int)(cells.size() - 1);
+	}
+
+	int SpatialHashGrid2D::findCell(int cellXPARAM, int cellYPARAM) const
+	{
+		if (cells.empty())
+			return -1;
+
+		// Step forward from the hashed index until we find the cell, or an unused entry, meaning the cell doesn't exist
+		unsigned int mask = (unsigned int)(cells.size() - 1);
+		unsigned int index = computeCellHash(cellXPARAM, cellYPARAM);
+		while (cells[index].used)
+		{
+			if (cells[index].cellX == cellXPARAM && cells[index].cellY == cellYPARAM)
+				return int(index);
+			index = (index + 1) & mask;
+		}
+		return -1;
+	}
+
+	unsigned int SpatialHashGrid2D::findOrAddCell(int cellXPARAM, int cellYPARAM)
+	{
+		int cellIndex = findCell(cellXPARAM, cellYPARAM);
+		if (cellIndex >= 0)
+			return (unsigned int)cellIndex;
+
+		// The cell doesn't exist, so rebuild the table first if adding it would make the table over three quarters full.
+		if ((numUsedCells + 1) * 4 > cells.size() * 3)
+			rebuildCells();
+
+		unsigned int mask = (unsigned int)(cells.size() - 1);
+		unsigned int index = computeCellHash(cellXPARAM, cellYPARAM);
+		while (cells[index].used)
+			index = (index + 1) & mask;
+
+		Cell& cell = cells[index];
+		cell.cellX = cellXPARAM;
+		cell.cellY = cellYPARAM;
+		cell.used = true;
+		numUsedCells++;
+		return index;
+	}
+
+	void SpatialHashGrid2D::rebuildCells(void)
+	{
+		// Compute the number of cells which still hold entities and make the new table at least twice that size
+		unsigned int numCellsWithEntities = getNumCellsWithEntities();
+		size_t newSize = 16;
+		while (newSize < ((size_t)numCellsWithEntities + 1) * 2)
+			newSize *= 2;
+
+		std::vector<Cell> oldCells;
+		oldCells.swap(cells);
+		cells.resize(newSize);
+		for (size_t i = 0; i < cells.size(); i++)
+			cells[i].used = false;
+		numUsedCells = 0;
+
+		// Move each cell which holds entities over to the new table, updating the cell index stored in each of it's entities
+		unsigned int mask = (unsigned int)(cells.size() - 1);
+		for (size_t i = 0; i < oldCells.size(); i++)
+		{
+			Cell& oldCell = oldCells[i];
+			if (!oldCell.used || oldCell.entities.empty())
+				continue;
+
+			unsigned int index = computeCellHash(oldCell.cellX, oldCell.cellY);
+			while (cells[index].used)
+				index = (index + 1) & mask;
+			cells[index] = std::move(oldCell);
+			numUsedCells++;
+			for (unsigned int j = 0; j < cells[index].entities.size(); j++)
+				cells[index].entities[j]->nodeOwner = index;
+		}
+	}
+
+	void SpatialHashGrid2D::addEntityToCell(QuadTreeEntity* entityPARAM)
+	{
+		unsigned int cellIndex = findOrAddCell(computeCellCoordinate(entityPARAM->positionX), computeCellCoordinate(entityPARAM->positionY));
+		Cell& cell = cells[cellIndex];
+		entityPARAM->nodeOwner = cellIndex;
+		entityPARAM->indexInNode = cell.entities.size();
+		cell.entities.push_back(entityPARAM);
+		cell.entityPositionsX.push_back(entityPARAM->positionX);
+		cell.entityPositionsY.push_back(entityPARAM->positionY);
+	}
+
+	void SpatialHashGrid2D::removeEntityFromCell(QuadTreeEntity* entityPARAM)
+	{
+		Cell& cell = cells[entityPARAM->nodeOwner];
+		unsigned int index = entityPARAM->indexInNode;
+		ErrorIfTrue(index >= cell.entities.size() || cell.entities[index] != entityPARAM, L"SpatialHashGrid2D::removeEntityFromCell() failed. The entity named " + entityPARAM->name + L" could not be found");
+
+		// The last entity of the cell is moved into the removed entity's place, so it's index needs updating
+		cell.entities.removeAndSwapWithLast(index);
+		cell.entityPositionsX.removeAndSwapWithLast(index);
+		cell.entityPositionsY.removeAndSwapWithLast(index);
+		if (index < cell.entities.size())
+			cell.entities[index]->indexInNode = index;
+		// The cell is left in the hash table even if it's now empty, see the cells member.
+	}
+
+	QuadTreeEntity* SpatialHashGrid2D::findEntity(SpatialEntityHandle handlePARAM) const
+	{
+		unsigned int slotIndex = spatialEntityHandleGetIndex(handlePARAM);
+		if (slotIndex >= entitySlots.size())
+			return 0;
+		const EntitySlot& slot = entitySlots[slotIndex];
+		if (slot.generation != spatialEntityHandleGetGeneration(handlePARAM))
+			return 0;
+		return slot.entity;
+	}
+
+	QuadTreeEntity* SpatialHashGrid2D::createEntity(const std::wstring& namePARAM, int positionXPARAM, int positionYPARAM, int userDataPARAM, void* pUserDataPARAM)
+	{
+		// Use a previously freed slot if there is one, otherwise add a new slot
+		unsigned int slotIndex;
+		if (freeEntitySlots.size())
+		{
+			slotIndex = freeEntitySlots.back();
+			freeEntitySlots.pop_back();
+		}
+		else
+		{
+			ErrorIfTrue(entitySlots.size() >= kSpatialEntityHandleMaxSlots, L"SpatialHashGrid2D::createEntity() failed. The maximum number of entities has been reached.");
+			slotIndex = (unsigned int)entitySlots.size();
+			EntitySlot slot;
+			slot.entity = 0;
+			slot.generation = 0;
+			entitySlots.push_back(slot);
+		}
+		EntitySlot& slot = entitySlots[slotIndex];
+
+		// Create new entity, it's cell is set once it's added to one
+		QuadTreeEntity* pEntity = new QuadTreeEntity(namePARAM, positionXPARAM, positionYPARAM, 0, spatialEntityHandleCreate(slotIndex, slot.generation), userDataPARAM, pUserDataPARAM);
+		ErrorIfFalse(pEntity, L"SpatialHashGrid2D::createEntity() failed to allocate memory for new entity.");
+		slot.entity = pEntity;
+		return pEntity;
+	}
+
+	void SpatialHashGrid2D::deleteEntity(QuadTreeEntity* entityPARAM)
+	{
+		// Increase the slot's generation so that any remaining handles to the entity become invalid.
+		// Once the generation no longer fits into a handle, the slot is retired instead of being reused.
+		EntitySlot& slot = entitySlots[spatialEntityHandleGetIndex(entityPARAM->handle)];
+		slot.entity = 0;
+		slot.generation++;
+		if (spatialEntityHandleGetSlotCanBeReused(slot.generation))
+			freeEntitySlots.push_back(spatialEntityHandleGetIndex(entityPARAM->handle));
+		delete entityPARAM;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,297 @@
+#pragma once
+#include "../Math/rect.h"
+#include "quadTreeEntity.h"
+#include "../Common/templateSmallArray.h"
+#include <map>
+#include <vector>
+
+namespace DC
+{
+	// This is a 2D spatial partitioning class, an alternative to the QuadTree class for dense worlds.
+	//
+	// The world is divided into square cells of a fixed size and each entity is stored in the cell which it's
+	// position is inside of. Finding the entities within a range or a rect is a matter of looking at the cells
+	// which the range or rect covers, without having to walk down through the nodes of a tree.
+	// When entities are roughly evenly spread across the world, such as within a busy 2D map, this is faster than
+	// the QuadTree, which spends much of it's time walking nodes. When entities are clumped together in a few
+	// places with lots of empty space in between, the QuadTree is usually better, as it adapts to where the
+	// entities are, whereas the grid has a fixed cell size.
+	// The cell size should be around the size of the ranges which are usually queried, so that each query only
+	// has to look at a handful of cells.
+	//
+	// Only the cells which have entities in them are stored. They are stored in a hash table which uses open
+	// addressing, so the cells are held in one contiguous array and finding a cell is a matter of hashing it's
+	// coordinates and stepping forward through the array until it's found. The world has no bounds, so unlike
+	// the QuadTree, nothing needs rebuilding when entities are added far away from the others.
+	// Moving an entity which stays inside of it's cell only updates it's position. Each entity stores it's index
+	// within it's cell's arrays, so neither that nor removing the entity involves searching the cell.
+	//
+	// The methods match those of the QuadTree class, so the two can be swapped for each other to see which is
+	// faster for a particular map. The entities are QuadTreeEntity objects, the same as the QuadTree uses.
+	// Entities may be added either with a unique name, or without one. Either way, adding an entity returns a
+	// SpatialEntityHandle which can be used to move, query and remove the entity.
+	class SpatialHashGrid2D
+	{
+	public:
+		// Constructor
+		// cellSize is the width and height of each of the grid's cells.
+		// This must be at least 1, otherwise an exception occurs.
+		SpatialHashGrid2D(int cellSize = 64);
+
+		// Destructor
+		// Deletes all cells and entities.
+		~SpatialHashGrid2D();
+
+		// Initialise the grid using the new given settings.
+		// This will free the existing cells and any entities.
+		// cellSize is the width and height of each of the grid's cells.
+		// This must be at least 1, otherwise an exception occurs.
+		void init(int cellSize = 64);
+
+		// Deletes all cells and all entities
+		void free(void);
+
+		// Add entity to the grid.
+		// Each entity needs a unique name, if the name given already exists, an exception occurs.
+		// Returns the handle of the new entity, which may be used instead of the name for faster access.
+		SpatialEntityHandle addEntity(const std::wstring& name, int positionX, int positionY, int userData = 0, void* pUserData = 0);
+
+		// Add an entity which has no name to the grid.
+		// Returns the handle of the new entity, which is used to refer to it from then on.
+		// Handles are only valid until the entity is removed, or the grid is freed or initialised again.
+		SpatialEntityHandle addEntity(int positionX, int positionY, int userData = 0, void* pUserData = 0);
+
+		// Removes the named entity from the grid.
+		// If the unique name doesn't exist, an exception occurs.
+		// To determine whether an entity exists, use getEntityExists()
+		void removeEntity(const std::wstring& name);
+
+		// Removes the entity with the given handle from the grid.
+		// If the handle is invalid, or the entity has already been removed, an exception occurs.
+		void removeEntity(SpatialEntityHandle handle);
+
+		// Returns whether the named entity exists or not
+		bool getEntityExists(const std::wstring& name) const;
+
+		// Returns whether the entity with the given handle exists or not
+		bool getEntityExists(SpatialEntityHandle handle) const;
+
+		// Returns the handle of the named entity
+		// If the named entity doesn't exist, an exception occurs
+		SpatialEntityHandle getEntityHandle(const std::wstring& name) const;
+
+		// Returns a pointer to the entity with the given handle
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		QuadTreeEntity* getEntity(SpatialEntityHandle handle) const;
+
+		// Removes all entities from the grid.
+		// The memory used by the cells is kept for reuse.
+		void removeAllEntities(void);
+
+		// Set an existing entity's position to the one given, moving it to the correct cell if needed.
+		// If the named entity doesn't exist, an exception occurs
+		void setEntityPosition(const std::wstring& name, int positionX, int positionY);
+
+		// Set the position of the entity with the given handle, moving it to the correct cell if needed.
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		void setEntityPosition(SpatialEntityHandle handle, int positionX, int positionY);
+
+		// Sets the given ints to the named entity's position.
+		// If the named entity doesn't exist, an exception occurs
+		void getEntityPosition(const std::wstring& name, int& positionX, int& positionY) const;
+
+		// Sets the given ints to the position of the entity with the given handle.
+		// If the handle is invalid, or the entity has been removed, an exception occurs
+		void getEntityPosition(SpatialEntityHandle handle, int& positionX, int& positionY) const;
+
+		// Returns a vector of entities which are within range of the given position.
+		// This returns all of the entities within the cells which the range covers, so may return some entities
+		// which are outside of the range.
+		// To only get the entities which are within range, use getEntitiesWithinRangeExact()
+		std::vector<QuadTreeEntity*> getEntitiesWithinRange(int positionX, int positionY, int range) const;
+
+		// Returns a vector of entities which are within the given Rect
+		// This returns all of the entities within the cells which the rect covers, so may return some entities
+		// which are outside of the rect.
+		// To only get the entities which are inside of the rect, use getEntitiesWithinRectExact()
+		std::vector<QuadTreeEntity*> getEntitiesWithinRect(const Rect& rect) const;
+
+		// Returns a vector of the entities which are within range of the given position.
+		// Unlike getEntitiesWithinRange(), the distance to each entity is tested, so only the entities which are
+		// within range are returned.
+		// If sortByDistance is true, the entities are sorted from the nearest to the furthest.
+		std::vector<QuadTreeEntity*> getEntitiesWithinRangeExact(int positionX, int positionY, int range, bool sortByDistance = false) const;
+
+		// Returns a vector of the entities whose positions are inside of the given rect.
+		// Unlike getEntitiesWithinRect(), each entity's position is tested, so only the entities which are inside
+		// of the rect are returned.
+		std::vector<QuadTreeEntity*> getEntitiesWithinRectExact(const Rect& rect) const;
+
+		// The methods below are the same as the ones above which return a vector, except that they add the
+		// entities to the end of the given vector instead. The vector is not cleared first.
+		void getEntitiesWithinRange(int positionX, int positionY, int range, std::vector<QuadTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinRect(const Rect& rect, std::vector<QuadTreeEntity*>& entitiesOut) const;
+		void getEntitiesWithinRangeExact(int positionX, int positionY, int range, std::vector<QuadTreeEntity*>& entitiesOut, bool sortByDistance = false) const;
+		void getEntitiesWithinRectExact(const Rect& rect, std::vector<QuadTreeEntity*>& entitiesOut) const;
+
+		// The methods below call the given visitor for each entity which getEntitiesWithinRange() and
+		// getEntitiesWithinRect() would have returned, instead of storing them in a vector.
+		// The visitor may be a lambda or any other callable object and is passed a QuadTreeEntity*
+		// The grid must not be modified from within the visitor.
+		template <typename Visitor> void visitEntitiesWithinRange(int positionX, int positionY, int range, Visitor&& visitor) const;
+		template <typename Visitor> void visitEntitiesWithinRect(const Rect& rect, Visitor&& visitor) const;
+
+		// Returns the width and height of each of the grid's cells
+		int getCellSize(void) const;
+
+		// Returns the number of cells which currently hold entities
+		unsigned int getNumCellsWithEntities(void) const;
+
+	private:
+		// Number of entities a cell can hold before it's entity array is moved onto the heap.
+		// A cell which is about the size of the queries typically holds around ten entities in a dense map, so this
+		// leaves room for most cells to never spill onto the heap.
+		static const unsigned int kInlineEntityCapacity = 16;
+
+		// A cell of the grid, stored within the cells hash table
+		struct Cell
+		{
+			int cellX;					// Coordinate of the cell along the X axis, which is the position divided by the cell size
+			int cellY;					// Coordinate of the cell along the Y axis
+			bool used;					// Whether this entry of the hash table holds a cell
+			SmallArray<QuadTreeEntity*, kInlineEntityCapacity> entities;	// The entities within this cell
+			SmallArray<int, kInlineEntityCapacity> entityPositionsX;		// Position of each entity along X, in the same order as entities
+			SmallArray<int, kInlineEntityCapacity> entityPositionsY;		// Position of each entity along Y, in the same order as entities
+		};
+
+		// Hash table of cells, the size of which is always a power of two.
+		// Entries are found by hashing the cell's coordinates and stepping forward from there until either the
+		// cell or an unused entry is found. Cells which become empty are left in the table, so that the cells
+		// after them can still be found, and are removed when the table is next rebuilt.
+		std::vector<Cell> cells;
+
+		// Number of entries within the cells hash table which are used
+		unsigned int numUsedCells;
+
+		// Width and height of each cell
+		// Set during construction
+		int cellSize;
+
+		// A slot which holds an entity, the index of which is stored within the entity's handle
+		struct EntitySlot
+		{
+			QuadTreeEntity* entity;		// Pointer to the entity in this slot, or 0 if the slot is unused
+			unsigned int generation;	// Increased each time the slot's entity is removed, to invalidate old handles
+		};
+
+		// Slots holding pointers to each of the added entities, indexed by the entity handles.
+		std::vector<EntitySlot> entitySlots;
+
+		// Indicies of slots within entitySlots which are no longer used and can be reused
+		std::vector<unsigned int> freeEntitySlots;
+
+		// Hashmap holding the handle of each of the named entities
+		std::map<std::wstring, SpatialEntityHandle> entityNames;
+
+		// Returns the coordinate of the cell which the given position is inside of, along one axis
+		int computeCellCoordinate(int position) const;
+
+		// Returns the index within the cells hash table which the search for the given cell starts at
+		unsigned int computeCellHash(int cellX, int cellY) const;
+
+		// Returns the index of the given cell within the cells hash table, or -1 if it doesn't exist
+		int findCell(int cellX, int cellY) const;
+
+		// Returns the index of the given cell within the cells hash table, adding the cell if it doesn't exist.
+		// This may rebuild the hash table, so any references to cells are invalid afterwards.
+		unsigned int findOrAddCell(int cellX, int cellY);
+
+		// Rebuilds the cells hash table, leaving out any cells which no longer hold any entities and making the
+		// table large enough that it is no more than half full.
+		void rebuildCells(void);
+
+		// Adds an entity into the cell which it's position is inside of
+		void addEntityToCell(QuadTreeEntity* entity);
+
+		// Removes an entity from the cell it is in
+		// If the entity couldn't be found, an exception occurs
+		void removeEntityFromCell(QuadTreeEntity* entity);
+
+		// Returns a pointer to the entity with the given handle, or 0 if the handle is invalid or the entity has been removed
+		QuadTreeEntity* findEntity(SpatialEntityHandle handle) const;
+
+		// Creates a new entity and places it into a slot, but does not add it to a cell
+		QuadTreeEntity* createEntity(const std::wstring& name, int positionX, int positionY, int userData, void* pUserData);
+
+		// Deletes the given entity and frees it's slot, increasing the slot's generation
+		// The entity must have already been removed from it's cell
+		void deleteEntity(QuadTreeEntity* entity);
+
+		// Calls the given visitor for each cell which holds entities and is covered by the given rect.
+		// If the rect covers more cells than there are entries in the hash table, each entry of the hash table is
+		// checked instead of looking up each of the cells which the rect covers.
+		template <typename Visitor> void visitCellsWhichIntersect(const Rect& rect, Visitor& visitor) const;
+	};
+
+	template <typename Visitor>
+	void SpatialHashGrid2D::visitEntitiesWithinRange(int positionXPARAM, int positionYPARAM, int rangePARAM, Visitor&& visitorPARAM) const
+	{
+		// Create a rect which covers the maximum range from the given position
+		Rect rectRange;
+		rectRange.minX = positionXPARAM - rangePARAM;
+		rectRange.maxX = positionXPARAM + rangePARAM;
+		rectRange.minY = positionYPARAM - rangePARAM;
+		rectRange.maxY = positionYPARAM + rangePARAM;
+		visitEntitiesWithinRect(rectRange, visitorPARAM);
+	}
+
+	template <typename Visitor>
+	void SpatialHashGrid2D::visitEntitiesWithinRect(const Rect& rectPARAM, Visitor&& visitorPARAM) const
+	{
+		auto visitCell = [&visitorPARAM](const Cell& cell)
+		{
+			for (unsigned int i = 0; i < cell.entities.size(); i++)
+				visitorPARAM(cell.entities[i]);
+		};
+		visitCellsWhichIntersect(rectPARAM, visitCell);
+	}
+
+	template <typename Visitor>
+	void SpatialHashGrid2D::visitCellsWhichIntersect(const Rect& rectPARAM, Visitor& visitorPARAM) const
+	{
+		if (!numUsedCells)
+			return;
+
+		int minCellX = computeCellCoordinate(rectPARAM.minX);
+		int minCellY = computeCellCoordinate(rectPARAM.minY);
+		int maxCellX = computeCellCoordinate(rectPARAM.maxX);
+		int maxCellY = computeCellCoordinate(rectPARAM.maxY);
+
+		// If the rect covers lots of cells, it's quicker to go through the hash table
+		long long numCellsCovered = ((long long)maxCellX - minCellX + 1) * ((long long)maxCellY - minCellY + 1);
+		if (numCellsCovered >= (long long)cells.size())
+		{
+			for (size_t i = 0; i < cells.size(); i++)
+			{
+				const Cell& cell = cells[i];
+				if (!cell.used || cell.entities.empty())
+					continue;
+				if (cell.cellX < minCellX || cell.cellX > maxCellX || cell.cellY < minCellY || cell.cellY > maxCellY)
+					continue;
+				visitorPARAM(cell);
+			}
+			return;
+		}
+
+		// Otherwise, look up each of the cells which the rect covers
+		for (int cellY = minCellY; cellY <= maxCellY; cellY++)
+		{
+			for (int cellX = minCellX; cellX <= maxCellX; cellX++)
+			{
+				int cellIndex = findCell(cellX, cellY);
+				if (cellIndex >= 0 && !cells[cellIndex].entities.empty())
+					visitorPARAM(cells[cellIndex]);
+			}
+		}
+	}
+}
\ No newline at end of file
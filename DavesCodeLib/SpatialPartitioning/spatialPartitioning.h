@@ -1,7 +1,12 @@
 #pragma once
+#include "BVH.h"
+#include "linearOctTree.h"
 #include "octTree.h"
 #include "octTreeEntity.h"
 #include "octTreeNode.h"
 #include "quadTree.h"
 #include "quadTreeEntity.h"
 #include "quadTreeNode.h"
+#include "spatialEntityHandle.h"
+#include "spatialHashGrid2D.h"
+#include "sweepAndPrune.h"
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "sweepAndPrune.h"
+#include "../Common/error.h"
+#include "../Math/simd.h"
+#include <algorithm>
+#include <bit>
+
+namespace DC
+{
+	SweepAndPrune::SweepAndPrune()
+	{
+		sortAxis = 0;
+	}
+
+	std::vector<std::pair<unsigned int, unsigned int>> SweepAndPrune::getOverlappingPairs(const std::vector<AABB>& aabbsPARAM)
+	{
+		std::vector<std::pair<unsigned int, unsigned int>> vResult;
+		getOverlappingPairs(aabbsPARAM, vResult);
+		return vResult;
+	}
+
+	void SweepAndPrune::getOverlappingPairs(const std::vector<AABB>& aabbsPARAM, std::vector<std::pair<unsigned int, unsigned int>>& pairsOutPARAM)
+	{
+		unsigned int numAABBs = (unsigned int)aabbsPARAM.size();
+		ErrorIfTrue(aabbsPARAM.size() != numAABBs, L"SweepAndPrune::getOverlappingPairs() failed. Too many AABBs were given.");
+
+		// Find the axis which the centres of the AABBs are most spread out along.
+		// The sums are done with doubles, as with lots of AABBs the sum of the squares loses too much precision.
+		double dSum[3] = { 0.0, 0.0, 0.0 };
+		double dSumSquared[3] = { 0.0, 0.0, 0.0 };
+		for (unsigned int i = 0; i < numAABBs; i++)
+		{
+			Vector3f vCentre = aabbsPARAM[i].getPosition();
+			float fCentre[3] = { vCentre.x, vCentre.y, vCentre.z };
+			for (int axis = 0; axis < 3; axis++)
+			{
+				dSum[axis] += fCentre[axis];
+				dSumSquared[axis] += (double)fCentre[axis] * fCentre[axis];
+			}
+		}
+		unsigned int newSortAxis = 0;
+		double dLargestVariance = -1.0;
+		for (unsigned int axis = 0; axis < 3; axis++)
+		{
+			double dVariance = dSumSquared[axis] - dSum[axis] * dSum[axis] / (numAABBs ? numAABBs : 1);
+			if (dVariance > dLargestVariance)
+			{
+				dLargestVariance = dVariance;
+				newSortAxis = axis;
+			}
+		}
+
+		// If the number of AABBs or the axis has changed, last time's order is of no use, so start again
+		bool bSortFromScratch = false;
+		if (sortedIndicies.size() != numAABBs || sortAxis != newSortAxis)
+		{
+			sortedIndicies.resize(numAABBs);
+			for (unsigned int i = 0; i < numAABBs; i++)
+				sortedIndicies[i] = i;
+			bSortFromScratch = true;
+		}
+		sortAxis = newSortAxis;
+
+		// Sort the AABBs by their minimum position along the sort axis
+		sortKeys.resize(numAABBs);
+		for (unsigned int i = 0; i < numAABBs; i++)
+		{
+			Vector3f vMin = aabbsPARAM[i].getMin();
+			sortKeys[i] = 0 == sortAxis ? vMin.x : (1 == sortAxis ? vMin.y : vMin.z);
+		}
+		sortIndicies(bSortFromScratch);
+
+		// Copy the bounds of each AABB into the arrays in sorted order, with the sort axis first
+		unsigned int otherAxisA = (sortAxis + 1) % 3;
+		unsigned int otherAxisB = (sortAxis + 2) % 3;
+		for (int i = 0; i < 3; i++)
+		{
+			sortedMin[i].resize(numAABBs);
+			sortedMax[i].resize(numAABBs);
+		}
+		for (unsigned int i = 0; i < numAABBs; i++)
+		{
+			Vector3f vMin = aabbsPARAM[sortedIndicies[i]].getMin();
+			Vector3f vMax = aabbsPARAM[sortedIndicies[i]].getMax();
+			float fMin[3] = { vMin.x, vMin.y, vMin.z };
+			float fMax[3] = { vMax.x, vMax.y, vMax.z };
+			sortedMin[0][i] = fMin[sortAxis];
+			sortedMax[0][i] = fMax[sortAxis];
+			sortedMin[1][i] = fMin[otherAxisA];
+			sortedMax[1][i] = fMax[otherAxisA];
+			sortedMin[2][i] = fMin[otherAxisB];
+			sortedMax[2][i] = fMax[otherAxisB];
+		}
+
+		// Sweep along the sort axis
+		const float* pMin0 = sortedMin[0].data();
+		const float* pMin1 = sortedMin[1].data();
+		const float* pMax1 = sortedMax[1].data();
+		const float* pMin2 = sortedMin[2].data();
+		const float* pMax2 = sortedMax[2].data();
+		const int kAllMask = (1 << kSIMDWidth) - 1;
+		for (unsigned int i = 0; i < numAABBs; i++)
+		{
+			unsigned int index = sortedIndicies[i];
+			float fMax0 = sortedMax[0][i];
+			SIMDFloats vMax0 = simdSet(fMax0);
+			SIMDFloats vMin1 = simdSet(pMin1[i]);
+			SIMDFloats vMax1 = simdSet(pMax1[i]);
+			SIMDFloats vMin2 = simdSet(pMin2[i]);
+			SIMDFloats vMax2 = simdSet(pMax2[i]);
+
+			// Test the AABBs after this one, kSIMDWidth at a time, until one starts past this one's maximum.
+			// As the AABBs are sorted, all of the AABBs after that one also start past it.
+			bool bSweepDone = false;
+			unsigned int j = i + 1;
+			for (; j + kSIMDWidth <= numAABBs; j += kSIMDWidth)
+			{
+				int beyondMask = ~simdGetLessOrEqualMask(simdLoadUnaligned(pMin0 + j), vMax0) & kAllMask;
+				SIMDInts vOverlaps = simdAndInts(simdCompareLessOrEqual(simdLoadUnaligned(pMin1 + j), vMax1), simdCompareGreaterOrEqual(simdLoadUnaligned(pMax1 + j), vMin1));
+				vOverlaps = simdAndInts(vOverlaps, simdAndInts(simdCompareLessOrEqual(simdLoadUnaligned(pMin2 + j), vMax2), simdCompareGreaterOrEqual(simdLoadUnaligned(pMax2 + j), vMin2)));
+				int mask = simdGetMask(vOverlaps) & ~beyondMask;
+				while (mask)
+				{
+					unsigned int k = (unsigned int)std::countr_zero((unsigned int)mask);
+					mask &= mask - 1;
+					unsigned int otherIndex = sortedIndicies[j + k];
+					pairsOutPARAM.push_back(index < otherIndex ? std::pair<unsigned int, unsigned int>(index, otherIndex) : std::pair<unsigned int, unsigned int>(otherIndex, index));
+				}
+				if (beyondMask)
+				{
+					bSweepDone = true;
+					break;
+				}
+			}
+			if (bSweepDone)
+				continue;
+
+			// Then test the remaining AABBs one at a time
+			for (; j < numAABBs; j++)
+			{
+				if (pMin0[j] > fMax0)
+					break;
+				if (pMin1[j] > pMax1[i] || pMax1[j] < pMin1[i] || pMin2[j] > pMax2[i] || pMax2[j] < pMin2[i])
+					continue;
+				unsigned int otherIndex = sortedIndicies[j];
+				pairsOutPARAM.push_back(index < otherIndex ? std::pair<unsigned int, unsigned int>(index, otherIndex) : std::pair<unsigned int, unsigned int>(otherIndex, index));
+			}
+		}
+	}
+
+	void SweepAndPrune::free(void)
+	{
+		sortedIndicies.clear();
+		sortedIndicies.shrink_to_fit();
+		sortKeys.clear();
+		sortKeys.shrink_to_fit();
+		for (int i = 0; i < 3; i++)
+		{
+			sortedMin[i].clear();
+			sortedMin[i].shrink_to_fit();
+			sortedMax[i].clear();
+			sortedMax[i].shrink_to_fit();
+		}
+	}
+
+	unsigned int SweepAndPrune::getSortAxis(void) const
+	{
+		return sortAxis;
+	}
+
+	void SweepAndPrune::sortIndicies(bool sortFromScratchPARAM)
+	{
+		const float* pKeys = sortKeys.data();
+		size_t numIndicies = sortedIndicies.size();
+
+		// Insertion sort, giving up if the AABBs have moved too far since last time
+		if (!sortFromScratchPARAM)
+		{
+			size_t maxMoves = numIndicies * kMaxInsertionSortMovesPerAABB;
+			size_t numMoves = 0;
+			for (size_t i = 1; i < numIndicies; i++)
+			{
+				unsigned int index = sortedIndicies[i];
+				float fKey = pKeys[index];
+				size_t j = i;
+				while (j > 0 && pKeys[sortedIndicies[j - 1]] > fKey)
+				{
+					sortedIndicies[j] = sortedIndicies[j - 1];
+					j--;
+				}
+				sortedIndicies[j] = index;
+				numMoves += i - j;
+				if (numMoves > maxMoves)
+				{
+					sortFromScratchPARAM = true;
+					break;
+				}
+			}
+			if (!sortFromScratchPARAM)
+				return;
+		}
+
+		std::sort(sortedIndicies.begin(), sortedIndicies.end(), [pKeys](unsigned int indexA, unsigned int indexB)
+			{
+				return pKeys[indexA] < pKeys[indexB];
+			});
+	}
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+#include "../Math/AABB.h"
+#include <utility>
+#include <vector>
+
+namespace DC
+{
+	// Sweep and prune, used as the broad phase of collision detection to quickly find which of lots of AABBs
+	// intersect each other, without having to test every AABB against every other one.
+	//
+	// The AABBs are sorted by their minimum position along one axis. Then for each AABB in turn, the AABBs after it
+	// in the sorted order are swept through until one is found whose minimum is past the AABB's maximum along that
+	// axis, as neither it, nor any of the AABBs after it, can intersect. Only the AABBs before that one are tested
+	// along the other two axes, several at a time with the SIMD instructions chosen by Math/simd.h.
+	// The axis which the centres of the AABBs are most spread out along is used, as that's the one along which
+	// the fewest AABBs overlap.
+	//
+	// The sorted order is kept between calls to getOverlappingPairs(). As objects usually only move a little each
+	// frame, last frame's order is nearly sorted already and is sorted again with an insertion sort, which is close
+	// to linear time when that's the case. If the number of AABBs or the axis has changed, or the insertion sort has
+	// to move the AABBs too far, they are sorted from scratch instead.
+	//
+	// Unlike OctTree::getEntityPairsWithinRange(), there's no tree which needs to be kept up to date as objects
+	// move, so this is best suited to when most of the objects move each frame.
+	// As only one axis is swept, each AABB is tested against all of the others which overlap it along that axis,
+	// however far apart they are along the other two. With lots of small objects spread evenly through a large 3D
+	// world, that's a lot of AABBs and OctTree::getEntityPairsWithinRange() is faster.
+	//
+	// Example:
+	// SweepAndPrune sweepAndPrune;
+	// std::vector<std::pair<unsigned int, unsigned int>> pairs;
+	// Each frame...
+	// pairs.clear();
+	// sweepAndPrune.getOverlappingPairs(aabbs, pairs);
+	// for (size_t i = 0; i < pairs.size(); i++)
+	//     Perform the narrow phase of collision detection between objects pairs[i].first and pairs[i].second
+	class SweepAndPrune
+	{
+	public:
+		// Constructor
+		SweepAndPrune();
+
+		// Returns each pair of the given AABBs which intersect each other, including those which only touch.
+		// Each pair holds the indicies of the two AABBs within the given vector, with the smaller index first, and
+		// each pair is only returned once. The order of the pairs is undefined.
+		std::vector<std::pair<unsigned int, unsigned int>> getOverlappingPairs(const std::vector<AABB>& aabbs);
+
+		// The same as the above, except that the pairs are added to the end of the given vector instead.
+		// The vector is not cleared first.
+		// Keeping the same vector around and clearing it before each call means that once it has grown large
+		// enough, finding the pairs doesn't allocate any memory.
+		void getOverlappingPairs(const std::vector<AABB>& aabbs, std::vector<std::pair<unsigned int, unsigned int>>& pairsOut);
+
+		// Frees the memory used to store the sorted order of the AABBs.
+		// The next call to getOverlappingPairs() sorts the AABBs from scratch.
+		void free(void);
+
+		// Returns the axis which the AABBs were sorted along by the last call to getOverlappingPairs().
+		// 0 for X, 1 for Y and 2 for Z.
+		unsigned int getSortAxis(void) const;
+	private:
+		// The maximum average number of places each AABB may be moved by the insertion sort before it gives up and
+		// the AABBs are sorted from scratch instead.
+		static const unsigned int kMaxInsertionSortMovesPerAABB = 8;
+
+		// Axis the AABBs are sorted along
+		unsigned int sortAxis;
+
+		// The indicies of the AABBs within the vector given to getOverlappingPairs(), in sorted order.
+		// This is kept between calls so the AABBs don't have to be sorted from scratch each time.
+		std::vector<unsigned int> sortedIndicies;
+
+		// The minimum position of each AABB along the sort axis, in the same order as the vector given to
+		// getOverlappingPairs(). Used as the key when sorting.
+		std::vector<float> sortKeys;
+
+		// The bounds of each AABB along each axis, in sorted order.
+		// Index 0 is the sort axis and indicies 1 and 2 are the other two axes.
+		// These are stored seperately so that several AABBs at a time can be loaded into a SIMD register.
+		std::vector<float> sortedMin[3];
+		std::vector<float> sortedMax[3];
+
+		// Sorts sortedIndicies by sortKeys, using an insertion sort if possible.
+		// If sortFromScratch is true, or the insertion sort gives up, std::sort is used instead.
+		void sortIndicies(bool sortFromScratch);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "allocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace DCTests
+{
+	namespace
+	{
+		std::atomic<size_t> numAllocations(0);
+
+		void* allocate(size_t sizePARAM)
+		{
+			numAllocations.fetch_add(1, std::memory_order_relaxed);
+			void* pMemory = malloc(sizePARAM ? sizePARAM : 1);
+			if (!pMemory)
+				throw std::bad_alloc();
+			return pMemory;
+		}
+
+		void* allocateAligned(size_t sizePARAM, std::align_val_t alignmentPARAM)
+		{
+			numAllocations.fetch_add(1, std::memory_order_relaxed);
+			size_t alignment = (size_t)alignmentPARAM;
+			size_t size = (sizePARAM + alignment - 1) / alignment * alignment;
+#ifdef _MSC_VER
+			void* pMemory = _aligned_malloc(size ? size : alignment, alignment);
+#else
+			void* pMemory = aligned_alloc(alignment, size ? size : alignment);
+#endif
+			if (!pMemory)
+				throw std::bad_alloc();
+			return pMemory;
+		}
+
+		void freeAligned(void* pMemoryPARAM)
+		{
+#ifdef _MSC_VER
+			_aligned_free(pMemoryPARAM);
+#else
+			free(pMemoryPARAM);
+#endif
+		}
+	}
+
+	size_t getNumAllocations(void)
+	{
+		return numAllocations.load(std::memory_order_relaxed);
+	}
+}
+
+// The replacements of the global operators.
+// The nothrow versions aren't replaced, as the standard ones call these.
+void* operator new(size_t size) { return DCTests::allocate(size); }
+void* operator new[](size_t size) { return DCTests::allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return DCTests::allocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return DCTests::allocateAligned(size, alignment); }
+void operator delete(void* pMemory) noexcept { free(pMemory); }
+void operator delete[](void* pMemory) noexcept { free(pMemory); }
+void operator delete(void* pMemory, size_t) noexcept { free(pMemory); }
+void operator delete[](void* pMemory, size_t) noexcept { free(pMemory); }
+void operator delete(void* pMemory, std::align_val_t) noexcept { DCTests::freeAligned(pMemory); }
+void operator delete[](void* pMemory, std::align_val_t) noexcept { DCTests::freeAligned(pMemory); }
+void operator delete(void* pMemory, size_t, std::align_val_t) noexcept { DCTests::freeAligned(pMemory); }
+void operator delete[](void* pMemory, size_t, std::align_val_t) noexcept { DCTests::freeAligned(pMemory); }
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+
+// The tests replace the global operator new and delete with ones which count the number of allocations made, so that
+// the tests can check that something doesn't allocate any memory.
+//
+// Example:
+// size_t numAllocations = DCTests::getNumAllocations();
+// octTree.getEntitiesWithinRange(position, range, entities);
+// TestCheck(DCTests::getNumAllocations() == numAllocations);
+namespace DCTests
+{
+	// Returns the number of times memory has been allocated with operator new, by any thread, since the program started
+	size_t getNumAllocations(void);
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "tests.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _DEBUG
+#pragma comment(lib, "../_build/DavesCodeLib/OutputDir/x64/Debug/DavesCodeLib.lib")
+#else
+#pragma comment(lib, "../_build/DavesCodeLib/OutputDir/x64/Release/DavesCodeLib.lib")
+#endif
+
+namespace DCTests
+{
+	namespace
+	{
+		// Number of checks which have failed within the currently running test
+		unsigned int numFailedChecks = 0;
+	}
+
+	std::vector<Test>& getTests(void)
+	{
+		// Created upon first use, as the tests are registered before main() is called
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	TestRegistrar::TestRegistrar(const char* namePARAM, TestFunction functionPARAM)
+	{
+		getTests().push_back(Test{ namePARAM, functionPARAM });
+	}
+
+	void check(bool conditionPARAM, const char* conditionTextPARAM, const char* fileNamePARAM, int lineNumberPARAM)
+	{
+		if (conditionPARAM)
+			return;
+		numFailedChecks++;
+		printf("    FAILED: %s\n    %s(%d)\n", conditionTextPARAM, fileNamePARAM, lineNumberPARAM);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : 0;
+	unsigned int numTestsRun = 0;
+	unsigned int numTestsFailed = 0;
+	for (const DCTests::Test& test : DCTests::getTests())
+	{
+		if (filter && !strstr(test.name, filter))
+			continue;
+		printf("%s\n", test.name);
+		DCTests::numFailedChecks = 0;
+		test.function();
+		numTestsRun++;
+		if (DCTests::numFailedChecks)
+			numTestsFailed++;
+	}
+	printf("%u of %u tests passed.\n", numTestsRun - numTestsFailed, numTestsRun);
+	return (int)numTestsFailed;
+}
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "tests.h"
+#include "../DavesCodeLib/Math/fastMath.h"
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace DC;
+
+// Checks the maximum errors given in fastMath.h, against the standard library's double precision functions.
+// Rather than every float in each range, which would take far too long, every few hundredth float is checked, which
+// is still a couple of million values spread evenly across every exponent in the range.
+namespace
+{
+	// Number of floats skipped between each of the values checked
+	const unsigned int kStride = 601;
+
+	// Calls function(value) for every kStride'th float from first to last, both of which must be positive, and for the
+	// negative of each of them if bNegativeToo is true
+	template <typename Function> void forEachFloat(float firstPARAM, float lastPARAM, bool bNegativeTooPARAM, Function functionPARAM)
+	{
+		unsigned int first = std::bit_cast<unsigned int>(firstPARAM);
+		unsigned int last = std::bit_cast<unsigned int>(lastPARAM);
+		for (unsigned int bits = first; bits <= last && bits >= first; bits += kStride)
+		{
+			float fValue = std::bit_cast<float>(bits);
+			functionPARAM(fValue);
+			if (bNegativeTooPARAM)
+				functionPARAM(-fValue);
+		}
+		functionPARAM(lastPARAM);
+		if (bNegativeTooPARAM)
+			functionPARAM(-lastPARAM);
+	}
+
+	// Returns the relative error of the given value
+	double getRelativeError(float valuePARAM, double expectedPARAM)
+	{
+		return fabs(((double)valuePARAM - expectedPARAM) / expectedPARAM);
+	}
+
+	// Prints the maximum error found by one of the tests, so that it can be compared with the one given in fastMath.h
+	void printMaxError(const char* functionNamePARAM, const char* errorTypePARAM, double maxErrorPARAM)
+	{
+		printf("    %s maximum %s error: %g\n", functionNamePARAM, errorTypePARAM, maxErrorPARAM);
+	}
+
+	// Returns the given number of random values between the given minimum and maximum
+	std::vector<float> createRandomValues(size_t numValuesPARAM, float minPARAM, float maxPARAM)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> value(minPARAM, maxPARAM);
+		std::vector<float> values(numValuesPARAM);
+		for (size_t i = 0; i < numValuesPARAM; i++)
+			values[i] = value(random);
+		return values;
+	}
+}
+
+DC_TEST(fastMathRsqrtAndSqrtAccuracy)
+{
+	double dMaxRsqrtError = 0.0;
+	double dMaxSqrtError = 0.0;
+	forEachFloat(FLT_MIN, FLT_MAX, false, [&](float fValue)
+		{
+			double dExpected = std::sqrt((double)fValue);
+			dMaxRsqrtError = std::max(dMaxRsqrtError, getRelativeError(FastMath::rsqrt(fValue), 1.0 / dExpected));
+			dMaxSqrtError = std::max(dMaxSqrtError, getRelativeError(FastMath::sqrt(fValue), dExpected));
+		});
+	printMaxError("rsqrt()", "relative", dMaxRsqrtError);
+	printMaxError("sqrt()", "relative", dMaxSqrtError);
+	TestCheck(dMaxRsqrtError < 5e-6);
+	TestCheck(dMaxSqrtError < 5e-6);
+	TestCheck(0.0f == FastMath::sqrt(0.0f));
+}
+
+DC_TEST(fastMathSinCosAccuracy)
+{
+	double dMaxSinError = 0.0;
+	double dMaxCosError = 0.0;
+	auto check = [&](float fValue)
+		{
+			float fSin, fCos;
+			FastMath::sincos(fSin, fCos, fValue);
+			dMaxSinError = std::max(dMaxSinError, fabs(fSin - std::sin((double)fValue)));
+			dMaxCosError = std::max(dMaxCosError, fabs(fCos - std::cos((double)fValue)));
+			TestCheck(FastMath::sin(fValue) == fSin);
+			TestCheck(FastMath::cos(fValue) == fCos);
+		};
+	check(0.0f);
+	forEachFloat(FLT_MIN, 8192.0f, true, check);
+	printMaxError("sin()", "absolute", dMaxSinError);
+	printMaxError("cos()", "absolute", dMaxCosError);
+	TestCheck(dMaxSinError < 1e-7);
+	TestCheck(dMaxCosError < 1e-7);
+}
+
+DC_TEST(fastMathExpAccuracy)
+{
+	double dMaxError = 0.0;
+	auto check = [&](float fValue)
+		{
+			dMaxError = std::max(dMaxError, getRelativeError(FastMath::exp(fValue), std::exp((double)fValue)));
+		};
+	check(0.0f);
+	forEachFloat(FLT_MIN, 87.0f, true, check);
+	forEachFloat(87.0f, 88.0f, false, check);
+	printMaxError("exp()", "relative", dMaxError);
+	TestCheck(dMaxError < 1e-7);
+
+	// Outside of the range, the values are clamped
+	TestCheck(FastMath::exp(1000.0f) == FastMath::exp(88.0f));
+	TestCheck(FastMath::exp(-1000.0f) == FastMath::exp(-87.0f));
+	TestCheck(FastMath::exp(-1000.0f) > 0.0f);
+}
+
+DC_TEST(fastMathSigmoidAccuracy)
+{
+	double dMaxError = 0.0;
+	auto check = [&](float fValue)
+		{
+			double dExpected = 1.0 / (1.0 + std::exp(-(double)fValue));
+			dMaxError = std::max(dMaxError, fabs(FastMath::sigmoid(fValue) - dExpected));
+		};
+	check(0.0f);
+	forEachFloat(FLT_MIN, FLT_MAX, true, check);
+	printMaxError("sigmoid()", "absolute", dMaxError);
+	TestCheck(dMaxError < 1e-7);
+}
+
+// Vectors of every magnitude from about 1.1e-19 to 1.8e19, the range given in fastMath.h
+DC_TEST(fastMathVectorAccuracy)
+{
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+	std::uniform_int_distribution<int> exponent(-66, 66);
+	double dMaxNormaliseError = 0.0;
+	double dMaxMagnitudeError = 0.0;
+	for (int i = 0; i < 1000000; i++)
+	{
+		float fScale = ldexpf(1.0f, exponent(random));
+		Vector3f vector(component(random) * fScale, component(random) * fScale, component(random) * fScale);
+		double dMagnitude = std::sqrt((double)vector.x * vector.x + (double)vector.y * vector.y + (double)vector.z * vector.z);
+		if (dMagnitude < 1.1e-19 || dMagnitude > 1.8e19)
+			continue;
+		dMaxMagnitudeError = std::max(dMaxMagnitudeError, getRelativeError(FastMath::getMagnitude(vector), dMagnitude));
+		FastMath::normalise(vector);
+		double dNormalisedMagnitude = std::sqrt((double)vector.x * vector.x + (double)vector.y * vector.y + (double)vector.z * vector.z);
+		dMaxNormaliseError = std::max(dMaxNormaliseError, fabs(dNormalisedMagnitude - 1.0));
+	}
+	printMaxError("normalise()", "magnitude", dMaxNormaliseError);
+	printMaxError("getMagnitude()", "relative", dMaxMagnitudeError);
+	TestCheck(dMaxNormaliseError < 5e-6);
+	TestCheck(dMaxMagnitudeError < 5e-6);
+
+	// Vectors which are too small are left unchanged
+	Vector3f vTiny(1e-20f, 0.0f, 0.0f);
+	FastMath::normalise(vTiny);
+	TestCheck(1e-20f == vTiny.x);
+}
+
+// The functions which take spans must give exactly the same results as the single value versions.
+// The number of values isn't a multiple of the SIMD width, so that the leftover values are checked too.
+DC_TEST(fastMathSpansMatchSingleValues)
+{
+	const size_t kNumValues = 10007;
+	std::vector<float> angles = createRandomValues(kNumValues, -8192.0f, 8192.0f);
+	std::vector<float> positives = createRandomValues(kNumValues, 0.001f, 1000000.0f);
+	std::vector<float> exponents = createRandomValues(kNumValues, -100.0f, 100.0f);
+	std::vector<float> out(kNumValues);
+	std::vector<float> out2(kNumValues);
+
+	FastMath::rsqrt(positives, out);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::rsqrt(positives[i]) == out[i]);
+	FastMath::sqrt(positives, out);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::sqrt(positives[i]) == out[i]);
+	FastMath::sin(angles, out);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::sin(angles[i]) == out[i]);
+	FastMath::cos(angles, out);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::cos(angles[i]) == out[i]);
+	FastMath::sincos(angles, out, out2);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::sin(angles[i]) == out[i] && FastMath::cos(angles[i]) == out2[i]);
+	FastMath::exp(exponents, out);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::exp(exponents[i]) == out[i]);
+	FastMath::sigmoid(exponents, out);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::sigmoid(exponents[i]) == out[i]);
+	FastMath::sigmoid(exponents, out, 2.5f);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::sigmoid(exponents[i], 2.5f) == out[i]);
+
+	// In place
+	out = angles;
+	FastMath::sin(out, out);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::sin(angles[i]) == out[i]);
+
+	Vector3fArray vectors(kNumValues);
+	for (size_t i = 0; i < kNumValues; i++)
+		vectors.set(i, Vector3f(angles[i], exponents[i], i % 100 ? positives[i] : 0.0f));
+	FastMath::getMagnitude(vectors, out);
+	for (size_t i = 0; i < kNumValues; i++)
+		TestCheck(FastMath::getMagnitude(vectors.get(i)) == out[i]);
+	Vector3fArray normalised = vectors;
+	FastMath::normalise(normalised);
+	for (size_t i = 0; i < kNumValues; i++)
+	{
+		Vector3f vExpected = vectors.get(i);
+		FastMath::normalise(vExpected);
+		Vector3f vActual = normalised.get(i);
+		TestCheck(vExpected.x == vActual.x && vExpected.y == vActual.y && vExpected.z == vActual.z);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "tests.h"
+#include "../DavesCodeLib/Common/utilities.h"
+#include "../DavesCodeLib/Image/image2D.h"
+#include "../DavesCodeLib/Math/simd.h"
+#include <cstring>
+#include <random>
+#include <utility>
+
+using namespace DC;
+
+// Checks that the colour operations of Image2D, which use SIMD and split the image between threads, give exactly the
+// same bytes as the scalar code they replaced, which is written out again below as the reference for each of them,
+// whichever instruction set they use.
+namespace
+{
+	// Size of the images the tests use.
+	// The width isn't a multiple of any SIMD width, so that the leftover pixels at the end of each band of rows are
+	// checked too and there are enough pixels for parallelFor() to split the image between two threads.
+	const unsigned int kWidth = 301;
+	const unsigned int kHeight = 467;
+
+	// Creates the given image and fills it with random values
+	void createRandomImage(Image2D& imagePARAM, unsigned short numberOfChannelsPARAM)
+	{
+		imagePARAM.createBlank(kWidth, kHeight, numberOfChannelsPARAM);
+		std::mt19937 random(1);
+		std::uniform_int_distribution<int> value(0, 255);
+		unsigned char* pData = imagePARAM.getData();
+		for (unsigned int i = 0; i < imagePARAM.getDataSize(); i++)
+			pData[i] = (unsigned char)value(random);
+	}
+
+	// Each of the instruction sets which the colour operations choose between while the program is running
+	const SIMDInstructionSet kInstructionSets[] = { SIMDInstructionSet::SCALAR, SIMDInstructionSet::SSE4_1, SIMDInstructionSet::AVX2 };
+
+	// Calls operation(image, numThreads) on a random image with the given number of channels, with one thread and with
+	// four and with each of the instruction sets which the CPU supports, and checks that the image is then exactly the
+	// same as a copy of it which had reference(pPixel) called for each of it's pixels
+	template <typename Operation, typename Reference> void checkMatchesReference(unsigned short numberOfChannelsPARAM, Operation operationPARAM, Reference referencePARAM)
+	{
+		for (SIMDInstructionSet instructionSet : kInstructionSets)
+		{
+			simdLimitInstructionSet(instructionSet);
+			for (unsigned int numThreads : { 1u, 4u })
+			{
+				Image2D image;
+				createRandomImage(image, numberOfChannelsPARAM);
+				std::vector<unsigned char> expected(image.getData(), image.getData() + image.getDataSize());
+				for (size_t i = 0; i < expected.size(); i += numberOfChannelsPARAM)
+					referencePARAM(&expected[i]);
+				operationPARAM(image, numThreads);
+				TestCheck(0 == memcmp(image.getData(), expected.data(), expected.size()));
+			}
+		}
+		simdLimitInstructionSet(SIMDInstructionSet::AVX2);
+	}
+
+	// The scalar code's conversion of a grey value to unsigned char, which keeps the lowest byte of the truncated
+	// integer when the sensitivities add up to more than one
+	unsigned char toGreyByte(float valuePARAM)
+	{
+		return (unsigned char)(int)valuePARAM;
+	}
+}
+
+DC_TEST(image2DColourOperationsMatchScalarCode)
+{
+	for (unsigned short numberOfChannels = 3; numberOfChannels <= 4; numberOfChannels++)
+	{
+		checkMatchesReference(numberOfChannels, [](Image2D& image, unsigned int numThreads) { image.swapRedAndBlue(numThreads); },
+			[](unsigned char* pPixel) { std::swap(pPixel[0], pPixel[2]); });
+
+		for (int iInvert = 0; iInvert < 4; iInvert++)
+		{
+			bool bColour = 0 != (iInvert & 1);
+			bool bAlpha = 0 != (iInvert & 2);
+			checkMatchesReference(numberOfChannels, [&](Image2D& image, unsigned int numThreads) { image.invert(bColour, bAlpha, numThreads); },
+				[&](unsigned char* pPixel)
+				{
+					if (bColour)
+					{
+						for (int i = 0; i < 3; i++)
+							pPixel[i] = 255 - pPixel[i];
+					}
+					if (4 == numberOfChannels && bAlpha)
+						pPixel[3] = 255 - pPixel[3];
+				});
+		}
+
+		checkMatchesReference(numberOfChannels, [](Image2D& image, unsigned int numThreads) { image.greyscaleSimple(numThreads); },
+			[](unsigned char* pPixel)
+			{
+				float fTmp = float(pPixel[0]);
+				fTmp += float(pPixel[1]);
+				fTmp += float(pPixel[2]);
+				fTmp *= 1.0f / 3.0f;
+				pPixel[0] = pPixel[1] = pPixel[2] = (unsigned char)fTmp;
+			});
+
+		// The default sensitivities add up to more than one, so some of the grey values are more than 255
+		const float sensitivities[2][3] = { { 0.299f, 0.587f, 0.144f }, { 0.2126f, 0.7152f, 0.0722f } };
+		for (const float* pSensitivity : sensitivities)
+		{
+			checkMatchesReference(numberOfChannels, [&](Image2D& image, unsigned int numThreads) { image.greyscale(pSensitivity[0], pSensitivity[1], pSensitivity[2], numThreads); },
+				[&](unsigned char* pPixel)
+				{
+					float fTmp = float(pPixel[0]) * pSensitivity[0];
+					fTmp += float(pPixel[1]) * pSensitivity[1];
+					fTmp += float(pPixel[2]) * pSensitivity[2];
+					pPixel[0] = pPixel[1] = pPixel[2] = toGreyByte(fTmp);
+				});
+		}
+
+		for (int iBrightness : { 37, -91, 1000, -1000, 0 })
+		{
+			checkMatchesReference(numberOfChannels, [&](Image2D& image, unsigned int numThreads) { image.adjustBrightness(iBrightness, numThreads); },
+				[&](unsigned char* pPixel)
+				{
+					for (int i = 0; i < 3; i++)
+					{
+						int iCol = (int)pPixel[i] + iBrightness;
+						clamp(iCol, 0, 255);
+						pPixel[i] = (unsigned char)iCol;
+					}
+				});
+		}
+
+		for (int iContrast : { 50, -50, 100, -100, 1000 })
+		{
+			checkMatchesReference(numberOfChannels, [&](Image2D& image, unsigned int numThreads) { image.adjustContrast(iContrast, numThreads); },
+				[&](unsigned char* pPixel)
+				{
+					int iValue = iContrast;
+					clamp(iValue, -100, 100);
+					double dContrast = (100.0 + double(iValue)) * 0.01;
+					dContrast *= dContrast;
+					for (int i = 0; i < 3; i++)
+					{
+						double dPixel = double(pPixel[i]) * (1.0 / 255.0);
+						dPixel -= 0.5;
+						dPixel *= dContrast;
+						dPixel += 0.5;
+						dPixel *= 255;
+						clamp(dPixel, 0.0, 255.0);
+						pPixel[i] = (unsigned char)dPixel;
+					}
+				});
+		}
+	}
+
+	// removeAlphaChannel() changes the size of the data, so is checked on it's own
+	for (SIMDInstructionSet instructionSet : kInstructionSets)
+	{
+		simdLimitInstructionSet(instructionSet);
+		for (unsigned int numThreads : { 1u, 4u })
+		{
+			Image2D image;
+			createRandomImage(image, 4);
+			std::vector<unsigned char> expected;
+			for (unsigned int i = 0; i < image.getDataSize(); i += 4)
+				expected.insert(expected.end(), image.getData() + i, image.getData() + i + 3);
+			image.removeAlphaChannel(numThreads);
+			TestCheck(3 == image.getNumChannels());
+			TestCheck(image.getDataSize() == expected.size());
+			TestCheck(0 == memcmp(image.getData(), expected.data(), expected.size()));
+		}
+	}
+	simdLimitInstructionSet(SIMDInstructionSet::AVX2);
+}
+
+// generateMipChain() must average colours in linear space, keep the colour of transparent pixels out of the pixels
+// next to them, give the right number of levels and give the same bytes however many threads it uses.
+DC_TEST(image2DMipChain)
+{
+	std::vector<unsigned char> mipData;
+	std::vector<Image2D::MipLevel> mipLevels;
+
+	// A 2x2 black and white checkerboard averages to 50% linear brightness, which is 188 as sRGB, or 127.5 if it isn't,
+	// which may be rounded either way
+	for (unsigned short numberOfChannels = 3; numberOfChannels <= 4; numberOfChannels++)
+	{
+		Image2D image;
+		image.createBlank(2, 2, numberOfChannels);
+		for (unsigned int i = 0; i < image.getDataSize(); i++)
+		{
+			unsigned int pixel = i / numberOfChannels;
+			image.getData()[i] = (3 == i % numberOfChannels || 0 == pixel || 3 == pixel) ? 255 : 0;
+		}
+		for (Image2D::ResampleFilter filter : { Image2D::BOX, Image2D::BILINEAR, Image2D::LANCZOS3, Image2D::KAISER })
+		{
+			image.generateMipChain(mipData, mipLevels, filter, true);
+			TestCheck(2 == mipLevels.size());
+			for (unsigned short i = 0; i < 3; i++)
+				TestCheck(188 == mipData[mipLevels[1].offset + i]);
+			image.generateMipChain(mipData, mipLevels, filter, false);
+			for (unsigned short i = 0; i < 3; i++)
+				TestCheck(127 == mipData[mipLevels[1].offset + i] || 128 == mipData[mipLevels[1].offset + i]);
+			if (4 == numberOfChannels)
+				TestCheck(255 == mipData[mipLevels[1].offset + 3]);
+		}
+	}
+
+	// An image of one colour stays that colour all the way down, rather than drifting as each level is rounded
+	{
+		Image2D image;
+		image.createBlank(100, 60, 4);
+		for (unsigned int i = 0; i < image.getDataSize(); i += 4)
+		{
+			image.getData()[i] = 173;
+			image.getData()[i + 1] = 31;
+			image.getData()[i + 2] = 250;
+			image.getData()[i + 3] = 77;
+		}
+		image.generateMipChain(mipData, mipLevels);
+		for (size_t i = 0; i < mipData.size(); i += 4)
+		{
+			TestCheck(173 == mipData[i]);
+			TestCheck(31 == mipData[i + 1]);
+			TestCheck(250 == mipData[i + 2]);
+			TestCheck(77 == mipData[i + 3]);
+		}
+	}
+
+	// The left half is opaque red and the right half fully transparent green, so none of the green may appear in any
+	// of the levels
+	{
+		Image2D image;
+		image.createBlank(64, 64, 4);
+		for (unsigned int i = 0; i < image.getDataSize(); i += 4)
+		{
+			bool bLeft = (i / 4) % 64 < 32;
+			image.getData()[i] = bLeft ? 255 : 0;
+			image.getData()[i + 1] = bLeft ? 0 : 255;
+			image.getData()[i + 2] = 0;
+			image.getData()[i + 3] = bLeft ? 255 : 0;
+		}
+		for (Image2D::ResampleFilter filter : { Image2D::BOX, Image2D::KAISER })
+		{
+			image.generateMipChain(mipData, mipLevels, filter);
+			for (size_t i = 0; i < mipData.size(); i += 4)
+			{
+				if (!mipData[i + 3])
+					continue;
+				TestCheck(mipData[i] >= 254);
+				TestCheck(0 == mipData[i + 1]);
+				TestCheck(0 == mipData[i + 2]);
+			}
+		}
+	}
+
+	// Each level is half the size of the one before, rounded down but at least 1, down to 1x1, packed one after another
+	{
+		Image2D image;
+		image.createBlank(300, 17, 3);
+		image.generateMipChain(mipData, mipLevels);
+		const unsigned int expected[][2] = { { 300, 17 }, { 150, 8 }, { 75, 4 }, { 37, 2 }, { 18, 1 }, { 9, 1 }, { 4, 1 }, { 2, 1 }, { 1, 1 } };
+		TestCheck(9 == mipLevels.size());
+		size_t offset = 0;
+		for (size_t i = 0; i < mipLevels.size() && i < 9; i++)
+		{
+			TestCheck(expected[i][0] == mipLevels[i].width);
+			TestCheck(expected[i][1] == mipLevels[i].height);
+			TestCheck(offset == mipLevels[i].offset);
+			TestCheck(size_t(expected[i][0]) * expected[i][1] * 3 == mipLevels[i].size);
+			offset += mipLevels[i].size;
+		}
+		TestCheck(offset == mipData.size());
+	}
+
+	// The first level is a copy of the image and the levels are the same whether one thread is used or several.
+	// The image is large enough for the first few levels to be split between the threads.
+	for (unsigned short numberOfChannels = 3; numberOfChannels <= 4; numberOfChannels++)
+	{
+		Image2D image;
+		image.createBlank(640, 480, numberOfChannels);
+		std::mt19937 random(3);
+		for (unsigned int i = 0; i < image.getDataSize(); i++)
+			image.getData()[i] = (unsigned char)(random() & 0xFF);
+		for (Image2D::ResampleFilter filter : { Image2D::BOX, Image2D::KAISER })
+		{
+			image.generateMipChain(mipData, mipLevels, filter, true, 1);
+			TestCheck(0 == memcmp(mipData.data(), image.getData(), image.getDataSize()));
+			for (unsigned int numThreads : { 2u, 4u })
+			{
+				std::vector<unsigned char> mipDataThreaded;
+				image.generateMipChain(mipDataThreaded, mipLevels, filter, true, numThreads);
+				TestCheck(mipDataThreaded == mipData);
+			}
+		}
+	}
+}
@@ -0,0 +1,836 @@
+#include "tests.h"
+#include "../DavesCodeLib/Common/error.h"
+#include "../DavesCodeLib/Math/frustum.h"
+#include "../DavesCodeLib/Math/mathUtilities.h"
+#include "../DavesCodeLib/Math/matrix.h"
+#include "../DavesCodeLib/Math/matrixd.h"
+#include "../DavesCodeLib/Math/vector3d.h"
+#include "../DavesCodeLib/Math/vector3fArray.h"
+#include "../DavesCodeLib/Math/vector4f.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace DC;
+
+// The SIMD code paths of Matrix and Vector4f do their sums in the same order as the scalar code, so their results are
+// checked against a copy of the scalar code here, bit for bit. With DC_SIMD_SCALAR defined, these check the scalar code
+// against itself.
+namespace
+{
+	// Number of random matrices and vectors each of the tests checks
+	const int kNumRandomValues = 10000;
+
+	// Returns a matrix filled with random values between -10 and 10
+	Matrix createRandomMatrix(std::mt19937& randomPARAM)
+	{
+		std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+		float values[16];
+		for (int i = 0; i < 16; i++)
+			values[i] = value(randomPARAM);
+		Matrix matrix;
+		matrix.set(values);
+		return matrix;
+	}
+
+	// Returns a rotation, scale and translation matrix, which isn't anywhere near to being singular
+	Matrix createRandomTransform(std::mt19937& randomPARAM)
+	{
+		std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+		Matrix rotationX;
+		rotationX.setFromAxisAngleRadians(Vector3f(1.0f, 0.0f, 0.0f), value(randomPARAM) * 3.0f);
+		Matrix rotationY;
+		rotationY.setFromAxisAngleRadians(Vector3f(0.0f, 1.0f, 0.0f), value(randomPARAM) * 3.0f);
+		Matrix rotationZ;
+		rotationZ.setFromAxisAngleRadians(Vector3f(0.0f, 0.0f, 1.0f), value(randomPARAM) * 3.0f);
+		Matrix scale;
+		scale.setScale(1.5f + value(randomPARAM), 1.5f + value(randomPARAM), 1.5f + value(randomPARAM));
+		Matrix translation;
+		translation.setTranslation(value(randomPARAM) * 100.0f, value(randomPARAM) * 100.0f, value(randomPARAM) * 100.0f);
+		return translation * rotationZ * rotationY * rotationX * scale;
+	}
+
+	// Returns a frustum for a camera at the given position, looking at the given target
+	Frustum createFrustum(const Vector3f& positionPARAM, const Vector3f& targetPARAM)
+	{
+		Matrix matrixView;
+		matrixView.setViewLookat(positionPARAM, targetPARAM);
+		Matrix matrixProjection;
+		matrixProjection.setProjectionPerspective(60.0f, 1.0f, 500.0f, 1.5f);
+		Frustum frustum;
+		frustum.computeFromViewProjection(matrixView, matrixProjection);
+		return frustum;
+	}
+
+	// Returns whether the given sphere is visible, tested against each of the frustum's planes one at a time
+	bool isSphereVisible(const Frustum& frustumPARAM, const Vector3f& centrePARAM, float radiusPARAM)
+	{
+		const Plane* pPlanes[6] = { &frustumPARAM.planeNear, &frustumPARAM.planeFar, &frustumPARAM.planeLeft, &frustumPARAM.planeRight, &frustumPARAM.planeTop, &frustumPARAM.planeBottom };
+		for (int plane = 0; plane < 6; plane++)
+		{
+			if (pPlanes[plane]->getDistanceFromPlane(centrePARAM) + radiusPARAM < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	// An errorFunc which throws the error's description, so that a test can check that an error occurs by catching it
+	void throwError(const std::wstring& errorDescriptionPARAM, const std::wstring&, const std::wstring&)
+	{
+		throw errorDescriptionPARAM;
+	}
+
+	// Returns whether the given bit is set in the bits given by the batch visibility methods of Frustum
+	bool isBitSet(const std::vector<unsigned int>& bitsPARAM, size_t indexPARAM)
+	{
+		return 0 != (bitsPARAM[indexPARAM / 32] & (1u << (indexPARAM % 32)));
+	}
+
+	// Returns whether the given matrix holds exactly the given values
+	bool isBitIdentical(const Matrix& matrixPARAM, const float valuesPARAM[16])
+	{
+		return 0 == memcmp(matrixPARAM.getFloat(), valuesPARAM, sizeof(float) * 16);
+	}
+
+	// Returns whether the given vector holds exactly the given values
+	bool isBitIdentical(const Vector4f& vectorPARAM, float xPARAM, float yPARAM, float zPARAM, float wPARAM)
+	{
+		float values[4] = { xPARAM, yPARAM, zPARAM, wPARAM };
+		return 0 == memcmp(&vectorPARAM.x, values, sizeof(values));
+	}
+
+	// Returns whether the given vectors hold exactly the same values
+	bool isBitIdentical(const Vector3f& vectorPARAM, const Vector3f& expectedPARAM)
+	{
+		return 0 == memcmp(&vectorPARAM.x, &expectedPARAM.x, sizeof(float) * 3);
+	}
+
+	// Returns whether each vector of the given array holds exactly the same values as the given vectors, and that
+	// everything after them in each of the x, y and z arrays is zero, with it's sign bit clear too.
+	bool isBitIdentical(const Vector3fArray& vectorsPARAM, const std::vector<Vector3f>& expectedPARAM)
+	{
+		if (vectorsPARAM.size() != expectedPARAM.size())
+			return false;
+		for (size_t i = 0; i < expectedPARAM.size(); i++)
+		{
+			if (!isBitIdentical(vectorsPARAM.get(i), expectedPARAM[i]))
+				return false;
+		}
+		const float* pComponents[3] = { vectorsPARAM.getX(), vectorsPARAM.getY(), vectorsPARAM.getZ() };
+		for (int component = 0; component < 3; component++)
+		{
+			if (0 != ((size_t)pComponents[component] & 31))
+				return false;
+			const float fZero = 0.0f;
+			for (size_t i = vectorsPARAM.size(); i < vectorsPARAM.getCapacity(); i++)
+			{
+				if (0 != memcmp(&pComponents[component][i], &fZero, sizeof(float)))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Returns whether the given values are exactly the same
+	bool isBitIdentical(const std::vector<float>& valuesPARAM, const std::vector<float>& expectedPARAM)
+	{
+		return valuesPARAM.size() == expectedPARAM.size() && (valuesPARAM.empty() || 0 == memcmp(valuesPARAM.data(), expectedPARAM.data(), sizeof(float) * valuesPARAM.size()));
+	}
+
+	// The scalar code of Matrix::operator*()
+	void multiplyScalar(const float* mPARAM, const float* nPARAM, float* pResultPARAM)
+	{
+		for (int iColumn = 0; iColumn < 4; iColumn++)
+		{
+			for (int iRow = 0; iRow < 4; iRow++)
+			{
+				pResultPARAM[iColumn * 4 + iRow] = mPARAM[iRow] * nPARAM[iColumn * 4] + mPARAM[4 + iRow] * nPARAM[iColumn * 4 + 1] +
+					mPARAM[8 + iRow] * nPARAM[iColumn * 4 + 2] + mPARAM[12 + iRow] * nPARAM[iColumn * 4 + 3];
+			}
+		}
+	}
+
+	// The scalar code of Matrix::inverse()
+	void inverseScalar(const float* mPARAM, float* pResultPARAM)
+	{
+		const float* m = mPARAM;
+		float coef00 = m[10] * m[15] - m[14] * m[11];
+		float coef02 = m[6] * m[15] - m[14] * m[7];
+		float coef03 = m[6] * m[11] - m[10] * m[7];
+		float coef04 = m[9] * m[15] - m[13] * m[11];
+		float coef06 = m[5] * m[15] - m[13] * m[7];
+		float coef07 = m[5] * m[11] - m[9] * m[7];
+		float coef08 = m[9] * m[14] - m[13] * m[10];
+		float coef10 = m[5] * m[14] - m[13] * m[6];
+		float coef11 = m[5] * m[10] - m[9] * m[6];
+		float coef12 = m[8] * m[15] - m[12] * m[11];
+		float coef14 = m[4] * m[15] - m[12] * m[7];
+		float coef15 = m[4] * m[11] - m[8] * m[7];
+		float coef16 = m[8] * m[14] - m[12] * m[10];
+		float coef18 = m[4] * m[14] - m[12] * m[6];
+		float coef19 = m[4] * m[10] - m[8] * m[6];
+		float coef20 = m[8] * m[13] - m[12] * m[9];
+		float coef22 = m[4] * m[13] - m[12] * m[5];
+		float coef23 = m[4] * m[9] - m[8] * m[5];
+
+		float fac0[4] = { coef00, coef00, coef02, coef03 };
+		float fac1[4] = { coef04, coef04, coef06, coef07 };
+		float fac2[4] = { coef08, coef08, coef10, coef11 };
+		float fac3[4] = { coef12, coef12, coef14, coef15 };
+		float fac4[4] = { coef16, coef16, coef18, coef19 };
+		float fac5[4] = { coef20, coef20, coef22, coef23 };
+		float vec0[4] = { m[4], m[0], m[0], m[0] };
+		float vec1[4] = { m[5], m[1], m[1], m[1] };
+		float vec2[4] = { m[6], m[2], m[2], m[2] };
+		float vec3[4] = { m[7], m[3], m[3], m[3] };
+		float signA[4] = { 1.0f, -1.0f, 1.0f, -1.0f };
+		float signB[4] = { -1.0f, 1.0f, -1.0f, 1.0f };
+		for (int i = 0; i < 4; i++)
+		{
+			pResultPARAM[i] = (vec1[i] * fac0[i] - vec2[i] * fac1[i] + vec3[i] * fac2[i]) * signA[i];
+			pResultPARAM[4 + i] = (vec0[i] * fac0[i] - vec2[i] * fac3[i] + vec3[i] * fac4[i]) * signB[i];
+			pResultPARAM[8 + i] = (vec0[i] * fac1[i] - vec1[i] * fac3[i] + vec3[i] * fac5[i]) * signA[i];
+			pResultPARAM[12 + i] = (vec0[i] * fac2[i] - vec1[i] * fac4[i] + vec2[i] * fac5[i]) * signB[i];
+		}
+		float fDeterminant = (pResultPARAM[0] * m[0] + pResultPARAM[4] * m[1]) + (pResultPARAM[8] * m[2] + pResultPARAM[12] * m[3]);
+		float fOneOverDeterminant = 1.0f / fDeterminant;
+		for (int i = 0; i < 16; i++)
+			pResultPARAM[i] *= fOneOverDeterminant;
+	}
+}
+
+DC_TEST(matrixMultiplyMatchesScalarCode)
+{
+	std::mt19937 random(1);
+	for (int i = 0; i < kNumRandomValues; i++)
+	{
+		Matrix a = createRandomMatrix(random);
+		Matrix b = createRandomMatrix(random);
+		float expected[16];
+		multiplyScalar(a.getFloat(), b.getFloat(), expected);
+		TestCheck(isBitIdentical(a * b, expected));
+		TestCheck(isBitIdentical(a.multiply(b), expected));
+		Matrix c = a;
+		c *= b;
+		TestCheck(isBitIdentical(c, expected));
+	}
+}
+
+DC_TEST(matrixMultiplyVectorMatchesScalarCode)
+{
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+	for (int i = 0; i < kNumRandomValues; i++)
+	{
+		Matrix a = createRandomMatrix(random);
+		Vector3f v(value(random), value(random), value(random));
+		const float* m = a.getFloat();
+		Vector3f result = a.multiply(v);
+		float expected[3] =
+		{
+			m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12],
+			m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13],
+			m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14]
+		};
+		float actual[3] = { result.x, result.y, result.z };
+		TestCheck(0 == memcmp(actual, expected, sizeof(expected)));
+	}
+}
+
+// The batch transforms must give exactly the same results as the scalar code, with and without threads.
+// The number of vectors isn't a multiple of the SIMD width, so that the leftover vectors are checked too, and is
+// large enough for them to be split between threads.
+DC_TEST(matrixBatchTransformsMatchScalarCode)
+{
+	const size_t kNumVectors = 100003;
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+	Matrix a = createRandomMatrix(random);
+	const float* m = a.getFloat();
+	std::vector<Vector3f> vectors(kNumVectors);
+	std::vector<Vector4f> vector4fs(kNumVectors);
+	std::vector<float> x(kNumVectors), y(kNumVectors), z(kNumVectors);
+	for (size_t i = 0; i < kNumVectors; i++)
+	{
+		vectors[i].set(value(random), value(random), value(random));
+		vector4fs[i].set(vectors[i].x, vectors[i].y, vectors[i].z, value(random));
+		x[i] = vectors[i].x;
+		y[i] = vectors[i].y;
+		z[i] = vectors[i].z;
+	}
+
+	for (unsigned int numThreads = 1; numThreads <= 4; numThreads *= 4)
+	{
+		std::vector<Vector3f> points(kNumVectors);
+		a.transformPoints(vectors, points, numThreads);
+		std::vector<Vector3f> directions(kNumVectors);
+		a.transformDirections(vectors, directions, numThreads);
+		std::vector<float> xOut(kNumVectors), yOut(kNumVectors), zOut(kNumVectors);
+		a.transformPoints(x, y, z, xOut, yOut, zOut, numThreads);
+		std::vector<Vector4f> vector4fsOut(kNumVectors);
+		a.transformVectors(vector4fs, vector4fsOut, numThreads);
+		std::vector<Vector3f> inPlace = vectors;
+		a.transformPoints(inPlace, inPlace, numThreads);
+
+		bool bAllMatch = true;
+		for (size_t i = 0; i < kNumVectors; i++)
+		{
+			const Vector3f& v = vectors[i];
+			float expectedDirection[3] =
+			{
+				m[0] * v.x + m[4] * v.y + m[8] * v.z,
+				m[1] * v.x + m[5] * v.y + m[9] * v.z,
+				m[2] * v.x + m[6] * v.y + m[10] * v.z
+			};
+			float expectedPoint[3] = { expectedDirection[0] + m[12], expectedDirection[1] + m[13], expectedDirection[2] + m[14] };
+			const Vector4f& v4 = vector4fs[i];
+			float expectedVector4f[4] =
+			{
+				m[0] * v4.x + m[4] * v4.y + m[8] * v4.z + m[12] * v4.w,
+				m[1] * v4.x + m[5] * v4.y + m[9] * v4.z + m[13] * v4.w,
+				m[2] * v4.x + m[6] * v4.y + m[10] * v4.z + m[14] * v4.w,
+				m[3] * v4.x + m[7] * v4.y + m[11] * v4.z + m[15] * v4.w
+			};
+			float point[3] = { points[i].x, points[i].y, points[i].z };
+			float direction[3] = { directions[i].x, directions[i].y, directions[i].z };
+			float pointComponents[3] = { xOut[i], yOut[i], zOut[i] };
+			float pointInPlace[3] = { inPlace[i].x, inPlace[i].y, inPlace[i].z };
+			float vector4f[4] = { vector4fsOut[i].x, vector4fsOut[i].y, vector4fsOut[i].z, vector4fsOut[i].w };
+			bAllMatch = bAllMatch && 0 == memcmp(point, expectedPoint, sizeof(expectedPoint));
+			bAllMatch = bAllMatch && 0 == memcmp(direction, expectedDirection, sizeof(expectedDirection));
+			bAllMatch = bAllMatch && 0 == memcmp(pointComponents, expectedPoint, sizeof(expectedPoint));
+			bAllMatch = bAllMatch && 0 == memcmp(pointInPlace, expectedPoint, sizeof(expectedPoint));
+			bAllMatch = bAllMatch && 0 == memcmp(vector4f, expectedVector4f, sizeof(expectedVector4f));
+		}
+		TestCheck(bAllMatch);
+	}
+}
+
+DC_TEST(matrixMultiplyScalarMatchesScalarCode)
+{
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+	for (int i = 0; i < kNumRandomValues; i++)
+	{
+		Matrix a = createRandomMatrix(random);
+		float f = value(random);
+		float expected[16];
+		for (int j = 0; j < 16; j++)
+			expected[j] = a.getFloat()[j] * f;
+		TestCheck(isBitIdentical(a.multiply(f), expected));
+	}
+}
+
+DC_TEST(matrixTransposeMatchesScalarCode)
+{
+	std::mt19937 random(4);
+	for (int i = 0; i < kNumRandomValues; i++)
+	{
+		Matrix a = createRandomMatrix(random);
+		float expected[16];
+		for (int iColumn = 0; iColumn < 4; iColumn++)
+		{
+			for (int iRow = 0; iRow < 4; iRow++)
+				expected[iColumn * 4 + iRow] = a.getFloat()[iRow * 4 + iColumn];
+		}
+		TestCheck(isBitIdentical(a.transpose(), expected));
+	}
+}
+
+DC_TEST(matrixInverseMatchesScalarCode)
+{
+	std::mt19937 random(5);
+	for (int i = 0; i < kNumRandomValues; i++)
+	{
+		Matrix a = i & 1 ? createRandomMatrix(random) : createRandomTransform(random);
+		float expected[16];
+		inverseScalar(a.getFloat(), expected);
+		TestCheck(isBitIdentical(a.inverse(), expected));
+	}
+}
+
+// A matrix multiplied by it's inverse should give the identity matrix, give or take rounding errors
+DC_TEST(matrixInverseGivesIdentity)
+{
+	std::mt19937 random(6);
+	for (int i = 0; i < kNumRandomValues; i++)
+	{
+		Matrix a = createRandomTransform(random);
+		Matrix identity = a * a.inverse();
+		float fMaxError = 0.0f;
+		for (int iColumn = 0; iColumn < 4; iColumn++)
+		{
+			for (int iRow = 0; iRow < 4; iRow++)
+			{
+				float fExpected = iColumn == iRow ? 1.0f : 0.0f;
+				fMaxError = std::max(fMaxError, fabsf(identity.getFloat()[iColumn * 4 + iRow] - fExpected));
+			}
+		}
+		TestCheck(fMaxError < 1e-4f);
+	}
+}
+
+// Matrix::multiplyHierarchy() must give exactly the same matrices as multiplying each bone's local matrix by it's
+// parent's model space matrix with operator*(), both into seperate matrices and in place, and must detect parents
+// which don't come before their children and output which partly overlaps the local matrices.
+DC_TEST(matrixMultiplyHierarchyMatchesOperatorMultiply)
+{
+	std::mt19937 random(11);
+	const int kNumBones = 300;
+	std::vector<Matrix> localMatrices(kNumBones);
+	std::vector<int> parentIndicies(kNumBones);
+	for (int i = 0; i < kNumBones; i++)
+	{
+		// A few roots, so that there's more than one hierarchy, and the rest with any earlier bone as their parent
+		localMatrices[i] = createRandomTransform(random);
+		parentIndicies[i] = 0 == i % 50 ? -1 : (int)(random() % i);
+	}
+	std::vector<Matrix> expected(kNumBones);
+	for (int i = 0; i < kNumBones; i++)
+		expected[i] = parentIndicies[i] < 0 ? localMatrices[i] : expected[parentIndicies[i]] * localMatrices[i];
+
+	std::vector<Matrix> matricesOut(kNumBones);
+	Matrix::multiplyHierarchy(localMatrices, parentIndicies, matricesOut);
+	for (int i = 0; i < kNumBones; i++)
+		TestCheck(isBitIdentical(matricesOut[i], expected[i].getFloat()));
+	std::vector<Matrix> inPlace = localMatrices;
+	Matrix::multiplyHierarchy(inPlace, parentIndicies, inPlace);
+	for (int i = 0; i < kNumBones; i++)
+		TestCheck(isBitIdentical(inPlace[i], expected[i].getFloat()));
+	Matrix::multiplyHierarchy(std::span<const Matrix>(), std::span<const int>(), std::span<Matrix>());
+
+#ifndef _DEBUG
+	// With _DEBUG defined, the error macros break into the debugger before calling errorFunc, so the errors are only
+	// checked without it
+	void (*oldErrorFunc)(const std::wstring&, const std::wstring&, const std::wstring&) = errorFunc;
+	errorFunc = throwError;
+	auto getErrorOccurs = [](std::span<const Matrix> localMatricesPARAM, std::span<const int> parentIndiciesPARAM, std::span<Matrix> matricesOutPARAM)
+		{
+			try
+			{
+				Matrix::multiplyHierarchy(localMatricesPARAM, parentIndiciesPARAM, matricesOutPARAM);
+			}
+			catch (const std::wstring&)
+			{
+				return true;
+			}
+			return false;
+		};
+	std::vector<int> badParentIndicies = parentIndicies;
+	badParentIndicies[10] = 10;
+	TestCheck(getErrorOccurs(localMatrices, badParentIndicies, matricesOut));
+	badParentIndicies[10] = 11;
+	TestCheck(getErrorOccurs(localMatrices, badParentIndicies, matricesOut));
+	TestCheck(getErrorOccurs(localMatrices, std::span<const int>(parentIndicies).first(kNumBones - 1), matricesOut));
+	TestCheck(getErrorOccurs(localMatrices, parentIndicies, std::span<Matrix>(matricesOut).first(kNumBones - 1)));
+
+	// The output starting one matrix after or before the local matrices, within the same memory
+	std::vector<Matrix> shared(kNumBones + 1);
+	std::span<Matrix> first = std::span<Matrix>(shared).first(kNumBones);
+	std::span<Matrix> last = std::span<Matrix>(shared).last(kNumBones);
+	TestCheck(getErrorOccurs(first, parentIndicies, last));
+	TestCheck(getErrorOccurs(last, parentIndicies, first));
+	TestCheck(!getErrorOccurs(localMatrices, parentIndicies, matricesOut));
+	errorFunc = oldErrorFunc;
+#endif
+}
+
+DC_TEST(vector4fOperatorsMatchScalarCode)
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> value(-1000.0f, 1000.0f);
+	for (int i = 0; i < kNumRandomValues; i++)
+	{
+		Vector4f a(value(random), value(random), value(random), value(random));
+		Vector4f b(value(random), value(random), value(random), value(random));
+		float f = value(random);
+		TestCheck(isBitIdentical(a + b, a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w));
+		TestCheck(isBitIdentical(a - b, a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w));
+		TestCheck(isBitIdentical(a * b, a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w));
+		TestCheck(isBitIdentical(a * f, a.x * f, a.y * f, a.z * f, a.w * f));
+		Vector4f c = a;
+		c += b;
+		TestCheck(isBitIdentical(c, a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w));
+		c = a;
+		c -= b;
+		TestCheck(isBitIdentical(c, a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w));
+		c = a;
+		c *= f;
+		TestCheck(isBitIdentical(c, a.x * f, a.y * f, a.z * f, a.w * f));
+	}
+}
+
+// The batch visibility methods of Frustum must give exactly the same results as testing each object on it's own.
+// The number of objects is more than the batch methods give to each thread, and isn't a multiple of the SIMD width,
+// so that the threaded and leftover code paths are checked too.
+DC_TEST(frustumBatchVisibilityMatchesPerObjectTests)
+{
+	const size_t kNumObjects = 300007;
+	std::mt19937 random(8);
+	std::uniform_real_distribution<float> position(-600.0f, 600.0f);
+	std::uniform_real_distribution<float> size(0.0f, 20.0f);
+	Vector3fArray centres(kNumObjects);
+	Vector3fArray mins(kNumObjects);
+	Vector3fArray maxs(kNumObjects);
+	std::vector<float> radii(kNumObjects);
+	for (size_t i = 0; i < kNumObjects; i++)
+	{
+		Vector3f centre(position(random), position(random), position(random));
+		Vector3f halfDimensions(size(random), size(random), size(random));
+		centres.set(i, centre);
+		mins.set(i, centre - halfDimensions);
+		maxs.set(i, centre + halfDimensions);
+		radii[i] = i % 16 ? size(random) : 0.0f;
+	}
+
+	Frustum frustums[3] =
+	{
+		createFrustum(Vector3f(0.0f, 0.0f, 0.0f), Vector3f(0.0f, 0.0f, 1.0f)),
+		createFrustum(Vector3f(100.0f, 50.0f, -200.0f), Vector3f(-300.0f, -20.0f, 250.0f)),
+		createFrustum(Vector3f(-400.0f, 300.0f, 100.0f), Vector3f(-400.0f, -300.0f, 100.1f))
+	};
+	for (const Frustum& frustum : frustums)
+	{
+		for (unsigned int numThreads = 1; numThreads <= 4; numThreads += 3)
+		{
+			std::vector<unsigned int> sphereBits;
+			frustum.computeSphereVisibility(centres, radii, sphereBits, numThreads);
+			std::vector<unsigned int> aabbBits;
+			frustum.computeAABBVisibility(mins, maxs, aabbBits, numThreads);
+			std::vector<unsigned int> visibleSpheres;
+			frustum.getVisibleSpheres(centres, radii, visibleSpheres, numThreads);
+			std::vector<unsigned int> visibleAABBs;
+			frustum.getVisibleAABBs(mins, maxs, visibleAABBs, numThreads);
+			TestCheck(sphereBits.size() == (kNumObjects + 31) / 32);
+			TestCheck(aabbBits.size() == (kNumObjects + 31) / 32);
+
+			size_t numMismatches = 0;
+			std::vector<unsigned int> expectedVisibleSpheres;
+			std::vector<unsigned int> expectedVisibleAABBs;
+			for (size_t i = 0; i < kNumObjects; i++)
+			{
+				bool bSphereVisible = isSphereVisible(frustum, centres.get(i), radii[i]);
+				bool bAABBVisible = frustum.isAABBIntersecting(AABB(mins.get(i), maxs.get(i)));
+				if (bSphereVisible != isBitSet(sphereBits, i) || bAABBVisible != isBitSet(aabbBits, i))
+					numMismatches++;
+				if (0.0f == radii[i] && bSphereVisible != frustum.isPointInside(centres.get(i)))
+					numMismatches++;
+				if (bSphereVisible)
+					expectedVisibleSpheres.push_back((unsigned int)i);
+				if (bAABBVisible)
+					expectedVisibleAABBs.push_back((unsigned int)i);
+			}
+			TestCheck(0 == numMismatches);
+			TestCheck(visibleSpheres == expectedVisibleSpheres);
+			TestCheck(visibleAABBs == expectedVisibleAABBs);
+			TestCheck(!expectedVisibleSpheres.empty() && expectedVisibleSpheres.size() < kNumObjects);
+
+			// The bits after the last object must be zero
+			TestCheck(0 == (sphereBits.back() >> (kNumObjects % 32)));
+			TestCheck(0 == (aabbBits.back() >> (kNumObjects % 32)));
+		}
+	}
+}
+
+// A position is inside of the frustum if it's clip space position c = (projection * view) * (position, 1) has
+// -c.w <= c.x <= c.w, -c.w <= c.y <= c.w and 0 <= c.z <= c.w, which isPointInside() must agree with.
+// Positions which are so close to one of the planes that rounding could put them either side are skipped.
+DC_TEST(frustumIsPointInsideMatchesClipSpace)
+{
+	const Vector3f positions[4][2] =
+	{
+		{ Vector3f(0.0f, 0.0f, 0.0f), Vector3f(0.0f, 0.0f, 1.0f) },
+		{ Vector3f(100.0f, 50.0f, -200.0f), Vector3f(-300.0f, -20.0f, 250.0f) },
+		{ Vector3f(-400.0f, 300.0f, 100.0f), Vector3f(-400.0f, -300.0f, 100.1f) },
+		{ Vector3f(10.0f, -20.0f, 30.0f), Vector3f(-50.0f, -20.0f, 30.0f) }
+	};
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> offset(-700.0f, 700.0f);
+	for (const Vector3f* pCamera : positions)
+	{
+		Matrix matrixView;
+		matrixView.setViewLookat(pCamera[0], pCamera[1]);
+		Matrix matrixProjections[2];
+		matrixProjections[0].setProjectionPerspective(60.0f, 1.0f, 500.0f, 1.5f);
+		matrixProjections[1].setProjectionOrthographic(-200.0f, 300.0f, 150.0f, -100.0f, -50.0f, 400.0f);
+		for (const Matrix& matrixProjection : matrixProjections)
+		{
+			Frustum frustum;
+			frustum.computeFromViewProjection(matrixView, matrixProjection);
+			Matrix matrixViewProj = matrixProjection * matrixView;
+			const float* m = matrixViewProj.getFloat();
+
+			size_t numInside = 0;
+			size_t numOutside = 0;
+			size_t numMismatches = 0;
+			for (int i = 0; i < 100000; i++)
+			{
+				Vector3f position(pCamera[0].x + offset(random), pCamera[0].y + offset(random), pCamera[0].z + offset(random));
+				double clip[4];
+				for (int row = 0; row < 4; row++)
+					clip[row] = (double)m[row] * position.x + (double)m[4 + row] * position.y + (double)m[8 + row] * position.z + (double)m[12 + row];
+				double w = clip[3];
+				double slack[6] = { w + clip[0], w - clip[0], w + clip[1], w - clip[1], clip[2], w - clip[2] };
+				double dMinSlack = *std::min_element(slack, slack + 6);
+				if (fabs(dMinSlack) < 1e-3 * (fabs(w) + 1.0))
+					continue;
+				bool bExpectedInside = dMinSlack > 0.0;
+				if (bExpectedInside != frustum.isPointInside(position))
+					numMismatches++;
+				if (bExpectedInside)
+					numInside++;
+				else
+					numOutside++;
+			}
+			TestCheck(0 == numMismatches);
+			TestCheck(numInside > 100 && numOutside > 100);
+		}
+	}
+}
+
+// Each method of Vector3fArray must give exactly the same results as calling the equivalent method of Vector3f for
+// each vector, for sizes which do and don't fill the last SIMD register, and the padding after the vectors must stay
+// zero, even when the vectors are multiplied by infinity or NaN.
+DC_TEST(vector3fArrayMatchesVector3f)
+{
+	std::mt19937 random(8);
+	std::uniform_real_distribution<float> value(-1000.0f, 1000.0f);
+	std::vector<size_t> sizes;
+	for (size_t size = 0; size <= 40; size++)
+		sizes.push_back(size);
+	sizes.push_back(1003);
+	sizes.push_back(4099);
+	for (size_t size : sizes)
+	{
+		// Every 13th vector is zero, which normalise() leaves alone
+		std::vector<Vector3f> a(size);
+		std::vector<Vector3f> b(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			if (i % 13)
+				a[i].set(value(random), value(random), value(random));
+			b[i].set(value(random), value(random), value(random));
+		}
+		float fScalar = value(random) * 0.01f;
+		Vector3f vPoint(value(random), value(random), value(random));
+
+		Vector3fArray arrayA(a);
+		Vector3fArray arrayB(b);
+		TestCheck(isBitIdentical(arrayA, a));
+		std::vector<Vector3f> converted = arrayA.getAsVector3fs();
+		TestCheck(converted.size() == size);
+		for (size_t i = 0; i < size; i++)
+			TestCheck(isBitIdentical(converted[i], a[i]));
+
+		std::vector<float> values(size);
+		std::vector<float> expected(size);
+		arrayA.getMagnitude(values);
+		for (size_t i = 0; i < size; i++)
+			expected[i] = a[i].getMagnitude();
+		TestCheck(isBitIdentical(values, expected));
+		arrayA.getDot(arrayB, values);
+		for (size_t i = 0; i < size; i++)
+			expected[i] = a[i].getDot(b[i]);
+		TestCheck(isBitIdentical(values, expected));
+		arrayA.getDistance(arrayB, values);
+		for (size_t i = 0; i < size; i++)
+			expected[i] = a[i].getDistance(b[i]);
+		TestCheck(isBitIdentical(values, expected));
+		arrayA.getDistance(vPoint, values);
+		for (size_t i = 0; i < size; i++)
+			expected[i] = a[i].getDistance(vPoint);
+		TestCheck(isBitIdentical(values, expected));
+		arrayA.getDistanceSquared(vPoint, values);
+		for (size_t i = 0; i < size; i++)
+			expected[i] = a[i].getDistanceSquared(vPoint);
+		TestCheck(isBitIdentical(values, expected));
+
+		arrayA.add(vPoint);
+		for (size_t i = 0; i < size; i++)
+			a[i] += vPoint;
+		TestCheck(isBitIdentical(arrayA, a));
+		arrayA.add(arrayB);
+		for (size_t i = 0; i < size; i++)
+			a[i] += b[i];
+		TestCheck(isBitIdentical(arrayA, a));
+		arrayA.subtract(arrayB);
+		for (size_t i = 0; i < size; i++)
+			a[i] -= b[i];
+		TestCheck(isBitIdentical(arrayA, a));
+		arrayA.addScaled(arrayB, fScalar);
+		for (size_t i = 0; i < size; i++)
+			a[i] += b[i] * fScalar;
+		TestCheck(isBitIdentical(arrayA, a));
+		arrayA.multiply(fScalar);
+		for (size_t i = 0; i < size; i++)
+			a[i] *= fScalar;
+		TestCheck(isBitIdentical(arrayA, a));
+		arrayA.interpolate(arrayB, 0.3f);
+		for (size_t i = 0; i < size; i++)
+			a[i].set(interpolate(a[i].x, b[i].x, 0.3f), interpolate(a[i].y, b[i].y, 0.3f), interpolate(a[i].z, b[i].z, 0.3f));
+		TestCheck(isBitIdentical(arrayA, a));
+		for (size_t i = 0; i < size; i += 13)
+		{
+			a[i].set(0.0f, 0.0f, 0.0f);
+			arrayA.set(i, a[i]);
+		}
+		arrayA.normalise();
+		for (size_t i = 0; i < size; i++)
+			a[i].normalise();
+		TestCheck(isBitIdentical(arrayA, a));
+
+		// Copying into arrays which have less and more capacity than the one copied
+		Vector3fArray copy;
+		copy = arrayA;
+		TestCheck(isBitIdentical(copy, a));
+		Vector3fArray larger(size * 2 + 9);
+		larger = arrayA;
+		TestCheck(isBitIdentical(larger, a));
+		Vector3fArray moved(std::move(copy));
+		TestCheck(isBitIdentical(moved, a));
+		TestCheck(0 == copy.size());
+
+		// The vectors become infinite or NaN, but the padding must stay zero, with the sign bit clear
+		Vector3fArray infinite = arrayA;
+		infinite.multiply(INFINITY);
+		TestCheck(isBitIdentical(infinite, infinite.getAsVector3fs()));
+		infinite = arrayA;
+		infinite.multiply(-INFINITY);
+		TestCheck(isBitIdentical(infinite, infinite.getAsVector3fs()));
+		infinite = arrayA;
+		infinite.multiply(NAN);
+		TestCheck(isBitIdentical(infinite, infinite.getAsVector3fs()));
+		infinite = arrayA;
+		infinite.multiply(-2.0f);
+		TestCheck(isBitIdentical(infinite, infinite.getAsVector3fs()));
+		infinite = arrayA;
+		infinite.addScaled(arrayB, INFINITY);
+		TestCheck(isBitIdentical(infinite, infinite.getAsVector3fs()));
+		infinite = arrayA;
+		infinite.interpolate(arrayB, INFINITY);
+		TestCheck(isBitIdentical(infinite, infinite.getAsVector3fs()));
+	}
+}
+
+// Growing a Vector3fArray a little at a time must only reallocate it now and then, as it's capacity grows
+// geometrically, and the vectors must keep their values while the space which isn't in use stays zero.
+DC_TEST(vector3fArrayResizeKeepsValues)
+{
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> value(-1000.0f, 1000.0f);
+	Vector3fArray vectors;
+	std::vector<Vector3f> expected;
+	int numReallocations = 0;
+	for (int i = 0; i < 10000; i++)
+	{
+		const float* pX = vectors.getX();
+		Vector3f vVector(value(random), value(random), value(random));
+		vectors.resize(vectors.size() + 1);
+		vectors.set(vectors.size() - 1, vVector);
+		expected.push_back(vVector);
+		if (vectors.getX() != pX)
+			numReallocations++;
+	}
+	TestCheck(isBitIdentical(vectors, expected));
+	TestCheck(vectors.getCapacity() >= vectors.size() && vectors.getCapacity() < vectors.size() * 2 + 8);
+	TestCheck(numReallocations < 20);
+
+	// Shrinking and growing again within the capacity mustn't reallocate, and the vectors which come back are zero
+	const float* pX = vectors.getX();
+	size_t capacity = vectors.getCapacity();
+	for (int i = 0; i < 100; i++)
+	{
+		size_t size = 9000 + (i * 37) % 1000;
+		vectors.resize(size);
+		expected.resize(size);
+		TestCheck(isBitIdentical(vectors, expected));
+		TestCheck(vectors.getX() == pX);
+		TestCheck(vectors.getCapacity() == capacity);
+	}
+	vectors.resize(3);
+	vectors.resize(10);
+	expected.resize(3);
+	expected.resize(10);
+	TestCheck(isBitIdentical(vectors, expected));
+
+	// reserve() only ever makes the capacity larger
+	vectors.reserve(20000);
+	TestCheck(vectors.getCapacity() >= 20000);
+	TestCheck(isBitIdentical(vectors, expected));
+	capacity = vectors.getCapacity();
+	vectors.reserve(5);
+	TestCheck(vectors.getCapacity() == capacity);
+	vectors.clear();
+	TestCheck(0 == vectors.size() && 0 == vectors.getCapacity());
+}
+
+// The batch forms of Vector3d::getRelativeTo() and Matrixd::getRelativeTo() must give exactly the same results as
+// converting each position or matrix on it's own, for numbers of them which aren't a multiple of the SIMD width, and
+// numbers large enough to be split between threads.
+// The positions are tens of kilometres from the origin, with fractions which a float can't hold, so that rounding
+// the results to floats differently would show.
+DC_TEST(relativeToMatchesSingleConversions)
+{
+	std::mt19937 random(10);
+	std::uniform_real_distribution<double> coordinate(-50000.0, 50000.0);
+	const size_t positionSizes[] = { 0, 1, 3, 5, 7, 9, 13, 31, 101, 100003 };
+	const unsigned int numThreads[] = { 1, 3, 0 };
+	Vector3d vOrigin(coordinate(random), coordinate(random), coordinate(random));
+	Vector3fArray arrayOut;
+	for (size_t size : positionSizes)
+	{
+		std::vector<Vector3d> positions(size);
+		std::vector<Vector3f> expected(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			positions[i].x = vOrigin.x + coordinate(random) * 0.01;
+			positions[i].y = coordinate(random);
+			positions[i].z = vOrigin.z - coordinate(random) * 1e-4;
+			expected[i] = positions[i].getRelativeTo(vOrigin);
+		}
+		for (unsigned int threads : numThreads)
+		{
+			std::vector<Vector3f> spanOut(size);
+			Vector3d::getRelativeTo(positions, vOrigin, spanOut, threads);
+			for (size_t i = 0; i < size; i++)
+				TestCheck(isBitIdentical(spanOut[i], expected[i]));
+
+			// arrayOut is reused between sizes, so it's sometimes shrunk, which must leave it's padding zero
+			Vector3d::getRelativeTo(positions, vOrigin, arrayOut, threads);
+			TestCheck(isBitIdentical(arrayOut, expected));
+		}
+	}
+
+	std::uniform_real_distribution<double> value(-2.0, 2.0);
+	const size_t matrixSizes[] = { 0, 1, 3, 5, 7, 9, 20003 };
+	for (size_t size : matrixSizes)
+	{
+		// Every third matrix has a bottom row which isn't 0 0 0 1, which getRelativeTo() has to allow for
+		std::vector<Matrixd> matrices(size);
+		std::vector<Matrix> expected(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			double values[16];
+			for (int j = 0; j < 16; j++)
+				values[j] = value(random);
+			values[12] = coordinate(random);
+			values[13] = coordinate(random);
+			values[14] = coordinate(random);
+			if (i % 3)
+			{
+				values[3] = values[7] = values[11] = 0.0;
+				values[15] = 1.0;
+			}
+			matrices[i].set(values);
+			expected[i] = matrices[i].getRelativeTo(vOrigin);
+		}
+		for (unsigned int threads : numThreads)
+		{
+			std::vector<Matrix> matricesOut(size);
+			Matrixd::getRelativeTo(matrices, vOrigin, matricesOut, threads);
+			for (size_t i = 0; i < size; i++)
+				TestCheck(isBitIdentical(matricesOut[i], expected[i].getFloat()));
+		}
+	}
+}
\ No newline at end of file
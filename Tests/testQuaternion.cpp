@@ -0,0 +1,142 @@
+#include "tests.h"
+#include "../DavesCodeLib/Math/matrix.h"
+#include "../DavesCodeLib/Math/quaternion.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace DC;
+
+// Checks the batch methods of Quaternion against the methods which work on one quaternion at a time, as described
+// in quaternion.h.
+namespace
+{
+	// Number of quaternions each of the tests checks, which isn't a multiple of the SIMD width, so that the leftover
+	// quaternions are checked too
+	const size_t kNumQuaternions = 10007;
+
+	// Returns the given number of random unit quaternions.
+	// Every other quaternion is only a small rotation away from the one before, as the poses blended in animation
+	// usually are, and some of those have been negated, so that the two are in opposite hemispheres.
+	std::vector<Quaternion> createRandomQuaternions(size_t numQuaternionsPARAM, unsigned int seedPARAM)
+	{
+		std::mt19937 random(seedPARAM);
+		std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+		std::vector<Quaternion> quaternions(numQuaternionsPARAM);
+		for (size_t i = 0; i < numQuaternionsPARAM; i++)
+		{
+			if (i % 2)
+			{
+				float fSmall = 0.01f * (float)(i % 7);
+				quaternions[i] = quaternions[i - 1] + Quaternion(value(random) * fSmall, value(random) * fSmall, value(random) * fSmall, value(random) * fSmall);
+				if (i % 3 == 0)
+					quaternions[i] = quaternions[i].getNegative();
+			}
+			else
+				quaternions[i] = Quaternion(value(random), value(random), value(random), value(random));
+			quaternions[i].normalise();
+		}
+		return quaternions;
+	}
+
+	// Returns true if the two quaternions are exactly the same, bit for bit
+	bool isBitIdentical(const Quaternion& quaternionAPARAM, const Quaternion& quaternionBPARAM)
+	{
+		return 0 == memcmp(quaternionAPARAM.q, quaternionBPARAM.q, sizeof(quaternionAPARAM.q));
+	}
+}
+
+// slerp() must be within 4e-7 of an exact slerp, computed here with doubles
+DC_TEST(quaternionBatchSlerpAccuracy)
+{
+	std::vector<Quaternion> quaternionsA = createRandomQuaternions(kNumQuaternions, 1);
+	std::vector<Quaternion> quaternionsB = createRandomQuaternions(kNumQuaternions, 2);
+	std::vector<Quaternion> quaternionsOut(kNumQuaternions);
+	double dMaxError = 0.0;
+	for (float fInterval = 0.0f; fInterval <= 1.0f; fInterval += 0.125f)
+	{
+		Quaternion::slerp(quaternionsA, quaternionsB, fInterval, quaternionsOut);
+		for (size_t i = 0; i < kNumQuaternions; i++)
+		{
+			const float* a = quaternionsA[i].q;
+			const float* b = quaternionsB[i].q;
+			double dDot = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2] + (double)a[3] * b[3];
+			double dSign = dDot < 0.0 ? -1.0 : 1.0;
+			double dTheta = std::acos(std::min(dDot * dSign, 1.0));
+			double dWeightA = 1.0 - fInterval;
+			double dWeightB = fInterval;
+			if (dTheta > 1e-6)
+			{
+				dWeightA = std::sin(dTheta * (1.0 - fInterval)) / std::sin(dTheta);
+				dWeightB = std::sin(dTheta * fInterval) / std::sin(dTheta);
+			}
+			for (int j = 0; j < 4; j++)
+			{
+				double dExpected = a[j] * dWeightA + b[j] * dSign * dWeightB;
+				dMaxError = std::max(dMaxError, std::fabs(quaternionsOut[i].q[j] - dExpected));
+			}
+		}
+	}
+	printf("    slerp() maximum absolute error: %g\n", dMaxError);
+	TestCheck(dMaxError < 4e-7);
+}
+
+// nlerp() must give exactly the same results as getLERP(), once the second quaternion of each pair whose dot product
+// is negative has been negated
+DC_TEST(quaternionBatchNlerpMatchesGetLERP)
+{
+	std::vector<Quaternion> quaternionsA = createRandomQuaternions(kNumQuaternions, 3);
+	std::vector<Quaternion> quaternionsB = createRandomQuaternions(kNumQuaternions, 4);
+	std::vector<Quaternion> quaternionsOut(kNumQuaternions);
+	for (float fInterval = 0.0f; fInterval <= 1.0f; fInterval += 0.25f)
+	{
+		Quaternion::nlerp(quaternionsA, quaternionsB, fInterval, quaternionsOut);
+		bool bAllMatch = true;
+		for (size_t i = 0; i < kNumQuaternions; i++)
+		{
+			const Quaternion& a = quaternionsA[i];
+			Quaternion b = quaternionsB[i];
+			if (a.q[0] * b.q[0] + a.q[1] * b.q[1] + a.q[2] * b.q[2] + a.q[3] * b.q[3] < 0.0f)
+				b = b.getNegative();
+			bAllMatch = bAllMatch && isBitIdentical(quaternionsOut[i], a.getLERP(b, fInterval));
+		}
+		TestCheck(bAllMatch);
+	}
+
+	// In place
+	std::vector<Quaternion> inPlace = quaternionsA;
+	Quaternion::nlerp(inPlace, quaternionsB, 0.5f, inPlace);
+	Quaternion::nlerp(quaternionsA, quaternionsB, 0.5f, quaternionsOut);
+	bool bAllMatch = true;
+	for (size_t i = 0; i < kNumQuaternions; i++)
+		bAllMatch = bAllMatch && isBitIdentical(inPlace[i], quaternionsOut[i]);
+	TestCheck(bAllMatch);
+}
+
+// getMatrices() must give exactly the same results as Matrix::setFromQuaternion()
+DC_TEST(quaternionGetMatricesMatchesSetFromQuaternion)
+{
+	std::vector<Quaternion> quaternions = createRandomQuaternions(kNumQuaternions, 5);
+	std::mt19937 random(6);
+	std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+	std::vector<Vector3f> translations(kNumQuaternions);
+	for (size_t i = 0; i < kNumQuaternions; i++)
+		translations[i].set(value(random), value(random), value(random));
+	std::vector<Matrix> matrices(kNumQuaternions);
+	std::vector<Matrix> translatedMatrices(kNumQuaternions);
+	Quaternion::getMatrices(quaternions, matrices);
+	Quaternion::getMatrices(quaternions, translations, translatedMatrices);
+
+	bool bAllMatch = true;
+	for (size_t i = 0; i < kNumQuaternions; i++)
+	{
+		Matrix expected;
+		expected.setFromQuaternion(quaternions[i]);
+		bAllMatch = bAllMatch && 0 == memcmp(matrices[i].getFloat(), expected.getFloat(), sizeof(float[16]));
+		expected.setTranslation(translations[i]);
+		bAllMatch = bAllMatch && 0 == memcmp(translatedMatrices[i].getFloat(), expected.getFloat(), sizeof(float[16]));
+	}
+	TestCheck(bAllMatch);
+}
\ No newline at end of file
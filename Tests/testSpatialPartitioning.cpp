@@ -0,0 +1,1860 @@
+#include "tests.h"
+#include "allocationCounter.h"
+#include "../DavesCodeLib/SpatialPartitioning/BVH.h"
+#include "../DavesCodeLib/SpatialPartitioning/linearOctTree.h"
+#include "../DavesCodeLib/SpatialPartitioning/octTree.h"
+#include "../DavesCodeLib/SpatialPartitioning/quadTree.h"
+#include "../DavesCodeLib/SpatialPartitioning/spatialHashGrid2D.h"
+#include "../DavesCodeLib/SpatialPartitioning/sweepAndPrune.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <utility>
+
+using namespace DC;
+
+namespace
+{
+	// Number of queries each of the allocation tests performs of each type
+	const int kNumQueries = 1000;
+
+	// Returns a frustum for a camera at the given position, looking at the given target
+	Frustum createFrustum(const Vector3f& positionPARAM, const Vector3f& targetPARAM)
+	{
+		Matrix matrixView;
+		matrixView.setViewLookat(positionPARAM, targetPARAM);
+		Matrix matrixProjection;
+		matrixProjection.setProjectionPerspective(60.0f, 1.0f, 500.0f, 1.5f);
+		Frustum frustum;
+		frustum.computeFromViewProjection(matrixView, matrixProjection);
+		return frustum;
+	}
+
+	// Adds the given number of entities, spread randomly across the given size, to the given OctTree
+	void addRandomEntities(OctTree& octTreePARAM, int numEntitiesPARAM, float sizePARAM)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(-sizePARAM, sizePARAM);
+		for (int i = 0; i < numEntitiesPARAM; i++)
+			octTreePARAM.addEntity(Vector3f(position(random), position(random), position(random)), i);
+	}
+
+	// Returns the position of the given entity during the given frame of octTreeConcurrentQueriesAndWrites.
+	// The entities wander around their starting positions, apart from entity 0 which leaves the tree's region every
+	// 50 frames, so that the tree's root node has to be resized while other threads are waiting to query it.
+	Vector3f getStressTestPosition(const std::vector<Vector3f>& startPositionsPARAM, int entityPARAM, int framePARAM)
+	{
+		if (0 == entityPARAM && framePARAM % 50 == 25)
+			return Vector3f(5000.0f, 0.0f, 0.0f);
+		float f = (float)framePARAM;
+		float e = (float)entityPARAM;
+		return startPositionsPARAM[entityPARAM] + Vector3f(sinf(f * 0.1f + e) * 20.0f, cosf(f * 0.13f + e) * 20.0f, sinf(f * 0.07f + e * 2.0f) * 20.0f);
+	}
+
+	// Hashes the results of a sequence of queries, so that they can be compared against the results which the trees gave
+	// before their nodes were moved into a pool, which are recorded in octTreeAndQuadTreeMatchGoldenResults.
+	// The userData of the entities found by each query are sorted, so that the order the tree returns them in doesn't
+	// matter, then added to a 64 bit FNV-1a hash.
+	class QueryResultsHash
+	{
+	public:
+		template <typename Entity> void addQuery(const std::vector<Entity*>& entitiesPARAM)
+		{
+			std::vector<int> userData;
+			for (const Entity* pEntity : entitiesPARAM)
+				userData.push_back(pEntity->userData);
+			std::sort(userData.begin(), userData.end());
+			numEntitiesFound += userData.size();
+			for (int value : userData)
+			{
+				for (int i = 0; i < 4; i++)
+					addByte((unsigned char)(value >> (8 * i)));
+			}
+			addByte(0xFF);
+		}
+
+		unsigned long long hash = 14695981039346656037ull;
+		unsigned long long numEntitiesFound = 0;
+	private:
+		void addByte(unsigned char bytePARAM)
+		{
+			hash ^= bytePARAM;
+			hash *= 1099511628211ull;
+		}
+	};
+
+	// Tests the ray from origin along direction against the given AABB the same way that BVH does, including testing
+	// the axes which the ray is parallel to by whether it's origin is within the AABB along them, so that the BVH's
+	// results can be compared against testing every primitive.
+	// Returns whether the AABB is hit between 0 and maxT and if so sets tOut to where.
+	bool getRayHitsAABB(const Vector3f& originPARAM, const Vector3f& directionPARAM, const AABB& aabbPARAM, float maxTPARAM, float& tOutPARAM)
+	{
+		float fOrigin[3] = { originPARAM.x, originPARAM.y, originPARAM.z };
+		float fDirection[3] = { directionPARAM.x, directionPARAM.y, directionPARAM.z };
+		Vector3f vMin = aabbPARAM.getMin();
+		Vector3f vMax = aabbPARAM.getMax();
+		float fMin[3] = { vMin.x, vMin.y, vMin.z };
+		float fMax[3] = { vMax.x, vMax.y, vMax.z };
+		float fEnterT = 0.0f;
+		float fExitT = maxTPARAM;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (fabsf(fDirection[axis]) < 1e-20f)
+			{
+				if (fOrigin[axis] < fMin[axis] || fOrigin[axis] > fMax[axis])
+					return false;
+				continue;
+			}
+			float fInvDirection = 1.0f / fDirection[axis];
+			bool bNegative = fInvDirection < 0.0f;
+			float fEnterAxis = ((bNegative ? fMax[axis] : fMin[axis]) - fOrigin[axis]) * fInvDirection;
+			float fExitAxis = ((bNegative ? fMin[axis] : fMax[axis]) - fOrigin[axis]) * fInvDirection;
+			if (fEnterAxis > fEnterT)
+				fEnterT = fEnterAxis;
+			if (fExitAxis < fExitT)
+				fExitT = fExitAxis;
+		}
+		if (fEnterT > fExitT)
+			return false;
+		tOutPARAM = fEnterT;
+		return true;
+	}
+
+	// Adds an entity to the given tree with addEntity(tree, userData) and removes it again, over and over, while another
+	// entity stays in the tree, so that the same slot is reused until it's generation runs out and it's retired.
+	// Checks that none of the handles are given out twice, so that a handle to a removed entity never becomes valid
+	// again, and that none of them refer to an entity once it's been removed.
+	template <typename Tree, typename AddEntity> void checkRemovedHandlesStayInvalid(Tree& treePARAM, AddEntity addEntityPARAM)
+	{
+		SpatialEntityHandle keptHandle = addEntityPARAM(treePARAM, 0);
+		std::vector<SpatialEntityHandle> removedHandles;
+		const unsigned int kNumReuses = kSpatialEntityHandleMaxGeneration * 2 + 10;
+		for (unsigned int i = 0; i < kNumReuses; i++)
+		{
+			SpatialEntityHandle handle = addEntityPARAM(treePARAM, (int)i + 1);
+			TestCheck(treePARAM.getEntityExists(handle));
+			TestCheck(treePARAM.getEntity(handle)->userData == (int)i + 1);
+			treePARAM.removeEntity(handle);
+			TestCheck(!treePARAM.getEntityExists(handle));
+			removedHandles.push_back(handle);
+		}
+		TestCheck(treePARAM.getEntityExists(keptHandle));
+		for (SpatialEntityHandle handle : removedHandles)
+			TestCheck(!treePARAM.getEntityExists(handle));
+
+		// Each slot is used once for each of it's generations, then retired
+		std::vector<unsigned int> slotIndicies;
+		for (SpatialEntityHandle handle : removedHandles)
+			slotIndicies.push_back(spatialEntityHandleGetIndex(handle));
+		std::sort(removedHandles.begin(), removedHandles.end());
+		TestCheck(std::adjacent_find(removedHandles.begin(), removedHandles.end()) == removedHandles.end());
+		std::sort(slotIndicies.begin(), slotIndicies.end());
+		TestCheck(std::unique(slotIndicies.begin(), slotIndicies.end()) - slotIndicies.begin() == 3);
+	}
+}
+
+// Once the vectors given to the buffer queries have grown large enough, and for the visitor queries right away,
+// querying an OctTree mustn't allocate any memory.
+DC_TEST(octTreeQueriesDontAllocate)
+{
+	OctTree octTree;
+	addRandomEntities(octTree, 10000, 500.0f);
+	std::vector<OctTreeEntity*> entities;
+	std::vector<const OctTreeNode*> nodes;
+	OctTree::FrustumCullingState frustumCullingState;
+
+	// Each query, with the positions and frustums following a path through the tree
+	size_t numFound = 0;
+	auto performQueries = [&](int queryPARAM)
+	{
+		Vector3f vPosition(-400.0f + queryPARAM * 0.8f, 0.0f, 0.0f);
+		AABB aabb(vPosition - Vector3f(50.0f, 50.0f, 50.0f), vPosition + Vector3f(50.0f, 50.0f, 50.0f));
+		Frustum frustum = createFrustum(vPosition, vPosition + Vector3f(0.0f, 0.0f, 100.0f));
+		entities.clear();
+		octTree.getEntitiesWithinRange(vPosition, 50.0f, entities);
+		octTree.getEntitiesWithinAABB(aabb, entities);
+		octTree.getEntitiesWithinFrustum(frustum, entities);
+		octTree.getEntitiesWithinFrustum(frustum, entities, frustumCullingState);
+		numFound += entities.size();
+		nodes.clear();
+		octTree.getNodesWithEntitiesWhichIntersect(aabb, nodes);
+		octTree.getNodesWithEntitiesWhichIntersect(frustum, nodes);
+		numFound += nodes.size();
+		octTree.visitEntitiesWithinRange(vPosition, 50.0f, [&](OctTreeEntity*) { numFound++; });
+		octTree.visitEntitiesWithinAABB(aabb, [&](OctTreeEntity*) { numFound++; });
+		octTree.visitEntitiesWithinFrustum(frustum, [&](OctTreeEntity*) { numFound++; });
+		octTree.visitNodesWithEntitiesWhichIntersect(aabb, [&](const OctTreeNode*) { numFound++; });
+		octTree.visitNodesWithEntitiesWhichIntersect(frustum, [&](const OctTreeNode*) { numFound++; });
+	};
+
+	// Grow the vectors and the culling state first
+	for (int i = 0; i < kNumQueries; i++)
+		performQueries(i);
+
+	size_t numAllocations = DCTests::getNumAllocations();
+	for (int i = 0; i < kNumQueries; i++)
+		performQueries(i);
+	TestCheck(DCTests::getNumAllocations() == numAllocations);
+	TestCheck(numFound > 0);
+}
+
+// The same as octTreeQueriesDontAllocate, for a QuadTree
+DC_TEST(quadTreeQueriesDontAllocate)
+{
+	QuadTree quadTree;
+	std::mt19937 random(1);
+	std::uniform_int_distribution<int> position(-5000, 5000);
+	for (int i = 0; i < 10000; i++)
+		quadTree.addEntity(position(random), position(random), i);
+	std::vector<QuadTreeEntity*> entities;
+	std::vector<QuadTreeNode*> nodes;
+
+	size_t numFound = 0;
+	auto performQueries = [&](int queryPARAM)
+	{
+		int positionX = -4000 + queryPARAM * 8;
+		Rect rect(positionX - 500, -500, positionX + 500, 500);
+		entities.clear();
+		quadTree.getEntitiesWithinRange(positionX, 0, 500, entities);
+		quadTree.getEntitiesWithinRect(rect, entities);
+		numFound += entities.size();
+		nodes.clear();
+		quadTree.getNodesWithEntitiesWhichIntersect(rect, nodes);
+		numFound += nodes.size();
+		quadTree.visitEntitiesWithinRange(positionX, 0, 500, [&](QuadTreeEntity*) { numFound++; });
+		quadTree.visitEntitiesWithinRect(rect, [&](QuadTreeEntity*) { numFound++; });
+		quadTree.visitNodesWithEntitiesWhichIntersect(rect, [&](QuadTreeNode*) { numFound++; });
+	};
+
+	for (int i = 0; i < kNumQueries; i++)
+		performQueries(i);
+
+	size_t numAllocations = DCTests::getNumAllocations();
+	for (int i = 0; i < kNumQueries; i++)
+		performQueries(i);
+	TestCheck(DCTests::getNumAllocations() == numAllocations);
+	TestCheck(numFound > 0);
+}
+
+// The buffer and visitor queries must find the same entities as the queries which return a vector
+DC_TEST(octTreeQueryFormsAgree)
+{
+	OctTree octTree;
+	addRandomEntities(octTree, 10000, 500.0f);
+	Vector3f vPosition(25.0f, -10.0f, 40.0f);
+	AABB aabb(vPosition - Vector3f(80.0f, 80.0f, 80.0f), vPosition + Vector3f(80.0f, 80.0f, 80.0f));
+	Frustum frustum = createFrustum(vPosition, Vector3f(0.0f, 0.0f, 0.0f));
+
+	std::vector<OctTreeEntity*> returned = octTree.getEntitiesWithinFrustum(frustum);
+	std::vector<OctTreeEntity*> buffer;
+	octTree.getEntitiesWithinFrustum(frustum, buffer);
+	std::vector<OctTreeEntity*> visited;
+	octTree.visitEntitiesWithinFrustum(frustum, [&](OctTreeEntity* entity) { visited.push_back(entity); });
+	TestCheck(!returned.empty());
+	TestCheck(returned == buffer);
+	TestCheck(returned == visited);
+
+	returned = octTree.getEntitiesWithinAABB(aabb);
+	buffer.clear();
+	octTree.getEntitiesWithinAABB(aabb, buffer);
+	visited.clear();
+	octTree.visitEntitiesWithinAABB(aabb, [&](OctTreeEntity* entity) { visited.push_back(entity); });
+	TestCheck(!returned.empty());
+	TestCheck(returned == buffer);
+	TestCheck(returned == visited);
+}
+
+// Each of the broad phase methods must find exactly the pairs which testing every entity against every other finds.
+// The entities are clumped together in places, so that some of the tree's leaf nodes are full and others empty.
+DC_TEST(broadPhasePairsMatchBruteForce)
+{
+	const int kNumEntities = 3000;
+	const float kRange = 6.0f;
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+	std::vector<Vector3f> positions(kNumEntities);
+	for (int i = 0; i < kNumEntities; i++)
+	{
+		if (i % 2)
+			positions[i] = positions[i - 1] + Vector3f(offset(random), offset(random), offset(random));
+		else
+			positions[i].set(position(random), position(random), position(random));
+	}
+
+	// The pairs of indicies of the entities within range of each other, and whose cubes overlap
+	std::vector<std::pair<unsigned int, unsigned int>> expectedPairs;
+	std::vector<std::pair<unsigned int, unsigned int>> expectedPairs2D;
+	std::vector<std::pair<unsigned int, unsigned int>> expectedOverlaps;
+	std::vector<AABB> aabbs(kNumEntities);
+	for (int i = 0; i < kNumEntities; i++)
+		aabbs[i].setMinMax(positions[i] - Vector3f(kRange * 0.5f, kRange * 0.5f, kRange * 0.5f), positions[i] + Vector3f(kRange * 0.5f, kRange * 0.5f, kRange * 0.5f));
+	for (unsigned int i = 0; i < kNumEntities; i++)
+	{
+		for (unsigned int j = i + 1; j < kNumEntities; j++)
+		{
+			float fDiffX = positions[i].x - positions[j].x;
+			float fDiffY = positions[i].y - positions[j].y;
+			float fDiffZ = positions[i].z - positions[j].z;
+			if (fDiffX * fDiffX + fDiffY * fDiffY + fDiffZ * fDiffZ <= kRange * kRange)
+				expectedPairs.push_back(std::make_pair(i, j));
+			long long iDiffX = (long long)(int)positions[i].x - (int)positions[j].x;
+			long long iDiffY = (long long)(int)positions[i].y - (int)positions[j].y;
+			if (iDiffX * iDiffX + iDiffY * iDiffY <= (long long)(kRange * kRange))
+				expectedPairs2D.push_back(std::make_pair(i, j));
+			if (aabbs[i].getAABBintersects(aabbs[j]))
+				expectedOverlaps.push_back(std::make_pair(i, j));
+		}
+	}
+	TestCheck(!expectedPairs.empty());
+
+	OctTree octTree;
+	QuadTree quadTree;
+	for (int i = 0; i < kNumEntities; i++)
+	{
+		octTree.addEntity(positions[i], i);
+		quadTree.addEntity((int)positions[i].x, (int)positions[i].y, i);
+	}
+	std::vector<std::pair<unsigned int, unsigned int>> pairs;
+	for (const std::pair<OctTreeEntity*, OctTreeEntity*>& entityPair : octTree.getEntityPairsWithinRange(kRange))
+		pairs.push_back(std::make_pair((unsigned int)std::min(entityPair.first->userData, entityPair.second->userData), (unsigned int)std::max(entityPair.first->userData, entityPair.second->userData)));
+	std::sort(pairs.begin(), pairs.end());
+	TestCheck(pairs == expectedPairs);
+
+	pairs.clear();
+	for (const std::pair<QuadTreeEntity*, QuadTreeEntity*>& entityPair : quadTree.getEntityPairsWithinRange((int)kRange))
+		pairs.push_back(std::make_pair((unsigned int)std::min(entityPair.first->userData, entityPair.second->userData), (unsigned int)std::max(entityPair.first->userData, entityPair.second->userData)));
+	std::sort(pairs.begin(), pairs.end());
+	TestCheck(pairs == expectedPairs2D);
+
+	// Twice, so that the second call uses the order sorted by the first
+	SweepAndPrune sweepAndPrune;
+	for (int iCall = 0; iCall < 2; iCall++)
+	{
+		pairs = sweepAndPrune.getOverlappingPairs(aabbs);
+		std::sort(pairs.begin(), pairs.end());
+		TestCheck(pairs == expectedOverlaps);
+	}
+}
+
+// One thread moves all of the entities of a tree each frame while holding the lock returned by lockForWriting(),
+// while other threads hold the lock returned by lockForReading() and query the tree with it's const methods.
+// Each query's results must be exactly those of a brute force search of the positions for the frame which was
+// last written, and once the threads have finished, the tree must give the same results as a tree which was only
+// ever used from one thread.
+DC_TEST(octTreeConcurrentQueriesAndWrites)
+{
+	const int kNumEntities = 5000;
+	const int kNumFrames = 200;
+	const unsigned int kNumReaders = 3;
+	const int kNumQueriesPerReader = 300;
+	const float kRange = 40.0f;
+
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> position(-300.0f, 300.0f);
+	std::vector<Vector3f> startPositions(kNumEntities);
+	for (int i = 0; i < kNumEntities; i++)
+		startPositions[i] = Vector3f(position(random), position(random), position(random));
+
+	OctTree octTree;
+	std::vector<SpatialEntityHandle> handles(kNumEntities);
+	for (int i = 0; i < kNumEntities; i++)
+		handles[i] = octTree.addEntity(getStressTestPosition(startPositions, i, 0), i);
+
+	// The positions which the tree holds, only changed while the write lock is held
+	std::vector<Vector3f> writtenPositions(kNumEntities);
+	for (int i = 0; i < kNumEntities; i++)
+		writtenPositions[i] = getStressTestPosition(startPositions, i, 0);
+	std::atomic<unsigned int> numWrongResults(0);
+
+	// Each reader performs a fixed number of queries, rather than querying until the writer has finished, as a
+	// reader/writer lock may let readers keep the writer waiting for as long as there's always a reader holding it.
+	auto reader = [&](unsigned int readerPARAM)
+	{
+		std::mt19937 readerRandom(readerPARAM);
+		std::uniform_real_distribution<float> readerPosition(-300.0f, 300.0f);
+		std::vector<OctTreeEntity*> entities;
+		std::vector<int> found;
+		std::vector<int> expected;
+		for (int query = 0; query < kNumQueriesPerReader; query++)
+		{
+			Vector3f vCentre(readerPosition(readerRandom), readerPosition(readerRandom), readerPosition(readerRandom));
+			std::shared_lock<std::shared_mutex> lock = octTree.lockForReading();
+
+			// Range query
+			entities.clear();
+			octTree.getEntitiesWithinRangeExact(vCentre, kRange, entities);
+			found.clear();
+			for (OctTreeEntity* pEntity : entities)
+				found.push_back(pEntity->userData);
+			std::sort(found.begin(), found.end());
+			expected.clear();
+			float fNearestSquared = FLT_MAX;
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				Vector3f vDiff = writtenPositions[i] - vCentre;
+				float fDistanceSquared = vDiff.x * vDiff.x + vDiff.y * vDiff.y + vDiff.z * vDiff.z;
+				if (fDistanceSquared <= kRange * kRange)
+					expected.push_back(i);
+				fNearestSquared = std::min(fNearestSquared, fDistanceSquared);
+			}
+			if (found != expected)
+				numWrongResults++;
+
+			// Nearest entity, compared by distance as several entities may be equally near
+			entities.clear();
+			octTree.getNearestEntities(vCentre, 1, FLT_MAX, entities);
+			if (entities.size() != 1)
+				numWrongResults++;
+			else
+			{
+				Vector3f vDiff = entities[0]->getPosition() - vCentre;
+				if (vDiff.x * vDiff.x + vDiff.y * vDiff.y + vDiff.z * vDiff.z != fNearestSquared)
+					numWrongResults++;
+			}
+
+			// The handles must still find the entities at their written positions
+			int entity = (int)(readerRandom() % kNumEntities);
+			Vector3f vPosition;
+			octTree.getEntityPosition(handles[entity], vPosition);
+			if (vPosition != writtenPositions[entity])
+				numWrongResults++;
+
+			lock.unlock();
+			std::this_thread::yield();
+		}
+	};
+
+	std::vector<std::thread> readers;
+	for (unsigned int i = 0; i < kNumReaders; i++)
+		readers.push_back(std::thread(reader, i));
+
+	std::vector<Vector3f> positions(kNumEntities);
+	for (int frame = 1; frame < kNumFrames; frame++)
+	{
+		for (int i = 0; i < kNumEntities; i++)
+			positions[i] = getStressTestPosition(startPositions, i, frame);
+		std::unique_lock<std::shared_mutex> lock = octTree.lockForWriting();
+		octTree.setEntityPositions(handles, positions);
+		writtenPositions.swap(positions);
+		lock.unlock();
+		std::this_thread::yield();
+	}
+	for (std::thread& thread : readers)
+		thread.join();
+	TestCheck(0 == numWrongResults);
+
+	// Compare against a tree which has only been used from this thread
+	OctTree singleThreadedTree;
+	for (int i = 0; i < kNumEntities; i++)
+		singleThreadedTree.addEntity(getStressTestPosition(startPositions, i, kNumFrames - 1), i);
+	for (int i = 0; i < 100; i++)
+	{
+		Vector3f vCentre(position(random), position(random), position(random));
+		std::vector<OctTreeEntity*> entities = octTree.getEntitiesWithinRangeExact(vCentre, kRange, true);
+		std::vector<OctTreeEntity*> singleThreadedEntities = singleThreadedTree.getEntitiesWithinRangeExact(vCentre, kRange, true);
+		bool bSame = entities.size() == singleThreadedEntities.size();
+		for (size_t j = 0; bSame && j < entities.size(); j++)
+			bSame = entities[j]->userData == singleThreadedEntities[j]->userData;
+		TestCheck(bSame);
+	}
+}
+
+// The exact queries of SpatialHashGrid2D must return exactly the entities which testing every entity finds.
+// The entities are spread either side of zero, so that the cells with negative coordinates are used, and each round
+// some of them are moved within their cells, some are moved across the world, some are removed and more are added.
+// Once every few rounds all of the entities move far away, leaving lots of empty cells behind, so that the cells
+// hash table fills up and has to be rebuilt.
+DC_TEST(spatialHashGrid2DExactQueriesMatchBruteForce)
+{
+	const int kNumEntities = 4000;
+	const int kCellSize = 16;
+	std::mt19937 random(6);
+	std::uniform_int_distribution<int> position(-400, 400);
+	std::uniform_int_distribution<int> smallMove(-3, 3);
+	std::uniform_int_distribution<int> entity(0, kNumEntities - 1);
+
+	SpatialHashGrid2D grid(kCellSize);
+	std::vector<SpatialEntityHandle> handles(kNumEntities);
+	std::vector<int> positionsX(kNumEntities);
+	std::vector<int> positionsY(kNumEntities);
+	std::vector<bool> exists(kNumEntities, true);
+	for (int i = 0; i < kNumEntities; i++)
+	{
+		positionsX[i] = position(random);
+		positionsY[i] = position(random);
+		handles[i] = grid.addEntity(positionsX[i], positionsY[i], i);
+	}
+
+	// Returns the sorted userData of the given entities
+	auto getSortedIndicies = [](const std::vector<QuadTreeEntity*>& entitiesPARAM)
+		{
+			std::vector<int> indicies;
+			for (const QuadTreeEntity* pEntity : entitiesPARAM)
+				indicies.push_back(pEntity->userData);
+			std::sort(indicies.begin(), indicies.end());
+			return indicies;
+		};
+
+	int iWorldOffset = 0;
+	for (int round = 0; round < 40; round++)
+	{
+		if (round % 8 == 7)
+		{
+			// Move everything far away, leaving all of the cells it was in empty
+			iWorldOffset += 100000;
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				if (!exists[i])
+					continue;
+				positionsX[i] = position(random) + iWorldOffset;
+				positionsY[i] = position(random) - iWorldOffset;
+				grid.setEntityPosition(handles[i], positionsX[i], positionsY[i]);
+			}
+		}
+		else
+		{
+			for (int iMove = 0; iMove < kNumEntities; iMove++)
+			{
+				int i = entity(random);
+				if (!exists[i])
+					continue;
+				if (iMove % 4)
+				{
+					positionsX[i] += smallMove(random);
+					positionsY[i] += smallMove(random);
+				}
+				else
+				{
+					positionsX[i] = position(random) + iWorldOffset;
+					positionsY[i] = position(random) - iWorldOffset;
+				}
+				grid.setEntityPosition(handles[i], positionsX[i], positionsY[i]);
+			}
+			for (int iRemove = 0; iRemove < 200; iRemove++)
+			{
+				int i = entity(random);
+				if (exists[i])
+				{
+					grid.removeEntity(handles[i]);
+					TestCheck(!grid.getEntityExists(handles[i]));
+					exists[i] = false;
+				}
+				else
+				{
+					positionsX[i] = position(random) + iWorldOffset;
+					positionsY[i] = position(random) - iWorldOffset;
+					handles[i] = grid.addEntity(positionsX[i], positionsY[i], i);
+					exists[i] = true;
+				}
+			}
+		}
+
+		for (int iQuery = 0; iQuery < 20; iQuery++)
+		{
+			int iQueryX = position(random) + iWorldOffset;
+			int iQueryY = position(random) - iWorldOffset;
+			int iRange = (iQuery % 5) * 40 + 1;
+			Rect rect(iQueryX - iRange, iQueryY - iRange / 2, iQueryX + iRange / 3, iQueryY + iRange);
+			std::vector<int> expectedInRange;
+			std::vector<int> expectedInRect;
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				if (!exists[i])
+					continue;
+				long long iDiffX = (long long)positionsX[i] - iQueryX;
+				long long iDiffY = (long long)positionsY[i] - iQueryY;
+				if (iDiffX * iDiffX + iDiffY * iDiffY <= (long long)iRange * iRange)
+					expectedInRange.push_back(i);
+				if (positionsX[i] >= rect.minX && positionsX[i] <= rect.maxX && positionsY[i] >= rect.minY && positionsY[i] <= rect.maxY)
+					expectedInRect.push_back(i);
+			}
+			std::vector<QuadTreeEntity*> inRange = grid.getEntitiesWithinRangeExact(iQueryX, iQueryY, iRange, true);
+			TestCheck(getSortedIndicies(inRange) == expectedInRange);
+			for (size_t i = 1; i < inRange.size(); i++)
+			{
+				long long iDiffAX = (long long)positionsX[inRange[i - 1]->userData] - iQueryX;
+				long long iDiffAY = (long long)positionsY[inRange[i - 1]->userData] - iQueryY;
+				long long iDiffBX = (long long)positionsX[inRange[i]->userData] - iQueryX;
+				long long iDiffBY = (long long)positionsY[inRange[i]->userData] - iQueryY;
+				TestCheck(iDiffAX * iDiffAX + iDiffAY * iDiffAY <= iDiffBX * iDiffBX + iDiffBY * iDiffBY);
+			}
+			TestCheck(getSortedIndicies(grid.getEntitiesWithinRectExact(rect)) == expectedInRect);
+		}
+
+		// Each entity must still be found by it's handle, at the position it was last given
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			if (!exists[i])
+				continue;
+			int iPositionX, iPositionY;
+			grid.getEntityPosition(handles[i], iPositionX, iPositionY);
+			TestCheck(iPositionX == positionsX[i] && iPositionY == positionsY[i]);
+		}
+	}
+
+	// All of the cells left empty by the moves far away must have been removed when the table was rebuilt
+	TestCheck(grid.getNumCellsWithEntities() <= (unsigned int)kNumEntities);
+}
+
+// Entities are added to an OctTree and a QuadTree, queried, then some of them are moved and some removed and they are
+// queried again. A quarter of the entities are packed into a tiny cluster around the origin, so that the nodes at the
+// maximum depth there hold far more than maxEntitiesPerNode entities, and every fifth query is centered on it.
+// The expected hashes were recorded with the trees as they were before their nodes were moved into a pool, with each
+// of the results of their non exact queries filtered down to the entities which are actually within range or inside of
+// the AABB or rect. The positions are whole numbers, so that the distances are exact and so are the same whichever
+// compiler is used, and they are made from the raw output of std::mt19937, which unlike the distributions is the same
+// for every standard library.
+DC_TEST(octTreeAndQuadTreeMatchGoldenResults)
+{
+	const int kNumEntities = 3000;
+	const unsigned long long kExpectedOctTreeHashes[2] = { 0x2c36862adf0be0f5ull, 0x39262125145fc8c2ull };
+	const unsigned long long kExpectedOctTreeNumFound[2] = { 16347, 17559 };
+	const unsigned long long kExpectedQuadTreeHashes[2] = { 0x396c95842e5a19daull, 0x24335966f2fe4ef7ull };
+	const unsigned long long kExpectedQuadTreeNumFound[2] = { 16614, 18366 };
+
+	{
+		std::mt19937 random(1);
+		auto position = [&]() { return (int)(random() % 2001) - 1000; };
+		auto clusterPosition = [&]() { return (int)(random() % 9) - 4; };
+		// The order in which function arguments are evaluated isn't defined, so each value is taken from the generator
+		// in a statement of it's own, to get the same order whichever compiler is used
+		auto randomPosition = [&](bool inClusterPARAM)
+			{
+				int iPositionX = inClusterPARAM ? clusterPosition() : position();
+				int iPositionY = inClusterPARAM ? clusterPosition() : position();
+				int iPositionZ = inClusterPARAM ? clusterPosition() : position();
+				return Vector3f((float)iPositionX, (float)iPositionY, (float)iPositionZ);
+			};
+		OctTree octTree;
+		std::vector<SpatialEntityHandle> handles(kNumEntities);
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			handles[i] = octTree.addEntity(randomPosition(0 == i % 4), i);
+		}
+		for (int phase = 0; phase < 2; phase++)
+		{
+			QueryResultsHash hash;
+			for (int iQuery = 0; iQuery < 50; iQuery++)
+			{
+				Vector3f vCentre = randomPosition(false);
+				if (0 == iQuery % 5)
+					vCentre = randomPosition(true);
+				int iRange = 50 + (int)(random() % 250);
+				hash.addQuery(octTree.getEntitiesWithinRangeExact(vCentre, (float)iRange));
+				Vector3f vHalfDims;
+				vHalfDims.x = (float)(20 + (int)(random() % 200));
+				vHalfDims.y = (float)(20 + (int)(random() % 200));
+				vHalfDims.z = (float)(20 + (int)(random() % 200));
+				hash.addQuery(octTree.getEntitiesWithinAABBExact(AABB(vCentre - vHalfDims, vCentre + vHalfDims)));
+			}
+			TestCheck(kExpectedOctTreeHashes[phase] == hash.hash);
+			TestCheck(kExpectedOctTreeNumFound[phase] == hash.numEntitiesFound);
+
+			if (0 == phase)
+			{
+				for (int i = 0; i < kNumEntities; i += 3)
+					octTree.setEntityPosition(handles[i], randomPosition(0 == i % 2));
+				for (int i = 0; i < kNumEntities; i += 7)
+					octTree.removeEntity(handles[i]);
+			}
+		}
+	}
+
+	{
+		std::mt19937 random(2);
+		auto position = [&]() { return (int)(random() % 2001) - 1000; };
+		auto clusterPosition = [&]() { return (int)(random() % 9) - 4; };
+		auto randomPosition = [&](bool inClusterPARAM, int& positionXPARAM, int& positionYPARAM)
+			{
+				positionXPARAM = inClusterPARAM ? clusterPosition() : position();
+				positionYPARAM = inClusterPARAM ? clusterPosition() : position();
+			};
+		QuadTree quadTree;
+		std::vector<SpatialEntityHandle> handles(kNumEntities);
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			int iPositionX, iPositionY;
+			randomPosition(0 == i % 4, iPositionX, iPositionY);
+			handles[i] = quadTree.addEntity(iPositionX, iPositionY, i);
+		}
+		for (int phase = 0; phase < 2; phase++)
+		{
+			QueryResultsHash hash;
+			for (int iQuery = 0; iQuery < 50; iQuery++)
+			{
+				int iCentreX, iCentreY;
+				randomPosition(false, iCentreX, iCentreY);
+				if (0 == iQuery % 5)
+					randomPosition(true, iCentreX, iCentreY);
+				int iRange = 20 + (int)(random() % 150);
+				hash.addQuery(quadTree.getEntitiesWithinRangeExact(iCentreX, iCentreY, iRange));
+				int iHalfWidth = 10 + (int)(random() % 150);
+				int iHalfHeight = 10 + (int)(random() % 150);
+				hash.addQuery(quadTree.getEntitiesWithinRectExact(Rect(iCentreX - iHalfWidth, iCentreY - iHalfHeight, iCentreX + iHalfWidth, iCentreY + iHalfHeight)));
+			}
+			TestCheck(kExpectedQuadTreeHashes[phase] == hash.hash);
+			TestCheck(kExpectedQuadTreeNumFound[phase] == hash.numEntitiesFound);
+
+			if (0 == phase)
+			{
+				for (int i = 0; i < kNumEntities; i += 3)
+				{
+					int iPositionX, iPositionY;
+					randomPosition(0 == i % 2, iPositionX, iPositionY);
+					quadTree.setEntityPosition(handles[i], iPositionX, iPositionY);
+				}
+				for (int i = 0; i < kNumEntities; i += 7)
+					quadTree.removeEntity(handles[i]);
+			}
+		}
+	}
+}
+
+// Entities which sit upon the boundaries between nodes and move back and forth across them each frame are moved
+// between nodes each time by a tree which isn't loose, but stay where they are for longer the looser the tree is.
+// Some of the entities are too large to go down into the smaller nodes of a loose tree, so are stored in nodes which
+// have children, so each of the queries is also checked against a brute force search of the positions.
+DC_TEST(octTreeLooseFactorReducesReinsertions)
+{
+	const int kNumEntities = 2000;
+	const int kNumFrames = 60;
+	std::mt19937 random(9);
+	std::vector<Vector3f> basePositions(kNumEntities);
+	std::vector<float> radii(kNumEntities);
+	std::vector<float> directions(kNumEntities);
+	for (int i = 0; i < kNumEntities; i++)
+	{
+		// Upon the boundaries of the nodes which are 4 units across, or any of the larger nodes
+		int iX = (int)(random() % 32) - 16;
+		int iY = (int)(random() % 32) - 16;
+		int iZ = (int)(random() % 32) - 16;
+		basePositions[i].set(iX * 4.0f, iY * 4.0f, iZ * 4.0f);
+		radii[i] = (0 == i % 10) ? 20.0f : 0.25f;
+		directions[i] = (random() % 2) ? 1.0f : -1.0f;
+	}
+
+	const float looseFactors[] = { 1.0f, 1.5f, 2.0f };
+	unsigned int numReinsertions[3];
+	for (int iLooseFactor = 0; iLooseFactor < 3; iLooseFactor++)
+	{
+		OctTree octTree(8, 2.0f, looseFactors[iLooseFactor]);
+		std::vector<SpatialEntityHandle> handles(kNumEntities);
+		for (int i = 0; i < kNumEntities; i++)
+			handles[i] = octTree.addEntity(basePositions[i], i, 0, radii[i]);
+		octTree.resetNumReinsertions();
+
+		std::vector<Vector3f> positions(kNumEntities);
+		std::vector<OctTreeEntity*> entities;
+		for (int iFrame = 0; iFrame < kNumFrames; iFrame++)
+		{
+			float fOffset = (iFrame % 2) ? 0.5f : -0.5f;
+			for (int i = 0; i < kNumEntities; i++)
+				positions[i] = basePositions[i] + Vector3f(fOffset, fOffset, -fOffset) * directions[i];
+			octTree.setEntityPositions(handles, positions);
+
+			if (iFrame % 10)
+				continue;
+
+			// Range and nearest queries about one of the entities
+			const Vector3f& vCentre = positions[iFrame * 31 % kNumEntities];
+			const float kRange = 9.0f;
+			std::vector<int> expected;
+			std::vector<std::pair<float, int>> distances;
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				float fDistanceSquared = positions[i].getDistanceSquared(vCentre);
+				if (fDistanceSquared <= kRange * kRange)
+					expected.push_back(i);
+				distances.push_back(std::make_pair(fDistanceSquared, i));
+			}
+			std::vector<int> found;
+			entities.clear();
+			octTree.getEntitiesWithinRangeExact(vCentre, kRange, entities);
+			for (OctTreeEntity* pEntity : entities)
+				found.push_back(pEntity->userData);
+			std::sort(found.begin(), found.end());
+			TestCheck(found == expected);
+
+			std::sort(distances.begin(), distances.end());
+			entities = octTree.getNearestEntities(vCentre, 20);
+			TestCheck(20 == entities.size());
+			for (unsigned int i = 0; i < entities.size(); i++)
+				TestCheck(positions[entities[i]->userData].getDistanceSquared(vCentre) == distances[i].first);
+
+			// The pairs within range of each other
+			std::vector<std::pair<int, int>> expectedPairs;
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				for (int j = i + 1; j < kNumEntities; j++)
+				{
+					if (positions[i].getDistanceSquared(positions[j]) <= 2.0f * 2.0f)
+						expectedPairs.push_back(std::make_pair(i, j));
+				}
+			}
+			std::vector<std::pair<int, int>> pairs;
+			for (const std::pair<OctTreeEntity*, OctTreeEntity*>& entityPair : octTree.getEntityPairsWithinRange(2.0f))
+				pairs.push_back(std::make_pair(std::min(entityPair.first->userData, entityPair.second->userData), std::max(entityPair.first->userData, entityPair.second->userData)));
+			std::sort(pairs.begin(), pairs.end());
+			TestCheck(!expectedPairs.empty());
+			TestCheck(pairs == expectedPairs);
+		}
+		numReinsertions[iLooseFactor] = octTree.getNumReinsertions();
+	}
+
+	// Every entity is moved across a boundary each frame by the tree which isn't loose
+	TestCheck(numReinsertions[0] >= (unsigned int)kNumEntities * (kNumFrames - 1) / 2);
+	TestCheck(numReinsertions[1] < numReinsertions[0] / 4);
+	TestCheck(numReinsertions[2] <= numReinsertions[1]);
+}
+
+
+// Removing an entity must invalidate it's handle for good, however many times it's slot is reused afterwards, even
+// once the slot's generation has gone through every value which fits into a handle.
+DC_TEST(spatialEntityHandlesStayInvalidAfterSlotReuse)
+{
+	OctTree octTree;
+	checkRemovedHandlesStayInvalid(octTree, [](OctTree& tree, int userData) { return tree.addEntity(Vector3f(1.0f, 2.0f, 3.0f), userData); });
+	QuadTree quadTree;
+	checkRemovedHandlesStayInvalid(quadTree, [](QuadTree& tree, int userData) { return tree.addEntity(1, 2, userData); });
+	SpatialHashGrid2D spatialHashGrid;
+	checkRemovedHandlesStayInvalid(spatialHashGrid, [](SpatialHashGrid2D& tree, int userData) { return tree.addEntity(1, 2, userData); });
+	LinearOctTree linearOctTree;
+	checkRemovedHandlesStayInvalid(linearOctTree, [](LinearOctTree& tree, int userData) { return tree.addEntity(Vector3f(1.0f, 2.0f, 3.0f), userData); });
+}
+
+// Emptying part of a tree, by removing some of it's entities and moving the others away, must free the nodes there,
+// collapsing those which are left holding only a few entities, and compact() must then free the unused part of the
+// node pool without changing the results of any query, or which entity each handle refers to.
+// Each tree is used once with node collapsing turned off, which must leave more nodes behind.
+DC_TEST(octTreeAndQuadTreeCompactKeepsQueryResults)
+{
+	const int kNumEntities = 4000;
+
+	unsigned int numOctTreeNodesLeft[2];
+	for (int iCollapse = 0; iCollapse < 2; iCollapse++)
+	{
+		std::mt19937 random(4);
+		auto coordinate = [&]() { return (float)((int)(random() % 401) - 200); };
+		auto randomPosition = [&]()
+			{
+				float fX = coordinate();
+				float fY = coordinate();
+				float fZ = coordinate();
+				return Vector3f(fX, fY, fZ);
+			};
+		OctTree octTree;
+		if (!iCollapse)
+			octTree.setNodeCollapseThreshold(0);
+		std::vector<SpatialEntityHandle> handles(kNumEntities);
+		std::vector<Vector3f> positions(kNumEntities);
+		std::vector<bool> removed(kNumEntities, false);
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			positions[i] = randomPosition();
+			handles[i] = octTree.addEntity(positions[i], i);
+		}
+		unsigned int numNodesBefore = octTree.getNumNodes();
+
+		// Empty most of the negative half along x, removing some of the entities and moving the rest across
+		std::vector<SpatialEntityHandle> movedHandles;
+		std::vector<Vector3f> movedPositions;
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			if (positions[i].x >= 0.0f || 0 == i % 10)
+				continue;
+			if (i % 3)
+			{
+				octTree.removeEntity(handles[i]);
+				removed[i] = true;
+			}
+			else
+			{
+				positions[i].x = -positions[i].x;
+				movedHandles.push_back(handles[i]);
+				movedPositions.push_back(positions[i]);
+			}
+		}
+		octTree.setEntityPositions(movedHandles, movedPositions);
+		TestCheck(octTree.getNumNodes() < numNodesBefore);
+		TestCheck(octTree.getNumFreeNodes() > 0);
+		TestCheck(0 == octTree.getNumEmptyNodes());
+		numOctTreeNodesLeft[iCollapse] = octTree.getNumNodes();
+
+		// Each range query is also checked against a brute force search of the positions
+		auto performQueries = [&]()
+			{
+				std::mt19937 queryRandom(7);
+				QueryResultsHash hash;
+				for (int iQuery = 0; iQuery < 40; iQuery++)
+				{
+					int iX = (int)(queryRandom() % 401) - 200;
+					int iY = (int)(queryRandom() % 401) - 200;
+					int iZ = (int)(queryRandom() % 401) - 200;
+					Vector3f vCentre((float)iX, (float)iY, (float)iZ);
+					float fRange = (float)(10 + (int)(queryRandom() % 60));
+					std::vector<OctTreeEntity*> entities = octTree.getEntitiesWithinRangeExact(vCentre, fRange);
+					hash.addQuery(entities);
+					size_t numExpected = 0;
+					for (int i = 0; i < kNumEntities; i++)
+					{
+						if (!removed[i] && positions[i].getDistanceSquared(vCentre) <= fRange * fRange)
+							numExpected++;
+					}
+					TestCheck(entities.size() == numExpected);
+					Vector3f vHalfDims(fRange, fRange * 0.5f, fRange * 2.0f);
+					hash.addQuery(octTree.getEntitiesWithinAABBExact(AABB(vCentre - vHalfDims, vCentre + vHalfDims)));
+					hash.addQuery(octTree.getNearestEntities(vCentre, 10));
+				}
+				return hash;
+			};
+		QueryResultsHash hashBefore = performQueries();
+		unsigned int numNodes = octTree.getNumNodes();
+		octTree.compact();
+		TestCheck(0 == octTree.getNumFreeNodes());
+		TestCheck(numNodes == octTree.getNumNodes());
+		TestCheck(0 == octTree.getNumEmptyNodes());
+		QueryResultsHash hashAfter = performQueries();
+		TestCheck(hashBefore.numEntitiesFound > 0);
+		TestCheck(hashBefore.hash == hashAfter.hash);
+		TestCheck(hashBefore.numEntitiesFound == hashAfter.numEntitiesFound);
+
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			TestCheck(octTree.getEntityExists(handles[i]) == !removed[i]);
+			if (removed[i])
+				continue;
+			Vector3f vPosition;
+			octTree.getEntityPosition(handles[i], vPosition);
+			TestCheck(vPosition == positions[i]);
+			TestCheck(octTree.getEntity(handles[i])->userData == i);
+		}
+
+		// The tree carries on working once compacted, as the entities are added back and moved around
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			if (removed[i])
+			{
+				handles[i] = octTree.addEntity(positions[i], i);
+				removed[i] = false;
+			}
+			else if (0 == i % 5)
+			{
+				positions[i] = randomPosition();
+				octTree.setEntityPosition(handles[i], positions[i]);
+			}
+		}
+		performQueries();
+	}
+	TestCheck(numOctTreeNodesLeft[1] < numOctTreeNodesLeft[0]);
+
+	unsigned int numQuadTreeNodesLeft[2];
+	for (int iCollapse = 0; iCollapse < 2; iCollapse++)
+	{
+		std::mt19937 random(4);
+		auto coordinate = [&]() { return (int)(random() % 2001) - 1000; };
+		QuadTree quadTree;
+		if (!iCollapse)
+			quadTree.setNodeCollapseThreshold(0);
+		std::vector<SpatialEntityHandle> handles(kNumEntities);
+		std::vector<std::pair<int, int>> positions(kNumEntities);
+		std::vector<bool> removed(kNumEntities, false);
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			positions[i].first = coordinate();
+			positions[i].second = coordinate();
+			handles[i] = quadTree.addEntity(positions[i].first, positions[i].second, i);
+		}
+		unsigned int numNodesBefore = quadTree.getNumNodes();
+
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			if (positions[i].first >= 0 || 0 == i % 10)
+				continue;
+			if (i % 3)
+			{
+				quadTree.removeEntity(handles[i]);
+				removed[i] = true;
+			}
+			else
+			{
+				positions[i].first = -positions[i].first;
+				quadTree.setEntityPosition(handles[i], positions[i].first, positions[i].second);
+			}
+		}
+		TestCheck(quadTree.getNumNodes() < numNodesBefore);
+		TestCheck(quadTree.getNumFreeNodes() > 0);
+		TestCheck(0 == quadTree.getNumEmptyNodes());
+		numQuadTreeNodesLeft[iCollapse] = quadTree.getNumNodes();
+
+		auto performQueries = [&]()
+			{
+				std::mt19937 queryRandom(7);
+				QueryResultsHash hash;
+				for (int iQuery = 0; iQuery < 40; iQuery++)
+				{
+					int iX = (int)(queryRandom() % 2001) - 1000;
+					int iY = (int)(queryRandom() % 2001) - 1000;
+					int iRange = 30 + (int)(queryRandom() % 200);
+					std::vector<QuadTreeEntity*> entities = quadTree.getEntitiesWithinRangeExact(iX, iY, iRange);
+					hash.addQuery(entities);
+					size_t numExpected = 0;
+					for (int i = 0; i < kNumEntities; i++)
+					{
+						long long iDiffX = positions[i].first - iX;
+						long long iDiffY = positions[i].second - iY;
+						if (!removed[i] && iDiffX * iDiffX + iDiffY * iDiffY <= (long long)iRange * iRange)
+							numExpected++;
+					}
+					TestCheck(entities.size() == numExpected);
+					hash.addQuery(quadTree.getEntitiesWithinRectExact(Rect(iX - iRange, iY - iRange / 2, iX + iRange, iY + iRange * 2)));
+					hash.addQuery(quadTree.getNearestEntities(iX, iY, 10));
+				}
+				return hash;
+			};
+		QueryResultsHash hashBefore = performQueries();
+		unsigned int numNodes = quadTree.getNumNodes();
+		quadTree.compact();
+		TestCheck(0 == quadTree.getNumFreeNodes());
+		TestCheck(numNodes == quadTree.getNumNodes());
+		TestCheck(0 == quadTree.getNumEmptyNodes());
+		QueryResultsHash hashAfter = performQueries();
+		TestCheck(hashBefore.numEntitiesFound > 0);
+		TestCheck(hashBefore.hash == hashAfter.hash);
+		TestCheck(hashBefore.numEntitiesFound == hashAfter.numEntitiesFound);
+
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			TestCheck(quadTree.getEntityExists(handles[i]) == !removed[i]);
+			if (removed[i])
+				continue;
+			int iPositionX, iPositionY;
+			quadTree.getEntityPosition(handles[i], iPositionX, iPositionY);
+			TestCheck(iPositionX == positions[i].first);
+			TestCheck(iPositionY == positions[i].second);
+			TestCheck(quadTree.getEntity(handles[i])->userData == i);
+		}
+
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			if (removed[i])
+			{
+				handles[i] = quadTree.addEntity(positions[i].first, positions[i].second, i);
+				removed[i] = false;
+			}
+			else if (0 == i % 5)
+			{
+				positions[i].first = coordinate();
+				positions[i].second = coordinate();
+				quadTree.setEntityPosition(handles[i], positions[i].first, positions[i].second);
+			}
+		}
+		performQueries();
+	}
+	TestCheck(numQuadTreeNodesLeft[1] < numQuadTreeNodesLeft[0]);
+}
+
+
+// buildFromPoints(), on one thread and on several, must give trees which find the same entities as adding each of the
+// entities with addEntity(), both straight after they're built and once some of their entities have been moved and
+// removed.
+// The nearest entity queries are compared by the distances of the entities found, as which of several entities at the
+// same distance is found depends on the shape of the tree.
+DC_TEST(octTreeAndQuadTreeBuildFromPointsMatchesAddEntity)
+{
+	const int kNumEntities = 20000;
+
+	// Tree 0 is built with addEntity(), tree 1 with buildFromPoints() on one thread and tree 2 with it on four
+	const unsigned int kNumThreads[] = { 0, 1, 4 };
+	{
+		unsigned long long queryHashes[3][2];
+		std::vector<float> nearestDistances[3][2];
+		for (int iTree = 0; iTree < 3; iTree++)
+		{
+			std::mt19937 random(5);
+			auto coordinate = [&]() { return (float)((int)(random() % 2001) - 1000) * 0.5f; };
+			std::vector<Vector3f> positions(kNumEntities);
+			std::vector<int> userData(kNumEntities);
+			std::vector<bool> removed(kNumEntities, false);
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				float fX = coordinate();
+				float fY = coordinate();
+				float fZ = coordinate();
+				positions[i].set(fX, fY, fZ);
+				userData[i] = i;
+			}
+
+			OctTree octTree;
+			std::vector<SpatialEntityHandle> handles;
+			if (0 == iTree)
+			{
+				for (int i = 0; i < kNumEntities; i++)
+					handles.push_back(octTree.addEntity(positions[i], i));
+			}
+			else
+				handles = octTree.buildFromPoints(positions, userData, kNumThreads[iTree]);
+			TestCheck(handles.size() == (size_t)kNumEntities);
+
+			// Each range query is also checked against a brute force search of the positions
+			auto performQueries = [&](std::vector<float>& nearestDistancesPARAM)
+				{
+					std::mt19937 queryRandom(8);
+					QueryResultsHash hash;
+					for (int iQuery = 0; iQuery < 40; iQuery++)
+					{
+						int iX = (int)(queryRandom() % 1001) - 500;
+						int iY = (int)(queryRandom() % 1001) - 500;
+						int iZ = (int)(queryRandom() % 1001) - 500;
+						Vector3f vCentre((float)iX, (float)iY, (float)iZ);
+						float fRange = (float)(20 + (int)(queryRandom() % 80));
+						std::vector<OctTreeEntity*> entities = octTree.getEntitiesWithinRangeExact(vCentre, fRange);
+						hash.addQuery(entities);
+						size_t numExpected = 0;
+						for (int i = 0; i < kNumEntities; i++)
+						{
+							if (!removed[i] && positions[i].getDistanceSquared(vCentre) <= fRange * fRange)
+								numExpected++;
+						}
+						TestCheck(entities.size() == numExpected);
+						Vector3f vHalfDims(fRange, fRange * 0.5f, fRange * 2.0f);
+						hash.addQuery(octTree.getEntitiesWithinAABBExact(AABB(vCentre - vHalfDims, vCentre + vHalfDims)));
+						std::vector<float> distances;
+						for (OctTreeEntity* pEntity : octTree.getNearestEntities(vCentre, 10))
+							distances.push_back(pEntity->getPosition().getDistanceSquared(vCentre));
+						std::sort(distances.begin(), distances.end());
+						nearestDistancesPARAM.insert(nearestDistancesPARAM.end(), distances.begin(), distances.end());
+					}
+					TestCheck(hash.numEntitiesFound > 0);
+					return hash.hash;
+				};
+			queryHashes[iTree][0] = performQueries(nearestDistances[iTree][0]);
+
+			// Each handle refers to the entity made from the position and userData at the same index
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				TestCheck(octTree.getEntity(handles[i])->userData == i);
+				Vector3f vPosition;
+				octTree.getEntityPosition(handles[i], vPosition);
+				TestCheck(vPosition == positions[i]);
+			}
+
+			// Move and remove some of the entities, with some of them moving outside of the root node's region
+			std::vector<SpatialEntityHandle> movedHandles;
+			std::vector<Vector3f> movedPositions;
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				if (0 == i % 11)
+				{
+					octTree.removeEntity(handles[i]);
+					removed[i] = true;
+				}
+				else if (0 == i % 7)
+				{
+					positions[i] = Vector3f(positions[i].z, positions[i].x, positions[i].y) * (0 == i % 1001 ? 4.0f : 1.0f);
+					movedHandles.push_back(handles[i]);
+					movedPositions.push_back(positions[i]);
+				}
+			}
+			octTree.setEntityPositions(movedHandles, movedPositions);
+			queryHashes[iTree][1] = performQueries(nearestDistances[iTree][1]);
+		}
+		for (int iTree = 1; iTree < 3; iTree++)
+		{
+			for (int iPass = 0; iPass < 2; iPass++)
+			{
+				TestCheck(queryHashes[iTree][iPass] == queryHashes[0][iPass]);
+				TestCheck(nearestDistances[iTree][iPass] == nearestDistances[0][iPass]);
+			}
+		}
+	}
+
+	// The same for QuadTree
+	{
+		unsigned long long queryHashes[3][2];
+		std::vector<long long> nearestDistances[3][2];
+		for (int iTree = 0; iTree < 3; iTree++)
+		{
+			std::mt19937 random(5);
+			auto coordinate = [&]() { return (int)(random() % 4001) - 2000; };
+			std::vector<int> positionsX(kNumEntities);
+			std::vector<int> positionsY(kNumEntities);
+			std::vector<int> userData(kNumEntities);
+			std::vector<bool> removed(kNumEntities, false);
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				positionsX[i] = coordinate();
+				positionsY[i] = coordinate();
+				userData[i] = i;
+			}
+
+			QuadTree quadTree;
+			std::vector<SpatialEntityHandle> handles;
+			if (0 == iTree)
+			{
+				for (int i = 0; i < kNumEntities; i++)
+					handles.push_back(quadTree.addEntity(positionsX[i], positionsY[i], i));
+			}
+			else
+				handles = quadTree.buildFromPoints(positionsX, positionsY, userData, kNumThreads[iTree]);
+			TestCheck(handles.size() == (size_t)kNumEntities);
+
+			auto getDistanceSquared = [](int xPARAM, int yPARAM, int otherXPARAM, int otherYPARAM)
+				{
+					long long iDiffX = (long long)xPARAM - otherXPARAM;
+					long long iDiffY = (long long)yPARAM - otherYPARAM;
+					return iDiffX * iDiffX + iDiffY * iDiffY;
+				};
+			auto performQueries = [&](std::vector<long long>& nearestDistancesPARAM)
+				{
+					std::mt19937 queryRandom(8);
+					QueryResultsHash hash;
+					for (int iQuery = 0; iQuery < 40; iQuery++)
+					{
+						int iX = (int)(queryRandom() % 4001) - 2000;
+						int iY = (int)(queryRandom() % 4001) - 2000;
+						int iRange = 30 + (int)(queryRandom() % 200);
+						std::vector<QuadTreeEntity*> entities = quadTree.getEntitiesWithinRangeExact(iX, iY, iRange);
+						hash.addQuery(entities);
+						size_t numExpected = 0;
+						for (int i = 0; i < kNumEntities; i++)
+						{
+							if (!removed[i] && getDistanceSquared(positionsX[i], positionsY[i], iX, iY) <= (long long)iRange * iRange)
+								numExpected++;
+						}
+						TestCheck(entities.size() == numExpected);
+						hash.addQuery(quadTree.getEntitiesWithinRectExact(Rect(iX - iRange, iY - iRange / 2, iX + iRange, iY + iRange * 2)));
+						std::vector<long long> distances;
+						for (QuadTreeEntity* pEntity : quadTree.getNearestEntities(iX, iY, 10))
+							distances.push_back(getDistanceSquared(positionsX[pEntity->userData], positionsY[pEntity->userData], iX, iY));
+						std::sort(distances.begin(), distances.end());
+						nearestDistancesPARAM.insert(nearestDistancesPARAM.end(), distances.begin(), distances.end());
+					}
+					TestCheck(hash.numEntitiesFound > 0);
+					return hash.hash;
+				};
+			queryHashes[iTree][0] = performQueries(nearestDistances[iTree][0]);
+
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				TestCheck(quadTree.getEntity(handles[i])->userData == i);
+				int iPositionX, iPositionY;
+				quadTree.getEntityPosition(handles[i], iPositionX, iPositionY);
+				TestCheck(iPositionX == positionsX[i]);
+				TestCheck(iPositionY == positionsY[i]);
+			}
+
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				if (0 == i % 11)
+				{
+					quadTree.removeEntity(handles[i]);
+					removed[i] = true;
+				}
+				else if (0 == i % 7)
+				{
+					int iScale = 0 == i % 1001 ? 4 : 1;
+					std::swap(positionsX[i], positionsY[i]);
+					positionsX[i] *= iScale;
+					positionsY[i] *= iScale;
+					quadTree.setEntityPosition(handles[i], positionsX[i], positionsY[i]);
+				}
+			}
+			queryHashes[iTree][1] = performQueries(nearestDistances[iTree][1]);
+		}
+		for (int iTree = 1; iTree < 3; iTree++)
+		{
+			for (int iPass = 0; iPass < 2; iPass++)
+			{
+				TestCheck(queryHashes[iTree][iPass] == queryHashes[0][iPass]);
+				TestCheck(nearestDistances[iTree][iPass] == nearestDistances[0][iPass]);
+			}
+		}
+	}
+}
+
+// The exact queries of OctTree and QuadTree, sorted by distance and not, must find exactly the entities which testing
+// every entity finds. The positions and ranges are whole numbers within a small area, so that lots of the entities are
+// exactly at the range of a query or on the edge of it's AABB or rect, which must be found, and a quarter of them are
+// packed into a tiny cluster, so that some nodes hold far more entities than the SIMD code tests at once.
+DC_TEST(octTreeAndQuadTreeExactQueriesMatchBruteForce)
+{
+	const int kNumEntities = 3000;
+
+	// Returns the sorted userData of the given entities
+	auto getSortedIndicies = [](const auto& entitiesPARAM)
+		{
+			std::vector<int> indicies;
+			for (const auto* pEntity : entitiesPARAM)
+				indicies.push_back(pEntity->userData);
+			std::sort(indicies.begin(), indicies.end());
+			return indicies;
+		};
+
+	{
+		std::mt19937 random(9);
+		auto coordinate = [&](int entityPARAM) { return 0 == entityPARAM % 4 ? (float)((int)(random() % 5) - 2) : (float)((int)(random() % 81) - 40); };
+		OctTree octTree;
+		std::vector<SpatialEntityHandle> handles(kNumEntities);
+		std::vector<Vector3f> positions(kNumEntities);
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			float fX = coordinate(i);
+			float fY = coordinate(i);
+			float fZ = coordinate(i);
+			positions[i].set(fX, fY, fZ);
+			handles[i] = octTree.addEntity(positions[i], i);
+		}
+
+		for (int iRound = 0; iRound < 2; iRound++)
+		{
+			for (int iQuery = 0; iQuery < 40; iQuery++)
+			{
+				int iX = (int)(random() % 61) - 30;
+				int iY = (int)(random() % 61) - 30;
+				int iZ = (int)(random() % 61) - 30;
+				if (0 == iQuery % 5)
+					iX = iY = iZ = 0;
+				Vector3f vCentre((float)iX, (float)iY, (float)iZ);
+				float fRange = (float)(iQuery % 20);
+				AABB aabb(vCentre - Vector3f(fRange, fRange * 0.5f, 3.0f), vCentre + Vector3f(2.0f, fRange, fRange));
+				Vector3f vMin = aabb.getMin();
+				Vector3f vMax = aabb.getMax();
+				std::vector<int> expectedInRange;
+				std::vector<int> expectedInAABB;
+				for (int i = 0; i < kNumEntities; i++)
+				{
+					if (positions[i].getDistanceSquared(vCentre) <= fRange * fRange)
+						expectedInRange.push_back(i);
+					if (positions[i].x >= vMin.x && positions[i].x <= vMax.x && positions[i].y >= vMin.y && positions[i].y <= vMax.y && positions[i].z >= vMin.z && positions[i].z <= vMax.z)
+						expectedInAABB.push_back(i);
+				}
+				TestCheck(getSortedIndicies(octTree.getEntitiesWithinRangeExact(vCentre, fRange)) == expectedInRange);
+				std::vector<OctTreeEntity*> sorted = octTree.getEntitiesWithinRangeExact(vCentre, fRange, true);
+				TestCheck(getSortedIndicies(sorted) == expectedInRange);
+				for (size_t i = 1; i < sorted.size(); i++)
+					TestCheck(positions[sorted[i - 1]->userData].getDistanceSquared(vCentre) <= positions[sorted[i]->userData].getDistanceSquared(vCentre));
+				TestCheck(getSortedIndicies(octTree.getEntitiesWithinAABBExact(aabb)) == expectedInAABB);
+			}
+
+			// Move a third of the entities, so that the second round queries nodes whose entities have been
+			// removed from the middle of their arrays and added to the end of others'
+			for (int i = 0; i < kNumEntities; i += 3)
+			{
+				float fX = coordinate(i + 1);
+				float fY = coordinate(i + 1);
+				float fZ = coordinate(i + 1);
+				positions[i].set(fX, fY, fZ);
+				octTree.setEntityPosition(handles[i], positions[i]);
+			}
+		}
+	}
+
+	// The same for QuadTree, which also has negative positions, as it compares them as signed integers
+	{
+		std::mt19937 random(9);
+		auto coordinate = [&](int entityPARAM) { return 0 == entityPARAM % 4 ? (int)(random() % 5) - 2 : (int)(random() % 161) - 80; };
+		QuadTree quadTree;
+		std::vector<SpatialEntityHandle> handles(kNumEntities);
+		std::vector<int> positionsX(kNumEntities);
+		std::vector<int> positionsY(kNumEntities);
+		for (int i = 0; i < kNumEntities; i++)
+		{
+			positionsX[i] = coordinate(i);
+			positionsY[i] = coordinate(i);
+			handles[i] = quadTree.addEntity(positionsX[i], positionsY[i], i);
+		}
+
+		auto getDistanceSquared = [&](int entityPARAM, int xPARAM, int yPARAM)
+			{
+				long long iDiffX = (long long)positionsX[entityPARAM] - xPARAM;
+				long long iDiffY = (long long)positionsY[entityPARAM] - yPARAM;
+				return iDiffX * iDiffX + iDiffY * iDiffY;
+			};
+		for (int iRound = 0; iRound < 2; iRound++)
+		{
+			for (int iQuery = 0; iQuery < 40; iQuery++)
+			{
+				int iX = (int)(random() % 121) - 60;
+				int iY = (int)(random() % 121) - 60;
+				if (0 == iQuery % 5)
+					iX = iY = 0;
+				int iRange = iQuery % 20;
+				Rect rect(iX - iRange, iY - iRange / 2, iX + 2, iY + iRange);
+				std::vector<int> expectedInRange;
+				std::vector<int> expectedInRect;
+				for (int i = 0; i < kNumEntities; i++)
+				{
+					if (getDistanceSquared(i, iX, iY) <= (long long)iRange * iRange)
+						expectedInRange.push_back(i);
+					if (positionsX[i] >= rect.minX && positionsX[i] <= rect.maxX && positionsY[i] >= rect.minY && positionsY[i] <= rect.maxY)
+						expectedInRect.push_back(i);
+				}
+				TestCheck(getSortedIndicies(quadTree.getEntitiesWithinRangeExact(iX, iY, iRange)) == expectedInRange);
+				std::vector<QuadTreeEntity*> sorted = quadTree.getEntitiesWithinRangeExact(iX, iY, iRange, true);
+				TestCheck(getSortedIndicies(sorted) == expectedInRange);
+				for (size_t i = 1; i < sorted.size(); i++)
+					TestCheck(getDistanceSquared(sorted[i - 1]->userData, iX, iY) <= getDistanceSquared(sorted[i]->userData, iX, iY));
+				TestCheck(getSortedIndicies(quadTree.getEntitiesWithinRectExact(rect)) == expectedInRect);
+			}
+
+			for (int i = 0; i < kNumEntities; i += 3)
+			{
+				positionsX[i] = coordinate(i + 1);
+				positionsY[i] = coordinate(i + 1);
+				quadTree.setEntityPosition(handles[i], positionsX[i], positionsY[i]);
+			}
+		}
+	}
+}
+
+// Each of BVH's queries must find the same primitives as testing every one of them, whatever the number of primitives
+// per leaf and whichever of the SIMD code paths splits the nodes' children between registers.
+// The boxes have whole number corners and the rays start and end half way between whole numbers, so that none of the
+// rays only just touch a box, which would depend on how the distances are rounded.
+DC_TEST(bvhQueriesMatchBruteForce)
+{
+	const int kNumPrimitives = 1500;
+	std::mt19937 random(10);
+	auto coordinate = [&](int rangePARAM) { return (float)((int)(random() % (unsigned int)(rangePARAM * 2 + 1)) - rangePARAM); };
+	auto randomPosition = [&](int rangePARAM)
+		{
+			float fX = coordinate(rangePARAM) + 0.5f;
+			float fY = coordinate(rangePARAM) + 0.5f;
+			float fZ = coordinate(rangePARAM) + 0.5f;
+			return Vector3f(fX, fY, fZ);
+		};
+	std::vector<AABB> aabbs(kNumPrimitives);
+	for (int i = 0; i < kNumPrimitives; i++)
+	{
+		float fX = coordinate(100);
+		float fY = coordinate(100);
+		float fZ = coordinate(100);
+		float fSizeX = (float)(1 + random() % 12);
+		float fSizeY = (float)(1 + random() % 12);
+		float fSizeZ = (float)(1 + random() % 12);
+		aabbs[i] = AABB(Vector3f(fX, fY, fZ), Vector3f(fX + fSizeX, fY + fSizeY, fZ + fSizeZ));
+	}
+
+	// Returns whether anything is hit and the nearest t, testing every primitive
+	auto getNearestHit = [&](const Vector3f& originPARAM, const Vector3f& directionPARAM, float maxTPARAM, float& tOutPARAM)
+		{
+			bool bHit = false;
+			tOutPARAM = maxTPARAM;
+			for (int i = 0; i < kNumPrimitives; i++)
+			{
+				float fT;
+				if (getRayHitsAABB(originPARAM, directionPARAM, aabbs[i], tOutPARAM, fT))
+				{
+					bHit = true;
+					tOutPARAM = fT;
+				}
+			}
+			return bHit;
+		};
+
+	// Checks getSegmentIntersection() and getSegmentIntersectsAny() against testing every primitive
+	auto checkSegment = [&](const BVH& bvhPARAM, const Vector3f& startPARAM, const Vector3f& endPARAM)
+		{
+			float fExpectedT;
+			bool bExpectedHit = getNearestHit(startPARAM, endPARAM - startPARAM, 1.0f, fExpectedT);
+			unsigned int primitive = kNumPrimitives;
+			float fT = -1.0f;
+			TestCheck(bvhPARAM.getSegmentIntersection(startPARAM, endPARAM, primitive, fT) == bExpectedHit);
+			TestCheck(bvhPARAM.getSegmentIntersectsAny(startPARAM, endPARAM) == bExpectedHit);
+			if (!bExpectedHit)
+			{
+				TestCheck(kNumPrimitives == primitive && -1.0f == fT);
+				return bExpectedHit;
+			}
+			TestCheck(fT == fExpectedT);
+
+			// Several primitives may be hit at the same t, so check the one given is one of them
+			float fPrimitiveT;
+			TestCheck(primitive < (unsigned int)kNumPrimitives);
+			TestCheck(getRayHitsAABB(startPARAM, endPARAM - startPARAM, aabbs[primitive], 1.0f, fPrimitiveT) && fPrimitiveT == fT);
+			return bExpectedHit;
+		};
+
+	const unsigned int maxPrimitivesPerLeaf[] = { 1, 4, 16 };
+	for (unsigned int leafSize : maxPrimitivesPerLeaf)
+	{
+		BVH bvh;
+		bvh.build(aabbs, leafSize);
+		TestCheck(bvh.getNumPrimitives() == (unsigned int)kNumPrimitives);
+		AABB bounds = bvh.getBounds();
+		for (int i = 0; i < kNumPrimitives; i++)
+			TestCheck(bounds.getPointIsInside(aabbs[i].getMin()) && bounds.getPointIsInside(aabbs[i].getMax()));
+
+		// Rays with a maximum distance, in random directions, which getRayIntersection() normalises first
+		int numRayHits = 0;
+		for (int iRay = 0; iRay < 300; iRay++)
+		{
+			Vector3f vOrigin = randomPosition(130);
+			Vector3f vTarget = randomPosition(60);
+			Vector3f vDirection = vTarget - vOrigin;
+			float fMaxDistance = (float)(20 + random() % 300);
+			float fLength = vDirection.getMagnitude();
+			Vector3f vUnitDirection(vDirection.x / fLength, vDirection.y / fLength, vDirection.z / fLength);
+			float fExpectedDistance;
+			bool bExpectedHit = getNearestHit(vOrigin, vUnitDirection, fMaxDistance, fExpectedDistance);
+			unsigned int primitive;
+			float fDistance;
+			TestCheck(bvh.getRayIntersection(vOrigin, vDirection, fMaxDistance, primitive, fDistance) == bExpectedHit);
+			TestCheck(bvh.getRayIntersectsAny(vOrigin, vDirection, fMaxDistance) == bExpectedHit);
+			if (bExpectedHit)
+			{
+				numRayHits++;
+				TestCheck(fDistance == fExpectedDistance);
+				float fPrimitiveDistance;
+				TestCheck(getRayHitsAABB(vOrigin, vUnitDirection, aabbs[primitive], fMaxDistance, fPrimitiveDistance) && fPrimitiveDistance == fDistance);
+			}
+		}
+		TestCheck(numRayHits > 30 && numRayHits < 270);
+
+		// Segments in random directions, some starting inside of a primitive
+		int numSegmentHits = 0;
+		for (int iSegment = 0; iSegment < 300; iSegment++)
+		{
+			Vector3f vStart = randomPosition(110);
+			Vector3f vEnd = randomPosition(110);
+			if (checkSegment(bvh, vStart, vEnd))
+				numSegmentHits++;
+		}
+		TestCheck(numSegmentHits > 30 && numSegmentHits < 270);
+
+		// Segments along each axis and in each direction, whose direction has two components of zero, which the BVH
+		// tests seperately. Along the other two axes the segments are at whole numbers, so that lots of them run
+		// exactly along the faces of the boxes, both the minimum and maximum ones, which they hit, the same as AABBs
+		// which only touch intersect.
+		int numAxisHits = 0;
+		for (int iSegment = 0; iSegment < 600; iSegment++)
+		{
+			float fX = coordinate(110);
+			float fY = coordinate(110);
+			float fZ = coordinate(110);
+			Vector3f vStart(fX, fY, fZ);
+			float fLength = coordinate(60);
+			int axis = iSegment % 3;
+			if (0 == axis)
+				vStart.x += 0.5f;
+			else if (1 == axis)
+				vStart.y += 0.5f;
+			else
+				vStart.z += 0.5f;
+			Vector3f vEnd = vStart;
+			if (0 == axis)
+				vEnd.x += fLength;
+			else if (1 == axis)
+				vEnd.y += fLength;
+			else
+				vEnd.z += fLength;
+			bool bHit = checkSegment(bvh, vStart, vEnd);
+			if (bHit)
+				numAxisHits++;
+
+			// Which must also be what working it out along just the one axis gives
+			float fStart[3] = { vStart.x, vStart.y, vStart.z };
+			float fEnd[3] = { vEnd.x, vEnd.y, vEnd.z };
+			bool bExpectedHit = false;
+			for (int i = 0; i < kNumPrimitives; i++)
+			{
+				Vector3f vMin = aabbs[i].getMin();
+				Vector3f vMax = aabbs[i].getMax();
+				float fMin[3] = { vMin.x, vMin.y, vMin.z };
+				float fMax[3] = { vMax.x, vMax.y, vMax.z };
+				bool bInside = true;
+				for (int otherAxis = 0; otherAxis < 3; otherAxis++)
+				{
+					if (otherAxis == axis)
+						bInside = bInside && std::max(fStart[axis], fEnd[axis]) >= fMin[axis] && std::min(fStart[axis], fEnd[axis]) <= fMax[axis];
+					else
+						bInside = bInside && fStart[otherAxis] >= fMin[otherAxis] && fStart[otherAxis] <= fMax[otherAxis];
+				}
+				bExpectedHit = bExpectedHit || bInside;
+			}
+			TestCheck(bHit == bExpectedHit);
+		}
+		TestCheck(numAxisHits > 20 && numAxisHits < 580);
+
+		// Segments of zero length, which hit only the primitives they're inside of or on the surface of, at a fraction
+		// of 0. Half of them are at whole numbers, so are often on the surface of a box.
+		int numPointHits = 0;
+		for (int iSegment = 0; iSegment < 300; iSegment++)
+		{
+			Vector3f vPoint = randomPosition(110);
+			if (iSegment & 1)
+				vPoint -= Vector3f(0.5f, 0.5f, 0.5f);
+			bool bExpectedHit = false;
+			for (int i = 0; i < kNumPrimitives; i++)
+				bExpectedHit = bExpectedHit || aabbs[i].getPointIsInside(vPoint);
+			TestCheck(checkSegment(bvh, vPoint, vPoint) == bExpectedHit);
+			unsigned int primitive;
+			float fFraction;
+			if (bvh.getSegmentIntersection(vPoint, vPoint, primitive, fFraction))
+			{
+				numPointHits++;
+				TestCheck(0.0f == fFraction);
+				TestCheck(aabbs[primitive].getPointIsInside(vPoint));
+			}
+		}
+		TestCheck(numPointHits > 10 && numPointHits < 290);
+
+		// AABBs, which find every primitive whose AABB touches them
+		for (int iQuery = 0; iQuery < 100; iQuery++)
+		{
+			float fX = coordinate(110);
+			float fY = coordinate(110);
+			float fZ = coordinate(110);
+			float fSize = (float)(random() % 40);
+			AABB aabb(Vector3f(fX, fY, fZ), Vector3f(fX + fSize, fY + fSize * 0.5f, fZ + fSize * 2.0f));
+			std::vector<unsigned int> expected;
+			for (int i = 0; i < kNumPrimitives; i++)
+			{
+				if (aabb.getAABBintersects(aabbs[i]))
+					expected.push_back((unsigned int)i);
+			}
+			std::vector<unsigned int> found = bvh.getPrimitivesWithinAABB(aabb);
+			std::sort(found.begin(), found.end());
+			TestCheck(found == expected);
+		}
+
+		// Frustums, which find every primitive whose AABB isn't wholly behind one of the planes
+		for (int iQuery = 0; iQuery < 50; iQuery++)
+		{
+			Vector3f vPosition = randomPosition(150);
+			Vector3f vTarget = randomPosition(40);
+			Frustum frustum = createFrustum(vPosition, vTarget);
+			const Plane* pPlanes[6] = { &frustum.planeNear, &frustum.planeFar, &frustum.planeLeft, &frustum.planeRight, &frustum.planeTop, &frustum.planeBottom };
+			std::vector<unsigned int> expected;
+			for (int i = 0; i < kNumPrimitives; i++)
+			{
+				Vector3f vMin = aabbs[i].getMin();
+				Vector3f vMax = aabbs[i].getMax();
+				bool bOutside = false;
+				for (int plane = 0; plane < 6 && !bOutside; plane++)
+				{
+					Vector3f vNormal = pPlanes[plane]->getNormal();
+					Vector3f vFurthest(vNormal.x >= 0.0f ? vMax.x : vMin.x, vNormal.y >= 0.0f ? vMax.y : vMin.y, vNormal.z >= 0.0f ? vMax.z : vMin.z);
+					bOutside = vNormal.x * vFurthest.x + vNormal.y * vFurthest.y + vNormal.z * vFurthest.z < pPlanes[plane]->getDistanceToOrigin();
+				}
+				if (!bOutside)
+					expected.push_back((unsigned int)i);
+			}
+			std::vector<unsigned int> found = bvh.getPrimitivesWithinFrustum(frustum);
+			std::sort(found.begin(), found.end());
+			TestCheck(found == expected);
+		}
+	}
+
+	// An empty BVH finds nothing
+	BVH bvh;
+	bvh.build(std::vector<AABB>());
+	unsigned int primitive;
+	float fT;
+	TestCheck(!bvh.getSegmentIntersection(Vector3f(0.0f, 0.0f, 0.0f), Vector3f(1.0f, 1.0f, 1.0f), primitive, fT));
+	TestCheck(!bvh.getSegmentIntersectsAny(Vector3f(0.0f, 0.0f, 0.0f), Vector3f(1.0f, 1.0f, 1.0f)));
+	TestCheck(bvh.getPrimitivesWithinAABB(AABB(Vector3f(-1.0f, -1.0f, -1.0f), Vector3f(1.0f, 1.0f, 1.0f))).empty());
+}
+
+// LinearOctTree must find the same entities as OctTree with the exact queries and getNearestEntities(), and it's other
+// queries, which may return entities outside of the shape, must return all of the ones inside of it and none twice.
+// This is checked after moving entities within the smallest node they're in, which updates them straight away, and
+// after moving, adding and removing them, which needs a rebuild, checking getNeedsRebuild() after each change.
+DC_TEST(linearOctTreeQueriesMatchOctTree)
+{
+	const int kNumEntities = 4000;
+	std::mt19937 random(11);
+	auto coordinate = [&](int entityPARAM) { return 0 == entityPARAM % 4 ? (float)((int)(random() % 5) - 2) : (float)((int)(random() % 81) - 40); };
+	auto getSortedIndicies = [](const std::vector<OctTreeEntity*>& entitiesPARAM)
+		{
+			std::vector<int> indicies;
+			for (const OctTreeEntity* pEntity : entitiesPARAM)
+				indicies.push_back(pEntity->userData);
+			std::sort(indicies.begin(), indicies.end());
+			return indicies;
+		};
+
+	OctTree octTree;
+	LinearOctTree linearOctTree;
+	TestCheck(!linearOctTree.getNeedsRebuild());
+	std::vector<SpatialEntityHandle> handles;
+	std::vector<SpatialEntityHandle> linearHandles;
+	std::vector<Vector3f> positions;
+	std::vector<bool> removed;
+	auto addEntity = [&](const Vector3f& positionPARAM)
+		{
+			int userData = (int)positions.size();
+			positions.push_back(positionPARAM);
+			removed.push_back(false);
+			handles.push_back(octTree.addEntity(positionPARAM, userData));
+			linearHandles.push_back(linearOctTree.addEntity(positionPARAM, userData));
+		};
+	auto setEntityPosition = [&](int entityPARAM, const Vector3f& positionPARAM)
+		{
+			positions[entityPARAM] = positionPARAM;
+			octTree.setEntityPosition(handles[entityPARAM], positionPARAM);
+			linearOctTree.setEntityPosition(linearHandles[entityPARAM], positionPARAM);
+		};
+	for (int i = 0; i < kNumEntities; i++)
+	{
+		float fX = coordinate(i);
+		float fY = coordinate(i);
+		float fZ = coordinate(i);
+		addEntity(Vector3f(fX, fY, fZ));
+	}
+	TestCheck(linearOctTree.getNeedsRebuild());
+	linearOctTree.rebuild();
+	TestCheck(!linearOctTree.getNeedsRebuild());
+
+	auto checkQueries = [&]()
+		{
+			// Every entity must still be where it was put
+			for (size_t i = 0; i < positions.size(); i++)
+			{
+				TestCheck(linearOctTree.getEntityExists(linearHandles[i]) == !removed[i]);
+				if (removed[i])
+					continue;
+				Vector3f vPosition;
+				linearOctTree.getEntityPosition(linearHandles[i], vPosition);
+				TestCheck(vPosition == positions[i]);
+				TestCheck(linearOctTree.getEntity(linearHandles[i])->userData == (int)i);
+			}
+
+			for (int iQuery = 0; iQuery < 30; iQuery++)
+			{
+				int iX = (int)(random() % 61) - 30;
+				int iY = (int)(random() % 61) - 30;
+				int iZ = (int)(random() % 61) - 30;
+				if (0 == iQuery % 5)
+					iX = iY = iZ = 0;
+				Vector3f vCentre((float)iX, (float)iY, (float)iZ);
+				float fRange = (float)(iQuery % 20);
+				AABB aabb(vCentre - Vector3f(fRange, fRange * 0.5f, 3.0f), vCentre + Vector3f(2.0f, fRange, fRange));
+
+				std::vector<int> inRange = getSortedIndicies(octTree.getEntitiesWithinRangeExact(vCentre, fRange));
+				TestCheck(getSortedIndicies(linearOctTree.getEntitiesWithinRangeExact(vCentre, fRange)) == inRange);
+				std::vector<OctTreeEntity*> sorted = linearOctTree.getEntitiesWithinRangeExact(vCentre, fRange, true);
+				TestCheck(getSortedIndicies(sorted) == inRange);
+				for (size_t i = 1; i < sorted.size(); i++)
+					TestCheck(positions[sorted[i - 1]->userData].getDistanceSquared(vCentre) <= positions[sorted[i]->userData].getDistanceSquared(vCentre));
+				std::vector<int> inAABB = getSortedIndicies(octTree.getEntitiesWithinAABBExact(aabb));
+				TestCheck(getSortedIndicies(linearOctTree.getEntitiesWithinAABBExact(aabb)) == inAABB);
+
+				std::vector<int> nearRange = getSortedIndicies(linearOctTree.getEntitiesWithinRange(vCentre, fRange));
+				TestCheck(std::adjacent_find(nearRange.begin(), nearRange.end()) == nearRange.end());
+				TestCheck(std::includes(nearRange.begin(), nearRange.end(), inRange.begin(), inRange.end()));
+				std::vector<int> nearAABB = getSortedIndicies(linearOctTree.getEntitiesWithinAABB(aabb));
+				TestCheck(std::adjacent_find(nearAABB.begin(), nearAABB.end()) == nearAABB.end());
+				TestCheck(std::includes(nearAABB.begin(), nearAABB.end(), inAABB.begin(), inAABB.end()));
+
+				// The positions are whole numbers, so lots of entities are the same distance away and the trees may
+				// choose different ones of those, but the distances must be the same
+				unsigned int k = 1 + iQuery % 12;
+				float fMaxRange = 0 == iQuery % 3 ? fRange : FLT_MAX;
+				std::vector<OctTreeEntity*> nearest = octTree.getNearestEntities(vCentre, k, fMaxRange);
+				std::vector<OctTreeEntity*> linearNearest = linearOctTree.getNearestEntities(vCentre, k, fMaxRange);
+				TestCheck(linearNearest.size() == nearest.size());
+				for (size_t i = 0; i < nearest.size() && i < linearNearest.size(); i++)
+					TestCheck(positions[linearNearest[i]->userData].getDistanceSquared(vCentre) == positions[nearest[i]->userData].getDistanceSquared(vCentre));
+				std::vector<int> nearestIndicies = getSortedIndicies(linearNearest);
+				TestCheck(std::adjacent_find(nearestIndicies.begin(), nearestIndicies.end()) == nearestIndicies.end());
+			}
+
+			for (int iQuery = 0; iQuery < 10; iQuery++)
+			{
+				Vector3f vPosition((float)((int)(random() % 161) - 80), (float)((int)(random() % 161) - 80), (float)((int)(random() % 161) - 80));
+				Frustum frustum = createFrustum(vPosition, Vector3f(0.5f, 0.5f, 0.5f));
+				std::vector<int> inFrustum;
+				for (size_t i = 0; i < positions.size(); i++)
+				{
+					if (!removed[i] && frustum.isPointInside(positions[i]))
+						inFrustum.push_back((int)i);
+				}
+				std::vector<int> octTreeFound = getSortedIndicies(octTree.getEntitiesWithinFrustum(frustum));
+				std::vector<int> linearFound = getSortedIndicies(linearOctTree.getEntitiesWithinFrustum(frustum));
+				TestCheck(std::includes(octTreeFound.begin(), octTreeFound.end(), inFrustum.begin(), inFrustum.end()));
+				TestCheck(std::adjacent_find(linearFound.begin(), linearFound.end()) == linearFound.end());
+				TestCheck(std::includes(linearFound.begin(), linearFound.end(), inFrustum.begin(), inFrustum.end()));
+			}
+		};
+	checkQueries();
+
+	// Move half of the entities somewhere else within the smallest node they're in, which is updated straight away.
+	// The new positions are kept away from the node's sides, so that rounding can't put them in the next node.
+	AABB region = linearOctTree.getRegion();
+	Vector3f vRegionMin = region.getMin();
+	float fSmallestNodeSize = (region.getMax().x - vRegionMin.x) / 1024.0f;
+	std::uniform_real_distribution<float> offset(0.25f, 0.75f);
+	auto getPositionInSameNode = [&](float positionPARAM, float regionMinPARAM)
+		{
+			float fNode = floorf((positionPARAM - regionMinPARAM) / fSmallestNodeSize);
+			return regionMinPARAM + (fNode + offset(random)) * fSmallestNodeSize;
+		};
+	for (int i = 0; i < kNumEntities; i += 2)
+	{
+		float fX = getPositionInSameNode(positions[i].x, vRegionMin.x);
+		float fY = getPositionInSameNode(positions[i].y, vRegionMin.y);
+		float fZ = getPositionInSameNode(positions[i].z, vRegionMin.z);
+		setEntityPosition(i, Vector3f(fX, fY, fZ));
+	}
+	TestCheck(!linearOctTree.getNeedsRebuild());
+	checkQueries();
+
+	// Moving an entity into another node needs a rebuild, after which moving entities within their nodes doesn't
+	// change that until rebuild() is called
+	setEntityPosition(1, positions[1] + Vector3f(fSmallestNodeSize * 3.0f, 0.0f, 0.0f));
+	TestCheck(linearOctTree.getNeedsRebuild());
+	for (int i = 3; i < kNumEntities; i += 5)
+	{
+		float fX = coordinate(i);
+		float fY = coordinate(i);
+		float fZ = coordinate(i);
+		setEntityPosition(i, Vector3f(fX, fY, fZ));
+	}
+	setEntityPosition(0, positions[0]);
+	TestCheck(linearOctTree.getNeedsRebuild());
+	linearOctTree.rebuild();
+	TestCheck(!linearOctTree.getNeedsRebuild());
+	checkQueries();
+
+	// Moving an entity outside of the region means the next rebuild() has to compute a larger one
+	setEntityPosition(5, Vector3f(500.0f, -3.0f, 7.0f));
+	TestCheck(linearOctTree.getNeedsRebuild());
+	linearOctTree.rebuild();
+	TestCheck(linearOctTree.getRegion().getPointIsInside(positions[5]));
+	checkQueries();
+
+	// Removing and adding entities
+	for (int i = 0; i < kNumEntities; i += 7)
+	{
+		octTree.removeEntity(handles[i]);
+		linearOctTree.removeEntity(linearHandles[i]);
+		removed[i] = true;
+	}
+	TestCheck(linearOctTree.getNeedsRebuild());
+	linearOctTree.rebuild();
+	TestCheck(!linearOctTree.getNeedsRebuild());
+	TestCheck(linearOctTree.getNumEntities() == (unsigned int)(kNumEntities - (kNumEntities + 6) / 7));
+	checkQueries();
+	for (int i = 0; i < 500; i++)
+	{
+		float fX = coordinate(i);
+		float fY = coordinate(i);
+		float fZ = coordinate(i);
+		addEntity(Vector3f(fX, fY, fZ));
+	}
+	TestCheck(linearOctTree.getNeedsRebuild());
+	linearOctTree.rebuild();
+	checkQueries();
+
+	// Neither of these need a rebuild afterwards
+	linearOctTree.removeAllEntities();
+	TestCheck(!linearOctTree.getNeedsRebuild());
+	TestCheck(0 == linearOctTree.getNumEntities());
+	linearOctTree.buildFromPoints(positions);
+	TestCheck(!linearOctTree.getNeedsRebuild());
+	TestCheck(linearOctTree.getNumEntities() == positions.size());
+}
\ No newline at end of file
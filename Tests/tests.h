@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+
+// A tiny test framework for the DavesCodeLib tests.
+// Each test is a function which is registered with DC_TEST and uses TestCheck() to check that things are as expected.
+// main() runs each of the registered tests, printing any checks which failed and returns the number of tests which failed.
+// Passing a name on the command line only runs the tests whose names contain it.
+//
+// Example:
+// DC_TEST(vector3fAddition)
+// {
+//     DC::Vector3f v = DC::Vector3f(1, 2, 3) + DC::Vector3f(1, 1, 1);
+//     TestCheck(v == DC::Vector3f(2, 3, 4));
+// }
+namespace DCTests
+{
+	// Signature of a test function
+	typedef void (*TestFunction)(void);
+
+	// A registered test
+	struct Test
+	{
+		const char* name;
+		TestFunction function;
+	};
+
+	// Returns all of the registered tests
+	std::vector<Test>& getTests(void);
+
+	// Registers the given test when constructed, which DC_TEST does before main() is called
+	class TestRegistrar
+	{
+	public:
+		TestRegistrar(const char* name, TestFunction function);
+	};
+
+	// If the given condition is false, prints the condition along with the file and line it's from and marks the
+	// currently running test as having failed. Use TestCheck() rather than calling this directly.
+	void check(bool condition, const char* conditionText, const char* fileName, int lineNumber);
+}
+
+// Declares and registers a test function with the given name
+#define DC_TEST(testName)\
+	static void testName(void);\
+	static DCTests::TestRegistrar testName##Registrar(#testName, testName);\
+	static void testName(void)
+
+// Checks that x is true, failing the current test if it isn't
+#define TestCheck(x) DCTests::check((x), #x, __FILE__, __LINE__)
\ No newline at end of file